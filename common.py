@@ -142,6 +142,7 @@ def get_sources(env, is_editor_build, include_tests):
     if include_tests:
         sources += [
             "tests/*.cpp",
+            "tests/benchmarks/*.cpp",
             "tests/util/*.cpp",
             "tests/voxel/*.cpp"
         ]
@@ -45,6 +45,7 @@ VoxelStringNames::VoxelStringNames() {
 
 	voxel_normalmap_atlas = StringName("voxel_normalmap_atlas");
 	voxel_normalmap_lookup = StringName("voxel_normalmap_lookup");
+	voxel_cubes_atlas_tile = StringName("_voxel_cubes_atlas_tile");
 
 	u_voxel_normalmap_atlas = StringName("u_voxel_normalmap_atlas");
 	u_voxel_cell_lookup = StringName("u_voxel_cell_lookup");
@@ -61,6 +62,7 @@ VoxelStringNames::VoxelStringNames() {
 
 	changed = StringName("changed");
 	frame_post_draw = StringName("frame_post_draw");
+	frame_pre_draw = StringName("frame_pre_draw");
 
 #ifdef TOOLS_ENABLED
 	Add = StringName("Add");
@@ -82,7 +84,6 @@ VoxelStringNames::VoxelStringNames() {
 #endif
 
 	_rpc_receive_blocks = StringName("_rpc_receive_blocks");
-	_rpc_receive_area = StringName("_rpc_receive_area");
 
 	unnamed = StringName("unnamed");
 	air = StringName("air");
@@ -116,6 +117,7 @@ VoxelStringNames::VoxelStringNames() {
 
 	_on_async_search_completed = StringName("_on_async_search_completed");
 	async_search_completed = StringName("async_search_completed");
+	async_paths_found = StringName("async_paths_found");
 
 	file_selected = StringName("file_selected");
 }
@@ -39,6 +39,7 @@ public:
 
 	StringName voxel_normalmap_atlas;
 	StringName voxel_normalmap_lookup;
+	StringName voxel_cubes_atlas_tile;
 
 	StringName u_voxel_normalmap_atlas;
 	StringName u_voxel_cell_lookup;
@@ -56,6 +57,7 @@ public:
 	// These are usually in CoreStringNames, but when compiling as a GDExtension, we don't have access to them
 	StringName changed;
 	StringName frame_post_draw;
+	StringName frame_pre_draw;
 
 #ifdef TOOLS_ENABLED
 	StringName Add;
@@ -77,7 +79,6 @@ public:
 #endif
 
 	StringName _rpc_receive_blocks;
-	StringName _rpc_receive_area;
 
 	StringName unnamed;
 	StringName air;
@@ -103,6 +104,7 @@ public:
 
 	StringName _on_async_search_completed;
 	StringName async_search_completed;
+	StringName async_paths_found;
 
 	StringName file_selected;
 };
@@ -0,0 +1,528 @@
+#include "blocky_lighting.h"
+#include "../meshers/blocky/voxel_blocky_library_base.h"
+#include "../storage/voxel_data.h"
+#include "../util/containers/container_funcs.h"
+#include "../util/math/funcs.h"
+#include "../util/memory/memory.h"
+#include "../util/profiling.h"
+
+namespace zylann::voxel {
+
+void BlockyLightingRules::update_from_library(const VoxelBlockyLibraryBase &library) {
+	RWLockRead rlock(library.get_baked_data_rw_lock());
+	const VoxelBlockyLibraryBase::BakedData &lib_data = library.get_baked_data();
+
+	models.resize(lib_data.models.size());
+	for (unsigned int i = 0; i < lib_data.models.size(); ++i) {
+		const VoxelBlockyModel::BakedData &model_data = lib_data.models[i];
+		Model &model = models[i];
+		model.emission = math::min(model_data.light_emission, blocky_light::MAX_LEVEL);
+		// Only full cubes contribute to AO
+		model.opaque = !model_data.empty && model_data.contributes_to_ao && model_data.transparency_index == 0;
+	}
+}
+
+namespace {
+
+// Light can't change further than this from a voxel that changed, except straight down for sky light
+constexpr int LIGHT_RANGE = blocky_light::MAX_LEVEL;
+
+enum LightKind { //
+	LIGHT_BLOCK = 0,
+	LIGHT_SKY
+};
+
+const Vector3i g_directions[6] = {
+	Vector3i(-1, 0, 0), //
+	Vector3i(1, 0, 0), //
+	Vector3i(0, -1, 0), //
+	Vector3i(0, 1, 0), //
+	Vector3i(0, 0, -1), //
+	Vector3i(0, 0, 1) //
+};
+
+constexpr unsigned int DIRECTION_DOWN = 2;
+
+struct BlockyLightingJob {
+	// Voxels which may no longer match their neighbors
+	Box3i check_box;
+	// Voxels whose light may change. Everything outside is left untouched.
+	Box3i write_box;
+	// Blocks covering `write_box`, locked while the job runs
+	Box3i blocks_box;
+
+	Box3i changed_box;
+	bool changed = false;
+};
+
+// Voxel buffers of blocks covering the area of a job
+class BlockyLightingGrid {
+public:
+	void load(VoxelData &data, Box3i blocks_box) {
+		_blocks_box = blocks_box;
+		_block_size_po2 = data.get_block_size_po2();
+		_block_mask = (1 << _block_size_po2) - 1;
+		_blocks.clear();
+		_blocks.resize(Vector3iUtil::get_volume(blocks_box.size));
+		data.get_blocks_with_voxel_data(blocks_box, 0, to_span(_blocks));
+	}
+
+	void clear() {
+		_blocks.clear();
+	}
+
+	// Returns null if the voxel is in a block that isn't loaded
+	inline VoxelBuffer *get_block(Vector3i pos, Vector3i &out_rpos) const {
+		const Vector3i bpos = (pos >> _block_size_po2) - _blocks_box.position;
+		if (bpos.x < 0 || bpos.y < 0 || bpos.z < 0 || bpos.x >= _blocks_box.size.x || bpos.y >= _blocks_box.size.y ||
+			bpos.z >= _blocks_box.size.z) {
+			return nullptr;
+		}
+		out_rpos = pos & _block_mask;
+		return _blocks[Vector3iUtil::get_zxy_index(bpos, _blocks_box.size)].get();
+	}
+
+private:
+	StdVector<std::shared_ptr<VoxelBuffer>> _blocks;
+	Box3i _blocks_box;
+	unsigned int _block_size_po2 = 0;
+	int _block_mask = 0;
+};
+
+// Runs removal and propagation passes for one kind of light within the area of a job
+class BlockyLightPropagator {
+public:
+	BlockyLightPropagator(
+			const BlockyLightingGrid &grid,
+			const BlockyLightingRules &rules,
+			VoxelBuffer::ChannelId channel,
+			Box3i write_box,
+			LightKind kind
+	) :
+			_grid(grid),
+			_rules(rules),
+			_channel(channel),
+			_write_box(write_box),
+			_kind(kind),
+			_shift(kind == LIGHT_SKY ? 4 : 0) {}
+
+	void relight(Box3i check_box) {
+		StdVector<Node> &removal_queue = get_tls_removal_queue();
+		StdVector<Node> &add_queue = get_tls_add_queue();
+		StdVector<Vector3i> &seeds = get_tls_seeds();
+		removal_queue.clear();
+		add_queue.clear();
+		seeds.clear();
+
+		check_box.clip(_write_box);
+
+		// Find voxels whose light no longer matches their surroundings
+		check_box.for_each_cell_zxy([this, &removal_queue, &seeds](Vector3i pos) {
+			Vector3i rpos;
+			if (_grid.get_block(pos, rpos) == nullptr) {
+				return;
+			}
+			const uint8_t expected_level = compute_level(pos);
+			const uint8_t current_level = get_level(pos);
+			if (expected_level == current_level) {
+				return;
+			}
+			if (current_level > 0) {
+				set_level(pos, 0);
+				removal_queue.push_back(Node{ pos, current_level });
+			}
+			seeds.push_back(pos);
+		});
+
+		// Remove light that came from these voxels. Neighbors brighter than the removed light have another source,
+		// so light is propagated back from them afterward.
+		for (unsigned int i = 0; i < removal_queue.size(); ++i) {
+			const Node node = removal_queue[i];
+
+			for (unsigned int di = 0; di < 6; ++di) {
+				const Vector3i npos = node.pos + g_directions[di];
+				if (!_write_box.contains(npos)) {
+					continue;
+				}
+				const uint8_t nlevel = get_level(npos);
+				if (nlevel == 0) {
+					continue;
+				}
+				if (nlevel < node.level ||
+					(_kind == LIGHT_SKY && di == DIRECTION_DOWN && node.level == blocky_light::MAX_LEVEL)) {
+					set_level(npos, 0);
+					removal_queue.push_back(Node{ npos, nlevel });
+				} else {
+					add_queue.push_back(Node{ npos, nlevel });
+				}
+			}
+		}
+
+		for (const Vector3i pos : seeds) {
+			const uint8_t level = compute_level(pos);
+			if (level > get_level(pos)) {
+				set_level(pos, level);
+				add_queue.push_back(Node{ pos, level });
+			}
+		}
+
+		// Propagate light
+		for (unsigned int i = 0; i < add_queue.size(); ++i) {
+			const Vector3i pos = add_queue[i].pos;
+			// It may have changed since it was queued
+			const uint8_t level = get_level(pos);
+			if (level <= 1) {
+				continue;
+			}
+
+			for (unsigned int di = 0; di < 6; ++di) {
+				const Vector3i npos = pos + g_directions[di];
+				if (!_write_box.contains(npos)) {
+					continue;
+				}
+				const uint8_t nlevel =
+						(_kind == LIGHT_SKY && di == DIRECTION_DOWN && level == blocky_light::MAX_LEVEL) ? level
+																										 : level - 1;
+				if (get_level(npos) >= nlevel) {
+					continue;
+				}
+				Vector3i rpos;
+				const VoxelBuffer *voxels = _grid.get_block(npos, rpos);
+				if (voxels == nullptr || get_model(*voxels, rpos).opaque) {
+					continue;
+				}
+				set_level(npos, nlevel);
+				add_queue.push_back(Node{ npos, nlevel });
+			}
+		}
+	}
+
+	inline bool has_changes() const {
+		return _changed;
+	}
+
+	inline Box3i get_changed_box() const {
+		return Box3i::from_min_max(_changed_min, _changed_max + Vector3i(1, 1, 1));
+	}
+
+private:
+	struct Node {
+		Vector3i pos;
+		uint8_t level;
+	};
+
+	static StdVector<Node> &get_tls_removal_queue() {
+		static thread_local StdVector<Node> tls_queue;
+		return tls_queue;
+	}
+
+	static StdVector<Node> &get_tls_add_queue() {
+		static thread_local StdVector<Node> tls_queue;
+		return tls_queue;
+	}
+
+	static StdVector<Vector3i> &get_tls_seeds() {
+		static thread_local StdVector<Vector3i> tls_seeds;
+		return tls_seeds;
+	}
+
+	inline BlockyLightingRules::Model get_model(const VoxelBuffer &voxels, Vector3i rpos) const {
+		return _rules.get_model(voxels.get_voxel(rpos, VoxelBuffer::CHANNEL_TYPE));
+	}
+
+	// Voxels in blocks that aren't loaded are dark
+	inline uint8_t get_level(Vector3i pos) const {
+		Vector3i rpos;
+		const VoxelBuffer *voxels = _grid.get_block(pos, rpos);
+		if (voxels == nullptr) {
+			return 0;
+		}
+		return (voxels->get_voxel(rpos, _channel) >> _shift) & 0xf;
+	}
+
+	inline void set_level(Vector3i pos, uint8_t level) {
+		Vector3i rpos;
+		VoxelBuffer *voxels = _grid.get_block(pos, rpos);
+		ZN_ASSERT_RETURN(voxels != nullptr);
+		const uint64_t v = voxels->get_voxel(rpos, _channel);
+		voxels->set_voxel((v & ~(uint64_t(0xf) << _shift)) | (uint64_t(level) << _shift), rpos, _channel);
+
+		if (_changed) {
+			_changed_min = math::min(_changed_min, pos);
+			_changed_max = math::max(_changed_max, pos);
+		} else {
+			_changed_min = pos;
+			_changed_max = pos;
+			_changed = true;
+		}
+	}
+
+	// Light level a voxel should have given its neighbors
+	uint8_t compute_level(Vector3i pos) const {
+		Vector3i rpos;
+		const VoxelBuffer *voxels = _grid.get_block(pos, rpos);
+		ZN_ASSERT_RETURN_V(voxels != nullptr, 0);
+		const BlockyLightingRules::Model model = get_model(*voxels, rpos);
+
+		const uint8_t own_level = _kind == LIGHT_BLOCK ? model.emission : 0;
+		if (model.opaque) {
+			return own_level;
+		}
+
+		if (_kind == LIGHT_SKY) {
+			const Vector3i above_pos = pos + Vector3i(0, 1, 0);
+			Vector3i above_rpos;
+			if (_grid.get_block(above_pos, above_rpos) == nullptr) {
+				// Nothing loaded above, assume it is open sky
+				return blocky_light::MAX_LEVEL;
+			}
+			if (get_level(above_pos) == blocky_light::MAX_LEVEL) {
+				return blocky_light::MAX_LEVEL;
+			}
+		}
+
+		int level = own_level;
+		for (unsigned int di = 0; di < 6; ++di) {
+			level = math::max(level, get_level(pos + g_directions[di]) - 1);
+		}
+		return level;
+	}
+
+	const BlockyLightingGrid &_grid;
+	const BlockyLightingRules &_rules;
+	const VoxelBuffer::ChannelId _channel;
+	const Box3i _write_box;
+	const LightKind _kind;
+	const unsigned int _shift;
+
+	bool _changed = false;
+	Vector3i _changed_min;
+	Vector3i _changed_max;
+};
+
+bool run_lighting_job(
+		VoxelData &data,
+		const BlockyLightingRules &rules,
+		VoxelBuffer::ChannelId channel,
+		BlockyLightingJob &job
+) {
+	ZN_PROFILE_SCOPE();
+
+	SpatialLock3D &spatial_lock = data.get_spatial_lock(0);
+	const BoxBounds3i lock_box(job.blocks_box);
+	if (!spatial_lock.try_lock_write(lock_box)) {
+		return false;
+	}
+
+	static thread_local BlockyLightingGrid tls_grid;
+	tls_grid.load(data, job.blocks_box);
+
+	for (const LightKind kind : { LIGHT_BLOCK, LIGHT_SKY }) {
+		BlockyLightPropagator propagator(tls_grid, rules, channel, job.write_box, kind);
+		propagator.relight(job.check_box);
+		if (propagator.has_changes()) {
+			if (job.changed) {
+				job.changed_box.merge_with(propagator.get_changed_box());
+			} else {
+				job.changed_box = propagator.get_changed_box();
+				job.changed = true;
+			}
+		}
+	}
+
+	// Don't hold references to voxels longer than needed
+	tls_grid.clear();
+
+	spatial_lock.unlock_write(lock_box);
+	return true;
+}
+
+} // namespace
+
+class BlockyLighting::Task : public IThreadedTask {
+public:
+	Task(
+			std::shared_ptr<VoxelData> data,
+			std::shared_ptr<const BlockyLightingRules> rules,
+			VoxelBuffer::ChannelId channel,
+			const BlockyLightingJob &job,
+			std::shared_ptr<Output> output
+	) :
+			_data(data), _rules(rules), _channel(channel), _job(job), _output(output) {}
+
+	void run(ThreadedTaskContext &ctx) override {
+		if (!run_lighting_job(*_data, *_rules, _channel, _job)) {
+			// Another thread is using the area, try later
+			ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+		}
+	}
+
+	void apply_result() override {
+		Output &output = *_output;
+		ZN_ASSERT(output.task_count > 0);
+		--output.task_count;
+
+		if (!_job.changed) {
+			return;
+		}
+		output.modified_boxes.push_back(_job.changed_box);
+
+		// Sky light changed at the bottom of the area, so voxels below may have to change too
+		const int bottom_y = _job.write_box.position.y;
+		if (_job.changed_box.position.y == bottom_y && bottom_y > _data->get_bounds().position.y) {
+			output.next_check_boxes.push_back(Box3i(
+					Vector3i(_job.changed_box.position.x, bottom_y - 1, _job.changed_box.position.z),
+					Vector3i(_job.changed_box.size.x, 1, _job.changed_box.size.z)
+			));
+		}
+	}
+
+	const char *get_debug_name() const override {
+		return "BlockyLighting";
+	}
+
+private:
+	std::shared_ptr<VoxelData> _data;
+	std::shared_ptr<const BlockyLightingRules> _rules;
+	VoxelBuffer::ChannelId _channel;
+	BlockyLightingJob _job;
+	std::shared_ptr<Output> _output;
+};
+
+BlockyLighting::BlockyLighting() : _output(make_shared_instance<Output>()) {}
+
+void BlockyLighting::set_rules(std::shared_ptr<const BlockyLightingRules> rules) {
+	_rules = rules;
+	_library = nullptr;
+	_library_bake_version = 0;
+}
+
+bool BlockyLighting::update_rules_from_library(const VoxelBlockyLibraryBase &library) {
+	uint32_t bake_version = 0;
+	{
+		RWLockRead rlock(library.get_baked_data_rw_lock());
+		bake_version = library.get_baked_data().bake_version;
+	}
+	// Models can change without their count changing, so the library is compared by bake
+	if (_rules != nullptr && _library == &library && _library_bake_version == bake_version) {
+		return false;
+	}
+	std::shared_ptr<BlockyLightingRules> rules = make_shared_instance<BlockyLightingRules>();
+	rules->update_from_library(library);
+	_rules = rules;
+	_library = &library;
+	_library_bake_version = bake_version;
+	return true;
+}
+
+void BlockyLighting::set_channel(VoxelBuffer::ChannelId channel) {
+	ZN_ASSERT_RETURN(channel >= 0 && channel < VoxelBuffer::MAX_CHANNELS);
+	ZN_ASSERT_RETURN(channel != VoxelBuffer::CHANNEL_TYPE);
+	_channel = channel;
+}
+
+void BlockyLighting::mark_block_loaded(Vector3i bpos, unsigned int block_size) {
+	const Box3i voxel_box(bpos * int(block_size), Vector3iUtil::create(block_size));
+	const Vector2i column(bpos.x, bpos.z);
+	// Neighbors touching the block may have received light from what was there before, or from the open sky above
+	// the block when it wasn't loaded
+	const Box3i check_box = voxel_box.padded(1);
+
+	MutexLock mlock(_mutex);
+	auto it = _pending_columns.find(column);
+	if (it == _pending_columns.end()) {
+		_pending_columns.insert({ column, check_box });
+	} else {
+		it->second.merge_with(check_box);
+	}
+}
+
+void BlockyLighting::mark_area_edited(Box3i voxel_box, unsigned int block_size) {
+	// Only voxels that changed can differ from their neighbors at this point
+	mark_area(voxel_box, block_size);
+}
+
+void BlockyLighting::mark_area(Box3i voxel_box, unsigned int p_block_size) {
+	const int block_size = p_block_size;
+	const Box3i blocks_box = voxel_box.downscaled(block_size);
+
+	MutexLock mlock(_mutex);
+	for (int bz = blocks_box.position.z; bz < blocks_box.position.z + blocks_box.size.z; ++bz) {
+		for (int bx = blocks_box.position.x; bx < blocks_box.position.x + blocks_box.size.x; ++bx) {
+			// Split per column of blocks
+			const Box3i column_box(
+					Vector3i(bx * block_size, voxel_box.position.y, bz * block_size),
+					Vector3i(block_size, voxel_box.size.y, block_size)
+			);
+			const Box3i check_box = voxel_box.clipped(column_box);
+			const Vector2i column(bx, bz);
+			auto it = _pending_columns.find(column);
+			if (it == _pending_columns.end()) {
+				_pending_columns.insert({ column, check_box });
+			} else {
+				it->second.merge_with(check_box);
+			}
+		}
+	}
+}
+
+void BlockyLighting::clear_pending() {
+	MutexLock mlock(_mutex);
+	_pending_columns.clear();
+}
+
+bool BlockyLighting::has_pending_work() const {
+	MutexLock mlock(_mutex);
+	return _pending_columns.size() > 0;
+}
+
+bool BlockyLighting::has_tasks_in_progress() const {
+	return _output->task_count > 0;
+}
+
+void BlockyLighting::take_tasks(const std::shared_ptr<VoxelData> &data, StdVector<IThreadedTask *> &out_tasks) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(data != nullptr);
+	ZN_ASSERT_RETURN(_rules != nullptr);
+
+	StdUnorderedMap<Vector2i, Box3i> columns;
+	{
+		MutexLock mlock(_mutex);
+		std::swap(columns, _pending_columns);
+	}
+
+	const int block_size = data->get_block_size();
+	const Box3i bounds = data->get_bounds();
+	_output->block_size = block_size;
+
+	for (auto it = columns.begin(); it != columns.end(); ++it) {
+		BlockyLightingJob job;
+		job.check_box = it->second.clipped(bounds);
+		if (Vector3iUtil::get_volume(job.check_box.size) == 0) {
+			continue;
+		}
+
+		// Sky light can go further down, but that continues in a later task if light changes at the bottom, so
+		// one task never locks a whole column of loaded blocks
+		job.write_box = job.check_box.padded(LIGHT_RANGE).clipped(bounds);
+		job.blocks_box = job.write_box.downscaled(block_size);
+
+		// Tasks working on nearby columns lock the same blocks. They will wait for each other.
+		out_tasks.push_back(ZN_NEW(Task(data, _rules, _channel, job, _output)));
+		++_output->task_count;
+	}
+}
+
+void BlockyLighting::take_results(StdVector<Box3i> &out_modified_voxel_boxes) {
+	Output &output = *_output;
+
+	append_array(out_modified_voxel_boxes, output.modified_boxes);
+	output.modified_boxes.clear();
+
+	for (const Box3i &box : output.next_check_boxes) {
+		mark_area(box, output.block_size);
+	}
+	output.next_check_boxes.clear();
+}
+
+} // namespace zylann::voxel
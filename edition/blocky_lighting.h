@@ -0,0 +1,134 @@
+#ifndef VOXEL_BLOCKY_LIGHTING_H
+#define VOXEL_BLOCKY_LIGHTING_H
+
+#include "../storage/voxel_buffer.h"
+#include "../util/containers/std_unordered_map.h"
+#include "../util/containers/std_vector.h"
+#include "../util/math/box3i.h"
+#include "../util/math/vector2i.h"
+#include "../util/tasks/threaded_task.h"
+#include "../util/thread/mutex.h"
+#include <memory>
+
+namespace zylann::voxel {
+
+class VoxelData;
+class VoxelBlockyLibraryBase;
+
+// Light levels are packed into one 8-bit value per voxel: sky light in the high 4 bits, light from emitting voxels in
+// the low 4 bits.
+namespace blocky_light {
+
+static constexpr uint8_t MAX_LEVEL = 15;
+
+inline uint8_t get_sky(uint8_t v) {
+	return v >> 4;
+}
+
+inline uint8_t get_block(uint8_t v) {
+	return v & 0xf;
+}
+
+inline uint8_t pack(uint8_t sky, uint8_t block) {
+	return (sky << 4) | block;
+}
+
+} // namespace blocky_light
+
+// Describes how each model ID of a blocky library interacts with light.
+struct BlockyLightingRules {
+	struct Model {
+		uint8_t emission = 0;
+		bool opaque = true;
+	};
+
+	// Indexed by model ID. IDs beyond the end are opaque and don't emit light.
+	StdVector<Model> models;
+
+	inline Model get_model(uint32_t model_id) const {
+		if (model_id < models.size()) {
+			return models[model_id];
+		}
+		return Model();
+	}
+
+	// Full cubes without transparency block light, other models let it through.
+	void update_from_library(const VoxelBlockyLibraryBase &library);
+};
+
+// Flood-fill lighting of blocky voxels, stored in a channel of `VoxelData`.
+//
+// Sky light enters from above the topmost loaded blocks and goes down without losing intensity, other directions lose
+// one level per voxel. Light of emitting voxels loses one level per voxel in all directions.
+//
+// Loaded and edited areas are queued, and relit incrementally by threaded tasks: voxels whose light no longer matches
+// their neighbors are found, light that came from them is removed with a breadth-first search, then light is
+// propagated back from the boundary of the removed area. There is one task per column of blocks, which writes into
+// `VoxelData` under its spatial lock, including across block borders. Sky light going further down than a task can
+// reach is queued again, and continues in later tasks.
+//
+// Unloading blocks does not relight anything, so light remains as it was in loaded blocks near them.
+class BlockyLighting {
+public:
+	BlockyLighting();
+
+	void set_rules(std::shared_ptr<const BlockyLightingRules> rules);
+	// Rebuilds rules if the library is not the one they were last built from, or was baked again since then.
+	// Returns true if they were rebuilt, in which case light of loaded blocks is likely outdated.
+	bool update_rules_from_library(const VoxelBlockyLibraryBase &library);
+
+	inline const BlockyLightingRules *get_rules() const {
+		return _rules.get();
+	}
+
+	void set_channel(VoxelBuffer::ChannelId channel);
+
+	inline VoxelBuffer::ChannelId get_channel() const {
+		return _channel;
+	}
+
+	// Must be called when voxels of a block are loaded or replaced.
+	void mark_block_loaded(Vector3i bpos, unsigned int block_size);
+	// Must be called when voxels of an area are modified.
+	void mark_area_edited(Box3i voxel_box, unsigned int block_size);
+	void clear_pending();
+
+	bool has_pending_work() const;
+
+	// Creates tasks relighting pending areas, to be scheduled by the caller. Results are gathered by `take_results`
+	// once tasks have run and their `apply_result` was called.
+	void take_tasks(const std::shared_ptr<VoxelData> &data, StdVector<IThreadedTask *> &out_tasks);
+	// Boxes of voxels where light changed are added to `out_modified_voxel_boxes`. Must be called on the thread
+	// applying task results.
+	void take_results(StdVector<Box3i> &out_modified_voxel_boxes);
+
+	bool has_tasks_in_progress() const;
+
+private:
+	void mark_area(Box3i voxel_box, unsigned int block_size);
+
+	class Task;
+
+	// Filled when tasks apply their results. Shared with tasks so they can finish after lighting is destroyed.
+	struct Output {
+		StdVector<Box3i> modified_boxes;
+		// Areas to check again because light may continue beyond what tasks could change
+		StdVector<Box3i> next_check_boxes;
+		unsigned int block_size = 0;
+		unsigned int task_count = 0;
+	};
+
+	std::shared_ptr<const BlockyLightingRules> _rules;
+	// Library rules were built from, if any
+	const VoxelBlockyLibraryBase *_library = nullptr;
+	uint32_t _library_bake_version = 0;
+	VoxelBuffer::ChannelId _channel = VoxelBuffer::CHANNEL_DATA5;
+	// Voxels to check, per column of blocks
+	StdUnorderedMap<Vector2i, Box3i> _pending_columns;
+	mutable BinaryMutex _mutex;
+	std::shared_ptr<Output> _output;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_BLOCKY_LIGHTING_H
@@ -0,0 +1,255 @@
+#include "blocky_random_tick.h"
+#include "../meshers/blocky/voxel_blocky_library_base.h"
+#include "../storage/voxel_data.h"
+#include "../util/godot/core/random_pcg.h"
+#include "../util/profiling.h"
+#include <cmath>
+#include <limits>
+
+#ifdef ZN_GODOT_EXTENSION
+using namespace godot;
+#endif
+
+namespace zylann::voxel {
+
+void BlockyRandomTickIndex::mark_blocks_dirty(Box3i block_box) {
+	MutexLock mlock(_mutex);
+	if (_blocks.size() == 0) {
+		return;
+	}
+	if (Vector3iUtil::get_volume(block_box.size) > static_cast<int64_t>(_blocks.size())) {
+		for (auto it = _blocks.begin(); it != _blocks.end(); ++it) {
+			if (block_box.contains(it->first)) {
+				it->second.dirty = true;
+			}
+		}
+	} else {
+		block_box.for_each_cell_zxy([this](Vector3i bpos) {
+			auto it = _blocks.find(bpos);
+			if (it != _blocks.end()) {
+				it->second.dirty = true;
+			}
+		});
+	}
+}
+
+void BlockyRandomTickIndex::mark_block_dirty(Vector3i bpos) {
+	MutexLock mlock(_mutex);
+	auto it = _blocks.find(bpos);
+	if (it != _blocks.end()) {
+		it->second.dirty = true;
+	}
+}
+
+void BlockyRandomTickIndex::remove_block(Vector3i bpos) {
+	MutexLock mlock(_mutex);
+	_blocks.erase(bpos);
+}
+
+void BlockyRandomTickIndex::clear() {
+	MutexLock mlock(_mutex);
+	_blocks.clear();
+	_library = nullptr;
+}
+
+void BlockyRandomTickIndex::update_library(const VoxelBlockyLibraryBase &library) {
+	// The library may be baked again on another thread
+	RWLockRead rlock(library.get_baked_data_rw_lock());
+	const VoxelBlockyLibraryBase::BakedData &lib_data = library.get_baked_data();
+
+	if (_library == &library && _library_bake_version == lib_data.bake_version) {
+		return;
+	}
+
+	// Different library or rebaked, indexed blocks are no longer valid
+	_library = &library;
+	_library_bake_version = lib_data.bake_version;
+	_blocks.clear();
+
+	_tickable_models.resize_no_init(lib_data.models.size());
+	for (unsigned int i = 0; i < lib_data.models.size(); ++i) {
+		_tickable_models.set(i, lib_data.models[i].is_random_tickable);
+	}
+}
+
+namespace {
+
+template <typename T>
+void find_tickable_voxels(Span<const T> type_ids, const DynamicBitset &tickable_models, StdVector<uint16_t> &dst) {
+	const unsigned int model_count = tickable_models.size();
+	for (unsigned int i = 0; i < type_ids.size(); ++i) {
+		const T v = type_ids[i];
+		if (v < model_count && tickable_models.get(v)) {
+			dst.push_back(i);
+		}
+	}
+}
+
+} // namespace
+
+Span<const uint16_t> BlockyRandomTickIndex::get_tickable_indices(
+		Vector3i bpos,
+		const std::shared_ptr<VoxelBuffer> &voxels_ptr,
+		const VoxelBlockyLibraryBase &library
+) {
+	update_library(library);
+
+	Block &block = _blocks[bpos];
+
+	// Owner comparison, to avoid keeping a stale index if the block got a new buffer without being marked dirty
+	const bool same_voxels = !block.voxels.owner_before(voxels_ptr) && !voxels_ptr.owner_before(block.voxels);
+
+	if (!block.dirty && same_voxels) {
+		return to_span(block.tickable_indices);
+	}
+
+	ZN_PROFILE_SCOPE();
+
+	const VoxelBuffer &voxels = *voxels_ptr;
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+	const unsigned int volume = Vector3iUtil::get_volume(voxels.get_size());
+	ZN_ASSERT_RETURN_V(volume <= std::numeric_limits<uint16_t>::max() + 1, Span<const uint16_t>());
+
+	block.tickable_indices.clear();
+	block.voxels = voxels_ptr;
+	block.dirty = false;
+
+	if (voxels.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_UNIFORM) {
+		const uint64_t v = voxels.get_voxel(0, 0, 0, channel);
+		if (v < _tickable_models.size() && _tickable_models.get(v)) {
+			block.tickable_indices.resize(volume);
+			for (unsigned int i = 0; i < volume; ++i) {
+				block.tickable_indices[i] = i;
+			}
+		}
+		return to_span(block.tickable_indices);
+	}
+
+	switch (voxels.get_channel_depth(channel)) {
+		case VoxelBuffer::DEPTH_8_BIT: {
+			Span<const uint8_t> type_ids;
+			ZN_ASSERT(voxels.get_channel_data_read_only(channel, type_ids));
+			find_tickable_voxels(type_ids, _tickable_models, block.tickable_indices);
+		} break;
+
+		case VoxelBuffer::DEPTH_16_BIT: {
+			Span<const uint16_t> type_ids;
+			ZN_ASSERT(voxels.get_channel_data_read_only(channel, type_ids));
+			find_tickable_voxels(type_ids, _tickable_models, block.tickable_indices);
+		} break;
+
+		default:
+			// Blocky libraries don't support more than 16-bit IDs
+			ZN_PRINT_ERROR("Unsupported depth for random ticks");
+			break;
+	}
+
+	return to_span(block.tickable_indices);
+}
+
+void run_blocky_random_tick_batched(
+		VoxelData &data,
+		Box3i voxel_box,
+		const VoxelBlockyLibraryBase &lib,
+		BlockyRandomTickIndex &index,
+		RandomPCG &random,
+		int voxel_count,
+		int batch_count,
+		void *callback_data,
+		bool (*callback)(void *, Span<const Vector3i>, Span<const uint32_t>)
+) {
+	ZN_PROFILE_SCOPE();
+
+	ERR_FAIL_COND(batch_count <= 0);
+	ERR_FAIL_COND(voxel_count < 0);
+	ERR_FAIL_COND(!math::is_valid_size(voxel_box.size));
+	ERR_FAIL_COND(callback == nullptr);
+
+	constexpr unsigned int lod_index = 0;
+
+	const unsigned int block_size = data.get_block_size();
+	const Box3i block_box = voxel_box.downscaled(block_size);
+
+	const int block_count = voxel_count / batch_count;
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	static thread_local StdVector<Vector3i> tls_positions;
+	static thread_local StdVector<uint32_t> tls_types;
+	// Tickable voxels within the area, when a block is only partially covered
+	static thread_local StdVector<uint16_t> tls_clipped_indices;
+
+	const float block_volume = math::cubed(block_size);
+
+	for (int bi = 0; bi < block_count; ++bi) {
+		const Vector3i block_pos = block_box.position +
+				Vector3i(random.rand(block_box.size.x), random.rand(block_box.size.y), random.rand(block_box.size.z));
+
+		const Vector3i block_origin = data.block_to_voxel(block_pos);
+
+		tls_positions.clear();
+		tls_types.clear();
+
+		{
+			SpatialLock3D &spatial_lock = data.get_spatial_lock(lod_index);
+			SpatialLock3D::Read srlock(spatial_lock, BoxBounds3i::from_position(block_pos));
+
+			std::shared_ptr<VoxelBuffer> voxels_ptr = data.try_get_block_voxels(block_pos);
+			if (voxels_ptr == nullptr) {
+				continue;
+			}
+			const VoxelBuffer &voxels = *voxels_ptr;
+
+			MutexLock index_lock(index._mutex);
+
+			Span<const uint16_t> tickable_indices = index.get_tickable_indices(block_pos, voxels_ptr, lib);
+			if (tickable_indices.size() == 0) {
+				continue;
+			}
+
+			const Box3i block_voxel_box(block_origin, Vector3iUtil::create(block_size));
+			Box3i local_voxel_box = voxel_box.clipped(block_voxel_box);
+			local_voxel_box.position -= block_origin;
+			const float volume_ratio = Vector3iUtil::get_volume(local_voxel_box.size) / block_volume;
+			// How many voxels `run_blocky_random_tick` would sample in this block
+			const int local_batch_count = std::ceil(batch_count * volume_ratio);
+
+			if (local_voxel_box.size != voxels.get_size()) {
+				tls_clipped_indices.clear();
+				const Vector3i size = voxels.get_size();
+				for (const uint16_t i : tickable_indices) {
+					if (local_voxel_box.contains(Vector3iUtil::from_zxy_index(i, size))) {
+						tls_clipped_indices.push_back(i);
+					}
+				}
+				tickable_indices = to_span(tls_clipped_indices);
+				if (tickable_indices.size() == 0) {
+					continue;
+				}
+			}
+
+			// Uniform sampling of the area would hit tickable voxels this many times on average. Pick that many
+			// among tickable voxels directly, rounding randomly so the average is preserved.
+			const float expected_hits = local_batch_count * float(tickable_indices.size()) /
+					float(Vector3iUtil::get_volume(local_voxel_box.size));
+			int hit_count = static_cast<int>(expected_hits);
+			if (random.randf() < expected_hits - hit_count) {
+				++hit_count;
+			}
+
+			for (int hi = 0; hi < hit_count; ++hi) {
+				const uint16_t i = tickable_indices[random.rand(tickable_indices.size())];
+				const Vector3i rpos = Vector3iUtil::from_zxy_index(i, voxels.get_size());
+				const uint64_t v = voxels.get_voxel(rpos, channel);
+				tls_positions.push_back(block_origin + rpos);
+				tls_types.push_back(v);
+			}
+		}
+
+		// The callback may read and write voxels, so nothing must be locked at this point.
+		if (tls_positions.size() > 0) {
+			ERR_FAIL_COND(!callback(callback_data, to_span(tls_positions), to_span(tls_types)));
+		}
+	}
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,89 @@
+#ifndef VOXEL_BLOCKY_RANDOM_TICK_H
+#define VOXEL_BLOCKY_RANDOM_TICK_H
+
+#include "../util/containers/dynamic_bitset.h"
+#include "../util/containers/span.h"
+#include "../util/containers/std_unordered_map.h"
+#include "../util/containers/std_vector.h"
+#include "../util/godot/macros.h"
+#include "../util/math/box3i.h"
+#include "../util/thread/mutex.h"
+#include <memory>
+
+ZN_GODOT_FORWARD_DECLARE(class RandomPCG);
+
+namespace zylann::voxel {
+
+class VoxelBuffer;
+class VoxelData;
+class VoxelBlockyLibraryBase;
+
+// Keeps track of which voxels of loaded blocks are random-tickable according to a blocky library, so random ticks only
+// sample voxels that can react to them, instead of picking voxels at random and discarding most of them.
+// Blocks are indexed the first time they are sampled, and indexed again after they get written to.
+class BlockyRandomTickIndex {
+public:
+	// Must be called when voxels of blocks are modified or replaced. Indexing is deferred to the next tick.
+	void mark_blocks_dirty(Box3i block_box);
+	void mark_block_dirty(Vector3i bpos);
+	void remove_block(Vector3i bpos);
+	void clear();
+
+	struct Block {
+		// Local ZXY indices of voxels having a random-tickable type. Data blocks are small enough for 16 bits.
+		StdVector<uint16_t> tickable_indices;
+		// Buffer the index was built from. If the block gets a different buffer, it is indexed again.
+		std::weak_ptr<VoxelBuffer> voxels;
+		bool dirty = true;
+	};
+
+private:
+	friend void run_blocky_random_tick_batched(
+			VoxelData &,
+			Box3i,
+			const VoxelBlockyLibraryBase &,
+			BlockyRandomTickIndex &,
+			RandomPCG &,
+			int,
+			int,
+			void *,
+			bool (*)(void *, Span<const Vector3i>, Span<const uint32_t>)
+	);
+
+	// Gets tickable voxels of a block, indexing it if needed. Voxels must be locked for reading, and the mutex must be
+	// locked.
+	Span<const uint16_t> get_tickable_indices(
+			Vector3i bpos,
+			const std::shared_ptr<VoxelBuffer> &voxels_ptr,
+			const VoxelBlockyLibraryBase &library
+	);
+
+	void update_library(const VoxelBlockyLibraryBase &library);
+
+	StdUnorderedMap<Vector3i, Block> _blocks;
+	// Which model IDs are tickable in the library blocks were indexed with
+	DynamicBitset _tickable_models;
+	const VoxelBlockyLibraryBase *_library = nullptr;
+	uint32_t _library_bake_version = 0;
+	BinaryMutex _mutex;
+};
+
+// Random tick where only random-tickable voxels are sampled, using an index of where they are in each block.
+// Each voxel has the same chance to be picked as with `run_blocky_random_tick`, but voxels that can't tick cost
+// nothing. Instead of one call per voxel, `callback` is called once per block with world positions and types of the
+// voxels that got a tick. It is called outside of locks, so it may edit the terrain.
+void run_blocky_random_tick_batched(
+		VoxelData &data,
+		Box3i voxel_box,
+		const VoxelBlockyLibraryBase &lib,
+		BlockyRandomTickIndex &index,
+		RandomPCG &random,
+		int voxel_count,
+		int batch_count,
+		void *callback_data,
+		bool (*callback)(void *, Span<const Vector3i> positions, Span<const uint32_t> types)
+);
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_BLOCKY_RANDOM_TICK_H
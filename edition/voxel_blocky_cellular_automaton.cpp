@@ -0,0 +1,718 @@
+#include "voxel_blocky_cellular_automaton.h"
+#include "../constants/voxel_string_names.h"
+#include "../engine/voxel_engine.h"
+#include "../terrain/fixed_lod/voxel_terrain.h"
+#include "../util/containers/container_funcs.h"
+#include "../util/godot/core/array.h"
+#include "../util/math/conv.h"
+#include "../util/profiling.h"
+#include "../util/string/format.h"
+#include "../util/tasks/parallel_for.h"
+#include "../util/thread/thread.h"
+#include <limits>
+
+namespace zylann::voxel {
+
+namespace {
+
+// How far voxels can influence each other in one step. A voxel can only receive a flow from a neighbor if no other
+// fluid competes for it, which needs to look at neighbors of neighbors.
+constexpr int HALO = 2;
+
+// Small fluid flows alternate directions each step, so a block that did not change in one step could still change in
+// the next ones
+constexpr uint8_t IDLE_STEPS_BEFORE_SLEEP = 4;
+
+// Model of voxels in blocks that aren't loaded. They are solid so it is never written, but it must not be mistaken for
+// a model that exists, like model 0 which is often air.
+constexpr uint16_t UNLOADED_MODEL = std::numeric_limits<uint16_t>::max();
+
+// Below this amount of active blocks per task, spawning threaded tasks costs more than it saves
+constexpr unsigned int MIN_BLOCKS_PER_TASK = 4;
+
+struct CellularAutomatonBlockResult {
+	StdVector<uint16_t> changed_indices;
+	StdVector<uint16_t> changed_values;
+	// In voxels, relative to the block
+	Box3i changed_box;
+	// True if the block has no voxels to simulate
+	bool missing = false;
+};
+
+// Padded copy of the voxels of a block, decoded into states. Only read during a step.
+class CellularAutomatonGrid {
+public:
+	struct State {
+		uint16_t model;
+		CellularAutomatonRules::Kind kind;
+		uint8_t fluid_index;
+		uint8_t level;
+	};
+
+	// Returns false if the block has no voxels
+	bool load(
+			const VoxelData &data,
+			Vector3i bpos,
+			const CellularAutomatonRules &rules,
+			StdVector<std::shared_ptr<VoxelBuffer>> &neighbor_voxels
+	);
+
+	void compute(
+			const CellularAutomatonRules &rules,
+			uint32_t step_index,
+			CellularAutomatonBlockResult &out_result
+	) const;
+
+private:
+	// Level of the voxel if it were filled with fluid `fi`. -1 if it can't contain that fluid.
+	inline int get_level_as(unsigned int i, uint8_t fi) const {
+		const State &s = _states[i];
+		if (s.kind == CellularAutomatonRules::KIND_EMPTY) {
+			return 0;
+		}
+		if (s.kind == CellularAutomatonRules::KIND_FLUID && s.fluid_index == fi) {
+			return s.level;
+		}
+		return -1;
+	}
+
+	// Amount of fluid flowing from a voxel into the voxel below it
+	inline int get_down_flow(const CellularAutomatonRules &rules, unsigned int i) const {
+		const State &s = _states[i];
+		if (s.kind != CellularAutomatonRules::KIND_FLUID) {
+			return 0;
+		}
+		const int below_level = get_level_as(i - _stride_y, s.fluid_index);
+		if (below_level < 0) {
+			return 0;
+		}
+		const int max_level = rules.fluids[s.fluid_index].get_max_level();
+		return math::min(int(s.level), max_level - below_level);
+	}
+
+	// Tests if something enters the voxel from above, in which case nothing can enter it sideways
+	inline bool receives_from_above(const CellularAutomatonRules &rules, unsigned int i) const {
+		const unsigned int above_i = i + _stride_y;
+		const State &above = _states[above_i];
+		if (above.kind == CellularAutomatonRules::KIND_FALLING) {
+			return _states[i].kind == CellularAutomatonRules::KIND_EMPTY;
+		}
+		return get_down_flow(rules, above_i) > 0;
+	}
+
+	// Amount of fluid flowing sideways from voxel `src` into voxel `dst`, located in horizontal direction `dir`
+	int get_side_flow(
+			const CellularAutomatonRules &rules,
+			unsigned int src,
+			unsigned int dst,
+			unsigned int dir,
+			uint32_t step_index
+	) const;
+
+	StdVector<State> _states;
+	// Size of one side of the padded grid
+	int _size = 0;
+	unsigned int _stride_y = 1;
+	unsigned int _stride_x = 0;
+	unsigned int _stride_z = 0;
+	// Offsets to horizontal neighbors. `_side_offsets[d]` and `_side_offsets[d ^ 1]` are opposite.
+	FixedArray<int, 4> _side_offsets;
+};
+
+bool CellularAutomatonGrid::load(
+		const VoxelData &data,
+		Vector3i bpos,
+		const CellularAutomatonRules &rules,
+		StdVector<std::shared_ptr<VoxelBuffer>> &neighbor_voxels
+) {
+	const int block_size = data.get_block_size();
+	_size = block_size + 2 * HALO;
+	const Vector3i grid_size = Vector3iUtil::create(_size);
+
+	// ZXY order, like voxel buffers
+	_stride_y = 1;
+	_stride_x = _size;
+	_stride_z = _size * _size;
+	_side_offsets[0] = _stride_x;
+	_side_offsets[1] = -int(_stride_x);
+	_side_offsets[2] = _stride_z;
+	_side_offsets[3] = -int(_stride_z);
+
+	_states.resize(Vector3iUtil::get_volume(grid_size));
+
+	const Box3i neighbors_box(bpos - Vector3i(1, 1, 1), Vector3i(3, 3, 3));
+	neighbor_voxels.clear();
+	neighbor_voxels.resize(Vector3iUtil::get_volume(neighbors_box.size));
+	data.get_blocks_with_voxel_data(neighbors_box, 0, to_span(neighbor_voxels));
+
+	// Center of the 3x3x3 area
+	if (neighbor_voxels[13] == nullptr) {
+		return false;
+	}
+
+	const Box3i grid_box(data.block_to_voxel(bpos) - Vector3iUtil::create(HALO), grid_size);
+
+	// This is where voxels from neighbor blocks are exchanged. They are all copied before anything gets written.
+	SpatialLock3D::Read srlock(data.get_spatial_lock(0), BoxBounds3i(neighbors_box));
+
+	unsigned int neighbor_index = 0;
+	neighbors_box.for_each_cell_zxy([this, &data, &rules, &neighbor_voxels, &neighbor_index, &grid_box, block_size](
+											Vector3i npos
+									) {
+		const VoxelBuffer *voxels = neighbor_voxels[neighbor_index].get();
+		++neighbor_index;
+
+		const Vector3i block_origin = data.block_to_voxel(npos);
+		const Box3i area = Box3i(block_origin, Vector3iUtil::create(block_size)).clipped(grid_box);
+		const Vector3i grid_size = grid_box.size;
+
+		area.for_each_cell_zxy([this, voxels, &rules, &block_origin, &grid_box, &grid_size](Vector3i pos) {
+			State &state = _states[Vector3iUtil::get_zxy_index(pos - grid_box.position, grid_size)];
+			if (voxels == nullptr) {
+				// Not loaded, or not editable. Nothing can enter or leave.
+				state.model = UNLOADED_MODEL;
+				state.kind = CellularAutomatonRules::KIND_SOLID;
+				state.fluid_index = 0;
+				state.level = 0;
+			} else {
+				const uint32_t model = voxels->get_voxel(pos - block_origin, VoxelBuffer::CHANNEL_TYPE);
+				const CellularAutomatonRules::Cell cell = rules.get_cell(model);
+				state.model = model;
+				state.kind = cell.kind;
+				state.fluid_index = cell.fluid_index;
+				state.level = cell.level;
+			}
+		});
+	});
+
+	return true;
+}
+
+int CellularAutomatonGrid::get_side_flow(
+		const CellularAutomatonRules &rules,
+		unsigned int src,
+		unsigned int dst,
+		unsigned int dir,
+		uint32_t step_index
+) const {
+	const State &s = _states[src];
+	if (s.kind != CellularAutomatonRules::KIND_FLUID) {
+		return 0;
+	}
+	// Fluid only spreads once it can't go down
+	if (get_down_flow(rules, src) > 0) {
+		return 0;
+	}
+	const int dst_level = get_level_as(dst, s.fluid_index);
+	if (dst_level < 0) {
+		return 0;
+	}
+	if (receives_from_above(rules, dst)) {
+		return 0;
+	}
+	if (_states[dst].kind == CellularAutomatonRules::KIND_EMPTY) {
+		// Several fluids could enter the same empty voxel. The one with the lowest index wins.
+		for (unsigned int d = 0; d < _side_offsets.size(); ++d) {
+			const State &ns = _states[dst + _side_offsets[d]];
+			if (ns.kind == CellularAutomatonRules::KIND_FLUID && ns.fluid_index < s.fluid_index) {
+				return 0;
+			}
+		}
+	}
+	const int diff = int(s.level) - dst_level;
+	if (diff <= 0) {
+		return 0;
+	}
+	// Sending a quarter of the difference to each side can never take more than the voxel contains, nor fill
+	// a voxel beyond its maximum level.
+	const int flow = diff / 4;
+	if (flow == 0 && diff >= 2 && dir == step_index % 4) {
+		// Small differences are evened out one unit at a time, in a single direction per step so a voxel never
+		// receives more than one such unit. Directions alternate each step.
+		return 1;
+	}
+	return flow;
+}
+
+void CellularAutomatonGrid::compute(
+		const CellularAutomatonRules &rules,
+		uint32_t step_index,
+		CellularAutomatonBlockResult &out_result
+) const {
+	const int block_size = _size - 2 * HALO;
+	const Vector3i block_size3 = Vector3iUtil::create(block_size);
+	const Vector3i grid_size = Vector3iUtil::create(_size);
+	const Vector3i halo3 = Vector3iUtil::create(HALO);
+
+	out_result.changed_indices.clear();
+	out_result.changed_values.clear();
+
+	Vector3i changed_min;
+	Vector3i changed_max;
+
+	Vector3i rpos;
+	for (rpos.z = 0; rpos.z < block_size; ++rpos.z) {
+		for (rpos.x = 0; rpos.x < block_size; ++rpos.x) {
+			for (rpos.y = 0; rpos.y < block_size; ++rpos.y) {
+				const unsigned int i = Vector3iUtil::get_zxy_index(rpos + halo3, grid_size);
+				const State &s = _states[i];
+
+				uint16_t new_model = s.model;
+
+				switch (s.kind) {
+					case CellularAutomatonRules::KIND_SOLID:
+						break;
+
+					case CellularAutomatonRules::KIND_FALLING:
+						if (_states[i - _stride_y].kind == CellularAutomatonRules::KIND_EMPTY) {
+							new_model = rules.empty_model;
+						}
+						break;
+
+					case CellularAutomatonRules::KIND_EMPTY: {
+						const State &above = _states[i + _stride_y];
+						if (above.kind == CellularAutomatonRules::KIND_FALLING) {
+							new_model = above.model;
+							break;
+						}
+						int level = get_down_flow(rules, i + _stride_y);
+						uint8_t fluid_index = above.fluid_index;
+						if (level == 0) {
+							for (unsigned int dir = 0; dir < _side_offsets.size(); ++dir) {
+								// Neighbor on the opposite side of `dir` flows in direction `dir`
+								const unsigned int src = i + _side_offsets[dir ^ 1];
+								const int flow = get_side_flow(rules, src, i, dir, step_index);
+								if (flow > 0) {
+									level += flow;
+									fluid_index = _states[src].fluid_index;
+								}
+							}
+						}
+						if (level > 0) {
+							new_model = rules.fluids[fluid_index].level_models[level];
+						}
+					} break;
+
+					case CellularAutomatonRules::KIND_FLUID: {
+						int level = s.level;
+						level -= get_down_flow(rules, i);
+						if (_states[i + _stride_y].kind == CellularAutomatonRules::KIND_FLUID &&
+							_states[i + _stride_y].fluid_index == s.fluid_index) {
+							level += get_down_flow(rules, i + _stride_y);
+						}
+						for (unsigned int dir = 0; dir < _side_offsets.size(); ++dir) {
+							level -= get_side_flow(rules, i, i + _side_offsets[dir], dir, step_index);
+							level += get_side_flow(rules, i + _side_offsets[dir ^ 1], i, dir, step_index);
+						}
+#ifdef DEBUG_ENABLED
+						ZN_ASSERT(level >= 0 && level <= int(rules.fluids[s.fluid_index].get_max_level()));
+#endif
+						if (level == 0) {
+							new_model = rules.empty_model;
+						} else {
+							new_model = rules.fluids[s.fluid_index].level_models[level];
+						}
+					} break;
+
+					default:
+						ZN_PRINT_ERROR("Unhandled cell kind");
+						break;
+				}
+
+				if (new_model != s.model) {
+					if (out_result.changed_indices.size() == 0) {
+						changed_min = rpos;
+						changed_max = rpos;
+					} else {
+						changed_min = math::min(changed_min, rpos);
+						changed_max = math::max(changed_max, rpos);
+					}
+					out_result.changed_indices.push_back(Vector3iUtil::get_zxy_index(rpos, block_size3));
+					out_result.changed_values.push_back(new_model);
+				}
+			}
+		}
+	}
+
+	if (out_result.changed_indices.size() > 0) {
+		out_result.changed_box = Box3i::from_min_max(changed_min, changed_max + Vector3i(1, 1, 1));
+	}
+}
+
+void compute_cellular_automaton_block(
+		const VoxelData &data,
+		const CellularAutomatonRules &rules,
+		uint32_t step_index,
+		Vector3i bpos,
+		CellularAutomatonBlockResult &result
+) {
+	ZN_PROFILE_SCOPE();
+
+	static thread_local CellularAutomatonGrid tls_grid;
+	static thread_local StdVector<std::shared_ptr<VoxelBuffer>> tls_neighbor_voxels;
+
+	if (tls_grid.load(data, bpos, rules, tls_neighbor_voxels)) {
+		tls_grid.compute(rules, step_index, result);
+	} else {
+		result.missing = true;
+	}
+
+	// Don't hold references to voxels longer than needed
+	tls_neighbor_voxels.clear();
+}
+
+} // namespace
+
+void CellularAutomaton::set_rules(std::shared_ptr<const CellularAutomatonRules> rules) {
+	_rules = rules;
+}
+
+void CellularAutomaton::mark_blocks_active(Box3i blocks_box) {
+	blocks_box.for_each_cell_zxy([this](Vector3i bpos) { //
+		_active_blocks[bpos] = 0;
+	});
+}
+
+void CellularAutomaton::mark_area_active(Box3i voxel_box, unsigned int block_size) {
+	// Voxels can be influenced by other voxels up to the halo distance
+	mark_blocks_active(voxel_box.padded(HALO).downscaled(block_size));
+}
+
+void CellularAutomaton::clear_active_blocks() {
+	_active_blocks.clear();
+}
+
+void CellularAutomaton::step(
+		const std::shared_ptr<VoxelData> &data,
+		unsigned int max_helper_tasks,
+		StdVector<Box3i> &out_modified_voxel_boxes
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(data != nullptr);
+	ZN_ASSERT_RETURN(_rules != nullptr);
+
+	if (_active_blocks.size() == 0) {
+		return;
+	}
+
+	const unsigned int block_size = data->get_block_size();
+	ZN_ASSERT_RETURN_MSG(
+			math::cubed(block_size) <= std::numeric_limits<uint16_t>::max() + 1, "Block size is too large"
+	);
+
+	StdVector<Vector3i> blocks;
+	StdVector<uint8_t> idle_step_counts;
+	blocks.reserve(_active_blocks.size());
+	idle_step_counts.reserve(_active_blocks.size());
+	for (auto it = _active_blocks.begin(); it != _active_blocks.end(); ++it) {
+		blocks.push_back(it->first);
+		idle_step_counts.push_back(it->second);
+	}
+	_active_blocks.clear();
+
+	const unsigned int block_count = blocks.size();
+	// One per block
+	StdVector<CellularAutomatonBlockResult> results;
+	results.resize(block_count);
+
+	const CellularAutomatonRules &rules = *_rules;
+	const uint32_t step_index = _step_index;
+
+	parallel_for(
+			block_count,
+			MIN_BLOCKS_PER_TASK,
+			max_helper_tasks,
+			[](Span<IThreadedTask *> tasks) { VoxelEngine::get_singleton().push_async_tasks(tasks); },
+			[&data, &rules, step_index, &blocks, &results](unsigned int block_index) {
+				compute_cellular_automaton_block(*data, rules, step_index, blocks[block_index], results[block_index]);
+			}
+	);
+
+	// All results are computed, now apply them.
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+	const Vector3i block_size3 = Vector3iUtil::create(block_size);
+	SpatialLock3D &spatial_lock = data->get_spatial_lock(0);
+
+	for (unsigned int block_index = 0; block_index < block_count; ++block_index) {
+		const CellularAutomatonBlockResult &result = results[block_index];
+		if (result.changed_indices.size() == 0) {
+			continue;
+		}
+
+		const Vector3i bpos = blocks[block_index];
+		{
+			SpatialLock3D::Write swlock(spatial_lock, BoxBounds3i::from_position(bpos));
+			std::shared_ptr<VoxelBuffer> voxels = data->try_get_block_voxels(bpos);
+			if (voxels == nullptr) {
+				// Got unloaded in the meantime
+				continue;
+			}
+			for (unsigned int i = 0; i < result.changed_indices.size(); ++i) {
+				const Vector3i rpos = Vector3iUtil::from_zxy_index(result.changed_indices[i], block_size3);
+				voxels->set_voxel(result.changed_values[i], rpos, channel);
+			}
+		}
+
+		const Box3i changed_box(data->block_to_voxel(bpos) + result.changed_box.position, result.changed_box.size);
+		out_modified_voxel_boxes.push_back(changed_box);
+
+		// Voxels around changes may change in the next step
+		mark_area_active(changed_box, block_size);
+	}
+
+	for (unsigned int block_index = 0; block_index < block_count; ++block_index) {
+		const CellularAutomatonBlockResult &result = results[block_index];
+		const uint8_t idle_step_count = idle_step_counts[block_index] + 1;
+		if (result.changed_indices.size() == 0 && !result.missing && idle_step_count < IDLE_STEPS_BEFORE_SLEEP) {
+			// Doesn't replace the entry if changes nearby activated the block again
+			_active_blocks.insert({ blocks[block_index], idle_step_count });
+		}
+	}
+
+	++_step_index;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+bool contains_name(const StdVector<StringName> &names, const StringName &name) {
+	for (const StringName &n : names) {
+		if (n == name) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+VoxelBlockyCellularAutomaton::VoxelBlockyCellularAutomaton() {
+	_empty_type = VoxelStringNames::get_singleton().air;
+}
+
+void VoxelBlockyCellularAutomaton::set_library(Ref<VoxelBlockyTypeLibrary> library) {
+	_library = library;
+	_rules_dirty = true;
+}
+
+Ref<VoxelBlockyTypeLibrary> VoxelBlockyCellularAutomaton::get_library() const {
+	return _library;
+}
+
+void VoxelBlockyCellularAutomaton::set_empty_type(StringName type_name) {
+	_empty_type = type_name;
+	_rules_dirty = true;
+}
+
+StringName VoxelBlockyCellularAutomaton::get_empty_type() const {
+	return _empty_type;
+}
+
+void VoxelBlockyCellularAutomaton::add_falling_type(StringName type_name) {
+	ZN_ASSERT_RETURN(!contains_name(_falling_types, type_name));
+	_falling_types.push_back(type_name);
+	_rules_dirty = true;
+}
+
+void VoxelBlockyCellularAutomaton::add_fluid_type(StringName type_name, StringName level_attribute) {
+	for (const FluidType &ft : _fluid_types) {
+		ZN_ASSERT_RETURN(ft.type_name != type_name);
+	}
+	ZN_ASSERT_RETURN_MSG(_fluid_types.size() < 256, "Too many fluid types");
+	_fluid_types.push_back(FluidType{ type_name, level_attribute });
+	_rules_dirty = true;
+}
+
+void VoxelBlockyCellularAutomaton::clear_types() {
+	_falling_types.clear();
+	_fluid_types.clear();
+	_rules_dirty = true;
+}
+
+void VoxelBlockyCellularAutomaton::mark_area_active(Box3i voxel_box) {
+	_pending_active_areas.push_back(voxel_box);
+}
+
+void VoxelBlockyCellularAutomaton::clear_active_blocks() {
+	_pending_active_areas.clear();
+	_automaton.clear_active_blocks();
+}
+
+int VoxelBlockyCellularAutomaton::get_active_block_count() const {
+	return _automaton.get_active_block_count();
+}
+
+bool VoxelBlockyCellularAutomaton::update_rules() {
+	ZN_ASSERT_RETURN_V_MSG(_library.is_valid(), false, "No library was assigned");
+
+	const VoxelBlockyTypeLibrary &library = **_library;
+	unsigned int model_count = 0;
+	uint32_t bake_version = 0;
+	{
+		RWLockRead rlock(library.get_baked_data_rw_lock());
+		const VoxelBlockyLibraryBase::BakedData &lib_data = library.get_baked_data();
+		model_count = lib_data.models.size();
+		bake_version = lib_data.bake_version;
+	}
+
+	// Types can be edited without changing the number of models, so the library is compared by bake
+	if (!_rules_dirty && bake_version == _rules_bake_version) {
+		return true;
+	}
+
+	ZN_PROFILE_SCOPE();
+
+	std::shared_ptr<CellularAutomatonRules> rules = make_shared_instance<CellularAutomatonRules>();
+
+	const int empty_model = library.get_model_index_default(_empty_type);
+	ZN_ASSERT_RETURN_V_MSG(
+			empty_model >= 0, false, format("Empty type \"{}\" was not found in the library", String(_empty_type))
+	);
+	rules->empty_model = empty_model;
+
+	rules->fluids.resize(_fluid_types.size());
+	rules->cells.resize(model_count);
+
+	for (unsigned int model_index = 0; model_index < model_count; ++model_index) {
+		const Array name_and_attributes = library.get_type_name_and_attributes_from_model_index(model_index);
+		if (name_and_attributes.size() != 2) {
+			continue;
+		}
+		const StringName type_name = name_and_attributes[0];
+		CellularAutomatonRules::Cell &cell = rules->cells[model_index];
+
+		if (type_name == _empty_type) {
+			cell.kind = CellularAutomatonRules::KIND_EMPTY;
+			continue;
+		}
+
+		if (contains_name(_falling_types, type_name)) {
+			cell.kind = CellularAutomatonRules::KIND_FALLING;
+			continue;
+		}
+
+		for (unsigned int fluid_index = 0; fluid_index < _fluid_types.size(); ++fluid_index) {
+			const FluidType &ft = _fluid_types[fluid_index];
+			if (ft.type_name != type_name) {
+				continue;
+			}
+			const Dictionary attributes = name_and_attributes[1];
+			const Variant level_v = attributes.get(ft.level_attribute, Variant());
+			ZN_ASSERT_CONTINUE_MSG(
+					level_v.get_type() == Variant::INT,
+					format("Type \"{}\" has no attribute \"{}\"", String(type_name), String(ft.level_attribute))
+			);
+			// Attribute values start from 0, but level 0 is empty
+			const int level = int(level_v) + 1;
+			ZN_ASSERT_CONTINUE(level < 256);
+
+			cell.kind = CellularAutomatonRules::KIND_FLUID;
+			cell.fluid_index = fluid_index;
+			cell.level = level;
+
+			CellularAutomatonRules::Fluid &fluid = rules->fluids[fluid_index];
+			if (int(fluid.level_models.size()) <= level) {
+				fluid.level_models.resize(level + 1, 0);
+			}
+			// If the type has other attributes, several models can have the same level. The first one is used when
+			// levels change.
+			if (fluid.level_models[level] == 0) {
+				fluid.level_models[level] = model_index;
+			}
+			break;
+		}
+	}
+
+	for (unsigned int fluid_index = 0; fluid_index < rules->fluids.size(); ++fluid_index) {
+		CellularAutomatonRules::Fluid &fluid = rules->fluids[fluid_index];
+		const FluidType &ft = _fluid_types[fluid_index];
+		ZN_ASSERT_RETURN_V_MSG(
+				fluid.level_models.size() > 1,
+				false,
+				format("Fluid type \"{}\" was not found in the library", String(ft.type_name))
+		);
+		fluid.level_models[0] = rules->empty_model;
+		for (unsigned int level = 1; level < fluid.level_models.size(); ++level) {
+			ZN_ASSERT_RETURN_V_MSG(
+					fluid.level_models[level] != 0,
+					false,
+					format("Fluid type \"{}\" has no model for level {}", String(ft.type_name), level)
+			);
+		}
+	}
+
+	_automaton.set_rules(rules);
+	_rules_dirty = false;
+	_rules_bake_version = bake_version;
+	return true;
+}
+
+int VoxelBlockyCellularAutomaton::step(VoxelTerrain *terrain) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(terrain != nullptr, 0);
+
+	if (!update_rules()) {
+		return 0;
+	}
+
+	std::shared_ptr<VoxelData> data = terrain->get_storage_shared();
+	ZN_ASSERT_RETURN_V(data != nullptr, 0);
+
+	const unsigned int block_size = data->get_block_size();
+	for (const Box3i &voxel_box : _pending_active_areas) {
+		_automaton.mark_area_active(voxel_box, block_size);
+	}
+	_pending_active_areas.clear();
+
+	const unsigned int max_helper_tasks = math::max(Thread::get_hardware_concurrency(), 2u) - 1;
+
+	_modified_boxes.clear();
+	_automaton.step(data, max_helper_tasks, _modified_boxes);
+
+	// Same path as edits done with VoxelTool, so changes get remeshed, saved and replicated
+	for (const Box3i &box : _modified_boxes) {
+		terrain->post_edit_area(box, true);
+	}
+
+	return _modified_boxes.size();
+}
+
+void VoxelBlockyCellularAutomaton::_b_mark_area_active(AABB voxel_area) {
+	mark_area_active(Box3i(math::floor_to_int(voxel_area.position), math::floor_to_int(voxel_area.size)));
+}
+
+void VoxelBlockyCellularAutomaton::_bind_methods() {
+	using Self = VoxelBlockyCellularAutomaton;
+
+	ClassDB::bind_method(D_METHOD("set_library", "library"), &Self::set_library);
+	ClassDB::bind_method(D_METHOD("get_library"), &Self::get_library);
+
+	ClassDB::bind_method(D_METHOD("set_empty_type", "type_name"), &Self::set_empty_type);
+	ClassDB::bind_method(D_METHOD("get_empty_type"), &Self::get_empty_type);
+
+	ClassDB::bind_method(D_METHOD("add_falling_type", "type_name"), &Self::add_falling_type);
+	ClassDB::bind_method(D_METHOD("add_fluid_type", "type_name", "level_attribute"), &Self::add_fluid_type);
+	ClassDB::bind_method(D_METHOD("clear_types"), &Self::clear_types);
+
+	ClassDB::bind_method(D_METHOD("mark_area_active", "voxel_area"), &Self::_b_mark_area_active);
+	ClassDB::bind_method(D_METHOD("clear_active_blocks"), &Self::clear_active_blocks);
+	ClassDB::bind_method(D_METHOD("get_active_block_count"), &Self::get_active_block_count);
+
+	ClassDB::bind_method(D_METHOD("step", "terrain"), &Self::step);
+
+	ADD_PROPERTY(
+			PropertyInfo(
+					Variant::OBJECT,
+					"library",
+					PROPERTY_HINT_RESOURCE_TYPE,
+					VoxelBlockyTypeLibrary::get_class_static(),
+					PROPERTY_USAGE_NO_EDITOR
+			),
+			"set_library",
+			"get_library"
+	);
+	ADD_PROPERTY(PropertyInfo(Variant::STRING_NAME, "empty_type"), "set_empty_type", "get_empty_type");
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,159 @@
+#ifndef VOXEL_BLOCKY_CELLULAR_AUTOMATON_H
+#define VOXEL_BLOCKY_CELLULAR_AUTOMATON_H
+
+#include "../meshers/blocky/types/voxel_blocky_type_library.h"
+#include "../storage/voxel_data.h"
+#include "../util/containers/std_unordered_map.h"
+#include "../util/containers/std_vector.h"
+#include "../util/godot/classes/ref_counted.h"
+#include "../util/math/box3i.h"
+#include <memory>
+
+namespace zylann::voxel {
+
+class VoxelTerrain;
+
+// Describes how each model ID of a blocky library behaves in a `CellularAutomaton`.
+struct CellularAutomatonRules {
+	enum Kind : uint8_t {
+		// Never changes, and blocks anything else
+		KIND_SOLID = 0,
+		// Can be replaced by falling voxels or fluids
+		KIND_EMPTY,
+		// Falls straight down into empty voxels
+		KIND_FALLING,
+		// Flows down and spreads sideways into empty voxels or voxels of the same fluid with a lower level
+		KIND_FLUID
+	};
+
+	struct Cell {
+		Kind kind = KIND_SOLID;
+		uint8_t fluid_index = 0;
+		// For fluids, from 1 to the maximum level of the fluid
+		uint8_t level = 0;
+	};
+
+	struct Fluid {
+		// Model ID for each level. Index 0 is unused, empty voxels are used instead.
+		StdVector<uint16_t> level_models;
+
+		inline unsigned int get_max_level() const {
+			return level_models.size() - 1;
+		}
+	};
+
+	// Indexed by model ID. IDs beyond the end are solid.
+	StdVector<Cell> cells;
+	StdVector<Fluid> fluids;
+	// Model ID written where voxels become empty
+	uint16_t empty_model = 0;
+
+	inline Cell get_cell(uint32_t model_id) const {
+		if (model_id < cells.size()) {
+			return cells[model_id];
+		}
+		return Cell();
+	}
+};
+
+// Simulates falling voxels and fluids on the TYPE channel of `VoxelData`, one data block at a time.
+//
+// Only active blocks are processed. A block becomes inactive after a few steps without changes, and blocks are
+// activated again when voxels near them change. Each step reads voxels of all active blocks with a halo of voxels from
+// neighbor blocks, and computes new states in separate buffers, so blocks can be processed in parallel and results
+// don't depend on processing order. Changes are written to `VoxelData` once all blocks are processed.
+//
+// Fluid levels are conserved: every flow of a voxel is computed the same way by the voxel it leaves and by the voxel
+// it enters.
+class CellularAutomaton {
+public:
+	void set_rules(std::shared_ptr<const CellularAutomatonRules> rules);
+
+	inline const CellularAutomatonRules *get_rules() const {
+		return _rules.get();
+	}
+
+	void mark_blocks_active(Box3i blocks_box);
+	// Activates blocks containing voxels which may change after voxels of the given area were modified. This should be
+	// called after edits, so the simulation resumes around them.
+	void mark_area_active(Box3i voxel_box, unsigned int block_size);
+	void clear_active_blocks();
+
+	inline unsigned int get_active_block_count() const {
+		return _active_blocks.size();
+	}
+
+	// Runs one step over all active blocks. Up to `max_helper_tasks` threaded tasks may be spawned to process blocks
+	// in parallel, the calling thread takes part in the work too and returns when all blocks are done.
+	// Boxes of voxels that changed are added to `out_modified_voxel_boxes`, one per modified block.
+	void step(
+			const std::shared_ptr<VoxelData> &data,
+			unsigned int max_helper_tasks,
+			StdVector<Box3i> &out_modified_voxel_boxes
+	);
+
+	inline uint32_t get_step_index() const {
+		return _step_index;
+	}
+
+private:
+	std::shared_ptr<const CellularAutomatonRules> _rules;
+	// Value is how many steps in a row did not change the block
+	StdUnorderedMap<Vector3i, uint8_t> _active_blocks;
+	uint32_t _step_index = 0;
+};
+
+// Godot-facing API. Rules are set per type of a `VoxelBlockyTypeLibrary`.
+class VoxelBlockyCellularAutomaton : public RefCounted {
+	GDCLASS(VoxelBlockyCellularAutomaton, RefCounted)
+public:
+	VoxelBlockyCellularAutomaton();
+
+	void set_library(Ref<VoxelBlockyTypeLibrary> library);
+	Ref<VoxelBlockyTypeLibrary> get_library() const;
+
+	void set_empty_type(StringName type_name);
+	StringName get_empty_type() const;
+
+	void add_falling_type(StringName type_name);
+	void add_fluid_type(StringName type_name, StringName level_attribute);
+	void clear_types();
+
+	void mark_area_active(Box3i voxel_box);
+	void clear_active_blocks();
+	int get_active_block_count() const;
+
+	// Runs one step and sends modified areas to the terrain, so they get remeshed and saved like other edits.
+	// Returns how many blocks were modified.
+	int step(VoxelTerrain *terrain);
+
+private:
+	bool update_rules();
+
+	void _b_mark_area_active(AABB voxel_area);
+
+	static void _bind_methods();
+
+	struct FluidType {
+		StringName type_name;
+		StringName level_attribute;
+	};
+
+	Ref<VoxelBlockyTypeLibrary> _library;
+	StringName _empty_type;
+	StdVector<StringName> _falling_types;
+	StdVector<FluidType> _fluid_types;
+	bool _rules_dirty = true;
+	// Bake version of the library rules were built from
+	uint32_t _rules_bake_version = 0;
+
+	// Areas activated before we know the block size of the terrain
+	StdVector<Box3i> _pending_active_areas;
+
+	CellularAutomaton _automaton;
+	StdVector<Box3i> _modified_boxes;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_BLOCKY_CELLULAR_AUTOMATON_H
@@ -0,0 +1,936 @@
+#include "voxel_collision_query.h"
+#include "../engine/voxel_engine.h"
+#include "../meshers/blocky/voxel_mesher_blocky.h"
+#include "../meshers/cubes/voxel_mesher_cubes.h"
+#include "../storage/voxel_buffer.h"
+#include "../storage/voxel_data.h"
+#include "../terrain/fixed_lod/voxel_terrain.h"
+#include "../terrain/variable_lod/voxel_lod_terrain.h"
+#include "../util/godot/classes/node.h"
+#include "../util/math/box3i.h"
+#include "../util/math/conv.h"
+#include "../util/profiling.h"
+#include "../util/tasks/parallel_for.h"
+#include "../util/thread/thread.h"
+#include <limits>
+
+namespace zylann::voxel {
+
+void CollisionQuerySource::set_blocky_library(const VoxelBlockyLibraryBase &library) {
+	RWLockRead rlock(library.get_baked_data_rw_lock());
+	const VoxelBlockyLibraryBase::BakedData &lib_data = library.get_baked_data();
+
+	type = TYPE_BLOCKY;
+	blocky_models.resize(lib_data.models.size());
+	blocky_boxes.clear();
+
+	for (unsigned int i = 0; i < lib_data.models.size(); ++i) {
+		const VoxelBlockyModel::BakedData &model_data = lib_data.models[i];
+		BlockyModel &model = blocky_models[i];
+		model.collision_mask = model_data.box_collision_mask;
+		model.first_box = blocky_boxes.size();
+		model.box_count = model_data.box_collision_aabbs.size();
+		for (const AABB &box : model_data.box_collision_aabbs) {
+			blocky_boxes.push_back(box);
+		}
+	}
+}
+
+namespace collision_queries {
+namespace {
+
+// Queries reading more voxels than this are split, or considered blocked if they can't be
+constexpr unsigned int MAX_QUERY_VOLUME = 64 * 64 * 64;
+// Long sweeps are split into at most this many segments, each reading its own voxels
+constexpr unsigned int MAX_SWEEP_SEGMENTS = 256;
+// Distance under which the moving shape advances by fixed steps instead of distance to the closest obstacle, in
+// voxels. Thinner features can be missed when grazing along a surface.
+constexpr real_t MIN_STEP = 0.05;
+// Shapes going this much deeper into obstacles than where they started are considered colliding. Allows touching
+// shapes to slide along surfaces despite precision errors.
+constexpr real_t PENETRATION_TOLERANCE = 0.0001;
+constexpr unsigned int MAX_SWEEP_ITERATIONS = 1024;
+constexpr unsigned int BISECTION_ITERATIONS = 16;
+constexpr unsigned int SEGMENT_SEARCH_ITERATIONS = 24;
+// Shapes are sampled at this interval when testing against SDF voxels
+constexpr real_t SDF_SAMPLING_STEP = 0.5;
+
+// Swept-sphere-box: a box of half-extents `half_extents` moved along the segment from `a` to `b`, inflated by `radius`.
+// It covers AABBs, spheres and capsules.
+struct QueryShape {
+	Vector3 a;
+	Vector3 b;
+	Vector3 half_extents;
+	real_t radius = 0;
+
+	static QueryShape from_aabb(AABB box) {
+		QueryShape shape;
+		shape.half_extents = 0.5 * box.size;
+		shape.a = box.position + shape.half_extents;
+		shape.b = shape.a;
+		return shape;
+	}
+
+	static QueryShape from_capsule(Vector3 a, Vector3 b, real_t radius) {
+		QueryShape shape;
+		shape.a = a;
+		shape.b = b;
+		shape.radius = radius;
+		return shape;
+	}
+
+	AABB get_bounds() const {
+		const Vector3 r = half_extents + Vector3(radius, radius, radius);
+		const Vector3 min_pos(math::min(a.x, b.x), math::min(a.y, b.y), math::min(a.z, b.z));
+		const Vector3 max_pos(math::max(a.x, b.x), math::max(a.y, b.y), math::max(a.z, b.z));
+		return AABB(min_pos - r, max_pos - min_pos + 2 * r);
+	}
+
+	QueryShape translated(Vector3 offset) const {
+		QueryShape shape = *this;
+		shape.a += offset;
+		shape.b += offset;
+		return shape;
+	}
+};
+
+// Voxels read to collide with something within `bounds`
+Box3i get_environment_box(AABB bounds) {
+	// Padded so boxes of blocky models going out of their voxel and SDF interpolation are accounted for
+	const Vector3i min_pos = math::floor_to_int(bounds.position) - Vector3i(1, 1, 1);
+	const Vector3i max_pos = math::floor_to_int(bounds.position + bounds.size) + Vector3i(2, 2, 2);
+	return Box3i::from_min_max(min_pos, max_pos);
+}
+
+inline bool fits_in_query(AABB bounds) {
+	return Vector3iUtil::get_volume(get_environment_box(bounds).size) <= MAX_QUERY_VOLUME;
+}
+
+// Bounds covered by a shape moving from its position by `motion`
+inline AABB get_swept_bounds(const QueryShape &shape, Vector3 motion) {
+	const AABB bounds = shape.get_bounds();
+	return bounds.merge(AABB(bounds.position + motion, bounds.size));
+}
+
+// What can be collided with around a query, read from voxels
+struct Environment {
+	CollisionQuerySource::Type type;
+	// Solid boxes, for blocky and cubes sources
+	StdVector<AABB> boxes;
+	// SDF values for SDF sources, in ZXY order
+	StdVector<float> sdf;
+	Vector3i origin;
+	Vector3i size;
+
+	inline float get_sdf(int x, int y, int z) const {
+		return sdf[Vector3iUtil::get_zxy_index(Vector3i(x, y, z), size)];
+	}
+
+	real_t get_sdf_interpolated(Vector3 pos) const {
+		const Vector3 rpos = pos - Vector3(origin);
+		// Environments always have at least 2 voxels on each axis
+		const int x0 = math::clamp(int(Math::floor(rpos.x)), 0, size.x - 2);
+		const int y0 = math::clamp(int(Math::floor(rpos.y)), 0, size.y - 2);
+		const int z0 = math::clamp(int(Math::floor(rpos.z)), 0, size.z - 2);
+		const real_t fx = math::clamp(rpos.x - x0, real_t(0), real_t(1));
+		const real_t fy = math::clamp(rpos.y - y0, real_t(0), real_t(1));
+		const real_t fz = math::clamp(rpos.z - z0, real_t(0), real_t(1));
+
+		const real_t v000 = get_sdf(x0, y0, z0);
+		const real_t v100 = get_sdf(x0 + 1, y0, z0);
+		const real_t v010 = get_sdf(x0, y0 + 1, z0);
+		const real_t v110 = get_sdf(x0 + 1, y0 + 1, z0);
+		const real_t v001 = get_sdf(x0, y0, z0 + 1);
+		const real_t v101 = get_sdf(x0 + 1, y0, z0 + 1);
+		const real_t v011 = get_sdf(x0, y0 + 1, z0 + 1);
+		const real_t v111 = get_sdf(x0 + 1, y0 + 1, z0 + 1);
+
+		const real_t v00 = Math::lerp(v000, v100, fx);
+		const real_t v10 = Math::lerp(v010, v110, fx);
+		const real_t v01 = Math::lerp(v001, v101, fx);
+		const real_t v11 = Math::lerp(v011, v111, fx);
+		return Math::lerp(Math::lerp(v00, v10, fy), Math::lerp(v01, v11, fy), fz);
+	}
+};
+
+// Reads voxels around `bounds` and turns them into what can be collided with.
+bool load_environment(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		AABB bounds,
+		Environment &env
+) {
+	ZN_PROFILE_SCOPE();
+
+	const Box3i box = get_environment_box(bounds);
+	const Vector3i min_pos = box.position;
+	const Vector3i size = box.size;
+
+	ZN_ASSERT_RETURN_V_MSG(
+			Vector3iUtil::get_volume(size) <= MAX_QUERY_VOLUME,
+			false,
+			"Collision query is too large, it should be split into smaller ones"
+	);
+
+	env.type = source.type;
+	env.origin = min_pos;
+	env.size = size;
+	env.boxes.clear();
+	env.sdf.clear();
+
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+	voxels.create(size);
+
+	Vector3i rpos;
+
+	switch (source.type) {
+		case CollisionQuerySource::TYPE_SDF: {
+			const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_SDF;
+			data.copy(min_pos, voxels, 1 << channel);
+			env.sdf.resize(Vector3iUtil::get_volume(size));
+			unsigned int i = 0;
+			for (rpos.z = 0; rpos.z < size.z; ++rpos.z) {
+				for (rpos.x = 0; rpos.x < size.x; ++rpos.x) {
+					for (rpos.y = 0; rpos.y < size.y; ++rpos.y) {
+						env.sdf[i] = voxels.get_voxel_f(rpos, channel);
+						++i;
+					}
+				}
+			}
+		} break;
+
+		case CollisionQuerySource::TYPE_BLOCKY: {
+			const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+			data.copy(min_pos, voxels, 1 << channel);
+			for (rpos.z = 0; rpos.z < size.z; ++rpos.z) {
+				for (rpos.x = 0; rpos.x < size.x; ++rpos.x) {
+					for (rpos.y = 0; rpos.y < size.y; ++rpos.y) {
+						const uint32_t model_id = voxels.get_voxel(rpos, channel);
+						if (model_id >= source.blocky_models.size()) {
+							continue;
+						}
+						const CollisionQuerySource::BlockyModel &model = source.blocky_models[model_id];
+						if ((model.collision_mask & collision_mask) == 0) {
+							continue;
+						}
+						const Vector3 model_origin(min_pos + rpos);
+						for (unsigned int bi = 0; bi < model.box_count; ++bi) {
+							AABB box = source.blocky_boxes[model.first_box + bi];
+							box.position += model_origin;
+							env.boxes.push_back(box);
+						}
+					}
+				}
+			}
+		} break;
+
+		case CollisionQuerySource::TYPE_CUBES: {
+			const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_COLOR;
+			data.copy(min_pos, voxels, 1 << channel);
+			for (rpos.z = 0; rpos.z < size.z; ++rpos.z) {
+				for (rpos.x = 0; rpos.x < size.x; ++rpos.x) {
+					for (rpos.y = 0; rpos.y < size.y; ++rpos.y) {
+						if (voxels.get_voxel(rpos, channel) != 0) {
+							env.boxes.push_back(AABB(Vector3(min_pos + rpos), Vector3(1, 1, 1)));
+						}
+					}
+				}
+			}
+		} break;
+
+		default:
+			ZN_PRINT_ERROR("Unhandled collision source type");
+			return false;
+	}
+
+	return true;
+}
+
+// Negative inside the box
+inline real_t get_point_box_signed_distance(Vector3 p, Vector3 box_min, Vector3 box_max) {
+	const Vector3 center = 0.5 * (box_min + box_max);
+	const Vector3 extents = 0.5 * (box_max - box_min);
+	const Vector3 q = (p - center).abs() - extents;
+	const Vector3 outside(math::max(q.x, real_t(0)), math::max(q.y, real_t(0)), math::max(q.z, real_t(0)));
+	return outside.length() + math::min(math::max(q.x, math::max(q.y, q.z)), real_t(0));
+}
+
+// Lower bound of the signed distance between any two points of the boxes
+inline real_t get_box_box_signed_distance(Vector3 min0, Vector3 max0, Vector3 min1, Vector3 max1) {
+	return get_point_box_signed_distance(0.5 * (min0 + max0), min1 - 0.5 * (max0 - min0), max1 + 0.5 * (max0 - min0));
+}
+
+// Points away from the box
+Vector3 get_point_box_normal(Vector3 p, Vector3 box_min, Vector3 box_max) {
+	const Vector3 closest( //
+			math::clamp(p.x, box_min.x, box_max.x),
+			math::clamp(p.y, box_min.y, box_max.y),
+			math::clamp(p.z, box_min.z, box_max.z)
+	);
+	const Vector3 diff = p - closest;
+	const real_t diff_length = diff.length();
+	if (diff_length > 0.000001) {
+		return diff / diff_length;
+	}
+	// Inside, use the closest face
+	const Vector3 center = 0.5 * (box_min + box_max);
+	const Vector3 q = (p - center).abs() - 0.5 * (box_max - box_min);
+	int axis = Vector3::AXIS_X;
+	if (q.y > q[axis]) {
+		axis = Vector3::AXIS_Y;
+	}
+	if (q.z > q[axis]) {
+		axis = Vector3::AXIS_Z;
+	}
+	Vector3 normal;
+	normal[axis] = p[axis] < center[axis] ? -1 : 1;
+	return normal;
+}
+
+struct ClosestBox {
+	unsigned int index = 0;
+	// Point of the segment of the shape closest to the box
+	Vector3 point;
+};
+
+real_t get_signed_distance_to_boxes(
+		Span<const AABB> boxes,
+		const QueryShape &shape,
+		Vector3 offset,
+		ClosestBox *out_closest = nullptr
+) {
+	const Vector3 a = shape.a + offset;
+	const Vector3 b = shape.b + offset;
+	const Vector3 segment_min(math::min(a.x, b.x), math::min(a.y, b.y), math::min(a.z, b.z));
+	const Vector3 segment_max(math::max(a.x, b.x), math::max(a.y, b.y), math::max(a.z, b.z));
+	const bool is_segment = !a.is_equal_approx(b);
+
+	real_t min_distance = std::numeric_limits<real_t>::max();
+
+	for (unsigned int box_index = 0; box_index < boxes.size(); ++box_index) {
+		const AABB &box = boxes[box_index];
+		// The moving box is accounted for by growing obstacles instead (Minkowski sum)
+		const Vector3 box_min = box.position - shape.half_extents;
+		const Vector3 box_max = box.position + box.size + shape.half_extents;
+
+		Vector3 point = a;
+
+		if (is_segment) {
+			// Skip boxes that can't be closer than what was already found
+			if (get_box_box_signed_distance(segment_min, segment_max, box_min, box_max) >= min_distance) {
+				continue;
+			}
+
+			// Distance to a convex shape along a segment is convex, so it has only one minimum
+			real_t t0 = 0;
+			real_t t1 = 1;
+			for (unsigned int i = 0; i < SEGMENT_SEARCH_ITERATIONS; ++i) {
+				const real_t ta = Math::lerp(t0, t1, real_t(1.0 / 3.0));
+				const real_t tb = Math::lerp(t0, t1, real_t(2.0 / 3.0));
+				const real_t da = get_point_box_signed_distance(a.lerp(b, ta), box_min, box_max);
+				const real_t db = get_point_box_signed_distance(a.lerp(b, tb), box_min, box_max);
+				if (da < db) {
+					t1 = tb;
+				} else {
+					t0 = ta;
+				}
+			}
+			point = a.lerp(b, 0.5 * (t0 + t1));
+		}
+
+		const real_t d = get_point_box_signed_distance(point, box_min, box_max);
+
+		if (d < min_distance) {
+			min_distance = d;
+			if (out_closest != nullptr) {
+				out_closest->index = box_index;
+				out_closest->point = point;
+			}
+		}
+	}
+
+	return min_distance - shape.radius;
+}
+
+// Approximated by sampling the shape, so features of the SDF thinner than the sampling step can be missed.
+// Optionally gives the position of the sample closest to matter.
+real_t get_signed_distance_to_sdf(
+		const Environment &env,
+		const QueryShape &shape,
+		Vector3 offset,
+		Vector3 *out_closest_position = nullptr
+) {
+	const Vector3 a = shape.a + offset;
+	const Vector3 b = shape.b + offset;
+
+	const unsigned int segment_steps = Math::ceil(a.distance_to(b) / SDF_SAMPLING_STEP);
+	const Vector3i box_steps( //
+			Math::ceil(2 * shape.half_extents.x / SDF_SAMPLING_STEP),
+			Math::ceil(2 * shape.half_extents.y / SDF_SAMPLING_STEP),
+			Math::ceil(2 * shape.half_extents.z / SDF_SAMPLING_STEP)
+	);
+	const Vector3 box_step_size( //
+			box_steps.x > 0 ? 2 * shape.half_extents.x / box_steps.x : 0,
+			box_steps.y > 0 ? 2 * shape.half_extents.y / box_steps.y : 0,
+			box_steps.z > 0 ? 2 * shape.half_extents.z / box_steps.z : 0
+	);
+
+	real_t min_sd = std::numeric_limits<real_t>::max();
+
+	for (unsigned int si = 0; si <= segment_steps; ++si) {
+		const Vector3 center = segment_steps > 0 ? a.lerp(b, real_t(si) / segment_steps) : a;
+		const Vector3 box_min = center - shape.half_extents;
+		Vector3i i;
+		for (i.z = 0; i.z <= box_steps.z; ++i.z) {
+			for (i.x = 0; i.x <= box_steps.x; ++i.x) {
+				for (i.y = 0; i.y <= box_steps.y; ++i.y) {
+					const Vector3 pos = box_min + Vector3(i) * box_step_size;
+					const real_t sd = env.get_sdf_interpolated(pos);
+					if (sd < min_sd) {
+						min_sd = sd;
+						if (out_closest_position != nullptr) {
+							*out_closest_position = pos;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return min_sd - shape.radius;
+}
+
+// Negative when the shape overlaps something
+real_t get_signed_distance(const Environment &env, const QueryShape &shape, Vector3 offset) {
+	if (env.type == CollisionQuerySource::TYPE_SDF) {
+		return get_signed_distance_to_sdf(env, shape, offset);
+	}
+	return get_signed_distance_to_boxes(to_span(env.boxes), shape, offset);
+}
+
+// Gets the direction in which the closest obstacle pushes the shape. Using only the closest obstacle avoids mixing
+// normals of other surfaces the shape is touching.
+Vector3 get_normal(const Environment &env, const QueryShape &shape, Vector3 offset, Vector3 motion) {
+	Vector3 gradient;
+
+	if (env.type == CollisionQuerySource::TYPE_SDF) {
+		const real_t h = 0.01;
+		Vector3 pos;
+		get_signed_distance_to_sdf(env, shape, offset, &pos);
+		gradient = Vector3( //
+				env.get_sdf_interpolated(pos + Vector3(h, 0, 0)) - env.get_sdf_interpolated(pos - Vector3(h, 0, 0)),
+				env.get_sdf_interpolated(pos + Vector3(0, h, 0)) - env.get_sdf_interpolated(pos - Vector3(0, h, 0)),
+				env.get_sdf_interpolated(pos + Vector3(0, 0, h)) - env.get_sdf_interpolated(pos - Vector3(0, 0, h))
+		);
+
+	} else {
+		ClosestBox closest;
+		get_signed_distance_to_boxes(to_span(env.boxes), shape, offset, &closest);
+		if (closest.index < env.boxes.size()) {
+			const AABB &box = env.boxes[closest.index];
+			gradient = get_point_box_normal(
+					closest.point, box.position - shape.half_extents, box.position + box.size + shape.half_extents
+			);
+		}
+	}
+
+	const real_t len = gradient.length();
+	if (len < 0.00001) {
+		// Flat spot of the distance field, such as deep inside a box
+		return -motion.normalized();
+	}
+	return gradient / len;
+}
+
+// Conservative advancement: the shape moves by its distance to the closest obstacle, which can't make it go through
+// anything. Close to obstacles, it moves by small fixed steps, so it can slide along surfaces it touches.
+bool sweep(const Environment &env, const QueryShape &shape, Vector3 motion, CollisionSweepResult &out_result) {
+	ZN_PROFILE_SCOPE();
+
+	const real_t motion_length = motion.length();
+	if (motion_length < 0.00001) {
+		return false;
+	}
+	const real_t min_step = MIN_STEP / motion_length;
+
+	real_t t = 0;
+	real_t d = get_signed_distance(env, shape, Vector3());
+	// Going out of an obstacle is allowed, going further into it is not
+	const real_t allowed_d = math::min(d, real_t(0));
+
+	for (unsigned int iteration = 0; iteration < MAX_SWEEP_ITERATIONS; ++iteration) {
+		if (d >= MIN_STEP) {
+			// Nothing can be closer than `d`
+			t += d / motion_length;
+			if (t >= 1) {
+				return false;
+			}
+			d = get_signed_distance(env, shape, motion * t);
+			continue;
+		}
+
+		const real_t next_t = math::min(t + min_step, real_t(1));
+		const real_t next_d = get_signed_distance(env, shape, motion * next_t);
+
+		if (next_d >= allowed_d - PENETRATION_TOLERANCE) {
+			if (next_t >= 1) {
+				return false;
+			}
+			t = next_t;
+			d = next_d;
+			continue;
+		}
+
+		// Hit something during the step, find where
+		real_t t0 = t;
+		real_t t1 = next_t;
+		for (unsigned int i = 0; i < BISECTION_ITERATIONS; ++i) {
+			const real_t mt = 0.5 * (t0 + t1);
+			if (get_signed_distance(env, shape, motion * mt) >= allowed_d) {
+				t0 = mt;
+			} else {
+				t1 = mt;
+			}
+		}
+
+		out_result.fraction = t0;
+		out_result.normal = get_normal(env, shape, motion * t1, motion);
+		return true;
+	}
+
+	// Took too long, stop here to stay on the safe side
+	out_result.fraction = t;
+	out_result.normal = -motion.normalized();
+	return true;
+}
+
+thread_local Environment tls_environment;
+
+// Used when a query can't run. Reporting a free path instead would let shapes go through anything.
+bool set_blocked_result(Vector3 motion, CollisionSweepResult &out_result) {
+	out_result.fraction = 0;
+	out_result.normal = -motion.normalized();
+	return true;
+}
+
+bool sweep(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		const QueryShape &shape,
+		Vector3 motion,
+		CollisionSweepResult &out_result
+) {
+	// Long motions are split into segments small enough for their voxels to be read at once
+	unsigned int segment_count = 1;
+	while (!fits_in_query(get_swept_bounds(shape, motion / real_t(segment_count)))) {
+		if (segment_count >= MAX_SWEEP_SEGMENTS) {
+			ZN_PRINT_ERROR("Collision sweep is too large, considering it blocked");
+			return set_blocked_result(motion, out_result);
+		}
+		segment_count *= 2;
+	}
+
+	const Vector3 segment_motion = motion / real_t(segment_count);
+	Environment &env = tls_environment;
+
+	for (unsigned int segment_index = 0; segment_index < segment_count; ++segment_index) {
+		const QueryShape segment_shape = shape.translated(motion * (real_t(segment_index) / segment_count));
+
+		const AABB bounds = get_swept_bounds(segment_shape, segment_motion);
+		if (!load_environment(data, source, collision_mask, bounds, env)) {
+			return set_blocked_result(motion, out_result);
+		}
+
+		CollisionSweepResult segment_result;
+		if (sweep(env, segment_shape, segment_motion, segment_result)) {
+			out_result.fraction = (segment_index + segment_result.fraction) / segment_count;
+			out_result.normal = segment_result.normal;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool overlaps(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		const QueryShape &shape
+) {
+	Environment &env = tls_environment;
+	if (!load_environment(data, source, collision_mask, shape.get_bounds(), env)) {
+		// Overlapping is the safe side when the query can't run
+		return true;
+	}
+	return get_signed_distance(env, shape, Vector3()) < -PENETRATION_TOLERANCE;
+}
+
+} // namespace
+
+bool sweep_aabb(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		AABB box,
+		Vector3 motion,
+		CollisionSweepResult &out_result
+) {
+	return sweep(data, source, collision_mask, QueryShape::from_aabb(box), motion, out_result);
+}
+
+bool sweep_sphere(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		Vector3 center,
+		real_t radius,
+		Vector3 motion,
+		CollisionSweepResult &out_result
+) {
+	return sweep(data, source, collision_mask, QueryShape::from_capsule(center, center, radius), motion, out_result);
+}
+
+bool sweep_capsule(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		Vector3 a,
+		Vector3 b,
+		real_t radius,
+		Vector3 motion,
+		CollisionSweepResult &out_result
+) {
+	return sweep(data, source, collision_mask, QueryShape::from_capsule(a, b, radius), motion, out_result);
+}
+
+bool overlaps_aabb(const VoxelData &data, const CollisionQuerySource &source, uint32_t collision_mask, AABB box) {
+	return overlaps(data, source, collision_mask, QueryShape::from_aabb(box));
+}
+
+bool overlaps_sphere(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		Vector3 center,
+		real_t radius
+) {
+	return overlaps(data, source, collision_mask, QueryShape::from_capsule(center, center, radius));
+}
+
+bool overlaps_capsule(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		Vector3 a,
+		Vector3 b,
+		real_t radius
+) {
+	return overlaps(data, source, collision_mask, QueryShape::from_capsule(a, b, radius));
+}
+
+} // namespace collision_queries
+
+// Godot API
+// -------------------------------------------------------------------------------------------------------------------
+
+real_t VoxelCollisionQueryResult::_b_get_fraction() const {
+	return fraction;
+}
+
+Vector3 VoxelCollisionQueryResult::_b_get_travel() const {
+	return travel;
+}
+
+Vector3 VoxelCollisionQueryResult::_b_get_normal() const {
+	return normal;
+}
+
+void VoxelCollisionQueryResult::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_fraction"), &VoxelCollisionQueryResult::_b_get_fraction);
+	ClassDB::bind_method(D_METHOD("get_travel"), &VoxelCollisionQueryResult::_b_get_travel);
+	ClassDB::bind_method(D_METHOD("get_normal"), &VoxelCollisionQueryResult::_b_get_normal);
+
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "fraction"), "", "get_fraction");
+	ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "travel"), "", "get_travel");
+	ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "normal"), "", "get_normal");
+}
+
+namespace {
+
+// Queries are claimed by threads in chunks of this size
+constexpr unsigned int QUERIES_PER_CHUNK = 8;
+// Below this amount of chunks per task, spawning threaded tasks costs more than it saves
+constexpr unsigned int MIN_CHUNKS_PER_TASK = 2;
+
+struct BatchSweepContext {
+	const VoxelData *data = nullptr;
+	const CollisionQuerySource *source = nullptr;
+	uint32_t collision_mask = 0;
+	// Relative to each position, in local space
+	AABB box;
+	real_t radius = 0;
+	bool is_sphere = false;
+	StdVector<Vector3> positions;
+	StdVector<Vector3> motions;
+	StdVector<float> fractions;
+
+	void run_chunk(unsigned int chunk_index) {
+		const unsigned int count = positions.size();
+		const unsigned int begin = chunk_index * QUERIES_PER_CHUNK;
+		const unsigned int end = math::min(begin + QUERIES_PER_CHUNK, count);
+
+		for (unsigned int i = begin; i < end; ++i) {
+			CollisionSweepResult result;
+			bool hit;
+			if (is_sphere) {
+				hit = collision_queries::sweep_sphere(
+						*data, *source, collision_mask, positions[i], radius, motions[i], result
+				);
+			} else {
+				hit = collision_queries::sweep_aabb(
+						*data,
+						*source,
+						collision_mask,
+						AABB(box.position + positions[i], box.size),
+						motions[i],
+						result
+				);
+			}
+			fractions[i] = hit ? result.fraction : 1.f;
+		}
+	}
+};
+
+} // namespace
+
+void VoxelCollisionQuery::set_terrain(VoxelNode &terrain) {
+	ZN_PROFILE_SCOPE();
+
+	VoxelTerrain *fixed_lod_terrain = Object::cast_to<VoxelTerrain>(&terrain);
+	VoxelLodTerrain *lod_terrain = Object::cast_to<VoxelLodTerrain>(&terrain);
+
+	if (fixed_lod_terrain != nullptr) {
+		_data = fixed_lod_terrain->get_storage_shared();
+	} else if (lod_terrain != nullptr) {
+		_data = lod_terrain->get_storage_shared();
+	} else {
+		ZN_PRINT_ERROR("Unsupported terrain type");
+		return;
+	}
+
+	std::shared_ptr<CollisionQuerySource> source = make_shared_instance<CollisionQuerySource>();
+
+	Ref<VoxelMesher> mesher = terrain.get_mesher();
+	Ref<VoxelMesherBlocky> mesher_blocky;
+	Ref<VoxelMesherCubes> mesher_cubes;
+
+	if (zylann::godot::try_get_as(mesher, mesher_blocky)) {
+		Ref<VoxelBlockyLibraryBase> library = mesher_blocky->get_library();
+		if (library.is_valid()) {
+			source->set_blocky_library(**library);
+		} else {
+			ZN_PRINT_WARNING("VoxelMesherBlocky has no library assigned, collision queries won't hit anything");
+			source->type = CollisionQuerySource::TYPE_BLOCKY;
+		}
+	} else if (zylann::godot::try_get_as(mesher, mesher_cubes)) {
+		source->type = CollisionQuerySource::TYPE_CUBES;
+	} else {
+		source->type = CollisionQuerySource::TYPE_SDF;
+	}
+
+	_source = source;
+
+	_to_world = terrain.get_global_transform();
+	_to_local = _to_world.affine_inverse();
+	_to_local_scale = math::max( //
+			_to_local.basis.get_column(Vector3::AXIS_X).length(),
+			math::max(
+					_to_local.basis.get_column(Vector3::AXIS_Y).length(),
+					_to_local.basis.get_column(Vector3::AXIS_Z).length()
+			)
+	);
+}
+
+void VoxelCollisionQuery::set_collision_mask(uint32_t mask) {
+	_collision_mask = mask;
+}
+
+uint32_t VoxelCollisionQuery::get_collision_mask() const {
+	return _collision_mask;
+}
+
+Ref<VoxelCollisionQueryResult> VoxelCollisionQuery::make_result(const CollisionSweepResult &result, Vector3 motion)
+		const {
+	Ref<VoxelCollisionQueryResult> res;
+	res.instantiate();
+	res->fraction = result.fraction;
+	res->travel = motion * result.fraction;
+	// Normals transform with the inverse transpose
+	res->normal = _to_local.basis.transposed().xform(result.normal).normalized();
+	return res;
+}
+
+Ref<VoxelCollisionQueryResult> VoxelCollisionQuery::sweep_aabb(AABB box, Vector3 motion) const {
+	ERR_FAIL_COND_V_MSG(_data == nullptr, Ref<VoxelCollisionQueryResult>(), "No terrain was set");
+	CollisionSweepResult result;
+	if (collision_queries::sweep_aabb(
+				*_data, *_source, _collision_mask, _to_local.xform(box), _to_local.basis.xform(motion), result
+		)) {
+		return make_result(result, motion);
+	}
+	return Ref<VoxelCollisionQueryResult>();
+}
+
+Ref<VoxelCollisionQueryResult> VoxelCollisionQuery::sweep_sphere(Vector3 center, real_t radius, Vector3 motion) const {
+	ERR_FAIL_COND_V_MSG(_data == nullptr, Ref<VoxelCollisionQueryResult>(), "No terrain was set");
+	CollisionSweepResult result;
+	if (collision_queries::sweep_sphere(
+				*_data,
+				*_source,
+				_collision_mask,
+				_to_local.xform(center),
+				radius * _to_local_scale,
+				_to_local.basis.xform(motion),
+				result
+		)) {
+		return make_result(result, motion);
+	}
+	return Ref<VoxelCollisionQueryResult>();
+}
+
+Ref<VoxelCollisionQueryResult> VoxelCollisionQuery::sweep_capsule(Vector3 a, Vector3 b, real_t radius, Vector3 motion)
+		const {
+	ERR_FAIL_COND_V_MSG(_data == nullptr, Ref<VoxelCollisionQueryResult>(), "No terrain was set");
+	CollisionSweepResult result;
+	if (collision_queries::sweep_capsule(
+				*_data,
+				*_source,
+				_collision_mask,
+				_to_local.xform(a),
+				_to_local.xform(b),
+				radius * _to_local_scale,
+				_to_local.basis.xform(motion),
+				result
+		)) {
+		return make_result(result, motion);
+	}
+	return Ref<VoxelCollisionQueryResult>();
+}
+
+bool VoxelCollisionQuery::overlaps_aabb(AABB box) const {
+	ERR_FAIL_COND_V_MSG(_data == nullptr, false, "No terrain was set");
+	return collision_queries::overlaps_aabb(*_data, *_source, _collision_mask, _to_local.xform(box));
+}
+
+bool VoxelCollisionQuery::overlaps_sphere(Vector3 center, real_t radius) const {
+	ERR_FAIL_COND_V_MSG(_data == nullptr, false, "No terrain was set");
+	return collision_queries::overlaps_sphere(
+			*_data, *_source, _collision_mask, _to_local.xform(center), radius * _to_local_scale
+	);
+}
+
+bool VoxelCollisionQuery::overlaps_capsule(Vector3 a, Vector3 b, real_t radius) const {
+	ERR_FAIL_COND_V_MSG(_data == nullptr, false, "No terrain was set");
+	return collision_queries::overlaps_capsule(
+			*_data, *_source, _collision_mask, _to_local.xform(a), _to_local.xform(b), radius * _to_local_scale
+	);
+}
+
+PackedFloat32Array VoxelCollisionQuery::sweep_batch(
+		const PackedVector3Array &positions,
+		AABB box,
+		real_t radius,
+		const PackedVector3Array &motions
+) const {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND_V_MSG(_data == nullptr, PackedFloat32Array(), "No terrain was set");
+	ERR_FAIL_COND_V_MSG(
+			positions.size() != motions.size(), PackedFloat32Array(), "Positions and motions must have the same size"
+	);
+
+	const unsigned int count = positions.size();
+	if (count == 0) {
+		return PackedFloat32Array();
+	}
+
+	BatchSweepContext ctx;
+	ctx.data = _data.get();
+	ctx.source = _source.get();
+	ctx.collision_mask = _collision_mask;
+	ctx.is_sphere = radius > 0;
+	ctx.radius = radius * _to_local_scale;
+	ctx.box = Transform3D(_to_local.basis, Vector3()).xform(box);
+	ctx.positions.resize(count);
+	ctx.motions.resize(count);
+	ctx.fractions.resize(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		ctx.positions[i] = _to_local.xform(positions[i]);
+		ctx.motions[i] = _to_local.basis.xform(motions[i]);
+	}
+
+	parallel_for(
+			math::ceildiv(count, QUERIES_PER_CHUNK),
+			MIN_CHUNKS_PER_TASK,
+			math::max(Thread::get_hardware_concurrency(), 2u) - 1,
+			[](Span<IThreadedTask *> tasks) { VoxelEngine::get_singleton().push_async_tasks(tasks); },
+			[&ctx](unsigned int chunk_index) { ctx.run_chunk(chunk_index); }
+	);
+
+	PackedFloat32Array fractions;
+	zylann::godot::copy_to(fractions, ctx.fractions);
+	return fractions;
+}
+
+PackedFloat32Array VoxelCollisionQuery::sweep_aabbs(
+		PackedVector3Array positions,
+		AABB box,
+		PackedVector3Array motions
+) const {
+	return sweep_batch(positions, box, 0, motions);
+}
+
+PackedFloat32Array VoxelCollisionQuery::sweep_spheres(
+		PackedVector3Array centers,
+		real_t radius,
+		PackedVector3Array motions
+) const {
+	ERR_FAIL_COND_V(radius <= 0, PackedFloat32Array());
+	return sweep_batch(centers, AABB(), radius, motions);
+}
+
+void VoxelCollisionQuery::_b_set_terrain(Node *node) {
+	VoxelNode *terrain = Object::cast_to<VoxelNode>(node);
+	ERR_FAIL_COND_MSG(terrain == nullptr, "Expected a voxel terrain node");
+	set_terrain(*terrain);
+}
+
+void VoxelCollisionQuery::_bind_methods() {
+	using Self = VoxelCollisionQuery;
+
+	ClassDB::bind_method(D_METHOD("set_terrain", "terrain"), &Self::_b_set_terrain);
+
+	ClassDB::bind_method(D_METHOD("set_collision_mask", "mask"), &Self::set_collision_mask);
+	ClassDB::bind_method(D_METHOD("get_collision_mask"), &Self::get_collision_mask);
+
+	ClassDB::bind_method(D_METHOD("sweep_aabb", "box", "motion"), &Self::sweep_aabb);
+	ClassDB::bind_method(D_METHOD("sweep_sphere", "center", "radius", "motion"), &Self::sweep_sphere);
+	ClassDB::bind_method(D_METHOD("sweep_capsule", "a", "b", "radius", "motion"), &Self::sweep_capsule);
+
+	ClassDB::bind_method(D_METHOD("overlaps_aabb", "box"), &Self::overlaps_aabb);
+	ClassDB::bind_method(D_METHOD("overlaps_sphere", "center", "radius"), &Self::overlaps_sphere);
+	ClassDB::bind_method(D_METHOD("overlaps_capsule", "a", "b", "radius"), &Self::overlaps_capsule);
+
+	ClassDB::bind_method(D_METHOD("sweep_aabbs", "positions", "box", "motions"), &Self::sweep_aabbs);
+	ClassDB::bind_method(D_METHOD("sweep_spheres", "centers", "radius", "motions"), &Self::sweep_spheres);
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "collision_mask", PROPERTY_HINT_LAYERS_3D_PHYSICS),
+			"set_collision_mask",
+			"get_collision_mask"
+	);
+}
+
+} // namespace zylann::voxel
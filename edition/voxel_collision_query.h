@@ -0,0 +1,171 @@
+#ifndef VOXEL_COLLISION_QUERY_H
+#define VOXEL_COLLISION_QUERY_H
+
+#include "../util/containers/std_vector.h"
+#include "../util/godot/classes/ref_counted.h"
+#include "../util/godot/core/packed_arrays.h"
+#include "../util/godot/macros.h"
+#include "../util/math/transform_3d.h"
+#include "../util/math/vector3.h"
+#include <memory>
+
+ZN_GODOT_FORWARD_DECLARE(class Node);
+
+namespace zylann::voxel {
+
+class VoxelData;
+class VoxelNode;
+class VoxelBlockyLibraryBase;
+
+// Describes what is solid in voxel data, the same way as colliders made by the mesher of a terrain.
+struct CollisionQuerySource {
+	enum Type : uint8_t {
+		// Matter is where the SDF channel is negative, interpolated between voxels
+		TYPE_SDF = 0,
+		// Collision boxes of blocky models, from the TYPE channel
+		TYPE_BLOCKY,
+		// Unit cubes where the COLOR channel is not zero
+		TYPE_CUBES
+	};
+
+	struct BlockyModel {
+		uint32_t collision_mask = 0;
+		uint32_t first_box = 0;
+		uint32_t box_count = 0;
+	};
+
+	Type type = TYPE_SDF;
+	// Indexed by model ID, only used with `TYPE_BLOCKY`
+	StdVector<BlockyModel> blocky_models;
+	StdVector<AABB> blocky_boxes;
+
+	void set_blocky_library(const VoxelBlockyLibraryBase &library);
+};
+
+struct CollisionSweepResult {
+	// Fraction of the motion the shape can do before touching something
+	real_t fraction = 1;
+	// Points away from what was hit
+	Vector3 normal;
+};
+
+// Native collision queries against voxel data, which don't need physics shapes.
+// Positions are in voxels, relative to the volume. Queries only read voxels, so they can run from any thread at once.
+// Long sweeps are split internally. Shapes too large to be queried are considered blocked or overlapping, so they
+// never go through anything.
+namespace collision_queries {
+
+// These return true if something was hit, in which case `out_result` is filled.
+bool sweep_aabb(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		AABB box,
+		Vector3 motion,
+		CollisionSweepResult &out_result
+);
+bool sweep_sphere(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		Vector3 center,
+		real_t radius,
+		Vector3 motion,
+		CollisionSweepResult &out_result
+);
+// A capsule is defined by the segment going through the center of its hemispheres
+bool sweep_capsule(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		Vector3 a,
+		Vector3 b,
+		real_t radius,
+		Vector3 motion,
+		CollisionSweepResult &out_result
+);
+
+bool overlaps_aabb(const VoxelData &data, const CollisionQuerySource &source, uint32_t collision_mask, AABB box);
+bool overlaps_sphere(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		Vector3 center,
+		real_t radius
+);
+bool overlaps_capsule(
+		const VoxelData &data,
+		const CollisionQuerySource &source,
+		uint32_t collision_mask,
+		Vector3 a,
+		Vector3 b,
+		real_t radius
+);
+
+} // namespace collision_queries
+
+class VoxelCollisionQueryResult : public RefCounted {
+	GDCLASS(VoxelCollisionQueryResult, RefCounted)
+public:
+	real_t fraction = 1;
+	Vector3 travel;
+	Vector3 normal;
+
+private:
+	real_t _b_get_fraction() const;
+	Vector3 _b_get_travel() const;
+	Vector3 _b_get_normal() const;
+
+	static void _bind_methods();
+};
+
+// Godot-facing API. Works with both `VoxelTerrain` and `VoxelLodTerrain`, in world space.
+// Queries can be called from any thread, and batched queries spread their work over threads of `VoxelEngine`.
+class VoxelCollisionQuery : public RefCounted {
+	GDCLASS(VoxelCollisionQuery, RefCounted)
+public:
+	// Takes what queries need from the terrain: its voxel data, how its mesher makes colliders, and its current
+	// transform. Must be called again if any of these change, and not while queries are running.
+	void set_terrain(VoxelNode &terrain);
+
+	void set_collision_mask(uint32_t mask);
+	uint32_t get_collision_mask() const;
+
+	Ref<VoxelCollisionQueryResult> sweep_aabb(AABB box, Vector3 motion) const;
+	Ref<VoxelCollisionQueryResult> sweep_sphere(Vector3 center, real_t radius, Vector3 motion) const;
+	Ref<VoxelCollisionQueryResult> sweep_capsule(Vector3 a, Vector3 b, real_t radius, Vector3 motion) const;
+
+	bool overlaps_aabb(AABB box) const;
+	bool overlaps_sphere(Vector3 center, real_t radius) const;
+	bool overlaps_capsule(Vector3 a, Vector3 b, real_t radius) const;
+
+	// Batched sweeps of the same shape from many positions. Return the fraction of each motion that can be done, which
+	// is 1 when nothing is hit.
+	PackedFloat32Array sweep_aabbs(PackedVector3Array positions, AABB box, PackedVector3Array motions) const;
+	PackedFloat32Array sweep_spheres(PackedVector3Array centers, real_t radius, PackedVector3Array motions) const;
+
+private:
+	Ref<VoxelCollisionQueryResult> make_result(const CollisionSweepResult &result, Vector3 motion) const;
+	PackedFloat32Array sweep_batch(
+			const PackedVector3Array &positions,
+			AABB box,
+			real_t radius,
+			const PackedVector3Array &motions
+	) const;
+
+	void _b_set_terrain(Node *node);
+
+	static void _bind_methods();
+
+	std::shared_ptr<VoxelData> _data;
+	std::shared_ptr<const CollisionQuerySource> _source;
+	Transform3D _to_world;
+	Transform3D _to_local;
+	// Radii can only be converted with a single scale, so the largest one is used
+	real_t _to_local_scale = 1;
+	uint32_t _collision_mask = 0xffffffff;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_COLLISION_QUERY_H
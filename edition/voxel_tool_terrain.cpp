@@ -10,6 +10,7 @@
 #include "../util/godot/core/packed_arrays.h"
 #include "../util/math/conv.h"
 #include "../util/voxel_raycast.h"
+#include "blocky_random_tick.h"
 
 using namespace zylann::godot;
 
@@ -408,6 +409,79 @@ void VoxelToolTerrain::run_blocky_random_tick(
 	zylann::voxel::run_blocky_random_tick(data, voxel_area, lib, _random, voxel_count, batch_count, callback);
 }
 
+void VoxelToolTerrain::run_blocky_random_tick_batched(
+		AABB voxel_area,
+		int voxel_count,
+		const Callable &callback,
+		int batch_count
+) {
+	ZN_PROFILE_SCOPE();
+
+	ERR_FAIL_COND(_terrain == nullptr);
+	ERR_FAIL_COND_MSG(
+			get_voxel_library(*_terrain).is_null(),
+			String("This function requires a volume using {0} with a valid library")
+					.format(varray(VoxelMesherBlocky::get_class_static()))
+	);
+	ERR_FAIL_COND(callback.is_null());
+	ERR_FAIL_COND(batch_count <= 0);
+	ERR_FAIL_COND(voxel_count < 0);
+	ERR_FAIL_COND(!math::is_valid_size(voxel_area.size));
+
+	if (voxel_count == 0) {
+		return;
+	}
+
+	const VoxelBlockyLibraryBase &lib = **get_voxel_library(*_terrain);
+	VoxelData &data = _terrain->get_storage();
+
+	struct CallbackData {
+		const Callable &callable;
+		PackedVector3Array positions;
+		PackedInt32Array types;
+	};
+	CallbackData cb_self{ callback, PackedVector3Array(), PackedInt32Array() };
+
+	const Box3i voxel_box(math::floor_to_int(voxel_area.position), math::floor_to_int(voxel_area.size));
+
+	zylann::voxel::run_blocky_random_tick_batched(
+			data,
+			voxel_box,
+			lib,
+			_terrain->get_random_tick_index(),
+			_random,
+			voxel_count,
+			batch_count,
+			&cb_self,
+			[](void *self, Span<const Vector3i> positions, Span<const uint32_t> types) {
+				CallbackData *cd = reinterpret_cast<CallbackData *>(self);
+
+				// One script call per block instead of one per voxel
+				cd->positions.resize(positions.size());
+				cd->types.resize(types.size());
+				for (unsigned int i = 0; i < positions.size(); ++i) {
+					cd->positions.set(i, Vector3(positions[i]));
+					cd->types.set(i, types[i]);
+				}
+
+#ifdef ZN_GODOT
+				const Variant vpositions = cd->positions;
+				const Variant vtypes = cd->types;
+				const Variant *args[2] = { &vpositions, &vtypes };
+				Callable::CallError error;
+				Variant retval; // We don't care about the return value, Callable API requires it
+				cd->callable.callp(args, 2, retval, error);
+				// Return if it fails, we don't want an error spam
+				ERR_FAIL_COND_V(error.error != Callable::CallError::CALL_OK, false);
+#elif ZN_GODOT_EXTENSION
+				// TODO GDX: No way to detect or report errors when calling a Callable. Do I need to?
+				cd->callable.call(cd->positions, cd->types);
+#endif
+				return true;
+			}
+	);
+}
+
 void VoxelToolTerrain::for_each_voxel_metadata_in_area(AABB voxel_area, const Callable &callback) {
 	ERR_FAIL_COND(_terrain == nullptr);
 	ERR_FAIL_COND(callback.is_null());
@@ -540,6 +614,11 @@ void VoxelToolTerrain::_bind_methods() {
 			&VoxelToolTerrain::run_blocky_random_tick,
 			DEFVAL(16)
 	);
+	ClassDB::bind_method(
+			D_METHOD("run_blocky_random_tick_batched", "area", "voxel_count", "callback", "batch_count"),
+			&VoxelToolTerrain::run_blocky_random_tick_batched,
+			DEFVAL(16)
+	);
 	ClassDB::bind_method(
 			D_METHOD("for_each_voxel_metadata_in_area", "voxel_area", "callback"),
 			&VoxelToolTerrain::for_each_voxel_metadata_in_area
@@ -52,6 +52,12 @@ public:
 	void do_hemisphere(Vector3 center, float radius, Vector3 flat_direction, float smoothness);
 
 	void run_blocky_random_tick(AABB voxel_area, int voxel_count, const Callable &callback, int block_batch_count);
+	void run_blocky_random_tick_batched(
+			AABB voxel_area,
+			int voxel_count,
+			const Callable &callback,
+			int block_batch_count
+	);
 
 	void for_each_voxel_metadata_in_area(AABB voxel_area, const Callable &callback);
 
@@ -10,55 +10,102 @@
 #include "../../util/math/triangle.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
+#include <limits>
 
 namespace zylann::voxel {
 
 namespace {
 
-void dilate_normalmap(Span<Vector3f> normals, Vector2i size) {
+// Normals of a tile, stored in separate planes of X, Y and Z components so they can be processed with vectorized loops.
+// There is a border of 1 pixel of zeros around the tile, so neighbors can be accessed without checking bounds.
+struct NormalmapPlanes {
+	StdVector<float> x;
+	StdVector<float> y;
+	StdVector<float> z;
+
+	void reset(unsigned int tile_resolution) {
+		const unsigned int padded_area = math::squared(tile_resolution + 2);
+		x.resize(padded_area);
+		y.resize(padded_area);
+		z.resize(padded_area);
+		to_span(x).fill(0.f);
+		to_span(y).fill(0.f);
+		to_span(z).fill(0.f);
+	}
+};
+
+// Sets 1 where normals are not zero, 0 otherwise.
+void compute_normalmap_mask(const NormalmapPlanes &normals, Span<float> mask) {
 	ZN_PROFILE_SCOPE();
+#ifdef DEBUG_ENABLED
+	ZN_ASSERT(mask.size() == normals.x.size());
+#endif
+	const float *nx = normals.x.data();
+	const float *ny = normals.y.data();
+	const float *nz = normals.z.data();
+	float *m = mask.data();
+	const unsigned int count = mask.size();
+	for (unsigned int i = 0; i < count; ++i) {
+		// Not using `||` to avoid branching
+		m[i] = float((nx[i] != 0.f) | (ny[i] != 0.f) | (nz[i] != 0.f));
+	}
+}
 
-	static const int s_dx[4] = { -1, 1, 0, 0 };
-	static const int s_dy[4] = { 0, 0, -1, 1 };
+// Fills pixels having a zero normal with the average of their non-zero neighbors, for one component.
+// `mask` tells which pixels have a normal (see `compute_normalmap_mask`).
+void dilate_normalmap_component(
+		Span<const float> mask,
+		Span<const float> src,
+		Span<float> dst,
+		const unsigned int tile_resolution
+) {
+	const unsigned int pitch = tile_resolution + 2;
+#ifdef DEBUG_ENABLED
+	ZN_ASSERT(mask.size() == math::squared(pitch));
+	ZN_ASSERT(src.size() == mask.size());
+	ZN_ASSERT(dst.size() == mask.size());
+#endif
 
-	struct NewNormal {
-		unsigned int loc;
-		Vector3f normal;
-	};
-	static thread_local StdVector<NewNormal> tls_new_normals;
-	tls_new_normals.clear();
-
-	unsigned int loc = 0;
-	for (int y = 0; y < size.y; ++y) {
-		for (int x = 0; x < size.x; ++x) {
-			if (normals[loc] != Vector3f()) {
-				++loc;
-				continue;
-			}
-			Vector3f sum;
-			int count = 0;
-			for (unsigned int di = 0; di < 4; ++di) {
-				const int nx = x + s_dx[di];
-				const int ny = y + s_dy[di];
-				if (nx >= 0 && nx < size.x && ny >= 0 && ny < size.y) {
-					const Vector3f nn = normals[nx + ny * size.y];
-					if (nn != Vector3f()) {
-						sum += nn;
-						++count;
-					}
-				}
-			}
-			if (count > 0) {
-				sum /= float(count);
-				tls_new_normals.push_back(NewNormal{ loc, sum });
-			}
-			++loc;
+	for (unsigned int y = 1; y <= tile_resolution; ++y) {
+		const unsigned int row_begin = y * pitch + 1;
+
+		// One pointer per neighbor so the compiler can vectorize the loop
+		const float *m = mask.data() + row_begin;
+		const float *m_left = m - 1;
+		const float *m_right = m + 1;
+		const float *m_up = m - pitch;
+		const float *m_down = m + pitch;
+
+		const float *s = src.data() + row_begin;
+		const float *s_left = s - 1;
+		const float *s_right = s + 1;
+		const float *s_up = s - pitch;
+		const float *s_down = s + pitch;
+
+		float *d = dst.data() + row_begin;
+
+		for (unsigned int x = 0; x < tile_resolution; ++x) {
+			const float count = m_left[x] + m_right[x] + m_up[x] + m_down[x];
+			// Zero normals don't contribute to the sum, and if all of them are zero, the sum is zero too
+			const float average = (s_left[x] + s_right[x] + s_up[x] + s_down[x]) / (count + float(count == 0.f));
+			d[x] = m[x] * s[x] + (1.f - m[x]) * average;
 		}
 	}
+}
 
-	for (const NewNormal nn : tls_new_normals) {
-		normals[nn.loc] = nn.normal;
-	}
+// Fills pixels having a zero normal with the average of their non-zero neighbors.
+void dilate_normalmap(
+		const NormalmapPlanes &src,
+		NormalmapPlanes &dst,
+		StdVector<float> &mask,
+		const unsigned int tile_resolution
+) {
+	ZN_PROFILE_SCOPE();
+	mask.resize(src.x.size());
+	compute_normalmap_mask(src, to_span(mask));
+	dilate_normalmap_component(to_span(mask), to_span(src.x), to_span(dst.x), tile_resolution);
+	dilate_normalmap_component(to_span(mask), to_span(src.y), to_span(dst.y), tile_resolution);
+	dilate_normalmap_component(to_span(mask), to_span(src.z), to_span(dst.z), tile_resolution);
 }
 
 } // namespace
@@ -163,23 +210,59 @@ inline uint8_t unorm_to_u8(float x) {
 	return math::clamp(255.f * x, 0.f, 255.f);
 }
 
-// https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
-Vector2f octahedron_wrap(Vector2f v) {
-	return (Vector2f(1.f) - math::abs(Vector2f(v.y, v.x))) * math::sign_nonzero(v);
+// Encodes normals of a tile into packed pixels of 3 bytes.
+void encode_normals_xyz(const NormalmapPlanes &src, const unsigned int tile_resolution, Span<uint8_t> dst) {
+	ZN_PROFILE_SCOPE();
+#ifdef DEBUG_ENABLED
+	ZN_ASSERT(dst.size() == math::squared(tile_resolution) * 3);
+#endif
+	const unsigned int pitch = tile_resolution + 2;
+	uint8_t *d = dst.data();
+
+	for (unsigned int y = 0; y < tile_resolution; ++y) {
+		const float *sx = src.x.data() + (y + 1) * pitch + 1;
+		const float *sy = src.y.data() + (y + 1) * pitch + 1;
+		const float *sz = src.z.data() + (y + 1) * pitch + 1;
+
+		for (unsigned int x = 0; x < tile_resolution; ++x) {
+			d[0] = unorm_to_u8(0.5f + 0.5f * sx[x]);
+			d[1] = unorm_to_u8(0.5f + 0.5f * sy[x]);
+			d[2] = unorm_to_u8(0.5f + 0.5f * sz[x]);
+			d += 3;
+		}
+	}
 }
 
+// Encodes normals of a tile into packed pixels of 2 bytes.
 // https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
-inline Vector2f encode_normal_octahedron(Vector3f n) {
-	const float sum = Math::abs(n.x) + Math::abs(n.y) + Math::abs(n.z);
-	n.x /= sum;
-	n.y /= sum;
-	Vector2f r = n.z >= 0.f ? Vector2f(n.x, n.y) : octahedron_wrap(Vector2f(n.x, n.y));
-	r = r * 0.5f + Vector2f(0.5f);
-	return r;
-}
-
-inline Vector3f encode_normal_xyz(const Vector3f n) {
-	return Vector3f(0.5f) + 0.5f * n;
+void encode_normals_octahedron(const NormalmapPlanes &src, const unsigned int tile_resolution, Span<uint8_t> dst) {
+	ZN_PROFILE_SCOPE();
+#ifdef DEBUG_ENABLED
+	ZN_ASSERT(dst.size() == math::squared(tile_resolution) * 2);
+#endif
+	const unsigned int pitch = tile_resolution + 2;
+	uint8_t *d = dst.data();
+
+	for (unsigned int y = 0; y < tile_resolution; ++y) {
+		const float *sx = src.x.data() + (y + 1) * pitch + 1;
+		const float *sy = src.y.data() + (y + 1) * pitch + 1;
+		const float *sz = src.z.data() + (y + 1) * pitch + 1;
+
+		// Branchless so it can be vectorized
+		for (unsigned int x = 0; x < tile_resolution; ++x) {
+			const float sum = Math::abs(sx[x]) + Math::abs(sy[x]) + Math::abs(sz[x]);
+			// Pixels without normal are encoded as if they pointed towards Z
+			const float inv_sum = 1.f / (sum + float(sum == 0.f));
+			const float nx = sx[x] * inv_sum;
+			const float ny = sy[x] * inv_sum;
+			const float wx = (1.f - Math::abs(ny)) * math::sign_nonzero(nx);
+			const float wy = (1.f - Math::abs(nx)) * math::sign_nonzero(ny);
+			const bool front = sz[x] >= 0.f;
+			d[0] = unorm_to_u8(0.5f + 0.5f * (front ? nx : wx));
+			d[1] = unorm_to_u8(0.5f + 0.5f * (front ? ny : wy));
+			d += 2;
+		}
+	}
 }
 
 void query_sdf_with_edits(
@@ -393,6 +476,314 @@ inline void query_sdf(
 #endif
 }
 
+// Tiles are not processed one by one. Instead, samples of many tiles are gathered so the generator can be queried with
+// large series of positions at once, and following steps can run on contiguous arrays the compiler can vectorize.
+struct DetailTextureBatch {
+	// Beyond this amount of samples, the batch gets processed before adding more tiles, to bound memory usage
+	static const unsigned int MAX_SAMPLES = 16384;
+
+	struct Tile {
+		unsigned int samples_begin;
+		unsigned int samples_end;
+		Vector3f cell_origin_world;
+		bool has_edits;
+		FixedArray<Vector3f, CurrentCellInfo::MAX_TRIANGLES> triangle_normals;
+	};
+
+	StdVector<Tile> tiles;
+
+	// Per sample, position where the pixel ray hit the mesh
+	StdVector<float> sample_x;
+	StdVector<float> sample_y;
+	StdVector<float> sample_z;
+	// Index of the pixel within its tile
+	StdVector<uint16_t> sample_pixel_indices;
+	StdVector<uint8_t> sample_triangle_indices;
+
+	// Each normal needs 4 samples:
+	// (x,   y,   z  )
+	// (x+s, y,   z  )
+	// (x,   y+s, z  )
+	// (x,   y,   z+s)
+	// They are stored in 4 consecutive planes, each the size of the number of samples.
+	StdVector<float> query_x;
+	StdVector<float> query_y;
+	StdVector<float> query_z;
+	StdVector<float> query_sdf;
+
+	StdVector<float> normal_x;
+	StdVector<float> normal_y;
+	StdVector<float> normal_z;
+
+	// Pixels of the tile being dilated. Two sets, because dilation reads from one and writes to the other.
+	FixedArray<NormalmapPlanes, 2> pixels;
+	StdVector<float> pixel_mask;
+
+	inline unsigned int get_sample_count() const {
+		return sample_x.size();
+	}
+
+	void clear() {
+		tiles.clear();
+		sample_x.clear();
+		sample_y.clear();
+		sample_z.clear();
+		sample_pixel_indices.clear();
+		sample_triangle_indices.clear();
+	}
+};
+
+void query_batch_sdf(
+		DetailTextureBatch &batch,
+		VoxelGenerator &generator,
+		const VoxelData *voxel_data,
+		const unsigned int cell_size,
+		const float step
+) {
+	ZN_PROFILE_SCOPE();
+
+	const unsigned int sample_count = batch.get_sample_count();
+	const unsigned int query_count = sample_count * 4;
+
+	batch.query_x.resize(query_count);
+	batch.query_y.resize(query_count);
+	batch.query_z.resize(query_count);
+	batch.query_sdf.resize(query_count);
+
+	{
+		ZN_PROFILE_SCOPE_NAMED("Compute positions");
+
+		const float *sx = batch.sample_x.data();
+		const float *sy = batch.sample_y.data();
+		const float *sz = batch.sample_z.data();
+
+		for (unsigned int plane = 0; plane < 4; ++plane) {
+			const float ox = plane == 1 ? step : 0.f;
+			const float oy = plane == 2 ? step : 0.f;
+			const float oz = plane == 3 ? step : 0.f;
+			float *qx = batch.query_x.data() + plane * sample_count;
+			float *qy = batch.query_y.data() + plane * sample_count;
+			float *qz = batch.query_z.data() + plane * sample_count;
+			for (unsigned int i = 0; i < sample_count; ++i) {
+				qx[i] = sx[i] + ox;
+				qy[i] = sy[i] + oy;
+				qz[i] = sz[i] + oz;
+			}
+		}
+	}
+
+	const VoxelModifierStack *modifiers = voxel_data != nullptr ? &voxel_data->get_modifiers() : nullptr;
+
+	// Tiles without edits are all queried in one go
+	{
+		Vector3f min_pos;
+		Vector3f max_pos;
+		bool found_tile_without_edits = false;
+		for (const DetailTextureBatch::Tile &tile : batch.tiles) {
+			if (tile.has_edits) {
+				continue;
+			}
+			const Vector3f tile_min_pos = tile.cell_origin_world;
+			const Vector3f tile_max_pos = tile.cell_origin_world + Vector3f(cell_size);
+			if (found_tile_without_edits) {
+				for (unsigned int axis = 0; axis < Vector3f::AXIS_COUNT; ++axis) {
+					min_pos[axis] = math::min(min_pos[axis], tile_min_pos[axis]);
+					max_pos[axis] = math::max(max_pos[axis], tile_max_pos[axis]);
+				}
+			} else {
+				min_pos = tile_min_pos;
+				max_pos = tile_max_pos;
+				found_tile_without_edits = true;
+			}
+		}
+
+		// Samples of tiles with edits are included too, which is wasted work. But edited tiles are usually rare, so
+		// it's better to make only one large query.
+		if (found_tile_without_edits && query_count > 0) {
+			query_sdf(
+					generator,
+					nullptr,
+					modifiers,
+					to_span(batch.query_x),
+					to_span(batch.query_y),
+					to_span(batch.query_z),
+					to_span(batch.query_sdf),
+					min_pos,
+					max_pos
+			);
+		}
+	}
+
+	// Tiles with edits are queried separately, each needing its own grid of blocks
+	for (const DetailTextureBatch::Tile &tile : batch.tiles) {
+		if (!tile.has_edits || tile.samples_begin == tile.samples_end) {
+			continue;
+		}
+		ZN_ASSERT(voxel_data != nullptr);
+
+		// Re-use memory because it will be used a lot
+		static thread_local VoxelDataGrid tls_voxel_data_grid;
+		// Ensure cleanup references to voxel buffers
+		ClearVoxelDataGridOnExit grid_clear_on_exit{ tls_voxel_data_grid };
+
+		const Vector3f min_pos = tile.cell_origin_world;
+		const Vector3f max_pos = tile.cell_origin_world + Vector3f(cell_size);
+
+		// The grid was already queried when the tile was added, but it had to be released since then
+		uint32_t skipped_count_due_to_high_volume = 0;
+		const bool has_edits = try_query_edited_blocks(
+				tls_voxel_data_grid, *voxel_data, min_pos, max_pos, skipped_count_due_to_high_volume
+		);
+		const VoxelDataGrid *edits_grid = has_edits ? &tls_voxel_data_grid : nullptr;
+
+		const unsigned int tile_sample_count = tile.samples_end - tile.samples_begin;
+
+		for (unsigned int plane = 0; plane < 4; ++plane) {
+			const unsigned int begin = plane * sample_count + tile.samples_begin;
+			query_sdf(
+					generator,
+					edits_grid,
+					modifiers,
+					to_span_from_position_and_size(batch.query_x, begin, tile_sample_count),
+					to_span_from_position_and_size(batch.query_y, begin, tile_sample_count),
+					to_span_from_position_and_size(batch.query_z, begin, tile_sample_count),
+					to_span_from_position_and_size(batch.query_sdf, begin, tile_sample_count),
+					min_pos,
+					max_pos
+			);
+		}
+	}
+}
+
+void compute_batch_normals(DetailTextureBatch &batch, float max_deviation_cosine, float max_deviation_sine) {
+	ZN_PROFILE_SCOPE();
+
+	const unsigned int sample_count = batch.get_sample_count();
+
+	batch.normal_x.resize(sample_count);
+	batch.normal_y.resize(sample_count);
+	batch.normal_z.resize(sample_count);
+
+	// Gradients of the SDF
+	{
+		const float *sd000 = batch.query_sdf.data();
+		const float *sd100 = sd000 + sample_count;
+		const float *sd010 = sd100 + sample_count;
+		const float *sd001 = sd010 + sample_count;
+		float *nx = batch.normal_x.data();
+		float *ny = batch.normal_y.data();
+		float *nz = batch.normal_z.data();
+
+		for (unsigned int i = 0; i < sample_count; ++i) {
+			const float gx = sd100[i] - sd000[i];
+			const float gy = sd010[i] - sd000[i];
+			const float gz = sd001[i] - sd000[i];
+			const float length = Math::sqrt(gx * gx + gy * gy + gz * gz);
+			// Not using a condition, so the loop can be vectorized
+			const float d = length + float(length == 0.f);
+			nx[i] = gx / d;
+			ny[i] = gy / d;
+			nz[i] = gz / d;
+		}
+	}
+
+	// Clamp normals if their dot product with triangle normal is higher than a threshold.
+	// This helps avoiding flipped normals on very low LODs because bias is very high. In the
+	// SolarSystem demo it can pick up caves from the surface which results in black spots.
+	for (const DetailTextureBatch::Tile &tile : batch.tiles) {
+		for (unsigned int i = tile.samples_begin; i < tile.samples_end; ++i) {
+			const Vector3f normal(batch.normal_x[i], batch.normal_y[i], batch.normal_z[i]);
+			const Vector3f &tri_normal = tile.triangle_normals[batch.sample_triangle_indices[i]];
+			const float tdot = math::dot(normal, tri_normal);
+			if (tdot < max_deviation_cosine) {
+				Vector3f clamped_normal;
+				if (tdot < -0.999) {
+					clamped_normal = tri_normal;
+				} else {
+					const Vector3f axis = math::normalized(math::cross(tri_normal, normal));
+					clamped_normal = math::rotated(tri_normal, axis, max_deviation_cosine, max_deviation_sine);
+				}
+				batch.normal_x[i] = clamped_normal.x;
+				batch.normal_y[i] = clamped_normal.y;
+				batch.normal_z[i] = clamped_normal.z;
+			}
+		}
+	}
+}
+
+// Computes normals of all tiles in the batch and appends them to `normals`, then clears the batch.
+void process_batch(
+		DetailTextureBatch &batch,
+		StdVector<uint8_t> &normals,
+		VoxelGenerator &generator,
+		const VoxelData *voxel_data,
+		const unsigned int tile_resolution,
+		const unsigned int cell_size,
+		const float step,
+		const bool octahedral_encoding,
+		const float max_deviation_cosine,
+		const float max_deviation_sine
+) {
+	ZN_PROFILE_SCOPE();
+
+	if (batch.tiles.size() == 0) {
+		return;
+	}
+
+	query_batch_sdf(batch, generator, voxel_data, cell_size, step);
+	compute_batch_normals(batch, max_deviation_cosine, max_deviation_sine);
+
+	const unsigned int encoded_normal_size = octahedral_encoding ? 2 : 3;
+	const unsigned int tile_size_in_bytes = math::squared(tile_resolution) * encoded_normal_size;
+	const unsigned int pitch = tile_resolution + 2;
+
+	// Resizing as we go, because depending on settings we may have to skip some cells
+	unsigned int tile_begin = normals.size();
+	normals.resize(normals.size() + batch.tiles.size() * tile_size_in_bytes);
+
+	for (const DetailTextureBatch::Tile &tile : batch.tiles) {
+		// Borders must remain zero, and pixels without samples too
+		batch.pixels[0].reset(tile_resolution);
+		batch.pixels[1].reset(tile_resolution);
+
+		{
+			NormalmapPlanes &pixels = batch.pixels[0];
+
+			for (unsigned int si = tile.samples_begin; si < tile.samples_end; ++si) {
+				const unsigned int pixel_index = batch.sample_pixel_indices[si];
+				const unsigned int x = pixel_index % tile_resolution;
+				const unsigned int y = pixel_index / tile_resolution;
+				const unsigned int loc = (x + 1) + (y + 1) * pitch;
+#ifdef DEBUG_ENABLED
+				ZN_ASSERT(loc < pixels.x.size());
+#endif
+				pixels.x[loc] = batch.normal_x[si];
+				pixels.y[loc] = batch.normal_y[si];
+				pixels.z[loc] = batch.normal_z[si];
+			}
+		}
+
+		// Fill up some pixels around triangle borders, to give some margin when sampling near them in shader
+		unsigned int src = 0;
+		for (unsigned int dilation_steps = 0; dilation_steps < 2; ++dilation_steps) {
+			const unsigned int dst = 1 - src;
+			dilate_normalmap(batch.pixels[src], batch.pixels[dst], batch.pixel_mask, tile_resolution);
+			src = dst;
+		}
+
+		// Encode normals
+		Span<uint8_t> tile_bytes = to_span_from_position_and_size(normals, tile_begin, tile_size_in_bytes);
+		if (octahedral_encoding) {
+			encode_normals_octahedron(batch.pixels[src], tile_resolution, tile_bytes);
+		} else {
+			encode_normals_xyz(batch.pixels[src], tile_resolution, tile_bytes);
+		}
+		tile_begin += tile_size_in_bytes;
+	}
+
+	batch.clear();
+}
+
 // For each non-empty cell of the mesh, choose an axis-aligned projection based on triangle normals in the cell.
 // Sample voxels inside the cell to compute a tile of world space normals from the SDF.
 void compute_detail_texture_data(
@@ -415,6 +806,8 @@ void compute_detail_texture_data(
 
 	ZN_ASSERT_RETURN(generator.supports_series_generation());
 	ZN_ASSERT_RETURN_MSG(max_deviation_radians > 0.001f, "Max deviation angle is too small.");
+	// Pixel indices are stored in 16 bits
+	ZN_ASSERT_RETURN(math::squared(tile_resolution) <= std::numeric_limits<uint16_t>::max() + 1);
 
 	const float max_deviation_cosine = Math::cos(max_deviation_radians);
 	const float max_deviation_sine = Math::sin(max_deviation_radians);
@@ -423,11 +816,12 @@ void compute_detail_texture_data(
 
 	const unsigned int cell_size = 1 << lod_index;
 	const float step = float(cell_size) / tile_resolution;
+	const unsigned int tile_area = math::squared(tile_resolution);
 
 	if (!edited_tiles_only) {
 		const unsigned int cell_count = cell_iterator.get_count();
 		normal_map_data.tiles.reserve(cell_count);
-		normal_map_data.normals.reserve(math::squared(tile_resolution) * cell_count * encoded_normal_size);
+		normal_map_data.normals.reserve(tile_area * cell_count * encoded_normal_size);
 	}
 
 	if (voxel_data != nullptr &&
@@ -441,28 +835,50 @@ void compute_detail_texture_data(
 
 	uint32_t skipped_count_due_to_high_volume = 0;
 
+	// Re-use memory because it will be used a lot
+	static thread_local DetailTextureBatch tls_batch;
+	DetailTextureBatch &batch = tls_batch;
+	batch.clear();
+
 	CurrentCellInfo cell_info;
 	for (unsigned int cell_index = 0; cell_iterator.next(cell_info); ++cell_index) {
-		// Re-use memory because it will be used a lot
-		static thread_local VoxelDataGrid tls_voxel_data_grid;
-		// Ensure cleanup references to voxel buffers
-		ClearVoxelDataGridOnExit grid_clear_on_exit{ tls_voxel_data_grid };
-
 		const Vector3f cell_origin_world = to_vec3f(origin_in_voxels + cell_info.position * cell_size);
 
 		// In cases we only want tiles with edited voxels, check this early so we can skip the tile.
-		const bool cell_has_edits = voxel_data != nullptr &&
-				try_query_edited_blocks(tls_voxel_data_grid,
-										*voxel_data,
-										cell_origin_world,
-										cell_origin_world + Vector3f(cell_size),
-										skipped_count_due_to_high_volume);
+		bool cell_has_edits = false;
+		if (voxel_data != nullptr) {
+			static thread_local VoxelDataGrid tls_voxel_data_grid;
+			// Ensure cleanup references to voxel buffers
+			ClearVoxelDataGridOnExit grid_clear_on_exit{ tls_voxel_data_grid };
+			cell_has_edits = try_query_edited_blocks(
+					tls_voxel_data_grid,
+					*voxel_data,
+					cell_origin_world,
+					cell_origin_world + Vector3f(cell_size),
+					skipped_count_due_to_high_volume
+			);
+		}
 		if (!cell_has_edits && edited_tiles_only) {
 			continue;
 		} else if (edited_tiles_only) {
 			normal_map_data.tile_indices.push_back(cell_index);
 		}
 
+		if (batch.get_sample_count() + tile_area > DetailTextureBatch::MAX_SAMPLES) {
+			process_batch(
+					batch,
+					normal_map_data.normals,
+					generator,
+					voxel_data,
+					tile_resolution,
+					cell_size,
+					step,
+					octahedral_encoding,
+					max_deviation_cosine,
+					max_deviation_sine
+			);
+		}
+
 		const DetailTextureData::Tile tile = compute_tile_info(cell_info, mesh_normals, mesh_indices);
 		normal_map_data.tiles.push_back(tile);
 
@@ -477,50 +893,26 @@ void compute_detail_texture_data(
 		Vector3f direction;
 		direction[az] = 1.f;
 
-		static thread_local StdVector<Vector2i> tls_tile_sample_positions;
-		tls_tile_sample_positions.clear();
-		tls_tile_sample_positions.reserve(math::squared(tile_resolution));
-
-		static thread_local StdVector<uint8_t> tls_tile_sample_triangle_index;
-		tls_tile_sample_triangle_index.clear();
-		tls_tile_sample_triangle_index.reserve(math::squared(tile_resolution));
-
-		// Each normal needs 4 samples:
-		// (x,   y,   z  )
-		// (x+s, y,   z  )
-		// (x,   y+s, z  )
-		// (x,   y,   z+s)
-		const unsigned int max_buffer_size = math::squared(tile_resolution) * 4;
-
-		static thread_local StdVector<float> tls_sdf_buffer;
-		static thread_local StdVector<float> tls_x_buffer;
-		static thread_local StdVector<float> tls_y_buffer;
-		static thread_local StdVector<float> tls_z_buffer;
-		tls_sdf_buffer.clear();
-		tls_x_buffer.clear();
-		tls_y_buffer.clear();
-		tls_z_buffer.clear();
-		tls_sdf_buffer.reserve(max_buffer_size);
-		tls_x_buffer.reserve(max_buffer_size);
-		tls_y_buffer.reserve(max_buffer_size);
-		tls_z_buffer.reserve(max_buffer_size);
-
 		// Optimize triangles
 		CellTriangles baked_triangles;
 		unsigned int triangle_count =
 				prepare_triangles(cell_info, direction, baked_triangles, mesh_vertices, mesh_indices);
 
+		DetailTextureBatch::Tile batch_tile;
+		batch_tile.cell_origin_world = cell_origin_world;
+		batch_tile.has_edits = cell_has_edits;
+		batch_tile.samples_begin = batch.get_sample_count();
+
 		// Compute triangle normals
-		FixedArray<Vector3f, CurrentCellInfo::MAX_TRIANGLES> triangle_normals;
 		for (unsigned int i = 0; i < triangle_count; ++i) {
 			const math::BakedIntersectionTriangleForFixedDirection &tri = baked_triangles[i];
 			const Vector3f tri_normal = math::normalized(math::cross(tri.e2, tri.e1));
-			triangle_normals[i] = tri_normal;
+			batch_tile.triangle_normals[i] = tri_normal;
 		}
 
-		// Fill query buffers
+		// Project pixels to triangles
 		{
-			ZN_PROFILE_SCOPE_NAMED("Compute positions");
+			ZN_PROFILE_SCOPE_NAMED("Raycast pixels");
 			for (unsigned int yi = 0; yi < tile_resolution; ++yi) {
 				for (unsigned int xi = 0; xi < tile_resolution; ++xi) {
 					// TODO Add bias to center differences when calculating the normals?
@@ -529,7 +921,6 @@ void compute_detail_texture_data(
 					pos000[ax] += int(xi) * step;
 					pos000[ay] += int(yi) * step;
 
-					// Project to triangles
 					const Vector3f ray_origin_world = pos000 - direction * cell_size;
 					const Vector3f ray_origin_mesh = ray_origin_world - to_vec3f(origin_in_voxels);
 					float nearest_hit_distance = 999999.f;
@@ -550,142 +941,33 @@ void compute_detail_texture_data(
 					}
 
 					pos000 = ray_origin_world + direction * nearest_hit_distance;
-					tls_tile_sample_positions.push_back(Vector2i(xi, yi));
-					tls_tile_sample_triangle_index.push_back(hit_triangle_index);
-
-					tls_x_buffer.push_back(pos000.x);
-					tls_y_buffer.push_back(pos000.y);
-					tls_z_buffer.push_back(pos000.z);
-
-					Vector3f pos100 = pos000;
-					pos100.x += step;
-					tls_x_buffer.push_back(pos100.x);
-					tls_y_buffer.push_back(pos100.y);
-					tls_z_buffer.push_back(pos100.z);
-
-					Vector3f pos010 = pos000;
-					pos010.y += step;
-					tls_x_buffer.push_back(pos010.x);
-					tls_y_buffer.push_back(pos010.y);
-					tls_z_buffer.push_back(pos010.z);
-
-					Vector3f pos001 = pos000;
-					pos001.z += step;
-					tls_x_buffer.push_back(pos001.x);
-					tls_y_buffer.push_back(pos001.y);
-					tls_z_buffer.push_back(pos001.z);
-				}
-			}
-		}
-
-		tls_sdf_buffer.resize(tls_x_buffer.size());
-
-		{
-			const VoxelDataGrid *edits_grid = cell_has_edits ? &tls_voxel_data_grid : nullptr;
-			const VoxelModifierStack *modifiers = voxel_data != nullptr ? &voxel_data->get_modifiers() : nullptr;
-
-			// Query voxel data
-			query_sdf(
-					generator,
-					edits_grid,
-					modifiers,
-					to_span(tls_x_buffer),
-					to_span(tls_y_buffer),
-					to_span(tls_z_buffer),
-					to_span(tls_sdf_buffer),
-					cell_origin_world,
-					cell_origin_world + Vector3f(cell_size)
-			);
-		}
-
-		static thread_local StdVector<Vector3f> tls_tile_normals;
-		tls_tile_normals.clear();
-		tls_tile_normals.resize(math::squared(tile_resolution));
 
-		// Compute normals from SDF results
-		{
-			ZN_PROFILE_SCOPE_NAMED("Compute normals");
-			ZN_ASSERT(tls_tile_sample_positions.size() == tls_tile_sample_triangle_index.size());
-
-			unsigned int bi = 0;
-
-			for (unsigned int si = 0; si < tls_tile_sample_positions.size(); ++si) {
-				const Vector2i sample_position = tls_tile_sample_positions[si];
-				const uint8_t sample_tri_index = tls_tile_sample_triangle_index[si];
-
-				const unsigned int bi000 = bi;
-				const unsigned int bi100 = bi + 1;
-				const unsigned int bi010 = bi + 2;
-				const unsigned int bi001 = bi + 3;
-				bi += 4;
-				// TODO I wish this was solved https://github.com/godotengine/godot/issues/31608
-#ifdef DEBUG_ENABLED
-				ZN_ASSERT(bi000 < tls_sdf_buffer.size());
-				ZN_ASSERT(bi100 < tls_sdf_buffer.size());
-				ZN_ASSERT(bi010 < tls_sdf_buffer.size());
-				ZN_ASSERT(bi001 < tls_sdf_buffer.size());
-#endif
-				const float sd000 = tls_sdf_buffer[bi000];
-				const float sd100 = tls_sdf_buffer[bi100];
-				const float sd010 = tls_sdf_buffer[bi010];
-				const float sd001 = tls_sdf_buffer[bi001];
-
-				Vector3f normal = math::normalized(Vector3f(sd100 - sd000, sd010 - sd000, sd001 - sd000));
-
-				// Clamp normals if their dot product with triangle normal is higher than a threshold.
-				// This helps avoiding flipped normals on very low LODs because bias is very high. In the
-				// SolarSystem demo it can pick up caves from the surface which results in black spots.
-				const Vector3f &tri_normal = triangle_normals[sample_tri_index];
-				const float tdot = math::dot(normal, tri_normal);
-				if (tdot < max_deviation_cosine) {
-					if (tdot < -0.999) {
-						normal = tri_normal;
-					} else {
-						const Vector3f axis = math::normalized(math::cross(tri_normal, normal));
-						normal = math::rotated(tri_normal, axis, max_deviation_cosine, max_deviation_sine);
-					}
+					batch.sample_x.push_back(pos000.x);
+					batch.sample_y.push_back(pos000.y);
+					batch.sample_z.push_back(pos000.z);
+					batch.sample_pixel_indices.push_back(xi + yi * tile_resolution);
+					batch.sample_triangle_indices.push_back(hit_triangle_index);
 				}
-
-				const unsigned int normal_index = sample_position.x + sample_position.y * tile_resolution;
-#ifdef DEBUG_ENABLED
-				ZN_ASSERT(normal_index < tls_tile_normals.size());
-#endif
-				tls_tile_normals[normal_index] = normal;
 			}
 		}
 
-		for (unsigned int dilation_steps = 0; dilation_steps < 2; ++dilation_steps) {
-			// Fill up some pixels around triangle borders, to give some margin when sampling near them in shader
-			dilate_normalmap(to_span(tls_tile_normals), Vector2i(tile_resolution, tile_resolution));
-		}
-
-		// Resizing as we go, because depending on settings we may have to skip some cells
-		const unsigned int tile_begin = normal_map_data.normals.size();
-		normal_map_data.normals.resize(
-				normal_map_data.normals.size() + math::squared(tile_resolution) * encoded_normal_size
-		);
-
-		// Encode normals
-		if (octahedral_encoding) {
-			for (unsigned int i = 0; i < tls_tile_normals.size(); ++i) {
-				const unsigned int offset = tile_begin + i * encoded_normal_size;
-				ZN_ASSERT(offset + encoded_normal_size <= normal_map_data.normals.size());
-				const Vector2f n = encode_normal_octahedron(tls_tile_normals[i]);
-				normal_map_data.normals[offset + 0] = unorm_to_u8(n.x);
-				normal_map_data.normals[offset + 1] = unorm_to_u8(n.y);
-			}
-		} else {
-			for (unsigned int i = 0; i < tls_tile_normals.size(); ++i) {
-				const unsigned int offset = tile_begin + i * encoded_normal_size; //
-				ZN_ASSERT(offset + encoded_normal_size <= normal_map_data.normals.size());
-				const Vector3f n = encode_normal_xyz(tls_tile_normals[i]);
-				normal_map_data.normals[offset + 0] = unorm_to_u8(n.x);
-				normal_map_data.normals[offset + 1] = unorm_to_u8(n.y);
-				normal_map_data.normals[offset + 2] = unorm_to_u8(n.z);
-			}
-		}
+		batch_tile.samples_end = batch.get_sample_count();
+		batch.tiles.push_back(batch_tile);
 	}
 
+	process_batch(
+			batch,
+			normal_map_data.normals,
+			generator,
+			voxel_data,
+			tile_resolution,
+			cell_size,
+			step,
+			octahedral_encoding,
+			max_deviation_cosine,
+			max_deviation_sine
+	);
+
 	if (skipped_count_due_to_high_volume > 0) {
 		// Logging here to reduce spam
 		ZN_PRINT_VERBOSE(format(
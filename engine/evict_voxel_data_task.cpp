@@ -0,0 +1,95 @@
+#include "evict_voxel_data_task.h"
+#include "../storage/voxel_data.h"
+#include "../util/profiling.h"
+#include "../util/string/format.h"
+#include <algorithm>
+
+namespace zylann::voxel {
+
+EvictVoxelDataTask::EvictVoxelDataTask(
+		StdVector<std::shared_ptr<VoxelData>> &&volumes,
+		size_t bytes_to_release,
+		uint32_t max_access_clock,
+		std::shared_ptr<Results> results
+) :
+		_volumes(std::move(volumes)),
+		_bytes_to_release(bytes_to_release),
+		_max_access_clock(max_access_clock),
+		_results(results) {}
+
+void EvictVoxelDataTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+
+	struct Candidate {
+		VoxelData::EvictableBlock block;
+		uint32_t volume_index;
+	};
+
+	static thread_local StdVector<VoxelData::EvictableBlock> tls_blocks;
+	static thread_local StdVector<Candidate> tls_candidates;
+	StdVector<Candidate> &candidates = tls_candidates;
+	candidates.clear();
+
+	for (unsigned int volume_index = 0; volume_index < _volumes.size(); ++volume_index) {
+		tls_blocks.clear();
+		_volumes[volume_index]->get_evictable_blocks(_max_access_clock, tls_blocks);
+		for (const VoxelData::EvictableBlock &block : tls_blocks) {
+			candidates.push_back(Candidate{ block, volume_index });
+		}
+	}
+
+	{
+		ZN_PROFILE_SCOPE_NAMED("Sort");
+		// Least recently used first
+		std::sort(candidates.begin(), candidates.end(), [this](const Candidate &a, const Candidate &b) {
+			return static_cast<int32_t>(a.block.last_access - _max_access_clock) <
+					static_cast<int32_t>(b.block.last_access - _max_access_clock);
+		});
+	}
+
+	// Blocks are evicted in small batches, to limit how long each volume's locks are held and to stop close to the
+	// requested amount
+	static const unsigned int BATCH_SIZE = 16;
+
+	size_t released_bytes = 0;
+	uint64_t evicted_blocks = 0;
+	unsigned int begin = 0;
+
+	while (begin < candidates.size() && released_bytes < _bytes_to_release) {
+		const uint32_t volume_index = candidates[begin].volume_index;
+
+		tls_blocks.clear();
+		unsigned int end = begin;
+		while (end < candidates.size() && tls_blocks.size() < BATCH_SIZE &&
+			   candidates[end].volume_index == volume_index) {
+			tls_blocks.push_back(candidates[end].block);
+			++end;
+		}
+
+		unsigned int evicted_count = 0;
+		released_bytes += _volumes[volume_index]->evict_blocks(to_span(tls_blocks), evicted_count);
+		evicted_blocks += evicted_count;
+
+		begin = end;
+	}
+
+	_results->evicted_bytes += released_bytes;
+	_results->evicted_blocks += evicted_blocks;
+
+	ZN_PRINT_VERBOSE(format("Evicted {} bytes of cached voxel data from {} candidate blocks, requested {}",
+			released_bytes, candidates.size(), _bytes_to_release));
+
+	// Don't hold on voxel data references longer than needed
+	_volumes.clear();
+}
+
+TaskPriority EvictVoxelDataTask::get_priority() {
+	// Memory pressure is more important than streaming
+	return TaskPriority::max();
+}
+
+void EvictVoxelDataTask::apply_result() {
+	_results->in_progress = false;
+}
+
+} // namespace zylann::voxel
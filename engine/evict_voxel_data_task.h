@@ -0,0 +1,48 @@
+#ifndef VOXEL_EVICT_VOXEL_DATA_TASK_H
+#define VOXEL_EVICT_VOXEL_DATA_TASK_H
+
+#include "../util/containers/std_vector.h"
+#include "../util/tasks/threaded_task.h"
+#include <atomic>
+#include <memory>
+
+namespace zylann::voxel {
+
+class VoxelData;
+
+// Drops cached voxel data of least recently used blocks across multiple volumes, until a given amount of memory has
+// been released. Only data that can be obtained again from generators is dropped, so it is transparent to users.
+class EvictVoxelDataTask : public IThreadedTask {
+public:
+	struct Results {
+		std::atomic_uint64_t evicted_blocks = { 0 };
+		std::atomic_uint64_t evicted_bytes = { 0 };
+		// Set while a task is pending, to avoid scheduling more than one at once
+		std::atomic_bool in_progress = { false };
+	};
+
+	EvictVoxelDataTask(
+			StdVector<std::shared_ptr<VoxelData>> &&volumes,
+			size_t bytes_to_release,
+			uint32_t max_access_clock,
+			std::shared_ptr<Results> results
+	);
+
+	const char *get_debug_name() const override {
+		return "EvictVoxelData";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+	TaskPriority get_priority() override;
+	void apply_result() override;
+
+private:
+	StdVector<std::shared_ptr<VoxelData>> _volumes;
+	size_t _bytes_to_release;
+	uint32_t _max_access_clock;
+	std::shared_ptr<Results> _results;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_EVICT_VOXEL_DATA_TASK_H
@@ -3,6 +3,8 @@
 #include "../generators/generate_block_task.h"
 #include "../meshers/mesh_block_task.h"
 #include "../shaders/shaders.h"
+#include "../storage/voxel_data.h"
+#include "../storage/voxel_memory_pool.h"
 #include "../streams/load_all_blocks_data_task.h"
 #include "../streams/load_block_data_task.h"
 #include "../streams/save_block_data_task.h"
@@ -98,6 +100,9 @@ VoxelEngine::VoxelEngine(Config config) {
 	}
 
 	set_main_thread_time_budget_usec(config.main_thread_budget_usec);
+
+	_eviction_results = make_shared_instance<EvictVoxelDataTask::Results>();
+	set_voxel_data_memory_budget(config.voxel_data_memory_budget);
 }
 
 void VoxelEngine::load_shaders() {
@@ -183,10 +188,11 @@ void VoxelEngine::wait_and_clear_all_tasks(bool warn) {
 	});
 }
 
-VolumeID VoxelEngine::add_volume(VolumeCallbacks callbacks) {
+VolumeID VoxelEngine::add_volume(VolumeCallbacks callbacks, std::shared_ptr<VoxelData> data) {
 	ZN_ASSERT(callbacks.check_callbacks());
 	Volume volume;
 	volume.callbacks = callbacks;
+	volume.data = data;
 	return _world.volumes.add(volume);
 }
 
@@ -326,6 +332,10 @@ void VoxelEngine::push_gpu_task(IGPUTask *task) {
 }
 
 void VoxelEngine::process() {
+#ifdef ZN_BUILTIN_PROFILER_ENABLED
+	// Tracy builds mark frames after drawing instead. This avoids connecting to the RenderingServer in all builds.
+	ZN_PROFILE_MARK_FRAME();
+#endif
 	ZN_PROFILE_SCOPE();
 	ZN_PROFILE_PLOT("Static memory usage", int64_t(OS::get_singleton()->get_static_memory_usage()));
 	ZN_PROFILE_PLOT("TimeSpread tasks", int64_t(_time_spread_task_runner.get_pending_count()));
@@ -352,9 +362,73 @@ void VoxelEngine::process() {
 	// Update viewer dependencies
 	sync_viewers_task_priority_data();
 
+	process_voxel_data_memory_budget();
+
 	ZN_PROFILE_PLOT("Pending GPU tasks", int64_t(_gpu_task_runner.get_pending_task_count()));
 }
 
+void VoxelEngine::set_voxel_data_memory_budget(size_t bytes) {
+	_voxel_data_memory_budget = bytes;
+}
+
+size_t VoxelEngine::get_voxel_data_memory_budget() const {
+	return _voxel_data_memory_budget;
+}
+
+void VoxelEngine::process_voxel_data_memory_budget() {
+	// Blocks store the value of this clock when they are accessed, so we can tell which ones were least recently used
+	VoxelDataBlock::advance_access_clock();
+
+	if (_voxel_data_memory_budget == 0 || _eviction_results->in_progress) {
+		return;
+	}
+
+	// Don't evict blocks used in the last frames, they are likely to be used again very soon
+	static const uint32_t MIN_AGE = 60;
+	const uint32_t access_clock = VoxelDataBlock::get_access_clock();
+	if (access_clock <= MIN_AGE) {
+		// No block is old enough yet
+		return;
+	}
+
+	// If the last eviction released nothing, remaining blocks are either not evictable or too recent. Scanning them
+	// all again is pointless until more of them are old enough.
+	if (_eviction_results->evicted_bytes == _evicted_bytes_before_last_eviction &&
+		access_clock - _last_eviction_access_clock < MIN_AGE) {
+		return;
+	}
+
+	// This includes voxel buffers temporarily used by tasks, not just those of blocks, but all of them come from the
+	// same pool
+	const size_t used_memory = VoxelMemoryPool::get_singleton().debug_get_used_memory();
+	if (used_memory <= _voxel_data_memory_budget) {
+		return;
+	}
+
+	ZN_PROFILE_SCOPE();
+
+	StdVector<std::shared_ptr<VoxelData>> volumes;
+	_world.volumes.for_each_value([&volumes](Volume &volume) {
+		std::shared_ptr<VoxelData> data = volume.data.lock();
+		if (data != nullptr) {
+			volumes.push_back(data);
+		}
+	});
+	if (volumes.size() == 0) {
+		return;
+	}
+
+	// Release a bit more than the excess, so eviction doesn't run every frame while memory stays close to the budget
+	const size_t target_memory = _voxel_data_memory_budget - _voxel_data_memory_budget / 10;
+	const uint32_t max_access_clock = access_clock - MIN_AGE;
+
+	_evicted_bytes_before_last_eviction = _eviction_results->evicted_bytes;
+	_last_eviction_access_clock = access_clock;
+	_eviction_results->in_progress = true;
+	push_async_task(ZN_NEW(EvictVoxelDataTask(std::move(volumes), used_memory - target_memory, max_access_clock,
+			_eviction_results)));
+}
+
 void VoxelEngine::sync_viewers_task_priority_data() {
 	const unsigned int viewer_count = _world.viewers.count();
 
@@ -427,6 +501,12 @@ VoxelEngine::Stats VoxelEngine::get_stats() const {
 	s.meshing_tasks = MeshBlockTask::debug_get_running_count();
 	s.streaming_tasks = LoadBlockDataTask::debug_get_running_count() + SaveBlockDataTask::debug_get_running_count();
 	s.main_thread_tasks = _time_spread_task_runner.get_pending_count() + _progressive_task_runner.get_pending_count();
+	s.generated_blocks = _debug_generated_block_count;
+	s.meshed_blocks = MeshBlockTask::debug_get_completed_count();
+	s.loaded_blocks = LoadBlockDataTask::debug_get_loaded_count();
+	s.saved_blocks = SaveBlockDataTask::debug_get_completed_count();
+	s.evicted_blocks = _eviction_results->evicted_blocks;
+	s.evicted_bytes = _eviction_results->evicted_bytes;
 	return s;
 }
 
@@ -6,6 +6,7 @@
 #include "../util/containers/slot_map.h"
 #include "../util/containers/std_vector.h"
 #include "../util/godot/classes/rendering_device.h"
+#include "../util/godot/classes/shape_3d.h"
 #include "../util/io/file_locker.h"
 #include "../util/memory/memory.h"
 #include "../util/string/std_string.h"
@@ -13,6 +14,7 @@
 #include "../util/tasks/threaded_task_runner.h"
 #include "../util/tasks/time_spread_task_runner.h"
 #include "detail_rendering/detail_rendering.h"
+#include "evict_voxel_data_task.h"
 #include "gpu/compute_shader.h"
 #include "gpu/gpu_storage_buffer_pool.h"
 #include "gpu/gpu_task_runner.h"
@@ -26,6 +28,8 @@ using namespace godot;
 
 namespace zylann::voxel {
 
+class VoxelData;
+
 // Singleton for common things, notably the task system and shared viewers list.
 // In Godot terminology this used to be called a "server", but I don't really agree with the term here, and it can be
 // confused with networking features.
@@ -53,6 +57,11 @@ public:
 		// Tells if the mesh resource was built as part of the task. If not, you need to build it on the main thread if
 		// it is needed.
 		bool has_mesh_resource;
+		// Only used if `has_collision_shape` is true. Can be null if the mesh has no triangles.
+		Ref<Shape3D> collision_shape;
+		// Tells if the collision shape was built as part of the task. If not, you need to build it on the main thread
+		// if it is needed.
+		bool has_collision_shape = false;
 		// Tells if the meshing task was required to build a rendering mesh if possible.
 		bool visual_was_required;
 		// Can be null. Attached to meshing output so it is tracked more easily, because it is baked asynchronously
@@ -67,7 +76,7 @@ public:
 			TYPE_SAVED
 		};
 
-		Type type;
+		Type type = TYPE_LOADED;
 		// If voxels are null with TYPE_LOADED, it means no block was found in the stream (if any) and no generator task
 		// was scheduled. This is the case when we don't want to cache blocks of generated data.
 		std::shared_ptr<VoxelBuffer> voxels;
@@ -137,13 +146,16 @@ public:
 		// Portion of available CPU threads to attempt using
 		float thread_count_ratio_over_max = 0.5;
 		unsigned int main_thread_budget_usec = DEFAULT_MAIN_THREAD_BUDGET_USEC;
+		// Maximum amount of memory voxel data should use, in bytes, including temporary buffers. 0 means no limit.
+		size_t voxel_data_memory_budget = 0;
 	};
 
 	static VoxelEngine &get_singleton();
 	static void create_singleton(Config config);
 	static void destroy_singleton();
 
-	VolumeID add_volume(VolumeCallbacks callbacks);
+	// If voxel data is provided, it may have cached data evicted when the voxel data memory budget is exceeded.
+	VolumeID add_volume(VolumeCallbacks callbacks, std::shared_ptr<VoxelData> data = nullptr);
 	VolumeCallbacks get_volume_callbacks(VolumeID volume_id) const;
 
 	void remove_volume(VolumeID volume_id);
@@ -181,6 +193,12 @@ public:
 	int get_main_thread_time_budget_usec() const;
 	void set_main_thread_time_budget_usec(unsigned int usec);
 
+	// When memory used by voxel data exceeds this amount of bytes, the least recently used blocks of voxel data that
+	// can be regenerated are dropped. 0 means no limit. Memory is measured over the whole voxel memory pool, so it
+	// includes buffers temporarily used by tasks.
+	void set_voxel_data_memory_budget(size_t bytes);
+	size_t get_voxel_data_memory_budget() const;
+
 	// Allows/disallows building Mesh and Texture resources from inside threads.
 	// Depends on Godot's efficiency at doing so, and which renderer is used.
 	// For example, the OpenGL renderer does not support this well, but the Vulkan one should.
@@ -227,6 +245,13 @@ public:
 		int streaming_tasks;
 		int meshing_tasks;
 		int main_thread_tasks;
+		// Totals since startup
+		uint64_t generated_blocks;
+		uint64_t meshed_blocks;
+		uint64_t loaded_blocks;
+		uint64_t saved_blocks;
+		uint64_t evicted_blocks;
+		uint64_t evicted_bytes;
 	};
 
 	Stats get_stats() const;
@@ -296,10 +321,15 @@ public:
 #endif
 	}
 
+	inline void debug_increment_generated_block_counter() {
+		++_debug_generated_block_count;
+	}
+
 private:
 	VoxelEngine(Config config);
 
 	void load_shaders();
+	void process_voxel_data_memory_budget();
 
 	// Since we are going to send data to tasks running in multiple threads, a few strategies are in place:
 	//
@@ -315,6 +345,8 @@ private:
 
 	struct Volume {
 		VolumeCallbacks callbacks;
+		// Optional, used to enforce the memory budget
+		std::weak_ptr<VoxelData> data;
 	};
 
 	struct World {
@@ -334,6 +366,12 @@ private:
 	unsigned int _main_thread_time_budget_usec = DEFAULT_MAIN_THREAD_BUDGET_USEC;
 	ProgressiveTaskRunner _progressive_task_runner;
 
+	size_t _voxel_data_memory_budget = 0;
+	std::shared_ptr<EvictVoxelDataTask::Results> _eviction_results;
+	// Used to tell if the last eviction released anything, and to wait before trying again if it didn't
+	uint64_t _evicted_bytes_before_last_eviction = 0;
+	uint32_t _last_eviction_access_clock = 0;
+
 	FileLocker _file_locker;
 
 	bool _threaded_graphics_resource_building_enabled = false;
@@ -358,6 +396,7 @@ private:
 
 	// There can be multiple types of generation tasks, so we count them with a common counter.
 	std::atomic_int _debug_generate_block_task_count = { 0 };
+	std::atomic_uint64_t _debug_generated_block_count = { 0 };
 };
 
 struct VoxelFileLockerRead {
@@ -2,11 +2,13 @@
 #include "../constants/version.gen.h"
 #include "../constants/voxel_string_names.h"
 #include "../storage/voxel_memory_pool.h"
+#include "../util/godot/classes/file_access.h"
 #include "../util/godot/classes/project_settings.h"
 #include "../util/godot/classes/rendering_server.h"
 #include "../util/godot/core/packed_arrays.h"
 #include "../util/macros.h"
 #include "../util/profiling.h"
+#include "../util/string/std_string.h"
 #include "../util/tasks/godot/threaded_task_gd.h"
 #include "voxel_engine.h"
 
@@ -50,6 +52,10 @@ VoxelEngine::Config VoxelEngine::get_config_from_godot() {
 			Variant::INT, "voxel/threads/main/time_budget_ms", PROPERTY_HINT_RANGE, "0,1000", 8, true
 	);
 
+	add_custom_project_setting(
+			Variant::INT, "voxel/memory/voxel_data_budget_mb", PROPERTY_HINT_RANGE, "0,65536", 0, true
+	);
+
 	add_custom_project_setting(Variant::BOOL, "voxel/ownership_checks", PROPERTY_HINT_NONE, "", true, true);
 
 	config.inner.main_thread_budget_usec = 1000 * int(ps.get("voxel/threads/main/time_budget_ms"));
@@ -63,12 +69,17 @@ VoxelEngine::Config VoxelEngine::get_config_from_godot() {
 	config.inner.thread_count_ratio_over_max =
 			math::clamp(float(ps.get("voxel/threads/count/ratio_over_max")), 0.f, 1.f);
 
+	config.inner.voxel_data_memory_budget =
+			static_cast<size_t>(math::max(0, int(ps.get("voxel/memory/voxel_data_budget_mb")))) * 1024 * 1024;
+
 	config.ownership_checks = ps.get("voxel/ownership_checks");
 
 	return config;
 }
 
 VoxelEngine::VoxelEngine() {
+	ZN_PROFILE_SET_THREAD_NAME("Main thread");
+
 #ifdef ZN_PROFILER_ENABLED
 	CRASH_COND(RenderingServer::get_singleton() == nullptr);
 	RenderingServer::get_singleton()->connect(
@@ -123,11 +134,25 @@ Dictionary to_dict(const zylann::voxel::VoxelEngine::Stats &stats) {
 	tasks["meshing"] = stats.meshing_tasks;
 	tasks["main_thread"] = stats.main_thread_tasks;
 
+	Dictionary totals;
+	totals["generated_blocks"] = stats.generated_blocks;
+	totals["meshed_blocks"] = stats.meshed_blocks;
+	totals["loaded_blocks"] = stats.loaded_blocks;
+	totals["saved_blocks"] = stats.saved_blocks;
+
 	// This part is additional for scripts because VoxelMemoryPool is not exposed
 	Dictionary mem;
 	mem["voxel_total"] = ZN_SIZE_T_TO_VARIANT(VoxelMemoryPool::get_singleton().debug_get_total_memory());
 	mem["voxel_used"] = ZN_SIZE_T_TO_VARIANT(VoxelMemoryPool::get_singleton().debug_get_used_memory());
 	mem["block_count"] = VoxelMemoryPool::get_singleton().debug_get_used_blocks();
+	{
+		const VoxelMemoryPool::ThreadCacheStats tcs = VoxelMemoryPool::get_singleton().debug_get_thread_cache_stats();
+		mem["thread_cache_hit_ratio"] = tcs.get_hit_ratio();
+		mem["thread_cache_blocks"] = tcs.cached_blocks;
+		mem["thread_cache_memory"] = ZN_SIZE_T_TO_VARIANT(tcs.cached_memory);
+	}
+	mem["evicted_blocks"] = stats.evicted_blocks;
+	mem["evicted_bytes"] = stats.evicted_bytes;
 #ifdef DEBUG_ENABLED
 	const uint64_t std_allocated = static_cast<int64_t>(StdDefaultAllocatorCounters::g_allocated);
 	const uint64_t std_deallocated = static_cast<int64_t>(StdDefaultAllocatorCounters::g_deallocated);
@@ -143,6 +168,7 @@ Dictionary to_dict(const zylann::voxel::VoxelEngine::Stats &stats) {
 	Dictionary d;
 	d["thread_pools"] = pools;
 	d["tasks"] = tasks;
+	d["totals"] = totals;
 	d["memory_pools"] = mem;
 	return d;
 }
@@ -158,6 +184,69 @@ void VoxelEngine::schedule_task(Ref<ZN_ThreadedTask> task) {
 	zylann::voxel::VoxelEngine::get_singleton().push_async_task(task->create_task());
 }
 
+#ifdef ZN_BUILTIN_PROFILER_ENABLED
+
+void VoxelEngine::set_profiling_enabled(bool enabled) {
+	zylann::profiler::set_enabled(enabled);
+}
+
+bool VoxelEngine::is_profiling_enabled() const {
+	return zylann::profiler::is_enabled();
+}
+
+void VoxelEngine::set_profiling_events_per_thread(int count) {
+	ERR_FAIL_COND(count < 1);
+	zylann::profiler::set_events_per_thread(count);
+}
+
+int VoxelEngine::get_profiling_events_per_thread() const {
+	return zylann::profiler::get_events_per_thread();
+}
+
+void VoxelEngine::clear_profiling_data() {
+	zylann::profiler::clear();
+}
+
+Error VoxelEngine::save_profiling_trace(String fpath) const {
+	StdString json;
+	zylann::profiler::get_chrome_trace(json);
+
+	Error err;
+	Ref<FileAccess> f = open_file(fpath, FileAccess::WRITE, err);
+	ERR_FAIL_COND_V_MSG(f.is_null(), err, String("Could not open {0}").format(varray(fpath)));
+	store_buffer(**f, Span<const uint8_t>(reinterpret_cast<const uint8_t *>(json.data()), json.size()));
+	return OK;
+}
+
+#else
+
+// The built-in profiler is not compiled when Tracy is used, or when disabled explicitly
+
+void VoxelEngine::set_profiling_enabled(bool enabled) {
+	ERR_PRINT("The built-in profiler is not available in this build");
+}
+
+bool VoxelEngine::is_profiling_enabled() const {
+	return false;
+}
+
+void VoxelEngine::set_profiling_events_per_thread(int count) {
+	ERR_PRINT("The built-in profiler is not available in this build");
+}
+
+int VoxelEngine::get_profiling_events_per_thread() const {
+	return 0;
+}
+
+void VoxelEngine::clear_profiling_data() {}
+
+Error VoxelEngine::save_profiling_trace(String fpath) const {
+	ERR_PRINT("The built-in profiler is not available in this build");
+	return ERR_UNAVAILABLE;
+}
+
+#endif
+
 void VoxelEngine::_on_rendering_server_frame_post_draw() {
 #ifdef ZN_PROFILER_ENABLED
 	ZN_PROFILE_MARK_FRAME();
@@ -186,6 +275,15 @@ void VoxelEngine::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_version_minor"), &VoxelEngine::get_version_minor);
 	ClassDB::bind_method(D_METHOD("get_version_patch"), &VoxelEngine::get_version_patch);
 	ClassDB::bind_method(D_METHOD("get_stats"), &VoxelEngine::get_stats);
+
+	ClassDB::bind_method(D_METHOD("set_profiling_enabled", "enabled"), &VoxelEngine::set_profiling_enabled);
+	ClassDB::bind_method(D_METHOD("is_profiling_enabled"), &VoxelEngine::is_profiling_enabled);
+	ClassDB::bind_method(
+			D_METHOD("set_profiling_events_per_thread", "count"), &VoxelEngine::set_profiling_events_per_thread
+	);
+	ClassDB::bind_method(D_METHOD("get_profiling_events_per_thread"), &VoxelEngine::get_profiling_events_per_thread);
+	ClassDB::bind_method(D_METHOD("clear_profiling_data"), &VoxelEngine::clear_profiling_data);
+	ClassDB::bind_method(D_METHOD("save_profiling_trace", "path"), &VoxelEngine::save_profiling_trace);
 }
 
 } // namespace zylann::voxel::godot
@@ -34,6 +34,13 @@ public:
 	Dictionary get_stats() const;
 	void schedule_task(Ref<ZN_ThreadedTask> task);
 
+	void set_profiling_enabled(bool enabled);
+	bool is_profiling_enabled() const;
+	void set_profiling_events_per_thread(int count);
+	int get_profiling_events_per_thread() const;
+	void clear_profiling_data();
+	Error save_profiling_trace(String fpath) const;
+
 #ifdef TOOLS_ENABLED
 	void set_editor_camera_info(Vector3 position, Vector3 direction);
 	Vector3 get_editor_camera_position() const;
@@ -166,6 +166,7 @@ void GenerateBlockTask::run_stream_saving_and_finish() {
 	}
 
 	_has_run = true;
+	VoxelEngine::get_singleton().debug_increment_generated_block_counter();
 }
 
 TaskPriority GenerateBlockTask::get_priority() {
@@ -64,17 +64,7 @@ void GenerateBlockMultipassCBTask::run(zylann::ThreadedTaskContext &ctx) {
 		const Vector2i column_position(_block_position.x, _block_position.z);
 		// TODO Candidate for postponing? Lots of them, might cause contention
 		SpatialLock2D::Read srlock(map.spatial_lock, BoxBounds2i::from_position(column_position));
-		VoxelGeneratorMultipassCBStructs::Column *column = nullptr;
-		{
-			MutexLock mlock(map.mutex);
-			auto column_it = map.columns.find(column_position);
-			if (column_it == map.columns.end()) {
-				// Drop, for some reason it wasn't available
-				return;
-			}
-
-			column = &column_it->second;
-		}
+		VoxelGeneratorMultipassCBStructs::Column *column = map.columns.find(column_position);
 
 		if (column == nullptr) {
 			// Drop.
@@ -115,7 +105,9 @@ void GenerateBlockMultipassCBTask::run(zylann::ThreadedTaskContext &ctx) {
 				// It could cause a request loop even though a task already is pending
 			}
 
-			if ((column->pending_subpass_tasks_mask & (1 << final_subpass_index)) == 0) {
+			// Other block tasks of the same column can be here at the same time, so the bit is claimed atomically
+			const uint8_t final_subpass_bit = 1 << final_subpass_index;
+			if ((column->pending_subpass_tasks_mask.fetch_or(final_subpass_bit) & final_subpass_bit) == 0) {
 				// No tasks working on it, and we are the first top-level task.
 				// Spawn a subtask to bring this column to final state.
 				GenerateColumnMultipassTask *subtask = ZN_NEW(GenerateColumnMultipassTask(
@@ -131,8 +123,6 @@ void GenerateBlockMultipassCBTask::run(zylann::ThreadedTaskContext &ctx) {
 						make_shared_instance<std::atomic_int>(1)
 				));
 
-				column->pending_subpass_tasks_mask |= (1 << final_subpass_index);
-
 				VoxelEngine::get_singleton().push_async_task(subtask);
 
 			} else {
@@ -212,6 +202,7 @@ void GenerateBlockMultipassCBTask::run_stream_saving_and_finish() {
 	}
 
 	_has_run = true;
+	VoxelEngine::get_singleton().debug_increment_generated_block_counter();
 }
 
 TaskPriority GenerateBlockMultipassCBTask::get_priority() {
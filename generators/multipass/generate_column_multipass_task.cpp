@@ -86,33 +86,11 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 
 	if (_cancelled) {
 		// At least one subtask was cancelled, therefore we have to cleanup and return too.
-
-		// Unregister from the column if any
-		{
-			if (!map.spatial_lock.try_lock_write(BoxBounds2i::from_position(_column_position))) {
-				// Try later (funny situation, but that's the pattern)
-				ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
-				return;
-			}
-			SpatialLock2D::UnlockWriteOnScopeExit swlock(
-					map.spatial_lock, BoxBounds2i::from_position(_column_position)
-			);
-
-			MutexLock mlock(map.mutex);
-			auto column_it = map.columns.find(_column_position);
-			if (column_it != map.columns.end()) {
-				// Unregister task from the column
-				Column &column = column_it->second;
-				column.pending_subpass_tasks_mask &= ~(1 << _subpass_index);
-
-				if (_subpass_index == final_subpass_index) {
-					// Schedule pending block requests to make them handle cancellation
-					schedule_final_block_tasks(column, task_scheduler);
-				}
-			}
+		if (!run_cancellation(map, task_scheduler)) {
+			// Try later (funny situation, but that's the pattern)
+			ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+			return;
 		}
-
-		return_to_caller(false);
 		task_scheduler.flush();
 		return;
 	}
@@ -135,6 +113,45 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 	const unsigned int central_block_index =
 			Vector2iUtil::get_yx_index(Vector2iUtil::create(pass.dependency_extents), neighbors_box.size);
 
+	const int prev_subpass_index = _subpass_index - 1;
+
+	// Check dependencies first. This only reads the state of columns, so tasks working in the same area can do it at
+	// the same time. The region only gets locked for writing once the pass can run.
+	if (prev_subpass_index >= 0) {
+		std::shared_ptr<std::atomic_int> dependency_counter;
+
+		switch (check_dependencies(map, neighbors_box, task_scheduler, dependency_counter)) {
+			case DEPENDENCIES_READY:
+				break;
+
+			case DEPENDENCIES_MISSING_COLUMN:
+				// No longer loaded, we have to cancel the task
+				_cancelled = true;
+				if (!run_cancellation(map, task_scheduler)) {
+					ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+					return;
+				}
+				task_scheduler.flush();
+				return;
+
+			case DEPENDENCIES_NOT_READY:
+				task_scheduler.flush();
+				if (dependency_counter == nullptr) {
+					ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+				} else {
+					// We will be scheduled again by subtasks or columns we are waiting for.
+					ctx.status = ThreadedTaskContext::STATUS_TAKEN_OUT;
+					// Release the count we held while registering. After this, the current task could already be
+					// running again in another thread, so it must not be accessed anymore.
+					if (--(*dependency_counter) == 0) {
+						// Everything we waited for finished in the meantime
+						ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+					}
+				}
+				return;
+		}
+	}
+
 	StdVector<Column *> columns;
 	// TODO Cache memory
 	columns.reserve(Vector2iUtil::get_area(neighbors_box.size));
@@ -157,52 +174,25 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 		// Fetch columns from map
 		{
 			ZN_PROFILE_SCOPE_NAMED("Fetch columns");
-
-			// TODO We don't create new columns from here, could use a shared lock?
-			MutexLock mlock(map.mutex);
-
-			Vector2i bpos;
 			// Coordinate order matters (note, Y in Vector2i corresponds to Z in 3D here).
-			neighbors_box.for_each_cell_yx([&columns, &map](Vector2i cpos) {
-				auto it = map.columns.find(cpos);
-				Column *column = nullptr;
-				if (it != map.columns.end()) {
-					column = &it->second;
-				}
-				columns.push_back(column);
+			neighbors_box.for_each_cell_yx([&columns, &map](Vector2i cpos) { //
+				columns.push_back(map.columns.find(cpos));
 			});
 		}
 
-		const int subpass_index = _subpass_index;
-		const int prev_subpass_index = subpass_index - 1;
-
 		Column *main_column = columns[central_block_index];
 
-		bool spawned_subtasks = false;
-		bool postpone = false;
-
-		// Check loading levels
+		// Check loading levels again. Columns could have been unloaded, or unloaded and loaded again, since
+		// dependencies were checked.
 		{
 			ZN_PROFILE_SCOPE_NAMED("Check levels");
 
-			Vector2i cpos;
-
-			const Vector2i cpos_min = neighbors_box.position;
-			const Vector2i cpos_max = neighbors_box.position + neighbors_box.size;
-
-			std::shared_ptr<std::atomic_int> dependency_counter = nullptr;
-
 			for (Column *column : columns) {
 				if (column == nullptr) {
 					// No longer loaded, we have to cancel the task
 
 					if (main_column != nullptr) {
-						main_column->pending_subpass_tasks_mask &= ~(1 << _subpass_index);
-
-						if (_subpass_index == final_subpass_index) {
-							// Schedule pending block requests to make them handle cancellation
-							schedule_final_block_tasks(*main_column, task_scheduler);
-						}
+						unregister_from_column(*main_column, task_scheduler);
 					}
 
 					return_to_caller(false);
@@ -213,79 +203,32 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 
 			// ZN_ASSERT(!has_duplicate(to_span_const(columns)));
 
-			unsigned int i = 0;
-			for (cpos.y = cpos_min.y; cpos.y < cpos_max.y; ++cpos.y) {
-				for (cpos.x = cpos_min.x; cpos.x < cpos_max.x; ++cpos.x) {
-					Column *column = columns[i];
-					ZN_ASSERT(column != nullptr);
-
-					// We want all blocks in the neighborhood to be at least at the previous subpass before we can
-					// run the current subpass
-					if (prev_subpass_index >= 0 && column->subpass_index < prev_subpass_index) {
-						// Dependencies not ready yet.
-
-						if (column->loading) {
-							// A task is pending to work on the dependency, so we wait.
-							// TODO Ideally we should subscribe to the completion of that task.
-							// println(format("O {} {} {} {} {}", int(_subpass_index), _column_position.x, 0,
-							// 		_column_position.y, Time::get_singleton()->get_ticks_usec()));
-							postpone = true;
-
-						} else if ((column->pending_subpass_tasks_mask & (1 << prev_subpass_index)) != 0) {
-							// A task is pending to work on the dependency, so we wait.
-							// TODO Ideally we should subscribe to the completion of that task.
-							// We can do that
-							// println(format("O {} {} {} {} {}", int(_subpass_index), _column_position.x, 0,
-							// 		_column_position.y, Time::get_singleton()->get_ticks_usec()));
-							postpone = true;
-
-						} else {
-							// No task is pending to work on the dependency, spawn one.
-
-							if (dependency_counter == nullptr) {
-								dependency_counter = make_shared_instance<std::atomic_int>();
-							}
-							++(*dependency_counter);
-
-							GenerateColumnMultipassTask *subtask = ZN_NEW(GenerateColumnMultipassTask(
-									cpos,
-									_block_size,
-									prev_subpass_index,
-									_generator_internal,
-									_generator,
-									_priority,
-									this,
-									dependency_counter
-							));
-							subtask->_caller_mp_task = this;
-							task_scheduler.push_main_task(subtask);
-
-							column->pending_subpass_tasks_mask |= (1 << prev_subpass_index);
-
-							spawned_subtasks = true;
-						}
-						// TODO If a column got deallocated after it was returned once, restart its generation process.
-						// This would be to cover cases where blocks of a column get requested more than once. In the
-						// ideal case this should not happen, but the real world is a mess:
-						// - The game could have crashed
-						// - Saving could have failed
-						// - Files could have been deleted
-						// - The game could simply want to reset an area
-					}
+			if (main_column->loading) {
+				// Its cached state is being restored. Dependencies of other subpasses can't be loading, because they
+				// would have been checked before.
+				ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+				return;
+			}
 
-					++i;
+			for (Column *column : columns) {
+				// We want all blocks in the neighborhood to be at least at the previous subpass before we can
+				// run the current subpass
+				if (prev_subpass_index >= 0 && column->subpass_index < prev_subpass_index) {
+					// TODO If a column got deallocated after it was returned once, restart its generation process.
+					// This would be to cover cases where blocks of a column get requested more than once. In the
+					// ideal case this should not happen, but the real world is a mess:
+					// - The game could have crashed
+					// - Saving could have failed
+					// - Files could have been deleted
+					// - The game could simply want to reset an area
+					// Dependencies will be checked again
+					ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+					return;
 				}
 			}
 		}
 
-		if (spawned_subtasks) {
-			ctx.status = ThreadedTaskContext::STATUS_TAKEN_OUT;
-
-		} else if (postpone) {
-			ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
-			return;
-
-		} else {
+		{
 			ZN_PROFILE_SCOPE_NAMED("Run pass");
 			// We can run the pass
 
@@ -353,6 +296,10 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 			}
 
 			main_column->pending_subpass_tasks_mask &= ~(1 << _subpass_index);
+			// Tasks waiting for this column may now resume
+			main_column->notify_waiters([&task_scheduler](IThreadedTask *task) { //
+				task_scheduler.push_main_task(task);
+			});
 
 			if (main_column->subpass_index == final_subpass_index) {
 				// All tasks that were waiting for this column to be complete (and did not spawn column subtasks
@@ -369,6 +316,141 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 	task_scheduler.flush();
 }
 
+GenerateColumnMultipassTask::DependencyCheckResult GenerateColumnMultipassTask::check_dependencies(
+		Map &map,
+		const Box2i neighbors_box,
+		BufferedTaskScheduler &task_scheduler,
+		std::shared_ptr<std::atomic_int> &out_dependency_counter
+) {
+	ZN_PROFILE_SCOPE();
+
+	if (!map.spatial_lock.try_lock_read(neighbors_box)) {
+		return DEPENDENCIES_NOT_READY;
+	}
+	SpatialLock2D::UnlockReadOnScopeExit srlock(map.spatial_lock, neighbors_box);
+
+	StdVector<Column *> columns;
+	// TODO Cache memory
+	columns.reserve(Vector2iUtil::get_area(neighbors_box.size));
+
+	{
+		ZN_PROFILE_SCOPE_NAMED("Fetch columns");
+		neighbors_box.for_each_cell_yx([&columns, &map](Vector2i cpos) { //
+			columns.push_back(map.columns.find(cpos));
+		});
+	}
+
+	for (const Column *column : columns) {
+		if (column == nullptr) {
+			return DEPENDENCIES_MISSING_COLUMN;
+		}
+	}
+
+	const int prev_subpass_index = _subpass_index - 1;
+	const uint8_t prev_subpass_bit = 1 << prev_subpass_index;
+
+	bool postpone = false;
+
+	Vector2i cpos;
+	const Vector2i cpos_min = neighbors_box.position;
+	const Vector2i cpos_max = neighbors_box.position + neighbors_box.size;
+
+	unsigned int i = 0;
+	for (cpos.y = cpos_min.y; cpos.y < cpos_max.y; ++cpos.y) {
+		for (cpos.x = cpos_min.x; cpos.x < cpos_max.x; ++cpos.x) {
+			Column *column = columns[i];
+			++i;
+
+			// We want all blocks in the neighborhood to be at least at the previous subpass before we can
+			// run the current subpass
+			if (column->subpass_index >= prev_subpass_index) {
+				continue;
+			}
+
+			// Dependencies not ready yet.
+
+			if (column->loading) {
+				// A task is pending to work on the dependency, so we wait.
+				// TODO Ideally we should subscribe to the completion of that task.
+				postpone = true;
+				continue;
+			}
+
+			if (out_dependency_counter == nullptr) {
+				// Starts at 1 so tasks we wait for can't bring it to zero until we are done registering
+				out_dependency_counter = make_shared_instance<std::atomic_int>(1);
+			}
+
+			// Other tasks can check the same column at the same time, so the bit is claimed atomically
+			if ((column->pending_subpass_tasks_mask.fetch_or(prev_subpass_bit) & prev_subpass_bit) == 0) {
+				// No task is pending to work on the dependency, spawn one.
+				++(*out_dependency_counter);
+
+				GenerateColumnMultipassTask *subtask = ZN_NEW(GenerateColumnMultipassTask(
+						cpos,
+						_block_size,
+						prev_subpass_index,
+						_generator_internal,
+						_generator,
+						_priority,
+						this,
+						out_dependency_counter
+				));
+				subtask->_caller_mp_task = this;
+				task_scheduler.push_main_task(subtask);
+
+			} else {
+				// A task is pending to work on the dependency, wait for it to finish.
+				++(*out_dependency_counter);
+				if (!column->add_waiter(prev_subpass_index, ColumnWaiter{ this, out_dependency_counter })) {
+					// It finished in the meantime
+					--(*out_dependency_counter);
+				}
+			}
+		}
+	}
+
+	if (out_dependency_counter == nullptr && !postpone) {
+		return DEPENDENCIES_READY;
+	}
+	return DEPENDENCIES_NOT_READY;
+}
+
+bool GenerateColumnMultipassTask::run_cancellation(Map &map, BufferedTaskScheduler &task_scheduler) {
+	// Unregister from the column if any
+	{
+		if (!map.spatial_lock.try_lock_write(BoxBounds2i::from_position(_column_position))) {
+			return false;
+		}
+		SpatialLock2D::UnlockWriteOnScopeExit swlock(map.spatial_lock, BoxBounds2i::from_position(_column_position));
+
+		Column *column = map.columns.find(_column_position);
+		if (column != nullptr) {
+			unregister_from_column(*column, task_scheduler);
+		}
+	}
+
+	return_to_caller(false);
+	return true;
+}
+
+void GenerateColumnMultipassTask::unregister_from_column(Column &column, BufferedTaskScheduler &task_scheduler) {
+	column.pending_subpass_tasks_mask &= ~(1 << _subpass_index);
+
+	// Tasks waiting for us will check again and spawn a new task if needed
+	column.notify_waiters([&task_scheduler](IThreadedTask *task) { //
+		task_scheduler.push_main_task(task);
+	});
+
+	const int final_subpass_index =
+			VoxelGeneratorMultipassCB::get_subpass_count_from_pass_count(_generator_internal->passes.size()) - 1;
+
+	if (_subpass_index == final_subpass_index) {
+		// Schedule pending block requests to make them handle cancellation
+		schedule_final_block_tasks(column, task_scheduler);
+	}
+}
+
 void GenerateColumnMultipassTask::schedule_final_block_tasks(Column &column, BufferedTaskScheduler &task_scheduler) {
 	for (Block &block : column.blocks) {
 		if (block.final_pending_task != nullptr) {
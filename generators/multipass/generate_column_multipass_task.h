@@ -13,9 +13,10 @@ class BufferedTaskScheduler;
 // If at least one column isn't found in the map, the task is cancelled, and so should be all its callers.
 // Otherwise:
 // If a column doesn't fulfills dependency requirements:
-//     - If another task is working on that column, the current task is postponed to run later.
+//     - If the column is loading, the current task is postponed to run later.
+//     - If another task is working on that column, the current task registers itself as a waiter of that column.
 //     - Otherwise, a subtask is spawned to work on the dependency.
-//       The current task is queued after every subtask spawned this way.
+//       The current task is queued after every subtask and column it waits for.
 // Otherwise, the task runs the pass, re-schedules its caller, and returns.
 //
 // One reason to use this pattern instead of "pyramid diffs", is that it can be invoked without assumptions. It will
@@ -53,6 +54,30 @@ public:
 	// bool is_cancelled() {}
 
 private:
+	enum DependencyCheckResult {
+		DEPENDENCIES_READY,
+		// Either postponed, or subtasks were spawned, or the task is waiting for other tasks
+		DEPENDENCIES_NOT_READY,
+		DEPENDENCIES_MISSING_COLUMN
+	};
+
+	// Spawns subtasks for dependencies that no task is working on, and registers the current task as waiting for the
+	// others. Only locks the region for reading.
+	DependencyCheckResult check_dependencies(
+			VoxelGeneratorMultipassCBStructs::Map &map,
+			const Box2i neighbors_box,
+			BufferedTaskScheduler &task_scheduler,
+			std::shared_ptr<std::atomic_int> &out_dependency_counter
+	);
+
+	// Returns false if it has to run again later
+	bool run_cancellation(VoxelGeneratorMultipassCBStructs::Map &map, BufferedTaskScheduler &task_scheduler);
+
+	void unregister_from_column(
+			VoxelGeneratorMultipassCBStructs::Column &column,
+			BufferedTaskScheduler &task_scheduler
+	);
+
 	void schedule_final_block_tasks(
 			VoxelGeneratorMultipassCBStructs::Column &column,
 			BufferedTaskScheduler &task_scheduler
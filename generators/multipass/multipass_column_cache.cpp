@@ -0,0 +1,353 @@
+#include "multipass_column_cache.h"
+#include "../../streams/voxel_block_serializer.h"
+#include "../../util/godot/classes/directory.h"
+#include "../../util/godot/classes/file_access.h"
+#include "../../util/godot/core/array.h"
+#include "../../util/godot/file_utils.h"
+#include "../../util/io/log.h"
+#include "../../util/profiling.h"
+
+namespace zylann::voxel {
+
+namespace {
+const uint8_t FORMAT_VERSION = 0;
+const char *FILE_EXTENSION = "vxmc";
+} // namespace
+
+MultipassColumnCache::MultipassColumnCache(String directory, unsigned int max_columns) :
+		_directory(directory), _max_columns(max_columns) {}
+
+bool MultipassColumnCache::has(Vector2i cpos) const {
+	MutexLock mlock(_mutex);
+	return _entries.find(cpos) != _entries.end();
+}
+
+void MultipassColumnCache::push_pending_save(Vector2i cpos, ColumnData &&data) {
+	MutexLock mlock(_mutex);
+	Entry &entry = _entries[cpos];
+	entry.pending_data = std::move(data);
+	entry.has_pending_data = true;
+	touch(cpos, entry);
+}
+
+bool MultipassColumnCache::save(Vector2i cpos) {
+	ZN_PROFILE_SCOPE();
+
+	ColumnData data;
+	bool init_directory_needed = false;
+	{
+		MutexLock mlock(_mutex);
+
+		if (_expired) {
+			return true;
+		}
+		if (_directory_initializing) {
+			// Files written now could be removed by the thread cleaning up the directory
+			return false;
+		}
+
+		auto it = _entries.find(cpos);
+		if (it == _entries.end()) {
+			// Got loaded back before we had a chance to save it
+			return true;
+		}
+		Entry &entry = it->second;
+		if (!entry.has_pending_data) {
+			return true;
+		}
+		if (entry.busy) {
+			return false;
+		}
+
+		if (!_directory_initialized) {
+			// Done after unlocking, the main thread should not wait for disk I/O
+			_directory_initialized = true;
+			_directory_initializing = true;
+			init_directory_needed = true;
+		}
+
+		data = std::move(entry.pending_data);
+		entry.pending_data.blocks.clear();
+		entry.has_pending_data = false;
+		entry.busy = true;
+	}
+
+	if (init_directory_needed) {
+		init_directory();
+		MutexLock mlock(_mutex);
+		_directory_initializing = false;
+	}
+
+	bool success = false;
+	{
+		const String file_path = get_column_file_path(cpos);
+		Error open_err;
+		Ref<FileAccess> f_ref = zylann::godot::open_file(file_path, FileAccess::WRITE, open_err);
+
+		if (f_ref.is_valid()) {
+			FileAccess &f = **f_ref;
+			f.store_8(FORMAT_VERSION);
+			f.store_8(static_cast<uint8_t>(data.subpass_index));
+			f.store_8(data.blocks.size());
+
+			success = true;
+			for (const VoxelBuffer &voxels : data.blocks) {
+				BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(voxels);
+				if (!res.success) {
+					ZN_PRINT_ERROR("Failed to serialize multipass column block");
+					success = false;
+					break;
+				}
+				f.store_32(res.data.size());
+				zylann::godot::store_buffer(f, to_span(res.data));
+			}
+
+		} else {
+			ERR_PRINT(String("Could not open file {0} to cache multipass column, error {1}")
+							  .format(varray(file_path, open_err)));
+		}
+	}
+
+	StdVector<Vector2i> evicted_columns;
+	{
+		MutexLock mlock(_mutex);
+
+		auto it = _entries.find(cpos);
+		ZN_ASSERT_RETURN_V(it != _entries.end(), true);
+		Entry &entry = it->second;
+		entry.busy = false;
+
+		if (success) {
+			if (!entry.on_disk) {
+				entry.on_disk = true;
+				++_on_disk_count;
+			}
+		} else if (entry.on_disk) {
+			// The previous version of the file can't be trusted anymore
+			entry.on_disk = false;
+			--_on_disk_count;
+		}
+
+		if (!entry.on_disk && !entry.has_pending_data) {
+			erase(cpos, entry);
+		}
+
+		select_least_recently_used_for_eviction(evicted_columns);
+	}
+
+	if (evicted_columns.size() > 0) {
+		remove_evicted_columns(to_span(evicted_columns));
+	}
+
+	return true;
+}
+
+MultipassColumnCache::LoadResult MultipassColumnCache::load(Vector2i cpos, ColumnData &out_data) {
+	ZN_PROFILE_SCOPE();
+
+	{
+		MutexLock mlock(_mutex);
+
+		auto it = _entries.find(cpos);
+		if (it == _entries.end()) {
+			return LOAD_NOT_FOUND;
+		}
+		Entry &entry = it->second;
+
+		if (entry.has_pending_data) {
+			// Not written yet, no need to read the file
+			out_data = std::move(entry.pending_data);
+			entry.pending_data.blocks.clear();
+			entry.has_pending_data = false;
+			if (!entry.on_disk) {
+				// The saving task will find nothing to save
+				erase(cpos, entry);
+			} else {
+				touch(cpos, entry);
+			}
+			return LOAD_FOUND;
+		}
+
+		if (entry.busy) {
+			return LOAD_BUSY;
+		}
+
+		ZN_ASSERT(entry.on_disk);
+		entry.busy = true;
+		touch(cpos, entry);
+	}
+
+	bool success = false;
+	{
+		const String file_path = get_column_file_path(cpos);
+		Error open_err;
+		Ref<FileAccess> f_ref = zylann::godot::open_file(file_path, FileAccess::READ, open_err);
+
+		if (f_ref.is_valid()) {
+			FileAccess &f = **f_ref;
+			const uint8_t version = f.get_8();
+
+			if (version == FORMAT_VERSION) {
+				out_data.subpass_index = static_cast<int8_t>(f.get_8());
+				const unsigned int block_count = f.get_8();
+				out_data.blocks.clear();
+				out_data.blocks.reserve(block_count);
+
+				success = true;
+				for (unsigned int i = 0; i < block_count; ++i) {
+					const uint32_t data_size = f.get_32();
+					out_data.blocks.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_POOL));
+					if (f.eof_reached() ||
+						!BlockSerializer::decompress_and_deserialize(f, data_size, out_data.blocks.back())) {
+						ERR_PRINT(String("Failed to read multipass column from file {0}").format(varray(file_path)));
+						success = false;
+						break;
+					}
+				}
+			} else {
+				ERR_PRINT(String("Unexpected version {0} in multipass column file {1}")
+								  .format(varray(version, file_path)));
+			}
+
+		} else {
+			ERR_PRINT(String("Could not open file {0} to load multipass column, error {1}")
+							  .format(varray(file_path, open_err)));
+		}
+	}
+
+	{
+		MutexLock mlock(_mutex);
+
+		auto it = _entries.find(cpos);
+		ZN_ASSERT_RETURN_V(it != _entries.end(), LOAD_NOT_FOUND);
+		Entry &entry = it->second;
+		entry.busy = false;
+
+		if (!success) {
+			out_data.blocks.clear();
+			entry.on_disk = false;
+			--_on_disk_count;
+			if (!entry.has_pending_data) {
+				erase(cpos, entry);
+			}
+			return LOAD_NOT_FOUND;
+		}
+	}
+
+	// The file is left as is. It will be overwritten if the column gets unloaded again.
+	return LOAD_FOUND;
+}
+
+void MultipassColumnCache::set_expired() {
+	MutexLock mlock(_mutex);
+	_expired = true;
+}
+
+unsigned int MultipassColumnCache::get_stored_column_count() const {
+	MutexLock mlock(_mutex);
+	return _on_disk_count;
+}
+
+String MultipassColumnCache::get_column_file_path(Vector2i cpos) const {
+	return _directory.path_join(
+			String::num_int64(cpos.x) + String("_") + String::num_int64(cpos.y) + String(".") + FILE_EXTENSION
+	);
+}
+
+void MultipassColumnCache::touch(Vector2i cpos, Entry &entry) {
+	if (entry.last_used != 0) {
+		_lru.erase(entry.last_used);
+	}
+	++_use_counter;
+	entry.last_used = _use_counter;
+	_lru[entry.last_used] = cpos;
+}
+
+void MultipassColumnCache::erase(Vector2i cpos, const Entry &entry) {
+	if (entry.last_used != 0) {
+		_lru.erase(entry.last_used);
+	}
+	_entries.erase(cpos);
+}
+
+void MultipassColumnCache::init_directory() {
+	ZN_PROFILE_SCOPE();
+
+	if (zylann::godot::check_directory_created(_directory) != OK) {
+		return;
+	}
+
+	Ref<DirAccess> da = zylann::godot::open_directory(_directory);
+	ZN_ASSERT_RETURN(da.is_valid());
+
+	// Remove files from a previous configuration or session
+	const String ext = String(".") + FILE_EXTENSION;
+	StdVector<String> file_names;
+	da->list_dir_begin();
+	while (true) {
+		const String fname = da->get_next();
+		if (fname == "") {
+			break;
+		}
+		if (!da->current_is_dir() && fname.ends_with(ext)) {
+			file_names.push_back(fname);
+		}
+	}
+	da->list_dir_end();
+
+	for (const String &fname : file_names) {
+		da->remove(_directory.path_join(fname));
+	}
+}
+
+void MultipassColumnCache::select_least_recently_used_for_eviction(StdVector<Vector2i> &out_columns) {
+	if (_on_disk_count <= _max_columns) {
+		return;
+	}
+
+	auto lru_it = _lru.begin();
+	while (_on_disk_count > _max_columns && lru_it != _lru.end()) {
+		const Vector2i cpos = lru_it->second;
+		++lru_it;
+
+		auto it = _entries.find(cpos);
+		ZN_ASSERT_CONTINUE(it != _entries.end());
+		Entry &entry = it->second;
+
+		if (!entry.on_disk || entry.busy) {
+			continue;
+		}
+
+		entry.on_disk = false;
+		// Until its file is removed, the column can't be saved again
+		entry.busy = true;
+		--_on_disk_count;
+		out_columns.push_back(cpos);
+	}
+}
+
+void MultipassColumnCache::remove_evicted_columns(Span<const Vector2i> columns) {
+	ZN_PROFILE_SCOPE();
+
+	Ref<DirAccess> da = zylann::godot::open_directory(_directory);
+	if (da.is_valid()) {
+		for (const Vector2i cpos : columns) {
+			da->remove(get_column_file_path(cpos));
+		}
+	} else {
+		ZN_PRINT_ERROR("Could not open multipass column cache directory to evict columns");
+	}
+
+	MutexLock mlock(_mutex);
+	for (const Vector2i cpos : columns) {
+		auto it = _entries.find(cpos);
+		ZN_ASSERT_CONTINUE(it != _entries.end());
+		Entry &entry = it->second;
+		entry.busy = false;
+		if (!entry.on_disk && !entry.has_pending_data) {
+			erase(cpos, entry);
+		}
+	}
+}
+
+} // namespace zylann::voxel
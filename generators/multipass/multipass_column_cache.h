@@ -0,0 +1,93 @@
+#ifndef VOXEL_MULTIPASS_COLUMN_CACHE_H
+#define VOXEL_MULTIPASS_COLUMN_CACHE_H
+
+#include "../../storage/voxel_buffer.h"
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_map.h"
+#include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/string.h"
+#include "../../util/math/vector2i.h"
+#include "../../util/thread/mutex.h"
+
+namespace zylann::voxel {
+
+// Stores columns of a multipass generator when they get unloaded, so they can resume from their last completed subpass
+// instead of running every pass again when they get loaded back.
+// Each column is stored as one file in a directory. When there are more stored columns than the limit, the least
+// recently used ones are removed.
+// Contents only make sense for the generator configuration they were produced with, so files already present in the
+// directory are removed the first time a column is saved.
+// Thread-safe.
+class MultipassColumnCache {
+public:
+	struct ColumnData {
+		int8_t subpass_index = -1;
+		// Vertical stack of blocks
+		StdVector<VoxelBuffer> blocks;
+	};
+
+	enum LoadResult { //
+		LOAD_FOUND,
+		LOAD_NOT_FOUND,
+		// The column is being written or read by another thread, try again later
+		LOAD_BUSY
+	};
+
+	MultipassColumnCache(String directory, unsigned int max_columns);
+
+	// Cheap check that can be done before scheduling a loading task
+	bool has(Vector2i cpos) const;
+
+	// Keeps column data in memory until `save` is called. Until then, loading it doesn't require reading a file.
+	void push_pending_save(Vector2i cpos, ColumnData &&data);
+
+	// Writes data previously given to `push_pending_save`, if any. Evicts least recently used columns if there are
+	// too many. Returns false if it has to be called again later.
+	bool save(Vector2i cpos);
+
+	LoadResult load(Vector2i cpos, ColumnData &out_data);
+
+	// Called when the generator's configuration changed. The cache stops writing anything, as a new cache will use the
+	// same directory.
+	void set_expired();
+
+	unsigned int get_stored_column_count() const;
+
+private:
+	struct Entry {
+		uint64_t last_used = 0;
+		bool on_disk = false;
+		// Set while the file is being written or read without the mutex locked
+		bool busy = false;
+		bool has_pending_data = false;
+		ColumnData pending_data;
+	};
+
+	String get_column_file_path(Vector2i cpos) const;
+	void touch(Vector2i cpos, Entry &entry);
+	void erase(Vector2i cpos, const Entry &entry);
+	void init_directory();
+	// Must be called with the mutex locked. Selected columns are marked busy until they are removed.
+	void select_least_recently_used_for_eviction(StdVector<Vector2i> &out_columns);
+	// Must be called without the mutex locked, so file removal doesn't block other threads
+	void remove_evicted_columns(Span<const Vector2i> columns);
+
+	const String _directory;
+	const unsigned int _max_columns;
+
+	StdUnorderedMap<Vector2i, Entry> _entries;
+	// Entries sorted by last use
+	StdMap<uint64_t, Vector2i> _lru;
+	uint64_t _use_counter = 0;
+	unsigned int _on_disk_count = 0;
+	bool _directory_initialized = false;
+	// Set while files from a previous configuration are being removed
+	bool _directory_initializing = false;
+	bool _expired = false;
+	mutable Mutex _mutex;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_MULTIPASS_COLUMN_CACHE_H
@@ -0,0 +1,85 @@
+#include "multipass_column_cache_tasks.h"
+#include "../../engine/voxel_engine.h"
+#include "../../util/dstack.h"
+#include "../../util/io/log.h"
+#include "../../util/memory/memory.h"
+#include "../../util/profiling.h"
+
+namespace zylann::voxel {
+
+using namespace VoxelGeneratorMultipassCBStructs;
+
+void SaveMultipassColumnTask::run(ThreadedTaskContext &ctx) {
+	ZN_DSTACK();
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT(_cache != nullptr);
+
+	if (!_cache->save(_column_position)) {
+		// The column is being read by another thread
+		ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+	}
+}
+
+void LoadMultipassColumnTask::run(ThreadedTaskContext &ctx) {
+	ZN_DSTACK();
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT(_generator_internal != nullptr);
+
+	Internal &internal = *_generator_internal;
+	MultipassColumnCache *cache = internal.column_cache.get();
+	ZN_ASSERT(cache != nullptr);
+
+	if (internal.expired) {
+		// Nobody will use that column anymore
+		return;
+	}
+
+	if (!_has_read_cache) {
+		const MultipassColumnCache::LoadResult result = cache->load(_column_position, _data);
+		if (result == MultipassColumnCache::LOAD_BUSY) {
+			ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+			return;
+		}
+		_found = (result == MultipassColumnCache::LOAD_FOUND);
+		_has_read_cache = true;
+	}
+
+	Map &map = internal.map;
+	const BoxBounds2i bounds = BoxBounds2i::from_position(_column_position);
+
+	if (!map.spatial_lock.try_lock_write(bounds)) {
+		ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+		return;
+	}
+	SpatialLock2D::UnlockWriteOnScopeExit swlock(map.spatial_lock, bounds);
+
+	Column *column = map.columns.find(_column_position);
+
+	if (column == nullptr || !column->loading || column->subpass_index != -1) {
+		// The column got unloaded in the meantime, or was loaded by another task.
+		if (_found) {
+			// Don't lose what we took out of the cache
+			cache->push_pending_save(_column_position, std::move(_data));
+			VoxelEngine::get_singleton().push_async_io_task(
+					ZN_NEW(SaveMultipassColumnTask(_column_position, internal.column_cache))
+			);
+		}
+		return;
+	}
+
+	if (_found) {
+		if (_data.blocks.size() == column->blocks.size()) {
+			for (unsigned int i = 0; i < _data.blocks.size(); ++i) {
+				column->blocks[i].voxels = std::move(_data.blocks[i]);
+			}
+			column->subpass_index = _data.subpass_index;
+		} else {
+			ZN_PRINT_ERROR("Cached multipass column doesn't have the expected height, it will be generated again");
+		}
+	}
+
+	// Column tasks can start working on it
+	column->loading = false;
+}
+
+} // namespace zylann::voxel
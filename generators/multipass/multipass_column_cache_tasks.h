@@ -0,0 +1,56 @@
+#ifndef VOXEL_MULTIPASS_COLUMN_CACHE_TASKS_H
+#define VOXEL_MULTIPASS_COLUMN_CACHE_TASKS_H
+
+#include "../../util/math/vector2i.h"
+#include "../../util/tasks/threaded_task.h"
+#include "multipass_column_cache.h"
+#include "voxel_generator_multipass_cb_structs.h"
+
+#include <memory>
+
+namespace zylann::voxel {
+
+// Writes a column that got unloaded from a multipass generator's map into its disk cache
+class SaveMultipassColumnTask : public IThreadedTask {
+public:
+	SaveMultipassColumnTask(Vector2i p_column_position, std::shared_ptr<MultipassColumnCache> p_cache) :
+			_column_position(p_column_position), _cache(p_cache) {}
+
+	const char *get_debug_name() const override {
+		return "SaveMultipassColumnTask";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+
+private:
+	Vector2i _column_position;
+	std::shared_ptr<MultipassColumnCache> _cache;
+};
+
+// Restores a column of a multipass generator's map from its disk cache. The column must have been created with
+// `loading` set to `true`, so column tasks wait for this task to finish before processing it.
+class LoadMultipassColumnTask : public IThreadedTask {
+public:
+	LoadMultipassColumnTask(
+			Vector2i p_column_position,
+			std::shared_ptr<VoxelGeneratorMultipassCBStructs::Internal> p_generator_internal
+	) :
+			_column_position(p_column_position), _generator_internal(p_generator_internal) {}
+
+	const char *get_debug_name() const override {
+		return "LoadMultipassColumnTask";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+
+private:
+	Vector2i _column_position;
+	bool _has_read_cache = false;
+	bool _found = false;
+	MultipassColumnCache::ColumnData _data;
+	std::shared_ptr<VoxelGeneratorMultipassCBStructs::Internal> _generator_internal;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_MULTIPASS_COLUMN_CACHE_TASKS_H
@@ -1,5 +1,6 @@
 #include "voxel_generator_multipass_cb.h"
 #include "../../engine/buffered_task_scheduler.h"
+#include "../../engine/voxel_engine.h"
 #include "../../util/containers/container_funcs.h"
 #include "../../util/dstack.h"
 #include "../../util/godot/check_ref_ownership.h"
@@ -8,6 +9,8 @@
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "generate_block_multipass_cb_task.h"
+#include "multipass_column_cache.h"
+#include "multipass_column_cache_tasks.h"
 
 namespace zylann::voxel {
 
@@ -156,6 +159,52 @@ void VoxelGeneratorMultipassCB::set_pass_extent_blocks(int pass_index, int new_e
 	re_initialize_column_refcounts();
 }
 
+String VoxelGeneratorMultipassCB::get_column_cache_directory() const {
+	return get_internal()->column_cache_directory;
+}
+
+void VoxelGeneratorMultipassCB::set_column_cache_directory(String directory) {
+	if (get_column_cache_directory() == directory) {
+		return;
+	}
+	reset_internal([directory](Internal &internal) { //
+		internal.column_cache_directory = directory;
+	});
+	re_initialize_column_refcounts();
+}
+
+int VoxelGeneratorMultipassCB::get_column_cache_max_columns() const {
+	return get_internal()->column_cache_max_columns;
+}
+
+void VoxelGeneratorMultipassCB::set_column_cache_max_columns(int max_columns) {
+	ZN_ASSERT_RETURN(max_columns >= 0);
+	if (get_column_cache_max_columns() == max_columns) {
+		return;
+	}
+	reset_internal([max_columns](Internal &internal) { //
+		internal.column_cache_max_columns = max_columns;
+	});
+	re_initialize_column_refcounts();
+}
+
+void VoxelGeneratorMultipassCB::create_column_cache(Internal &internal) {
+	if (internal.column_cache_directory.is_empty() || internal.column_cache_max_columns == 0) {
+		internal.column_cache = nullptr;
+		return;
+	}
+	internal.column_cache = make_shared_instance<MultipassColumnCache>(
+			internal.column_cache_directory, internal.column_cache_max_columns
+	);
+}
+
+void VoxelGeneratorMultipassCB::expire_column_cache(Internal &internal) {
+	// Tasks of the old cache may still be running. Prevent them from writing into the directory of the new one.
+	if (internal.column_cache != nullptr) {
+		internal.column_cache->set_expired();
+	}
+}
+
 // Internal
 
 std::shared_ptr<Internal> VoxelGeneratorMultipassCB::get_internal() const {
@@ -285,15 +334,23 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 
 	// Blocks to view
 	const int column_height = internal->column_height_blocks;
-	load_requested_box.difference(prev_load_requested_box, [&map, column_height](Box2i new_box) {
+	load_requested_box.difference(prev_load_requested_box, [&map, column_height, &internal](Box2i new_box) {
 		{
 			SpatialLock2D::Write swlock(map.spatial_lock, new_box);
-			MutexLock mlock(map.mutex);
 
-			new_box.for_each_cell_yx([&map, column_height](Vector2i bpos) {
-				Column &column = map.columns[bpos];
+			new_box.for_each_cell_yx([&map, column_height, &internal](Vector2i bpos) {
+				Column &column = map.columns.get_or_create(bpos);
 				if (column.blocks.size() == 0) {
 					column.blocks.resize(column_height);
+
+					if (internal->column_cache != nullptr && internal->column_cache->has(bpos)) {
+						// Resume from the state the column had when it was unloaded.
+						// Column tasks will wait until it's done.
+						column.loading = true;
+						VoxelEngine::get_singleton().push_async_io_task(
+								ZN_NEW(LoadMultipassColumnTask(bpos, internal))
+						);
+					}
 				}
 				// if (block == nullptr) {
 				// 	block = make_unique_instance<Block>();
@@ -307,17 +364,16 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 	});
 
 	// Blocks to unview
-	prev_load_requested_box.difference(load_requested_box, [&map, &task_scheduler](Box2i old_box) {
+	prev_load_requested_box.difference(load_requested_box, [&map, &task_scheduler, &internal](Box2i old_box) {
 		{
 			SpatialLock2D::Write swlock(map.spatial_lock, old_box);
-			MutexLock mlock(map.mutex);
 
-			old_box.for_each_cell_yx([&map, &task_scheduler](Vector2i cpos) {
-				auto it = map.columns.find(cpos);
+			old_box.for_each_cell_yx([&map, &task_scheduler, &internal](Vector2i cpos) {
+				Column *column_ptr = map.columns.find(cpos);
 
 				// The block must be found because last time the block was in the loading area of the viewer.
-				ZN_ASSERT(it != map.columns.end());
-				Column &column = it->second;
+				ZN_ASSERT(column_ptr != nullptr);
+				Column &column = *column_ptr;
 
 				column.viewers.remove();
 				if (column.viewers.get() == 0) {
@@ -331,9 +387,27 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 						}
 					}
 
-					// TODO Implement saving tasks
-					// We remove immediately for now
-					map.columns.erase(it);
+					// Tasks waiting for this column resume too, they will find it's gone and cancel
+					column.notify_waiters([&task_scheduler](IThreadedTask *task) { //
+						task_scheduler.push_main_task(task);
+					});
+
+					if (internal->column_cache != nullptr && !column.loading && column.subpass_index >= 0) {
+						// Keep what was generated so far, so it doesn't have to run again if the column gets
+						// loaded back. Ongoing tasks can't be using these blocks, since the area is locked.
+						MultipassColumnCache::ColumnData data;
+						data.subpass_index = column.subpass_index;
+						data.blocks.reserve(column.blocks.size());
+						for (Block &block : column.blocks) {
+							data.blocks.push_back(std::move(block.voxels));
+						}
+						internal->column_cache->push_pending_save(cpos, std::move(data));
+						VoxelEngine::get_singleton().push_async_io_task(
+								ZN_NEW(SaveMultipassColumnTask(cpos, internal->column_cache))
+						);
+					}
+
+					map.columns.erase(cpos);
 					// println(format("U {} {} {} {} {}", 0, cpos.x, 0, cpos.y,
 					// Time::get_singleton()->get_ticks_usec()));
 				}
@@ -382,14 +456,7 @@ bool VoxelGeneratorMultipassCB::debug_try_get_column_states(StdVector<DebugColum
 	std::shared_ptr<Internal> internal = get_internal();
 	Map &map = internal->map;
 
-	{
-		unsigned int size = 0;
-		{
-			MutexLock mlock(map.mutex);
-			size = map.columns.size();
-		}
-		out_states.reserve(size);
-	}
+	out_states.reserve(map.columns.size());
 
 	if (!map.spatial_lock.try_lock_read(BoxBounds2i::from_everywhere())) {
 		// Don't hang here on the main thread, while generating it's very likely the map is locked somewhere.
@@ -398,12 +465,9 @@ bool VoxelGeneratorMultipassCB::debug_try_get_column_states(StdVector<DebugColum
 	}
 	SpatialLock2D::UnlockReadOnScopeExit srlock(map.spatial_lock, BoxBounds2i::from_everywhere());
 
-	MutexLock mlock(map.mutex);
-
-	for (auto it = map.columns.begin(); it != map.columns.end(); ++it) {
-		Column &column = it->second;
-		out_states.push_back(DebugColumnState{ it->first, column.subpass_index, uint8_t(column.viewers.get()) });
-	}
+	map.columns.for_each([&out_states](Vector2i cpos, const Column &column) {
+		out_states.push_back(DebugColumnState{ cpos, column.subpass_index, uint8_t(column.viewers.get()) });
+	});
 
 	return true;
 }
@@ -630,6 +694,22 @@ void VoxelGeneratorMultipassCB::_bind_methods() {
 			D_METHOD("set_column_height_blocks", "y"), &VoxelGeneratorMultipassCB::set_column_height_blocks
 	);
 
+	ClassDB::bind_method(
+			D_METHOD("get_column_cache_directory"), &VoxelGeneratorMultipassCB::get_column_cache_directory
+	);
+	ClassDB::bind_method(
+			D_METHOD("set_column_cache_directory", "directory"),
+			&VoxelGeneratorMultipassCB::set_column_cache_directory
+	);
+
+	ClassDB::bind_method(
+			D_METHOD("get_column_cache_max_columns"), &VoxelGeneratorMultipassCB::get_column_cache_max_columns
+	);
+	ClassDB::bind_method(
+			D_METHOD("set_column_cache_max_columns", "count"),
+			&VoxelGeneratorMultipassCB::set_column_cache_max_columns
+	);
+
 	ClassDB::bind_method(
 			D_METHOD("debug_generate_test_column", "column_position_blocks"),
 			&VoxelGeneratorMultipassCB::debug_generate_test_column
@@ -658,6 +738,20 @@ void VoxelGeneratorMultipassCB::_bind_methods() {
 			"get_pass_count"
 	);
 
+	ADD_GROUP("Column cache", "column_cache_");
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::STRING, "column_cache_directory", PROPERTY_HINT_DIR),
+			"set_column_cache_directory",
+			"get_column_cache_directory"
+	);
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "column_cache_max_columns", PROPERTY_HINT_RANGE, "0,65536,1,or_greater"),
+			"set_column_cache_max_columns",
+			"get_column_cache_max_columns"
+	);
+
 	BIND_CONSTANT(MAX_PASSES);
 	BIND_CONSTANT(MAX_PASS_EXTENT);
 }
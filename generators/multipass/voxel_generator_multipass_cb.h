@@ -84,6 +84,12 @@ public:
 	int get_pass_extent_blocks(int pass_index) const;
 	void set_pass_extent_blocks(int pass_index, int new_extent);
 
+	String get_column_cache_directory() const;
+	void set_column_cache_directory(String directory);
+
+	int get_column_cache_max_columns() const;
+	void set_column_cache_max_columns(int max_columns);
+
 	// Run the generator to get a particular column from scratch, using a single thread for better script debugging
 	// (since Godot 4 still doesn't support debugging scripts in different threads, at time of writing). This doesn't
 	// use the internal cache and can be extremely slow.
@@ -131,6 +137,8 @@ private:
 	void process_viewer_diff_internal(Box3i p_requested_box, Box3i p_prev_requested_box);
 	void re_initialize_column_refcounts();
 	void generate_block_fallback_script(VoxelQueryData &input);
+	static void create_column_cache(VoxelGeneratorMultipassCBStructs::Internal &internal);
+	static void expire_column_cache(VoxelGeneratorMultipassCBStructs::Internal &internal);
 
 	// This must be called each time the structure of passes changes (number of passes, extents)
 	template <typename F>
@@ -144,12 +152,17 @@ private:
 
 		f(*new_internal);
 
+		// Cached columns only make sense with the configuration that produced them
+		create_column_cache(*new_internal);
+
 		{
 			MutexLock mlock(_internal_mutex);
 			_internal = new_internal;
 			old_internal->expired = true;
 		}
 
+		expire_column_cache(*old_internal);
+
 		// Note, resetting the cache also means we lost all viewer refcounts in columns, which could be different now.
 		// For example if pass count or extents have changed, viewers will need to reference a larger area.
 		// Depending on the context, we may call `re_initialize_column_refcounts()`.
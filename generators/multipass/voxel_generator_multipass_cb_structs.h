@@ -2,16 +2,21 @@
 #define VOXEL_GENERATOR_MULTIPASS_CB_STRUCTS_H
 
 #include "../../storage/voxel_buffer.h"
+#include "../../util/containers/fixed_array.h"
 #include "../../util/containers/small_vector.h"
 #include "../../util/containers/span.h"
 #include "../../util/containers/std_unordered_map.h"
 #include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/string.h"
 #include "../../util/math/vector2i.h"
 #include "../../util/math/vector3i.h"
 #include "../../util/ref_count.h"
 #include "../../util/thread/mutex.h"
+#include "../../util/thread/short_lock.h"
 #include "../../util/thread/spatial_lock_2d.h"
 
+#include <atomic>
+#include <memory>
 #include <utility>
 
 // Data structures used internally in multipass generation.
@@ -25,6 +30,9 @@ namespace zylann {
 class IThreadedTask;
 
 namespace voxel {
+
+class MultipassColumnCache;
+
 namespace VoxelGeneratorMultipassCBStructs {
 
 // Pass limit is pretty low because in practice not that many should be needed, and it gets expensive really quick
@@ -66,16 +74,31 @@ struct Block {
 	}
 };
 
+// Task waiting for a column to progress
+struct ColumnWaiter {
+	IThreadedTask *task;
+	// The task gets scheduled when this reaches zero
+	std::shared_ptr<std::atomic_int> dependency_counter;
+};
+
 struct Column {
 	RefCount viewers;
 	// Index of the last subpass that was executed directly on this chunk.
 	// -1 means the chunk just got created and no subpass has run on it yet.
-	int8_t subpass_index = -1;
+	// Only increases while the column exists. Can be read while the column is locked for reading in the map's spatial
+	// lock, but is only modified while it is locked for writing.
+	std::atomic_int8_t subpass_index = { -1 };
 	bool saving = false;
 	bool loading = false;
 
 	// Each bit is set to 1 when a task is pending to process this block at a given subpass.
-	uint8_t pending_subpass_tasks_mask = 0;
+	// Tasks claim a bit atomically before spawning a subtask, so only one task gets spawned per subpass even when
+	// checking dependencies concurrently.
+	std::atomic_uint8_t pending_subpass_tasks_mask = { 0 };
+
+	// Tasks waiting for a pending subpass task of this column to finish or cancel, instead of polling it.
+	StdVector<ColumnWaiter> waiters;
+	ShortLock waiters_lock;
 
 	// Currently unused, because if chunks get removed from the cache or don't get saved for any reason,
 	// it can become out of sync and we wouldn't know. It would be a nice optimization tho...
@@ -90,15 +113,125 @@ struct Column {
 	// TODO Maybe replace with a dynamic non-resizeable array?
 	StdVector<Block> blocks;
 
+	Column() {}
+
+	// Columns are only moved when they are not shared with other threads
+	Column(Column &&other) {
+		viewers = other.viewers;
+		subpass_index = other.subpass_index.load();
+		saving = other.saving;
+		loading = other.loading;
+		pending_subpass_tasks_mask = other.pending_subpass_tasks_mask.load();
+		waiters = std::move(other.waiters);
+		blocks = std::move(other.blocks);
+	}
+
+	~Column() {
+		ZN_ASSERT_RETURN_MSG(waiters.size() == 0, "Unhandled waiting tasks leaked!");
+	}
+
+	// Registers a task to be scheduled when the pending task working on this column at `subpass_index` finishes.
+	// Returns false if the column already reached that subpass, in which case the task was not registered.
+	bool add_waiter(int p_subpass_index, const ColumnWaiter &waiter) {
+		ShortLockScope slock(waiters_lock);
+		// Checked while locked, so we can't miss the notification of a task finishing at the same time
+		if (subpass_index >= p_subpass_index) {
+			return false;
+		}
+		waiters.push_back(waiter);
+		return true;
+	}
+
+	// Must be called after a pending task stopped working on this column, whether it completed or not
+	template <typename F>
+	void notify_waiters(F schedule_func) {
+		StdVector<ColumnWaiter> waiters_to_notify;
+		{
+			ShortLockScope slock(waiters_lock);
+			if (waiters.size() == 0) {
+				return;
+			}
+			waiters_to_notify = std::move(waiters);
+			waiters.clear();
+		}
+		for (ColumnWaiter &waiter : waiters_to_notify) {
+			if (--(*waiter.dependency_counter) == 0) {
+				schedule_func(waiter.task);
+			}
+		}
+	}
+
 	// Column() {
 	// 	fill(subpass_iterations, uint8_t(0));
 	// }
 };
 
+// Columns are spread into shards by position, each with their own mutex, so threads looking up columns don't all
+// contend on the same mutex. Columns don't move in memory once created, until they are erased.
+class ColumnMap {
+public:
+	static const unsigned int SHARD_COUNT = 16;
+
+	Column *find(Vector2i pos) {
+		Shard &shard = get_shard(pos);
+		MutexLock mlock(shard.mutex);
+		auto it = shard.columns.find(pos);
+		if (it == shard.columns.end()) {
+			return nullptr;
+		}
+		return &it->second;
+	}
+
+	Column &get_or_create(Vector2i pos) {
+		Shard &shard = get_shard(pos);
+		MutexLock mlock(shard.mutex);
+		return shard.columns[pos];
+	}
+
+	void erase(Vector2i pos) {
+		Shard &shard = get_shard(pos);
+		MutexLock mlock(shard.mutex);
+		shard.columns.erase(pos);
+	}
+
+	size_t size() const {
+		size_t count = 0;
+		for (const Shard &shard : _shards) {
+			MutexLock mlock(shard.mutex);
+			count += shard.columns.size();
+		}
+		return count;
+	}
+
+	// Shards are locked one after the other, not all at once
+	template <typename F>
+	void for_each(F f) {
+		for (Shard &shard : _shards) {
+			MutexLock mlock(shard.mutex);
+			for (auto it = shard.columns.begin(); it != shard.columns.end(); ++it) {
+				f(it->first, it->second);
+			}
+		}
+	}
+
+private:
+	struct Shard {
+		StdUnorderedMap<Vector2i, Column> columns;
+		// Protects the hashmap itself
+		BinaryMutex mutex;
+	};
+
+	inline Shard &get_shard(Vector2i pos) {
+		// Neighbor columns go to different shards
+		const uint32_t h = (static_cast<uint32_t>(pos.x) * 73856093u) ^ (static_cast<uint32_t>(pos.y) * 19349663u);
+		return _shards[h % SHARD_COUNT];
+	}
+
+	FixedArray<Shard, SHARD_COUNT> _shards;
+};
+
 struct Map {
-	StdUnorderedMap<Vector2i, Column> columns;
-	// Protects the hashmap itself
-	Mutex mutex;
+	ColumnMap columns;
 	// Protects columns
 	mutable SpatialLock2D spatial_lock;
 
@@ -137,6 +270,12 @@ struct Internal {
 	SmallVector<Pass, MAX_PASSES> passes;
 	int column_base_y_blocks = -4;
 	int column_height_blocks = 8;
+	// If not empty, columns are cached in this directory when they get unloaded
+	String column_cache_directory;
+	unsigned int column_cache_max_columns = 4096;
+
+	// Created from the above params, can be null
+	std::shared_ptr<MultipassColumnCache> column_cache;
 
 	// Set to `true` if the generator's configuration changed. Means a new instance of Internal has been made.
 	// Existing tasks may still finish their work using the old instance, but results will be thrown away. Such
@@ -152,6 +291,8 @@ struct Internal {
 		passes = other.passes;
 		column_base_y_blocks = other.column_base_y_blocks;
 		column_height_blocks = other.column_height_blocks;
+		column_cache_directory = other.column_cache_directory;
+		column_cache_max_columns = other.column_cache_max_columns;
 	}
 };
 
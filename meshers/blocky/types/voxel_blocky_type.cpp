@@ -409,6 +409,8 @@ void VoxelBlockyType::bake(StdVector<VoxelBlockyModel::BakedData> &out_models, S
 			baked_model.transparency_index = _base_model->get_transparency_index();
 			baked_model.box_collision_mask |= _base_model->get_collision_mask();
 			baked_model.is_random_tickable |= _base_model->is_random_tickable();
+			baked_model.light_emission =
+					math::max(baked_model.light_emission, uint8_t(_base_model->get_light_emission()));
 		}
 	}
 
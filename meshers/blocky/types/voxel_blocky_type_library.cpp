@@ -101,6 +101,7 @@ void VoxelBlockyTypeLibrary::bake() {
 	}
 
 	_baked_data.indexed_materials_count = _indexed_materials.size();
+	++_baked_data.bake_version;
 
 	generate_side_culling_matrix(_baked_data);
 
@@ -67,6 +67,7 @@ void VoxelBlockyLibrary::bake() {
 	}
 
 	_baked_data.indexed_materials_count = _indexed_materials.size();
+	++_baked_data.bake_version;
 
 	generate_side_culling_matrix(_baked_data);
 
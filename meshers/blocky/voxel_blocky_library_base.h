@@ -46,6 +46,9 @@ public:
 
 		unsigned int indexed_materials_count = 0;
 
+		// Incremented every time the library is baked, so users caching baked data can tell when it changed
+		uint32_t bake_version = 0;
+
 		inline bool has_model(uint32_t i) const {
 			return i < models.size();
 		}
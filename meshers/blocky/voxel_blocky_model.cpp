@@ -240,6 +240,7 @@ void VoxelBlockyModel::bake(BakedData &baked_data, bool bake_tangents, MaterialI
 	baked_data.culls_neighbors = _culls_neighbors;
 	baked_data.color = _color;
 	baked_data.is_random_tickable = _random_tickable;
+	baked_data.light_emission = _light_emission;
 	baked_data.box_collision_mask = _collision_mask;
 	baked_data.box_collision_aabbs = _collision_aabbs;
 
@@ -332,6 +333,14 @@ bool VoxelBlockyModel::is_random_tickable() const {
 	return _random_tickable;
 }
 
+void VoxelBlockyModel::set_light_emission(int level) {
+	_light_emission = math::clamp(level, 0, 15);
+}
+
+int VoxelBlockyModel::get_light_emission() const {
+	return _light_emission;
+}
+
 bool VoxelBlockyModel::is_empty() const {
 	ZN_PRINT_ERROR("Not implemented");
 	// Implemented in child classes
@@ -344,6 +353,7 @@ void VoxelBlockyModel::copy_base_properties_from(const VoxelBlockyModel &src) {
 	_transparency_index = src._transparency_index;
 	_culls_neighbors = src._culls_neighbors;
 	_random_tickable = src._random_tickable;
+	_light_emission = src._light_emission;
 	_color = src._color;
 	_collision_aabbs = src._collision_aabbs;
 	_collision_mask = src._collision_mask;
@@ -550,6 +560,9 @@ void VoxelBlockyModel::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("is_random_tickable"), &VoxelBlockyModel::is_random_tickable);
 	ClassDB::bind_method(D_METHOD("set_random_tickable"), &VoxelBlockyModel::set_random_tickable);
 
+	ClassDB::bind_method(D_METHOD("set_light_emission", "level"), &VoxelBlockyModel::set_light_emission);
+	ClassDB::bind_method(D_METHOD("get_light_emission"), &VoxelBlockyModel::get_light_emission);
+
 	ClassDB::bind_method(
 			D_METHOD("set_mesh_collision_enabled", "surface_index", "enabled"),
 			&VoxelBlockyModel::set_mesh_collision_enabled
@@ -578,6 +591,11 @@ void VoxelBlockyModel::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "transparency_index"), "set_transparency_index", "get_transparency_index");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "culls_neighbors"), "set_culls_neighbors", "get_culls_neighbors");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "random_tickable"), "set_random_tickable", "is_random_tickable");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "light_emission", PROPERTY_HINT_RANGE, "0,15"),
+			"set_light_emission",
+			"get_light_emission"
+	);
 
 	ADD_GROUP("Box collision", "");
 
@@ -108,6 +108,8 @@ public:
 		bool empty;
 		bool is_random_tickable;
 		bool is_transparent;
+		// Light level emitted by voxels of this model, from 0 to 15
+		uint8_t light_emission;
 
 		uint32_t box_collision_mask;
 		StdVector<AABB> box_collision_aabbs;
@@ -171,6 +173,9 @@ public:
 	void set_random_tickable(bool rt);
 	bool is_random_tickable() const;
 
+	void set_light_emission(int level);
+	int get_light_emission() const;
+
 	//------------------------------------------
 	// Properties for internal usage only
 
@@ -255,6 +260,7 @@ private:
 	// can be useful for denser transparent voxels, such as foliage.
 	bool _culls_neighbors = true;
 	bool _random_tickable = false;
+	uint8_t _light_emission = 0;
 
 	Color _color;
 
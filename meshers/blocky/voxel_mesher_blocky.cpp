@@ -1,6 +1,8 @@
 #include "voxel_mesher_blocky.h"
 #include "../../constants/cube_tables.h"
+#include "../../edition/blocky_lighting.h"
 #include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_buffer_gd.h"
 #include "../../util/containers/span.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/godot/core/packed_arrays.h"
@@ -54,6 +56,60 @@ inline bool contributes_to_ao(const VoxelBlockyLibraryBase::BakedData &lib, uint
 	return true;
 }
 
+// Brightness of each light level. Each level is 80% as bright as the next one.
+const float g_light_level_brightness[blocky_light::MAX_LEVEL + 1] = {
+	0.035184f, 0.043980f, 0.054976f, 0.068719f, 0.085899f, 0.107374f, 0.134218f, 0.167772f, //
+	0.209715f, 0.262144f, 0.327680f, 0.409600f, 0.512000f, 0.640000f, 0.800000f, 1.f //
+};
+
+inline Color get_light_color(Span<const uint8_t> light_levels, int voxel_index) {
+	if (light_levels.size() == 0) {
+		return Color(1, 1, 1);
+	}
+	const float b = g_light_level_brightness[light_levels[voxel_index]];
+	return Color(b, b, b);
+}
+
+// Gets the highest of sky and block light for each voxel
+bool get_light_levels(const VoxelBuffer &voxels, VoxelBuffer::ChannelId channel, StdVector<uint8_t> &out_levels) {
+	const unsigned int volume = Vector3iUtil::get_volume(voxels.get_size());
+	out_levels.resize(volume);
+
+	if (voxels.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_UNIFORM) {
+		const uint8_t v = voxels.get_voxel(Vector3i(), channel);
+		const uint8_t level = math::max(blocky_light::get_sky(v), blocky_light::get_block(v));
+		for (unsigned int i = 0; i < volume; ++i) {
+			out_levels[i] = level;
+		}
+		return true;
+	}
+
+	switch (voxels.get_channel_depth(channel)) {
+		case VoxelBuffer::DEPTH_8_BIT: {
+			Span<const uint8_t> src;
+			ZN_ASSERT_RETURN_V(voxels.get_channel_data_read_only(channel, src), false);
+			for (unsigned int i = 0; i < volume; ++i) {
+				out_levels[i] = math::max(blocky_light::get_sky(src[i]), blocky_light::get_block(src[i]));
+			}
+		} break;
+
+		case VoxelBuffer::DEPTH_16_BIT: {
+			Span<const uint16_t> src;
+			ZN_ASSERT_RETURN_V(voxels.get_channel_data_read_only(channel, src), false);
+			for (unsigned int i = 0; i < volume; ++i) {
+				const uint8_t v = src[i];
+				out_levels[i] = math::max(blocky_light::get_sky(v), blocky_light::get_block(v));
+			}
+		} break;
+
+		default:
+			ZN_PRINT_ERROR("Unsupported depth for light levels");
+			return false;
+	}
+
+	return true;
+}
+
 StdVector<int> &get_tls_index_offsets() {
 	static thread_local StdVector<int> tls_index_offsets;
 	return tls_index_offsets;
@@ -69,7 +125,9 @@ void generate_blocky_mesh( //
 		const Vector3i block_size, //
 		const VoxelBlockyLibraryBase::BakedData &library, //
 		bool bake_occlusion, //
-		float baked_occlusion_darkness //
+		float baked_occlusion_darkness, //
+		// Empty if lighting is disabled
+		const Span<const uint8_t> light_levels //
 ) {
 	// TODO Optimization: not sure if this mandates a template function. There is so much more happening in this
 	// function other than reading voxels, although reading is on the hottest path. It needs to be profiled. If
@@ -277,7 +335,9 @@ void generate_blocky_mesh( //
 							const int append_index = arrays.colors.size();
 							arrays.colors.resize(arrays.colors.size() + vertex_count);
 							Color *w = arrays.colors.data() + append_index;
-							const Color modulate_color = voxel.color;
+							// Faces are lit by the voxel they face
+							const Color modulate_color =
+									voxel.color * get_light_color(light_levels, voxel_index + side_neighbor_lut[side]);
 
 							if (bake_occlusion) {
 								for (unsigned int i = 0; i < vertex_count; ++i) {
@@ -372,7 +432,7 @@ void generate_blocky_mesh( //
 
 					const StdVector<Vector3f> &positions = surface.positions;
 					const unsigned int vertex_count = positions.size();
-					const Color modulate_color = voxel.color;
+					const Color modulate_color = voxel.color * get_light_color(light_levels, voxel_index);
 
 					const StdVector<Vector3f> &normals = surface.normals;
 					const StdVector<Vector2f> &uvs = surface.uvs;
@@ -663,6 +723,37 @@ bool VoxelMesherBlocky::get_occlusion_enabled() const {
 	return _parameters.bake_occlusion;
 }
 
+void VoxelMesherBlocky::set_lighting_enabled(bool enable) {
+	RWLockWrite wlock(_parameters_lock);
+	_parameters.lighting_enabled = enable;
+}
+
+bool VoxelMesherBlocky::get_lighting_enabled() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.lighting_enabled;
+}
+
+void VoxelMesherBlocky::set_light_channel(VoxelBuffer::ChannelId channel) {
+	ERR_FAIL_INDEX(channel, VoxelBuffer::MAX_CHANNELS);
+	ERR_FAIL_COND_MSG(channel == VoxelBuffer::CHANNEL_TYPE, "The TYPE channel can't be used for light");
+	RWLockWrite wlock(_parameters_lock);
+	_parameters.light_channel = channel;
+}
+
+VoxelBuffer::ChannelId VoxelMesherBlocky::get_light_channel() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.light_channel;
+}
+
+void VoxelMesherBlocky::_b_set_light_channel(int channel) {
+	ERR_FAIL_INDEX(channel, VoxelBuffer::MAX_CHANNELS);
+	set_light_channel(VoxelBuffer::ChannelId(channel));
+}
+
+int VoxelMesherBlocky::_b_get_light_channel() const {
+	return get_light_channel();
+}
+
 void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::Input &input) {
 	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
 	Parameters params;
@@ -732,6 +823,14 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 	const Vector3i block_size = voxels.get_size();
 	const VoxelBuffer::Depth channel_depth = voxels.get_channel_depth(channel);
 
+	Span<const uint8_t> light_levels;
+	if (params.lighting_enabled) {
+		if (!get_light_levels(voxels, params.light_channel, cache.light_levels)) {
+			return;
+		}
+		light_levels = to_span(cache.light_levels);
+	}
+
 	VoxelMesher::Output::CollisionSurface *collision_surface = nullptr;
 	if (input.collision_hint) {
 		collision_surface = &output.collision_surface;
@@ -758,7 +857,8 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 						block_size, //
 						library_baked_data, //
 						params.bake_occlusion, //
-						baked_occlusion_darkness //
+						baked_occlusion_darkness, //
+						light_levels //
 				);
 				if (input.lod_index > 0) {
 					append_seams(raw_channel, block_size, arrays_per_material, library_baked_data);
@@ -774,7 +874,8 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 						block_size,
 						library_baked_data,
 						params.bake_occlusion,
-						baked_occlusion_darkness
+						baked_occlusion_darkness,
+						light_levels
 				);
 				if (input.lod_index > 0) {
 					append_seams(model_ids, block_size, arrays_per_material, library_baked_data);
@@ -870,6 +971,10 @@ Ref<Resource> VoxelMesherBlocky::duplicate(bool p_subresources) const {
 }
 
 int VoxelMesherBlocky::get_used_channels_mask() const {
+	RWLockRead rlock(_parameters_lock);
+	if (_parameters.lighting_enabled) {
+		return (1 << VoxelBuffer::CHANNEL_TYPE) | (1 << _parameters.light_channel);
+	}
 	return (1 << VoxelBuffer::CHANNEL_TYPE);
 }
 
@@ -927,6 +1032,12 @@ void VoxelMesherBlocky::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_occlusion_darkness", "value"), &VoxelMesherBlocky::set_occlusion_darkness);
 	ClassDB::bind_method(D_METHOD("get_occlusion_darkness"), &VoxelMesherBlocky::get_occlusion_darkness);
 
+	ClassDB::bind_method(D_METHOD("set_lighting_enabled", "enable"), &VoxelMesherBlocky::set_lighting_enabled);
+	ClassDB::bind_method(D_METHOD("get_lighting_enabled"), &VoxelMesherBlocky::get_lighting_enabled);
+
+	ClassDB::bind_method(D_METHOD("set_light_channel", "channel"), &VoxelMesherBlocky::_b_set_light_channel);
+	ClassDB::bind_method(D_METHOD("get_light_channel"), &VoxelMesherBlocky::_b_get_light_channel);
+
 	ADD_PROPERTY(
 			PropertyInfo(
 					Variant::OBJECT,
@@ -947,6 +1058,17 @@ void VoxelMesherBlocky::_bind_methods() {
 			"set_occlusion_darkness",
 			"get_occlusion_darkness"
 	);
+
+	ADD_GROUP("Lighting", "");
+
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "lighting_enabled"), "set_lighting_enabled", "get_lighting_enabled");
+	ADD_PROPERTY(
+			PropertyInfo(
+					Variant::INT, "light_channel", PROPERTY_HINT_ENUM, godot::VoxelBuffer::CHANNEL_ID_HINT_STRING
+			),
+			"set_light_channel",
+			"get_light_channel"
+	);
 }
 
 } // namespace zylann::voxel
@@ -1,6 +1,7 @@
 #ifndef VOXEL_MESHER_BLOCKY_H
 #define VOXEL_MESHER_BLOCKY_H
 
+#include "../../storage/voxel_buffer.h"
 #include "../../util/godot/classes/mesh.h"
 #include "../../util/thread/rw_lock.h"
 #include "../voxel_mesher.h"
@@ -30,6 +31,12 @@ public:
 	void set_occlusion_enabled(bool enable);
 	bool get_occlusion_enabled() const;
 
+	void set_lighting_enabled(bool enable);
+	bool get_lighting_enabled() const;
+
+	void set_light_channel(VoxelBuffer::ChannelId channel);
+	VoxelBuffer::ChannelId get_light_channel() const;
+
 	void build(VoxelMesher::Output &output, const VoxelMesher::Input &input) override;
 
 	// TODO GDX: Resource::duplicate() cannot be overriden (while it can in modules).
@@ -77,18 +84,29 @@ public:
 		return true;
 	}
 
+	CollisionSimplification get_collision_simplification() const override {
+		return COLLISION_SIMPLIFICATION_MERGE_QUADS;
+	}
+
 protected:
 	static void _bind_methods();
 
 private:
+	void _b_set_light_channel(int channel);
+	int _b_get_light_channel() const;
+
 	struct Parameters {
 		float baked_occlusion_darkness = 0.8;
 		bool bake_occlusion = true;
+		// If enabled, vertex colors are darkened using light levels found in `light_channel`
+		bool lighting_enabled = false;
+		VoxelBuffer::ChannelId light_channel = VoxelBuffer::CHANNEL_DATA5;
 		Ref<VoxelBlockyLibraryBase> library;
 	};
 
 	struct Cache {
 		StdVector<Arrays> arrays_per_material;
+		StdVector<uint8_t> light_levels;
 	};
 
 	// Parameters
@@ -0,0 +1,551 @@
+#include "collision_simplification.h"
+#include "../util/containers/std_unordered_map.h"
+#include "../util/godot/core/packed_arrays.h"
+#include "../util/math/conv.h"
+#include "../util/math/funcs.h"
+#include "../util/math/vector2i.h"
+#include "../util/math/vector3i.h"
+#include "../util/profiling.h"
+#include <algorithm>
+#include <cmath>
+
+namespace zylann::voxel {
+
+namespace {
+
+bool try_get_grid_position(const Vector3f p, Vector3i &out_pos) {
+	static constexpr float EPSILON = 0.0001f;
+	for (unsigned int i = 0; i < Vector3f::AXIS_COUNT; ++i) {
+		const float r = std::round(p[i]);
+		if (std::abs(p[i] - r) > EPSILON) {
+			return false;
+		}
+		out_pos[i] = static_cast<int>(r);
+	}
+	return true;
+}
+
+// A square face of a plane split in a grid
+struct QuadCell {
+	uint8_t axis;
+	// 1 if the face points toward negative coordinates along the axis
+	uint8_t negative;
+	// Size of the grid
+	int32_t size;
+	// Coordinate of the plane along the axis
+	int32_t d;
+	// Position in the grid, along the two other axes
+	int32_t u;
+	int32_t v;
+
+	inline bool is_same_plane(const QuadCell &other) const {
+		return axis == other.axis && negative == other.negative && size == other.size && d == other.d;
+	}
+};
+
+// Tells if two triangles form an axis-aligned square, and if so, which grid cell it covers.
+bool try_get_quad_cell(const FixedArray<Vector3f, 6> &positions, QuadCell &out_cell) {
+	FixedArray<Vector3i, 6> grid_positions;
+	for (unsigned int i = 0; i < positions.size(); ++i) {
+		if (!try_get_grid_position(positions[i], grid_positions[i])) {
+			return false;
+		}
+	}
+
+	Vector3i minp = grid_positions[0];
+	Vector3i maxp = grid_positions[0];
+	for (unsigned int i = 1; i < grid_positions.size(); ++i) {
+		minp = math::min(minp, grid_positions[i]);
+		maxp = math::max(maxp, grid_positions[i]);
+	}
+
+	const Vector3i extents = maxp - minp;
+	int axis = -1;
+	for (unsigned int i = 0; i < Vector3iUtil::AXIS_COUNT; ++i) {
+		if (extents[i] == 0) {
+			if (axis != -1) {
+				// Degenerate
+				return false;
+			}
+			axis = i;
+		}
+	}
+	if (axis == -1) {
+		// Not axis-aligned
+		return false;
+	}
+
+	const unsigned int u_axis = (axis + 1) % Vector3iUtil::AXIS_COUNT;
+	const unsigned int v_axis = (axis + 2) % Vector3iUtil::AXIS_COUNT;
+	const int size = extents[u_axis];
+	if (size != extents[v_axis]) {
+		// Not a square
+		return false;
+	}
+	if (math::wrap(minp[u_axis], size) != 0 || math::wrap(minp[v_axis], size) != 0) {
+		// Not aligned to a grid of the same size
+		return false;
+	}
+
+	// Each vertex must be a corner of the square. Corners are identified with 2 bits, one per axis of the plane.
+	FixedArray<uint8_t, 6> corners;
+	for (unsigned int i = 0; i < grid_positions.size(); ++i) {
+		const Vector3i p = grid_positions[i];
+		if ((p[u_axis] != minp[u_axis] && p[u_axis] != maxp[u_axis]) ||
+			(p[v_axis] != minp[v_axis] && p[v_axis] != maxp[v_axis])) {
+			return false;
+		}
+		corners[i] = (p[u_axis] == maxp[u_axis] ? 1 : 0) | (p[v_axis] == maxp[v_axis] ? 2 : 0);
+	}
+
+	// Each triangle must use 3 different corners, and the corners they don't use must be opposite, otherwise the
+	// triangles overlap instead of covering the square.
+	FixedArray<uint8_t, 2> missing_corners;
+	for (unsigned int t = 0; t < 2; ++t) {
+		const uint8_t c0 = corners[t * 3];
+		const uint8_t c1 = corners[t * 3 + 1];
+		const uint8_t c2 = corners[t * 3 + 2];
+		if (c0 == c1 || c1 == c2 || c0 == c2) {
+			return false;
+		}
+		// Corners are 0, 1, 2 and 3, so their sum is 6
+		missing_corners[t] = 6 - c0 - c1 - c2;
+	}
+	if ((missing_corners[0] ^ missing_corners[1]) != 3) {
+		return false;
+	}
+
+	// Both triangles must face the same way
+	FixedArray<float, 2> normals;
+	for (unsigned int t = 0; t < 2; ++t) {
+		const Vector3f a = positions[t * 3];
+		const Vector3f b = positions[t * 3 + 1];
+		const Vector3f c = positions[t * 3 + 2];
+		normals[t] = math::cross(b - a, c - a)[axis];
+	}
+	if ((normals[0] < 0.f) != (normals[1] < 0.f)) {
+		return false;
+	}
+
+	out_cell.axis = axis;
+	out_cell.negative = normals[0] < 0.f ? 1 : 0;
+	out_cell.size = size;
+	out_cell.d = minp[axis];
+	out_cell.u = minp[u_axis] / size;
+	out_cell.v = minp[v_axis] / size;
+	return true;
+}
+
+void add_merged_quad(
+		const QuadCell &plane,
+		int u0,
+		int v0,
+		int u1,
+		int v1,
+		StdVector<Vector3f> &dst_positions,
+		StdVector<int> &dst_indices
+) {
+	const unsigned int u_axis = (plane.axis + 1) % Vector3iUtil::AXIS_COUNT;
+	const unsigned int v_axis = (plane.axis + 2) % Vector3iUtil::AXIS_COUNT;
+
+	const int first_index = dst_positions.size();
+
+	const Vector2i corners[4] = { Vector2i(u0, v0), Vector2i(u1, v0), Vector2i(u1, v1), Vector2i(u0, v1) };
+	for (const Vector2i corner : corners) {
+		Vector3f p;
+		p[plane.axis] = plane.d;
+		p[u_axis] = corner.x * plane.size;
+		p[v_axis] = corner.y * plane.size;
+		dst_positions.push_back(p);
+	}
+
+	// Going from the U axis to the V axis is counter-clockwise when looking from the positive side of the plane
+	if (plane.negative) {
+		dst_indices.push_back(first_index);
+		dst_indices.push_back(first_index + 2);
+		dst_indices.push_back(first_index + 1);
+		dst_indices.push_back(first_index);
+		dst_indices.push_back(first_index + 3);
+		dst_indices.push_back(first_index + 2);
+	} else {
+		dst_indices.push_back(first_index);
+		dst_indices.push_back(first_index + 1);
+		dst_indices.push_back(first_index + 2);
+		dst_indices.push_back(first_index);
+		dst_indices.push_back(first_index + 2);
+		dst_indices.push_back(first_index + 3);
+	}
+}
+
+// Greedy meshing of cells lying on the same plane
+void merge_plane_cells(
+		Span<const QuadCell> cells,
+		bool fill_holes,
+		StdVector<uint8_t> &grid,
+		StdVector<Vector3f> &dst_positions,
+		StdVector<int> &dst_indices
+) {
+	const QuadCell &plane = cells[0];
+
+	Vector2i minp(cells[0].u, cells[0].v);
+	Vector2i maxp = minp;
+	for (const QuadCell &cell : cells) {
+		minp.x = math::min(minp.x, cell.u);
+		minp.y = math::min(minp.y, cell.v);
+		maxp.x = math::max(maxp.x, cell.u);
+		maxp.y = math::max(maxp.y, cell.v);
+	}
+	const Vector2i grid_size = maxp - minp + Vector2i(1, 1);
+
+	grid.clear();
+	grid.resize(grid_size.x * grid_size.y, 0);
+	for (const QuadCell &cell : cells) {
+		grid[(cell.u - minp.x) + (cell.v - minp.y) * grid_size.x] = 1;
+	}
+
+	if (fill_holes) {
+		// Covered cells are marked differently, so they don't count as neighbors of other holes
+		for (int v = 1; v < grid_size.y - 1; ++v) {
+			for (int u = 1; u < grid_size.x - 1; ++u) {
+				const int i = u + v * grid_size.x;
+				if (grid[i] == 0 && grid[i - 1] == 1 && grid[i + 1] == 1 && grid[i - grid_size.x] == 1 &&
+					grid[i + grid_size.x] == 1) {
+					grid[i] = 2;
+				}
+			}
+		}
+	}
+
+	for (int v = 0; v < grid_size.y; ++v) {
+		for (int u = 0; u < grid_size.x; ++u) {
+			if (grid[u + v * grid_size.x] == 0) {
+				continue;
+			}
+
+			int u_end = u + 1;
+			while (u_end < grid_size.x && grid[u_end + v * grid_size.x] != 0) {
+				++u_end;
+			}
+
+			int v_end = v + 1;
+			while (v_end < grid_size.y) {
+				bool full_row = true;
+				for (int ru = u; ru < u_end; ++ru) {
+					if (grid[ru + v_end * grid_size.x] == 0) {
+						full_row = false;
+						break;
+					}
+				}
+				if (!full_row) {
+					break;
+				}
+				++v_end;
+			}
+
+			for (int rv = v; rv < v_end; ++rv) {
+				for (int ru = u; ru < u_end; ++ru) {
+					grid[ru + rv * grid_size.x] = 0;
+				}
+			}
+
+			add_merged_quad(
+					plane, minp.x + u, minp.y + v, minp.x + u_end, minp.y + v_end, dst_positions, dst_indices
+			);
+		}
+	}
+}
+
+void add_triangle_with_remap(
+		Span<const Vector3f> src_positions,
+		Span<const int> src_indices,
+		unsigned int first_index,
+		StdVector<int> &remap,
+		StdVector<Vector3f> &dst_positions,
+		StdVector<int> &dst_indices
+) {
+	for (unsigned int i = first_index; i < first_index + 3; ++i) {
+		const int src_index = src_indices[i];
+		int &dst_index = remap[src_index];
+		if (dst_index == -1) {
+			dst_index = dst_positions.size();
+			dst_positions.push_back(src_positions[src_index]);
+		}
+		dst_indices.push_back(dst_index);
+	}
+}
+
+bool is_on_box_faces(const Vector3f p, const Vector3f box_size) {
+	static constexpr float EPSILON = 0.001f;
+	for (unsigned int i = 0; i < Vector3f::AXIS_COUNT; ++i) {
+		if (std::abs(p[i]) < EPSILON || std::abs(p[i] - box_size[i]) < EPSILON) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+void merge_collision_quads(
+		Span<const Vector3f> src_positions,
+		Span<const int> src_indices,
+		StdVector<Vector3f> &dst_positions,
+		StdVector<int> &dst_indices,
+		bool fill_holes
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(src_indices.size() % 3 == 0);
+
+	dst_positions.clear();
+	dst_indices.clear();
+
+	static thread_local StdVector<QuadCell> tls_cells;
+	static thread_local StdVector<int> tls_remap;
+	static thread_local StdVector<uint8_t> tls_grid;
+
+	StdVector<QuadCell> &cells = tls_cells;
+	cells.clear();
+	StdVector<int> &remap = tls_remap;
+	remap.clear();
+	remap.resize(src_positions.size(), -1);
+
+	unsigned int ii = 0;
+	while (ii < src_indices.size()) {
+		if (ii + 6 <= src_indices.size()) {
+			FixedArray<Vector3f, 6> positions;
+			for (unsigned int i = 0; i < positions.size(); ++i) {
+				positions[i] = src_positions[src_indices[ii + i]];
+			}
+			QuadCell cell;
+			if (try_get_quad_cell(positions, cell)) {
+				cells.push_back(cell);
+				ii += 6;
+				continue;
+			}
+		}
+		// Can't be merged, keep as is
+		add_triangle_with_remap(src_positions, src_indices, ii, remap, dst_positions, dst_indices);
+		ii += 3;
+	}
+
+	std::sort(cells.begin(), cells.end(), [](const QuadCell &a, const QuadCell &b) {
+		if (a.axis != b.axis) {
+			return a.axis < b.axis;
+		}
+		if (a.negative != b.negative) {
+			return a.negative < b.negative;
+		}
+		if (a.size != b.size) {
+			return a.size < b.size;
+		}
+		return a.d < b.d;
+	});
+
+	unsigned int plane_begin = 0;
+	for (unsigned int i = 1; i <= cells.size(); ++i) {
+		if (i == cells.size() || !cells[i].is_same_plane(cells[plane_begin])) {
+			merge_plane_cells(to_span_from_position_and_size(cells, plane_begin, i - plane_begin), fill_holes,
+					tls_grid, dst_positions, dst_indices);
+			plane_begin = i;
+		}
+	}
+}
+
+void decimate_collision_mesh(
+		Span<const Vector3f> src_positions,
+		Span<const int> src_indices,
+		float cell_size,
+		Vector3f preserved_box_size,
+		StdVector<Vector3f> &dst_positions,
+		StdVector<int> &dst_indices
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(src_indices.size() % 3 == 0);
+	ZN_ASSERT_RETURN(cell_size > 0.f);
+
+	dst_positions.clear();
+	dst_indices.clear();
+
+	struct Cluster {
+		Vector3f sum;
+		unsigned int count;
+	};
+
+	static thread_local StdVector<Cluster> tls_clusters;
+	static thread_local StdVector<int> tls_vertex_to_cluster;
+	static thread_local StdVector<int> tls_cluster_to_dst;
+	static thread_local StdUnorderedMap<Vector3i, int> tls_cell_to_cluster;
+
+	StdVector<Cluster> &clusters = tls_clusters;
+	clusters.clear();
+	StdVector<int> &vertex_to_cluster = tls_vertex_to_cluster;
+	vertex_to_cluster.clear();
+	vertex_to_cluster.resize(src_positions.size(), -1);
+	StdUnorderedMap<Vector3i, int> &cell_to_cluster = tls_cell_to_cluster;
+	cell_to_cluster.clear();
+
+	const float inv_cell_size = 1.f / cell_size;
+
+	for (const int src_index : src_indices) {
+		int &cluster_index = vertex_to_cluster[src_index];
+		if (cluster_index != -1) {
+			continue;
+		}
+		const Vector3f p = src_positions[src_index];
+
+		if (is_on_box_faces(p, preserved_box_size)) {
+			// Vertices on the border of the block don't move, neighbor blocks don't know about our clusters
+			cluster_index = clusters.size();
+			clusters.push_back(Cluster{ p, 1 });
+			continue;
+		}
+
+		const Vector3i cell_pos = floor_to_int(p * inv_cell_size);
+		auto it = cell_to_cluster.find(cell_pos);
+		if (it == cell_to_cluster.end()) {
+			cluster_index = clusters.size();
+			clusters.push_back(Cluster{ p, 1 });
+			cell_to_cluster.insert({ cell_pos, cluster_index });
+		} else {
+			cluster_index = it->second;
+			Cluster &cluster = clusters[cluster_index];
+			cluster.sum += p;
+			++cluster.count;
+		}
+	}
+
+	StdVector<int> &cluster_to_dst = tls_cluster_to_dst;
+	cluster_to_dst.clear();
+	cluster_to_dst.resize(clusters.size(), -1);
+
+	// Relative to the size of cells, so the threshold works at any scale
+	const float min_area_squared = math::squared(0.0001f * cell_size * cell_size);
+
+	for (unsigned int ii = 0; ii < src_indices.size(); ii += 3) {
+		const int c0 = vertex_to_cluster[src_indices[ii]];
+		const int c1 = vertex_to_cluster[src_indices[ii + 1]];
+		const int c2 = vertex_to_cluster[src_indices[ii + 2]];
+		if (c0 == c1 || c1 == c2 || c0 == c2) {
+			// Collapsed
+			continue;
+		}
+
+		const int triangle_clusters[3] = { c0, c1, c2 };
+		FixedArray<Vector3f, 3> positions;
+		for (unsigned int i = 0; i < positions.size(); ++i) {
+			const Cluster &cluster = clusters[triangle_clusters[i]];
+			positions[i] = cluster.sum / static_cast<float>(cluster.count);
+		}
+		if (math::length_squared(math::cross(positions[1] - positions[0], positions[2] - positions[0])) <
+			min_area_squared) {
+			continue;
+		}
+
+		for (unsigned int i = 0; i < positions.size(); ++i) {
+			int &dst_index = cluster_to_dst[triangle_clusters[i]];
+			if (dst_index == -1) {
+				dst_index = dst_positions.size();
+				dst_positions.push_back(positions[i]);
+			}
+			dst_indices.push_back(dst_index);
+		}
+	}
+}
+
+void simplify_collision_surface(
+		VoxelMesher::Output &output,
+		const VoxelMesher &mesher,
+		unsigned int level,
+		Vector3i mesh_block_size,
+		unsigned int lod_index
+) {
+	ZN_PROFILE_SCOPE();
+
+	if (level == 0) {
+		return;
+	}
+
+	VoxelMesher::Output::CollisionSurface &collision_surface = output.collision_surface;
+
+	// Gather the triangles that would otherwise be used for the collision shape
+	static thread_local StdVector<Vector3f> tls_src_positions;
+	static thread_local StdVector<int> tls_src_indices;
+	StdVector<Vector3f> &src_positions = tls_src_positions;
+	StdVector<int> &src_indices = tls_src_indices;
+	src_positions.clear();
+	src_indices.clear();
+
+	if (mesher.is_generating_collision_surface() && collision_surface.submesh_index_end == -1) {
+		// Use specialized collision mesh
+		std::swap(src_positions, collision_surface.positions);
+		std::swap(src_indices, collision_surface.indices);
+
+	} else {
+		const unsigned int surface_count = mesher.is_generating_collision_surface() ? 1 : output.surfaces.size();
+
+		for (unsigned int surface_index = 0; surface_index < math::min(surface_count, output.surfaces.size());
+			 ++surface_index) {
+			const Array &arrays = output.surfaces[surface_index].arrays;
+			if (arrays.size() == 0) {
+				continue;
+			}
+			ZN_ASSERT_CONTINUE(arrays.size() == Mesh::ARRAY_MAX);
+
+			const PackedVector3Array positions = arrays[Mesh::ARRAY_VERTEX];
+			const PackedInt32Array indices = arrays[Mesh::ARRAY_INDEX];
+
+			unsigned int vertex_count = positions.size();
+			unsigned int index_count = indices.size();
+			if (collision_surface.submesh_index_end != -1) {
+				// Use a sub-region of the render mesh
+				vertex_count = math::min(vertex_count, static_cast<unsigned int>(collision_surface.submesh_vertex_end));
+				index_count = math::min(index_count, static_cast<unsigned int>(collision_surface.submesh_index_end));
+			}
+
+			const int index_offset = src_positions.size();
+			for (unsigned int i = 0; i < vertex_count; ++i) {
+				src_positions.push_back(to_vec3f(positions[i]));
+			}
+			for (unsigned int i = 0; i < index_count; ++i) {
+				const int index = indices[i];
+				ZN_ASSERT_RETURN(index >= 0 && index < static_cast<int>(vertex_count));
+				src_indices.push_back(index_offset + index);
+			}
+		}
+	}
+
+	switch (mesher.get_collision_simplification()) {
+		case VoxelMesher::COLLISION_SIMPLIFICATION_MERGE_QUADS:
+			// Merging is exact, so higher levels trade accuracy by also covering small holes
+			merge_collision_quads(
+					to_span(src_positions),
+					to_span(src_indices),
+					collision_surface.positions,
+					collision_surface.indices,
+					level >= 2
+			);
+			break;
+
+		case VoxelMesher::COLLISION_SIMPLIFICATION_DECIMATE: {
+			const float lod_scale = 1 << lod_index;
+			const float cell_size = (1 << level) * lod_scale;
+			decimate_collision_mesh(
+					to_span(src_positions),
+					to_span(src_indices),
+					cell_size,
+					to_vec3f(mesh_block_size) * lod_scale,
+					collision_surface.positions,
+					collision_surface.indices
+			);
+		} break;
+
+		default:
+			ZN_PRINT_ERROR("Unhandled collision simplification");
+			break;
+	}
+
+	collision_surface.submesh_vertex_end = -1;
+	collision_surface.submesh_index_end = -1;
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,49 @@
+#ifndef VOXEL_COLLISION_SIMPLIFICATION_H
+#define VOXEL_COLLISION_SIMPLIFICATION_H
+
+#include "../util/containers/span.h"
+#include "../util/containers/std_vector.h"
+#include "../util/math/vector3f.h"
+#include "voxel_mesher.h"
+
+namespace zylann::voxel {
+
+// Merges coplanar, axis-aligned square faces lying on a grid into larger rectangles, using greedy meshing on each
+// plane. Faces must be given as pairs of consecutive triangles, like blocky meshers do. Triangles that can't be merged
+// are copied as they are.
+// If `fill_holes` is true, missing cells surrounded by faces on all 4 sides of the same plane are covered too, which
+// allows larger rectangles at the cost of accuracy.
+void merge_collision_quads(
+		Span<const Vector3f> src_positions,
+		Span<const int> src_indices,
+		StdVector<Vector3f> &dst_positions,
+		StdVector<int> &dst_indices,
+		bool fill_holes = false
+);
+
+// Reduces triangle count by clustering vertices in a grid of cells of the given size, then removing triangles that
+// became degenerate. Vertices on the faces of the box going from the origin to `preserved_box_size` are kept as they
+// are, so meshes of neighbor blocks still connect.
+void decimate_collision_mesh(
+		Span<const Vector3f> src_positions,
+		Span<const int> src_indices,
+		float cell_size,
+		Vector3f preserved_box_size,
+		StdVector<Vector3f> &dst_positions,
+		StdVector<int> &dst_indices
+);
+
+// Replaces the collision surface of a mesher output with a simplified version. `level` is 0 for full detail (nothing
+// is done), higher levels reduce detail more. Unlike the collision surface produced by meshers, the result is always
+// stored in `collision_surface.positions` and `collision_surface.indices`, even if the mesher doesn't generate one.
+void simplify_collision_surface(
+		VoxelMesher::Output &output,
+		const VoxelMesher &mesher,
+		unsigned int level,
+		Vector3i mesh_block_size,
+		unsigned int lod_index
+);
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_COLLISION_SIMPLIFICATION_H
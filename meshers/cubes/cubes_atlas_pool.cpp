@@ -0,0 +1,206 @@
+#include "cubes_atlas_pool.h"
+#include "../../util/errors.h"
+#include "../../util/godot/classes/image.h"
+#include "../../util/godot/core/packed_arrays.h"
+#include "../../util/godot/core/typed_array.h"
+#include "../../util/math/funcs.h"
+#include "../../util/profiling.h"
+
+namespace zylann::voxel {
+
+namespace {
+
+unsigned int get_max_layer_count_for_tile_size(unsigned int tile_size) {
+	const size_t layer_size = tile_size * CubesAtlasPool::TILES_PER_LAYER_AXIS;
+	const size_t layer_bytes = layer_size * layer_size * sizeof(Color8);
+	return math::min<size_t>(CubesAtlasPool::MAX_LAYERS, CubesAtlasPool::MAX_MEMORY_USAGE / layer_bytes);
+}
+
+} // namespace
+
+CubesAtlasPool::CubesAtlasPool(unsigned int tile_size) :
+		_tile_size(tile_size), _max_layer_count(get_max_layer_count_for_tile_size(tile_size)) {
+	ZN_ASSERT(tile_size > 0 && tile_size <= MAX_TILE_SIZE);
+}
+
+bool CubesAtlasPool::allocate_tile(Tile &out_tile) {
+	MutexLock mlock(_mutex);
+
+	if (_free_tiles.size() == 0) {
+		if (_layers.size() >= _max_layer_count) {
+			return false;
+		}
+		const unsigned int layer_index = _layers.size();
+		Layer &layer = _layers.emplace_back();
+		const unsigned int layer_size = get_layer_size();
+		layer.pixels.resize(layer_size * layer_size);
+		layer.dirty = true;
+
+		// Reversed so tiles get allocated from the beginning of the layer
+		for (int i = TILES_PER_LAYER - 1; i >= 0; --i) {
+			_free_tiles.push_back(Tile{ static_cast<uint16_t>(layer_index), static_cast<uint16_t>(i) });
+		}
+	}
+
+	out_tile = _free_tiles.back();
+	_free_tiles.pop_back();
+	++_used_tile_count;
+	return true;
+}
+
+void CubesAtlasPool::free_tile(Tile tile) {
+	MutexLock mlock(_mutex);
+	ZN_ASSERT_RETURN(tile.layer < _layers.size());
+	ZN_ASSERT_RETURN(_used_tile_count > 0);
+	// Its pixels are left as they are, they will be overwritten by the next mesh using it
+	_free_tiles.push_back(tile);
+	--_used_tile_count;
+}
+
+Vector2i CubesAtlasPool::get_tile_position(Tile tile) const {
+	return Vector2i(tile.index % TILES_PER_LAYER_AXIS, tile.index / TILES_PER_LAYER_AXIS) * _tile_size;
+}
+
+void CubesAtlasPool::write_tile(Tile tile, Span<const Color8> pixels, Vector2i size) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(size.x <= static_cast<int>(_tile_size) && size.y <= static_cast<int>(_tile_size));
+	ZN_ASSERT_RETURN(pixels.size() == static_cast<size_t>(size.x * size.y));
+
+	const Vector2i tile_position = get_tile_position(tile);
+	const unsigned int layer_size = get_layer_size();
+
+	MutexLock mlock(_mutex);
+	ZN_ASSERT_RETURN(tile.layer < _layers.size());
+	Layer &layer = _layers[tile.layer];
+
+	for (int y = 0; y < size.y; ++y) {
+		const unsigned int dst_i = tile_position.x + (tile_position.y + y) * layer_size;
+		memcpy(layer.pixels.data() + dst_i, pixels.data() + y * size.x, size.x * sizeof(Color8));
+	}
+
+	layer.dirty = true;
+}
+
+namespace {
+
+Ref<Image> make_layer_image(const PackedByteArray &pixels, unsigned int layer_size) {
+	return Image::create_from_data(layer_size, layer_size, false, Image::FORMAT_RGBA8, pixels);
+}
+
+} // namespace
+
+Ref<Texture2DArray> CubesAtlasPool::update_texture() {
+	ZN_PROFILE_SCOPE();
+
+	struct LayerUpload {
+		unsigned int index;
+		PackedByteArray pixels;
+	};
+
+	StdVector<LayerUpload> uploads;
+	Ref<Texture2DArray> texture;
+	unsigned int texture_layer_count;
+	bool recreate_texture;
+
+	// Only pixels are copied while locked. Images are made and uploaded afterward, so meshing threads writing tiles
+	// don't have to wait.
+	{
+		MutexLock mlock(_mutex);
+
+		if (_texture.is_null()) {
+			_texture.instantiate();
+		}
+		texture = _texture;
+
+		recreate_texture = _texture_layer_count < _layers.size();
+		if (recreate_texture) {
+			// Layers are reserved geometrically, so the texture is only created again a few times as the pool grows
+			const uint32_t reserved_layer_count =
+					math::max(math::get_next_power_of_two_32(static_cast<uint32_t>(_layers.size())), 4u);
+			_texture_layer_count = math::min(reserved_layer_count, _max_layer_count);
+		}
+		texture_layer_count = _texture_layer_count;
+
+		for (unsigned int i = 0; i < _layers.size(); ++i) {
+			Layer &layer = _layers[i];
+			if (layer.dirty || recreate_texture) {
+				LayerUpload &upload = uploads.emplace_back();
+				upload.index = i;
+				upload.pixels.resize(layer.pixels.size() * sizeof(Color8));
+				memcpy(upload.pixels.ptrw(), layer.pixels.data(), layer.pixels.size() * sizeof(Color8));
+				layer.dirty = false;
+			}
+		}
+	}
+
+	if (uploads.size() == 0) {
+		return texture;
+	}
+
+	const unsigned int layer_size = get_layer_size();
+
+	if (recreate_texture) {
+		// All layers have to be uploaded again. The texture's RID is kept, so materials using it don't need to be
+		// updated.
+#if defined(ZN_GODOT)
+		Vector<Ref<Image>> images;
+#elif defined(ZN_GODOT_EXTENSION)
+		TypedArray<Image> images;
+#endif
+		images.resize(texture_layer_count);
+
+		for (const LayerUpload &upload : uploads) {
+#if defined(ZN_GODOT)
+			images.write[upload.index] = make_layer_image(upload.pixels, layer_size);
+#elif defined(ZN_GODOT_EXTENSION)
+			images[upload.index] = make_layer_image(upload.pixels, layer_size);
+#endif
+		}
+
+		if (uploads.size() < texture_layer_count) {
+			// Reserved layers share the same blank image
+			PackedByteArray blank_pixels;
+			blank_pixels.resize(layer_size * layer_size * sizeof(Color8));
+			memset(blank_pixels.ptrw(), 0, blank_pixels.size());
+			Ref<Image> blank_image = make_layer_image(blank_pixels, layer_size);
+			for (unsigned int i = uploads.size(); i < texture_layer_count; ++i) {
+#if defined(ZN_GODOT)
+				images.write[i] = blank_image;
+#elif defined(ZN_GODOT_EXTENSION)
+				images[i] = blank_image;
+#endif
+			}
+		}
+
+		const Error err = texture->create_from_images(images);
+		ZN_ASSERT_RETURN_V(err == OK, texture);
+
+	} else {
+		for (const LayerUpload &upload : uploads) {
+			texture->update_layer(make_layer_image(upload.pixels, layer_size), upload.index);
+		}
+	}
+
+	return texture;
+}
+
+unsigned int CubesAtlasPool::get_used_tile_count() const {
+	MutexLock mlock(_mutex);
+	return _used_tile_count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelMesherCubesAtlasTile::~VoxelMesherCubesAtlasTile() {
+	if (_pool != nullptr) {
+		_pool->free_tile(_tile);
+	}
+}
+
+void VoxelMesherCubesAtlasTile::init(std::shared_ptr<CubesAtlasPool> pool, CubesAtlasPool::Tile tile) {
+	ZN_ASSERT_RETURN(_pool == nullptr);
+	_pool = pool;
+	_tile = tile;
+}
+
+} // namespace zylann::voxel
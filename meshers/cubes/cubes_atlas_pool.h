@@ -0,0 +1,106 @@
+#ifndef VOXEL_CUBES_ATLAS_POOL_H
+#define VOXEL_CUBES_ATLAS_POOL_H
+
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/classes/ref_counted.h"
+#include "../../util/godot/classes/texture_array.h"
+#include "../../util/math/color8.h"
+#include "../../util/math/vector2i.h"
+#include "../../util/thread/mutex.h"
+
+#include <memory>
+
+namespace zylann::voxel {
+
+// Texture array shared by meshes of `VoxelMesherCubes` when they store their colors in a texture. Layers are divided
+// into square tiles, and each mesh gets one. Tiles are recycled when meshes using them are destroyed.
+// Compared to creating a texture for every mesh, this costs one upload of modified layers per frame.
+// Thread-safe.
+class CubesAtlasPool {
+public:
+	struct Tile {
+		uint16_t layer = 0;
+		// Within the layer, in row-major order
+		uint16_t index = 0;
+	};
+
+	static const unsigned int TILES_PER_LAYER_AXIS = 8;
+	static const unsigned int TILES_PER_LAYER = TILES_PER_LAYER_AXIS * TILES_PER_LAYER_AXIS;
+	// GPUs don't support too many layers
+	static const unsigned int MAX_LAYERS = 256;
+	// Layers are also limited by how much memory they take. Pixels are kept on the CPU as well, so this amount is used
+	// on both sides.
+	static const size_t MAX_MEMORY_USAGE = 256 * 1024 * 1024;
+	static const unsigned int MAX_TILE_SIZE = 128;
+
+	CubesAtlasPool(unsigned int tile_size);
+
+	unsigned int get_tile_size() const {
+		return _tile_size;
+	}
+
+	unsigned int get_layer_size() const {
+		return _tile_size * TILES_PER_LAYER_AXIS;
+	}
+
+	unsigned int get_max_layer_count() const {
+		return _max_layer_count;
+	}
+
+	// Returns false if all layers are full
+	bool allocate_tile(Tile &out_tile);
+	void free_tile(Tile tile);
+
+	// Position of the tile within its layer, in pixels
+	Vector2i get_tile_position(Tile tile) const;
+
+	// Copies an image into a tile, starting from its top-left corner. It must not be larger than the tile.
+	void write_tile(Tile tile, Span<const Color8> pixels, Vector2i size);
+
+	// Uploads layers modified since the last call. Must be called on the main thread.
+	// The same texture object is returned when the pool grows, so it can be assigned to materials once.
+	Ref<Texture2DArray> update_texture();
+
+	unsigned int get_used_tile_count() const;
+
+private:
+	struct Layer {
+		StdVector<Color8> pixels;
+		bool dirty = false;
+	};
+
+	const unsigned int _tile_size;
+	const unsigned int _max_layer_count;
+	StdVector<Layer> _layers;
+	StdVector<Tile> _free_tiles;
+	unsigned int _used_tile_count = 0;
+	// Number of layers in the texture. It grows geometrically, so the texture doesn't have to be created again every
+	// time a layer is added. Layers past those of the pool are left blank.
+	unsigned int _texture_layer_count = 0;
+	Ref<Texture2DArray> _texture;
+	mutable Mutex _mutex;
+};
+
+// Keeps a tile of a `CubesAtlasPool` allocated as long as a mesh references it
+class VoxelMesherCubesAtlasTile : public RefCounted {
+	GDCLASS(VoxelMesherCubesAtlasTile, RefCounted)
+public:
+	~VoxelMesherCubesAtlasTile();
+
+	void init(std::shared_ptr<CubesAtlasPool> pool, CubesAtlasPool::Tile tile);
+
+	CubesAtlasPool *get_pool() const {
+		return _pool.get();
+	}
+
+private:
+	static void _bind_methods() {}
+
+	std::shared_ptr<CubesAtlasPool> _pool;
+	CubesAtlasPool::Tile _tile;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_CUBES_ATLAS_POOL_H
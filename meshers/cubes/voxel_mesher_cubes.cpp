@@ -1,15 +1,21 @@
 #include "voxel_mesher_cubes.h"
+#include "../../constants/voxel_string_names.h"
 #include "../../storage/voxel_buffer.h"
 #include "../../util/godot/classes/array_mesh.h"
 #include "../../util/godot/classes/base_material_3d.h"
 #include "../../util/godot/classes/geometry_2d.h"
 #include "../../util/godot/classes/image.h"
+#include "../../util/godot/classes/ref_counted.h"
+#include "../../util/godot/classes/rendering_server.h"
 #include "../../util/godot/classes/shader_material.h"
 #include "../../util/godot/core/packed_arrays.h"
 #include "../../util/godot/core/string.h"
 #include "../../util/math/conv.h"
+#include "../../util/math/funcs.h"
+#include "../../util/memory/memory.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
+#include "cubes_atlas_pool.h"
 
 // TODO Binary greedy mesher optimization
 // https://www.youtube.com/watch?v=qnGoGq7DWMc
@@ -648,6 +654,72 @@ void build_voxel_mesh_as_greedy_cubes_atlased(
 	}
 }
 
+// Packs images of the atlas into a rectangle. Returns the size of the rectangle.
+Vector2i pack_greedy_atlas(const VoxelMesherCubes::GreedyAtlasData &atlas_data, StdVector<Vector2i> &out_positions) {
+	ZN_PROFILE_SCOPE_NAMED("Packing");
+	StdVector<Vector2i> sizes;
+	sizes.resize(atlas_data.images.size());
+	for (unsigned int i = 0; i < atlas_data.images.size(); ++i) {
+		const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
+		sizes[i] = Vector2i(im.size_x, im.size_y);
+	}
+	Vector2i result_size;
+	zylann::godot::geometry_2d_make_atlas(to_span(sizes), out_positions, result_size);
+	return result_size;
+}
+
+// Sets UVs of quads, given packed images are placed at `offset` in a texture of size `texture_size`
+bool assign_greedy_atlas_uvs(
+		const VoxelMesherCubes::GreedyAtlasData &atlas_data,
+		Span<const Vector2i> positions,
+		Span<VoxelMesherCubes::Arrays> surfaces,
+		Vector2i offset,
+		Vector2i texture_size
+) {
+	const Vector2f uv_scale(1.f / float(texture_size.x), 1.f / float(texture_size.y));
+	for (unsigned int i = 0; i < atlas_data.images.size(); ++i) {
+		const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
+		VoxelMesherCubes::Arrays &surface = surfaces[im.surface_index];
+		ERR_FAIL_COND_V(im.first_vertex_index + 4 > surface.uvs.size(), false);
+		const unsigned int vi = im.first_vertex_index;
+		const Vector2f pos(to_vec2f(positions[i] + offset));
+		// 2-----3
+		// |     |
+		// |     |
+		// 0-----1
+		surface.uvs[vi] = pos * uv_scale;
+		surface.uvs[vi + 1] = (pos + Vector2f(im.size_x, 0)) * uv_scale;
+		surface.uvs[vi + 2] = (pos + Vector2f(0, im.size_y)) * uv_scale;
+		surface.uvs[vi + 3] = (pos + Vector2f(im.size_x, im.size_y)) * uv_scale;
+	}
+	return true;
+}
+
+// Copies images to their packed position
+void blit_greedy_atlas(
+		const VoxelMesherCubes::GreedyAtlasData &atlas_data,
+		Span<const Vector2i> positions,
+		Span<Color8> dst_data,
+		Vector2i dst_size
+) {
+	// For all rectangles
+	for (unsigned int i = 0; i < atlas_data.images.size(); ++i) {
+		const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
+		const Vector2i dst_pos = positions[i];
+		Span<const Color8> src_data =
+				to_span_from_position_and_size(atlas_data.colors, im.first_color_index, im.size_x * im.size_y);
+
+		// Blit rectangle
+		for (unsigned int y = 0; y < im.size_y; ++y) {
+			for (unsigned int x = 0; x < im.size_x; ++x) {
+				const unsigned int src_i = x + y * im.size_x;
+				const unsigned int dst_i = (dst_pos.x + x) + (dst_pos.y + y) * dst_size.x;
+				dst_data[dst_i] = src_data[src_i];
+			}
+		}
+	}
+}
+
 Ref<Image> make_greedy_atlas(
 		const VoxelMesherCubes::GreedyAtlasData &atlas_data,
 		Span<VoxelMesherCubes::Arrays> surfaces
@@ -658,17 +730,7 @@ Ref<Image> make_greedy_atlas(
 
 	// Pack rectangles
 	StdVector<Vector2i> result_points;
-	Vector2i result_size;
-	{
-		ZN_PROFILE_SCOPE_NAMED("Packing");
-		StdVector<Vector2i> sizes;
-		sizes.resize(atlas_data.images.size());
-		for (unsigned int i = 0; i < atlas_data.images.size(); ++i) {
-			const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
-			sizes[i] = Vector2i(im.size_x, im.size_y);
-		}
-		zylann::godot::geometry_2d_make_atlas(to_span(sizes), result_points, result_size);
-	}
+	const Vector2i result_size = pack_greedy_atlas(atlas_data, result_points);
 
 	// DEBUG
 	// Ref<Image> debug_im;
@@ -687,21 +749,8 @@ Ref<Image> make_greedy_atlas(
 	// debug_im->save_png("debug_atlas_packing.png");
 
 	// Update UVs
-	const Vector2f uv_scale(1.f / float(result_size.x), 1.f / float(result_size.y));
-	for (unsigned int i = 0; i < atlas_data.images.size(); ++i) {
-		const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
-		VoxelMesherCubes::Arrays &surface = surfaces[im.surface_index];
-		ERR_FAIL_COND_V(im.first_vertex_index + 4 > surface.uvs.size(), Ref<Image>());
-		const unsigned int vi = im.first_vertex_index;
-		const Vector2f pos(to_vec2f(result_points[i]));
-		// 2-----3
-		// |     |
-		// |     |
-		// 0-----1
-		surface.uvs[vi] = pos * uv_scale;
-		surface.uvs[vi + 1] = (pos + Vector2f(im.size_x, 0)) * uv_scale;
-		surface.uvs[vi + 2] = (pos + Vector2f(0, im.size_y)) * uv_scale;
-		surface.uvs[vi + 3] = (pos + Vector2f(im.size_x, im.size_y)) * uv_scale;
+	if (!assign_greedy_atlas_uvs(atlas_data, to_span(result_points), surfaces, Vector2i(), result_size)) {
+		return Ref<Image>();
 	}
 
 	// Create image
@@ -709,29 +758,70 @@ Ref<Image> make_greedy_atlas(
 	im_data.resize(result_size.x * result_size.y * sizeof(Color8));
 	{
 		Span<Color8> dst_data = Span<Color8>(reinterpret_cast<Color8 *>(im_data.ptrw()), result_size.x * result_size.y);
-
-		// For all rectangles
-		for (unsigned int i = 0; i < atlas_data.images.size(); ++i) {
-			const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
-			const Vector2i dst_pos = result_points[i];
-			Span<const Color8> src_data =
-					to_span_from_position_and_size(atlas_data.colors, im.first_color_index, im.size_x * im.size_y);
-
-			// Blit rectangle
-			for (unsigned int y = 0; y < im.size_y; ++y) {
-				for (unsigned int x = 0; x < im.size_x; ++x) {
-					const unsigned int src_i = x + y * im.size_x;
-					const unsigned int dst_i = (dst_pos.x + x) + (dst_pos.y + y) * result_size.x;
-					dst_data[dst_i] = src_data[src_i];
-				}
-			}
-		}
+		blit_greedy_atlas(atlas_data, to_span(result_points), dst_data, result_size);
 	}
 
 	Ref<Image> image = Image::create_from_data(result_size.x, result_size.y, false, Image::FORMAT_RGBA8, im_data);
 	return image;
 }
 
+// Stores the atlas in a tile of a texture array shared with other meshes, instead of creating an image for each mesh.
+// Returns a null reference if it doesn't fit in a tile, or if the pool is full.
+Ref<VoxelMesherCubesAtlasTile> store_greedy_atlas_in_pool(
+		const VoxelMesherCubes::GreedyAtlasData &atlas_data,
+		Span<VoxelMesherCubes::Arrays> surfaces,
+		std::shared_ptr<CubesAtlasPool> pool,
+		StdVector<Color8> &pixels
+) {
+	ZN_PROFILE_SCOPE();
+
+	if (atlas_data.images.size() == 0) {
+		return Ref<VoxelMesherCubesAtlasTile>();
+	}
+
+	StdVector<Vector2i> positions;
+	const Vector2i size = pack_greedy_atlas(atlas_data, positions);
+
+	const int tile_size = pool->get_tile_size();
+	if (size.x > tile_size || size.y > tile_size) {
+		ZN_PRINT_VERBOSE(
+				format("Cubes atlas of size {} doesn't fit in shared atlas tiles of size {}", size, tile_size)
+		);
+		return Ref<VoxelMesherCubesAtlasTile>();
+	}
+
+	CubesAtlasPool::Tile tile;
+	if (!pool->allocate_tile(tile)) {
+		ZN_PRINT_VERBOSE("Shared cubes atlas is full");
+		return Ref<VoxelMesherCubesAtlasTile>();
+	}
+	// The tile gets freed when the last reference to it is released
+	Ref<VoxelMesherCubesAtlasTile> atlas_tile;
+	atlas_tile.instantiate();
+	atlas_tile->init(pool, tile);
+
+	const int layer_size = pool->get_layer_size();
+	const Vector2i tile_position = pool->get_tile_position(tile);
+	if (!assign_greedy_atlas_uvs(
+				atlas_data, to_span(positions), surfaces, tile_position, Vector2i(layer_size, layer_size)
+		)) {
+		return Ref<VoxelMesherCubesAtlasTile>();
+	}
+
+	// The layer goes in UV2, so shaders can sample the texture array with `vec3(UV, UV2.x)`. UV2.y tells the mesh uses
+	// the atlas, because meshes that didn't fit use vertex colors.
+	for (VoxelMesherCubes::Arrays &surface : surfaces) {
+		surface.uv2s.clear();
+		surface.uv2s.resize(surface.uvs.size(), Vector2f(tile.layer, 1.f));
+	}
+
+	pixels.resize(size.x * size.y);
+	blit_greedy_atlas(atlas_data, to_span(positions), to_span(pixels), size);
+	pool->write_tile(tile, to_span_const(pixels), size);
+
+	return atlas_tile;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 VoxelMesherCubes::VoxelMesherCubes() {
@@ -740,6 +830,14 @@ VoxelMesherCubes::VoxelMesherCubes() {
 
 VoxelMesherCubes::~VoxelMesherCubes() {}
 
+void VoxelMesherCubes::attach_output_resources(Mesh &mesh, const VoxelMesher::Output &output) const {
+	Ref<VoxelMesherCubesAtlasTile> atlas_tile;
+	if (zylann::godot::try_get_as(output.atlas_tile, atlas_tile)) {
+		// The tile is freed when the mesh is destroyed. Its pixels get uploaded before the next frame is drawn.
+		mesh.set_meta(VoxelStringNames::get_singleton().voxel_cubes_atlas_tile, atlas_tile);
+	}
+}
+
 VoxelMesherCubes::Cache &VoxelMesherCubes::get_tls_cache() {
 	static thread_local Cache cache;
 	return cache;
@@ -793,6 +891,7 @@ void VoxelMesherCubes::build(VoxelMesher::Output &output, const VoxelMesher::Inp
 	// Note, we don't lock the palette because its data has fixed-size
 
 	Ref<Image> atlas_image;
+	Ref<VoxelMesherCubesAtlasTile> atlas_tile;
 
 	switch (params.color_mode) {
 		case COLOR_RAW:
@@ -874,7 +973,10 @@ void VoxelMesherCubes::build(VoxelMesher::Output &output, const VoxelMesher::Inp
 			switch (channel_depth) {
 				case VoxelBuffer::DEPTH_8_BIT:
 					if (params.greedy_meshing) {
-						if (params.store_colors_in_texture) {
+						const bool use_shared_atlas = params.shared_atlas_enabled && params.atlas_pool != nullptr;
+						bool use_vertex_colors = true;
+
+						if (params.store_colors_in_texture || use_shared_atlas) {
 							build_voxel_mesh_as_greedy_cubes_atlased(
 									cache.arrays_per_material,
 									cache.greedy_atlas_data,
@@ -883,9 +985,30 @@ void VoxelMesherCubes::build(VoxelMesher::Output &output, const VoxelMesher::Inp
 									cache.mask_memory_pool,
 									get_color_from_palette
 							);
-							atlas_image =
-									make_greedy_atlas(cache.greedy_atlas_data, to_span(cache.arrays_per_material));
-						} else {
+							if (use_shared_atlas) {
+								atlas_tile = store_greedy_atlas_in_pool(
+										cache.greedy_atlas_data,
+										to_span(cache.arrays_per_material),
+										params.atlas_pool,
+										cache.atlas_pixels
+								);
+							}
+							if (atlas_tile.is_valid()) {
+								use_vertex_colors = false;
+							} else if (params.store_colors_in_texture) {
+								atlas_image = make_greedy_atlas(
+										cache.greedy_atlas_data, to_span(cache.arrays_per_material)
+								);
+								use_vertex_colors = false;
+							} else {
+								// Didn't fit in the shared atlas, fallback on vertex colors
+								for (Arrays &arrays : cache.arrays_per_material) {
+									arrays.clear();
+								}
+							}
+						}
+
+						if (use_vertex_colors) {
 							build_voxel_mesh_as_greedy_cubes(
 									cache.arrays_per_material,
 									raw_channel,
@@ -1032,6 +1155,11 @@ void VoxelMesherCubes::build(VoxelMesher::Output &output, const VoxelMesher::Inp
 					copy_to(uvs, arrays.uvs);
 					mesh_arrays[Mesh::ARRAY_TEX_UV] = uvs;
 				}
+				if (arrays.uv2s.size() > 0) {
+					PackedVector2Array uv2s;
+					copy_to(uv2s, arrays.uv2s);
+					mesh_arrays[Mesh::ARRAY_TEX_UV2] = uv2s;
+				}
 			}
 
 			// surface.collision_enabled = (material_index == MATERIAL_OPAQUE);
@@ -1046,6 +1174,7 @@ void VoxelMesherCubes::build(VoxelMesher::Output &output, const VoxelMesher::Inp
 
 	output.primitive_type = Mesh::PRIMITIVE_TRIANGLES;
 	output.atlas_image = atlas_image;
+	output.atlas_tile = atlas_tile;
 
 	// if (params.store_colors_in_texture) {
 	// 	// Don't compress UVs, they need to be precise. Not doing this causes noticeable offsets.
@@ -1095,6 +1224,89 @@ bool VoxelMesherCubes::get_store_colors_in_texture() const {
 	return _parameters.store_colors_in_texture;
 }
 
+void VoxelMesherCubes::set_shared_atlas_enabled(bool enable) {
+	{
+		RWLockWrite wlock(_parameters_lock);
+		if (enable == _parameters.shared_atlas_enabled) {
+			return;
+		}
+		_parameters.shared_atlas_enabled = enable;
+		if (enable) {
+			_parameters.atlas_pool = make_shared_instance<CubesAtlasPool>(_parameters.shared_atlas_tile_size);
+		} else {
+			// Meshes still using tiles keep the pool alive
+			_parameters.atlas_pool.reset();
+		}
+	}
+	set_frame_pre_draw_connected(enable);
+}
+
+bool VoxelMesherCubes::is_shared_atlas_enabled() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.shared_atlas_enabled;
+}
+
+void VoxelMesherCubes::set_shared_atlas_tile_size(int size) {
+	const unsigned int clamped_size = math::clamp(size, 8, static_cast<int>(CubesAtlasPool::MAX_TILE_SIZE));
+	RWLockWrite wlock(_parameters_lock);
+	if (clamped_size == _parameters.shared_atlas_tile_size) {
+		return;
+	}
+	_parameters.shared_atlas_tile_size = clamped_size;
+	if (_parameters.shared_atlas_enabled) {
+		// Tiles have a fixed size, so a new texture is needed
+		_parameters.atlas_pool = make_shared_instance<CubesAtlasPool>(clamped_size);
+	}
+}
+
+int VoxelMesherCubes::get_shared_atlas_tile_size() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.shared_atlas_tile_size;
+}
+
+Ref<Texture2DArray> VoxelMesherCubes::get_shared_atlas_texture() const {
+	std::shared_ptr<CubesAtlasPool> pool;
+	{
+		RWLockRead rlock(_parameters_lock);
+		pool = _parameters.atlas_pool;
+	}
+	if (pool == nullptr) {
+		return Ref<Texture2DArray>();
+	}
+	return pool->update_texture();
+}
+
+void VoxelMesherCubes::set_frame_pre_draw_connected(bool connected) {
+	RenderingServer *rs = RenderingServer::get_singleton();
+	if (rs == nullptr) {
+		// Can happen in tools that don't render anything
+		return;
+	}
+	const StringName &signal_name = VoxelStringNames::get_singleton().frame_pre_draw;
+	const Callable callable = callable_mp(this, &VoxelMesherCubes::_on_rendering_server_frame_pre_draw);
+	if (rs->is_connected(signal_name, callable) == connected) {
+		return;
+	}
+	if (connected) {
+		rs->connect(signal_name, callable);
+	} else {
+		rs->disconnect(signal_name, callable);
+	}
+}
+
+void VoxelMesherCubes::_on_rendering_server_frame_pre_draw() {
+	// Meshes using the atlas may have been built in threads and shown in this frame. Uploading modified layers once,
+	// right before drawing, makes them show with their colors without uploading the texture for each of them.
+	std::shared_ptr<CubesAtlasPool> pool;
+	{
+		RWLockRead rlock(_parameters_lock);
+		pool = _parameters.atlas_pool;
+	}
+	if (pool != nullptr) {
+		pool->update_texture();
+	}
+}
+
 Ref<Resource> VoxelMesherCubes::duplicate(bool p_subresources) const {
 	Parameters params;
 	{
@@ -1102,12 +1314,20 @@ Ref<Resource> VoxelMesherCubes::duplicate(bool p_subresources) const {
 		params = _parameters;
 	}
 
+	if (params.atlas_pool != nullptr) {
+		// Each mesher has its own texture
+		params.atlas_pool = make_shared_instance<CubesAtlasPool>(params.shared_atlas_tile_size);
+	}
+
 	if (p_subresources && params.palette.is_valid()) {
 		params.palette = params.palette->duplicate(true);
 	}
 	Ref<VoxelMesherCubes> d;
 	d.instantiate();
 	d->_parameters = params;
+	if (params.atlas_pool != nullptr) {
+		d->set_frame_pre_draw_connected(true);
+	}
 
 	return d;
 }
@@ -1248,6 +1468,14 @@ void VoxelMesherCubes::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("_get_transparent_material"), &Self::_b_get_transparent_material);
 	ClassDB::bind_method(D_METHOD("_set_transparent_material", "material"), &Self::_b_set_transparent_material);
 
+	ClassDB::bind_method(D_METHOD("set_shared_atlas_enabled", "enable"), &Self::set_shared_atlas_enabled);
+	ClassDB::bind_method(D_METHOD("is_shared_atlas_enabled"), &Self::is_shared_atlas_enabled);
+
+	ClassDB::bind_method(D_METHOD("set_shared_atlas_tile_size", "size"), &Self::set_shared_atlas_tile_size);
+	ClassDB::bind_method(D_METHOD("get_shared_atlas_tile_size"), &Self::get_shared_atlas_tile_size);
+
+	ClassDB::bind_method(D_METHOD("get_shared_atlas_texture"), &Self::get_shared_atlas_texture);
+
 	ClassDB::bind_static_method(
 			Self::get_class_static(),
 			D_METHOD("generate_mesh_from_image", "image", "voxel_size"),
@@ -1272,6 +1500,15 @@ void VoxelMesherCubes::_bind_methods() {
 			"get_palette"
 	);
 
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "shared_atlas_enabled"), "set_shared_atlas_enabled", "is_shared_atlas_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "shared_atlas_tile_size", PROPERTY_HINT_RANGE, "8,128,1"),
+			"set_shared_atlas_tile_size",
+			"get_shared_atlas_tile_size"
+	);
+
 	const String material_hint =
 			String(BaseMaterial3D::get_class_static()) + "," + String(ShaderMaterial::get_class_static());
 
@@ -1,16 +1,20 @@
 #ifndef VOXEL_MESHER_CUBES_H
 #define VOXEL_MESHER_CUBES_H
 
+#include "../../util/godot/classes/texture_array.h"
 #include "../../util/math/vector2f.h"
 #include "../../util/math/vector3f.h"
 #include "../../util/thread/rw_lock.h"
 #include "../voxel_mesher.h"
 #include "voxel_color_palette.h"
 
+#include <memory>
 #include <vector>
 
 namespace zylann::voxel {
 
+class CubesAtlasPool;
+
 // A super simple mesher only producing colored cubes
 class VoxelMesherCubes : public VoxelMesher {
 	GDCLASS(VoxelMesherCubes, VoxelMesher)
@@ -41,6 +45,7 @@ public:
 	~VoxelMesherCubes();
 
 	void build(VoxelMesher::Output &output, const VoxelMesher::Input &input) override;
+	void attach_output_resources(Mesh &mesh, const VoxelMesher::Output &output) const override;
 
 	void set_greedy_meshing_enabled(bool enable);
 	bool is_greedy_meshing_enabled() const;
@@ -64,10 +69,25 @@ public:
 	void set_store_colors_in_texture(bool enable);
 	bool get_store_colors_in_texture() const;
 
+	void set_shared_atlas_enabled(bool enable);
+	bool is_shared_atlas_enabled() const;
+
+	void set_shared_atlas_tile_size(int size);
+	int get_shared_atlas_tile_size() const;
+
+	// Texture array in which meshes store their colors when the shared atlas is enabled.
+	// Layers modified by meshes built so far get uploaded when calling this. Otherwise, they are uploaded before every
+	// frame is drawn.
+	Ref<Texture2DArray> get_shared_atlas_texture() const;
+
 	bool supports_lod() const override {
 		return true;
 	}
 
+	CollisionSimplification get_collision_simplification() const override {
+		return COLLISION_SIMPLIFICATION_MERGE_QUADS;
+	}
+
 	void set_material_by_index(Materials id, Ref<Material> material);
 	Ref<Material> get_material_by_index(unsigned int i) const override;
 	unsigned int get_material_index_count() const override;
@@ -83,6 +103,8 @@ public:
 		StdVector<Vector3f> normals;
 		StdVector<Color> colors;
 		StdVector<Vector2f> uvs;
+		// Only used with the shared atlas, X is the layer of the texture array and Y is 1
+		StdVector<Vector2f> uv2s;
 		StdVector<int> indices;
 
 		void clear() {
@@ -90,6 +112,7 @@ public:
 			normals.clear();
 			colors.clear();
 			uvs.clear();
+			uv2s.clear();
 			indices.clear();
 		}
 	};
@@ -118,6 +141,9 @@ private:
 	void _b_set_transparent_material(Ref<Material> material);
 	Ref<Material> _b_get_transparent_material() const;
 
+	void set_frame_pre_draw_connected(bool connected);
+	void _on_rendering_server_frame_pre_draw();
+
 	static void _bind_methods();
 
 	struct Parameters {
@@ -125,12 +151,17 @@ private:
 		Ref<VoxelColorPalette> palette;
 		bool greedy_meshing = true;
 		bool store_colors_in_texture = false;
+		bool shared_atlas_enabled = false;
+		unsigned int shared_atlas_tile_size = 64;
+		// Created when the shared atlas is enabled
+		std::shared_ptr<CubesAtlasPool> atlas_pool;
 	};
 
 	struct Cache {
 		FixedArray<Arrays, MATERIAL_COUNT> arrays_per_material;
 		StdVector<uint8_t> mask_memory_pool;
 		GreedyAtlasData greedy_atlas_data;
+		StdVector<Color8> atlas_pixels;
 	};
 
 	// Parameters
@@ -2,6 +2,8 @@
 #define HERMITE_VALUE_H
 
 #include "../../storage/voxel_buffer.h"
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_vector.h"
 #include "../../util/math/funcs.h"
 #include "../../util/math/vector3f.h"
 
@@ -14,30 +16,56 @@ struct HermiteValue {
 	HermiteValue() : sdf(1.0) {}
 };
 
-inline float get_isolevel_clamped(const VoxelBuffer &voxels, unsigned int x, unsigned int y, unsigned int z) {
-	x = x >= (unsigned int)voxels.get_size().x ? voxels.get_size().x - 1 : x;
-	y = y >= (unsigned int)voxels.get_size().y ? voxels.get_size().y - 1 : y;
-	z = z >= (unsigned int)voxels.get_size().z ? voxels.get_size().z - 1 : z;
-	return voxels.get_voxel_f(x, y, z, VoxelBuffer::CHANNEL_SDF);
+// SDF of a voxel buffer decoded to floats, so Hermite values can be computed from contiguous memory with fixed strides
+// instead of decoding every sample from the buffer's format. Uses the same ZXY layout as `VoxelBuffer`.
+struct SdfGrid {
+	Span<const float> values;
+	Vector3i size;
+
+	inline unsigned int get_index(int x, int y, int z) const {
+		return y + size.y * (x + size.x * z);
+	}
+
+	inline float get(int x, int y, int z) const {
+		return values[get_index(x, y, z)];
+	}
+
+	inline float get_clamped(int x, int y, int z) const {
+		return get(math::clamp(x, 0, size.x - 1), math::clamp(y, 0, size.y - 1), math::clamp(z, 0, size.z - 1));
+	}
+};
+
+inline SdfGrid load_sdf_grid(const VoxelBuffer &voxels, StdVector<float> &storage) {
+	storage.resize(Vector3iUtil::get_volume(voxels.get_size()));
+	get_unscaled_sdf(voxels, to_span(storage));
+	return SdfGrid{ to_span_const(storage), voxels.get_size() };
 }
 
-inline HermiteValue get_hermite_value(const VoxelBuffer &voxels, unsigned int x, unsigned int y, unsigned int z) {
+inline HermiteValue get_hermite_value(const SdfGrid &grid, int x, int y, int z) {
 	HermiteValue v;
 
-	v.sdf = voxels.get_voxel_f(x, y, z, VoxelBuffer::CHANNEL_SDF);
-
-	Vector3f gradient;
+	if (x > 0 && y > 0 && z > 0 && x < grid.size.x - 1 && y < grid.size.y - 1 && z < grid.size.z - 1) {
+		// Neighbors are all inside, read them at fixed offsets
+		const int stride_x = grid.size.y;
+		const int stride_z = grid.size.y * grid.size.x;
+		const float *p = grid.values.data() + grid.get_index(x, y, z);
 
-	gradient.x = get_isolevel_clamped(voxels, x + 1, y, z) - get_isolevel_clamped(voxels, x - 1, y, z);
-	gradient.y = get_isolevel_clamped(voxels, x, y + 1, z) - get_isolevel_clamped(voxels, x, y - 1, z);
-	gradient.z = get_isolevel_clamped(voxels, x, y, z + 1) - get_isolevel_clamped(voxels, x, y, z - 1);
+		v.sdf = p[0];
+		v.gradient = Vector3f(p[stride_x] - p[-stride_x], p[1] - p[-1], p[stride_z] - p[-stride_z]);
 
-	v.gradient = gradient;
+	} else {
+		v.sdf = grid.get_clamped(x, y, z);
+		v.gradient = Vector3f( //
+				grid.get_clamped(x + 1, y, z) - grid.get_clamped(x - 1, y, z),
+				grid.get_clamped(x, y + 1, z) - grid.get_clamped(x, y - 1, z),
+				grid.get_clamped(x, y, z + 1) - grid.get_clamped(x, y, z - 1)
+		);
+	}
 
 	return v;
 }
 
-inline HermiteValue get_interpolated_hermite_value(const VoxelBuffer &voxels, Vector3f pos) {
+inline HermiteValue get_interpolated_hermite_value(const SdfGrid &grid, Vector3f pos) {
 	int x0 = static_cast<int>(pos.x);
 	int y0 = static_cast<int>(pos.y);
 	int z0 = static_cast<int>(pos.z);
@@ -53,15 +81,15 @@ inline HermiteValue get_interpolated_hermite_value(const VoxelBuffer &voxels, Ve
 	// x X X x
 	//   x x     (and this, in 3D)
 
-	HermiteValue v0 = get_hermite_value(voxels, x0, y0, z0);
-	HermiteValue v1 = get_hermite_value(voxels, x1, y0, z0);
-	HermiteValue v2 = get_hermite_value(voxels, x1, y0, z1);
-	HermiteValue v3 = get_hermite_value(voxels, x0, y0, z1);
+	HermiteValue v0 = get_hermite_value(grid, x0, y0, z0);
+	HermiteValue v1 = get_hermite_value(grid, x1, y0, z0);
+	HermiteValue v2 = get_hermite_value(grid, x1, y0, z1);
+	HermiteValue v3 = get_hermite_value(grid, x0, y0, z1);
 
-	HermiteValue v4 = get_hermite_value(voxels, x0, y1, z0);
-	HermiteValue v5 = get_hermite_value(voxels, x1, y1, z0);
-	HermiteValue v6 = get_hermite_value(voxels, x1, y1, z1);
-	HermiteValue v7 = get_hermite_value(voxels, x0, y1, z1);
+	HermiteValue v4 = get_hermite_value(grid, x0, y1, z0);
+	HermiteValue v5 = get_hermite_value(grid, x1, y1, z0);
+	HermiteValue v6 = get_hermite_value(grid, x1, y1, z1);
+	HermiteValue v7 = get_hermite_value(grid, x0, y1, z1);
 
 	Vector3f rpos = pos - Vector3f(x0, y0, z0);
 
@@ -51,6 +51,36 @@ Array MeshBuilder::commit(bool wireframe) {
 	return surface;
 }
 
+void MeshBuilder::append(const MeshBuilder &other) {
+	// Vertices of the other builder are stored in order of first use by its indices
+	StdVector<int> &remap = _remap_cache;
+	remap.resize(other._positions.size());
+
+	for (unsigned int i = 0; i < other._positions.size(); ++i) {
+		const Vector3f position = other._positions[i];
+		auto it = _position_to_index.find(position);
+
+		if (it != _position_to_index.end()) {
+			remap[i] = it->second;
+			++_reused_vertices;
+
+		} else {
+			const int new_index = _positions.size();
+			_position_to_index.insert({ position, new_index });
+			_positions.push_back(position);
+			_normals.push_back(other._normals[i]);
+			remap[i] = new_index;
+		}
+	}
+
+	_indices.reserve(_indices.size() + other._indices.size());
+	for (const int i : other._indices) {
+		_indices.push_back(remap[i]);
+	}
+
+	_reused_vertices += other._reused_vertices;
+}
+
 void MeshBuilder::scale(float scale) {
 	for (auto it = _positions.begin(); it != _positions.end(); ++it) {
 		*it *= scale;
@@ -33,6 +33,10 @@ public:
 		_indices.push_back(i);
 	}
 
+	// Adds the triangles of another builder after those already present, merging vertices with the same position.
+	// Gives the same result as if they had been added to this builder directly.
+	void append(const MeshBuilder &other);
+
 	void scale(float scale);
 	Array commit(bool wireframe);
 	void clear();
@@ -47,6 +51,8 @@ private:
 	StdVector<int> _indices;
 	StdMap<Vector3f, int> _position_to_index;
 	int _reused_vertices;
+	// Reused by `append`
+	StdVector<int> _remap_cache;
 };
 
 } // namespace zylann::voxel::dmc
@@ -1,11 +1,19 @@
 #include "voxel_mesher_dmc.h"
 #include "../../constants/cube_tables.h"
+#include "../../engine/voxel_engine.h"
+#include "../../util/containers/container_funcs.h"
 #include "../../util/godot/classes/time.h"
 #include "../../util/math/conv.h"
+#include "../../util/memory/memory.h"
+#include "../../util/profiling.h"
+#include "../../util/tasks/parallel_for.h"
+#include "../../util/thread/thread.h"
 #include "marching_cubes_tables.h"
 #include "mesh_builder.h"
 #include "octree_tables.h"
 
+#include <memory>
+
 // Dual marching cubes
 // Algorithm taken from https://www.volume-gfx.com/volume-rendering/dual-marching-cubes/
 // Partially based on Ogre's implementation, adapted for requirements of this module with a few extras
@@ -19,20 +27,20 @@ const float NEAR_SURFACE_FACTOR = 2.0;
 
 // Helper to access padded voxel data
 struct VoxelAccess {
-	const VoxelBuffer &buffer;
+	const SdfGrid grid;
 	const Vector3i offset;
 
-	VoxelAccess(const VoxelBuffer &p_buffer, Vector3i p_offset) : buffer(p_buffer), offset(p_offset) {}
+	VoxelAccess(const SdfGrid p_grid, Vector3i p_offset) : grid(p_grid), offset(p_offset) {}
 
 	inline HermiteValue get_hermite_value(int x, int y, int z) const {
-		return dmc::get_hermite_value(buffer, x + offset.x, y + offset.y, z + offset.z);
+		return dmc::get_hermite_value(grid, x + offset.x, y + offset.y, z + offset.z);
 	}
 
 	inline HermiteValue get_interpolated_hermite_value(Vector3f pos) const {
 		pos.x += offset.x;
 		pos.y += offset.y;
 		pos.z += offset.z;
-		return dmc::get_interpolated_hermite_value(buffer, pos);
+		return dmc::get_interpolated_hermite_value(grid, pos);
 	}
 };
 
@@ -44,7 +52,6 @@ bool can_split(Vector3i node_origin, int node_size, const VoxelAccess &voxels, f
 
 	Vector3i origin = node_origin + voxels.offset;
 	int step = node_size;
-	int channel = VoxelBuffer::CHANNEL_SDF;
 
 	// Don't split if nothing is inside, i.e isolevel distance is greater than the size of the cube we are in
 	Vector3i center_pos = node_origin + Vector3iUtil::create(node_size / 2);
@@ -55,15 +62,15 @@ bool can_split(Vector3i node_origin, int node_size, const VoxelAccess &voxels, f
 
 	// Fighting with Clang-format here /**/
 
-	float v0 = voxels.buffer.get_voxel_f(origin.x, /*  */ origin.y, /*  */ origin.z, /*  */ channel); // 0
-	float v1 = voxels.buffer.get_voxel_f(origin.x + step, origin.y, /*  */ origin.z, /*  */ channel); // 1
-	float v2 = voxels.buffer.get_voxel_f(origin.x + step, origin.y, /*  */ origin.z + step, channel); // 2
-	float v3 = voxels.buffer.get_voxel_f(origin.x, /*  */ origin.y, /*  */ origin.z + step, channel); // 3
+	float v0 = voxels.grid.get(origin.x, /*  */ origin.y, /*  */ origin.z); // 0
+	float v1 = voxels.grid.get(origin.x + step, origin.y, /*  */ origin.z); // 1
+	float v2 = voxels.grid.get(origin.x + step, origin.y, /*  */ origin.z + step); // 2
+	float v3 = voxels.grid.get(origin.x, /*  */ origin.y, /*  */ origin.z + step); // 3
 
-	float v4 = voxels.buffer.get_voxel_f(origin.x, /*  */ origin.y + step, origin.z, /*  */ channel); // 4
-	float v5 = voxels.buffer.get_voxel_f(origin.x + step, origin.y + step, origin.z, /*  */ channel); // 5
-	float v6 = voxels.buffer.get_voxel_f(origin.x + step, origin.y + step, origin.z + step, channel); // 6
-	float v7 = voxels.buffer.get_voxel_f(origin.x, /*  */ origin.y + step, origin.z + step, channel); // 7
+	float v4 = voxels.grid.get(origin.x, /*  */ origin.y + step, origin.z); // 4
+	float v5 = voxels.grid.get(origin.x + step, origin.y + step, origin.z); // 5
+	float v6 = voxels.grid.get(origin.x + step, origin.y + step, origin.z + step); // 6
+	float v7 = voxels.grid.get(origin.x, /*  */ origin.y + step, origin.z + step); // 7
 
 	int hstep = step / 2;
 
@@ -121,7 +128,7 @@ bool can_split(Vector3i node_origin, int node_size, const VoxelAccess &voxels, f
 	for (int i = 0; i < 19; ++i) {
 		Vector3i pos = positions[i];
 
-		HermiteValue value = get_hermite_value(voxels.buffer, pos.x, pos.y, pos.z);
+		HermiteValue value = get_hermite_value(voxels.grid, pos.x, pos.y, pos.z);
 
 		float interpolated_value = math::interpolate_trilinear(v0, v1, v2, v3, v4, v5, v6, v7, positions_ratio[i]);
 
@@ -195,7 +202,6 @@ public:
 
 	OctreeNode *build(Vector3i node_origin, int node_size) const {
 		OctreeNode *children[8] = { nullptr };
-		bool any_node = false;
 
 		// Go all the way down, except leaves because we can't reason bottom-up on them
 		if (node_size > 2) {
@@ -203,10 +209,20 @@ public:
 				const int *dir = OctreeTables::g_octant_position[i];
 				int child_size = node_size / 2;
 				children[i] = build(node_origin + child_size * Vector3i(dir[0], dir[1], dir[2]), child_size);
-				any_node |= children[i] != nullptr;
 			}
 		}
 
+		return build_from_children(node_origin, node_size, children);
+	}
+
+	// Creates a node from its octants, which may have been built separately. Null octants get replaced with leaves,
+	// unless they are all null, in which case the node itself may not be created.
+	OctreeNode *build_from_children(Vector3i node_origin, int node_size, OctreeNode *const *children) const {
+		bool any_node = false;
+		for (int i = 0; i < 8; ++i) {
+			any_node |= children[i] != nullptr;
+		}
+
 		OctreeNode *node = nullptr;
 
 		if (!any_node) {
@@ -591,6 +607,8 @@ public:
 	DualGridGenerator(DualGrid &grid, int octree_root_size) : _grid(grid), _octree_root_size(octree_root_size) {}
 
 	void node_proc(OctreeNode *node);
+	// Only creates cells spanning several children of the node, without recursing into them
+	void node_proc_between_children(OctreeNode *node);
 
 private:
 	DualGrid &_grid;
@@ -1009,6 +1027,12 @@ void DualGridGenerator::node_proc(OctreeNode *node) {
 		node_proc(children[i]);
 	}
 
+	node_proc_between_children(node);
+}
+
+void DualGridGenerator::node_proc_between_children(OctreeNode *node) {
+	OctreeNode **children = node->children;
+
 	face_proc_xy(children[0], children[3]);
 	face_proc_xy(children[1], children[2]);
 	face_proc_xy(children[4], children[7]);
@@ -1279,7 +1303,7 @@ void polygonize_dual_cell(
 
 	if (skirts_enabled) {
 		add_marching_squares_skirts(
-				corners, values, mesh_builder, Vector3f(), to_vec3f(voxels.buffer.get_size() + voxels.offset));
+				corners, values, mesh_builder, Vector3f(), to_vec3f(voxels.grid.size + voxels.offset));
 	}
 }
 
@@ -1290,16 +1314,17 @@ inline void polygonize_dual_grid(
 	}
 }
 
-void polygonize_volume_directly(
-		const VoxelBuffer &voxels, Vector3i min, Vector3i size, MeshBuilder &mesh_builder, bool skirts_enabled) {
+// Polygonizes voxels from `min` to `min + size`, with vertices placed relative to `origin`
+void polygonize_volume_directly(const SdfGrid &voxels, Vector3i origin, Vector3i min, Vector3i size,
+		MeshBuilder &mesh_builder, bool skirts_enabled) {
 	Vector3f corners[8];
 	HermiteValue values[8];
 
 	const Vector3i max = min + size;
-	const Vector3f minf = to_vec3f(min);
+	const Vector3f originf = to_vec3f(origin);
 
 	const Vector3f min_vertex_pos = Vector3f();
-	const Vector3f max_vertex_pos = to_vec3f(voxels.get_size() - 2 * min);
+	const Vector3f max_vertex_pos = to_vec3f(voxels.size - 2 * origin);
 
 	for (int z = min.z; z < max.z; ++z) {
 		for (int x = min.x; x < max.x; ++x) {
@@ -1323,7 +1348,7 @@ void polygonize_volume_directly(
 				corners[7] = Vector3f(x, y + 1, z + 1);
 
 				for (int i = 0; i < 8; ++i) {
-					corners[i] -= minf;
+					corners[i] -= originf;
 				}
 
 				polygonize_cell_marching_cubes(corners, values, mesh_builder);
@@ -1336,6 +1361,78 @@ void polygonize_volume_directly(
 	}
 }
 
+// Processes the 8 octants of a block on multiple threads. Octants are claimed one by one, so the thread building the
+// mesh can end up doing all the work if no other thread is available.
+// Results are stored per octant and combined in order, so the final mesh is the same as if the whole block was
+// processed by a single thread.
+struct ParallelOctantsContext {
+	static const unsigned int OCTANT_COUNT = 8;
+
+	// These are owned by the thread waiting for octants to be done
+	const VoxelAccess *voxels = nullptr;
+	FixedArray<OctantCache, OCTANT_COUNT> *octants = nullptr;
+
+	int chunk_size = 0;
+	float geometric_error = 0.f;
+	VoxelMesherDMC::SimplifyMode simplify_mode = VoxelMesherDMC::SIMPLIFY_OCTREE_BOTTOM_UP;
+	bool build_dual_grid = false;
+	bool polygonize = false;
+	bool skirts_enabled = false;
+
+	void process_octant(unsigned int octant_index, OctantCache &octant) {
+		ZN_PROFILE_SCOPE();
+
+		if (simplify_mode == VoxelMesherDMC::SIMPLIFY_NONE) {
+			// Without an octree, split in slabs along Z instead, which is the outer loop of direct polygonization.
+			// That way appending them in order produces the same mesh as polygonizing the whole block at once.
+			const int slab_size = chunk_size / static_cast<int>(OCTANT_COUNT);
+			polygonize_volume_directly(voxels->grid, voxels->offset,
+					voxels->offset + Vector3i(0, 0, static_cast<int>(octant_index) * slab_size),
+					Vector3i(chunk_size, chunk_size, slab_size), octant.mesh_builder, skirts_enabled);
+			return;
+		}
+
+		const int *dir = OctreeTables::g_octant_position[octant_index];
+		const int octant_size = chunk_size / 2;
+		const Vector3i octant_origin = octant_size * Vector3i(dir[0], dir[1], dir[2]);
+
+		if (simplify_mode == VoxelMesherDMC::SIMPLIFY_OCTREE_BOTTOM_UP) {
+			OctreeBuilderBottomUp octree_builder(*voxels, geometric_error, octant.octree_node_pool);
+			octant.root = octree_builder.build(octant_origin, octant_size);
+		} else {
+			OctreeBuilderTopDown octree_builder(*voxels, geometric_error, octant.octree_node_pool);
+			octant.root = octree_builder.build(octant_origin, octant_size);
+		}
+
+		if (octant.root == nullptr || !build_dual_grid) {
+			return;
+		}
+
+		// Borders are still those of the whole block
+		DualGridGenerator dual_grid_generator(octant.dual_grid, chunk_size);
+		dual_grid_generator.node_proc(octant.root);
+
+		if (polygonize) {
+			polygonize_dual_grid(octant.dual_grid, *voxels, octant.mesh_builder, skirts_enabled);
+			octant.dual_grid.cells.clear();
+		}
+	}
+};
+
+void run_octants_in_parallel(ParallelOctantsContext &ctx) {
+	ZN_PROFILE_SCOPE();
+
+	// This usually runs in a meshing task already. Octants not picked up by other threads are processed here, and
+	// this thread sleeps while the last ones claimed by other threads finish.
+	parallel_for(
+			ParallelOctantsContext::OCTANT_COUNT,
+			1,
+			math::max(Thread::get_hardware_concurrency(), 2u) - 1,
+			[](Span<IThreadedTask *> tasks) { VoxelEngine::get_singleton().push_async_tasks(tasks); },
+			[&ctx](unsigned int octant_index) { ctx.process_octant(octant_index, (*ctx.octants)[octant_index]); }
+	);
+}
+
 } // namespace zylann::voxel::dmc
 
 namespace zylann::voxel {
@@ -1393,6 +1490,16 @@ VoxelMesherDMC::SeamMode VoxelMesherDMC::get_seam_mode() const {
 	return _parameters.seam_mode;
 }
 
+void VoxelMesherDMC::set_parallel_octants_enabled(bool enabled) {
+	RWLockWrite wlock(_parameters_lock);
+	_parameters.parallel_octants = enabled;
+}
+
+bool VoxelMesherDMC::is_parallel_octants_enabled() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.parallel_octants;
+}
+
 void VoxelMesherDMC::build(VoxelMesher::Output &output, const VoxelMesher::Input &input) {
 	using namespace zylann::voxel;
 
@@ -1435,14 +1542,23 @@ void VoxelMesherDMC::build(VoxelMesher::Output &output, const VoxelMesher::Input
 	// So we can't improve this further until Godot's API gives us that possibility, or other approaches like skirts
 	// need to be taken.
 
-	// Construct an intermediate to handle padding transparently
-	dmc::VoxelAccess voxels_access(voxels, Vector3iUtil::create(PADDING));
-
 	Stats stats;
 	real_t time_before = Time::get_singleton()->get_ticks_usec();
 
 	Cache &cache = get_tls_cache();
 
+	// Decode SDF once, the algorithm samples most voxels several times
+	const dmc::SdfGrid sdf_grid = dmc::load_sdf_grid(voxels, cache.sdf);
+
+	// Construct an intermediate to handle padding transparently
+	dmc::VoxelAccess voxels_access(sdf_grid, Vector3iUtil::create(PADDING));
+
+	// Splitting work has a cost, it is only worth it with large blocks.
+	// A top-down octree whose root doesn't split has no work to share either.
+	const bool parallel_octants = params.parallel_octants && chunk_size >= MIN_PARALLEL_OCTANTS_BLOCK_SIZE &&
+			(params.simplify_mode != SIMPLIFY_OCTREE_TOP_DOWN ||
+					dmc::can_split(Vector3i(), chunk_size, voxels_access, params.geometric_error));
+
 	// In an ideal world, a tiny sphere placed in the middle of an empty SDF volume will
 	// cause corners data to change so that they indicate distance to it.
 	// That means we could build our meshing octree top-down efficiently because corners of the volume will tell if the
@@ -1461,7 +1577,40 @@ void VoxelMesherDMC::build(VoxelMesher::Output &output, const VoxelMesher::Input
 	//
 	// TODO This option might disappear once I find a good enough solution
 	dmc::OctreeNode *root = nullptr;
-	if (params.simplify_mode == SIMPLIFY_OCTREE_BOTTOM_UP) {
+	if (parallel_octants) {
+		dmc::ParallelOctantsContext ctx;
+		ctx.voxels = &voxels_access;
+		ctx.octants = &cache.octants;
+		ctx.chunk_size = chunk_size;
+		ctx.geometric_error = params.geometric_error;
+		ctx.simplify_mode = params.simplify_mode;
+		ctx.build_dual_grid = params.mesh_mode != MESH_DEBUG_OCTREE;
+		ctx.polygonize = params.mesh_mode == MESH_NORMAL || params.mesh_mode == MESH_WIREFRAME;
+		ctx.skirts_enabled = skirts_enabled;
+
+		// In this mode, octants also get their dual grid and polygons done, so that time is included in octree stats
+		dmc::run_octants_in_parallel(ctx);
+
+		dmc::OctreeNode *octant_roots[8];
+		for (unsigned int i = 0; i < cache.octants.size(); ++i) {
+			octant_roots[i] = cache.octants[i].root;
+		}
+
+		if (params.simplify_mode == SIMPLIFY_OCTREE_BOTTOM_UP) {
+			dmc::OctreeBuilderBottomUp octree_builder(voxels_access, params.geometric_error, cache.octree_node_pool);
+			root = octree_builder.build_from_children(Vector3i(), chunk_size, octant_roots);
+
+		} else if (params.simplify_mode == SIMPLIFY_OCTREE_TOP_DOWN) {
+			// We checked earlier the root splits
+			root = cache.octree_node_pool.create();
+			root->origin = Vector3i();
+			root->size = chunk_size;
+			for (unsigned int i = 0; i < 8; ++i) {
+				root->children[i] = octant_roots[i];
+			}
+		}
+
+	} else if (params.simplify_mode == SIMPLIFY_OCTREE_BOTTOM_UP) {
 		dmc::OctreeBuilderBottomUp octree_builder(voxels_access, params.geometric_error, cache.octree_node_pool);
 		root = octree_builder.build(Vector3i(), chunk_size);
 
@@ -1482,7 +1631,18 @@ void VoxelMesherDMC::build(VoxelMesher::Output &output, const VoxelMesher::Input
 			time_before = Time::get_singleton()->get_ticks_usec();
 
 			dmc::DualGridGenerator dual_grid_generator(cache.dual_grid, root->size);
-			dual_grid_generator.node_proc(root);
+			if (parallel_octants) {
+				// Cells within octants are done already. Only those spanning several octants are left.
+				if (params.mesh_mode == MESH_DEBUG_DUAL_GRID) {
+					for (dmc::OctantCache &octant : cache.octants) {
+						append_array(cache.dual_grid.cells, octant.dual_grid.cells);
+						octant.dual_grid.cells.clear();
+					}
+				}
+				dual_grid_generator.node_proc_between_children(root);
+			} else {
+				dual_grid_generator.node_proc(root);
+			}
 			// TODO Handle non-subdivided octree
 
 			stats.dualgrid_derivation_time = Time::get_singleton()->get_ticks_usec() - time_before;
@@ -1492,6 +1652,10 @@ void VoxelMesherDMC::build(VoxelMesher::Output &output, const VoxelMesher::Input
 
 			} else {
 				time_before = Time::get_singleton()->get_ticks_usec();
+				if (parallel_octants) {
+					// Cells of octants come first in the dual grid, keep that order
+					append_octant_meshes(cache);
+				}
 				dmc::polygonize_dual_grid(cache.dual_grid, voxels_access, cache.mesh_builder, skirts_enabled);
 				stats.meshing_time = Time::get_singleton()->get_ticks_usec() - time_before;
 			}
@@ -1499,14 +1663,32 @@ void VoxelMesherDMC::build(VoxelMesher::Output &output, const VoxelMesher::Input
 			cache.dual_grid.cells.clear();
 		}
 
+		if (parallel_octants) {
+			// Octant nodes come from different pools
+			for (unsigned int i = 0; i < cache.octants.size(); ++i) {
+				dmc::OctantCache &octant = cache.octants[i];
+				if (octant.root != nullptr) {
+					octant.root->recycle(octant.octree_node_pool);
+					octant.octree_node_pool.recycle(octant.root);
+					octant.root = nullptr;
+					root->children[i] = nullptr;
+				}
+			}
+		}
+
 		root->recycle(cache.octree_node_pool);
+		cache.octree_node_pool.recycle(root);
 
 	} else if (params.simplify_mode == SIMPLIFY_NONE) {
 		// We throw away adaptivity for meshing speed.
 		// This is essentially regular marching cubes.
 		time_before = Time::get_singleton()->get_ticks_usec();
-		dmc::polygonize_volume_directly(voxels, Vector3iUtil::create(PADDING), Vector3iUtil::create(chunk_size),
-				cache.mesh_builder, skirts_enabled);
+		if (parallel_octants) {
+			append_octant_meshes(cache);
+		} else {
+			dmc::polygonize_volume_directly(sdf_grid, Vector3iUtil::create(PADDING), Vector3iUtil::create(PADDING),
+					Vector3iUtil::create(chunk_size), cache.mesh_builder, skirts_enabled);
+		}
 		stats.meshing_time = Time::get_singleton()->get_ticks_usec() - time_before;
 	}
 
@@ -1535,6 +1717,13 @@ void VoxelMesherDMC::build(VoxelMesher::Output &output, const VoxelMesher::Input
 	_stats = stats;
 }
 
+void VoxelMesherDMC::append_octant_meshes(Cache &cache) {
+	for (dmc::OctantCache &octant : cache.octants) {
+		cache.mesh_builder.append(octant.mesh_builder);
+		octant.mesh_builder.clear();
+	}
+}
+
 Ref<Resource> VoxelMesherDMC::duplicate(bool p_subresources) const {
 	Ref<VoxelMesherDMC> c;
 	c.instantiate();
@@ -1569,6 +1758,11 @@ void VoxelMesherDMC::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_seam_mode", "mode"), &VoxelMesherDMC::set_seam_mode);
 	ClassDB::bind_method(D_METHOD("get_seam_mode"), &VoxelMesherDMC::get_seam_mode);
 
+	ClassDB::bind_method(
+			D_METHOD("set_parallel_octants_enabled", "enabled"), &VoxelMesherDMC::set_parallel_octants_enabled
+	);
+	ClassDB::bind_method(D_METHOD("is_parallel_octants_enabled"), &VoxelMesherDMC::is_parallel_octants_enabled);
+
 	ClassDB::bind_method(D_METHOD("get_statistics"), &VoxelMesherDMC::get_statistics);
 
 	ADD_PROPERTY(
@@ -1583,6 +1777,9 @@ void VoxelMesherDMC::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "seam_mode", PROPERTY_HINT_ENUM, "None,MarchingSquareSkirts"),
 			"set_seam_mode", "get_seam_mode");
 
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "parallel_octants_enabled"), "set_parallel_octants_enabled",
+			"is_parallel_octants_enabled");
+
 	BIND_ENUM_CONSTANT(MESH_NORMAL);
 	BIND_ENUM_CONSTANT(MESH_WIREFRAME);
 	BIND_ENUM_CONSTANT(MESH_DEBUG_OCTREE);
@@ -1,6 +1,7 @@
 #ifndef VOXEL_MESHER_DMC_H
 #define VOXEL_MESHER_DMC_H
 
+#include "../../util/containers/fixed_array.h"
 #include "../../util/memory/object_pool.h"
 #include "../../util/thread/rw_lock.h"
 #include "../voxel_mesher.h"
@@ -29,9 +30,11 @@ struct OctreeNode {
 		}
 	}
 
+	// Recycles all descendants of the node. The node itself has to be recycled by the caller.
 	void recycle(OctreeNodePool &pool) {
 		for (int i = 0; i < 8; ++i) {
 			if (children[i]) {
+				children[i]->recycle(pool);
 				pool.recycle(children[i]);
 			}
 		}
@@ -58,6 +61,14 @@ struct DualGrid {
 	StdVector<DualCell> cells;
 };
 
+// Work data of one of the 8 octants of a block, when they are processed in parallel
+struct OctantCache {
+	MeshBuilder mesh_builder;
+	DualGrid dual_grid;
+	OctreeNodePool octree_node_pool;
+	OctreeNode *root = nullptr;
+};
+
 } // namespace zylann::voxel::dmc
 
 namespace zylann::voxel {
@@ -67,6 +78,8 @@ class VoxelMesherDMC : public VoxelMesher {
 	GDCLASS(VoxelMesherDMC, VoxelMesher)
 public:
 	static const int PADDING = 2;
+	// Blocks smaller than this are not split in octants processed in parallel
+	static const int MIN_PARALLEL_OCTANTS_BLOCK_SIZE = 32;
 
 	enum MeshMode { //
 		MESH_NORMAL,
@@ -103,6 +116,9 @@ public:
 	void set_seam_mode(SeamMode mode);
 	SeamMode get_seam_mode() const;
 
+	void set_parallel_octants_enabled(bool enabled);
+	bool is_parallel_octants_enabled() const;
+
 	void build(VoxelMesher::Output &output, const VoxelMesher::Input &input) override;
 
 	Dictionary get_statistics() const;
@@ -126,12 +142,16 @@ private:
 		MeshMode mesh_mode = MESH_NORMAL;
 		SimplifyMode simplify_mode = SIMPLIFY_OCTREE_BOTTOM_UP;
 		SeamMode seam_mode = SEAM_NONE;
+		bool parallel_octants = false;
 	};
 
 	struct Cache {
 		dmc::MeshBuilder mesh_builder;
 		dmc::DualGrid dual_grid;
 		dmc::OctreeNodePool octree_node_pool;
+		StdVector<float> sdf;
+		// Owned by the thread building the mesh, but filled by other threads while it waits for them
+		FixedArray<dmc::OctantCache, 8> octants;
 	};
 
 	// Parameters
@@ -141,6 +161,8 @@ private:
 	// Work cache
 	static Cache &get_tls_cache();
 
+	static void append_octant_meshes(Cache &cache);
+
 	struct Stats {
 		float octree_build_time = 0;
 		float dualgrid_derivation_time = 0;
@@ -1,5 +1,6 @@
 #include "mesh_block_task.h"
 #include "../engine/detail_rendering/render_detail_texture_task.h"
+#include "../meshers/collision_simplification.h"
 #include "../meshers/transvoxel/voxel_mesher_transvoxel.h"
 #include "../storage/voxel_data.h"
 #include "../terrain/voxel_mesh_block.h"
@@ -290,6 +291,7 @@ Ref<ArrayMesh> build_mesh(
 
 namespace {
 std::atomic_int g_debug_mesh_tasks_count = { 0 };
+std::atomic_uint64_t g_debug_mesh_tasks_completed_count = { 0 };
 } // namespace
 
 MeshBlockTask::MeshBlockTask() : _voxels(VoxelBuffer::ALLOCATOR_POOL) {
@@ -304,6 +306,10 @@ int MeshBlockTask::debug_get_running_count() {
 	return g_debug_mesh_tasks_count;
 }
 
+uint64_t MeshBlockTask::debug_get_completed_count() {
+	return g_debug_mesh_tasks_completed_count;
+}
+
 void MeshBlockTask::run(zylann::ThreadedTaskContext &ctx) {
 	ZN_DSTACK();
 	ZN_PROFILE_SCOPE();
@@ -479,6 +485,13 @@ void MeshBlockTask::build_mesh() {
 	};
 	mesher->build(_surfaces_output, input);
 
+	if (collision_hint) {
+		// Colliders are built here, so the main thread only has to assign them
+		simplify_collision_surface(_surfaces_output, **mesher, collision_detail, mesh_block_size, lod_index);
+		_collision_shape = make_collision_shape_from_mesher_output(_surfaces_output, **mesher);
+		_has_collision_shape = true;
+	}
+
 	const bool mesh_is_empty = VoxelMesher::is_mesh_empty(_surfaces_output.surfaces);
 
 	// Currently, Transvoxel only is supported in combination with detail normalmap texturing, because the algorithm
@@ -543,6 +556,9 @@ void MeshBlockTask::build_mesh() {
 				_surfaces_output.mesh_flags,
 				_mesh_material_indices
 		);
+		if (_mesh.is_valid()) {
+			mesher->attach_output_resources(**_mesh, _surfaces_output);
+		}
 		_has_mesh_resource = true;
 
 	} else {
@@ -550,6 +566,7 @@ void MeshBlockTask::build_mesh() {
 	}
 
 	_has_run = true;
+	++g_debug_mesh_tasks_completed_count;
 }
 
 TaskPriority MeshBlockTask::get_priority() {
@@ -589,6 +606,8 @@ void MeshBlockTask::apply_result() {
 			o.mesh = _mesh;
 			o.mesh_material_indices = std::move(_mesh_material_indices);
 			o.has_mesh_resource = _has_mesh_resource;
+			o.collision_shape = _collision_shape;
+			o.has_collision_shape = _has_collision_shape;
 			o.visual_was_required = require_visual;
 			o.detail_textures = _detail_textures;
 
@@ -10,6 +10,7 @@
 #include "../storage/voxel_buffer.h"
 #include "../util/containers/std_vector.h"
 #include "../util/godot/classes/array_mesh.h"
+#include "../util/godot/classes/shape_3d.h"
 #include "../util/tasks/cancellation_token.h"
 #include "../util/tasks/threaded_task.h"
 
@@ -35,6 +36,8 @@ public:
 	void set_gpu_results(StdVector<GenerateBlockGPUTaskResult> &&results) override;
 
 	static int debug_get_running_count();
+	// Total amount of tasks that built a mesh since startup
+	static uint64_t debug_get_completed_count();
 
 	// 3x3x3 or 4x4x4 grid of voxel blocks.
 	FixedArray<std::shared_ptr<VoxelBuffer>, constants::MAX_BLOCK_COUNT_PER_REQUEST> blocks;
@@ -46,8 +49,10 @@ public:
 	uint8_t blocks_count = 0;
 	// If true, a rendering mesh resource will be created if possible.
 	bool require_visual = true;
-	// If true, a collision mesh is required if possible
+	// If true, a collision mesh is required if possible, and its shape will be built in the task
 	bool collision_hint = false;
+	// 0 means collision shapes use all triangles, higher values simplify them more. See `VoxelNode::CollisionDetail`.
+	uint8_t collision_detail = 0;
 	// If true, the mesh will be used in a context with LOD, which might require a few extra things in the way it is
 	// built
 	bool lod_hint = false;
@@ -72,10 +77,12 @@ private:
 	bool _has_run = false;
 	bool _too_far = false;
 	bool _has_mesh_resource = false;
+	bool _has_collision_shape = false;
 	uint8_t _stage = 0;
 	VoxelBuffer _voxels;
 	VoxelMesher::Output _surfaces_output;
 	Ref<Mesh> _mesh;
+	Ref<Shape3D> _collision_shape;
 	StdVector<uint16_t> _mesh_material_indices; // Indexed by mesh surface
 	std::shared_ptr<DetailTextureOutput> _detail_textures;
 	StdVector<GenerateBlockGPUTaskResult> _gpu_generation_results;
@@ -125,9 +125,15 @@ Ref<Mesh> VoxelMesher::build_mesh(
 		}
 	}
 
+	attach_output_resources(**mesh, output);
+
 	return mesh;
 }
 
+void VoxelMesher::attach_output_resources(Mesh &mesh, const Output &output) const {
+	// Nothing by default
+}
+
 void VoxelMesher::build(Output &output, const Input &input) {
 	ERR_PRINT("Not implemented");
 }
@@ -73,10 +73,17 @@ public:
 		// May be used to store extra information needed in shader to render the mesh properly
 		// (currently used only by the cubes mesher when baking colors)
 		Ref<Image> atlas_image;
+		// Resource the mesh has to keep alive (currently used only by the cubes mesher when it stores colors in a
+		// shared atlas)
+		Ref<RefCounted> atlas_tile;
 	};
 
 	static bool is_mesh_empty(const StdVector<Output::Surface> &surfaces);
 
+	// Must be called after creating a mesh from the output, for meshers that need the mesh to keep some of their
+	// resources alive. This can be called from multiple threads at once.
+	virtual void attach_output_resources(Mesh &mesh, const Output &output) const;
+
 	// This can be called from multiple threads at once. Make sure member vars are protected or thread-local.
 	virtual void build(Output &output, const Input &voxels);
 
@@ -121,6 +128,18 @@ public:
 		return false;
 	}
 
+	enum CollisionSimplification {
+		// Faces are axis-aligned squares on a grid, which can be merged into larger rectangles
+		COLLISION_SIMPLIFICATION_MERGE_QUADS,
+		// Faces have any orientation, vertices are clustered to remove small details
+		COLLISION_SIMPLIFICATION_DECIMATE
+	};
+
+	// Tells how collision meshes produced by this mesher can be simplified, when lower collision detail is requested.
+	virtual CollisionSimplification get_collision_simplification() const {
+		return COLLISION_SIMPLIFICATION_DECIMATE;
+	}
+
 	// Gets a special default material to be used to render meshes produced with this mesher, when variable level of
 	// detail is used. If null, standard materials or default Godot shaders can be used. This is mostly to provide a
 	// default shader that looks ok. Users are still expected to tweak them if need be.
@@ -4,6 +4,8 @@
 #endif
 
 #include "constants/voxel_string_names.h"
+#include "edition/voxel_blocky_cellular_automaton.h"
+#include "edition/voxel_collision_query.h"
 #include "edition/voxel_mesh_sdf_gd.h"
 #include "edition/voxel_tool.h"
 #include "edition/voxel_tool_buffer.h"
@@ -30,6 +32,7 @@
 #include "meshers/blocky/voxel_blocky_model_empty.h"
 #include "meshers/blocky/voxel_blocky_model_mesh.h"
 #include "meshers/blocky/voxel_mesher_blocky.h"
+#include "meshers/cubes/cubes_atlas_pool.h"
 #include "meshers/cubes/voxel_mesher_cubes.h"
 #include "meshers/dmc/voxel_mesher_dmc.h"
 #include "meshers/transvoxel/voxel_mesher_transvoxel.h"
@@ -57,6 +60,7 @@
 #include "terrain/instancing/voxel_instancer_rigidbody.h"
 #include "terrain/variable_lod/voxel_lod_terrain.h"
 #include "terrain/voxel_a_star_grid_3d.h"
+#include "terrain/voxel_hierarchical_path_finder.h"
 #include "terrain/voxel_mesh_block.h"
 #include "terrain/voxel_save_completion_tracker.h"
 #include "terrain/voxel_viewer.h"
@@ -148,6 +152,8 @@
 #endif // TOOLS_ENABLED
 
 #ifdef VOXEL_TESTS
+#include "tests/benchmarks/benchmarks.h"
+#include "tests/benchmarks/streaming_soak_test.h"
 #include "tests/tests.h"
 #endif
 
@@ -297,6 +303,10 @@ void initialize_voxel_module(ModuleInitializationLevel p_level) {
 		ClassDB::register_class<VoxelMeshSDF>();
 		ClassDB::register_class<VoxelTerrainMultiplayerSynchronizer>();
 		ClassDB::register_class<VoxelAStarGrid3D>();
+		ClassDB::register_class<VoxelHierarchicalPathFinder>();
+		ClassDB::register_class<VoxelBlockyCellularAutomaton>();
+		ClassDB::register_class<VoxelCollisionQuery>();
+		ClassDB::register_class<VoxelCollisionQueryResult>();
 
 		// Meshers
 		ClassDB::register_abstract_class<VoxelMesher>();
@@ -309,6 +319,11 @@ void initialize_voxel_module(ModuleInitializationLevel p_level) {
 		// TODO GDX: I don't want to expose these classes, but there is no way not to expose them
 		ClassDB::register_class<ZN_GodotThreadHelper>();
 		ClassDB::register_class<VoxelEngineUpdater>();
+		ClassDB::register_class<VoxelMesherCubesAtlasTile>();
+#endif
+
+#ifdef VOXEL_TESTS
+		ClassDB::register_class<zylann::voxel::benchmarks::StreamingSoakTest>();
 #endif
 
 		print_size_reminders();
@@ -376,14 +391,74 @@ void initialize_voxel_module(ModuleInitializationLevel p_level) {
 #ifdef VOXEL_TESTS
 		const PackedStringArray command_line_arguments = zylann::godot::get_command_line_arguments();
 		const String tests_cmd = "--run_voxel_tests";
+		const String benchmarks_cmd = "--run_voxel_benchmarks";
+		// Optional, to only run benchmarks whose name contains the given string
+		const String benchmarks_filter_arg = "--voxel_benchmarks_filter=";
+		// Optional, to save results as JSON
+		const String benchmarks_output_arg = "--voxel_benchmarks_output=";
+
+		// Runs once the scene tree starts, takes one of `flight`, `teleport` or `crowd`
+		const String soak_test_arg = "--run_voxel_soak_test=";
+		// Optional soak test settings
+		const String soak_terrain_arg = "--voxel_soak_terrain=";
+		const String soak_generator_arg = "--voxel_soak_generator=";
+		const String soak_stream_arg = "--voxel_soak_stream=";
+		const String soak_mesher_arg = "--voxel_soak_mesher=";
+		const String soak_viewers_arg = "--voxel_soak_viewers=";
+		const String soak_view_distance_arg = "--voxel_soak_view_distance=";
+		const String soak_duration_arg = "--voxel_soak_duration=";
+		const String soak_output_arg = "--voxel_soak_output=";
+
+		bool run_benchmarks = false;
+		String benchmarks_filter;
+		String benchmarks_output_path;
+
+		bool run_soak_test = false;
+		zylann::voxel::benchmarks::StreamingSoakTestParams soak_params;
 
 		for (int i = 0; i < command_line_arguments.size(); ++i) {
 			const String arg = command_line_arguments[i];
 			if (arg == tests_cmd) {
 				zylann::voxel::tests::run_voxel_tests();
-				break;
+			} else if (arg == benchmarks_cmd) {
+				run_benchmarks = true;
+			} else if (arg.begins_with(benchmarks_filter_arg)) {
+				benchmarks_filter = arg.substr(benchmarks_filter_arg.length());
+			} else if (arg.begins_with(benchmarks_output_arg)) {
+				benchmarks_output_path = arg.substr(benchmarks_output_arg.length());
+			} else if (arg.begins_with(soak_test_arg)) {
+				const String name = arg.substr(soak_test_arg.length());
+				run_soak_test = zylann::voxel::benchmarks::StreamingSoakTestParams::parse_scenario(
+						name, soak_params.scenario
+				);
+				ERR_CONTINUE_MSG(!run_soak_test, String("Unknown soak test scenario \"{0}\"").format(varray(name)));
+			} else if (arg.begins_with(soak_terrain_arg)) {
+				soak_params.use_lod_terrain = arg.substr(soak_terrain_arg.length()) != "fixed";
+			} else if (arg.begins_with(soak_generator_arg)) {
+				soak_params.generator_path = arg.substr(soak_generator_arg.length());
+			} else if (arg.begins_with(soak_stream_arg)) {
+				soak_params.stream_path = arg.substr(soak_stream_arg.length());
+			} else if (arg.begins_with(soak_mesher_arg)) {
+				soak_params.mesher_path = arg.substr(soak_mesher_arg.length());
+			} else if (arg.begins_with(soak_viewers_arg)) {
+				const int64_t viewer_count = arg.substr(soak_viewers_arg.length()).to_int();
+				soak_params.viewer_count = viewer_count > 0 ? viewer_count : 0;
+			} else if (arg.begins_with(soak_view_distance_arg)) {
+				soak_params.view_distance = arg.substr(soak_view_distance_arg.length()).to_int();
+			} else if (arg.begins_with(soak_duration_arg)) {
+				soak_params.move_duration_seconds = arg.substr(soak_duration_arg.length()).to_float();
+			} else if (arg.begins_with(soak_output_arg)) {
+				soak_params.output_path = arg.substr(soak_output_arg.length());
 			}
 		}
+
+		if (run_benchmarks) {
+			zylann::voxel::benchmarks::run_voxel_benchmarks(benchmarks_filter, benchmarks_output_path);
+		}
+
+		if (run_soak_test) {
+			zylann::voxel::benchmarks::schedule_streaming_soak_test(soak_params);
+		}
 #endif
 	}
 
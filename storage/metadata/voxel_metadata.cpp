@@ -25,6 +25,32 @@ uint64_t VoxelMetadata::get_u64() const {
 	return _data.u64_data;
 }
 
+void VoxelMetadata::set_f64(double v) {
+	if (_type != TYPE_F64) {
+		clear();
+		_type = TYPE_F64;
+	}
+	_data.f64_data = v;
+}
+
+double VoxelMetadata::get_f64() const {
+	ZN_ASSERT(_type == TYPE_F64);
+	return _data.f64_data;
+}
+
+void VoxelMetadata::set_bool(bool v) {
+	if (_type != TYPE_BOOL) {
+		clear();
+		_type = TYPE_BOOL;
+	}
+	_data.u64_data = v ? 1 : 0;
+}
+
+bool VoxelMetadata::get_bool() const {
+	ZN_ASSERT(_type == TYPE_BOOL);
+	return _data.u64_data != 0;
+}
+
 void VoxelMetadata::set_custom(uint8_t type, ICustomVoxelMetadata *custom_data) {
 	ZN_ASSERT(type >= TYPE_CUSTOM_BEGIN);
 	clear();
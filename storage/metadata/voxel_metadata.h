@@ -21,7 +21,9 @@ public:
 	enum Type : uint8_t { //
 		TYPE_EMPTY = 0,
 		TYPE_U64 = 1,
-		// Reserved predefined types.
+		TYPE_F64 = 2,
+		TYPE_BOOL = 3,
+		// Reserved predefined types. Their payload is stored inline, so they don't allocate.
 
 		TYPE_CUSTOM_BEGIN = 32,
 		// Types equal or greater will implement `ICustomVoxelMetadata`.
@@ -61,6 +63,12 @@ public:
 	void set_u64(const uint64_t &v);
 	uint64_t get_u64() const;
 
+	void set_f64(double v);
+	double get_f64() const;
+
+	void set_bool(bool v);
+	bool get_bool() const;
+
 	void set_custom(uint8_t type, ICustomVoxelMetadata *custom_data);
 	ICustomVoxelMetadata &get_custom();
 	const ICustomVoxelMetadata &get_custom() const;
@@ -71,6 +79,7 @@ public:
 private:
 	union Data {
 		uint64_t u64_data;
+		double f64_data;
 		ICustomVoxelMetadata *custom_data;
 	};
 
@@ -0,0 +1,116 @@
+#include "voxel_metadata_map.h"
+
+namespace zylann::voxel {
+
+namespace {
+
+// Sorted without duplicates
+bool is_strictly_increasing(const StdVector<uint32_t> &indices) {
+	for (size_t i = 1; i < indices.size(); ++i) {
+		if (indices[i - 1] >= indices[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+void VoxelMetadataMap::sort() {
+	if (is_strictly_increasing(_indices)) {
+		// Common case: items were saved in index order
+		return;
+	}
+
+	// Sort a permutation, then move values into their final place
+	StdVector<uint32_t> order;
+	order.resize(_indices.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	// Stable, so the last of duplicate keys remains last
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { //
+		return _indices[a] < _indices[b];
+	});
+
+	StdVector<uint32_t> sorted_indices;
+	StdVector<VoxelMetadata> sorted_values;
+	sorted_indices.reserve(_indices.size());
+	sorted_values.reserve(_values.size());
+
+	for (size_t i = 0; i < order.size(); ++i) {
+		const uint32_t src = order[i];
+		const uint32_t index = _indices[src];
+		if (sorted_indices.size() > 0 && sorted_indices.back() == index) {
+			sorted_values.back() = std::move(_values[src]);
+		} else {
+			sorted_indices.push_back(index);
+			sorted_values.push_back(std::move(_values[src]));
+		}
+	}
+
+	_indices = std::move(sorted_indices);
+	_values = std::move(sorted_values);
+}
+
+void VoxelMetadataMap::merge(VoxelMetadataMap &&other) {
+	if (other.is_empty()) {
+		return;
+	}
+	if (is_empty()) {
+		_indices = std::move(other._indices);
+		_values = std::move(other._values);
+		other.clear();
+		return;
+	}
+
+	// Fast path when all new items come after the existing ones
+	if (_indices.back() < other._indices.front()) {
+		_indices.insert(_indices.end(), other._indices.begin(), other._indices.end());
+		_values.reserve(_values.size() + other._values.size());
+		for (VoxelMetadata &v : other._values) {
+			_values.push_back(std::move(v));
+		}
+		other.clear();
+		return;
+	}
+
+	StdVector<uint32_t> merged_indices;
+	StdVector<VoxelMetadata> merged_values;
+	merged_indices.reserve(_indices.size() + other._indices.size());
+	merged_values.reserve(_values.size() + other._values.size());
+
+	size_t i = 0;
+	size_t j = 0;
+	while (i < _indices.size() && j < other._indices.size()) {
+		const uint32_t a = _indices[i];
+		const uint32_t b = other._indices[j];
+		if (a < b) {
+			merged_indices.push_back(a);
+			merged_values.push_back(std::move(_values[i]));
+			++i;
+		} else {
+			if (a == b) {
+				// Replaced
+				++i;
+			}
+			merged_indices.push_back(b);
+			merged_values.push_back(std::move(other._values[j]));
+			++j;
+		}
+	}
+	for (; i < _indices.size(); ++i) {
+		merged_indices.push_back(_indices[i]);
+		merged_values.push_back(std::move(_values[i]));
+	}
+	for (; j < other._indices.size(); ++j) {
+		merged_indices.push_back(other._indices[j]);
+		merged_values.push_back(std::move(other._values[j]));
+	}
+
+	_indices = std::move(merged_indices);
+	_values = std::move(merged_values);
+	other.clear();
+}
+
+} // namespace zylann::voxel
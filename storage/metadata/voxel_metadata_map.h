@@ -0,0 +1,136 @@
+#ifndef VOXEL_METADATA_MAP_H
+#define VOXEL_METADATA_MAP_H
+
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_vector.h"
+#include "voxel_metadata.h"
+#include <algorithm>
+
+namespace zylann::voxel {
+
+// Sparse storage of voxel metadata, keyed by the local index of voxels in their buffer (ZXY order, the same as voxel
+// channels). Keys and values are stored in separate arrays sorted by index, so lookups and scans only touch packed
+// integers, and an area of the buffer maps to a contiguous range of keys.
+// Values are `VoxelMetadata`, so small POD payloads stay inline and only custom types allocate.
+class VoxelMetadataMap {
+public:
+	inline size_t size() const {
+		return _indices.size();
+	}
+
+	inline bool is_empty() const {
+		return _indices.size() == 0;
+	}
+
+	inline uint32_t get_index(size_t i) const {
+		return _indices[i];
+	}
+
+	inline const VoxelMetadata &get_value(size_t i) const {
+		return _values[i];
+	}
+
+	inline VoxelMetadata &get_value(size_t i) {
+		return _values[i];
+	}
+
+	inline Span<const uint32_t> get_indices() const {
+		return to_span(_indices);
+	}
+
+	// Returns the position of the first key that is not less than `index`
+	inline size_t lower_bound(uint32_t index) const {
+		return std::lower_bound(_indices.begin(), _indices.end(), index) - _indices.begin();
+	}
+
+	const VoxelMetadata *find(uint32_t index) const {
+		const size_t i = lower_bound(index);
+		if (i < _indices.size() && _indices[i] == index) {
+			return &_values[i];
+		}
+		return nullptr;
+	}
+
+	VoxelMetadata *find(uint32_t index) {
+		const size_t i = lower_bound(index);
+		if (i < _indices.size() && _indices[i] == index) {
+			return &_values[i];
+		}
+		return nullptr;
+	}
+
+	VoxelMetadata &get_or_create(uint32_t index) {
+		const size_t i = lower_bound(index);
+		if (i < _indices.size() && _indices[i] == index) {
+			return _values[i];
+		}
+		_indices.insert(_indices.begin() + i, index);
+		_values.insert(_values.begin() + i, VoxelMetadata());
+		return _values[i];
+	}
+
+	bool erase(uint32_t index) {
+		const size_t i = lower_bound(index);
+		if (i < _indices.size() && _indices[i] == index) {
+			_indices.erase(_indices.begin() + i);
+			_values.erase(_values.begin() + i);
+			return true;
+		}
+		return false;
+	}
+
+	void clear() {
+		_indices.clear();
+		_values.clear();
+	}
+
+	void reserve(size_t capacity) {
+		_indices.reserve(capacity);
+		_values.reserve(capacity);
+	}
+
+	// Adds an item at the end without keeping keys sorted. This is meant for bulk initialization, `sort()` must be
+	// called afterward.
+	inline VoxelMetadata &push_back_unsorted(uint32_t index) {
+		_indices.push_back(index);
+		_values.emplace_back();
+		return _values.back();
+	}
+
+	// Restores sorting after items were added with `push_back_unsorted`. Does nothing if they were already added in
+	// order. If the same key was added more than once, the last one is kept.
+	void sort();
+
+	// Inserts all items from another map, replacing existing ones with the same keys. Both maps are sorted, so this
+	// runs in linear time. Items of `other` are moved.
+	void merge(VoxelMetadataMap &&other);
+
+	// Removes items for which `predicate(uint32_t index, const VoxelMetadata &meta)` returns true.
+	template <typename F>
+	void remove_if(F predicate) {
+		size_t dst = 0;
+		for (size_t src = 0; src < _indices.size(); ++src) {
+			if (predicate(_indices[src], static_cast<const VoxelMetadata &>(_values[src]))) {
+				continue;
+			}
+			if (dst != src) {
+				_indices[dst] = _indices[src];
+				_values[dst] = std::move(_values[src]);
+			}
+			++dst;
+		}
+		_indices.resize(dst);
+		// Removed values were either moved-from or left at the end, they get destroyed here
+		_values.resize(dst);
+	}
+
+private:
+	// Sorted
+	StdVector<uint32_t> _indices;
+	// One per index
+	StdVector<VoxelMetadata> _values;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_METADATA_MAP_H
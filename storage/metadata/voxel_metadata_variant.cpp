@@ -37,6 +37,12 @@ Variant get_as_variant(const VoxelMetadata &meta) {
 		case VoxelMetadata::TYPE_U64: {
 			return Variant(int64_t(meta.get_u64()));
 		}
+		case VoxelMetadata::TYPE_F64: {
+			return Variant(meta.get_f64());
+		}
+		case VoxelMetadata::TYPE_BOOL: {
+			return Variant(meta.get_bool());
+		}
 		default:
 			ZN_PRINT_ERROR("Unknown VoxelMetadata type");
 			return Variant();
@@ -44,18 +50,31 @@ Variant get_as_variant(const VoxelMetadata &meta) {
 }
 
 void set_as_variant(VoxelMetadata &meta, Variant v) {
-	if (v.get_type() == Variant::NIL) {
-		meta.clear();
-	} else {
-		if (int(meta.get_type()) == METADATA_TYPE_VARIANT) {
-			VoxelMetadataVariant &mv = static_cast<VoxelMetadataVariant &>(meta.get_custom());
-			mv.data = v;
+	switch (v.get_type()) {
+		case Variant::NIL:
+			meta.clear();
 			return;
-		} else {
-			VoxelMetadataVariant *mv = ZN_NEW(VoxelMetadataVariant);
-			mv->data = v;
-			meta.set_custom(METADATA_TYPE_VARIANT, mv);
-		}
+		// Small values are stored inline, to avoid allocating a Variant for each voxel
+		case Variant::INT:
+			meta.set_u64(int64_t(v));
+			return;
+		case Variant::FLOAT:
+			meta.set_f64(double(v));
+			return;
+		case Variant::BOOL:
+			meta.set_bool(bool(v));
+			return;
+		default:
+			break;
+	}
+
+	if (int(meta.get_type()) == METADATA_TYPE_VARIANT) {
+		VoxelMetadataVariant &mv = static_cast<VoxelMetadataVariant &>(meta.get_custom());
+		mv.data = v;
+	} else {
+		VoxelMetadataVariant *mv = ZN_NEW(VoxelMetadataVariant);
+		mv->data = v;
+		meta.set_custom(METADATA_TYPE_VARIANT, mv);
 	}
 }
 
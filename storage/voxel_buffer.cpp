@@ -570,6 +570,16 @@ void VoxelBuffer::decompress_channel(unsigned int channel_index) {
 	}
 }
 
+void VoxelBuffer::decompress_channel_noinit(unsigned int channel_index) {
+	ZN_DSTACK();
+	ZN_ASSERT_RETURN(channel_index < MAX_CHANNELS);
+	ZN_ASSERT_RETURN(!Vector3iUtil::is_empty_size(get_size()));
+	Channel &channel = _channels[channel_index];
+	if (channel.compression == COMPRESSION_UNIFORM) {
+		ZN_ASSERT_RETURN(create_channel_noinit(channel_index, _size));
+	}
+}
+
 VoxelBuffer::Compression VoxelBuffer::get_channel_compression(unsigned int channel_index) const {
 	ZN_ASSERT_RETURN_V(channel_index < MAX_CHANNELS, VoxelBuffer::COMPRESSION_NONE);
 	const Channel &channel = _channels[channel_index];
@@ -761,6 +771,17 @@ size_t VoxelBuffer::get_size_in_bytes_for_volume(Vector3i size, Depth depth) {
 	return size_in_bytes;
 }
 
+size_t VoxelBuffer::get_allocated_channels_size_in_bytes() const {
+	size_t size = 0;
+	for (unsigned int i = 0; i < _channels.size(); ++i) {
+		const Channel &channel = _channels[i];
+		if (channel.compression == COMPRESSION_NONE) {
+			size += channel.size_in_bytes;
+		}
+	}
+	return size;
+}
+
 bool VoxelBuffer::create_channel_noinit(int i, Vector3i size) {
 	ZN_DSTACK();
 	Channel &channel = _channels[i];
@@ -971,37 +992,35 @@ void VoxelBuffer::get_range_f(float &out_min, float &out_max, ChannelId channel_
 
 const VoxelMetadata *VoxelBuffer::get_voxel_metadata(Vector3i pos) const {
 	ZN_ASSERT_RETURN_V(is_position_valid(pos), nullptr);
-	return _voxel_metadata.find(pos);
+	return _voxel_metadata.find(get_index(pos, _size));
 }
 
 VoxelMetadata *VoxelBuffer::get_voxel_metadata(Vector3i pos) {
 	ZN_ASSERT_RETURN_V(is_position_valid(pos), nullptr);
-	return _voxel_metadata.find(pos);
+	return _voxel_metadata.find(get_index(pos, _size));
 }
 
 VoxelMetadata *VoxelBuffer::get_or_create_voxel_metadata(Vector3i pos) {
 	ZN_ASSERT_RETURN_V(is_position_valid(pos), nullptr);
-	VoxelMetadata *d = _voxel_metadata.find(pos);
-	if (d != nullptr) {
-		return d;
-	}
-	// TODO Optimize: we know the key should not exist
-	VoxelMetadata &meta = _voxel_metadata.insert_or_assign(pos, VoxelMetadata());
-	return &meta;
+	// Metadata keys are 32-bit voxel indices
+	ZN_ASSERT_RETURN_V(Vector3iUtil::get_volume(_size) <= std::numeric_limits<uint32_t>::max(), nullptr);
+	return &_voxel_metadata.get_or_create(get_index(pos, _size));
 }
 
 void VoxelBuffer::erase_voxel_metadata(Vector3i pos) {
 	ZN_ASSERT_RETURN(is_position_valid(pos));
-	_voxel_metadata.erase(pos);
+	_voxel_metadata.erase(get_index(pos, _size));
 }
 
-void VoxelBuffer::clear_and_set_voxel_metadata(Span<FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair> pairs) {
+void VoxelBuffer::clear_and_set_voxel_metadata(VoxelMetadataMap &&map) {
 #ifdef DEBUG_ENABLED
-	for (size_t i = 0; i < pairs.size(); ++i) {
-		ZN_ASSERT_CONTINUE(is_position_valid(pairs[i].key));
+	const uint64_t volume = Vector3iUtil::get_volume(_size);
+	for (size_t i = 0; i < map.size(); ++i) {
+		ZN_ASSERT_CONTINUE(map.get_index(i) < volume);
 	}
 #endif
-	_voxel_metadata.clear_and_insert(pairs);
+	_voxel_metadata = std::move(map);
+	_voxel_metadata.sort();
 }
 
 /*#ifdef ZN_GODOT
@@ -1048,8 +1067,20 @@ void VoxelBuffer::clear_voxel_metadata() {
 }
 
 void VoxelBuffer::clear_voxel_metadata_in_area(Box3i box) {
-	_voxel_metadata.remove_if([&box](const FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair &p) { //
-		return box.contains(p.key);
+	box.clip(Box3i(Vector3i(), _size));
+	if (box.is_empty() || _voxel_metadata.is_empty()) {
+		return;
+	}
+	if (box.size == _size) {
+		_voxel_metadata.clear();
+		return;
+	}
+	const Vector3i size = _size;
+	const uint32_t min_index = get_index(box.position, size);
+	const uint32_t max_index = get_index(box.position + box.size - Vector3i(1, 1, 1), size);
+	_voxel_metadata.remove_if([&box, size, min_index, max_index](uint32_t index, const VoxelMetadata &meta) {
+		// Decoding the position is only needed for keys within the index range of the box
+		return index >= min_index && index <= max_index && box.contains(Vector3iUtil::from_zxy_index(index, size));
 	});
 }
 
@@ -1057,30 +1088,33 @@ void VoxelBuffer::copy_voxel_metadata_in_area(const VoxelBuffer &src_buffer, Box
 	ZN_ASSERT_RETURN(src_buffer.is_box_valid(src_box));
 
 	const Box3i clipped_src_box = src_box.clipped(Box3i(src_box.position - dst_origin, _size));
-	const Vector3i clipped_dst_offset = dst_origin + clipped_src_box.position - src_box.position;
-
-	for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator src_it = src_buffer._voxel_metadata.begin();
-		 src_it != src_buffer._voxel_metadata.end();
-		 ++src_it) {
-		if (src_box.contains(src_it->key)) {
-			const Vector3i dst_pos = src_it->key + clipped_dst_offset;
-			ZN_ASSERT(is_position_valid(dst_pos));
-
-			VoxelMetadata &meta = _voxel_metadata.insert_or_assign(dst_pos, VoxelMetadata());
-			meta.copy_from(src_it->value);
-		}
-	}
+	const Vector3i src_to_dst_offset = dst_origin - src_box.position;
+
+	// Translation preserves ZXY ordering, so items come out sorted and can be merged in one pass instead of being
+	// inserted one by one
+	VoxelMetadataMap copied;
+	src_buffer.for_each_voxel_metadata_in_area(
+			clipped_src_box,
+			[this, &copied, src_to_dst_offset](Vector3i src_pos, const VoxelMetadata &src_meta) {
+				const Vector3i dst_pos = src_pos + src_to_dst_offset;
+				ZN_ASSERT(is_position_valid(dst_pos));
+				copied.push_back_unsorted(get_index(dst_pos, _size)).copy_from(src_meta);
+			}
+	);
+	_voxel_metadata.merge(std::move(copied));
 }
 
 void VoxelBuffer::copy_voxel_metadata(const VoxelBuffer &src_buffer) {
 	ZN_ASSERT_RETURN(src_buffer.get_size() == _size);
 
-	for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator src_it = src_buffer._voxel_metadata.begin();
-		 src_it != src_buffer._voxel_metadata.end();
-		 ++src_it) {
-		VoxelMetadata &meta = _voxel_metadata.insert_or_assign(src_it->key, VoxelMetadata());
-		meta.copy_from(src_it->value);
+	// Same size means same keys
+	const VoxelMetadataMap &src_map = src_buffer._voxel_metadata;
+	VoxelMetadataMap copied;
+	copied.reserve(src_map.size());
+	for (size_t i = 0; i < src_map.size(); ++i) {
+		copied.push_back_unsorted(src_map.get_index(i)).copy_from(src_map.get_value(i));
 	}
+	_voxel_metadata.merge(std::move(copied));
 
 	_block_metadata.copy_from(src_buffer._block_metadata);
 }
@@ -1304,9 +1338,9 @@ void paste_src_masked(
 
 	if (with_metadata) {
 		dst_buffer.erase_voxel_metadata_if([dst_box, &src_buffer, src_mask_channel, src_mask_value](
-												   const FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair &p
+												   Vector3i pos, const VoxelMetadata &meta
 										   ) {
-			return dst_box.contains(p.key) && src_buffer.get_voxel(p.key, src_mask_channel) != src_mask_value;
+			return dst_box.contains(pos) && src_buffer.get_voxel(pos, src_mask_channel) != src_mask_value;
 		});
 
 		const Box3i src_box(dst_box.position - dst_base_pos, dst_box.size);
@@ -1395,12 +1429,12 @@ void paste_src_masked_dst_predicate(
 	if (with_metadata) {
 		dst_buffer.erase_voxel_metadata_if(
 				[&src_buffer, src_mask_channel, src_mask_value, dst_box, &dst_buffer, dst_mask_channel, &dst_predicate](
-						const FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair &p
+						Vector3i pos, const VoxelMetadata &meta
 				) {
 					//
-					return dst_box.contains(p.key) //
-							&& src_buffer.get_voxel(p.key, src_mask_channel) != src_mask_value //
-							&& dst_predicate(dst_buffer.get_voxel(p.key, dst_mask_channel));
+					return dst_box.contains(pos) //
+							&& src_buffer.get_voxel(pos, src_mask_channel) != src_mask_value //
+							&& dst_predicate(dst_buffer.get_voxel(pos, dst_mask_channel));
 				}
 		);
 
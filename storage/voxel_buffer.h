@@ -7,6 +7,7 @@
 #include "../util/math/box3i.h"
 #include "funcs.h"
 #include "metadata/voxel_metadata.h"
+#include "metadata/voxel_metadata_map.h"
 
 #include <limits>
 
@@ -170,10 +171,16 @@ public:
 
 	void compress_uniform_channels();
 	void decompress_channel(unsigned int channel_index);
+	// Same as `decompress_channel`, but leaves contents of the channel uninitialized. Used when the caller is going to
+	// overwrite all of it anyways, like deserialization.
+	void decompress_channel_noinit(unsigned int channel_index);
 	Compression get_channel_compression(unsigned int channel_index) const;
 
 	static size_t get_size_in_bytes_for_volume(Vector3i size, Depth depth);
 
+	// Gets how many bytes are allocated for voxel channels. Does not include metadata.
+	size_t get_allocated_channels_size_in_bytes() const;
+
 	void copy_format(const VoxelBuffer &other);
 
 	// Specialized copy functions.
@@ -482,24 +489,49 @@ public:
 	VoxelMetadata *get_or_create_voxel_metadata(Vector3i pos);
 	void erase_voxel_metadata(Vector3i pos);
 
-	void clear_and_set_voxel_metadata(Span<FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair> pairs);
+	// Replaces all voxel metadata. Keys are indices of voxels in this buffer, and don't need to be sorted.
+	void clear_and_set_voxel_metadata(VoxelMetadataMap &&map);
+
+	// Calls `callback(Vector3i pos, const VoxelMetadata &meta)` for each voxel metadata, in index order.
+	template <typename F>
+	void for_each_voxel_metadata(F callback) const {
+		for (size_t i = 0; i < _voxel_metadata.size(); ++i) {
+			const Vector3i pos = Vector3iUtil::from_zxy_index(_voxel_metadata.get_index(i), _size);
+			callback(pos, _voxel_metadata.get_value(i));
+		}
+	}
 
+	// Calls `callback(Vector3i pos, const VoxelMetadata &meta)` for each voxel metadata within the box, in index order.
 	template <typename F>
 	void for_each_voxel_metadata_in_area(Box3i box, F callback) const {
-		// TODO For `find`s and this kind of iteration, we may want to separate keys and values in FlatMap's internal
-		// storage, to reduce cache misses
-		for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator it = _voxel_metadata.begin();
-			 it != _voxel_metadata.end();
-			 ++it) {
-			if (box.contains(it->key)) {
-				callback(it->key, it->value);
+		box.clip(Box3i(Vector3i(), _size));
+		if (box.is_empty() || _voxel_metadata.is_empty()) {
+			return;
+		}
+		// Keys are sorted in ZXY order, so only the range between the first and last voxels of the box has to be
+		// scanned
+		const Vector3i box_max = box.position + box.size - Vector3i(1, 1, 1);
+		const uint32_t min_index = get_index(box.position, _size);
+		const uint32_t max_index = get_index(box_max, _size);
+		for (size_t i = _voxel_metadata.lower_bound(min_index); i < _voxel_metadata.size(); ++i) {
+			const uint32_t index = _voxel_metadata.get_index(i);
+			if (index > max_index) {
+				break;
+			}
+			const Vector3i pos = Vector3iUtil::from_zxy_index(index, _size);
+			if (box.contains(pos)) {
+				callback(pos, _voxel_metadata.get_value(i));
 			}
 		}
 	}
 
+	// Erases voxel metadata for which `predicate(Vector3i pos, const VoxelMetadata &meta)` returns true.
 	template <typename F>
 	inline void erase_voxel_metadata_if(F predicate) {
-		_voxel_metadata.remove_if(predicate);
+		const Vector3i size = _size;
+		_voxel_metadata.remove_if([size, &predicate](uint32_t index, const VoxelMetadata &meta) {
+			return predicate(Vector3iUtil::from_zxy_index(index, size), meta);
+		});
 	}
 
 	// #ifdef ZN_GODOT
@@ -513,7 +545,7 @@ public:
 	void copy_voxel_metadata_in_area(const VoxelBuffer &src_buffer, Box3i src_box, Vector3i dst_origin);
 	void copy_voxel_metadata(const VoxelBuffer &src_buffer);
 
-	const FlatMapMoveOnly<Vector3i, VoxelMetadata> &get_voxel_metadata() const {
+	const VoxelMetadataMap &get_voxel_metadata() const {
 		return _voxel_metadata;
 	}
 
@@ -541,8 +573,8 @@ private:
 
 	// TODO Could we separate metadata from VoxelBuffer?
 	VoxelMetadata _block_metadata;
-	// This metadata is expected to be sparse, with low amount of items.
-	FlatMapMoveOnly<Vector3i, VoxelMetadata> _voxel_metadata;
+	// This metadata is expected to be sparse. Keys are voxel indices, so it must be cleared when the size changes.
+	VoxelMetadataMap _voxel_metadata;
 };
 
 void get_unscaled_sdf(const VoxelBuffer &voxels, Span<float> sdf);
@@ -626,6 +626,67 @@ void VoxelData::clear_cached_blocks_in_voxel_area(Box3i p_voxel_box) {
 	}
 }
 
+void VoxelData::get_evictable_blocks(uint32_t max_access_clock, StdVector<EvictableBlock> &out_blocks) const {
+	ZN_PROFILE_SCOPE();
+	const unsigned int lod_count = get_lod_count();
+
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		const Lod &lod = _lods[lod_index];
+		// Not locking spatially, results are checked again when evicting
+		RWLockRead rlock(lod.map_lock);
+
+		lod.map.for_each_block([&out_blocks, max_access_clock, lod_index](Vector3i bpos, const VoxelDataBlock &block) {
+			if (!block.is_voxel_data_reproducible()) {
+				return;
+			}
+			const uint32_t last_access = block.get_last_access();
+			// Clock values are compared relatively, so wrapping around does not break ordering
+			if (static_cast<int32_t>(max_access_clock - last_access) < 0) {
+				return;
+			}
+			const size_t size = block.get_voxels_const().get_allocated_channels_size_in_bytes();
+			if (size == 0) {
+				// Only uniform channels, not worth it
+				return;
+			}
+			out_blocks.push_back(EvictableBlock{ bpos, last_access, static_cast<uint32_t>(size), uint8_t(lod_index) });
+		});
+	}
+}
+
+size_t VoxelData::evict_blocks(Span<const EvictableBlock> blocks, unsigned int &out_evicted_count) {
+	ZN_PROFILE_SCOPE();
+	size_t released_bytes = 0;
+	unsigned int evicted_count = 0;
+
+	for (const EvictableBlock &eb : blocks) {
+		if (eb.lod_index >= get_lod_count()) {
+			continue;
+		}
+		Lod &lod = _lods[eb.lod_index];
+
+		// Don't wait on blocks currently used by other threads, they are not good candidates anyways
+		const BoxBounds3i bounds = BoxBounds3i::from_position(eb.position);
+		if (!lod.spatial_lock.try_lock_write(bounds)) {
+			continue;
+		}
+		{
+			RWLockRead rlock(lod.map_lock);
+			VoxelDataBlock *block = lod.map.peek_block(eb.position);
+			if (block != nullptr && block->is_voxel_data_reproducible() && !block->is_voxel_data_shared() &&
+				block->get_last_access() == eb.last_access) {
+				released_bytes += block->get_voxels_const().get_allocated_channels_size_in_bytes();
+				block->clear_voxels();
+				++evicted_count;
+			}
+		}
+		lod.spatial_lock.unlock_write(bounds);
+	}
+
+	out_evicted_count = evicted_count;
+	return released_bytes;
+}
+
 void VoxelData::mark_area_modified(
 		Box3i p_voxel_box,
 		StdVector<Vector3i> *lod0_new_blocks_to_lod,
@@ -878,6 +939,8 @@ void VoxelData::update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector
 			}
 
 			dst_block->set_modified(true);
+			// Mips contain downscaled edits, so they can't be obtained from generators anymore
+			dst_block->set_edited(true);
 
 			if (dst_lod_index != lod_count - 1 && !dst_block->get_needs_lodding()) {
 				dst_block->set_needs_lodding(true);
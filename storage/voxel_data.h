@@ -150,6 +150,21 @@ public:
 	// TODO Rename `clear_cached_voxel_data_in_area`
 	void clear_cached_blocks_in_voxel_area(Box3i p_voxel_box);
 
+	struct EvictableBlock {
+		Vector3i position;
+		uint32_t last_access;
+		uint32_t size_in_bytes;
+		uint8_t lod_index;
+	};
+
+	// Gets blocks whose voxel data is only a cache of generators and modifiers, and was not used since
+	// `max_access_clock`. Such data can be dropped to save memory, and will be obtained again when needed.
+	void get_evictable_blocks(uint32_t max_access_clock, StdVector<EvictableBlock> &out_blocks) const;
+
+	// Drops voxel data of the given blocks, if they are still reproducible and were not used since they were listed.
+	// Returns how many bytes were released.
+	size_t evict_blocks(Span<const EvictableBlock> blocks, unsigned int &out_evicted_count);
+
 	// Flags all blocks in the given area as modified at LOD0.
 	// Also marks them as requiring LOD updates (if lod count is 1 this has no effect).
 	// Optionally, returns a list of affected block positions which did not require LOD updates before.
@@ -4,6 +4,12 @@
 
 namespace zylann::voxel {
 
+std::atomic_uint32_t VoxelDataBlock::s_access_clock = { 0 };
+
+void VoxelDataBlock::advance_access_clock() {
+	++s_access_clock;
+}
+
 void VoxelDataBlock::set_modified(bool modified) {
 	// #ifdef TOOLS_ENABLED
 	// 	if (_modified == false && modified) {
@@ -2,6 +2,7 @@
 #define VOXEL_DATA_BLOCK_H
 
 #include "../util/ref_count.h"
+#include <atomic>
 #include <memory>
 
 namespace zylann::voxel {
@@ -29,7 +30,8 @@ public:
 			_lod_index(src._lod_index),
 			_needs_lodding(src._needs_lodding),
 			_modified(src._modified),
-			_edited(src._edited) {}
+			_edited(src._edited),
+			_last_access(src.get_last_access()) {}
 
 	VoxelDataBlock(const VoxelDataBlock &src) :
 			viewers(src.viewers),
@@ -37,7 +39,8 @@ public:
 			_lod_index(src._lod_index),
 			_needs_lodding(src._needs_lodding),
 			_modified(src._modified),
-			_edited(src._edited) {}
+			_edited(src._edited),
+			_last_access(src.get_last_access()) {}
 
 	VoxelDataBlock &operator=(VoxelDataBlock &&src) {
 		viewers = src.viewers;
@@ -46,6 +49,7 @@ public:
 		_needs_lodding = src._needs_lodding;
 		_modified = src._modified;
 		_edited = src._edited;
+		_last_access = src.get_last_access();
 		return *this;
 	}
 
@@ -56,6 +60,7 @@ public:
 		_needs_lodding = src._needs_lodding;
 		_modified = src._modified;
 		_edited = src._edited;
+		_last_access = src.get_last_access();
 		return *this;
 	}
 
@@ -126,6 +131,38 @@ public:
 		return _edited;
 	}
 
+	// Tells if voxel data is only a cache of generators and modifiers, so it can be dropped and obtained again
+	// transparently later.
+	inline bool is_voxel_data_reproducible() const {
+		return _voxels != nullptr && !_edited && !_modified && !_needs_lodding;
+	}
+
+	// Tells if voxel data is referenced somewhere else than in this block (tasks, save queues...)
+	inline bool is_voxel_data_shared() const {
+		return _voxels.use_count() > 1;
+	}
+
+	// Marks the block as recently used, so it is less likely to be evicted when memory is constrained.
+	// Can be called from multiple threads.
+	inline void touch() const {
+		const uint32_t now = get_access_clock();
+		// Avoid writing if possible, because many threads can access the same blocks
+		if (_last_access.load(std::memory_order_relaxed) != now) {
+			_last_access.store(now, std::memory_order_relaxed);
+		}
+	}
+
+	inline uint32_t get_last_access() const {
+		return _last_access.load(std::memory_order_relaxed);
+	}
+
+	// The access clock is a counter incremented periodically (usually every frame), used to sort blocks by last use.
+	static void advance_access_clock();
+
+	static inline uint32_t get_access_clock() {
+		return s_access_clock.load(std::memory_order_relaxed);
+	}
+
 private:
 	// Voxel data. If null, it means the data may be obtained with procedural generation.
 	std::shared_ptr<VoxelBuffer> _voxels;
@@ -145,6 +182,11 @@ private:
 	// Once it becomes `true`, it usually never comes back to `false` unless reverted.
 	bool _edited = false;
 
+	// Value of the access clock when the block was last used
+	mutable std::atomic_uint32_t _last_access = { get_access_clock() };
+
+	static std::atomic_uint32_t s_access_clock;
+
 	// TODO Optimization: design a proper way to implement client-side caching for multiplayer
 	//
 	// Represents how many times the block was edited.
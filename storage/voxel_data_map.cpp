@@ -108,12 +108,22 @@ void VoxelDataMap::set_voxel_f(real_t value, Vector3i pos, unsigned int c) {
 VoxelDataBlock *VoxelDataMap::get_block(Vector3i bpos) {
 	auto it = _blocks_map.find(bpos);
 	if (it != _blocks_map.end()) {
+		it->second.touch();
 		return &it->second;
 	}
 	return nullptr;
 }
 
 const VoxelDataBlock *VoxelDataMap::get_block(Vector3i bpos) const {
+	auto it = _blocks_map.find(bpos);
+	if (it != _blocks_map.end()) {
+		it->second.touch();
+		return &it->second;
+	}
+	return nullptr;
+}
+
+VoxelDataBlock *VoxelDataMap::peek_block(Vector3i bpos) {
 	auto it = _blocks_map.find(bpos);
 	if (it != _blocks_map.end()) {
 		return &it->second;
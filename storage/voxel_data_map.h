@@ -118,9 +118,13 @@ public:
 		}
 	}
 
+	// Gets a block and marks it as recently used.
 	VoxelDataBlock *get_block(Vector3i bpos);
 	const VoxelDataBlock *get_block(Vector3i bpos) const;
 
+	// Gets a block without marking it as recently used.
+	VoxelDataBlock *peek_block(Vector3i bpos);
+
 	bool has_block(Vector3i pos) const;
 	bool is_block_surrounded(Vector3i pos) const;
 
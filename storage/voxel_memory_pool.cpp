@@ -1,4 +1,5 @@
 #include "voxel_memory_pool.h"
+#include "../util/containers/container_funcs.h"
 #include "../util/macros.h"
 #include "../util/memory/memory.h"
 #include "../util/profiling.h"
@@ -9,8 +10,31 @@ namespace zylann::voxel {
 
 namespace {
 VoxelMemoryPool *g_memory_pool = nullptr;
+// Protects the attachment of thread caches to pools. Not a member of the pool, because thread caches can outlive it.
+// Lock order is this mutex, then a thread cache's spin lock, then a pool's mutex.
+BinaryMutex g_thread_caches_mutex;
 } // namespace
 
+struct VoxelMemoryPool::ThreadCacheHolder {
+	ThreadCache *cache = nullptr;
+
+	~ThreadCacheHolder() {
+		if (cache == nullptr) {
+			return;
+		}
+		{
+			MutexLock lock(g_thread_caches_mutex);
+			VoxelMemoryPool *pool = cache->pool;
+			if (pool != nullptr) {
+				pool->drain_thread_cache(*cache);
+				pool->_exited_thread_cache_counters.add(cache->counters);
+				pool->unregister_thread_cache(*cache);
+			}
+		}
+		ZN_DELETE(cache);
+	}
+};
+
 void VoxelMemoryPool::create_singleton() {
 	ZN_ASSERT(g_memory_pool == nullptr);
 	g_memory_pool = ZN_NEW(VoxelMemoryPool);
@@ -93,9 +117,101 @@ VoxelMemoryPool::~VoxelMemoryPool() {
 		debug_print();
 	}
 #endif
+	{
+		// Threads may still be alive after the pool is destroyed (the main thread at least), so give back their
+		// blocks and detach their caches.
+		MutexLock lock(g_thread_caches_mutex);
+		for (ThreadCache *tc : _thread_caches) {
+			drain_thread_cache(*tc);
+			tc->spin_lock.lock();
+			tc->pool = nullptr;
+			tc->spin_lock.unlock();
+		}
+		_thread_caches.clear();
+	}
 	clear();
 }
 
+VoxelMemoryPool::ThreadCache *VoxelMemoryPool::get_thread_cache() {
+	static thread_local ThreadCacheHolder tls_holder;
+
+	ThreadCache *tc = tls_holder.cache;
+	if (tc == nullptr) {
+		tc = ZN_NEW(ThreadCache);
+		tls_holder.cache = tc;
+	}
+	// `pool` is only modified by the owner thread, or when the pool gets destroyed, in which case it must not be in
+	// use anymore.
+	if (tc->pool == this) {
+		return tc;
+	}
+	if (tc->pool != nullptr) {
+		// Attached to another pool. Only the singleton is expected to be used frequently, so we don't bother
+		// having one cache per pool.
+		return nullptr;
+	}
+	register_thread_cache(*tc);
+	return tc;
+}
+
+void VoxelMemoryPool::register_thread_cache(ThreadCache &tc) {
+	MutexLock lock(g_thread_caches_mutex);
+	tc.spin_lock.lock();
+	tc.pool = this;
+	tc.spin_lock.unlock();
+	_thread_caches.push_back(&tc);
+}
+
+void VoxelMemoryPool::unregister_thread_cache(ThreadCache &tc) {
+	// Global mutex must be locked by the caller
+	ZN_ASSERT(tc.pool == this);
+	tc.spin_lock.lock();
+	tc.pool = nullptr;
+	tc.spin_lock.unlock();
+	const bool removed = unordered_remove_value(_thread_caches, &tc);
+	ZN_ASSERT(removed);
+}
+
+// Moves blocks from a magazine back to its shared pool, until it contains `keep_count` blocks.
+void VoxelMemoryPool::drain_magazine(Magazine &magazine, unsigned int pool_index, unsigned int keep_count) {
+	if (magazine.count <= keep_count) {
+		return;
+	}
+	Pool &pool = _pot_pools[pool_index];
+	MutexLock lock(pool.mutex);
+	for (unsigned int i = keep_count; i < magazine.count; ++i) {
+		pool.blocks.push_back(magazine.blocks[i]);
+	}
+	magazine.count = keep_count;
+}
+
+void VoxelMemoryPool::drain_thread_cache(ThreadCache &tc) {
+	tc.spin_lock.lock();
+	for (unsigned int pot = 0; pot < tc.magazines.size(); ++pot) {
+		drain_magazine(tc.magazines[pot], pot, 0);
+	}
+	tc.spin_lock.unlock();
+}
+
+void VoxelMemoryPool::trim_thread_caches() {
+	ZN_PROFILE_SCOPE();
+	MutexLock lock(g_thread_caches_mutex);
+	for (ThreadCache *tc : _thread_caches) {
+		drain_thread_cache(*tc);
+	}
+}
+
+void VoxelMemoryPool::set_thread_caches_enabled(bool enabled) {
+	_thread_caches_enabled = enabled;
+	if (!enabled) {
+		trim_thread_caches();
+	}
+}
+
+bool VoxelMemoryPool::is_thread_caches_enabled() const {
+	return _thread_caches_enabled;
+}
+
 uint8_t *VoxelMemoryPool::allocate(size_t size) {
 	ZN_DSTACK();
 	ZN_PROFILE_SCOPE();
@@ -120,13 +236,50 @@ uint8_t *VoxelMemoryPool::allocate(size_t size) {
 	} else {
 		const unsigned int pot = get_pool_index_from_size(size);
 		Pool &pool = _pot_pools[pot];
-		pool.mutex.lock();
-		if (pool.blocks.size() > 0) {
-			block = pool.blocks.back();
-			pool.blocks.pop_back();
-			pool.mutex.unlock();
+
+		// Try the cache of the current thread first
+		ThreadCache *tc = nullptr;
+		if (is_pool_cached_per_thread(pot) && _thread_caches_enabled.load(std::memory_order_relaxed)) {
+			tc = get_thread_cache();
+		}
+
+		if (tc != nullptr) {
+			tc->spin_lock.lock();
+			Magazine &magazine = tc->magazines[pot];
+			if (magazine.count > 0) {
+				++tc->counters.hits;
+			} else {
+				// Refill half of the magazine at once, so the next allocations don't have to lock the pool
+				const unsigned int refill_count = get_magazine_capacity(pot) / 2;
+				pool.mutex.lock();
+				while (magazine.count < refill_count && pool.blocks.size() > 0) {
+					magazine.blocks[magazine.count] = pool.blocks.back();
+					++magazine.count;
+					pool.blocks.pop_back();
+				}
+				pool.mutex.unlock();
+				if (magazine.count > 0) {
+					++tc->counters.refills;
+				} else {
+					++tc->counters.misses;
+				}
+			}
+			if (magazine.count > 0) {
+				--magazine.count;
+				block = magazine.blocks[magazine.count];
+			}
+			tc->spin_lock.unlock();
+
 		} else {
+			pool.mutex.lock();
+			if (pool.blocks.size() > 0) {
+				block = pool.blocks.back();
+				pool.blocks.pop_back();
+			}
 			pool.mutex.unlock();
+		}
+
+		if (block == nullptr) {
 			ZN_PROFILE_SCOPE_NAMED("new alloc");
 			// All allocations done in this pool have the same size,
 			// which must be greater or equal to `size`
@@ -175,14 +328,37 @@ void VoxelMemoryPool::recycle(uint8_t *block, size_t size) {
 		// Make sure this allocation was done by this pool in this scenario
 		pool.debug_used_blocks.remove(block);
 #endif
-		MutexLock lock(pool.mutex);
-		pool.blocks.push_back(block);
+		ThreadCache *tc = nullptr;
+		if (is_pool_cached_per_thread(pot) && _thread_caches_enabled.load(std::memory_order_relaxed)) {
+			tc = get_thread_cache();
+		}
+
+		if (tc != nullptr) {
+			tc->spin_lock.lock();
+			Magazine &magazine = tc->magazines[pot];
+			const unsigned int capacity = get_magazine_capacity(pot);
+			if (magazine.count == capacity) {
+				// Only drain half of it, so alternating allocations and recycling near the limit does not bounce
+				// blocks back and forth with the shared pool
+				drain_magazine(magazine, pot, capacity / 2);
+				++tc->counters.drains;
+			}
+			magazine.blocks[magazine.count] = block;
+			++magazine.count;
+			tc->spin_lock.unlock();
+
+		} else {
+			MutexLock lock(pool.mutex);
+			pool.blocks.push_back(block);
+		}
 	}
 	--_used_blocks;
 	_used_memory -= size;
 }
 
 void VoxelMemoryPool::clear_unused_blocks() {
+	trim_thread_caches();
+
 	for (unsigned int pot = 0; pot < _pot_pools.size(); ++pot) {
 		Pool &pool = _pot_pools[pot];
 		MutexLock lock(pool.mutex);
@@ -217,6 +393,10 @@ void VoxelMemoryPool::debug_print() {
 		MutexLock lock(pool.mutex);
 		print_line(format("Pool {}: {} blocks (capacity {})", pot, pool.blocks.size(), pool.blocks.capacity()));
 	}
+	const ThreadCacheStats tcs = debug_get_thread_cache_stats();
+	print_line(format("Thread caches: {} threads, {} blocks, {} bytes, hits: {}, refills: {}, misses: {}, drains: {}",
+			tcs.thread_count, tcs.cached_blocks, tcs.cached_memory, tcs.counters.hits, tcs.counters.refills,
+			tcs.counters.misses, tcs.counters.drains));
 }
 
 unsigned int VoxelMemoryPool::debug_get_used_blocks() const {
@@ -231,4 +411,22 @@ size_t VoxelMemoryPool::debug_get_total_memory() const {
 	return _total_memory;
 }
 
+VoxelMemoryPool::ThreadCacheStats VoxelMemoryPool::debug_get_thread_cache_stats() const {
+	ThreadCacheStats stats;
+	MutexLock lock(g_thread_caches_mutex);
+	stats.counters = _exited_thread_cache_counters;
+	stats.thread_count = _thread_caches.size();
+	for (ThreadCache *tc : _thread_caches) {
+		tc->spin_lock.lock();
+		stats.counters.add(tc->counters);
+		for (unsigned int pot = 0; pot < tc->magazines.size(); ++pot) {
+			const unsigned int count = tc->magazines[pot].count;
+			stats.cached_blocks += count;
+			stats.cached_memory += count * get_size_from_pool_index(pot);
+		}
+		tc->spin_lock.unlock();
+	}
+	return stats;
+}
+
 } // namespace zylann::voxel
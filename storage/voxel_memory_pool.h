@@ -9,6 +9,7 @@
 #include "../util/dstack.h"
 #include "../util/math/funcs.h"
 #include "../util/thread/mutex.h"
+#include "../util/thread/spin_lock.h"
 
 #include <atomic>
 #include <limits>
@@ -20,6 +21,10 @@ namespace zylann::voxel {
 // The majority of VoxelBuffers use powers of two so most of the time
 // we won't waste memory. Sometimes non-power-of-two buffers are created,
 // but they are often temporary and less numerous.
+//
+// Pools are shared by all threads, which makes them a contention point when many threads allocate at the same time.
+// So each thread also owns a small cache of free blocks per size class (a "magazine"), which serves most allocations
+// without locking the shared pools. Magazines are refilled and drained in batches.
 class VoxelMemoryPool {
 private:
 #ifdef DEBUG_ENABLED
@@ -54,7 +59,49 @@ private:
 #endif
 	};
 
+	// We handle allocations with up to 2^20 = 1,048,576 bytes.
+	// This is chosen based on practical needs.
+	static constexpr unsigned int POOL_COUNT = 21;
+
+	// Maximum amount of blocks a thread can keep for a given size class
+	static constexpr unsigned int MAGAZINE_MAX_CAPACITY = 32;
+	// Maximum amount of bytes a thread can keep for a given size class. Larger size classes get fewer slots, and are
+	// not cached per thread at all if that leaves less than 2 slots.
+	static constexpr size_t MAGAZINE_MAX_BYTES = 128 * 1024;
+
 public:
+	struct ThreadCacheCounters {
+		// Allocations served from the thread's magazine
+		uint64_t hits = 0;
+		// Allocations that required a new block from the system
+		uint64_t misses = 0;
+		// Batches of blocks moved from shared pools to a magazine
+		uint64_t refills = 0;
+		// Batches of blocks moved from a magazine to shared pools
+		uint64_t drains = 0;
+
+		inline void add(const ThreadCacheCounters &other) {
+			hits += other.hits;
+			misses += other.misses;
+			refills += other.refills;
+			drains += other.drains;
+		}
+	};
+
+	struct ThreadCacheStats {
+		ThreadCacheCounters counters;
+		// Number of threads currently owning a cache
+		unsigned int thread_count = 0;
+		// Free blocks held in thread caches
+		unsigned int cached_blocks = 0;
+		size_t cached_memory = 0;
+
+		inline float get_hit_ratio() const {
+			const uint64_t total = counters.hits + counters.refills + counters.misses;
+			return total == 0 ? 0.f : float(double(counters.hits) / double(total));
+		}
+	};
+
 	static void create_singleton();
 	static void destroy_singleton();
 	static VoxelMemoryPool &get_singleton();
@@ -67,14 +114,54 @@ public:
 
 	void clear_unused_blocks();
 
+	// Thread caches are enabled by default. Disabling them also trims them.
+	void set_thread_caches_enabled(bool enabled);
+	bool is_thread_caches_enabled() const;
+
+	// Moves free blocks held by thread caches back to the shared pools.
+	void trim_thread_caches();
+
 	void debug_print();
 	unsigned int debug_get_used_blocks() const;
 	size_t debug_get_used_memory() const;
 	size_t debug_get_total_memory() const;
+	ThreadCacheStats debug_get_thread_cache_stats() const;
 
 private:
+	struct Magazine {
+		FixedArray<uint8_t *, MAGAZINE_MAX_CAPACITY> blocks;
+		unsigned int count = 0;
+	};
+
+	struct ThreadCache {
+		// Only contended when another thread trims caches, which is rare
+		SpinLock spin_lock;
+		// Pool this cache is attached to. Null if it got destroyed, or if the cache was not used yet.
+		VoxelMemoryPool *pool = nullptr;
+		FixedArray<Magazine, POOL_COUNT> magazines;
+		ThreadCacheCounters counters;
+	};
+
+	// Owns the cache of the current thread, and gives it back when the thread exits
+	struct ThreadCacheHolder;
+
 	void clear();
 
+	ThreadCache *get_thread_cache();
+	void register_thread_cache(ThreadCache &tc);
+	void unregister_thread_cache(ThreadCache &tc);
+	void drain_magazine(Magazine &magazine, unsigned int pool_index, unsigned int keep_count);
+	void drain_thread_cache(ThreadCache &tc);
+
+	static inline unsigned int get_magazine_capacity(unsigned int pool_index) {
+		const size_t capacity = MAGAZINE_MAX_BYTES >> pool_index;
+		return capacity > MAGAZINE_MAX_CAPACITY ? MAGAZINE_MAX_CAPACITY : static_cast<unsigned int>(capacity);
+	}
+
+	static inline bool is_pool_cached_per_thread(unsigned int pool_index) {
+		return get_magazine_capacity(pool_index) >= 2;
+	}
+
 	inline size_t get_highest_supported_size() const {
 		return size_t(1) << (_pot_pools.size() - 1);
 	}
@@ -95,11 +182,9 @@ private:
 	void debug_print_used_blocks(unsigned int max_amount);
 #endif
 
-	// We handle allocations with up to 2^20 = 1,048,576 bytes.
-	// This is chosen based on practical needs.
 	// Each slot in this array corresponds to allocations
 	// that contain 2^index bytes in them.
-	FixedArray<Pool, 21> _pot_pools;
+	FixedArray<Pool, POOL_COUNT> _pot_pools;
 #ifdef DEBUG_ENABLED
 	DebugUsedBlocks _debug_nonpooled_used_blocks;
 #endif
@@ -107,6 +192,12 @@ private:
 	std::atomic_uint32_t _used_blocks = { 0 };
 	std::atomic_uint64_t _used_memory = { 0 };
 	std::atomic_uint64_t _total_memory = { 0 };
+
+	std::atomic_bool _thread_caches_enabled = { true };
+	// Protected by a global mutex, since thread caches can outlive the pool and vice-versa
+	StdVector<ThreadCache *> _thread_caches;
+	// Counters accumulated from threads that exited
+	ThreadCacheCounters _exited_thread_cache_counters;
 };
 
 } // namespace zylann::voxel
@@ -40,6 +40,7 @@ void LoadAllBlocksDataTask::apply_result() {
 				VoxelStream::FullLoadingResult::Block &rb = *it;
 
 				VoxelEngine::BlockDataOutput o;
+				o.type = VoxelEngine::BlockDataOutput::TYPE_LOADED;
 				o.voxels = rb.voxels;
 				o.instances = std::move(rb.instances_data);
 				o.position = rb.position;
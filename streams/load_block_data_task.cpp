@@ -10,6 +10,8 @@ namespace zylann::voxel {
 
 namespace {
 std::atomic_int g_debug_load_block_tasks_count = { 0 };
+// Only counts blocks found in the stream
+std::atomic_uint64_t g_debug_loaded_blocks_count = { 0 };
 }
 
 LoadBlockDataTask::LoadBlockDataTask(VolumeID p_volume_id, Vector3i p_block_pos, uint8_t p_lod, uint8_t p_block_size,
@@ -40,6 +42,10 @@ int LoadBlockDataTask::debug_get_running_count() {
 	return g_debug_load_block_tasks_count;
 }
 
+uint64_t LoadBlockDataTask::debug_get_loaded_count() {
+	return g_debug_loaded_blocks_count;
+}
+
 void LoadBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	ZN_DSTACK();
 	ZN_PROFILE_SCOPE();
@@ -64,6 +70,9 @@ void LoadBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	if (voxel_query_data.result == VoxelStream::RESULT_ERROR) {
 		ERR_PRINT("Error loading voxel block");
 
+	} else if (voxel_query_data.result == VoxelStream::RESULT_BLOCK_FOUND) {
+		++g_debug_loaded_blocks_count;
+
 	} else if (voxel_query_data.result == VoxelStream::RESULT_BLOCK_NOT_FOUND) {
 		if (_generate_cache_data) {
 			Ref<VoxelGenerator> generator = _stream_dependency->generator;
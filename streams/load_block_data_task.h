@@ -30,6 +30,8 @@ public:
 	void apply_result() override;
 
 	static int debug_get_running_count();
+	// Total amount of blocks found in the stream since startup
+	static uint64_t debug_get_loaded_count();
 
 private:
 	PriorityDependency _priority_dependency;
@@ -1,8 +1,10 @@
 #include "region_file.h"
 #include "../../streams/voxel_block_serializer.h"
+#include "../../util/godot/classes/directory.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/godot/core/string.h"
 #include "../../util/io/log.h"
+#include "../../util/math/morton.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "file_utils.h"
@@ -258,12 +260,18 @@ Error RegionFile::open(const String &fpath, bool create_if_not_found) {
 	CRASH_COND(_sectors.size() != 0);
 	for (unsigned int i = 0; i < blocks_sorted_by_offset.size(); ++i) {
 		const BlockInfoAndIndex b = blocks_sorted_by_offset[i];
+		// Files saved with the free list strategy can have holes between blocks
+		while (_sectors.size() < b.b.get_sector_index()) {
+			_sectors.push_back(Vector3u16::free());
+		}
 		Vector3i bpos = get_block_position_from_index(b.i);
 		for (unsigned int j = 0; j < b.b.get_sector_count(); ++j) {
 			_sectors.push_back(bpos);
 		}
 	}
 
+	update_free_sectors();
+
 #ifdef DEBUG_ENABLED
 	debug_check();
 #endif
@@ -285,6 +293,7 @@ Error RegionFile::close() {
 		_file_access.unref();
 	}
 	_sectors.clear();
+	_free_sectors.clear();
 	return err;
 }
 
@@ -376,18 +385,18 @@ Error RegionFile::save_block(Vector3i position, VoxelBuffer &block) {
 	RegionBlockInfo &block_info = _header.blocks[lut_index];
 
 	if (block_info.data == 0) {
-		// The block isn't in the file yet, append at the end
-
-		const unsigned int end_offset = _blocks_begin_offset + _sectors.size() * _header.format.sector_size;
-		f.seek(end_offset);
-		const unsigned int block_offset = f.get_position();
-		// Check position matches the sectors rule
-		CRASH_COND((block_offset - _blocks_begin_offset) % _header.format.sector_size != 0);
+		// The block isn't in the file yet, append at the end, or in free sectors if the strategy allows it
 
 		BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(block);
 		ERR_FAIL_COND_V(!res.success, ERR_INVALID_PARAMETER);
-		f.store_32(res.data.size());
 		const unsigned int written_size = sizeof(uint32_t) + res.data.size();
+		const unsigned int sector_count = get_sector_count_from_bytes(written_size);
+		const uint32_t sector_index = allocate_sectors(sector_count, position);
+
+		const unsigned int block_offset = _blocks_begin_offset + sector_index * _header.format.sector_size;
+		f.seek(block_offset);
+
+		f.store_32(res.data.size());
 		zylann::godot::store_buffer(f, to_span(res.data));
 
 		const unsigned int end_pos = f.get_position();
@@ -396,12 +405,8 @@ Error RegionFile::save_block(Vector3i position, VoxelBuffer &block) {
 						.format(varray(written_size, block_offset, end_pos)));
 		pad_to_sector_size(f);
 
-		block_info.set_sector_index((block_offset - _blocks_begin_offset) / _header.format.sector_size);
-		block_info.set_sector_count(get_sector_count_from_bytes(written_size));
-
-		for (unsigned int i = 0; i < block_info.get_sector_count(); ++i) {
-			_sectors.push_back(position);
-		}
+		block_info.set_sector_index(sector_index);
+		block_info.set_sector_count(sector_count);
 
 		_header_modified = true;
 
@@ -426,8 +431,13 @@ Error RegionFile::save_block(Vector3i position, VoxelBuffer &block) {
 			// We can write the block at the same spot
 
 			if (new_sector_count < old_sector_count) {
-				// The block now uses less sectors, we can compact others.
-				remove_sectors_from_block(position, old_sector_count - new_sector_count);
+				if (_allocation_strategy == ALLOCATION_FREE_LIST) {
+					// The block now uses less sectors, the last ones can be reused by other blocks.
+					free_sectors(old_sector_index + new_sector_count, old_sector_count - new_sector_count);
+				} else {
+					// The block now uses less sectors, we can compact others.
+					remove_sectors_from_block(position, old_sector_count - new_sector_count);
+				}
 				_header_modified = true;
 			}
 
@@ -440,6 +450,31 @@ Error RegionFile::save_block(Vector3i position, VoxelBuffer &block) {
 			const size_t end_pos = f.get_position();
 			CRASH_COND(written_size != (end_pos - block_offset));
 
+		} else if (_allocation_strategy == ALLOCATION_FREE_LIST) {
+			// The block now uses more sectors. Other blocks don't move: the block either grows into free sectors
+			// following it, or moves to other sectors.
+
+			uint32_t sector_index = old_sector_index;
+			if (!try_grow_sectors(block_info, new_sector_count, position)) {
+				free_sectors(old_sector_index, old_sector_count);
+				sector_index = allocate_sectors(new_sector_count, position);
+			}
+
+			const size_t block_offset = _blocks_begin_offset + sector_index * _header.format.sector_size;
+			f.seek(block_offset);
+
+			f.store_32(data.size());
+			zylann::godot::store_buffer(f, to_span(data));
+
+			const size_t end_pos = f.get_position();
+			CRASH_COND(written_size != (end_pos - block_offset));
+
+			pad_to_sector_size(f);
+
+			block_info.set_sector_index(sector_index);
+
+			_header_modified = true;
+
 		} else {
 			// The block now uses more sectors, we have to move others.
 			// Note: we could shift blocks forward, but we can also remove the block entirely and rewrite it at the end.
@@ -562,6 +597,261 @@ void RegionFile::remove_sectors_from_block(Vector3i block_pos, unsigned int p_se
 	}
 }
 
+uint32_t RegionFile::allocate_sectors(unsigned int sector_count, Vector3i block_pos) {
+	uint32_t sector_index = _sectors.size();
+
+	if (_allocation_strategy == ALLOCATION_FREE_LIST) {
+		// First fit. There are usually few free ranges, because adjacent ones are merged.
+		for (unsigned int i = 0; i < _free_sectors.size(); ++i) {
+			SectorRange &range = _free_sectors[i];
+			if (range.count >= sector_count) {
+				sector_index = range.index;
+				range.index += sector_count;
+				range.count -= sector_count;
+				if (range.count == 0) {
+					_free_sectors.erase(_free_sectors.begin() + i);
+				}
+				break;
+			}
+		}
+	}
+
+	if (sector_index + sector_count > _sectors.size()) {
+		_sectors.resize(sector_index + sector_count, Vector3u16::free());
+	}
+	for (unsigned int i = 0; i < sector_count; ++i) {
+		_sectors[sector_index + i] = Vector3u16(block_pos);
+	}
+
+	return sector_index;
+}
+
+bool RegionFile::try_grow_sectors(
+		const RegionBlockInfo &block_info, unsigned int new_sector_count, Vector3i block_pos) {
+	const uint32_t end_index = block_info.get_sector_index() + block_info.get_sector_count();
+	const unsigned int extra_count = new_sector_count - block_info.get_sector_count();
+
+	if (end_index == _sectors.size()) {
+		// Last block of the file, it can grow freely
+		_sectors.resize(end_index + extra_count, Vector3u16(block_pos));
+		return true;
+	}
+
+	for (unsigned int i = 0; i < _free_sectors.size(); ++i) {
+		SectorRange &range = _free_sectors[i];
+		if (range.index == end_index) {
+			if (range.count < extra_count) {
+				return false;
+			}
+			range.index += extra_count;
+			range.count -= extra_count;
+			if (range.count == 0) {
+				_free_sectors.erase(_free_sectors.begin() + i);
+			}
+			for (unsigned int j = 0; j < extra_count; ++j) {
+				_sectors[end_index + j] = Vector3u16(block_pos);
+			}
+			return true;
+		}
+		if (range.index > end_index) {
+			break;
+		}
+	}
+
+	return false;
+}
+
+void RegionFile::free_sectors(uint32_t sector_index, unsigned int sector_count) {
+	CRASH_COND(sector_index + sector_count > _sectors.size());
+
+	for (unsigned int i = 0; i < sector_count; ++i) {
+		_sectors[sector_index + i] = Vector3u16::free();
+	}
+
+	// Insert the range, keeping the list sorted and merging adjacent ranges
+	unsigned int i = 0;
+	while (i < _free_sectors.size() && _free_sectors[i].index < sector_index) {
+		++i;
+	}
+	_free_sectors.insert(_free_sectors.begin() + i, SectorRange{ sector_index, sector_count });
+
+	if (i + 1 < _free_sectors.size()) {
+		SectorRange &range = _free_sectors[i];
+		const SectorRange next = _free_sectors[i + 1];
+		if (range.index + range.count == next.index) {
+			range.count += next.count;
+			_free_sectors.erase(_free_sectors.begin() + i + 1);
+		}
+	}
+	if (i > 0) {
+		SectorRange &prev = _free_sectors[i - 1];
+		const SectorRange range = _free_sectors[i];
+		if (prev.index + prev.count == range.index) {
+			prev.count += range.count;
+			_free_sectors.erase(_free_sectors.begin() + i);
+		}
+	}
+
+	// Free sectors at the end of the file are not holes, new blocks will be appended there
+	if (_free_sectors.size() > 0) {
+		const SectorRange last = _free_sectors.back();
+		if (last.index + last.count == _sectors.size()) {
+			_sectors.erase(_sectors.begin() + last.index, _sectors.end());
+			_free_sectors.pop_back();
+		}
+	}
+}
+
+void RegionFile::update_free_sectors() {
+	_free_sectors.clear();
+	if (_allocation_strategy != ALLOCATION_FREE_LIST) {
+		return;
+	}
+	for (unsigned int i = 0; i < _sectors.size(); ++i) {
+		if (!_sectors[i].is_free()) {
+			continue;
+		}
+		if (_free_sectors.size() > 0 && _free_sectors.back().index + _free_sectors.back().count == i) {
+			++_free_sectors.back().count;
+		} else {
+			_free_sectors.push_back(SectorRange{ i, 1 });
+		}
+	}
+}
+
+void RegionFile::set_allocation_strategy(AllocationStrategy strategy) {
+	if (strategy == _allocation_strategy) {
+		return;
+	}
+	_allocation_strategy = strategy;
+	update_free_sectors();
+}
+
+RegionFile::AllocationStrategy RegionFile::get_allocation_strategy() const {
+	return _allocation_strategy;
+}
+
+unsigned int RegionFile::get_free_sector_count() const {
+	unsigned int count = 0;
+	for (const Vector3u16 s : _sectors) {
+		if (s.is_free()) {
+			++count;
+		}
+	}
+	return count;
+}
+
+Error RegionFile::compact() {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND_V(_file_access.is_null(), ERR_FILE_CANT_READ);
+	FileAccess &f = **_file_access;
+
+	if (_header.version != FORMAT_VERSION) {
+		ERR_FAIL_COND_V(migrate_to_latest(f) == false, ERR_UNAVAILABLE);
+	}
+
+	// Blocks close to each other in space are likely to be loaded together
+	struct BlockRef {
+		uint64_t morton_code;
+		uint32_t lut_index;
+	};
+	StdVector<BlockRef> blocks;
+	for (unsigned int i = 0; i < _header.blocks.size(); ++i) {
+		if (_header.blocks[i].data != 0) {
+			const Vector3i bpos = get_block_position_from_index(i);
+			blocks.push_back(BlockRef{ math::morton_encode_3d(bpos.x, bpos.y, bpos.z), i });
+		}
+	}
+	std::sort(blocks.begin(), blocks.end(), [](const BlockRef &a, const BlockRef &b) { //
+		return a.morton_code < b.morton_code;
+	});
+
+	const String file_path = _file_path;
+	const String temp_file_path = file_path + ".tmp";
+
+	// Blocks are copied into a new file, which then replaces the old one
+	const Error copy_err = [&]() -> Error {
+		Error open_err;
+		Ref<FileAccess> temp_f_ref = zylann::godot::open_file(temp_file_path, FileAccess::WRITE, open_err);
+		ERR_FAIL_COND_V_MSG(temp_f_ref.is_null(), open_err,
+				String("Could not create file {0} to compact region").format(varray(temp_file_path)));
+		FileAccess &temp_f = **temp_f_ref;
+
+		StdVector<RegionBlockInfo> new_block_infos;
+		new_block_infos.resize(_header.blocks.size());
+
+		// The header is written once to reserve its space, and again when locations of blocks are known
+		ERR_FAIL_COND_V(!zylann::voxel::save_header(temp_f, FORMAT_VERSION, _header.format, new_block_infos),
+				ERR_FILE_CANT_WRITE);
+		ERR_FAIL_COND_V(temp_f.get_position() != _blocks_begin_offset, ERR_BUG);
+
+		const unsigned int sector_size = _header.format.sector_size;
+		StdVector<uint8_t> data;
+		uint32_t sector_index = 0;
+
+		for (const BlockRef b : blocks) {
+			const RegionBlockInfo old_info = _header.blocks[b.lut_index];
+			f.seek(_blocks_begin_offset + old_info.get_sector_index() * sector_size);
+
+			// Blocks are copied as they are, no need to decompress them
+			const uint32_t data_size = f.get_32();
+			const uint32_t size_with_prefix = sizeof(uint32_t) + data_size;
+			ERR_FAIL_COND_V(size_with_prefix > old_info.get_sector_count() * sector_size, ERR_FILE_CORRUPT);
+			data.resize(data_size);
+			ERR_FAIL_COND_V(zylann::godot::get_buffer(f, to_span(data)) != data_size, ERR_FILE_CORRUPT);
+
+			temp_f.store_32(data_size);
+			zylann::godot::store_buffer(temp_f, to_span(data));
+			pad_to_sector_size(temp_f);
+
+			const uint32_t sector_count = get_sector_count_from_bytes(size_with_prefix);
+			RegionBlockInfo &new_info = new_block_infos[b.lut_index];
+			new_info.set_sector_index(sector_index);
+			new_info.set_sector_count(sector_count);
+			sector_index += sector_count;
+		}
+
+		ERR_FAIL_COND_V(!zylann::voxel::save_header(temp_f, FORMAT_VERSION, _header.format, new_block_infos),
+				ERR_FILE_CANT_WRITE);
+		temp_f.flush();
+		return OK;
+	}();
+
+	if (copy_err != OK) {
+		// Don't leave a partial copy around
+		Ref<DirAccess> da = zylann::godot::open_directory(file_path.get_base_dir());
+		if (da.is_valid() && da->file_exists(temp_file_path)) {
+			da->remove(temp_file_path);
+		}
+		return copy_err;
+	}
+
+	// The compacted file already contains the latest header
+	_header_modified = false;
+	close();
+
+	Ref<DirAccess> da = zylann::godot::open_directory(file_path.get_base_dir());
+	if (da.is_null()) {
+		ERR_PRINT(String("Could not open directory of {0} to replace it with compacted region")
+						  .format(varray(file_path)));
+		// Keep using the old file
+		open(file_path, false);
+		return ERR_FILE_CANT_OPEN;
+	}
+	// Replaces the old file
+	const Error rename_err = da->rename(temp_file_path, file_path);
+	if (rename_err != OK) {
+		ERR_PRINT(String("Could not replace {0} with compacted region, error {1}")
+						  .format(varray(file_path, rename_err)));
+		// Keep using the old file, but the caller has to know compaction didn't happen
+		da->remove(temp_file_path);
+		open(file_path, false);
+		return rename_err;
+	}
+
+	return open(file_path, false);
+}
+
 bool RegionFile::save_header(FileAccess &f) {
 	// We should be allowed to migrate before write operations.
 	if (_header.version != FORMAT_VERSION) {
@@ -72,6 +72,18 @@ static_assert(sizeof(RegionBlockInfo) == 4, "Data in this struct must have a con
 //
 class RegionFile {
 public:
+	// How sectors are allocated when a block changes size
+	enum AllocationStrategy {
+		// Sectors following a block that shrinks or grows are moved to fill the gap, so the file never has holes.
+		// Saving blocks can become expensive in large files, because the rest of the file has to be rewritten.
+		ALLOCATION_SHIFT_SECTORS,
+		// Sectors no longer used are remembered in a free list, and reused by blocks needing new sectors. Nothing else
+		// has to move, but the file can contain holes until it is compacted.
+		// Note: versions of the module predating this strategy don't expect holes, and can corrupt such files when
+		// writing to them. Compacting the file removes holes.
+		ALLOCATION_FREE_LIST
+	};
+
 	RegionFile();
 	~RegionFile();
 
@@ -95,6 +107,17 @@ public:
 
 	bool is_valid_block_position(const Vector3 position) const;
 
+	void set_allocation_strategy(AllocationStrategy strategy);
+	AllocationStrategy get_allocation_strategy() const;
+
+	// Sectors between blocks which are not used by any of them
+	unsigned int get_free_sector_count() const;
+
+	// Rewrites the file with blocks ordered spatially (in Morton order), without any free sector. The new file is
+	// written next to the current one, which is then replaced with a rename, so a crash during compaction can't leave
+	// a partially written region behind. The file remains open after this.
+	Error compact();
+
 private:
 	bool save_header(FileAccess &f);
 	Error load_header(FileAccess &f);
@@ -105,6 +128,11 @@ private:
 	void pad_to_sector_size(FileAccess &f);
 	void remove_sectors_from_block(Vector3i block_pos, unsigned int p_sector_count);
 
+	uint32_t allocate_sectors(unsigned int sector_count, Vector3i block_pos);
+	bool try_grow_sectors(const RegionBlockInfo &block_info, unsigned int new_sector_count, Vector3i block_pos);
+	void free_sectors(uint32_t sector_index, unsigned int sector_count);
+	void update_free_sectors();
+
 	bool migrate_to_latest(FileAccess &f);
 	bool migrate_from_v2_to_v3(FileAccess &f, RegionFormat &format);
 
@@ -128,13 +156,30 @@ private:
 		uint16_t z;
 
 		Vector3u16(Vector3i p) : x(p.x), y(p.y), z(p.z) {}
+
+		// Marks sectors not used by any block
+		static inline Vector3u16 free() {
+			return Vector3u16(Vector3i(0xffff, 0xffff, 0xffff));
+		}
+
+		inline bool is_free() const {
+			return x == 0xffff;
+		}
 	};
 
-	// TODO Is it ever read?
 	// List of sectors in the order they appear in the file,
 	// and which position their block is. The same block can span multiple sectors.
 	// This is essentially a reverse table of `Header::blocks`.
 	StdVector<Vector3u16> _sectors;
+
+	struct SectorRange {
+		uint32_t index;
+		uint32_t count;
+	};
+
+	AllocationStrategy _allocation_strategy = ALLOCATION_SHIFT_SECTORS;
+	// Ranges of free sectors, sorted by index. Only used with `ALLOCATION_FREE_LIST`.
+	StdVector<SectorRange> _free_sectors;
 	uint32_t _blocks_begin_offset;
 	String _file_path;
 };
@@ -7,8 +7,10 @@
 #include "../../util/godot/core/string.h"
 #include "../../util/io/log.h"
 #include "../../util/math/box3i.h"
+#include "../../util/memory/memory.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
+#include "../../util/tasks/threaded_task.h"
 #include "file_utils.h"
 
 #include <algorithm>
@@ -483,6 +485,9 @@ VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::open_region(
 		format.sector_size = _meta.sector_size;
 
 		cached_region->region.set_format(format);
+		cached_region->region.set_allocation_strategy(
+				_reuse_free_sectors ? RegionFile::ALLOCATION_FREE_LIST : RegionFile::ALLOCATION_SHIFT_SECTORS
+		);
 		cached_region->position = region_pos;
 		cached_region->lod = lod;
 	}
@@ -573,6 +578,50 @@ Vector3i convert_block_coordinates(Vector3i pos, Vector3i old_size, Vector3i new
 
 } // namespace
 
+bool VoxelStreamRegionFiles::get_region_list(
+		String directory, unsigned int lod_count, StdVector<RegionLocation> &out_regions) {
+	using namespace zylann::godot;
+
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		const String lod_folder = directory.path_join("regions").path_join("lod") + String::num_int64(lod_index);
+		const String ext = String(".") + RegionFormat::FILE_EXTENSION;
+
+		Ref<DirAccess> da = open_directory(lod_folder);
+		if (da.is_null()) {
+			continue;
+		}
+
+		da->list_dir_begin();
+
+		while (true) {
+			String fname = da->get_next();
+			if (fname == "") {
+				break;
+			}
+			if (da->current_is_dir()) {
+				continue;
+			}
+			if (fname.ends_with(ext)) {
+				PackedStringArray parts = fname.split(".");
+				// r.x.y.z.ext
+				ERR_FAIL_COND_V_MSG(
+						parts.size() < 4, false, String("Found invalid region file: '{0}'").format(varray(fname))
+				);
+				RegionLocation p;
+				p.position.x = parts[1].to_int();
+				p.position.y = parts[2].to_int();
+				p.position.z = parts[3].to_int();
+				p.lod_index = lod_index;
+				out_regions.push_back(p);
+			}
+		}
+
+		da->list_dir_end();
+	}
+
+	return true;
+}
+
 void VoxelStreamRegionFiles::_convert_files(Meta new_meta) {
 	using namespace zylann::godot;
 
@@ -620,55 +669,13 @@ void VoxelStreamRegionFiles::_convert_files(Meta new_meta) {
 		ZN_PRINT_VERBOSE(format("Data backed up as {}", old_dir));
 	}
 
-	struct PositionAndLod {
-		Vector3i position;
-		uint8_t lod_index;
-	};
-
 	ERR_FAIL_COND(old_stream->load_meta() != FILE_OK);
 
-	StdVector<PositionAndLod> old_region_list;
+	StdVector<RegionLocation> old_region_list;
 	Meta old_meta = old_stream->_meta;
 
 	// Get list of all regions from the old stream
-	{
-		for (unsigned int lod_index = 0; lod_index < old_meta.lod_count; ++lod_index) {
-			const String lod_folder =
-					old_stream->_directory_path.path_join("regions").path_join("lod") + String::num_int64(lod_index);
-			const String ext = String(".") + RegionFormat::FILE_EXTENSION;
-
-			Ref<DirAccess> da = open_directory(lod_folder);
-			if (da.is_null()) {
-				continue;
-			}
-
-			da->list_dir_begin();
-
-			while (true) {
-				String fname = da->get_next();
-				if (fname == "") {
-					break;
-				}
-				if (da->current_is_dir()) {
-					continue;
-				}
-				if (fname.ends_with(ext)) {
-					PackedStringArray parts = fname.split(".");
-					// r.x.y.z.ext
-					ERR_FAIL_COND_MSG(
-							parts.size() < 4, String("Found invalid region file: '{0}'").format(varray(fname)));
-					PositionAndLod p;
-					p.position.x = parts[1].to_int();
-					p.position.y = parts[2].to_int();
-					p.position.z = parts[3].to_int();
-					p.lod_index = lod_index;
-					old_region_list.push_back(p);
-				}
-			}
-
-			da->list_dir_end();
-		}
-	}
+	ERR_FAIL_COND(!get_region_list(old_stream->_directory_path, old_meta.lod_count, old_region_list));
 
 	_meta = new_meta;
 	ERR_FAIL_COND(save_meta() != FILE_OK);
@@ -681,7 +688,7 @@ void VoxelStreamRegionFiles::_convert_files(Meta new_meta) {
 	// Read all blocks from the old stream and write them into the new one
 
 	for (unsigned int i = 0; i < old_region_list.size(); ++i) {
-		PositionAndLod region_info = old_region_list[i];
+		RegionLocation region_info = old_region_list[i];
 
 		const CachedRegion *old_region = old_stream->open_region(region_info.position, region_info.lod_index, false);
 		if (old_region == nullptr) {
@@ -918,6 +925,122 @@ void VoxelStreamRegionFiles::convert_files(Dictionary d) {
 	emit_changed();
 }
 
+void VoxelStreamRegionFiles::set_reuse_free_sectors(bool enabled) {
+	MutexLock lock(_mutex);
+	_reuse_free_sectors = enabled;
+	const RegionFile::AllocationStrategy strategy =
+			enabled ? RegionFile::ALLOCATION_FREE_LIST : RegionFile::ALLOCATION_SHIFT_SECTORS;
+	for (CachedRegion *cr : _region_cache) {
+		cr->region.set_allocation_strategy(strategy);
+	}
+}
+
+bool VoxelStreamRegionFiles::get_reuse_free_sectors() const {
+	MutexLock lock(_mutex);
+	return _reuse_free_sectors;
+}
+
+namespace {
+
+// Compacts one region, then schedules the next one. This way, other I/O tasks can run in between, and the stream is
+// only locked for the duration of a single region.
+class CompactRegionFilesTask : public IThreadedTask {
+public:
+	struct Context {
+		Ref<VoxelStreamRegionFiles> stream;
+		StdVector<std::pair<Vector3i, uint8_t>> regions;
+		std::atomic_bool *compacting = nullptr;
+	};
+
+	CompactRegionFilesTask(std::shared_ptr<Context> ctx, unsigned int index) : _ctx(ctx), _index(index) {}
+
+	void run(ThreadedTaskContext &ctx) override {
+		ZN_PROFILE_SCOPE();
+		if (_index < _ctx->regions.size()) {
+			const std::pair<Vector3i, uint8_t> region = _ctx->regions[_index];
+			const Error err = _ctx->stream->compact_region(region.first, region.second);
+			if (err != OK && err != ERR_DOES_NOT_EXIST) {
+				ZN_PRINT_ERROR(format("Failed to compact region lod{}/{}, error {}", int(region.second), region.first,
+						static_cast<int>(err)));
+			}
+		}
+		if (_index + 1 < _ctx->regions.size()) {
+			VoxelEngine::get_singleton().push_async_io_task(ZN_NEW(CompactRegionFilesTask(_ctx, _index + 1)));
+		} else {
+			ZN_PRINT_VERBOSE(format("Done compacting {} region files", _ctx->regions.size()));
+			*_ctx->compacting = false;
+		}
+	}
+
+	TaskPriority get_priority() override {
+		// Lowest, loading and saving blocks should happen first
+		return TaskPriority();
+	}
+
+	const char *get_debug_name() const override {
+		return "CompactRegionFiles";
+	}
+
+private:
+	std::shared_ptr<Context> _ctx;
+	unsigned int _index;
+};
+
+} // namespace
+
+void VoxelStreamRegionFiles::start_compaction() {
+	ZN_PROFILE_SCOPE();
+
+	if (_compacting.exchange(true)) {
+		ZN_PRINT_VERBOSE("Region files are already being compacted");
+		return;
+	}
+
+	StdVector<RegionLocation> regions;
+	{
+		MutexLock lock(_mutex);
+		if (!_directory_path.is_empty() && (_meta_loaded || load_meta() == zylann::godot::FILE_OK)) {
+			if (!get_region_list(_directory_path, _meta.lod_count, regions)) {
+				// Don't compact a directory we don't fully understand
+				regions.clear();
+			}
+		}
+	}
+
+	if (regions.size() == 0) {
+		_compacting = false;
+		return;
+	}
+
+	std::shared_ptr<CompactRegionFilesTask::Context> ctx = make_shared_instance<CompactRegionFilesTask::Context>();
+	ctx->stream = this;
+	ctx->compacting = &_compacting;
+	ctx->regions.reserve(regions.size());
+	for (const RegionLocation &r : regions) {
+		ctx->regions.push_back(std::make_pair(r.position, r.lod_index));
+	}
+
+	ZN_PRINT_VERBOSE(format("Compacting {} region files", regions.size()));
+	VoxelEngine::get_singleton().push_async_io_task(ZN_NEW(CompactRegionFilesTask(ctx, 0)));
+}
+
+bool VoxelStreamRegionFiles::is_compacting() const {
+	return _compacting;
+}
+
+Error VoxelStreamRegionFiles::compact_region(Vector3i region_pos, unsigned int lod) {
+	ZN_PROFILE_SCOPE();
+	MutexLock lock(_mutex);
+	ERR_FAIL_COND_V(!_meta_loaded, ERR_UNCONFIGURED);
+	ERR_FAIL_COND_V(lod >= _meta.lod_count, ERR_INVALID_PARAMETER);
+
+	CachedRegion *cache = open_region(region_pos, lod, false);
+	if (cache == nullptr) {
+		return ERR_DOES_NOT_EXIST;
+	}
+	return cache->region.compact();
+}
+
 void VoxelStreamRegionFiles::flush() {
 	ZN_PROFILE_SCOPE();
 	MutexLock lock(_mutex);
@@ -943,7 +1066,16 @@ void VoxelStreamRegionFiles::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD("convert_files", "new_settings"), &VoxelStreamRegionFiles::convert_files);
 
+	ClassDB::bind_method(
+			D_METHOD("set_reuse_free_sectors", "enabled"), &VoxelStreamRegionFiles::set_reuse_free_sectors);
+	ClassDB::bind_method(D_METHOD("get_reuse_free_sectors"), &VoxelStreamRegionFiles::get_reuse_free_sectors);
+
+	ClassDB::bind_method(D_METHOD("start_compaction"), &VoxelStreamRegionFiles::start_compaction);
+	ClassDB::bind_method(D_METHOD("is_compacting"), &VoxelStreamRegionFiles::is_compacting);
+
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "directory", PROPERTY_HINT_DIR), "set_directory", "get_directory");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "reuse_free_sectors"), "set_reuse_free_sectors", "get_reuse_free_sectors");
 
 	ADD_GROUP("Dimensions", "");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "lod_count"), "set_lod_count", "get_lod_count");
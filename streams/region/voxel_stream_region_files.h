@@ -7,6 +7,7 @@
 #include "../../util/thread/mutex.h"
 #include "../voxel_stream.h"
 #include "region_file.h"
+#include <atomic>
 
 namespace zylann::voxel {
 
@@ -52,6 +53,19 @@ public:
 
 	void convert_files(Dictionary d);
 
+	// If enabled, sectors no longer used by blocks are reused by other blocks, instead of moving the rest of the file.
+	// This makes saving much cheaper in large regions, at the cost of holes in files until they are compacted.
+	void set_reuse_free_sectors(bool enabled);
+	bool get_reuse_free_sectors() const;
+
+	// Starts compacting all region files in the background, one region at a time, while the stream remains usable.
+	// Blocks are reordered spatially and free space is reclaimed.
+	void start_compaction();
+	bool is_compacting() const;
+
+	// Compacts a single region file. Used by background compaction.
+	Error compact_region(Vector3i region_pos, unsigned int lod);
+
 	void flush() override;
 
 protected:
@@ -81,6 +95,14 @@ private:
 	CachedRegion *get_region_from_cache(const Vector3i pos, int lod) const;
 	void close_oldest_region();
 
+	struct RegionLocation {
+		Vector3i position;
+		uint8_t lod_index;
+	};
+
+	// Returns false if an invalid region file was found
+	static bool get_region_list(String directory, unsigned int lod_count, StdVector<RegionLocation> &out_regions);
+
 	struct Meta {
 		uint8_t version = -1;
 		uint8_t lod_count = 0;
@@ -133,6 +155,8 @@ private:
 	StdVector<CachedRegion *> _region_cache;
 	// TODO Add memory caches to increase capacity.
 	unsigned int _max_open_regions = MIN(8, FOPEN_MAX);
+	bool _reuse_free_sectors = false;
+	std::atomic_bool _compacting = { false };
 
 	Mutex _mutex;
 };
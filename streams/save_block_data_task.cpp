@@ -11,6 +11,7 @@ namespace zylann::voxel {
 
 namespace {
 std::atomic_int g_debug_save_block_tasks_count = { 0 };
+std::atomic_uint64_t g_debug_save_block_tasks_completed_count = { 0 };
 }
 
 SaveBlockDataTask::SaveBlockDataTask(VolumeID p_volume_id, Vector3i p_block_pos, uint8_t p_lod,
@@ -53,6 +54,10 @@ int SaveBlockDataTask::debug_get_running_count() {
 	return g_debug_save_block_tasks_count;
 }
 
+uint64_t SaveBlockDataTask::debug_get_completed_count() {
+	return g_debug_save_block_tasks_completed_count;
+}
+
 void SaveBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	ZN_PROFILE_SCOPE();
 
@@ -102,6 +107,7 @@ void SaveBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	}
 
 	_has_run = true;
+	++g_debug_save_block_tasks_completed_count;
 }
 
 TaskPriority SaveBlockDataTask::get_priority() {
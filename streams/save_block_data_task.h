@@ -36,6 +36,8 @@ public:
 	void apply_result() override;
 
 	static int debug_get_running_count();
+	// Total amount of tasks that saved to the stream since startup
+	static uint64_t debug_get_completed_count();
 
 private:
 	std::shared_ptr<VoxelBuffer> _voxels;
@@ -5,11 +5,13 @@
 #include "../../util/godot/core/array.h"
 #include "../../util/godot/core/string.h"
 #include "../../util/math/conv.h"
+#include "../../util/math/morton.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "../../util/string/std_string.h"
 #include "../compressed_data.h"
 
+#include <algorithm>
 #include <limits>
 #include <unordered_set>
 
@@ -29,14 +31,35 @@ struct BlockLocation {
 		return true;
 	}
 
+	// Blocks are keyed in Morton order, so blocks close to each other in space are also close to each other in the
+	// table, and areas can be loaded with a few range scans. Coordinates are biased to be positive. The LOD index
+	// comes first, so each LOD is a contiguous range.
 	uint64_t encode() const {
-		// 0l xx yy zz
-		// TODO Is this valid with negative numbers?
-		return ((static_cast<uint64_t>(lod) & 0xffff) << 48) | ((static_cast<uint64_t>(x) & 0xffff) << 32) |
-				((static_cast<uint64_t>(y) & 0xffff) << 16) | (static_cast<uint64_t>(z) & 0xffff);
+		// 0l mm mm mm
+		const uint64_t m = math::morton_encode_3d( //
+				static_cast<int32_t>(x) + 0x8000, //
+				static_cast<int32_t>(y) + 0x8000, //
+				static_cast<int32_t>(z) + 0x8000 //
+		);
+		return (static_cast<uint64_t>(lod) << 48) | m;
 	}
 
 	static BlockLocation decode(uint64_t id) {
+		uint32_t mx;
+		uint32_t my;
+		uint32_t mz;
+		math::morton_decode_3d(id & 0xffffffffffffull, mx, my, mz);
+		BlockLocation b;
+		b.x = static_cast<int32_t>(mx) - 0x8000;
+		b.y = static_cast<int32_t>(my) - 0x8000;
+		b.z = static_cast<int32_t>(mz) - 0x8000;
+		b.lod = ((id >> 48) & 0xff);
+		return b;
+	}
+
+	// Layout used by databases of version 0
+	static BlockLocation decode_v0(uint64_t id) {
+		// 0l xx yy zz
 		BlockLocation b;
 		b.z = (id & 0xffff);
 		b.y = ((id >> 16) & 0xffff);
@@ -46,6 +69,10 @@ struct BlockLocation {
 	}
 };
 
+// When loading many blocks, keys closer than this are fetched with the same range scan. Rows of blocks that were not
+// requested may be read in between, but their data is not.
+const uint64_t MAX_RANGE_SCAN_KEY_GAP = 64;
+
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -53,7 +80,9 @@ struct BlockLocation {
 // One connection to the database, with our prepared statements
 class VoxelStreamSQLiteInternal {
 public:
-	static const int VERSION = 0;
+	// 0: blocks keyed by packed coordinates
+	// 1: blocks keyed in Morton order
+	static const int VERSION = 1;
 
 	struct Meta {
 		int version = -1;
@@ -97,6 +126,14 @@ public:
 	bool save_block(BlockLocation loc, Span<const uint8_t> block_data, BlockType type);
 	VoxelStream::ResultCode load_block(BlockLocation loc, StdVector<uint8_t> &out_block_data, BlockType type);
 
+	// Loads voxel data of many blocks using range scans. `sorted_keys` must be encoded locations in ascending order.
+	// The callback is only called for blocks that were found.
+	bool load_voxel_blocks(
+			Span<const uint64_t> sorted_keys,
+			void *callback_data,
+			void (*process_block_func)(void *callback_data, unsigned int key_index, Span<const uint8_t> voxel_data)
+	);
+
 	bool load_all_blocks(
 			void *callback_data,
 			void (*process_block_func)(
@@ -142,12 +179,16 @@ private:
 		}
 	}
 
+	bool migrate_from_v0_to_v1();
+	bool migrate_blocks_from_v0_to_v1();
+
 	StdString _opened_path;
 	sqlite3 *_db = nullptr;
 	sqlite3_stmt *_begin_statement = nullptr;
 	sqlite3_stmt *_end_statement = nullptr;
 	sqlite3_stmt *_update_voxel_block_statement = nullptr;
 	sqlite3_stmt *_get_voxel_block_statement = nullptr;
+	sqlite3_stmt *_get_voxel_blocks_in_range_statement = nullptr;
 	sqlite3_stmt *_update_instance_block_statement = nullptr;
 	sqlite3_stmt *_get_instance_block_statement = nullptr;
 	sqlite3_stmt *_load_meta_statement = nullptr;
@@ -204,6 +245,13 @@ bool VoxelStreamSQLiteInternal::open(const char *fpath) {
 	if (!prepare(db, &_get_voxel_block_statement, "SELECT vb FROM blocks WHERE loc=:loc")) {
 		return false;
 	}
+	if (!prepare(
+				db,
+				&_get_voxel_blocks_in_range_statement,
+				"SELECT loc, vb FROM blocks WHERE loc BETWEEN :min_loc AND :max_loc"
+		)) {
+		return false;
+	}
 	if (!prepare(
 				db,
 				&_update_instance_block_statement,
@@ -258,12 +306,118 @@ bool VoxelStreamSQLiteInternal::open(const char *fpath) {
 			channel.depth = VoxelBuffer::DEPTH_16_BIT;
 		}
 		save_meta(meta);
+
+	} else if (meta.version == 0) {
+		if (!migrate_from_v0_to_v1()) {
+			ZN_PRINT_ERROR(format("Could not migrate database at path \"{}\"", fpath));
+			close();
+			return false;
+		}
+
+	} else if (meta.version != VERSION) {
+		ZN_PRINT_ERROR(format("Database at path \"{}\" has unsupported version {}", fpath, meta.version));
+		close();
+		return false;
 	}
 
 	_opened_path = fpath;
 	return true;
 }
 
+namespace {
+
+int get_first_column_as_int(void *data, int column_count, char **values, char **column_names) {
+	int *value = static_cast<int *>(data);
+	if (column_count > 0 && values[0] != nullptr) {
+		*value = atoi(values[0]);
+	}
+	return 0;
+}
+
+} // namespace
+
+bool VoxelStreamSQLiteInternal::migrate_from_v0_to_v1() {
+	// Another connection to the same database could be migrating at the same time, so wait for it instead of failing.
+	// The previous timeout is restored afterward, other queries of the connection keep failing immediately when busy.
+	int previous_busy_timeout = 0;
+	sqlite3_exec(_db, "PRAGMA busy_timeout", get_first_column_as_int, &previous_busy_timeout, nullptr);
+	sqlite3_busy_timeout(_db, 10000);
+
+	const bool success = migrate_blocks_from_v0_to_v1();
+
+	sqlite3_busy_timeout(_db, previous_busy_timeout);
+	return success;
+}
+
+bool VoxelStreamSQLiteInternal::migrate_blocks_from_v0_to_v1() {
+	ZN_PROFILE_SCOPE();
+	sqlite3 *db = _db;
+	char *error_message = nullptr;
+
+	struct L {
+		static void convert_key(sqlite3_context *context, int argc, sqlite3_value **argv) {
+			const uint64_t old_key = sqlite3_value_int64(argv[0]);
+			sqlite3_result_int64(context, BlockLocation::decode_v0(old_key).encode());
+		}
+	};
+
+	int rc = sqlite3_create_function_v2(db, "zn_block_key_v1", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+			L::convert_key, nullptr, nullptr, nullptr);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+
+	rc = sqlite3_exec(db, "BEGIN IMMEDIATE", nullptr, nullptr, &error_message);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(String("Failed to begin migration: {0}").format(varray(error_message)));
+		sqlite3_free(error_message);
+		return false;
+	}
+
+	// Check again now that the database is locked, in case another connection migrated it already
+	int version = -1;
+	rc = sqlite3_exec(db, "SELECT version FROM meta", get_first_column_as_int, &version, &error_message);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(String("Failed to read version: {0}").format(varray(error_message)));
+		sqlite3_free(error_message);
+		sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+		return false;
+	}
+	if (version != 0) {
+		sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+		return version == VERSION;
+	}
+
+	ZN_PRINT_VERBOSE(format("Migrating database {} from version 0 to 1", sqlite3_db_filename(db, nullptr)));
+
+	// Rows are inserted in order of their new key, so pages of the new table are filled sequentially
+	const char *migration = "CREATE TABLE blocks_v1 (loc INTEGER PRIMARY KEY, vb BLOB, instances BLOB);"
+							"INSERT INTO blocks_v1 SELECT zn_block_key_v1(loc) AS new_loc, vb, instances FROM blocks "
+							"ORDER BY new_loc;"
+							"DROP TABLE blocks;"
+							"ALTER TABLE blocks_v1 RENAME TO blocks;"
+							"UPDATE meta SET version=1;";
+
+	rc = sqlite3_exec(db, migration, nullptr, nullptr, &error_message);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(String("Failed to migrate blocks: {0}").format(varray(error_message)));
+		sqlite3_free(error_message);
+		sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+		return false;
+	}
+
+	rc = sqlite3_exec(db, "COMMIT", nullptr, nullptr, &error_message);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(String("Failed to commit migration: {0}").format(varray(error_message)));
+		sqlite3_free(error_message);
+		sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+		return false;
+	}
+
+	return true;
+}
+
 void VoxelStreamSQLiteInternal::close() {
 	if (_db == nullptr) {
 		return;
@@ -272,6 +426,7 @@ void VoxelStreamSQLiteInternal::close() {
 	finalize(_end_statement);
 	finalize(_update_voxel_block_statement);
 	finalize(_get_voxel_block_statement);
+	finalize(_get_voxel_blocks_in_range_statement);
 	finalize(_update_instance_block_statement);
 	finalize(_get_instance_block_statement);
 	finalize(_load_meta_statement);
@@ -432,6 +587,87 @@ VoxelStream::ResultCode VoxelStreamSQLiteInternal::load_block(
 	return result;
 }
 
+bool VoxelStreamSQLiteInternal::load_voxel_blocks(
+		Span<const uint64_t> sorted_keys,
+		void *callback_data,
+		void (*process_block_func)(void *callback_data, unsigned int key_index, Span<const uint8_t> voxel_data)
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT(process_block_func != nullptr);
+
+	sqlite3 *db = _db;
+	sqlite3_stmt *statement = _get_voxel_blocks_in_range_statement;
+
+	unsigned int range_begin = 0;
+
+	while (range_begin < sorted_keys.size()) {
+		// Group keys close to each other into the same range
+		unsigned int range_end = range_begin + 1;
+		while (range_end < sorted_keys.size() &&
+			   sorted_keys[range_end] - sorted_keys[range_end - 1] <= MAX_RANGE_SCAN_KEY_GAP) {
+			++range_end;
+		}
+
+		int rc = sqlite3_reset(statement);
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+		rc = sqlite3_bind_int64(statement, 1, sorted_keys[range_begin]);
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+		rc = sqlite3_bind_int64(statement, 2, sorted_keys[range_end - 1]);
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+
+		// Rows come in ascending order of keys, like requested keys, so they can be matched in a single pass
+		unsigned int key_index = range_begin;
+
+		while (true) {
+			rc = sqlite3_step(statement);
+
+			if (rc == SQLITE_ROW) {
+				const uint64_t key = sqlite3_column_int64(statement, 0);
+				while (key_index < range_end && sorted_keys[key_index] < key) {
+					++key_index;
+				}
+				if (key_index == range_end || sorted_keys[key_index] != key) {
+					// Not requested, skip without reading its data
+					continue;
+				}
+
+				const void *blob = sqlite3_column_blob(statement, 1);
+				const size_t blob_size = sqlite3_column_bytes(statement, 1);
+				if (blob_size == 0) {
+					continue;
+				}
+				const Span<const uint8_t> data(reinterpret_cast<const uint8_t *>(blob), blob_size);
+
+				// The same block could have been requested more than once
+				while (key_index < range_end && sorted_keys[key_index] == key) {
+					process_block_func(callback_data, key_index, data);
+					++key_index;
+				}
+
+			} else if (rc == SQLITE_DONE) {
+				break;
+
+			} else {
+				ERR_PRINT(String("Unexpected SQLite return code: {0}; errmsg: {1}").format(rc, sqlite3_errmsg(db)));
+				return false;
+			}
+		}
+
+		range_begin = range_end;
+	}
+
+	return true;
+}
+
 bool VoxelStreamSQLiteInternal::load_all_blocks(
 		void *callback_data,
 		void (*process_block_func)(
@@ -672,6 +908,10 @@ StdVector<uint8_t> &get_tls_temp_compressed_block_data() {
 	thread_local StdVector<uint8_t> tls_temp_compressed_block_data;
 	return tls_temp_compressed_block_data;
 }
+StdVector<uint64_t> &get_tls_temp_keys() {
+	thread_local StdVector<uint64_t> tls_temp_keys;
+	return tls_temp_keys;
+}
 } // namespace
 
 VoxelStreamSQLite::VoxelStreamSQLite() {}
@@ -767,11 +1007,16 @@ void VoxelStreamSQLite::load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_bl
 		return;
 	}
 
-	// TODO We should handle busy return codes
-	ERR_FAIL_COND(con->begin_transaction() == false);
+	// Sort requests by key, so blocks of the same area can be fetched with range scans, in the order they are
+	// stored in the database
+	struct KeyAndIndex {
+		uint64_t key;
+		unsigned int query_index;
+	};
+	StdVector<KeyAndIndex> sorted_requests;
+	sorted_requests.reserve(blocks_to_load.size());
 
-	for (unsigned int i = 0; i < blocks_to_load.size(); ++i) {
-		const unsigned int ri = blocks_to_load[i];
+	for (const unsigned int ri : blocks_to_load) {
 		VoxelStream::VoxelQueryData &q = p_blocks[ri];
 
 		BlockLocation loc;
@@ -780,16 +1025,46 @@ void VoxelStreamSQLite::load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_bl
 		loc.z = q.position_in_blocks.z;
 		loc.lod = q.lod_index;
 
-		StdVector<uint8_t> &temp_block_data = get_tls_temp_block_data();
+		sorted_requests.push_back(KeyAndIndex{ loc.encode(), ri });
+		q.result = RESULT_BLOCK_NOT_FOUND;
+	}
+
+	std::sort(sorted_requests.begin(), sorted_requests.end(), [](const KeyAndIndex &a, const KeyAndIndex &b) {
+		return a.key < b.key;
+	});
 
-		const ResultCode res = con->load_block(loc, temp_block_data, VoxelStreamSQLiteInternal::VOXELS);
+	StdVector<uint64_t> &sorted_keys = get_tls_temp_keys();
+	sorted_keys.resize(sorted_requests.size());
+	for (unsigned int i = 0; i < sorted_requests.size(); ++i) {
+		sorted_keys[i] = sorted_requests[i].key;
+	}
 
-		if (res == RESULT_BLOCK_FOUND) {
-			// TODO Not sure if we should actually expect non-null. There can be legit not found blocks.
-			BlockSerializer::decompress_and_deserialize(to_span_const(temp_block_data), q.voxel_buffer);
+	struct Context {
+		Span<VoxelStream::VoxelQueryData> blocks;
+		Span<const KeyAndIndex> sorted_requests;
+	};
+
+	struct L {
+		static void process_block_func(void *callback_data, unsigned int key_index, Span<const uint8_t> voxel_data) {
+			Context *ctx = static_cast<Context *>(callback_data);
+			VoxelStream::VoxelQueryData &q = ctx->blocks[ctx->sorted_requests[key_index].query_index];
+			if (BlockSerializer::decompress_and_deserialize(voxel_data, q.voxel_buffer)) {
+				q.result = RESULT_BLOCK_FOUND;
+			} else {
+				ZN_PRINT_ERROR(format("Failed to deserialize block {} lod {}", q.position_in_blocks, q.lod_index));
+				q.result = RESULT_ERROR;
+			}
 		}
+	};
 
-		q.result = res;
+	// TODO We should handle busy return codes
+	ERR_FAIL_COND(con->begin_transaction() == false);
+
+	Context ctx_outer{ p_blocks, to_span_const(sorted_requests) };
+	if (!con->load_voxel_blocks(to_span_const(sorted_keys), &ctx_outer, L::process_block_func)) {
+		for (const unsigned int ri : blocks_to_load) {
+			p_blocks[ri].result = RESULT_ERROR;
+		}
 	}
 
 	ERR_FAIL_COND(con->end_transaction() == false);
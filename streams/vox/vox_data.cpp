@@ -180,21 +180,22 @@ Error parse_node_common_header(Node &node, FileAccess &f, const StdUnorderedMap<
 
 void Data::clear() {
 	_models.clear();
+	_model_chunks.clear();
 	_scene_graph.clear();
 	_layers.clear();
 	_materials.clear();
 	_root_node_id = -1;
 }
 
-Error Data::load_from_file(String fpath) {
-	const Error err = _load_from_file(fpath);
+Error Data::load_from_file(String fpath, bool load_models) {
+	const Error err = _load_from_file(fpath, load_models);
 	if (err != OK) {
 		clear();
 	}
 	return err;
 }
 
-Error Data::_load_from_file(String fpath) {
+Error Data::_load_from_file(String fpath, bool load_models) {
 	ZN_PROFILE_SCOPE();
 	// https://github.com/ephtracy/voxel-model/blob/master/MagicaVoxel-file-format-vox.txt
 	// https://github.com/ephtracy/voxel-model/blob/master/MagicaVoxel-file-format-vox-extension.txt
@@ -241,26 +242,34 @@ Error Data::_load_from_file(String fpath) {
 			last_size = magica_to_opengl(size);
 
 		} else if (strcmp(chunk_id, "XYZI") == 0) {
-			UniquePtr<Model> model = make_unique_instance<Model>();
-			model->color_indexes.resize(last_size.x * last_size.y * last_size.z, 0);
-			model->size = last_size;
-
-			const uint32_t num_voxels = f.get_32();
-
-			for (uint32_t i = 0; i < num_voxels; ++i) {
-				Vector3i pos;
-				pos.x = f.get_8();
-				pos.y = f.get_8();
-				pos.z = f.get_8();
-				const uint32_t c = f.get_8();
-				pos = magica_to_opengl(pos);
-				ERR_FAIL_COND_V(pos.x >= model->size.x || pos.x < 0, ERR_PARSE_ERROR);
-				ERR_FAIL_COND_V(pos.y >= model->size.y || pos.y < 0, ERR_PARSE_ERROR);
-				ERR_FAIL_COND_V(pos.z >= model->size.z || pos.z < 0, ERR_PARSE_ERROR);
-				model->color_indexes[Vector3iUtil::get_zxy_index(pos, model->size)] = c;
+			ModelChunk chunk;
+			chunk.size = last_size;
+			chunk.voxel_count = f.get_32();
+			chunk.file_position = f.get_position();
+			// Sanity check
+			ERR_FAIL_COND_V(chunk.voxel_count > chunk_size / 4, ERR_PARSE_ERROR);
+
+			if (load_models) {
+				UniquePtr<Model> model = make_unique_instance<Model>();
+				model->color_indexes.resize(Vector3iUtil::get_volume(chunk.size), 0);
+				model->size = chunk.size;
+
+				static thread_local StdVector<ModelVoxel> tls_voxels;
+				const Error voxels_err = read_model_voxels(f, chunk, tls_voxels);
+				ERR_FAIL_COND_V(voxels_err != OK, voxels_err);
+
+				for (const ModelVoxel v : tls_voxels) {
+					model->color_indexes[Vector3iUtil::get_zxy_index(Vector3i(v.x, v.y, v.z), model->size)] =
+							v.color_index;
+				}
+
+				_models.push_back(std::move(model));
+
+			} else {
+				f.seek(chunk.file_position + chunk.voxel_count * 4);
 			}
 
-			_models.push_back(std::move(model));
+			_model_chunks.push_back(chunk);
 
 		} else if (strcmp(chunk_id, "RGBA") == 0) {
 			_palette[0] = Color8{ 0, 0, 0, 0 };
@@ -529,7 +538,8 @@ Error Data::_load_from_file(String fpath) {
 			case Node::TYPE_SHAPE: {
 				const ShapeNode *shape_node = reinterpret_cast<const ShapeNode *>(node);
 				const int model_id = shape_node->model_id;
-				ERR_FAIL_COND_V_MSG(model_id < 0 || model_id >= static_cast<int>(_models.size()), ERR_INVALID_DATA,
+				ERR_FAIL_COND_V_MSG(
+						model_id < 0 || model_id >= static_cast<int>(_model_chunks.size()), ERR_INVALID_DATA,
 						String("Model {0} does not exist").format(varray(model_id)));
 			} break;
 		}
@@ -556,8 +566,37 @@ Error Data::_load_from_file(String fpath) {
 	return OK;
 }
 
+Error Data::read_model_voxels(FileAccess &f, const ModelChunk &chunk, StdVector<ModelVoxel> &out_voxels) {
+	ZN_PROFILE_SCOPE();
+	static_assert(sizeof(ModelVoxel) == 4);
+
+	out_voxels.resize(chunk.voxel_count);
+	f.seek(chunk.file_position);
+	// Reading all voxels at once, it is much faster than reading them one by one
+	Span<uint8_t> bytes = to_span(out_voxels).reinterpret_cast_to<uint8_t>();
+	ERR_FAIL_COND_V(godot::get_buffer(f, bytes) != bytes.size(), ERR_PARSE_ERROR);
+
+	for (ModelVoxel &v : out_voxels) {
+		// Stored as XYZI in MagicaVoxel convention
+		const Vector3i pos = magica_to_opengl(Vector3i(v.x, v.y, v.z));
+		ERR_FAIL_COND_V(pos.x >= chunk.size.x, ERR_PARSE_ERROR);
+		ERR_FAIL_COND_V(pos.y >= chunk.size.y, ERR_PARSE_ERROR);
+		ERR_FAIL_COND_V(pos.z >= chunk.size.z, ERR_PARSE_ERROR);
+		v.x = pos.x;
+		v.y = pos.y;
+		v.z = pos.z;
+	}
+
+	return OK;
+}
+
 unsigned int Data::get_model_count() const {
-	return _models.size();
+	return _model_chunks.size();
+}
+
+const ModelChunk &Data::get_model_chunk(unsigned int index) const {
+	CRASH_COND(index >= _model_chunks.size());
+	return _model_chunks[index];
 }
 
 const Model &Data::get_model(unsigned int index) const {
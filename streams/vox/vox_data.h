@@ -5,6 +5,7 @@
 #include "../../util/containers/std_unordered_map.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/core/string.h"
+#include "../../util/godot/macros.h"
 #include "../../util/math/basis.h"
 #include "../../util/math/color8.h"
 #include "../../util/math/vector3i.h"
@@ -14,16 +15,33 @@
 #include <godot_cpp/classes/global_constants.hpp> // For `Error`
 #endif
 
+ZN_GODOT_FORWARD_DECLARE(class FileAccess)
+
 namespace zylann::voxel::magica {
 
 struct Model {
 	Vector3i size;
-	// TODO Optimization: implement lazy loading/streaming to reduce intermediary memory allocations?
-	// Loading a full 256^3 model needs 16 megabytes, but a lot of areas might actually be uniform,
-	// and we might not need the actual model immediately
+	// Loading a full 256^3 model needs 16 megabytes, but a lot of areas might actually be uniform.
+	// If this is a problem, models can be loaded later using `Data::read_model_voxels`.
 	StdVector<uint8_t> color_indexes;
 };
 
+// Voxel of a model as stored in the file, which is a list of non-empty voxels.
+// Coordinates are already converted to OpenGL convention.
+struct ModelVoxel {
+	uint8_t x;
+	uint8_t y;
+	uint8_t z;
+	uint8_t color_index;
+};
+
+// Location of a model's voxels in the file, so they can be read when needed
+struct ModelChunk {
+	Vector3i size;
+	uint64_t file_position;
+	uint32_t voxel_count;
+};
+
 struct Node {
 	enum Type { //
 		TYPE_TRANSFORM = 0,
@@ -100,10 +118,17 @@ struct Material {
 class Data {
 public:
 	void clear();
-	Error load_from_file(String fpath);
+	// If `load_models` is false, only the scene graph and where models are located in the file are loaded. Their voxels
+	// can be read later with `read_model_voxels`, which avoids keeping all of them in memory.
+	Error load_from_file(String fpath, bool load_models = true);
 
 	unsigned int get_model_count() const;
+	// Only available if models were loaded
 	const Model &get_model(unsigned int index) const;
+	const ModelChunk &get_model_chunk(unsigned int index) const;
+
+	// Reads voxels of a model from a file previously loaded into this data.
+	static Error read_model_voxels(FileAccess &f, const ModelChunk &chunk, StdVector<ModelVoxel> &out_voxels);
 
 	// Can return -1 if there is no scene graph
 	int get_root_node_id() const;
@@ -120,9 +145,10 @@ public:
 	}
 
 private:
-	Error _load_from_file(String fpath);
+	Error _load_from_file(String fpath, bool load_models);
 
 	StdVector<UniquePtr<Model>> _models;
+	StdVector<ModelChunk> _model_chunks;
 	StdVector<UniquePtr<Layer>> _layers;
 	StdUnorderedMap<int, UniquePtr<Node>> _scene_graph;
 	// Material IDs are supposedly tied to palette indices
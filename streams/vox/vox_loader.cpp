@@ -1,8 +1,16 @@
 #include "vox_loader.h"
 #include "../../meshers/cubes/voxel_color_palette.h"
 #include "../../storage/voxel_buffer_gd.h"
+#include "../../storage/voxel_data.h"
+#include "../../terrain/fixed_lod/voxel_terrain.h"
+#include "../../terrain/variable_lod/voxel_lod_terrain.h"
 #include "../../util/dstack.h"
+#include "../../util/math/funcs.h"
+#include "../../util/profiling.h"
+#include "../../util/thread/mutex.h"
+#include "../voxel_stream.h"
 #include "vox_data.h"
+#include "vox_scene_converter.h"
 
 namespace zylann::voxel {
 
@@ -79,6 +87,208 @@ int /*Error*/ VoxelVoxLoader::load_from_file(
 	return load_err;
 }
 
+namespace {
+
+// Splits converted regions into blocks and saves them into a stream
+class StreamSceneOutput : public magica::ISceneConverterOutput {
+public:
+	StreamSceneOutput(VoxelStream &stream, VoxelBuffer::ChannelId channel) : _stream(stream), _channel(channel) {
+		_block_size_po2 = stream.get_block_size_po2();
+	}
+
+	void write_region(Vector3i origin, VoxelBuffer &voxels) override {
+		ZN_PROFILE_SCOPE();
+		const int block_size = 1 << _block_size_po2;
+		const Vector3i region_size_in_blocks = voxels.get_size() >> _block_size_po2;
+		const Vector3i origin_in_blocks = origin >> _block_size_po2;
+
+		StdVector<VoxelBuffer> blocks;
+		StdVector<Vector3i> block_positions;
+		blocks.reserve(Vector3iUtil::get_volume(region_size_in_blocks));
+
+		Vector3i bpos;
+		for (bpos.z = 0; bpos.z < region_size_in_blocks.z; ++bpos.z) {
+			for (bpos.x = 0; bpos.x < region_size_in_blocks.x; ++bpos.x) {
+				for (bpos.y = 0; bpos.y < region_size_in_blocks.y; ++bpos.y) {
+					const Vector3i src_min = bpos * block_size;
+					blocks.emplace_back(VoxelBuffer::ALLOCATOR_POOL);
+					VoxelBuffer &block = blocks.back();
+					block.create(Vector3iUtil::create(block_size));
+					block.copy_channel_from(
+							voxels, src_min, src_min + Vector3iUtil::create(block_size), Vector3i(), _channel
+					);
+					block.compress_uniform_channels();
+					// Don't save blocks in which no model is present
+					if (block.is_uniform(_channel) && block.get_voxel(Vector3i(), _channel) == 0) {
+						blocks.pop_back();
+						continue;
+					}
+					block_positions.push_back(origin_in_blocks + bpos);
+				}
+			}
+		}
+
+		if (blocks.size() == 0) {
+			return;
+		}
+
+		StdVector<VoxelStream::VoxelQueryData> queries;
+		queries.reserve(blocks.size());
+		for (unsigned int i = 0; i < blocks.size(); ++i) {
+			queries.push_back(
+					VoxelStream::VoxelQueryData{ blocks[i], block_positions[i], 0, VoxelStream::RESULT_ERROR }
+			);
+		}
+
+		// Not all streams support saving from multiple threads at once
+		MutexLock mlock(_mutex);
+		_stream.save_voxel_blocks(to_span(queries));
+	}
+
+	inline unsigned int get_region_size() const {
+		return math::max(128, 1 << _block_size_po2);
+	}
+
+private:
+	VoxelStream &_stream;
+	VoxelBuffer::ChannelId _channel;
+	unsigned int _block_size_po2;
+	Mutex _mutex;
+};
+
+// Pastes converted regions into the voxel data of a terrain
+class TerrainSceneOutput : public magica::ISceneConverterOutput {
+public:
+	TerrainSceneOutput(VoxelData &data, VoxelBuffer::ChannelId channel) : _data(data), _channel(channel) {}
+
+	void write_region(Vector3i origin, VoxelBuffer &voxels) override {
+		ZN_PROFILE_SCOPE();
+		// Pasting is thread-safe. Empty voxels are not pasted, so they don't erase what is already in the terrain.
+		_data.paste_masked(origin, voxels, 1 << _channel, _channel, 0, !_data.is_streaming_enabled());
+
+		const Box3i box(origin, voxels.get_size());
+		MutexLock mlock(_mutex);
+		if (_has_edited_box) {
+			_edited_box.merge_with(box);
+		} else {
+			_edited_box = box;
+			_has_edited_box = true;
+		}
+	}
+
+	inline bool get_edited_box(Box3i &out_box) const {
+		out_box = _edited_box;
+		return _has_edited_box;
+	}
+
+private:
+	VoxelData &_data;
+	VoxelBuffer::ChannelId _channel;
+	Box3i _edited_box;
+	bool _has_edited_box = false;
+	Mutex _mutex;
+};
+
+Error open_scene_converter(
+		String fpath,
+		Ref<VoxelColorPalette> palette,
+		VoxelBuffer::ChannelId dst_channel,
+		Vector3i offset,
+		magica::SceneConverter &converter,
+		magica::SceneConverter::Params &params
+) {
+	const Error open_err = converter.open(fpath);
+	ERR_FAIL_COND_V(open_err != OK, open_err);
+
+	params.channel = dst_channel;
+	params.offset = offset;
+	// Same behavior as `load_from_file`: indices are written if a palette is provided
+	params.use_palette_indices = palette.is_valid();
+
+	if (palette.is_valid()) {
+		Span<const Color8> src_palette = to_span_const(converter.get_palette());
+		for (size_t i = 0; i < src_palette.size(); ++i) {
+			palette->set_color8(i, src_palette[i]);
+		}
+	}
+
+	return OK;
+}
+
+} // namespace
+
+int /*Error*/ VoxelVoxLoader::load_scene_to_stream(
+		String fpath,
+		Ref<VoxelStream> stream,
+		Ref<VoxelColorPalette> palette,
+		godot::VoxelBuffer::ChannelId dst_channel,
+		Vector3i offset
+) {
+	ZN_DSTACK();
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_INDEX_V(dst_channel, godot::VoxelBuffer::MAX_CHANNELS, ERR_INVALID_PARAMETER);
+	ERR_FAIL_COND_V(stream.is_null(), ERR_INVALID_PARAMETER);
+
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::ChannelId(dst_channel);
+
+	magica::SceneConverter converter;
+	magica::SceneConverter::Params params;
+	const Error open_err = open_scene_converter(fpath, palette, channel, offset, converter, params);
+	ERR_FAIL_COND_V(open_err != OK, open_err);
+
+	StreamSceneOutput output(**stream, channel);
+	params.region_size = output.get_region_size();
+
+	const Error err = converter.convert(params, output);
+	stream->flush();
+	return err;
+}
+
+int /*Error*/ VoxelVoxLoader::load_scene_to_terrain(
+		String fpath,
+		Node *terrain,
+		Ref<VoxelColorPalette> palette,
+		godot::VoxelBuffer::ChannelId dst_channel,
+		Vector3i offset
+) {
+	ZN_DSTACK();
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_INDEX_V(dst_channel, godot::VoxelBuffer::MAX_CHANNELS, ERR_INVALID_PARAMETER);
+	ERR_FAIL_COND_V(terrain == nullptr, ERR_INVALID_PARAMETER);
+
+	VoxelTerrain *fixed_terrain = Object::cast_to<VoxelTerrain>(terrain);
+	VoxelLodTerrain *lod_terrain = Object::cast_to<VoxelLodTerrain>(terrain);
+
+	std::shared_ptr<VoxelData> data;
+	if (fixed_terrain != nullptr) {
+		data = fixed_terrain->get_storage_shared();
+	} else if (lod_terrain != nullptr) {
+		data = lod_terrain->get_storage_shared();
+	}
+	ERR_FAIL_COND_V_MSG(data == nullptr, ERR_INVALID_PARAMETER, "Expected VoxelTerrain or VoxelLodTerrain");
+
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::ChannelId(dst_channel);
+
+	magica::SceneConverter converter;
+	magica::SceneConverter::Params params;
+	const Error open_err = open_scene_converter(fpath, palette, channel, offset, converter, params);
+	ERR_FAIL_COND_V(open_err != OK, open_err);
+
+	TerrainSceneOutput output(*data, channel);
+	const Error err = converter.convert(params, output);
+
+	Box3i edited_box;
+	if (output.get_edited_box(edited_box)) {
+		if (fixed_terrain != nullptr) {
+			fixed_terrain->post_edit_area(edited_box, true);
+		} else {
+			lod_terrain->post_edit_area(edited_box, true);
+		}
+	}
+
+	return err;
+}
+
 void VoxelVoxLoader::_bind_methods() {
 	ClassDB::bind_static_method(
 			VoxelVoxLoader::get_class_static(),
@@ -86,6 +296,20 @@ void VoxelVoxLoader::_bind_methods() {
 			&VoxelVoxLoader::load_from_file,
 			DEFVAL(godot::VoxelBuffer::CHANNEL_COLOR)
 	);
+	ClassDB::bind_static_method(
+			VoxelVoxLoader::get_class_static(),
+			D_METHOD("load_scene_to_stream", "fpath", "stream", "palette", "dst_channel", "offset"),
+			&VoxelVoxLoader::load_scene_to_stream,
+			DEFVAL(godot::VoxelBuffer::CHANNEL_COLOR),
+			DEFVAL(Vector3i())
+	);
+	ClassDB::bind_static_method(
+			VoxelVoxLoader::get_class_static(),
+			D_METHOD("load_scene_to_terrain", "fpath", "terrain", "palette", "dst_channel", "offset"),
+			&VoxelVoxLoader::load_scene_to_terrain,
+			DEFVAL(godot::VoxelBuffer::CHANNEL_COLOR),
+			DEFVAL(Vector3i())
+	);
 }
 
 } // namespace zylann::voxel
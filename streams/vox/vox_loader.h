@@ -3,10 +3,14 @@
 
 #include "../../storage/voxel_buffer_gd.h"
 #include "../../util/godot/classes/ref_counted.h"
+#include "../../util/godot/macros.h"
+
+ZN_GODOT_FORWARD_DECLARE(class Node);
 
 namespace zylann::voxel {
 
 class VoxelColorPalette;
+class VoxelStream;
 
 // Simple loader for MagicaVoxel
 class VoxelVoxLoader : public RefCounted {
@@ -20,7 +24,26 @@ public:
 			Ref<VoxelColorPalette> palette,
 			godot::VoxelBuffer::ChannelId dst_channel
 	);
-	// TODO Have chunked loading for better memory usage
+
+	// Imports all models placed in the scene of a .vox file, and saves them as blocks into a stream.
+	// The scene is converted region by region using multiple threads, so it doesn't have to fit in memory at once.
+	static int /*Error*/ load_scene_to_stream(
+			String fpath,
+			Ref<VoxelStream> stream,
+			Ref<VoxelColorPalette> palette,
+			godot::VoxelBuffer::ChannelId dst_channel,
+			Vector3i offset
+	);
+
+	// Same as `load_scene_to_stream`, but pastes voxels directly into a VoxelTerrain or VoxelLodTerrain.
+	static int /*Error*/ load_scene_to_terrain(
+			String fpath,
+			Node *terrain,
+			Ref<VoxelColorPalette> palette,
+			godot::VoxelBuffer::ChannelId dst_channel,
+			Vector3i offset
+	);
+
 	// TODO Saving
 
 private:
@@ -0,0 +1,333 @@
+#include "vox_scene_converter.h"
+#include "../../engine/voxel_engine.h"
+#include "../../util/containers/std_unordered_set.h"
+#include "../../util/godot/classes/file_access.h"
+#include "../../util/math/conv.h"
+#include "../../util/math/funcs.h"
+#include "../../util/memory/memory.h"
+#include "../../util/profiling.h"
+#include "../../util/string/format.h"
+#include "../../util/tasks/parallel_for.h"
+#include "../../util/thread/mutex.h"
+#include "../../util/thread/thread.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace zylann::voxel::magica {
+
+namespace {
+
+struct IntTransform {
+	FixedArray<Vector3i, 3> axes;
+	Vector3i origin;
+
+	inline Vector3i transform_direction(Vector3i v) const {
+		return axes[0] * v.x + axes[1] * v.y + axes[2] * v.z;
+	}
+
+	inline Vector3i transform(Vector3i v) const {
+		return transform_direction(v) + origin;
+	}
+};
+
+IntTransform get_identity_transform() {
+	IntTransform t;
+	t.axes[0] = Vector3i(1, 0, 0);
+	t.axes[1] = Vector3i(0, 1, 0);
+	t.axes[2] = Vector3i(0, 0, 1);
+	t.origin = Vector3i();
+	return t;
+}
+
+Vector3i get_rounded_axis(const Basis &basis, Vector3 axis) {
+	const Vector3 v = basis.xform(axis);
+	return Vector3i(Math::round(v.x), Math::round(v.y), Math::round(v.z));
+}
+
+ModelInstance make_instance(unsigned int model_index, const IntTransform &t, Vector3i model_size) {
+	ModelInstance instance;
+	instance.model_index = model_index;
+	instance.axes = t.axes;
+
+	// Models are rotated around their center, like the pivot used when importing scenes as meshes.
+	// When an axis is flipped, voxel `i` maps to `-i - 1` instead of `-i`, because we transform cells, not points.
+	const Vector3i pivot = model_size / 2;
+	const Vector3i axes_sum = t.axes[0] + t.axes[1] + t.axes[2];
+	const Vector3i flip_offset(axes_sum.x < 0 ? -1 : 0, axes_sum.y < 0 ? -1 : 0, axes_sum.z < 0 ? -1 : 0);
+	instance.origin = t.origin + flip_offset - t.transform_direction(pivot);
+
+	const Vector3i a = instance.transform(Vector3i());
+	const Vector3i b = instance.transform(model_size - Vector3i(1, 1, 1));
+	instance.box = Box3i::from_min_max(math::min(a, b), math::max(a, b) + Vector3i(1, 1, 1));
+
+	return instance;
+}
+
+Error add_instances_recursively(
+		const Data &data,
+		int node_id,
+		const IntTransform &parent_transform,
+		int depth,
+		StdVector<ModelInstance> &out_instances
+) {
+	ERR_FAIL_COND_V(depth > 10, ERR_INVALID_DATA);
+	const Node *vox_node = data.get_node(node_id);
+
+	switch (vox_node->type) {
+		case Node::TYPE_TRANSFORM: {
+			const TransformNode *vox_transform_node = reinterpret_cast<const TransformNode *>(vox_node);
+			const Basis &basis = vox_transform_node->rotation.basis;
+
+			IntTransform t;
+			t.axes[0] = parent_transform.transform_direction(get_rounded_axis(basis, Vector3(1, 0, 0)));
+			t.axes[1] = parent_transform.transform_direction(get_rounded_axis(basis, Vector3(0, 1, 0)));
+			t.axes[2] = parent_transform.transform_direction(get_rounded_axis(basis, Vector3(0, 0, 1)));
+			t.origin = parent_transform.transform(vox_transform_node->position);
+
+			return add_instances_recursively(data, vox_transform_node->child_node_id, t, depth + 1, out_instances);
+		}
+
+		case Node::TYPE_GROUP: {
+			const GroupNode *vox_group_node = reinterpret_cast<const GroupNode *>(vox_node);
+			for (const int child_node_id : vox_group_node->child_node_ids) {
+				const Error err =
+						add_instances_recursively(data, child_node_id, parent_transform, depth + 1, out_instances);
+				ERR_FAIL_COND_V(err != OK, err);
+			}
+		} break;
+
+		case Node::TYPE_SHAPE: {
+			const ShapeNode *vox_shape_node = reinterpret_cast<const ShapeNode *>(vox_node);
+			const unsigned int model_index = vox_shape_node->model_id;
+			const ModelChunk &chunk = data.get_model_chunk(model_index);
+			if (Vector3iUtil::get_volume(chunk.size) > 0) {
+				out_instances.push_back(make_instance(model_index, parent_transform, chunk.size));
+			}
+		} break;
+
+		default:
+			ERR_FAIL_V(ERR_INVALID_DATA);
+			break;
+	}
+
+	return OK;
+}
+
+struct ConversionContext {
+	String file_path;
+	SceneConverter::Params params;
+	Span<const Color8> palette;
+	// Instances already have the offset applied
+	StdVector<ModelInstance> instances;
+	StdVector<ModelChunk> model_chunks;
+	// Positions of regions to convert, in regions
+	StdVector<Vector3i> regions;
+	ISceneConverterOutput *output = nullptr;
+
+	std::atomic_int error = { OK };
+
+	// State reused between regions converted one after the other by the same thread
+	struct Worker {
+		Ref<FileAccess> file;
+		VoxelBuffer voxels{ VoxelBuffer::ALLOCATOR_POOL };
+		StdVector<ModelVoxel> model_voxels;
+		int loaded_model_index = -1;
+	};
+
+	// There are at most as many as threads converting regions at the same time
+	StdVector<UniquePtr<Worker>> idle_workers;
+	BinaryMutex idle_workers_mutex;
+
+	void run_region(unsigned int region_index) {
+		if (error != OK) {
+			return;
+		}
+
+		UniquePtr<Worker> worker;
+		{
+			MutexLock mlock(idle_workers_mutex);
+			if (idle_workers.size() > 0) {
+				worker = std::move(idle_workers.back());
+				idle_workers.pop_back();
+			}
+		}
+
+		if (worker == nullptr) {
+			Error open_err;
+			Ref<FileAccess> f = godot::open_file(file_path, FileAccess::READ, open_err);
+			if (f.is_null()) {
+				error = open_err;
+				return;
+			}
+			worker = make_unique_instance<Worker>();
+			worker->file = f;
+		}
+
+		const Error err = convert_region(
+				regions[region_index], **worker->file, worker->voxels, worker->model_voxels, worker->loaded_model_index
+		);
+		if (err != OK) {
+			error = err;
+		}
+
+		MutexLock mlock(idle_workers_mutex);
+		idle_workers.push_back(std::move(worker));
+	}
+
+	Error convert_region(
+			Vector3i region_position,
+			FileAccess &f,
+			VoxelBuffer &voxels,
+			StdVector<ModelVoxel> &model_voxels,
+			int &loaded_model_index
+	) {
+		ZN_PROFILE_SCOPE();
+
+		const Box3i region_box(region_position * params.region_size, Vector3iUtil::create(params.region_size));
+
+		voxels.create(region_box.size);
+		voxels.decompress_channel(params.channel);
+		Span<uint8_t> dst_raw;
+		ERR_FAIL_COND_V(!voxels.get_channel_as_bytes(params.channel, dst_raw), ERR_BUG);
+		const VoxelBuffer::Depth depth = voxels.get_channel_depth(params.channel);
+		ERR_FAIL_COND_V_MSG(
+				depth != VoxelBuffer::DEPTH_8_BIT && depth != VoxelBuffer::DEPTH_16_BIT,
+				ERR_INVALID_PARAMETER,
+				"Unsupported depth"
+		);
+
+		bool empty = true;
+
+		// Instances are processed in order, so later ones overwrite earlier ones if they overlap
+		for (const ModelInstance &instance : instances) {
+			if (!instance.box.intersects(region_box)) {
+				continue;
+			}
+
+			if (static_cast<int>(instance.model_index) != loaded_model_index) {
+				const Error err = Data::read_model_voxels(f, model_chunks[instance.model_index], model_voxels);
+				ERR_FAIL_COND_V(err != OK, err);
+				loaded_model_index = instance.model_index;
+			}
+
+			for (const ModelVoxel mv : model_voxels) {
+				const Vector3i pos = instance.transform(Vector3i(mv.x, mv.y, mv.z));
+				if (!region_box.contains(pos)) {
+					continue;
+				}
+				const unsigned int i = VoxelBuffer::get_index(pos - region_box.position, region_box.size);
+
+				if (depth == VoxelBuffer::DEPTH_8_BIT) {
+					dst_raw[i] = params.use_palette_indices ? mv.color_index : palette[mv.color_index].to_u8();
+				} else {
+					Span<uint16_t> dst = dst_raw.reinterpret_cast_to<uint16_t>();
+					dst[i] = params.use_palette_indices ? mv.color_index : palette[mv.color_index].to_u16();
+				}
+				empty = false;
+			}
+		}
+
+		if (!empty) {
+			output->write_region(region_box.position, voxels);
+		}
+
+		return OK;
+	}
+};
+
+} // namespace
+
+Error get_model_instances(const Data &data, StdVector<ModelInstance> &out_instances) {
+	if (data.get_root_node_id() != -1) {
+		return add_instances_recursively(data, data.get_root_node_id(), get_identity_transform(), 0, out_instances);
+	}
+
+	if (data.get_model_count() > 0) {
+		// Some vox files don't have a scene graph
+		const ModelChunk &chunk = data.get_model_chunk(0);
+		ModelInstance instance;
+		instance.model_index = 0;
+		instance.axes = get_identity_transform().axes;
+		instance.origin = Vector3i();
+		instance.box = Box3i(Vector3i(), chunk.size);
+		out_instances.push_back(instance);
+	}
+
+	return OK;
+}
+
+Error SceneConverter::open(String fpath) {
+	ZN_PROFILE_SCOPE();
+
+	_file_path = fpath;
+	_instances.clear();
+	_bounds = Box3i();
+
+	const Error load_err = _data.load_from_file(fpath, false);
+	ERR_FAIL_COND_V(load_err != OK, load_err);
+
+	const Error instances_err = get_model_instances(_data, _instances);
+	ERR_FAIL_COND_V(instances_err != OK, instances_err);
+
+	for (unsigned int i = 0; i < _instances.size(); ++i) {
+		if (i == 0) {
+			_bounds = _instances[i].box;
+		} else {
+			_bounds.merge_with(_instances[i].box);
+		}
+	}
+
+	return OK;
+}
+
+Error SceneConverter::convert(const Params &params, ISceneConverterOutput &output) const {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND_V(params.region_size == 0, ERR_INVALID_PARAMETER);
+
+	ConversionContext ctx;
+	ctx.file_path = _file_path;
+	ctx.params = params;
+	ctx.palette = to_span(_data.get_palette());
+	ctx.output = &output;
+
+	ctx.model_chunks.resize(_data.get_model_count());
+	for (unsigned int i = 0; i < ctx.model_chunks.size(); ++i) {
+		ctx.model_chunks[i] = _data.get_model_chunk(i);
+	}
+
+	StdUnorderedSet<Vector3i> regions;
+	ctx.instances.reserve(_instances.size());
+
+	for (ModelInstance instance : _instances) {
+		instance.origin += params.offset;
+		instance.box.position += params.offset;
+		ctx.instances.push_back(instance);
+
+		instance.box.downscaled(params.region_size).for_each_cell([&regions](Vector3i rpos) { //
+			regions.insert(rpos);
+		});
+	}
+
+	ctx.regions.reserve(regions.size());
+	for (const Vector3i rpos : regions) {
+		ctx.regions.push_back(rpos);
+	}
+	// Sort them so the order in which outputs receive regions is more predictable
+	std::sort(ctx.regions.begin(), ctx.regions.end());
+
+	const unsigned int region_count = ctx.regions.size();
+	ZN_PRINT_VERBOSE(format("Converting {} models into {} regions", ctx.instances.size(), region_count));
+
+	parallel_for(
+			region_count,
+			1,
+			math::max(Thread::get_hardware_concurrency(), 2u) - 1,
+			[](Span<IThreadedTask *> tasks) { VoxelEngine::get_singleton().push_async_tasks(tasks); },
+			[&ctx](unsigned int region_index) { ctx.run_region(region_index); }
+	);
+
+	return static_cast<Error>(ctx.error.load());
+}
+
+} // namespace zylann::voxel::magica
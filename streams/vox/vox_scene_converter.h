@@ -0,0 +1,83 @@
+#ifndef VOX_SCENE_CONVERTER_H
+#define VOX_SCENE_CONVERTER_H
+
+#include "../../storage/voxel_buffer.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/box3i.h"
+#include "../../util/math/color8.h"
+#include "vox_data.h"
+
+namespace zylann::voxel::magica {
+
+// Model placed in a scene, with its transform flattened from the scene graph.
+struct ModelInstance {
+	unsigned int model_index;
+	// Transforms voxel positions of the model into the scene:
+	// `scene_pos = axes[0] * pos.x + axes[1] * pos.y + axes[2] * pos.z + origin`.
+	// MagicaVoxel only allows axis-aligned rotations, so this can be done with integers.
+	FixedArray<Vector3i, 3> axes;
+	Vector3i origin;
+	// Voxels occupied by the model in the scene
+	Box3i box;
+
+	inline Vector3i transform(Vector3i pos) const {
+		return axes[0] * pos.x + axes[1] * pos.y + axes[2] * pos.z + origin;
+	}
+};
+
+// Gets all models placed in the scene, in the order they appear in the scene graph.
+// If the file has no scene graph, the first model is placed with its lower corner at the origin.
+Error get_model_instances(const Data &data, StdVector<ModelInstance> &out_instances);
+
+// Receives voxels converted from a scene. Called from multiple threads, so it must be thread-safe.
+class ISceneConverterOutput {
+public:
+	virtual ~ISceneConverterOutput() {}
+	// `voxels` contains an area of the scene starting at `origin`. Empty voxels are 0.
+	virtual void write_region(Vector3i origin, VoxelBuffer &voxels) = 0;
+};
+
+// Converts models placed in a MagicaVoxel scene into voxels, without loading the whole scene in memory.
+// The scene is split into regions, which are converted in parallel using threads of VoxelEngine. Voxels of models are
+// read from the file only when a region needs them.
+class SceneConverter {
+public:
+	struct Params {
+		// Channel receiving voxels
+		VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_COLOR;
+		// If true, palette indices are written. Otherwise, colors are converted to the depth of the channel.
+		bool use_palette_indices = false;
+		// Offset applied to the whole scene
+		Vector3i offset;
+		// Size of areas converted at once. Larger regions use more memory, but models spanning multiple regions will
+		// be processed more times.
+		unsigned int region_size = 128;
+	};
+
+	// Reads the scene graph and where models are located in the file, without their voxels.
+	Error open(String fpath);
+
+	// Bounds of the scene, before `Params::offset` is applied
+	inline Box3i get_bounds() const {
+		return _bounds;
+	}
+
+	inline const FixedArray<Color8, 256> &get_palette() const {
+		return _data.get_palette();
+	}
+
+	// Converts all regions containing models, and waits until they are done.
+	// Regions are aligned to multiples of the region size.
+	Error convert(const Params &params, ISceneConverterOutput &output) const;
+
+private:
+	String _file_path;
+	Data _data;
+	StdVector<ModelInstance> _instances;
+	Box3i _bounds;
+};
+
+} // namespace zylann::voxel::magica
+
+#endif // VOX_SCENE_CONVERTER_H
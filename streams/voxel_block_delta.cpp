@@ -0,0 +1,207 @@
+#include "voxel_block_delta.h"
+#include "../storage/voxel_buffer.h"
+#include "../util/errors.h"
+#include "../util/math/box3i.h"
+#include "../util/profiling.h"
+
+namespace zylann::voxel {
+namespace BlockDelta {
+
+namespace {
+
+// Format:
+//
+// u8 channels_mask
+// For each channel in the mask:
+//     Runs, each being:
+//         varuint zero_count
+//         varuint literal_count
+//         literal_count * value, each the size of the channel's depth, little-endian, XORed with the base value
+//     A run with literal_count == 0 ends the channel.
+//
+// Voxels are iterated in ZXY order within the area, the same as `VoxelBuffer` indexing.
+
+void store_var_uint(StdVector<uint8_t> &dst, uint32_t v) {
+	while (v >= 0x80) {
+		dst.push_back(static_cast<uint8_t>(v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+	dst.push_back(static_cast<uint8_t>(v));
+}
+
+bool get_var_uint(Span<const uint8_t> data, size_t &pos, uint32_t &out_v) {
+	uint32_t v = 0;
+	// 32-bit values take up to 5 bytes
+	for (unsigned int shift = 0; shift < 35; shift += 7) {
+		if (pos >= data.size()) {
+			return false;
+		}
+		const uint8_t b = data[pos];
+		++pos;
+		v |= static_cast<uint32_t>(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			out_v = v;
+			return true;
+		}
+	}
+	return false;
+}
+
+void store_run(StdVector<uint8_t> &dst, uint32_t zero_count, Span<const uint64_t> literals, unsigned int value_size) {
+	store_var_uint(dst, zero_count);
+	store_var_uint(dst, literals.size());
+	for (const uint64_t v : literals) {
+		for (unsigned int i = 0; i < value_size; ++i) {
+			dst.push_back(static_cast<uint8_t>(v >> (i * 8)));
+		}
+	}
+}
+
+} // namespace
+
+bool encode(
+		const VoxelBuffer &base,
+		Vector3i base_origin,
+		const VoxelBuffer &current,
+		Vector3i current_origin,
+		Vector3i size,
+		StdVector<uint8_t> &dst
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(base.is_box_valid(Box3i(base_origin, size)), false);
+	ZN_ASSERT_RETURN_V(current.is_box_valid(Box3i(current_origin, size)), false);
+
+	static thread_local StdVector<uint64_t> tls_literals;
+	StdVector<uint64_t> &literals = tls_literals;
+
+	const size_t header_index = dst.size();
+	// Channels mask, written once known
+	dst.push_back(0);
+	uint8_t channels_mask = 0;
+
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		const VoxelBuffer::Depth depth = base.get_channel_depth(channel_index);
+
+		if (depth != current.get_channel_depth(channel_index)) {
+			ZN_PRINT_ERROR("Channel depth mismatch, can't compute delta");
+			dst.resize(header_index);
+			return false;
+		}
+
+		if (base.get_channel_compression(channel_index) == VoxelBuffer::COMPRESSION_UNIFORM &&
+			current.get_channel_compression(channel_index) == VoxelBuffer::COMPRESSION_UNIFORM &&
+			base.get_voxel(base_origin, channel_index) == current.get_voxel(current_origin, channel_index)) {
+			// Fast path, very common for unused channels
+			continue;
+		}
+
+		const unsigned int value_size = VoxelBuffer::get_depth_byte_count(depth);
+		const size_t channel_begin = dst.size();
+		uint32_t zero_count = 0;
+		bool changed = false;
+		literals.clear();
+
+		Vector3i rpos;
+		for (rpos.z = 0; rpos.z < size.z; ++rpos.z) {
+			for (rpos.x = 0; rpos.x < size.x; ++rpos.x) {
+				for (rpos.y = 0; rpos.y < size.y; ++rpos.y) {
+					const uint64_t x = base.get_voxel(base_origin + rpos, channel_index) ^
+							current.get_voxel(current_origin + rpos, channel_index);
+
+					if (x == 0) {
+						if (literals.size() > 0) {
+							store_run(dst, zero_count, to_span(literals), value_size);
+							literals.clear();
+							zero_count = 0;
+						}
+						++zero_count;
+
+					} else {
+						literals.push_back(x);
+						changed = true;
+					}
+				}
+			}
+		}
+
+		if (!changed) {
+			dst.resize(channel_begin);
+			continue;
+		}
+
+		if (literals.size() > 0) {
+			store_run(dst, zero_count, to_span(literals), value_size);
+		}
+		// End of channel. Trailing zeroes don't need to be encoded.
+		store_var_uint(dst, 0);
+		store_var_uint(dst, 0);
+
+		channels_mask |= (1 << channel_index);
+	}
+
+	if (channels_mask == 0) {
+		dst.resize(header_index);
+		return false;
+	}
+
+	dst[header_index] = channels_mask;
+	return true;
+}
+
+bool apply(Span<const uint8_t> data, VoxelBuffer &voxels, Vector3i origin, Vector3i size) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(voxels.is_box_valid(Box3i(origin, size)), false);
+	ZN_ASSERT_RETURN_V(data.size() >= 1, false);
+
+	const uint8_t channels_mask = data[0];
+	size_t pos = 1;
+	const uint64_t volume = Vector3iUtil::get_volume(size);
+
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		if ((channels_mask & (1 << channel_index)) == 0) {
+			continue;
+		}
+
+		const unsigned int value_size = VoxelBuffer::get_depth_byte_count(voxels.get_channel_depth(channel_index));
+		uint64_t index = 0;
+
+		while (true) {
+			uint32_t zero_count;
+			uint32_t literal_count;
+			ZN_ASSERT_RETURN_V(get_var_uint(data, pos, zero_count), false);
+			ZN_ASSERT_RETURN_V(get_var_uint(data, pos, literal_count), false);
+
+			if (literal_count == 0) {
+				break;
+			}
+
+			index += zero_count;
+			ZN_ASSERT_RETURN_V(index + literal_count <= volume, false);
+			ZN_ASSERT_RETURN_V(pos + static_cast<size_t>(literal_count) * value_size <= data.size(), false);
+
+			for (uint32_t i = 0; i < literal_count; ++i) {
+				uint64_t x = 0;
+				for (unsigned int b = 0; b < value_size; ++b) {
+					x |= static_cast<uint64_t>(data[pos + b]) << (b * 8);
+				}
+				pos += value_size;
+
+				// ZXY order
+				const Vector3i rpos( //
+						static_cast<int>((index / size.y) % size.x), //
+						static_cast<int>(index % size.y), //
+						static_cast<int>(index / (static_cast<uint64_t>(size.y) * size.x))
+				);
+				const Vector3i vpos = origin + rpos;
+				voxels.set_voxel(voxels.get_voxel(vpos, channel_index) ^ x, vpos.x, vpos.y, vpos.z, channel_index);
+
+				++index;
+			}
+		}
+	}
+
+	return true;
+}
+
+} // namespace BlockDelta
+} // namespace zylann::voxel
@@ -0,0 +1,40 @@
+#ifndef VOXEL_BLOCK_DELTA_H
+#define VOXEL_BLOCK_DELTA_H
+
+#include "../util/containers/span.h"
+#include "../util/containers/std_vector.h"
+#include "../util/math/vector3i.h"
+
+#include <cstdint>
+
+namespace zylann::voxel {
+
+class VoxelBuffer;
+
+// Encodes differences between two versions of voxels, so that a peer having the old version can obtain the new one
+// by only receiving what changed. Values of each channel are XORed, which turns unchanged voxels into zeroes, and then
+// runs of zeroes are skipped. Cost is proportional to the size of the compared area, not to the size of the buffers.
+// Metadata is not included.
+namespace BlockDelta {
+
+// Appends to `dst` the delta between an area of `base` and an area of `current` of the same size. Channels must have
+// the same depth in both buffers.
+// Returns false if no voxel differs, in which case nothing is appended.
+bool encode(
+		const VoxelBuffer &base,
+		Vector3i base_origin,
+		const VoxelBuffer &current,
+		Vector3i current_origin,
+		Vector3i size,
+		StdVector<uint8_t> &dst
+);
+
+// Applies a delta produced with `encode` to an area of `voxels`, which must contain the same values as `base` had when
+// encoding.
+// Returns false if the data is invalid.
+bool apply(Span<const uint8_t> data, VoxelBuffer &voxels, Vector3i origin, Vector3i size);
+
+} // namespace BlockDelta
+} // namespace zylann::voxel
+
+#endif // VOXEL_BLOCK_DELTA_H
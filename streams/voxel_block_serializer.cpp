@@ -1,9 +1,12 @@
 #include "voxel_block_serializer.h"
 #include "../storage/voxel_buffer.h"
 #include "../storage/voxel_memory_pool.h"
+#include "../thirdparty/lz4/lz4.h"
+#include "../util/containers/fixed_array.h"
 #include "../util/dstack.h"
 #include "../util/godot/classes/file_access.h"
 #include "../util/io/serialization.h"
+#include "../util/math/funcs.h"
 #include "../util/math/vector3i.h"
 #include "../util/profiling.h"
 #include "../util/string/format.h"
@@ -23,6 +26,16 @@ const unsigned int BLOCK_TRAILING_MAGIC = 0x900df00d;
 const unsigned int BLOCK_TRAILING_MAGIC_SIZE = 4;
 const unsigned int BLOCK_METADATA_HEADER_SIZE = sizeof(uint32_t);
 
+// Channel sections are aligned relative to the beginning of the block. They are only aligned in memory if the block
+// itself is, which isn't the case after the 1-byte header of a compressed container. Readers must not rely on it, and
+// sections are always copied or decoded into channel memory.
+const unsigned int BLOCK_V5_SECTION_ALIGNMENT = 16;
+// Channel sections are individually compressed with LZ4
+const uint8_t BLOCK_V5_FLAG_LZ4_SECTIONS = 1;
+// Version, flags, size, and for each channel its format and either a uniform value or a section size, metadata size
+const unsigned int BLOCK_V5_MAX_HEADER_SIZE =
+		2 + 3 * sizeof(uint16_t) + VoxelBuffer::MAX_CHANNELS * (1 + sizeof(uint64_t)) + BLOCK_METADATA_HEADER_SIZE;
+
 // Temporary data buffers, re-used to reduce allocations
 
 StdVector<uint8_t> &get_tls_metadata_tmp() {
@@ -46,8 +59,12 @@ size_t get_metadata_size_in_bytes(const VoxelMetadata &meta) {
 		case VoxelMetadata::TYPE_EMPTY:
 			break;
 		case VoxelMetadata::TYPE_U64:
+		case VoxelMetadata::TYPE_F64:
 			size += sizeof(uint64_t);
 			break;
+		case VoxelMetadata::TYPE_BOOL:
+			size += sizeof(uint8_t);
+			break;
 		default:
 			if (meta.get_type() >= VoxelMetadata::TYPE_CUSTOM_BEGIN) {
 				const ICustomVoxelMetadata &custom = meta.get_custom();
@@ -63,30 +80,11 @@ size_t get_metadata_size_in_bytes(const VoxelMetadata &meta) {
 size_t get_metadata_size_in_bytes(const VoxelBuffer &buffer) {
 	size_t size = 0;
 
-	const FlatMapMoveOnly<Vector3i, VoxelMetadata> &voxel_metadata = buffer.get_voxel_metadata();
-	for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator it = voxel_metadata.begin();
-		 it != voxel_metadata.end();
-		 ++it) {
-		const Vector3i pos = it->key;
-
-		ERR_FAIL_COND_V_MSG(
-				pos.x < 0 || static_cast<uint32_t>(pos.x) >= VoxelBuffer::MAX_SIZE,
-				0,
-				"Invalid voxel metadata X position"
-		);
-		ERR_FAIL_COND_V_MSG(
-				pos.y < 0 || static_cast<uint32_t>(pos.y) >= VoxelBuffer::MAX_SIZE,
-				0,
-				"Invalid voxel metadata Y position"
-		);
-		ERR_FAIL_COND_V_MSG(
-				pos.z < 0 || static_cast<uint32_t>(pos.z) >= VoxelBuffer::MAX_SIZE,
-				0,
-				"Invalid voxel metadata Z position"
-		);
-
-		size += 3 * sizeof(uint16_t); // Positions are stored as 3 unsigned shorts
-		size += get_metadata_size_in_bytes(it->value);
+	const VoxelMetadataMap &voxel_metadata = buffer.get_voxel_metadata();
+	// Positions are stored as 3 unsigned shorts. They are always valid since they are within the buffer.
+	size += voxel_metadata.size() * (3 * sizeof(uint16_t));
+	for (size_t i = 0; i < voxel_metadata.size(); ++i) {
+		size += get_metadata_size_in_bytes(voxel_metadata.get_value(i));
 	}
 
 	// If no metadata is found at all, nothing is serialized, not even null.
@@ -125,6 +123,14 @@ void serialize_metadata(const VoxelMetadata &meta, MemoryWriterExistingBuffer &m
 			mw.store_8(type);
 			mw.store_64(meta.get_u64());
 			break;
+		case VoxelMetadata::TYPE_F64:
+			mw.store_8(type);
+			mw.store_double(meta.get_f64());
+			break;
+		case VoxelMetadata::TYPE_BOOL:
+			mw.store_8(type);
+			mw.store_8(meta.get_bool() ? 1 : 0);
+			break;
 		default:
 			if (type >= VoxelMetadata::TYPE_CUSTOM_BEGIN) {
 				mw.store_8(type);
@@ -147,34 +153,20 @@ void serialize_metadata(Span<uint8_t> p_dst, const VoxelBuffer &buffer) {
 	const VoxelMetadata &block_meta = buffer.get_block_metadata();
 	serialize_metadata(block_meta, mw);
 
-	const FlatMapMoveOnly<Vector3i, VoxelMetadata> &voxel_metadata = buffer.get_voxel_metadata();
-	for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator it = voxel_metadata.begin();
-		 it != voxel_metadata.end();
-		 ++it) {
-		// Serializing key as ushort because it's more than enough for a 3D dense array
-		static_assert(
-				VoxelBuffer::MAX_SIZE <= std::numeric_limits<uint16_t>::max(),
-				"Maximum size exceeds serialization support"
-		);
-		const Vector3i pos = it->key;
+	// Serializing key as ushort because it's more than enough for a 3D dense array
+	static_assert(
+			VoxelBuffer::MAX_SIZE <= std::numeric_limits<uint16_t>::max(), "Maximum size exceeds serialization support"
+	);
+
+	// Items are visited in index order, which is also the order in which they are deserialized fastest
+	buffer.for_each_voxel_metadata([&mw](Vector3i pos, const VoxelMetadata &meta) {
 		mw.store_16(pos.x);
 		mw.store_16(pos.y);
 		mw.store_16(pos.z);
-
-		serialize_metadata(it->value, mw);
-	}
+		serialize_metadata(meta, mw);
+	});
 }
 
-template <typename T>
-struct ClearOnExit {
-	T &container;
-	~ClearOnExit() {
-		container.clear();
-	}
-};
-
-// #define CLEAR_ON_EXIT(container) ClearOnExit<decltype(container)> clear_on_exit_##__LINE__;
-
 bool deserialize_metadata(VoxelMetadata &meta, MemoryReader &mr) {
 	const uint8_t type = mr.get_8();
 	switch (type) {
@@ -186,6 +178,14 @@ bool deserialize_metadata(VoxelMetadata &meta, MemoryReader &mr) {
 			meta.set_u64(mr.get_64());
 			return true;
 
+		case VoxelMetadata::TYPE_F64:
+			meta.set_f64(mr.get_double());
+			return true;
+
+		case VoxelMetadata::TYPE_BOOL:
+			meta.set_bool(mr.get_8() != 0);
+			return true;
+
 		default:
 			if (type >= VoxelMetadata::TYPE_CUSTOM_BEGIN) {
 				ICustomVoxelMetadata *custom = VoxelMetadataFactory::get_singleton().try_construct(type);
@@ -218,10 +218,9 @@ bool deserialize_metadata(Span<const uint8_t> p_src, VoxelBuffer &buffer) {
 
 	ZN_ASSERT_RETURN_V(deserialize_metadata(buffer.get_block_metadata(), mr), false);
 
-	typedef FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair Pair;
-	static thread_local StdVector<Pair> tls_pairs;
-	// Clear when exiting scope (including cases of error) so we don't store dangling Variants
-	ClearOnExit<StdVector<Pair>> clear_tls_pairs{ tls_pairs };
+	// Built separately, so nothing is left in the buffer in case of error
+	VoxelMetadataMap voxel_metadata;
+	const Vector3i buffer_size = buffer.get_size();
 
 	while (mr.pos < mr.data.size()) {
 		Vector3i pos;
@@ -231,95 +230,95 @@ bool deserialize_metadata(Span<const uint8_t> p_src, VoxelBuffer &buffer) {
 
 		ZN_ASSERT_CONTINUE_MSG(
 				buffer.is_position_valid(pos),
-				format("Invalid voxel metadata position {} for buffer of size {}", pos, buffer.get_size())
+				format("Invalid voxel metadata position {} for buffer of size {}", pos, buffer_size)
 		);
 
-		// VoxelMetadata &vmeta = buffer.get_or_create_voxel_metadata(pos);
-		tls_pairs.resize(tls_pairs.size() + 1);
-		Pair &p = tls_pairs.back();
-		p.key = pos;
+		VoxelMetadata &meta = voxel_metadata.push_back_unsorted(VoxelBuffer::get_index(pos, buffer_size));
 		ZN_ASSERT_RETURN_V_MSG(
-				deserialize_metadata(p.value, mr), false, format("Failed to deserialize voxel metadata {}", pos)
+				deserialize_metadata(meta, mr), false, format("Failed to deserialize voxel metadata {}", pos)
 		);
 	}
 
-	// Set all metadata at once, FlatMap is faster to initialize this way
-	buffer.clear_and_set_voxel_metadata(to_span(tls_pairs));
+	// Set all metadata at once. Blocks saved by older versions were not in index order, they get sorted once here.
+	buffer.clear_and_set_voxel_metadata(std::move(voxel_metadata));
 
 	return true;
 }
 
-size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
-	// Version and size
-	size_t size = 1 * sizeof(uint8_t) + 3 * sizeof(uint16_t);
-
-	const Vector3i size_in_voxels = buffer.get_size();
-
-	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
-		const VoxelBuffer::Compression compression = buffer.get_channel_compression(channel_index);
-		const VoxelBuffer::Depth depth = buffer.get_channel_depth(channel_index);
-
-		// For format value
-		size += 1;
-
-		switch (compression) {
-			case VoxelBuffer::COMPRESSION_NONE: {
-				size += VoxelBuffer::get_size_in_bytes_for_volume(size_in_voxels, depth);
-			} break;
-
-			case VoxelBuffer::COMPRESSION_UNIFORM: {
-				size += VoxelBuffer::get_depth_bit_count(depth) >> 3;
-			} break;
-
-			default:
-				ERR_PRINT("Unhandled compression mode");
-				CRASH_NOW();
-		}
+void store_uniform_value(MemoryWriter &f, uint64_t v, VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			f.store_8(v);
+			break;
+		case VoxelBuffer::DEPTH_16_BIT:
+			f.store_16(v);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			f.store_32(v);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			f.store_64(v);
+			break;
+		default:
+			CRASH_NOW();
 	}
+}
 
-	metadata_size = get_metadata_size_in_bytes(buffer);
-
-	size_t metadata_size_with_header = 0;
-	if (metadata_size > 0) {
-		metadata_size_with_header = metadata_size + BLOCK_METADATA_HEADER_SIZE;
+uint64_t get_uniform_value(MemoryReader &f, VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			return f.get_8();
+		case VoxelBuffer::DEPTH_16_BIT:
+			return f.get_16();
+		case VoxelBuffer::DEPTH_32_BIT:
+			return f.get_32();
+		case VoxelBuffer::DEPTH_64_BIT:
+			return f.get_64();
+		default:
+			CRASH_NOW();
 	}
-
-	return size + metadata_size_with_header + BLOCK_TRAILING_MAGIC_SIZE;
+	return 0;
 }
 
-SerializeResult serialize(const VoxelBuffer &voxel_buffer) {
-	ZN_PROFILE_SCOPE();
-
-	StdVector<uint8_t> &dst_data = get_tls_data();
-	StdVector<uint8_t> &metadata_tmp = get_tls_metadata_tmp();
-	dst_data.clear();
-	metadata_tmp.clear();
+// Appends a block in the latest format to `dst`. Section alignment is relative to where the block begins, so a wrapper
+// header may precede it (sections are then not aligned in memory).
+// If `compress_sections` is true, each channel section is LZ4-compressed straight from the memory of the channel.
+bool serialize_v5(const VoxelBuffer &voxel_buffer, StdVector<uint8_t> &dst, bool compress_sections) {
+	const size_t begin = dst.size();
+	const Vector3i size = voxel_buffer.get_size();
 
 	// Cannot serialize an empty block
-	ERR_FAIL_COND_V(Vector3iUtil::get_volume(voxel_buffer.get_size()) == 0, SerializeResult(dst_data, false));
+	ERR_FAIL_COND_V(Vector3iUtil::get_volume(size) == 0, false);
+	ERR_FAIL_COND_V(size.x > std::numeric_limits<uint16_t>().max(), false);
+	ERR_FAIL_COND_V(size.y > std::numeric_limits<uint16_t>().max(), false);
+	ERR_FAIL_COND_V(size.z > std::numeric_limits<uint16_t>().max(), false);
 
-	size_t expected_metadata_size = 0;
-	const size_t expected_data_size = get_size_in_bytes(voxel_buffer, expected_metadata_size);
-	dst_data.reserve(expected_data_size);
+	// Metadata has more reasons to fail. If a recoverable error occurs prior to serializing,
+	// we just discard all metadata as if it was empty.
+	const size_t metadata_size = get_metadata_size_in_bytes(voxel_buffer);
+
+	if (!compress_sections) {
+		size_t expected_size = BLOCK_V5_MAX_HEADER_SIZE + metadata_size + BLOCK_TRAILING_MAGIC_SIZE;
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			if (voxel_buffer.get_channel_compression(channel_index) == VoxelBuffer::COMPRESSION_NONE) {
+				expected_size += BLOCK_V5_SECTION_ALIGNMENT +
+						VoxelBuffer::get_size_in_bytes_for_volume(size, voxel_buffer.get_channel_depth(channel_index));
+			}
+		}
+		dst.reserve(begin + expected_size);
+	}
 
-	MemoryWriter f(dst_data, ENDIANNESS_LITTLE_ENDIAN);
+	MemoryWriter f(dst, ENDIANNESS_LITTLE_ENDIAN);
 
 	f.store_8(BLOCK_FORMAT_VERSION);
+	f.store_8(compress_sections ? BLOCK_V5_FLAG_LZ4_SECTIONS : 0);
+	f.store_16(size.x);
+	f.store_16(size.y);
+	f.store_16(size.z);
 
-	ERR_FAIL_COND_V(
-			voxel_buffer.get_size().x > std::numeric_limits<uint16_t>().max(), SerializeResult(dst_data, false)
-	);
-	f.store_16(voxel_buffer.get_size().x);
-
-	ERR_FAIL_COND_V(
-			voxel_buffer.get_size().y > std::numeric_limits<uint16_t>().max(), SerializeResult(dst_data, false)
-	);
-	f.store_16(voxel_buffer.get_size().y);
-
-	ERR_FAIL_COND_V(
-			voxel_buffer.get_size().z > std::numeric_limits<uint16_t>().max(), SerializeResult(dst_data, false)
-	);
-	f.store_16(voxel_buffer.get_size().z);
+	// Where section sizes are, so they can be patched once sections are written
+	FixedArray<size_t, VoxelBuffer::MAX_CHANNELS> section_size_positions;
+	fill(section_size_positions, size_t(0));
 
 	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
 		const VoxelBuffer::Compression compression = voxel_buffer.get_channel_compression(channel_index);
@@ -330,56 +329,71 @@ SerializeResult serialize(const VoxelBuffer &voxel_buffer) {
 		f.store_8(fmt);
 
 		switch (compression) {
-			case VoxelBuffer::COMPRESSION_NONE: {
-				Span<const uint8_t> data;
-				ERR_FAIL_COND_V(
-						!voxel_buffer.get_channel_as_bytes_read_only(channel_index, data),
-						SerializeResult(dst_data, false)
-				);
-				f.store_buffer(data);
-			} break;
+			case VoxelBuffer::COMPRESSION_NONE:
+				section_size_positions[channel_index] = dst.size();
+				f.store_32(0);
+				break;
 
-			case VoxelBuffer::COMPRESSION_UNIFORM: {
-				const uint64_t v = voxel_buffer.get_voxel(Vector3i(), channel_index);
-				switch (depth) {
-					case VoxelBuffer::DEPTH_8_BIT:
-						f.store_8(v);
-						break;
-					case VoxelBuffer::DEPTH_16_BIT:
-						f.store_16(v);
-						break;
-					case VoxelBuffer::DEPTH_32_BIT:
-						f.store_32(v);
-						break;
-					case VoxelBuffer::DEPTH_64_BIT:
-						f.store_64(v);
-						break;
-					default:
-						CRASH_NOW();
-				}
-			} break;
+			case VoxelBuffer::COMPRESSION_UNIFORM:
+				store_uniform_value(f, voxel_buffer.get_voxel(Vector3i(), channel_index), depth);
+				break;
 
 			default:
 				CRASH_COND("Unhandled compression mode");
 		}
 	}
 
-	// Metadata has more reasons to fail. If a recoverable error occurs prior to serializing,
-	// we just discard all metadata as if it was empty.
-	if (expected_metadata_size > 0) {
-		f.store_32(expected_metadata_size);
-		metadata_tmp.resize(expected_metadata_size);
-		// This function brings me joy. </irony>
-		serialize_metadata(to_span(metadata_tmp), voxel_buffer);
-		f.store_buffer(to_span(metadata_tmp));
+	f.store_32(metadata_size);
+
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		if (voxel_buffer.get_channel_compression(channel_index) != VoxelBuffer::COMPRESSION_NONE) {
+			continue;
+		}
+
+		Span<const uint8_t> channel_data;
+		ERR_FAIL_COND_V(!voxel_buffer.get_channel_as_bytes_read_only(channel_index, channel_data), false);
+
+		dst.resize(begin + math::alignup(dst.size() - begin, BLOCK_V5_SECTION_ALIGNMENT), 0);
+		const size_t section_begin = dst.size();
+
+		if (compress_sections) {
+			dst.resize(section_begin + LZ4_compressBound(channel_data.size()));
+			const int compressed_size = LZ4_compress_default(
+					reinterpret_cast<const char *>(channel_data.data()),
+					reinterpret_cast<char *>(dst.data() + section_begin),
+					channel_data.size(),
+					dst.size() - section_begin
+			);
+			ERR_FAIL_COND_V(compressed_size <= 0, false);
+			dst.resize(section_begin + compressed_size);
+		} else {
+			f.store_buffer(channel_data);
+		}
+
+		ByteSpanWithPosition size_bs(to_span(dst), section_size_positions[channel_index]);
+		MemoryWriterExistingBuffer size_writer(size_bs, ENDIANNESS_LITTLE_ENDIAN);
+		size_writer.store_32(dst.size() - section_begin);
+	}
+
+	if (metadata_size > 0) {
+		const size_t metadata_begin = dst.size();
+		dst.resize(metadata_begin + metadata_size);
+		serialize_metadata(Span<uint8_t>(dst.data() + metadata_begin, metadata_size), voxel_buffer);
 	}
 
 	f.store_32(BLOCK_TRAILING_MAGIC);
 
-	// Check out of bounds writing
-	CRASH_COND(dst_data.size() != expected_data_size);
+	return true;
+}
+
+SerializeResult serialize(const VoxelBuffer &voxel_buffer) {
+	ZN_PROFILE_SCOPE();
 
-	return SerializeResult(dst_data, true);
+	StdVector<uint8_t> &dst_data = get_tls_data();
+	dst_data.clear();
+
+	const bool success = serialize_v5(voxel_buffer, dst_data, false);
+	return SerializeResult(dst_data, success);
 }
 
 namespace legacy {
@@ -576,42 +590,10 @@ bool migrate_v2_to_v3(Span<const uint8_t> p_data, StdVector<uint8_t> &dst) {
 
 } // namespace legacy
 
-bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
-	ZN_DSTACK();
-	ZN_PROFILE_SCOPE();
-
+// Version 4 stores channels one after the other without alignment, followed by optional metadata
+bool deserialize_v4(MemoryReader &f, Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 	StdVector<uint8_t> &metadata_tmp = get_tls_metadata_tmp();
 
-	ERR_FAIL_COND_V(p_data.size() < sizeof(uint32_t), false);
-	const uint32_t magic = *reinterpret_cast<const uint32_t *>(&p_data[p_data.size() - sizeof(uint32_t)]);
-#if DEV_ENABLED
-	if (magic != BLOCK_TRAILING_MAGIC) {
-		print_line(to_hex_table(p_data));
-	}
-#endif
-	ERR_FAIL_COND_V(magic != BLOCK_TRAILING_MAGIC, false);
-
-	MemoryReader f(p_data, ENDIANNESS_LITTLE_ENDIAN);
-
-	const uint8_t format_version = f.get_8();
-
-	switch (format_version) {
-		case 2: {
-			StdVector<uint8_t> migrated_data;
-			ERR_FAIL_COND_V(!legacy::migrate_v2_to_v3(p_data, migrated_data), false);
-			return deserialize(to_span(migrated_data), out_voxel_buffer);
-		} break;
-
-		case 3: {
-			StdVector<uint8_t> migrated_data;
-			ERR_FAIL_COND_V(!legacy::migrate_v3_to_v4(p_data, migrated_data), false);
-			return deserialize(to_span(migrated_data), out_voxel_buffer);
-		} break;
-
-		default:
-			ERR_FAIL_COND_V(format_version != BLOCK_FORMAT_VERSION, false);
-	}
-
 	const unsigned int size_x = f.get_16();
 	const unsigned int size_y = f.get_16();
 	const unsigned int size_z = f.get_16();
@@ -653,23 +635,7 @@ bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 			} break;
 
 			case VoxelBuffer::COMPRESSION_UNIFORM: {
-				uint64_t v;
-				switch (out_voxel_buffer.get_channel_depth(channel_index)) {
-					case VoxelBuffer::DEPTH_8_BIT:
-						v = f.get_8();
-						break;
-					case VoxelBuffer::DEPTH_16_BIT:
-						v = f.get_16();
-						break;
-					case VoxelBuffer::DEPTH_32_BIT:
-						v = f.get_32();
-						break;
-					case VoxelBuffer::DEPTH_64_BIT:
-						v = f.get_64();
-						break;
-					default:
-						CRASH_NOW();
-				}
+				const uint64_t v = get_uniform_value(f, depth);
 				out_voxel_buffer.clear_channel(channel_index, v);
 			} break;
 
@@ -694,19 +660,159 @@ bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 	return true;
 }
 
+// Version 5 has a fixed-size header describing all channels, followed by channel sections starting at aligned offsets.
+// Sections are either raw or LZ4-compressed, and are decoded directly into channel memory.
+bool deserialize_v5(MemoryReader &f, Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
+	const uint8_t flags = f.get_8();
+	ERR_FAIL_COND_V_MSG((flags & ~BLOCK_V5_FLAG_LZ4_SECTIONS) != 0, false, "Unknown block flags");
+
+	const unsigned int size_x = f.get_16();
+	const unsigned int size_y = f.get_16();
+	const unsigned int size_z = f.get_16();
+	ERR_FAIL_COND_V(size_x == 0 || size_y == 0 || size_z == 0, false);
+
+	out_voxel_buffer.create(Vector3i(size_x, size_y, size_z));
+
+	// Zero for uniform channels
+	FixedArray<uint32_t, VoxelBuffer::MAX_CHANNELS> section_sizes;
+	fill(section_sizes, uint32_t(0));
+
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		const uint8_t fmt = f.get_8();
+		const uint8_t compression_value = fmt & 0xf;
+		const uint8_t depth_value = (fmt >> 4) & 0xf;
+		ERR_FAIL_COND_V_MSG(
+				compression_value >= VoxelBuffer::COMPRESSION_COUNT,
+				false,
+				"At offset 0x" + String::num_int64(f.get_position() - 1, 16)
+		);
+		ERR_FAIL_COND_V_MSG(
+				depth_value >= VoxelBuffer::DEPTH_COUNT,
+				false,
+				"At offset 0x" + String::num_int64(f.get_position() - 1, 16)
+		);
+		const VoxelBuffer::Compression compression = (VoxelBuffer::Compression)compression_value;
+		const VoxelBuffer::Depth depth = (VoxelBuffer::Depth)depth_value;
+
+		out_voxel_buffer.set_channel_depth(channel_index, depth);
+
+		switch (compression) {
+			case VoxelBuffer::COMPRESSION_NONE:
+				section_sizes[channel_index] = f.get_32();
+				ERR_FAIL_COND_V(section_sizes[channel_index] == 0, false);
+				break;
+
+			case VoxelBuffer::COMPRESSION_UNIFORM: {
+				const uint64_t v = get_uniform_value(f, depth);
+				out_voxel_buffer.clear_channel(channel_index, v);
+			} break;
+
+			default:
+				ERR_PRINT("Unhandled compression mode");
+				return false;
+		}
+	}
+
+	const size_t metadata_size = f.get_32();
+
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		const size_t section_size = section_sizes[channel_index];
+		if (section_size == 0) {
+			continue;
+		}
+
+		f.pos = math::alignup(f.pos, BLOCK_V5_SECTION_ALIGNMENT);
+		ERR_FAIL_COND_V_MSG(f.pos + section_size > p_data.size(), false, "Unexpected end of file");
+		const Span<const uint8_t> section = p_data.sub(f.pos, section_size);
+		f.pos += section_size;
+
+		// Decode straight into the memory of the channel, there is no intermediary buffer
+		out_voxel_buffer.decompress_channel_noinit(channel_index);
+		Span<uint8_t> channel_data;
+		CRASH_COND(!out_voxel_buffer.get_channel_as_bytes(channel_index, channel_data));
+
+		if ((flags & BLOCK_V5_FLAG_LZ4_SECTIONS) != 0) {
+			const int decompressed_size = LZ4_decompress_safe(
+					reinterpret_cast<const char *>(section.data()),
+					reinterpret_cast<char *>(channel_data.data()),
+					section.size(),
+					channel_data.size()
+			);
+			ERR_FAIL_COND_V_MSG(
+					decompressed_size < 0 || static_cast<size_t>(decompressed_size) != channel_data.size(),
+					false,
+					String("LZ4 decompression error ") + String::num_int64(decompressed_size)
+			);
+		} else {
+			ERR_FAIL_COND_V_MSG(section.size() != channel_data.size(), false, "Unexpected channel section size");
+			memcpy(channel_data.data(), section.data(), section.size());
+		}
+	}
+
+	if (metadata_size > 0) {
+		ERR_FAIL_COND_V(f.pos + metadata_size > p_data.size(), false);
+		deserialize_metadata(p_data.sub(f.pos, metadata_size), out_voxel_buffer);
+		f.pos += metadata_size;
+	}
+
+	// Failure at this indicates file corruption
+	ERR_FAIL_COND_V_MSG(
+			f.get_32() != BLOCK_TRAILING_MAGIC, false, "At offset 0x" + String::num_int64(f.get_position() - 4, 16)
+	);
+	return true;
+}
+
+bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
+	ZN_DSTACK();
+	ZN_PROFILE_SCOPE();
+
+	ERR_FAIL_COND_V(p_data.size() < sizeof(uint32_t), false);
+	const uint32_t magic = *reinterpret_cast<const uint32_t *>(&p_data[p_data.size() - sizeof(uint32_t)]);
+#if DEV_ENABLED
+	if (magic != BLOCK_TRAILING_MAGIC) {
+		print_line(to_hex_table(p_data));
+	}
+#endif
+	ERR_FAIL_COND_V(magic != BLOCK_TRAILING_MAGIC, false);
+
+	MemoryReader f(p_data, ENDIANNESS_LITTLE_ENDIAN);
+
+	const uint8_t format_version = f.get_8();
+
+	switch (format_version) {
+		case 2: {
+			StdVector<uint8_t> migrated_data;
+			ERR_FAIL_COND_V(!legacy::migrate_v2_to_v3(p_data, migrated_data), false);
+			return deserialize(to_span(migrated_data), out_voxel_buffer);
+		} break;
+
+		case 3: {
+			StdVector<uint8_t> migrated_data;
+			ERR_FAIL_COND_V(!legacy::migrate_v3_to_v4(p_data, migrated_data), false);
+			return deserialize(to_span(migrated_data), out_voxel_buffer);
+		} break;
+
+		case 4:
+			return deserialize_v4(f, p_data, out_voxel_buffer);
+
+		default:
+			ERR_FAIL_COND_V(format_version != BLOCK_FORMAT_VERSION, false);
+			return deserialize_v5(f, p_data, out_voxel_buffer);
+	}
+}
+
 SerializeResult serialize_and_compress(const VoxelBuffer &voxel_buffer) {
 	ZN_PROFILE_SCOPE();
 
 	StdVector<uint8_t> &compressed_data = get_tls_compressed_data();
+	compressed_data.clear();
 
-	SerializeResult res = serialize(voxel_buffer);
-	ERR_FAIL_COND_V(!res.success, SerializeResult(compressed_data, false));
-	const StdVector<uint8_t> &data = res.data;
+	// Channels are compressed individually, straight from voxel memory, so the container itself is left uncompressed.
+	// This also allows readers to decode channels directly into their destination.
+	compressed_data.push_back(CompressedData::COMPRESSION_NONE);
 
-	res.success = CompressedData::compress(
-			Span<const uint8_t>(data.data(), 0, data.size()), compressed_data, CompressedData::COMPRESSION_LZ4
-	);
-	ERR_FAIL_COND_V(!res.success, SerializeResult(compressed_data, false));
+	const bool success = serialize_v5(voxel_buffer, compressed_data, true);
+	ERR_FAIL_COND_V(!success, SerializeResult(compressed_data, false));
 
 	return SerializeResult(compressed_data, true);
 }
@@ -714,6 +820,13 @@ SerializeResult serialize_and_compress(const VoxelBuffer &voxel_buffer) {
 bool decompress_and_deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 	ZN_PROFILE_SCOPE();
 
+	ERR_FAIL_COND_V(p_data.size() == 0, false);
+
+	if (p_data[0] == CompressedData::COMPRESSION_NONE) {
+		// Since version 5, channels are compressed individually and get decoded straight into channel memory
+		return deserialize(p_data.sub(1), out_voxel_buffer);
+	}
+
 	StdVector<uint8_t> &data = get_tls_data();
 
 	const bool res = CompressedData::decompress(p_data, data);
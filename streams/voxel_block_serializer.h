@@ -19,7 +19,7 @@ class VoxelBuffer;
 namespace BlockSerializer {
 
 // Latest version, used when serializing
-static const uint8_t BLOCK_FORMAT_VERSION = 4;
+static const uint8_t BLOCK_FORMAT_VERSION = 5;
 
 struct SerializeResult {
 	// The lifetime of the pointed object is only valid in the calling thread,
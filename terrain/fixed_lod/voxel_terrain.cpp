@@ -31,6 +31,7 @@
 #include "../../util/tasks/async_dependency_tracker.h"
 #include "../instancing/voxel_instancer.h"
 #include "../voxel_data_block_enter_info.h"
+#include "../voxel_hierarchical_path_finder.h"
 #include "../voxel_save_completion_tracker.h"
 #include "voxel_terrain_multiplayer_synchronizer.h"
 
@@ -55,6 +56,7 @@ VoxelTerrain::VoxelTerrain() {
 
 	_streaming_dependency = make_shared_instance<StreamingDependency>();
 	_meshing_dependency = make_shared_instance<MeshingDependency>();
+	_update_data = make_shared_instance<VoxelTerrainUpdateData>();
 
 	struct ApplyMeshUpdateTask : public ITimeSpreadTask {
 		void run(TimeSpreadTaskContext &ctx) override {
@@ -88,7 +90,7 @@ VoxelTerrain::VoxelTerrain() {
 		self->apply_data_block_response(ob);
 	};
 
-	_volume_id = VoxelEngine::get_singleton().add_volume(callbacks);
+	_volume_id = VoxelEngine::get_singleton().add_volume(callbacks, _data);
 
 	// TODO Can't setup a default mesher anymore due to a Godot 4 warning...
 	// For ease of use in editor
@@ -126,6 +128,19 @@ bool VoxelTerrain::get_generator_use_gpu() const {
 	return _generator_use_gpu;
 }
 
+void VoxelTerrain::set_threaded_update_enabled(bool enabled) {
+	if (enabled != _threaded_update_enabled) {
+		if (_threaded_update_enabled) {
+			finish_update_task();
+		}
+		_threaded_update_enabled = enabled;
+	}
+}
+
+bool VoxelTerrain::is_threaded_update_enabled() const {
+	return _threaded_update_enabled;
+}
+
 void VoxelTerrain::set_stream(Ref<VoxelStream> p_stream) {
 	if (p_stream == get_stream()) {
 		return;
@@ -226,6 +241,9 @@ void VoxelTerrain::set_mesh_block_size(unsigned int mesh_block_size) {
 		return;
 	}
 
+	// Pending mesh block changes were computed with the previous size
+	finish_update_task();
+
 	_mesh_block_size_po2 = po2;
 
 	// Unload all mesh blocks regardless of refcount
@@ -305,6 +323,10 @@ void VoxelTerrain::set_mesher(Ref<VoxelMesher> mesher) {
 
 	MeshingDependency::reset(_meshing_dependency, _mesher, get_generator());
 
+	// The library may be different
+	_random_tick_index.clear();
+	_lighting.set_rules(nullptr);
+
 	stop_updater();
 
 	if (_mesher.is_valid()) {
@@ -565,6 +587,25 @@ void VoxelTerrain::set_instancer(VoxelInstancer *instancer) {
 	_instancer = instancer;
 }
 
+void VoxelTerrain::add_path_finder(std::shared_ptr<HierarchicalPathFinder> path_finder) {
+	ZN_ASSERT_RETURN(path_finder != nullptr);
+	_path_finders.push_back(path_finder);
+}
+
+void VoxelTerrain::invalidate_path_finders(Box3i box_in_voxels) {
+	for (unsigned int i = 0; i < _path_finders.size();) {
+		std::shared_ptr<HierarchicalPathFinder> path_finder = _path_finders[i].lock();
+		if (path_finder == nullptr) {
+			// No longer used
+			_path_finders[i] = _path_finders.back();
+			_path_finders.pop_back();
+		} else {
+			path_finder->invalidate_area(box_in_voxels);
+			++i;
+		}
+	}
+}
+
 void VoxelTerrain::get_meshed_block_positions(StdVector<Vector3i> &out_positions) const {
 	_mesh_map.for_each_block([&out_positions](const VoxelMeshBlock &mesh_block) {
 		if (mesh_block.has_mesh()) {
@@ -689,6 +730,8 @@ void VoxelTerrain::start_streamer() {
 }
 
 void VoxelTerrain::stop_streamer() {
+	finish_update_task();
+
 	// Invalidate pending tasks
 	StreamingDependency::reset(_streaming_dependency, get_stream(), get_generator());
 	// VoxelEngine::get_singleton().set_volume_stream(_volume_id, Ref<VoxelStream>());
@@ -722,6 +765,8 @@ void VoxelTerrain::clear_mesh_map() {
 void VoxelTerrain::reset_map() {
 	// Discard everything, to reload it all
 
+	finish_update_task();
+
 	_data->for_each_block_position([this](const Vector3i &bpos) { //
 		emit_data_block_unloaded(bpos);
 	});
@@ -768,6 +813,10 @@ void VoxelTerrain::try_schedule_mesh_update_from_data(const Box3i &box_in_voxels
 void VoxelTerrain::post_edit_area(Box3i box_in_voxels, bool update_mesh) {
 	_data->mark_area_modified(box_in_voxels, nullptr, false);
 
+	_random_tick_index.mark_blocks_dirty(box_in_voxels.downscaled(get_data_block_size()));
+	_lighting.mark_area_edited(box_in_voxels, get_data_block_size());
+	invalidate_path_finders(box_in_voxels);
+
 	box_in_voxels.clip(_data->get_bounds());
 
 	// TODO Maybe remove this in preference for multiplayer synchronizer virtual functions?
@@ -1074,10 +1123,17 @@ void VoxelTerrain::emit_data_block_loaded(Vector3i bpos) {
 	// absolutely necessary, buffers aren't exposed. Workaround: use VoxelTool
 	// const Variant vbuffer = block->voxels;
 	// const Variant *args[2] = { &vpos, &vbuffer };
+	_random_tick_index.mark_block_dirty(bpos);
+	_lighting.mark_block_loaded(bpos, get_data_block_size());
+	invalidate_path_finders(Box3i(bpos * get_data_block_size(), Vector3iUtil::create(get_data_block_size())));
 	emit_signal(VoxelStringNames::get_singleton().block_loaded, bpos);
 }
 
 void VoxelTerrain::emit_data_block_unloaded(Vector3i bpos) {
+	_random_tick_index.remove_block(bpos);
+	if (_multiplayer_synchronizer != nullptr) {
+		_multiplayer_synchronizer->on_data_block_unloaded(bpos);
+	}
 	emit_signal(VoxelStringNames::get_singleton().block_unloaded, bpos);
 }
 
@@ -1168,6 +1224,8 @@ void VoxelTerrain::process() {
 
 	process_viewers();
 	// process_received_data_blocks();
+	// Before meshing, so meshes get built with up-to-date light
+	process_lighting();
 	process_meshing();
 
 #ifdef TOOLS_ENABLED
@@ -1177,7 +1235,67 @@ void VoxelTerrain::process() {
 #endif
 }
 
+void VoxelTerrain::process_lighting() {
+	// Results of tasks scheduled previously
+	StdVector<Box3i> modified_boxes;
+	_lighting.take_results(modified_boxes);
+
+	if (modified_boxes.size() > 0) {
+		const bool send_to_peers = _multiplayer_synchronizer != nullptr && _multiplayer_synchronizer->is_server();
+
+		for (const Box3i &box : modified_boxes) {
+			try_schedule_mesh_update_from_data(box);
+			if (send_to_peers) {
+				// Light is part of the voxels replicated to clients
+				_multiplayer_synchronizer->send_area(box);
+			}
+		}
+	}
+
+	Ref<VoxelMesherBlocky> mesher = _mesher;
+	Ref<VoxelBlockyLibraryBase> library;
+	if (mesher.is_valid() && mesher->get_lighting_enabled()) {
+		library = mesher->get_library();
+	}
+	if (library.is_null()) {
+		_lighting.set_rules(nullptr);
+		_lighting.clear_pending();
+		return;
+	}
+
+	ZN_PROFILE_SCOPE();
+
+	const VoxelBuffer::ChannelId channel = mesher->get_light_channel();
+	const bool channel_changed = channel != _lighting.get_channel();
+	_lighting.set_channel(channel);
+
+	if (_lighting.update_rules_from_library(**library) || channel_changed) {
+		// Light of all loaded blocks may be different now
+		const unsigned int block_size = get_data_block_size();
+		_data->for_each_block_position([this, block_size](Vector3i bpos) { //
+			_lighting.mark_block_loaded(bpos, block_size);
+		});
+	}
+
+	// Areas keep accumulating while tasks run, so they are relit together once previous tasks are done
+	if (_lighting.has_tasks_in_progress() || !_lighting.has_pending_work()) {
+		return;
+	}
+
+	StdVector<IThreadedTask *> tasks;
+	_lighting.take_tasks(_data, tasks);
+	VoxelEngine::get_singleton().push_async_tasks(to_span(tasks));
+}
+
 void VoxelTerrain::process_viewers() {
+	if (!_update_data->task_is_complete) {
+		// The previous update is still running. Viewers will be processed again once it's done.
+		return;
+	}
+
+	// Results of the previous update, if it ran on a thread
+	apply_update_results();
+
 	ProfilingClock profiling_clock;
 
 	// Ordered by ascending index in paired viewers list
@@ -1325,87 +1443,56 @@ void VoxelTerrain::process_viewers() {
 								  (get_stream().is_valid() || get_generator().is_valid())) &&
 			(Engine::get_singleton()->is_editor_hint() == false || _run_stream_in_editor);
 
-	// Find out which blocks need to appear and which need to be unloaded
+	VoxelTerrainUpdateData &update_data = *_update_data;
+
+	// Gather how view boxes changed. Finding out which blocks need to appear and which need to be unloaded is done by
+	// the update task.
 	{
 		ZN_PROFILE_SCOPE();
 
+		update_data.changes.clear();
+		update_data.can_load_blocks = can_load_blocks;
+		update_data.may_save =
+				get_stream().is_valid() && (!Engine::get_singleton()->is_editor_hint() || _run_stream_in_editor);
+
+		const bool notifications_enabled = _block_enter_notification_enabled ||
+				(_multiplayer_synchronizer != nullptr && _multiplayer_synchronizer->is_server());
+
 		for (size_t i = 0; i < _paired_viewers.size(); ++i) {
 			const PairedViewer &viewer = _paired_viewers[i];
 
-			{
-				const Box3i &new_data_box = viewer.state.data_box;
-				const Box3i &prev_data_box = viewer.prev_state.data_box;
-
-				if (prev_data_box != new_data_box) {
-					process_viewer_data_box_change(viewer.id, prev_data_box, new_data_box, can_load_blocks);
-				}
+			if (viewer.state.data_box == viewer.prev_state.data_box &&
+				viewer.state.mesh_box == viewer.prev_state.mesh_box &&
+				viewer.state.requires_meshes == viewer.prev_state.requires_meshes &&
+				viewer.state.requires_collisions == viewer.prev_state.requires_collisions) {
+				continue;
 			}
 
-			{
-				const Box3i &new_mesh_box = viewer.state.mesh_box;
-				const Box3i &prev_mesh_box = viewer.prev_state.mesh_box;
-
-				if (prev_mesh_box != new_mesh_box) {
-					ZN_PROFILE_SCOPE();
-
-					// TODO Any reason to unview old blocks before viewing new blocks?
-					// Because if a viewer is removed and another is added, it will reload the whole area even if their
-					// box is the same.
-
-					// Unview blocks that just fell out of range
-					prev_mesh_box.difference(new_mesh_box, [this, &viewer](Box3i out_of_range_box) {
-						out_of_range_box.for_each_cell([this, &viewer](Vector3i bpos) {
-							unview_mesh_block(
-									bpos, viewer.prev_state.requires_meshes, viewer.prev_state.requires_collisions
-							);
-						});
-					});
-
-					// View blocks that just entered the range
-					new_mesh_box.difference(prev_mesh_box, [this, &viewer](Box3i box_to_load) {
-						box_to_load.for_each_cell([this, &viewer](Vector3i bpos) {
-							// Load or update block
-							view_mesh_block(bpos, viewer.state.requires_meshes, viewer.state.requires_collisions);
-						});
-					});
-				}
+			VoxelTerrainUpdateData::ViewerBoxChange change;
+			change.viewer_id = viewer.id;
+			change.prev_data_box = viewer.prev_state.data_box;
+			change.new_data_box = viewer.state.data_box;
+			change.prev_mesh_box = viewer.prev_state.mesh_box;
+			change.new_mesh_box = viewer.state.mesh_box;
+			change.prev_requires_meshes = viewer.prev_state.requires_meshes;
+			change.prev_requires_collisions = viewer.prev_state.requires_collisions;
+			change.requires_meshes = viewer.state.requires_meshes;
+			change.requires_collisions = viewer.state.requires_collisions;
+
+			// Could be a destroyed viewer
+			const bool viewer_exists = VoxelEngine::get_singleton().viewer_exists(viewer.id);
+
+			if (_multiplayer_synchronizer != nullptr && viewer_exists) {
+				change.network_peer_id = VoxelEngine::get_singleton().get_viewer_network_peer_id(viewer.id);
+			}
 
-				// Blocks that remained within range of the viewer may need some changes too if viewer flags were
-				// modified. This operates on a DISTINCT set of blocks than the one above.
-
-				if (viewer.state.requires_collisions != viewer.prev_state.requires_collisions) {
-					const Box3i box = new_mesh_box.clipped(prev_mesh_box);
-					if (viewer.state.requires_collisions) {
-						box.for_each_cell([this](Vector3i bpos) { //
-							view_mesh_block(bpos, false, true);
-						});
-
-					} else {
-						box.for_each_cell([this](Vector3i bpos) { //
-							unview_mesh_block(bpos, false, true);
-						});
-					}
-				}
+			change.require_notifications = notifications_enabled && viewer_exists &&
+					VoxelEngine::get_singleton().is_viewer_requiring_data_block_notifications(viewer.id);
 
-				if (viewer.state.requires_meshes != viewer.prev_state.requires_meshes) {
-					const Box3i box = new_mesh_box.clipped(prev_mesh_box);
-					if (viewer.state.requires_meshes) {
-						box.for_each_cell([this](Vector3i bpos) { //
-							view_mesh_block(bpos, true, false);
-						});
-
-					} else {
-						box.for_each_cell([this](Vector3i bpos) { //
-							unview_mesh_block(bpos, true, false);
-						});
-					}
-				}
-			}
+			update_data.changes.push_back(change);
 		}
 	}
 
-	_stats.time_detect_required_blocks = profiling_clock.restart();
-
 	// We no longer need unpaired viewers.
 	for (size_t i = 0; i < unpaired_viewer_indexes.size(); ++i) {
 		// Iterating backward so indexes of paired viewers that need removal will not change because of the removal
@@ -1416,6 +1503,23 @@ void VoxelTerrain::process_viewers() {
 		_paired_viewers.pop_back();
 	}
 
+	if (update_data.changes.size() > 0) {
+		update_data.task_is_complete = false;
+
+		if (_threaded_update_enabled) {
+			update_data.task_claimed = false;
+			// Results will be applied in a later call, once the task is complete
+			VoxelEngine::get_singleton().push_async_task(ZN_NEW(VoxelTerrainUpdateTask(_data, _update_data)));
+
+		} else {
+			update_data.task_claimed = true;
+			VoxelTerrainUpdateTask::run_update(*_data, update_data);
+			apply_update_results();
+		}
+	}
+
+	profiling_clock.restart();
+
 	// It's possible the user didn't set a stream yet, or it is turned off
 	if (can_load_blocks) {
 		send_data_load_requests();
@@ -1427,111 +1531,149 @@ void VoxelTerrain::process_viewers() {
 	_stats.time_request_blocks_to_load = profiling_clock.restart();
 }
 
-void VoxelTerrain::process_viewer_data_box_change(
-		ViewerID viewer_id,
-		Box3i prev_data_box,
-		Box3i new_data_box,
-		bool can_load_blocks
-) {
+void VoxelTerrain::finish_update_task() {
 	ZN_PROFILE_SCOPE();
-	ZN_ASSERT_RETURN(prev_data_box != new_data_box);
-
-	static thread_local StdVector<Vector3i> tls_missing_blocks;
-	static thread_local StdVector<Vector3i> tls_found_blocks_positions;
+	VoxelTerrainUpdateData &update_data = *_update_data;
 
-	Ref<VoxelGenerator> generator = get_generator();
-	if (generator.is_valid()) {
-		generator->process_viewer_diff(viewer_id, new_data_box, prev_data_box);
+	if (!update_data.task_is_complete) {
+		if (update_data.try_claim()) {
+			// The task did not start yet, run the update here instead of waiting for a thread to pick it up
+			VoxelTerrainUpdateTask::run_update(*_data, update_data);
+		} else {
+			// The task is running. It might not have locked the mutex yet, hence the loop.
+			while (!update_data.task_is_complete) {
+				update_data.wait_for_end_of_task();
+			}
+		}
 	}
 
-	// Unview blocks that just fell out of range
-	//
-	// TODO Any reason to unview old blocks before viewing new blocks?
-	// Because if a viewer is removed and another is added, it will reload the whole area even if their box is the same.
-	{
-		const bool may_save =
-				get_stream().is_valid() && (!Engine::get_singleton()->is_editor_hint() || _run_stream_in_editor);
+	apply_update_results();
+}
 
-		tls_missing_blocks.clear();
-		tls_found_blocks_positions.clear();
+void VoxelTerrain::apply_update_results() {
+	ZN_PROFILE_SCOPE();
 
-		const unsigned int to_save_index0 = _blocks_to_save.size();
+	VoxelTerrainUpdateData &update_data = *_update_data;
+	CRASH_COND(update_data.task_is_complete == false);
 
-		// Decrement refcounts from loaded blocks, and unload them
-		prev_data_box.difference(new_data_box, [this, may_save](Box3i out_of_range_box) {
-			// ZN_PRINT_VERBOSE(format("Unview data box {}", out_of_range_box));
-			_data->unview_area(
-					out_of_range_box,
-					0,
-					&tls_found_blocks_positions,
-					&tls_missing_blocks,
-					may_save ? &_blocks_to_save : nullptr
-			);
-		});
+	if (!update_data.has_results) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < update_data.changes.size(); ++i) {
+		VoxelTerrainUpdateData::ViewerBoxChangeResult &result = update_data.results[i];
+		apply_viewer_box_change_result(update_data.changes[i], result, update_data.can_load_blocks);
+		// Make sure to clear this because it holds refcounted stuff
+		result.clear();
+	}
 
-		// Temporarily store unloaded blocks in a map until saving completes
-		for (unsigned int i = to_save_index0; i < _blocks_to_save.size(); ++i) {
-			const VoxelData::BlockToSave &bts = _blocks_to_save[i];
-			_unloaded_saving_blocks[bts.position] = bts.voxels;
+	update_data.changes.clear();
+	update_data.has_results = false;
+	_stats.time_detect_required_blocks = update_data.time_detect_required_blocks;
+}
+
+void VoxelTerrain::apply_viewer_box_change_result(
+		const VoxelTerrainUpdateData::ViewerBoxChange &change,
+		VoxelTerrainUpdateData::ViewerBoxChangeResult &result,
+		bool can_load_blocks
+) {
+	ZN_PROFILE_SCOPE();
+
+	if (change.prev_data_box != change.new_data_box) {
+		Ref<VoxelGenerator> generator = get_generator();
+		if (generator.is_valid()) {
+			generator->process_viewer_diff(change.viewer_id, change.new_data_box, change.prev_data_box);
 		}
 
-		// Remove loading blocks (those were loaded and had their refcount reach zero)
-		for (const Vector3i bpos : tls_found_blocks_positions) {
-			emit_data_block_unloaded(bpos);
-			// TODO If they were loaded, why would they be in loading blocks?
-			// Probably in case we move so fast that blocks haven't even finished loading
-			_loading_blocks.erase(bpos);
+		if (change.network_peer_id != -1 && _multiplayer_synchronizer != nullptr) {
+			change.prev_data_box.difference(change.new_data_box, [this, &change](Box3i out_of_range_box) {
+				_multiplayer_synchronizer->on_peer_area_exited(change.network_peer_id, out_of_range_box);
+			});
 		}
+	}
 
-		// Remove refcount from loading blocks, and cancel loading if it reaches zero
-		for (const Vector3i bpos : tls_missing_blocks) {
-			auto loading_block_it = _loading_blocks.find(bpos);
-			if (loading_block_it == _loading_blocks.end()) {
+	// Blocks that got unviewed
+
+	// Temporarily store unloaded blocks in a map until saving completes
+	for (const VoxelData::BlockToSave &bts : result.blocks_to_save) {
+		_unloaded_saving_blocks[bts.position] = bts.voxels;
+		_blocks_to_save.push_back(bts);
+	}
+
+	// Remove loading blocks (those were loaded and had their refcount reach zero)
+	for (const Vector3i bpos : result.unloaded_blocks) {
+		emit_data_block_unloaded(bpos);
+		// TODO If they were loaded, why would they be in loading blocks?
+		// Probably in case we move so fast that blocks haven't even finished loading
+		_loading_blocks.erase(bpos);
+	}
+
+	// Remove refcount from loading blocks, and cancel loading if it reaches zero
+	for (const Vector3i bpos : result.unviewed_missing_blocks) {
+		auto loading_block_it = _loading_blocks.find(bpos);
+		if (loading_block_it == _loading_blocks.end()) {
+			if (_data->has_block(bpos, 0)) {
+				// The block finished loading after the update task found it missing, so it was added with our
+				// refcount included. Remove it now.
+				StdVector<Vector3i> removed_blocks;
+				const size_t to_save_index0 = _blocks_to_save.size();
+				_data->unview_area(
+						Box3i(bpos, Vector3i(1, 1, 1)),
+						0,
+						&removed_blocks,
+						nullptr,
+						_update_data->may_save ? &_blocks_to_save : nullptr
+				);
+				for (size_t i = to_save_index0; i < _blocks_to_save.size(); ++i) {
+					const VoxelData::BlockToSave &bts = _blocks_to_save[i];
+					_unloaded_saving_blocks[bts.position] = bts.voxels;
+				}
+				for (const Vector3i removed_bpos : removed_blocks) {
+					emit_data_block_unloaded(removed_bpos);
+				}
+			} else {
 				ZN_PRINT_VERBOSE("Request to unview a loading block that was never requested");
 				// Not expected, but fine I guess
-				return;
 			}
+			continue;
+		}
 
-			LoadingBlock &loading_block = loading_block_it->second;
-			loading_block.viewers.remove();
+		LoadingBlock &loading_block = loading_block_it->second;
+		loading_block.viewers.remove();
 
-			if (loading_block.viewers.get() == 0) {
-				// No longer want to load it
-				_loading_blocks.erase(loading_block_it);
+		if (loading_block.viewers.get() == 0) {
+			// No longer want to load it
+			_loading_blocks.erase(loading_block_it);
 
-				// TODO Do we really need that vector after all?
-				for (size_t i = 0; i < _blocks_pending_load.size(); ++i) {
-					if (_blocks_pending_load[i] == bpos) {
-						_blocks_pending_load[i] = _blocks_pending_load.back();
-						_blocks_pending_load.pop_back();
-						break;
-					}
+			// TODO Do we really need that vector after all?
+			for (size_t i = 0; i < _blocks_pending_load.size(); ++i) {
+				if (_blocks_pending_load[i] == bpos) {
+					_blocks_pending_load[i] = _blocks_pending_load.back();
+					_blocks_pending_load.pop_back();
+					break;
 				}
 			}
 		}
 	}
 
-	// View blocks coming into range
-	if (can_load_blocks) {
-		const bool require_notifications =
-				(_block_enter_notification_enabled ||
-				 (_multiplayer_synchronizer != nullptr && _multiplayer_synchronizer->is_server())) &&
-				VoxelEngine::get_singleton().viewer_exists(viewer_id) && // Could be a destroyed viewer
-				VoxelEngine::get_singleton().is_viewer_requiring_data_block_notifications(viewer_id);
-
-		static thread_local StdVector<VoxelDataBlock> tls_found_blocks;
-
-		tls_missing_blocks.clear();
-		tls_found_blocks.clear();
-		tls_found_blocks_positions.clear();
-
-		new_data_box.difference(prev_data_box, [this](Box3i box_to_load) {
-			// ZN_PRINT_VERBOSE(format("View data box {}", box_to_load));
-			_data->view_area(box_to_load, 0, &tls_missing_blocks, &tls_found_blocks_positions, &tls_found_blocks);
-		});
+	// Blocks that got viewed
 
+	if (can_load_blocks) {
 		// Schedule loading of missing blocks
-		for (const Vector3i missing_bpos : tls_missing_blocks) {
+		for (const Vector3i missing_bpos : result.viewed_missing_blocks) {
+			if (_data->has_block(missing_bpos, 0)) {
+				// The block finished loading after the update task found it missing, so our refcount is not included
+				// yet
+				_data->view_area(
+						Box3i(missing_bpos, Vector3i(1, 1, 1)),
+						0,
+						nullptr,
+						change.require_notifications ? &result.viewed_found_blocks_positions : nullptr,
+						change.require_notifications ? &result.viewed_found_blocks : nullptr
+				);
+				continue;
+			}
+
 			auto loading_block_it = _loading_blocks.find(missing_bpos);
 
 			if (loading_block_it == _loading_blocks.end()) {
@@ -1539,8 +1681,8 @@ void VoxelTerrain::process_viewer_data_box_change(
 				LoadingBlock new_loading_block;
 				new_loading_block.viewers.add();
 
-				if (require_notifications) {
-					new_loading_block.viewers_to_notify.push_back(viewer_id);
+				if (change.require_notifications) {
+					new_loading_block.viewers_to_notify.push_back(change.viewer_id);
 				}
 
 				_loading_blocks.insert({ missing_bpos, new_loading_block });
@@ -1551,28 +1693,34 @@ void VoxelTerrain::process_viewer_data_box_change(
 				LoadingBlock &loading_block = loading_block_it->second;
 				loading_block.viewers.add();
 
-				if (require_notifications) {
-					loading_block.viewers_to_notify.push_back(viewer_id);
+				if (change.require_notifications) {
+					loading_block.viewers_to_notify.push_back(change.viewer_id);
 				}
 			}
 		}
 
-		if (require_notifications) {
+		if (change.require_notifications) {
 			// Notifications for blocks that were already loaded
-			for (unsigned int i = 0; i < tls_found_blocks.size(); ++i) {
-				const Vector3i bpos = tls_found_blocks_positions[i];
-				const VoxelDataBlock &block = tls_found_blocks[i];
-				notify_data_block_enter(block, bpos, viewer_id);
+			for (unsigned int i = 0; i < result.viewed_found_blocks.size(); ++i) {
+				const Vector3i bpos = result.viewed_found_blocks_positions[i];
+				const VoxelDataBlock &block = result.viewed_found_blocks[i];
+				notify_data_block_enter(block, bpos, change.viewer_id);
 			}
 		}
 
-		// Make sure to clear this because it holds refcounted stuff. If we don't, it could crash on exit because the
-		// voxel engine deinitializes its stuff before thread_locals get destroyed
-		tls_found_blocks.clear();
-
 		// TODO viewers with varying flags during the game is not supported at the moment.
 		// They have to be re-created, which may cause world re-load...
 	}
+
+	// Mesh blocks
+
+	for (const VoxelTerrainUpdateData::MeshBlockViewChange &mc : result.mesh_block_changes) {
+		if (mc.view) {
+			view_mesh_block(mc.position, mc.mesh, mc.collision);
+		} else {
+			unview_mesh_block(mc.position, mc.mesh, mc.collision);
+		}
+	}
 }
 
 void VoxelTerrain::apply_data_block_response(VoxelEngine::BlockDataOutput &ob) {
@@ -1717,6 +1865,10 @@ bool VoxelTerrain::try_set_block_data(Vector3i position, std::shared_ptr<VoxelBu
 					.format(varray(expected_block_size, voxel_data->get_size()))
 	);
 
+	// Viewer boxes may already include changes the update task is still processing. Once applied, those would view
+	// the block again, so they have to be applied before counting.
+	finish_update_task();
+
 	// Setup viewers count intersecting with this block
 	RefCount refcount;
 	for (unsigned int i = 0; i < _paired_viewers.size(); ++i) {
@@ -1748,6 +1900,9 @@ bool VoxelTerrain::try_set_block_data(Vector3i position, std::shared_ptr<VoxelBu
 		existing_block.set_edited(incoming_block.is_edited());
 	});
 
+	_lighting.mark_block_loaded(position, get_data_block_size());
+	invalidate_path_finders(Box3i(position * get_data_block_size(), Vector3iUtil::create(get_data_block_size())));
+
 	// The block itself might not be suitable for meshing yet, but blocks surrounding it might be now
 	try_schedule_mesh_update_from_data(
 			Box3i(_data->block_to_voxel(position), Vector3iUtil::create(get_data_block_size()))
@@ -1807,6 +1962,7 @@ void VoxelTerrain::process_meshing() {
 		task->lod_index = 0;
 		task->meshing_dependency = _meshing_dependency;
 		task->collision_hint = _generate_collisions;
+		task->collision_detail = get_collision_detail();
 		task->data = _data;
 
 		// This iteration order is specifically chosen to match VoxelEngine and threaded access
@@ -1895,6 +2051,9 @@ void VoxelTerrain::apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob) {
 				ob.surfaces.mesh_flags,
 				material_indices
 		);
+		if (mesh.is_valid()) {
+			_mesher->attach_output_resources(**mesh, ob.surfaces);
+		}
 	}
 	if (mesh.is_valid()) {
 		const unsigned int surface_count = mesh->get_surface_count();
@@ -1930,7 +2089,13 @@ void VoxelTerrain::apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob) {
 
 	const bool gen_collisions = _generate_collisions && block->collision_viewers.get() > 0;
 	if (gen_collisions) {
-		Ref<Shape3D> collision_shape = make_collision_shape_from_mesher_output(ob.surfaces, **_mesher);
+		Ref<Shape3D> collision_shape;
+		if (ob.has_collision_shape) {
+			collision_shape = ob.collision_shape;
+		} else {
+			// The task was not asked to build it, which can happen if settings changed while it was running
+			collision_shape = make_collision_shape_from_mesher_output(ob.surfaces, **_mesher);
+		}
 		const bool debug_collisions = is_inside_tree() ? get_tree()->is_debugging_collisions_hint() : false;
 		block->set_collision_shape(collision_shape, debug_collisions, this, _collision_margin);
 
@@ -1997,6 +2162,9 @@ void VoxelTerrain::set_bounds(Box3i box) {
 	// Round to block size
 	bounds_in_voxels = bounds_in_voxels.snapped(get_data_block_size());
 
+	// The update task clips view areas to bounds
+	finish_update_task();
+
 	_data->set_bounds(bounds_in_voxels);
 
 	const unsigned int largest_dimension =
@@ -2265,6 +2433,9 @@ void VoxelTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_generator_use_gpu", "enable"), &Self::set_generator_use_gpu);
 	ClassDB::bind_method(D_METHOD("get_generator_use_gpu"), &Self::get_generator_use_gpu);
 
+	ClassDB::bind_method(D_METHOD("set_threaded_update_enabled", "enabled"), &Self::set_threaded_update_enabled);
+	ClassDB::bind_method(D_METHOD("is_threaded_update_enabled"), &Self::is_threaded_update_enabled);
+
 	// TODO Rename `_voxel_bounds`
 	ClassDB::bind_method(D_METHOD("set_bounds", "bounds"), &Self::_b_set_bounds);
 	ClassDB::bind_method(D_METHOD("get_bounds"), &Self::_b_get_bounds);
@@ -2357,6 +2528,11 @@ void VoxelTerrain::_bind_methods() {
 	);
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "mesh_block_size"), "set_mesh_block_size", "get_mesh_block_size");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_gpu_generation"), "set_generator_use_gpu", "get_generator_use_gpu");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "threaded_update_enabled"),
+			"set_threaded_update_enabled",
+			"is_threaded_update_enabled"
+	);
 
 	ADD_GROUP("Debug Drawing", "debug_");
 
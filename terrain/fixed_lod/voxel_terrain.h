@@ -2,6 +2,8 @@
 #define VOXEL_TERRAIN_H
 
 #include "../../constants/voxel_constants.h"
+#include "../../edition/blocky_lighting.h"
+#include "../../edition/blocky_random_tick.h"
 #include "../../engine/meshing_dependency.h"
 #include "../../storage/voxel_data.h"
 #include "../../util/containers/std_unordered_map.h"
@@ -14,6 +16,7 @@
 #include "../voxel_node.h"
 #include "voxel_mesh_block_vt.h"
 #include "voxel_terrain_multiplayer_synchronizer.h"
+#include "voxel_terrain_update_task.h"
 
 #ifdef TOOLS_ENABLED
 #include "../../util/godot/debug_renderer.h"
@@ -29,6 +32,7 @@ class VoxelTool;
 class VoxelInstancer;
 class VoxelSaveCompletionTracker;
 class VoxelTerrainMultiplayerSynchronizer;
+class HierarchicalPathFinder;
 class BufferedTaskScheduler;
 
 // Infinite paged terrain made of voxel blocks all with the same level of detail.
@@ -98,6 +102,9 @@ public:
 	void set_generator_use_gpu(bool enabled);
 	bool get_generator_use_gpu() const;
 
+	void set_threaded_update_enabled(bool enabled);
+	bool is_threaded_update_enabled() const;
+
 	VoxelData &get_storage() const {
 		ZN_ASSERT(_data != nullptr);
 		return *_data;
@@ -164,6 +171,15 @@ public:
 	// Internal
 
 	void set_instancer(VoxelInstancer *instancer);
+
+	// Where random-tickable voxels are in loaded blocks. Kept up to date as blocks get edited, loaded or unloaded.
+	BlockyRandomTickIndex &get_random_tick_index() {
+		return _random_tick_index;
+	}
+
+	// Registers a path finder so its cache gets invalidated when voxels change. The terrain doesn't keep it alive.
+	void add_path_finder(std::shared_ptr<HierarchicalPathFinder> path_finder);
+
 	void get_meshed_block_positions(StdVector<Vector3i> &out_positions) const;
 	Array get_mesh_block_surface(Vector3i block_pos) const;
 
@@ -194,13 +210,17 @@ protected:
 private:
 	void process();
 	void process_viewers();
-	void process_viewer_data_box_change(
-			ViewerID viewer_id,
-			Box3i prev_data_box,
-			Box3i new_data_box,
+	void apply_update_results();
+	void apply_viewer_box_change_result(
+			const VoxelTerrainUpdateData::ViewerBoxChange &change,
+			VoxelTerrainUpdateData::ViewerBoxChangeResult &result,
 			bool can_load_blocks
 	);
+	// Waits for the threaded update to finish, and applies its results
+	void finish_update_task();
 	// void process_received_data_blocks();
+	void process_lighting();
+	void invalidate_path_finders(Box3i box_in_voxels);
 	void process_meshing();
 	void apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob);
 	void apply_data_block_response(VoxelEngine::BlockDataOutput &ob);
@@ -295,6 +315,9 @@ private:
 
 	StdVector<PairedViewer> _paired_viewers;
 
+	// State shared with the threaded part of the update
+	std::shared_ptr<VoxelTerrainUpdateData> _update_data;
+
 	// Voxel storage. Using a shared_ptr so threaded tasks can use it safely.
 	std::shared_ptr<VoxelData> _data;
 
@@ -353,11 +376,17 @@ private:
 	// If enabled, VoxelViewers will cause blocks to automatically load around them.
 	bool _automatic_loading_enabled = true;
 	bool _generator_use_gpu = false;
+	bool _threaded_update_enabled = false;
 
 	Ref<Material> _material_override;
 
 	zylann::godot::ObjectUniquePtr<VoxelDataBlockEnterInfo> _data_block_enter_info_obj;
 
+	BlockyRandomTickIndex _random_tick_index;
+	// Used when the mesher is a `VoxelMesherBlocky` with lighting enabled
+	BlockyLighting _lighting;
+	StdVector<std::weak_ptr<HierarchicalPathFinder>> _path_finders;
+
 	// References to external nodes.
 	VoxelInstancer *_instancer = nullptr;
 	VoxelTerrainMultiplayerSynchronizer *_multiplayer_synchronizer = nullptr;
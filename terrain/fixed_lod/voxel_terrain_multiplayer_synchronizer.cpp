@@ -1,6 +1,9 @@
 #include "voxel_terrain_multiplayer_synchronizer.h"
 #include "../../constants/voxel_string_names.h"
+#include "../../engine/voxel_engine.h"
 #include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_data.h"
+#include "../../streams/voxel_block_delta.h"
 #include "../../streams/voxel_block_serializer.h"
 #include "../../util/containers/container_funcs.h"
 #include "../../util/godot/classes/multiplayer_api.h"
@@ -8,6 +11,7 @@
 #include "../../util/godot/classes/scene_tree.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/io/serialization.h"
+#include "../../util/math/funcs.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "voxel_terrain.h"
@@ -26,7 +30,6 @@ VoxelTerrainMultiplayerSynchronizer::VoxelTerrainMultiplayerSynchronizer() {
 	config["channel"] = _rpc_channel;
 
 	rpc_config(VoxelStringNames::get_singleton()._rpc_receive_blocks, config);
-	rpc_config(VoxelStringNames::get_singleton()._rpc_receive_area, config);
 
 	set_process(true);
 }
@@ -44,35 +47,162 @@ bool VoxelTerrainMultiplayerSynchronizer::is_server() const {
 	return mp->is_server();
 }
 
-void VoxelTerrainMultiplayerSynchronizer::send_block(
-		int viewer_peer_id,
-		const VoxelDataBlock &data_block,
-		Vector3i bpos
-) {
-	ZN_PROFILE_SCOPE();
+namespace {
+
+enum BlockMessageType : uint8_t {
+	// The whole block
+	BLOCK_MESSAGE_FULL = 0,
+	// New values of an area of the block, replacing what the client has there
+	BLOCK_MESSAGE_DELTA = 1
+};
+
+// Beyond this size, the full block is sent instead of a delta. Deltas are roughly proportional to the number of
+// voxels in the edited area that differ from defaults, and are not compressed further, so big changes are better sent
+// with the compressed block format.
+const unsigned int MAX_DELTA_SIZE = 4096;
+
+// Deltas are encoded against voxels having default values and the same channel depths as `format`. This only
+// depends on the format of the terrain, so the server and clients obtain the same base without having to agree on
+// previous versions of blocks.
+void make_delta_base(const VoxelBuffer &format, Vector3i size, VoxelBuffer &base) {
+	base.create(size);
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		base.set_channel_depth(channel_index, format.get_channel_depth(channel_index));
+	}
+}
 
-	BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(data_block.get_voxels_const());
-	ZN_ASSERT_RETURN(result.success);
+PackedByteArray make_full_block_message(Vector3i bpos, const VoxelBuffer &voxels) {
+	BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxels);
+	ZN_ASSERT_RETURN_V(result.success, PackedByteArray());
+	ZN_ASSERT_RETURN_V(result.data.size() <= 65535, PackedByteArray());
 
 	PackedByteArray message_data;
-	message_data.resize(4 * sizeof(int16_t) + result.data.size());
+	message_data.resize(1 + 4 * sizeof(int16_t) + result.data.size());
 
 	ByteSpanWithPosition mw_span(Span<uint8_t>(message_data.ptrw(), message_data.size()), 0);
 	MemoryWriterExistingBuffer mw(mw_span, ENDIANNESS_LITTLE_ENDIAN);
 
+	mw.store_8(BLOCK_MESSAGE_FULL);
 	mw.store_16(bpos.x);
 	mw.store_16(bpos.y);
 	mw.store_16(bpos.z);
-	ZN_ASSERT_RETURN(result.data.size() <= 65535);
 	mw.store_16(result.data.size());
 	mw.store_buffer(to_span(result.data));
 
+	return message_data;
+}
+
+} // namespace
+
+// Serializes and compresses full blocks, so joining peers or teleporting viewers don't stall the main thread. Blocks
+// are read when the task runs, so edits done in the meantime may already be included, which is fine since deltas
+// sent after that replace areas with the same values.
+class VoxelTerrainMultiplayerSynchronizer::SerializeBlocksTask : public IThreadedTask {
+public:
+	StdVector<BlockToSerialize> blocks;
+	std::shared_ptr<VoxelData> data;
+
+	void run(ThreadedTaskContext &ctx) override {
+		ZN_PROFILE_SCOPE();
+		ZN_ASSERT_RETURN(data != nullptr);
+		const int block_size = data->get_block_size();
+		_results.resize(blocks.size());
+
+		for (unsigned int i = 0; i < blocks.size(); ++i) {
+			const Vector3i bpos = blocks[i].position;
+			{
+				SpatialLock3D::Read srlock(data->get_spatial_lock(0), BoxBounds3i::from_position(bpos));
+				std::shared_ptr<VoxelBuffer> voxels = data->try_get_block_voxels(bpos);
+				if (voxels != nullptr) {
+					_results[i] = make_full_block_message(bpos, *voxels);
+					continue;
+				}
+			}
+			// Voxels aren't cached, but can be obtained from the generator
+			VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+			voxels.create(Vector3iUtil::create(block_size));
+			data->copy(bpos * block_size, voxels, 0xff);
+			_results[i] = make_full_block_message(bpos, voxels);
+		}
+	}
+
+	void apply_result() override {
+		// Messages are only accessed on the main thread once shared with peers
+		for (unsigned int i = 0; i < blocks.size(); ++i) {
+			BlockMessage &message = *blocks[i].message;
+			message.data = _results[i];
+			message.ready = true;
+		}
+	}
+
+	const char *get_debug_name() const override {
+		return "SerializeBlockMessages";
+	}
+
+private:
+	StdVector<PackedByteArray> _results;
+};
+
+std::shared_ptr<VoxelTerrainMultiplayerSynchronizer::BlockMessage> VoxelTerrainMultiplayerSynchronizer::
+		get_or_create_full_block_message(Vector3i bpos, ReplicatedBlock &rb) {
+	if (rb.full_message == nullptr) {
+		rb.full_message = make_shared_instance<BlockMessage>();
+		_blocks_to_serialize.push_back(BlockToSerialize{ bpos, rb.full_message });
+	}
+	// Otherwise it was already requested for another peer
+	return rb.full_message;
+}
+
+void VoxelTerrainMultiplayerSynchronizer::send_block(
+		int viewer_peer_id,
+		const VoxelDataBlock &data_block,
+		Vector3i bpos
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(_terrain != nullptr);
+
+	std::shared_ptr<VoxelBuffer> voxels = data_block.get_voxels_shared();
+
+	auto rb_it = _replicated_blocks.find(bpos);
+	bool replaced = false;
+	if (rb_it == _replicated_blocks.end()) {
+		rb_it = _replicated_blocks.insert({ bpos, ReplicatedBlock() }).first;
+	} else {
+		// The terrain replaced voxels of the block since it was last sent. Edits are reported with `send_area`, so
+		// voxels modified in place don't need to be checked here.
+		replaced = rb_it->second.source.lock() != voxels;
+	}
+	ReplicatedBlock &rb = rb_it->second;
+
+	if (replaced) {
+		rb.full_message = nullptr;
+	}
+	rb.source = voxels;
+
+	std::shared_ptr<BlockMessage> message = get_or_create_full_block_message(bpos, rb);
+
 	// print_line(String("Server: send block {0}").format(varray(bpos)));
 
+	if (replaced) {
+		// Other peers having the previous voxels must get the new ones too
+		for (auto peer_it = _peers.begin(); peer_it != _peers.end(); ++peer_it) {
+			if (peer_it->first == viewer_peer_id) {
+				continue;
+			}
+			PeerState &other_peer = peer_it->second;
+			if (other_peer.blocks.find(bpos) != other_peer.blocks.end()) {
+				other_peer.deferred_block_messages.push_back(message);
+			}
+		}
+	}
+
+	PeerState &peer = _peers[viewer_peer_id];
+	peer.blocks.insert(bpos);
+
 	// rpc_id(viewer_peer_id, VoxelStringNames::get_singleton().receive_block, data);
 	// Instead of sending it right away, defer it until the terrain finished processing. Sending individual blocks with
 	// the RPC system is too slow.
-	_deferred_block_messages_per_peer[viewer_peer_id].push_back(DeferredBlockMessage{ message_data });
+	peer.deferred_block_messages.push_back(message);
 }
 
 // TODO Have a way to implement ghost edits?
@@ -85,34 +215,122 @@ void VoxelTerrainMultiplayerSynchronizer::send_area(Box3i voxel_box) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT_RETURN(_terrain != nullptr);
 
-	StdVector<ViewerID> viewers;
-	_terrain->get_viewers_in_area(viewers, voxel_box);
+	if (_replicated_blocks.size() == 0 || Vector3iUtil::get_volume(voxel_box.size) == 0) {
+		return;
+	}
+
+	VoxelData &data = _terrain->get_storage();
+	const int block_size = data.get_block_size();
 
 	// Not particularly efficient for single-voxel edits, but should scale ok with bigger boxes
 	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
 	voxels.create(voxel_box.size);
-	_terrain->get_storage().copy(voxel_box.position, voxels, 0xff);
+	data.copy(voxel_box.position, voxels, 0xff);
 
-	BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxels);
-	ZN_ASSERT_RETURN(result.success);
+	static thread_local StdVector<uint8_t> tls_delta;
+
+	voxel_box.downscaled(block_size).for_each_cell([this, &data, &voxels, voxel_box, block_size](Vector3i bpos) {
+		auto rb_it = _replicated_blocks.find(bpos);
+		if (rb_it == _replicated_blocks.end()) {
+			// Not sent to any peer
+			return;
+		}
+		ReplicatedBlock &rb = rb_it->second;
+
+		const Box3i block_voxel_box(bpos * block_size, Vector3iUtil::create(block_size));
+		const Box3i area = voxel_box.clipped(block_voxel_box);
+		const Box3i local_area(area.position - block_voxel_box.position, area.size);
+		const Vector3i voxels_origin = area.position - voxel_box.position;
+
+		// Deltas don't include metadata, so if some is involved, send the full block. Metadata removed by the edit
+		// doesn't matter, deltas clear metadata in their area.
+		bool has_metadata = false;
+		{
+			SpatialLock3D::Read srlock(data.get_spatial_lock(0), BoxBounds3i::from_position(bpos));
+			std::shared_ptr<VoxelBuffer> block_voxels = data.try_get_block_voxels(bpos);
+			if (block_voxels != nullptr) {
+				block_voxels->for_each_voxel_metadata_in_area(
+						local_area, [&has_metadata](Vector3i pos, const VoxelMetadata &meta) { has_metadata = true; }
+				);
+			}
+		}
 
-	PackedByteArray pba;
-	pba.resize(4 * sizeof(int32_t) + result.data.size());
+		// The cached full block is outdated
+		rb.full_message = nullptr;
 
-	ByteSpanWithPosition mw_span(Span<uint8_t>(pba.ptrw(), pba.size()), 0);
-	MemoryWriterExistingBuffer mw(mw_span, ENDIANNESS_LITTLE_ENDIAN);
+		StdVector<uint8_t> &delta = tls_delta;
+		delta.clear();
+		bool use_delta = false;
 
-	mw.store_32(voxel_box.position.x);
-	mw.store_32(voxel_box.position.y);
-	mw.store_32(voxel_box.position.z);
-	mw.store_32(result.data.size());
-	mw.store_buffer(to_span(result.data));
-	for (const ViewerID viewer_id : viewers) {
-		const int peer_id = VoxelEngine::get_singleton().get_viewer_network_peer_id(viewer_id);
-		// TODO Don't bother copying and serializing if no networked viewers are around?
-		if (peer_id != -1 && peer_id != MultiplayerPeer::TARGET_PEER_SERVER) {
-			rpc_id(peer_id, VoxelStringNames::get_singleton()._rpc_receive_area, pba);
+		if (!has_metadata) {
+			VoxelBuffer base(VoxelBuffer::ALLOCATOR_POOL);
+			make_delta_base(voxels, area.size, base);
+			if (!BlockDelta::encode(base, Vector3i(), voxels, voxels_origin, area.size, delta)) {
+				// The area only contains default values. An empty delta still resets the area on clients.
+				delta.clear();
+				delta.push_back(0);
+			}
+			use_delta = delta.size() <= MAX_DELTA_SIZE;
 		}
+
+		std::shared_ptr<BlockMessage> message;
+		if (use_delta) {
+			// The same message is sent to all peers having the block
+			message = make_shared_instance<BlockMessage>();
+			message->ready = true;
+			PackedByteArray &delta_data = message->data;
+			delta_data.resize(1 + 3 * sizeof(int16_t) + 6 * sizeof(uint8_t) + sizeof(uint16_t) + delta.size());
+
+			ByteSpanWithPosition mw_span(Span<uint8_t>(delta_data.ptrw(), delta_data.size()), 0);
+			MemoryWriterExistingBuffer mw(mw_span, ENDIANNESS_LITTLE_ENDIAN);
+
+			mw.store_8(BLOCK_MESSAGE_DELTA);
+			mw.store_16(bpos.x);
+			mw.store_16(bpos.y);
+			mw.store_16(bpos.z);
+			mw.store_8(local_area.position.x);
+			mw.store_8(local_area.position.y);
+			mw.store_8(local_area.position.z);
+			mw.store_8(local_area.size.x);
+			mw.store_8(local_area.size.y);
+			mw.store_8(local_area.size.z);
+			mw.store_16(delta.size());
+			mw.store_buffer(to_span(delta));
+		}
+
+		for (auto peer_it = _peers.begin(); peer_it != _peers.end(); ++peer_it) {
+			PeerState &peer = peer_it->second;
+			if (peer.blocks.find(bpos) == peer.blocks.end()) {
+				continue;
+			}
+			if (message == nullptr) {
+				message = get_or_create_full_block_message(bpos, rb);
+			}
+			peer.deferred_block_messages.push_back(message);
+		}
+	});
+}
+
+void VoxelTerrainMultiplayerSynchronizer::on_data_block_unloaded(Vector3i bpos) {
+	if (_replicated_blocks.erase(bpos) == 0) {
+		return;
+	}
+	for (auto it = _peers.begin(); it != _peers.end(); ++it) {
+		it->second.blocks.erase(bpos);
+	}
+}
+
+void VoxelTerrainMultiplayerSynchronizer::on_peer_area_exited(int peer_id, Box3i blocks_box) {
+	auto peer_it = _peers.find(peer_id);
+	if (peer_it == _peers.end()) {
+		return;
+	}
+	PeerState &peer = peer_it->second;
+	// The client unloads these blocks on its side, so next time they will have to be sent in full
+	blocks_box.for_each_cell([&peer](Vector3i bpos) { peer.blocks.erase(bpos); });
+
+	if (peer.blocks.size() == 0 && peer.deferred_block_messages.size() == 0) {
+		_peers.erase(peer_it);
 	}
 }
 
@@ -142,13 +360,61 @@ void VoxelTerrainMultiplayerSynchronizer::_notification(int p_what) {
 // 	}
 // }
 
+void VoxelTerrainMultiplayerSynchronizer::schedule_block_serialization() {
+	if (_blocks_to_serialize.size() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	// Batch blocks, a single one is too little work for a task
+	static const unsigned int BATCH_SIZE = 16;
+
+	static thread_local StdVector<IThreadedTask *> tls_tasks;
+	StdVector<IThreadedTask *> &tasks = tls_tasks;
+	tasks.clear();
+
+	for (unsigned int begin = 0; begin < _blocks_to_serialize.size(); begin += BATCH_SIZE) {
+		const unsigned int end = math::min(begin + BATCH_SIZE, static_cast<unsigned int>(_blocks_to_serialize.size()));
+		SerializeBlocksTask *task = ZN_NEW(SerializeBlocksTask);
+		task->data = _terrain->get_storage_shared();
+		task->blocks.assign(_blocks_to_serialize.begin() + begin, _blocks_to_serialize.begin() + end);
+		tasks.push_back(task);
+	}
+
+	VoxelEngine::get_singleton().push_async_tasks(to_span(tasks));
+	_blocks_to_serialize.clear();
+}
+
 void VoxelTerrainMultiplayerSynchronizer::process() {
 	ZN_PROFILE_SCOPE();
 
-	for (auto it = _deferred_block_messages_per_peer.begin(); it != _deferred_block_messages_per_peer.end(); ++it) {
-		StdVector<DeferredBlockMessage> &messages = it->second;
+	schedule_block_serialization();
+
+	for (auto it = _peers.begin(); it != _peers.end(); ++it) {
+		StdVector<std::shared_ptr<BlockMessage>> &messages = it->second.deferred_block_messages;
 
-		if (messages.size() == 0) {
+		// Take messages in order, until one isn't ready yet or the budget is exceeded
+		unsigned int message_count = 0;
+		unsigned int block_count = 0;
+		unsigned int size = 0;
+		for (; message_count < messages.size(); ++message_count) {
+			const BlockMessage &message = *messages[message_count];
+			if (!message.ready) {
+				break;
+			}
+			if (_max_block_bytes_per_frame > 0 && block_count > 0 &&
+				size + message.data.size() > _max_block_bytes_per_frame) {
+				break;
+			}
+			if (message.data.size() > 0) {
+				// Can be empty if serialization failed
+				size += message.data.size();
+				++block_count;
+			}
+		}
+
+		if (block_count == 0) {
+			messages.erase(messages.begin(), messages.begin() + message_count);
 			continue;
 		}
 
@@ -157,23 +423,19 @@ void VoxelTerrainMultiplayerSynchronizer::process() {
 		// integration. It calls flush() on every RPC and that takes a lot of time, and there is overhead caused by
 		// the high-level features...
 
-		unsigned int size = 0;
-		for (const DeferredBlockMessage &message : messages) {
-			size += message.data.size();
-		}
-
 		pba.resize(1 * sizeof(uint32_t) + size);
 
 		ByteSpanWithPosition mw_span(Span<uint8_t>(pba.ptrw(), pba.size()), 0);
 		MemoryWriterExistingBuffer mw(mw_span, ENDIANNESS_LITTLE_ENDIAN);
-		mw.store_32(messages.size());
+		mw.store_32(block_count);
 
-		for (const DeferredBlockMessage &message : messages) {
-			mw.store_buffer(Span<const uint8_t>(message.data.ptr(), message.data.size()));
+		for (unsigned int i = 0; i < message_count; ++i) {
+			const PackedByteArray &data = messages[i]->data;
+			mw.store_buffer(Span<const uint8_t>(data.ptr(), data.size()));
 		}
 		ZN_ASSERT(mw.data.size() == mw.data.pos);
 
-		messages.clear();
+		messages.erase(messages.begin(), messages.begin() + message_count);
 
 		const int peer_id = it->first;
 		ZN_PRINT_VERBOSE(format("Sending {} bytes of block data to peer {}", pba.size(), peer_id));
@@ -182,6 +444,14 @@ void VoxelTerrainMultiplayerSynchronizer::process() {
 	}
 }
 
+void VoxelTerrainMultiplayerSynchronizer::set_max_block_bytes_per_frame(int bytes) {
+	_max_block_bytes_per_frame = math::max(bytes, 0);
+}
+
+int VoxelTerrainMultiplayerSynchronizer::get_max_block_bytes_per_frame() const {
+	return _max_block_bytes_per_frame;
+}
+
 void VoxelTerrainMultiplayerSynchronizer::_b_receive_blocks(PackedByteArray message_data) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT_RETURN(_terrain != nullptr);
@@ -194,52 +464,78 @@ void VoxelTerrainMultiplayerSynchronizer::_b_receive_blocks(PackedByteArray mess
 	const unsigned int block_count = mr.get_32();
 
 	for (unsigned int i = 0; i < block_count; ++i) {
+		const uint8_t message_type = mr.get_8();
+
 		Vector3i bpos;
 		// This effectively limits volume size to 1,048,576. If really required, we could double this data to cover
 		// more.
 		bpos.x = int16_t(mr.get_16());
 		bpos.y = int16_t(mr.get_16());
 		bpos.z = int16_t(mr.get_16());
-		const int voxel_data_size = mr.get_16();
-		// print_line(String("Client: receive block {0} data {1}").format(varray(bpos, voxel_data_size)));
 
-		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
-		ZN_ASSERT_RETURN(BlockSerializer::decompress_and_deserialize(mr.data.sub(mr.pos, voxel_data_size), voxels));
-
-		mr.pos += voxel_data_size;
-
-		std::shared_ptr<VoxelBuffer> voxels_p = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
-		*voxels_p = std::move(voxels);
-
-		ZN_ASSERT_RETURN(_terrain != nullptr);
-		_terrain->try_set_block_data(bpos, voxels_p);
+		if (message_type == BLOCK_MESSAGE_FULL) {
+			const int voxel_data_size = mr.get_16();
+			ZN_ASSERT_RETURN(mr.pos + voxel_data_size <= mr.data.size());
+			// print_line(String("Client: receive block {0} data {1}").format(varray(bpos, voxel_data_size)));
+
+			VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+			ZN_ASSERT_RETURN(BlockSerializer::decompress_and_deserialize(mr.data.sub(mr.pos, voxel_data_size), voxels)
+			);
+
+			mr.pos += voxel_data_size;
+
+			std::shared_ptr<VoxelBuffer> voxels_p = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+			*voxels_p = std::move(voxels);
+
+			ZN_ASSERT_RETURN(_terrain != nullptr);
+			_terrain->try_set_block_data(bpos, voxels_p);
+
+		} else if (message_type == BLOCK_MESSAGE_DELTA) {
+			Vector3i local_pos;
+			local_pos.x = mr.get_8();
+			local_pos.y = mr.get_8();
+			local_pos.z = mr.get_8();
+			Vector3i size;
+			size.x = mr.get_8();
+			size.y = mr.get_8();
+			size.z = mr.get_8();
+			const int delta_size = mr.get_16();
+			ZN_ASSERT_RETURN(mr.pos + delta_size <= mr.data.size());
+
+			ZN_ASSERT_RETURN(_terrain != nullptr);
+			const int block_size = _terrain->get_data_block_size();
+			ZN_ASSERT_RETURN(Box3i(Vector3i(), Vector3iUtil::create(block_size)).contains(Box3i(local_pos, size)));
+			ZN_ASSERT_RETURN(Vector3iUtil::get_volume(size) > 0);
+
+			const Box3i voxel_box(bpos * block_size + local_pos, size);
+			VoxelData &data = _terrain->get_storage();
+
+			// Only used to get channel depths of the terrain
+			VoxelBuffer format(VoxelBuffer::ALLOCATOR_POOL);
+			format.create(Vector3i(1, 1, 1));
+			data.copy(voxel_box.position, format, 0xff);
+
+			VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+			make_delta_base(format, size, voxels);
+			ZN_ASSERT_RETURN(BlockDelta::apply(mr.data.sub(mr.pos, delta_size), voxels, Vector3i(), size));
+			mr.pos += delta_size;
+
+			data.paste(voxel_box.position, voxels, 0xff, false);
+			_terrain->post_edit_area(
+					voxel_box,
+					// Don't bother for now, update mesh regardless. If necessary we would have to add a flag with the
+					// message to tell it's not actually changing voxels (if it's metadata changes), but might not be
+					// worth it
+					true
+			);
+
+		} else {
+			ZN_PRINT_ERROR(format("Unknown block message type {}", message_type));
+			return;
+		}
 	}
 }
 
-void VoxelTerrainMultiplayerSynchronizer::_b_receive_area(PackedByteArray message_data) {
-	ZN_PROFILE_SCOPE();
-	ZN_ASSERT_RETURN(_terrain != nullptr);
-
-	MemoryReader mr(Span<const uint8_t>(message_data.ptr(), message_data.size()), ENDIANNESS_LITTLE_ENDIAN);
-
-	Vector3i pos;
-	pos.x = int32_t(mr.get_32());
-	pos.y = int32_t(mr.get_32());
-	pos.z = int32_t(mr.get_32());
-	const int voxel_data_size = mr.get_32();
-
-	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
-	ZN_ASSERT_RETURN(BlockSerializer::decompress_and_deserialize(mr.data.sub(mr.pos, voxel_data_size), voxels));
-
-	_terrain->get_storage().paste(pos, voxels, 0xff, false);
-	_terrain->post_edit_area(
-			Box3i(pos, voxels.get_size()),
-			// Don't bother for now, update mesh regardless. If necessary we would have to add a flag with the message
-			// to tell it's not actually changing voxels (if it's metadata changes), but might not be worth it
-			true
-	);
-}
-
 #ifdef TOOLS_ENABLED
 
 #if defined(ZN_GODOT)
@@ -285,7 +581,21 @@ void VoxelTerrainMultiplayerSynchronizer::_bind_methods() {
 	ClassDB::bind_method(
 			D_METHOD("_rpc_receive_blocks", "data"), &VoxelTerrainMultiplayerSynchronizer::_b_receive_blocks
 	);
-	ClassDB::bind_method(D_METHOD("_rpc_receive_area", "data"), &VoxelTerrainMultiplayerSynchronizer::_b_receive_area);
+
+	ClassDB::bind_method(
+			D_METHOD("set_max_block_bytes_per_frame", "bytes"),
+			&VoxelTerrainMultiplayerSynchronizer::set_max_block_bytes_per_frame
+	);
+	ClassDB::bind_method(
+			D_METHOD("get_max_block_bytes_per_frame"),
+			&VoxelTerrainMultiplayerSynchronizer::get_max_block_bytes_per_frame
+	);
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "max_block_bytes_per_frame", PROPERTY_HINT_RANGE, "0,16777216,1,or_greater"),
+			"set_max_block_bytes_per_frame",
+			"get_max_block_bytes_per_frame"
+	);
 }
 
 } // namespace zylann::voxel
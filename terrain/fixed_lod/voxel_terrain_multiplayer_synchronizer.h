@@ -3,9 +3,11 @@
 
 #include "../../storage/voxel_data_block.h"
 #include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/std_unordered_set.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/classes/node.h"
 #include "../../util/math/box3i.h"
+#include "../../util/memory/memory.h"
 
 #ifdef TOOLS_ENABLED
 #include "../../util/godot/core/version.h"
@@ -15,7 +17,12 @@ namespace zylann::voxel {
 
 class VoxelTerrain;
 
-// Implements multiplayer replication for `VoxelTerrain`
+// Implements multiplayer replication for `VoxelTerrain`.
+//
+// The server keeps track of which blocks every peer received. Blocks entering a peer's area are sent in full, and
+// edits are sent as deltas containing the new values of the edited area, so the amount of data depends on the size of
+// edits rather than the size of blocks. Deltas don't depend on what peers had before, so no copy of replicated voxels
+// is kept. Only compressed full blocks are cached, to be shared by peers receiving them.
 class VoxelTerrainMultiplayerSynchronizer : public Node {
 	GDCLASS(VoxelTerrainMultiplayerSynchronizer, Node)
 public:
@@ -26,6 +33,16 @@ public:
 	void send_block(int viewer_peer_id, const VoxelDataBlock &data_block, Vector3i bpos);
 	void send_area(Box3i voxel_box);
 
+	// Called on the server when a data block is unloaded, so replication state about it can be freed
+	void on_data_block_unloaded(Vector3i bpos);
+	// Called on the server when blocks are no longer in the area of a peer's viewer
+	void on_peer_area_exited(int peer_id, Box3i blocks_box);
+
+	// Limits how much block data is sent to each peer per frame, in bytes. Remaining data is sent in later frames.
+	// 0 means no limit.
+	void set_max_block_bytes_per_frame(int bytes);
+	int get_max_block_bytes_per_frame() const;
+
 #ifdef TOOLS_ENABLED
 #if defined(ZN_GODOT)
 	PackedStringArray get_configuration_warnings() const override;
@@ -39,20 +56,50 @@ private:
 	void _notification(int p_what);
 
 	void process();
+	void schedule_block_serialization();
 
 	void _b_receive_blocks(PackedByteArray message_data);
-	void _b_receive_area(PackedByteArray message_data);
 
 	static void _bind_methods();
 
 	VoxelTerrain *_terrain = nullptr;
 	int _rpc_channel = 0;
 
-	struct DeferredBlockMessage {
+	// Block data to send. Shared between all peers receiving the same thing.
+	struct BlockMessage {
 		PackedByteArray data;
+		// Full blocks are serialized by threaded tasks, so they can't be sent until done
+		bool ready = false;
+	};
+
+	struct BlockToSerialize {
+		Vector3i position;
+		std::shared_ptr<BlockMessage> message;
+	};
+
+	class SerializeBlocksTask;
+
+	struct ReplicatedBlock {
+		// Voxels of the terrain the block was sent from. If the terrain replaces them, peers get the block again.
+		std::weak_ptr<VoxelBuffer> source;
+		// Message containing the whole block as it currently is. Null if it wasn't requested since the last edit.
+		std::shared_ptr<BlockMessage> full_message;
 	};
 
-	StdUnorderedMap<int, StdVector<DeferredBlockMessage>> _deferred_block_messages_per_peer;
+	struct PeerState {
+		// Blocks the peer has received, or will receive with the messages below
+		StdUnorderedSet<Vector3i> blocks;
+		// Sent in order, so a message that isn't ready yet holds the next ones back
+		StdVector<std::shared_ptr<BlockMessage>> deferred_block_messages;
+	};
+
+	std::shared_ptr<BlockMessage> get_or_create_full_block_message(Vector3i bpos, ReplicatedBlock &rb);
+
+	StdUnorderedMap<Vector3i, ReplicatedBlock> _replicated_blocks;
+	StdUnorderedMap<int, PeerState> _peers;
+	// Serialization requests of the current frame, batched into threaded tasks
+	StdVector<BlockToSerialize> _blocks_to_serialize;
+	unsigned int _max_block_bytes_per_frame = 128 * 1024;
 };
 
 } // namespace zylann::voxel
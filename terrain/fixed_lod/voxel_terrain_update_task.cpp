@@ -0,0 +1,153 @@
+#include "voxel_terrain_update_task.h"
+#include "../../util/profiling.h"
+#include "../../util/profiling_clock.h"
+
+namespace zylann::voxel {
+
+namespace {
+
+void process_data_box_change(
+		VoxelData &data,
+		const VoxelTerrainUpdateData::ViewerBoxChange &change,
+		VoxelTerrainUpdateData::ViewerBoxChangeResult &result,
+		bool can_load_blocks,
+		bool may_save
+) {
+	ZN_PROFILE_SCOPE();
+
+	// Unview blocks that just fell out of range
+	//
+	// TODO Any reason to unview old blocks before viewing new blocks?
+	// Because if a viewer is removed and another is added, it will reload the whole area even if their box is the same.
+	change.prev_data_box.difference(change.new_data_box, [&data, &result, may_save](Box3i out_of_range_box) {
+		data.unview_area(
+				out_of_range_box,
+				0,
+				&result.unloaded_blocks,
+				&result.unviewed_missing_blocks,
+				may_save ? &result.blocks_to_save : nullptr
+		);
+	});
+
+	// View blocks coming into range
+	if (can_load_blocks) {
+		StdVector<VoxelDataBlock> *found_blocks = change.require_notifications ? &result.viewed_found_blocks : nullptr;
+		StdVector<Vector3i> *found_blocks_positions =
+				change.require_notifications ? &result.viewed_found_blocks_positions : nullptr;
+
+		change.new_data_box.difference(
+				change.prev_data_box,
+				[&data, &result, found_blocks, found_blocks_positions](Box3i box_to_load) {
+					data.view_area(box_to_load, 0, &result.viewed_missing_blocks, found_blocks_positions, found_blocks);
+				}
+		);
+	}
+}
+
+void process_mesh_box_change(
+		const VoxelTerrainUpdateData::ViewerBoxChange &change,
+		StdVector<VoxelTerrainUpdateData::MeshBlockViewChange> &mesh_block_changes
+) {
+	ZN_PROFILE_SCOPE();
+
+	typedef VoxelTerrainUpdateData::MeshBlockViewChange MeshBlockViewChange;
+
+	if (change.prev_mesh_box != change.new_mesh_box) {
+		// Unview blocks that just fell out of range
+		change.prev_mesh_box.difference(change.new_mesh_box, [&change, &mesh_block_changes](Box3i out_of_range_box) {
+			out_of_range_box.for_each_cell([&change, &mesh_block_changes](Vector3i bpos) {
+				mesh_block_changes.push_back(MeshBlockViewChange{
+						bpos, false, change.prev_requires_meshes, change.prev_requires_collisions });
+			});
+		});
+
+		// View blocks that just entered the range
+		change.new_mesh_box.difference(change.prev_mesh_box, [&change, &mesh_block_changes](Box3i box_to_load) {
+			box_to_load.for_each_cell([&change, &mesh_block_changes](Vector3i bpos) {
+				mesh_block_changes.push_back(
+						MeshBlockViewChange{ bpos, true, change.requires_meshes, change.requires_collisions }
+				);
+			});
+		});
+	}
+
+	// Blocks that remained within range of the viewer may need some changes too if viewer flags were
+	// modified. This operates on a DISTINCT set of blocks than the one above.
+
+	if (change.requires_collisions != change.prev_requires_collisions) {
+		const Box3i box = change.new_mesh_box.clipped(change.prev_mesh_box);
+		const bool view = change.requires_collisions;
+		box.for_each_cell([&mesh_block_changes, view](Vector3i bpos) { //
+			mesh_block_changes.push_back(MeshBlockViewChange{ bpos, view, false, true });
+		});
+	}
+
+	if (change.requires_meshes != change.prev_requires_meshes) {
+		const Box3i box = change.new_mesh_box.clipped(change.prev_mesh_box);
+		const bool view = change.requires_meshes;
+		box.for_each_cell([&mesh_block_changes, view](Vector3i bpos) { //
+			mesh_block_changes.push_back(MeshBlockViewChange{ bpos, view, true, false });
+		});
+	}
+}
+
+} // namespace
+
+void VoxelTerrainUpdateTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+
+#ifdef DEV_ENABLED
+	CRASH_COND(_update_data == nullptr);
+	CRASH_COND(_data == nullptr);
+#endif
+
+	VoxelTerrainUpdateData &update_data = *_update_data;
+
+	if (!update_data.try_claim()) {
+		// The main thread needed the results early and ran the update itself
+		return;
+	}
+
+	run_update(*_data, update_data);
+}
+
+void VoxelTerrainUpdateTask::run_update(VoxelData &data, VoxelTerrainUpdateData &update_data) {
+	ZN_PROFILE_SCOPE();
+
+	struct SetCompleteOnScopeExit {
+		std::atomic_bool &_complete;
+		SetCompleteOnScopeExit(std::atomic_bool &b) : _complete(b) {}
+		~SetCompleteOnScopeExit() {
+			_complete = true;
+		}
+	};
+
+	CRASH_COND_MSG(update_data.task_is_complete, "Expected only one update task to run on a given volume");
+	MutexLock mutex_lock(update_data.completion_mutex);
+	// Declared after the lock so completion is visible as soon as the lock is released
+	SetCompleteOnScopeExit scoped_complete(update_data.task_is_complete);
+
+	ProfilingClock profiling_clock;
+
+	// Results are expected to have been consumed before starting a new update
+	ZN_ASSERT(update_data.has_results == false);
+
+	update_data.results.resize(update_data.changes.size());
+
+	for (unsigned int i = 0; i < update_data.changes.size(); ++i) {
+		const VoxelTerrainUpdateData::ViewerBoxChange &change = update_data.changes[i];
+		VoxelTerrainUpdateData::ViewerBoxChangeResult &result = update_data.results[i];
+		result.clear();
+
+		if (change.prev_data_box != change.new_data_box) {
+			process_data_box_change(data, change, result, update_data.can_load_blocks, update_data.may_save);
+		}
+
+		process_mesh_box_change(change, result.mesh_block_changes);
+	}
+
+	update_data.has_results = true;
+	update_data.time_detect_required_blocks = profiling_clock.restart();
+}
+
+} // namespace zylann::voxel
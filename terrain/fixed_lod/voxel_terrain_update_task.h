@@ -0,0 +1,129 @@
+#ifndef VOXEL_TERRAIN_UPDATE_TASK_H
+#define VOXEL_TERRAIN_UPDATE_TASK_H
+
+#include "../../engine/ids.h"
+#include "../../storage/voxel_data.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/box3i.h"
+#include "../../util/tasks/threaded_task.h"
+#include "../../util/thread/mutex.h"
+
+#include <atomic>
+
+namespace zylann::voxel {
+
+// Inputs and outputs of the threaded part of the streaming logic of VoxelTerrain.
+// See `VoxelTerrainUpdateTask` for more info.
+struct VoxelTerrainUpdateData {
+	// How the view boxes of a paired viewer changed since the last update.
+	// Written by the main thread before the task starts.
+	struct ViewerBoxChange {
+		ViewerID viewer_id;
+		// In data block coordinates
+		Box3i prev_data_box;
+		Box3i new_data_box;
+		// In mesh block coordinates
+		Box3i prev_mesh_box;
+		Box3i new_mesh_box;
+		int network_peer_id = -1;
+		bool prev_requires_meshes = false;
+		bool prev_requires_collisions = false;
+		bool requires_meshes = false;
+		bool requires_collisions = false;
+		bool require_notifications = false;
+	};
+
+	struct MeshBlockViewChange {
+		Vector3i position;
+		bool view;
+		bool mesh;
+		bool collision;
+	};
+
+	// Finalized lists of actions resulting from a `ViewerBoxChange`. Data blocks have already been viewed or unviewed
+	// in `VoxelData`, what remains is bookkeeping that has to happen on the main thread.
+	// Only read by the main thread once the task is complete, so no locking is needed.
+	struct ViewerBoxChangeResult {
+		// Data blocks whose refcount reached zero, and were removed
+		StdVector<Vector3i> unloaded_blocks;
+		// Data blocks that went out of range but were not present, they are probably still loading
+		StdVector<Vector3i> unviewed_missing_blocks;
+		// Data blocks that came into range but are not present, they need to be loaded
+		StdVector<Vector3i> viewed_missing_blocks;
+		// Data blocks that came into range and were already loaded. Only filled if notifications are required.
+		StdVector<Vector3i> viewed_found_blocks_positions;
+		StdVector<VoxelDataBlock> viewed_found_blocks;
+		// Data blocks that were removed and need saving
+		StdVector<VoxelData::BlockToSave> blocks_to_save;
+		// Mesh blocks to view or unview, in the order they must be applied
+		StdVector<MeshBlockViewChange> mesh_block_changes;
+
+		void clear() {
+			unloaded_blocks.clear();
+			unviewed_missing_blocks.clear();
+			viewed_missing_blocks.clear();
+			viewed_found_blocks_positions.clear();
+			viewed_found_blocks.clear();
+			blocks_to_save.clear();
+			mesh_block_changes.clear();
+		}
+	};
+
+	StdVector<ViewerBoxChange> changes;
+	// One result per change
+	StdVector<ViewerBoxChangeResult> results;
+	bool can_load_blocks = false;
+	bool may_save = false;
+	// True when results have been produced and were not consumed yet by the main thread
+	bool has_results = false;
+	uint32_t time_detect_required_blocks = 0;
+
+	// Set to true when the update is finished
+	std::atomic_bool task_is_complete = { true };
+	// Set by whoever runs the update first. The main thread can run it itself if the task did not start yet, which
+	// avoids waiting for it to be picked up by a thread.
+	std::atomic_bool task_claimed = { true };
+	// Will be locked as long as the update is running.
+	BinaryMutex completion_mutex;
+
+	bool try_claim() {
+		bool expected = false;
+		return task_claimed.compare_exchange_strong(expected, true);
+	}
+
+	// After this call, no locking is necessary, as no other thread should be using the data. Only valid if the update
+	// was claimed.
+	void wait_for_end_of_task() {
+		MutexLock lock(completion_mutex);
+	}
+};
+
+// Runs the part of the update loop of VoxelTerrain that finds out which blocks enter or leave the range of viewers.
+// Data blocks are viewed and unviewed directly in `VoxelData`, and mesh block changes are listed, so the main thread
+// only has to apply them. There must be only one running at once per terrain.
+//
+// IMPORTANT: The work done by this task must not involve any call to Godot's servers or to scripts, directly or
+// indirectly. These are deferred to the main thread.
+//
+class VoxelTerrainUpdateTask : public IThreadedTask {
+public:
+	VoxelTerrainUpdateTask(std::shared_ptr<VoxelData> p_data, std::shared_ptr<VoxelTerrainUpdateData> p_update_data) :
+			_data(p_data), _update_data(p_update_data) {}
+
+	const char *get_debug_name() const override {
+		return "VoxelTerrainUpdate";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+
+	// Runs the update in the calling thread. It must have been claimed by the caller.
+	static void run_update(VoxelData &data, VoxelTerrainUpdateData &update_data);
+
+private:
+	std::shared_ptr<VoxelData> _data;
+	std::shared_ptr<VoxelTerrainUpdateData> _update_data;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_TERRAIN_UPDATE_TASK_H
@@ -158,7 +158,7 @@ VoxelLodTerrain::VoxelLodTerrain() {
 		self->apply_detail_texture_update(ob);
 	};
 
-	_volume_id = VoxelEngine::get_singleton().add_volume(callbacks);
+	_volume_id = VoxelEngine::get_singleton().add_volume(callbacks, _data);
 	// VoxelEngine::get_singleton().set_volume_octree_lod_distance(_volume_id, get_lod_distance());
 
 	// TODO Being able to set a LOD smaller than the stream is probably a bad idea,
@@ -364,6 +364,10 @@ void VoxelLodTerrain::_on_shadow_casting_changed() {
 	}
 }
 
+void VoxelLodTerrain::_on_collision_detail_changed() {
+	_update_data->settings.collision_detail = get_collision_detail();
+}
+
 void VoxelLodTerrain::_on_render_layers_mask_changed() {
 	const int mask = get_render_layers_mask();
 	for (unsigned int lod_index = 0; lod_index < _update_data->state.lods.size(); ++lod_index) {
@@ -940,6 +944,7 @@ bool VoxelLodTerrain::get_generate_collisions() const {
 void VoxelLodTerrain::set_collision_lod_count(int lod_count) {
 	ERR_FAIL_COND(lod_count < 0);
 	_collision_lod_count = static_cast<unsigned int>(math::min(lod_count, get_lod_count()));
+	_update_data->settings.collision_lod_count = _collision_lod_count;
 }
 
 int VoxelLodTerrain::get_collision_lod_count() const {
@@ -1840,6 +1845,9 @@ void VoxelLodTerrain::apply_mesh_update(VoxelEngine::BlockMeshOutput &ob) {
 					mesh_data.mesh_flags,
 					material_indices
 			);
+			if (mesh.is_valid()) {
+				_mesher->attach_output_resources(**mesh, mesh_data);
+			}
 		}
 		if (mesh.is_valid()) {
 			const unsigned int surface_count = mesh->get_surface_count();
@@ -1986,10 +1994,17 @@ void VoxelLodTerrain::apply_mesh_update(VoxelEngine::BlockMeshOutput &ob) {
 	if (has_collision && collision_expected) {
 		const uint64_t now = get_ticks_msec();
 
+		Ref<Shape3D> collision_shape;
+		if (ob.has_collision_shape) {
+			collision_shape = ob.collision_shape;
+		} else {
+			// The task was not asked to build it, which can happen if settings changed while it was running
+			ZN_ASSERT(_mesher.is_valid());
+			collision_shape = make_collision_shape_from_mesher_output(ob.surfaces, **_mesher);
+		}
+
 		if (_collision_update_delay == 0 ||
 			static_cast<int>(now - block->last_collider_update_time) > _collision_update_delay) {
-			ZN_ASSERT(_mesher.is_valid());
-			Ref<Shape3D> collision_shape = make_collision_shape_from_mesher_output(ob.surfaces, **_mesher);
 			const bool debug_collisions = is_inside_tree() ? get_tree()->is_debugging_collisions_hint() : false;
 			block->set_collision_shape(collision_shape, debug_collisions, this, _collision_margin);
 
@@ -1997,14 +2012,15 @@ void VoxelLodTerrain::apply_mesh_update(VoxelEngine::BlockMeshOutput &ob) {
 			block->set_collision_mask(_collision_mask);
 			block->set_collision_enabled(collision_active);
 			block->last_collider_update_time = now;
-			block->deferred_collider_data.reset();
+			block->deferred_collision_shape.unref();
+			block->has_deferred_collision_shape = false;
 
 		} else {
-			if (block->deferred_collider_data == nullptr) {
+			if (!block->has_deferred_collision_shape) {
 				_deferred_collision_updates_per_lod[ob.lod].push_back(ob.position);
-				block->deferred_collider_data = make_unique_instance<VoxelMesher::Output>();
+				block->has_deferred_collision_shape = true;
 			}
-			*block->deferred_collider_data = std::move(ob.surfaces);
+			block->deferred_collision_shape = collision_shape;
 		}
 	}
 
@@ -2227,7 +2243,7 @@ void VoxelLodTerrain::process_deferred_collision_updates(uint32_t timeout_msec)
 			const Vector3i block_pos = deferred_collision_updates[i];
 			VoxelMeshBlockVLT *block = mesh_map.get_block(block_pos);
 
-			if (block == nullptr || block->deferred_collider_data == nullptr) {
+			if (block == nullptr || !block->has_deferred_collision_shape) {
 				// Block was unloaded or no longer needs a collision update
 				unordered_remove(deferred_collision_updates, i);
 				--i;
@@ -2237,19 +2253,17 @@ void VoxelLodTerrain::process_deferred_collision_updates(uint32_t timeout_msec)
 			const uint64_t now = get_ticks_msec();
 
 			if (static_cast<int>(now - block->last_collider_update_time) > _collision_update_delay) {
-				Ref<Shape3D> collision_shape;
-				if (_mesher.is_valid()) {
-					collision_shape =
-							make_collision_shape_from_mesher_output(*block->deferred_collider_data, **_mesher);
-				}
-
 				block->set_collision_shape(
-						collision_shape, get_tree()->is_debugging_collisions_hint(), this, _collision_margin
+						block->deferred_collision_shape,
+						get_tree()->is_debugging_collisions_hint(),
+						this,
+						_collision_margin
 				);
 				block->set_collision_layer(_collision_layer);
 				block->set_collision_mask(_collision_mask);
 				block->last_collider_update_time = now;
-				block->deferred_collider_data.reset();
+				block->deferred_collision_shape.unref();
+				block->has_deferred_collision_shape = false;
 
 				unordered_remove(deferred_collision_updates, i);
 				--i;
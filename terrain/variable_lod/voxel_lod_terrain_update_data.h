@@ -74,6 +74,10 @@ struct VoxelLodTerrainUpdateData {
 		// Not really exposed for now, will wait for it to be really needed. It might never be.
 		bool cache_generated_blocks = false;
 		bool collision_enabled = true;
+		// How many LODs from LOD0 have collisions. 0 means all of them.
+		uint8_t collision_lod_count = 0;
+		// See `VoxelNode::CollisionDetail`
+		uint8_t collision_detail = 0;
 		bool detail_textures_use_gpu = false;
 		bool generator_use_gpu = false;
 		uint8_t detail_texture_generator_override_begin_lod_index = 0;
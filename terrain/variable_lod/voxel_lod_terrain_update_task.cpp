@@ -297,7 +297,9 @@ void send_mesh_requests( //
 			task->meshing_dependency = meshing_dependency;
 			task->data = data_ptr;
 			task->require_visual = mesh_to_update.require_visual;
-			task->collision_hint = settings.collision_enabled;
+			task->collision_hint = settings.collision_enabled &&
+					(settings.collision_lod_count == 0 || lod_index < settings.collision_lod_count);
+			task->collision_detail = settings.collision_detail;
 			task->detail_texture_settings = settings.detail_texture_settings;
 			task->detail_texture_generator_override = settings.detail_texture_generator_override;
 			task->detail_texture_generator_override_begin_lod_index =
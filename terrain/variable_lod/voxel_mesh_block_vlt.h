@@ -37,7 +37,9 @@ public:
 	uint8_t detail_texture_fallback_level = 0;
 
 	uint64_t last_collider_update_time = 0;
-	UniquePtr<VoxelMesher::Output> deferred_collider_data;
+	// Collision shape waiting for the collision update delay to pass. Can be null if the mesh has no triangles.
+	Ref<Shape3D> deferred_collision_shape;
+	bool has_deferred_collision_shape = false;
 
 	VoxelMeshBlockVLT(const Vector3i bpos, unsigned int size, unsigned int p_lod_index);
 	~VoxelMeshBlockVLT();
@@ -0,0 +1,1174 @@
+#include "voxel_hierarchical_path_finder.h"
+#include "../constants/voxel_string_names.h"
+#include "../engine/voxel_engine.h"
+#include "../storage/voxel_buffer.h"
+#include "../storage/voxel_data.h"
+#include "../terrain/fixed_lod/voxel_terrain.h"
+#include "../terrain/variable_lod/voxel_lod_terrain.h"
+#include "../util/containers/fixed_array.h"
+#include "../util/math/conv.h"
+#include "../util/math/funcs.h"
+#include "../util/profiling.h"
+#include "../util/thread/thread.h"
+#include <algorithm>
+#include <limits>
+
+namespace zylann::voxel {
+
+namespace {
+
+const float INFINITE_COST = std::numeric_limits<float>::infinity();
+const uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+// clang-format off
+const Vector3i g_directions_2d[8] = {
+	Vector3i(-1, 0, -1),
+	Vector3i(0, 0, -1),
+	Vector3i(1, 0, -1),
+	Vector3i(-1, 0, 0),
+	Vector3i(1, 0, 0),
+	Vector3i(-1, 0, 1),
+	Vector3i(0, 0, 1),
+	Vector3i(1, 0, 1),
+};
+
+// Indexed by `axis * 2 + (positive ? 1 : 0)`
+const Vector3i g_face_directions[6] = {
+	Vector3i(-1, 0, 0),
+	Vector3i(1, 0, 0),
+	Vector3i(0, -1, 0),
+	Vector3i(0, 1, 0),
+	Vector3i(0, 0, -1),
+	Vector3i(0, 0, 1),
+};
+// clang-format on
+
+const unsigned int FACE_DIRECTION_COUNT = 6;
+
+inline Vector3i get_cluster_size_vector() {
+	return Vector3iUtil::create(HierarchicalPathFinder::CLUSTER_SIZE);
+}
+
+inline uint16_t get_local_index(Vector3i rpos) {
+	return Vector3iUtil::get_zxy_index(rpos, get_cluster_size_vector());
+}
+
+inline Vector3i get_local_position(unsigned int local_index) {
+	return Vector3iUtil::from_zxy_index(local_index, get_cluster_size_vector());
+}
+
+inline float get_move_cost(Vector3i d) {
+	return (d.x != 0 && d.z != 0) ? float(Math_SQRT2) : 1.f;
+}
+
+} // namespace
+
+struct HierarchicalPathFinder::Cluster {
+	enum CellFlags : uint8_t {
+		FLAG_SOLID = 1,
+		// The agent fits in this cell
+		FLAG_CLEAR = 2,
+		// There is ground not too far below this cell
+		FLAG_GROUNDED = 4
+	};
+
+	struct Edge {
+		// Index of a portal of the same cluster, or local cell index in a neighbor cluster
+		uint16_t target;
+		// Direction of the neighbor cluster, or `INTERNAL`
+		uint8_t direction;
+		float cost;
+
+		static const uint8_t INTERNAL = 0xff;
+	};
+
+	Vector3i position;
+	Vector3i origin;
+	// Flags of voxels in and around the cluster, so movement rules can be evaluated on its borders
+	Box3i padded_box;
+	StdVector<uint8_t> flags;
+
+	// Local indices of cells where agents can enter or leave the cluster, sorted
+	StdVector<uint16_t> portal_cells;
+	// Edges of each portal are in the range [edge_starts[i], edge_starts[i + 1])
+	StdVector<uint32_t> edge_starts;
+	StdVector<Edge> edges;
+
+	inline uint8_t get_flags(Vector3i pos) const {
+		const Vector3i rpos = pos - padded_box.position;
+		if (rpos.x < 0 || rpos.y < 0 || rpos.z < 0 || rpos.x >= padded_box.size.x || rpos.y >= padded_box.size.y ||
+			rpos.z >= padded_box.size.z) {
+			// Considered solid
+			return FLAG_SOLID | FLAG_GROUNDED;
+		}
+		return flags[Vector3iUtil::get_zxy_index(rpos, padded_box.size)];
+	}
+
+	inline bool is_solid(Vector3i pos) const {
+		return (get_flags(pos) & FLAG_SOLID) != 0;
+	}
+
+	inline bool is_clear(Vector3i pos) const {
+		return (get_flags(pos) & FLAG_CLEAR) != 0;
+	}
+
+	inline bool is_grounded(Vector3i pos) const {
+		return (get_flags(pos) & FLAG_GROUNDED) != 0;
+	}
+
+	// Agents can only be in cells near the ground, and don't need portals in the air
+	inline bool is_reachable(Vector3i pos) const {
+		// Either on the ground or falling, or at the top of a jump
+		return is_clear(pos) && (is_grounded(pos) || is_solid(pos - Vector3i(0, 2, 0)));
+	}
+
+	inline bool contains(Vector3i pos) const {
+		const Vector3i rpos = pos - origin;
+		return rpos.x >= 0 && rpos.y >= 0 && rpos.z >= 0 && rpos.x < CLUSTER_SIZE && rpos.y < CLUSTER_SIZE &&
+				rpos.z < CLUSTER_SIZE;
+	}
+
+	uint32_t find_portal(uint16_t local_index) const {
+		auto it = std::lower_bound(portal_cells.begin(), portal_cells.end(), local_index);
+		if (it == portal_cells.end() || *it != local_index) {
+			return NO_INDEX;
+		}
+		return it - portal_cells.begin();
+	}
+
+	// Same rules as `AStarGrid3D`, for an agent 1 voxel wide.
+	bool can_move(Vector3i from, Vector3i to) const {
+		if (!is_clear(from) || !is_clear(to)) {
+			return false;
+		}
+		const Vector3i d = to - from;
+		const bool supported = is_solid(from - Vector3i(0, 1, 0));
+
+		if (d.y == 0) {
+			if (d.x != 0 && d.z != 0) {
+				// Can't cut corners
+				if (!is_clear(from + Vector3i(d.x, 0, 0)) || !is_clear(from + Vector3i(0, 0, d.z))) {
+					return false;
+				}
+			}
+			if (!supported && !is_solid(to - Vector3i(0, 1, 0))) {
+				// Can't fly
+				return false;
+			}
+			return is_grounded(to);
+
+		} else if (d.y > 0) {
+			// Jumping requires something to climb on
+			if (!supported) {
+				return false;
+			}
+			for (const Vector3i dir : g_directions_2d) {
+				if (is_solid(from + dir)) {
+					return true;
+				}
+			}
+			return false;
+
+		} else {
+			// Falling
+			return !supported;
+		}
+	}
+};
+
+namespace {
+
+// Shortest paths restricted to the cells of one cluster. Buffers are reused between searches without clearing them.
+class LocalSearch {
+public:
+	LocalSearch() {
+		_costs.resize(HierarchicalPathFinder::CLUSTER_VOLUME);
+		_came_from.resize(HierarchicalPathFinder::CLUSTER_VOLUME);
+		_visit_stamps.resize(HierarchicalPathFinder::CLUSTER_VOLUME, 0);
+		_closed_stamps.resize(HierarchicalPathFinder::CLUSTER_VOLUME, 0);
+	}
+
+	// Explores the cluster from `src` (or towards it if `reverse` is true), until `target` is reached or all cells
+	// have been visited. If `target` is given, the search is guided towards it. If `stop_cells` is given, the search
+	// stops once all these cells have been reached.
+	void run(
+			const HierarchicalPathFinder::Cluster &cluster,
+			uint16_t src,
+			bool reverse,
+			uint32_t target,
+			Span<const uint16_t> stop_cells
+	) {
+		++_stamp;
+		if (_stamp == 0) {
+			// Wrapped around, old stamps could be mistaken for current ones
+			std::fill(_visit_stamps.begin(), _visit_stamps.end(), 0);
+			std::fill(_closed_stamps.begin(), _closed_stamps.end(), 0);
+			_stamp = 1;
+		}
+
+		const Vector3i target_pos = target != NO_INDEX ? cluster.origin + get_local_position(target) : Vector3i();
+		unsigned int remaining_stop_cells = stop_cells.size();
+
+		_open_list.clear();
+		set_cost(src, 0.f, NO_INDEX);
+		push(src, evaluate_heuristic(cluster.origin + get_local_position(src), target, target_pos));
+
+		while (_open_list.size() > 0) {
+			std::pop_heap(_open_list.begin(), _open_list.end(), compare_open_items);
+			const OpenItem item = _open_list.back();
+			_open_list.pop_back();
+
+			if (_closed_stamps[item.cell] == _stamp) {
+				continue;
+			}
+			_closed_stamps[item.cell] = _stamp;
+
+			if (item.cell == target) {
+				return;
+			}
+			if (remaining_stop_cells > 0 && std::binary_search(stop_cells.begin(), stop_cells.end(), item.cell)) {
+				--remaining_stop_cells;
+				if (remaining_stop_cells == 0) {
+					return;
+				}
+			}
+
+			const Vector3i pos = cluster.origin + get_local_position(item.cell);
+			const float cost = _costs[item.cell];
+
+			for (unsigned int dir_index = 0; dir_index < 10; ++dir_index) {
+				Vector3i d;
+				if (dir_index < 8) {
+					d = g_directions_2d[dir_index];
+				} else {
+					d = Vector3i(0, dir_index == 8 ? 1 : -1, 0);
+				}
+
+				const Vector3i npos = pos + d;
+				if (!cluster.contains(npos)) {
+					continue;
+				}
+				if (reverse ? !cluster.can_move(npos, pos) : !cluster.can_move(pos, npos)) {
+					continue;
+				}
+
+				const uint16_t ncell = get_local_index(npos - cluster.origin);
+				if (_closed_stamps[ncell] == _stamp) {
+					continue;
+				}
+				const float ncost = cost + get_move_cost(d);
+				if (ncost < get_cost(ncell)) {
+					set_cost(ncell, ncost, item.cell);
+					push(ncell, ncost + evaluate_heuristic(npos, target, target_pos));
+				}
+			}
+		}
+	}
+
+	// Cost to go from the source to a cell, or from a cell to the source with reverse searches
+	inline float get_cost(uint16_t cell) const {
+		return _visit_stamps[cell] == _stamp ? _costs[cell] : INFINITE_COST;
+	}
+
+	// Gets cells from the source to `cell`, excluding the source. Only valid with forward searches.
+	void get_path(const HierarchicalPathFinder::Cluster &cluster, uint16_t cell, StdVector<Vector3i> &out_path) const {
+		const unsigned int begin = out_path.size();
+		uint32_t i = cell;
+		while (_came_from[i] != NO_INDEX) {
+			out_path.push_back(cluster.origin + get_local_position(i));
+			i = _came_from[i];
+		}
+		std::reverse(out_path.begin() + begin, out_path.end());
+	}
+
+private:
+	struct OpenItem {
+		float priority;
+		uint16_t cell;
+	};
+
+	static bool compare_open_items(const OpenItem &a, const OpenItem &b) {
+		// Lowest priority on top of the heap
+		return a.priority > b.priority;
+	}
+
+	static inline float evaluate_heuristic(Vector3i pos, uint32_t target, Vector3i target_pos) {
+		if (target == NO_INDEX) {
+			return 0.f;
+		}
+		return math::length(to_vec3f(target_pos - pos));
+	}
+
+	inline void set_cost(uint16_t cell, float cost, uint32_t came_from) {
+		_visit_stamps[cell] = _stamp;
+		_costs[cell] = cost;
+		_came_from[cell] = came_from;
+	}
+
+	inline void push(uint16_t cell, float priority) {
+		_open_list.push_back(OpenItem{ priority, cell });
+		std::push_heap(_open_list.begin(), _open_list.end(), compare_open_items);
+	}
+
+	StdVector<float> _costs;
+	StdVector<uint32_t> _came_from;
+	StdVector<uint32_t> _visit_stamps;
+	StdVector<uint32_t> _closed_stamps;
+	uint32_t _stamp = 0;
+	StdVector<OpenItem> _open_list;
+};
+
+struct Transition {
+	Vector3i src;
+	Vector3i dst;
+	float cost;
+};
+
+// Finds moves crossing the face between the cluster at `lower_origin` and the next one along `axis`, going towards
+// positive coordinates if `upward` is true, and keeps one per entrance. An entrance is a set of transitions whose
+// sources can all reach each other by moving along the face, so paths going through any of them can go through the
+// kept one instead. Having few portals keeps cluster graphs small, at the cost of slightly less optimal paths.
+//
+// Transitions are found in an order that only depends on their position, and using only voxels both clusters have
+// around them, so both clusters sharing the face find the same ones.
+void find_face_entrances(
+		const HierarchicalPathFinder::Cluster &cluster,
+		Vector3i lower_origin,
+		unsigned int axis,
+		bool upward,
+		StdVector<Transition> &out_transitions
+) {
+	const int cs = HierarchicalPathFinder::CLUSTER_SIZE;
+	const unsigned int axis_u = axis == Vector3i::AXIS_X ? Vector3i::AXIS_Y : Vector3i::AXIS_X;
+	const unsigned int axis_v = axis == Vector3i::AXIS_Z ? Vector3i::AXIS_Y : Vector3i::AXIS_Z;
+	// Horizontal moves can also be diagonal along the other horizontal axis
+	int side_axis = -1;
+	if (axis == Vector3i::AXIS_X) {
+		side_axis = Vector3i::AXIS_Z;
+	} else if (axis == Vector3i::AXIS_Z) {
+		side_axis = Vector3i::AXIS_X;
+	}
+
+	Vector3i forward;
+	forward[axis] = upward ? 1 : -1;
+
+	Vector3i source_plane_origin = lower_origin;
+	source_plane_origin[axis] += upward ? cs - 1 : cs;
+
+	Vector3i du;
+	du[axis_u] = 1;
+	Vector3i dv;
+	dv[axis_v] = 1;
+
+	// Union-find over cells of the source side of the face, connecting those that can move to each other
+	FixedArray<int16_t, HierarchicalPathFinder::CLUSTER_SIZE * HierarchicalPathFinder::CLUSTER_SIZE> parents;
+
+	struct L {
+		static int16_t find_root(Span<int16_t> parents, int16_t i) {
+			while (parents[i] != i) {
+				parents[i] = parents[parents[i]];
+				i = parents[i];
+			}
+			return i;
+		}
+		static void merge(Span<int16_t> parents, int16_t a, int16_t b) {
+			a = find_root(parents, a);
+			b = find_root(parents, b);
+			// Lowest index as root, to not depend on the order of merges
+			if (a < b) {
+				parents[b] = a;
+			} else if (b < a) {
+				parents[a] = b;
+			}
+		}
+	};
+
+	for (unsigned int i = 0; i < parents.size(); ++i) {
+		parents[i] = i;
+	}
+
+	for (int u = 0; u < cs; ++u) {
+		for (int v = 0; v < cs; ++v) {
+			const Vector3i pos = source_plane_origin + du * u + dv * v;
+			if (!cluster.is_reachable(pos)) {
+				continue;
+			}
+			const int16_t i = u * cs + v;
+			if (u + 1 < cs && cluster.can_move(pos, pos + du) && cluster.can_move(pos + du, pos)) {
+				L::merge(to_span(parents), i, i + cs);
+			}
+			if (v + 1 < cs && cluster.can_move(pos, pos + dv) && cluster.can_move(pos + dv, pos)) {
+				L::merge(to_span(parents), i, i + 1);
+			}
+		}
+	}
+
+	struct Entrance {
+		int sum_u = 0;
+		int sum_v = 0;
+		int count = 0;
+		int64_t best_score = std::numeric_limits<int64_t>::max();
+		Transition best_transition;
+	};
+	FixedArray<Entrance, HierarchicalPathFinder::CLUSTER_SIZE * HierarchicalPathFinder::CLUSTER_SIZE> entrances;
+
+	// Find transitions
+	StdVector<Transition> transitions;
+	StdVector<int16_t> transition_cells;
+
+	for (int u = 0; u < cs; ++u) {
+		for (int v = 0; v < cs; ++v) {
+			const Vector3i src = source_plane_origin + du * u + dv * v;
+			if (!cluster.is_reachable(src)) {
+				continue;
+			}
+
+			for (int side = -1; side <= 1; ++side) {
+				if (side != 0 && side_axis == -1) {
+					continue;
+				}
+				Vector3i dst = src + forward;
+				if (side != 0) {
+					dst[side_axis] += side;
+					const int rd = dst[side_axis] - lower_origin[side_axis];
+					if (rd < 0 || rd >= cs) {
+						// Crosses into a diagonal cluster, such moves are not part of the cluster graph
+						continue;
+					}
+				}
+				if (cluster.can_move(src, dst)) {
+					transitions.push_back(Transition{ src, dst, get_move_cost(dst - src) });
+					transition_cells.push_back(u * cs + v);
+				}
+			}
+		}
+	}
+
+	for (const int16_t cell : transition_cells) {
+		Entrance &e = entrances[L::find_root(to_span(parents), cell)];
+		e.sum_u += cell / cs;
+		e.sum_v += cell % cs;
+		++e.count;
+	}
+
+	// Keep the transition closest to the center of its entrance, preferring straight moves
+	for (unsigned int i = 0; i < transitions.size(); ++i) {
+		const Transition &t = transitions[i];
+		const int16_t cell = transition_cells[i];
+		Entrance &e = entrances[L::find_root(to_span(parents), cell)];
+		// Scaled by the count to stay in integers
+		const int64_t cu = int64_t(cell / cs) * e.count - e.sum_u;
+		const int64_t cv = int64_t(cell % cs) * e.count - e.sum_v;
+		const int64_t score = cu * cu + cv * cv;
+		if (score < e.best_score || (score == e.best_score && t.cost < e.best_transition.cost)) {
+			e.best_score = score;
+			e.best_transition = t;
+		}
+	}
+
+	for (const Entrance &e : entrances) {
+		if (e.count > 0) {
+			out_transitions.push_back(e.best_transition);
+		}
+	}
+}
+
+} // namespace
+
+HierarchicalPathFinder::HierarchicalPathFinder(std::shared_ptr<VoxelData> data, int agent_height, int max_fall_height) :
+		_data(data), _agent_height(math::max(agent_height, 1)), _max_fall_height(math::max(max_fall_height, 1)) {
+	ZN_ASSERT(_data != nullptr);
+}
+
+void HierarchicalPathFinder::set_max_searched_clusters(unsigned int count) {
+	_max_searched_clusters = math::max(count, 1u);
+}
+
+Box3i HierarchicalPathFinder::get_cluster_padded_box(Vector3i cluster_pos) const {
+	// Movement rules look at voxels above the agent (to check if it fits), below (to find ground) and around (to find
+	// something to climb on), including from cells just outside the cluster
+	const Vector3i min_pad(2, _max_fall_height + 2, 2);
+	const Vector3i max_pad(2, _agent_height + 1, 2);
+	const Vector3i origin = cluster_pos * CLUSTER_SIZE;
+	return Box3i::from_min_max(origin - min_pad, origin + get_cluster_size_vector() + max_pad);
+}
+
+std::shared_ptr<HierarchicalPathFinder::Cluster> HierarchicalPathFinder::build_cluster(Vector3i cluster_pos) const {
+	ZN_PROFILE_SCOPE();
+
+	std::shared_ptr<Cluster> cluster = make_shared_instance<Cluster>();
+	cluster->position = cluster_pos;
+	cluster->origin = cluster_pos * CLUSTER_SIZE;
+	cluster->padded_box = get_cluster_padded_box(cluster_pos);
+
+	const Vector3i padded_size = cluster->padded_box.size;
+
+	// Cache flags of voxels
+	{
+		ZN_PROFILE_SCOPE_NAMED("Caching voxels");
+
+		const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+		voxels.create(padded_size);
+		_data->copy(cluster->padded_box.position, voxels, 1 << channel);
+
+		cluster->flags.resize(Vector3iUtil::get_volume(padded_size), 0);
+		StdVector<uint8_t> &flags = cluster->flags;
+
+		if (voxels.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_UNIFORM) {
+			if (voxels.get_voxel(0, 0, 0, channel) != 0) {
+				std::fill(flags.begin(), flags.end(), Cluster::FLAG_SOLID);
+			}
+		} else {
+			for (int z = 0; z < padded_size.z; ++z) {
+				for (int x = 0; x < padded_size.x; ++x) {
+					for (int y = 0; y < padded_size.y; ++y) {
+						if (voxels.get_voxel(x, y, z, channel) != 0) {
+							flags[Vector3iUtil::get_zxy_index(Vector3i(x, y, z), padded_size)] = Cluster::FLAG_SOLID;
+						}
+					}
+				}
+			}
+		}
+
+		// Columns are contiguous in ZXY order
+		for (int z = 0; z < padded_size.z; ++z) {
+			for (int x = 0; x < padded_size.x; ++x) {
+				uint8_t *column = &flags[Vector3iUtil::get_zxy_index(Vector3i(x, 0, z), padded_size)];
+
+				// Voxels outside the padded box are considered solid
+				int last_solid_y = -1;
+				for (int y = 0; y < padded_size.y; ++y) {
+					if ((column[y] & Cluster::FLAG_SOLID) != 0) {
+						last_solid_y = y;
+					} else if (y - last_solid_y <= _max_fall_height) {
+						column[y] |= Cluster::FLAG_GROUNDED;
+					}
+				}
+
+				int free_height = 0;
+				for (int y = padded_size.y - 1; y >= 0; --y) {
+					if ((column[y] & Cluster::FLAG_SOLID) != 0) {
+						free_height = 0;
+					} else {
+						++free_height;
+						if (free_height >= _agent_height) {
+							column[y] |= Cluster::FLAG_CLEAR;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Find portals on faces of the cluster
+	struct Exit {
+		uint16_t cell;
+		uint8_t direction;
+		uint16_t target;
+		float cost;
+	};
+	StdVector<Exit> exits;
+	{
+		ZN_PROFILE_SCOPE_NAMED("Portals");
+
+		StdVector<Transition> entrance_transitions;
+
+		for (unsigned int direction = 0; direction < FACE_DIRECTION_COUNT; ++direction) {
+			const unsigned int axis = direction / 2;
+			const bool positive = (direction & 1) != 0;
+			const Vector3i neighbor_origin = cluster->origin + g_face_directions[direction] * CLUSTER_SIZE;
+			const Vector3i lower_origin = positive ? cluster->origin : neighbor_origin;
+
+			// Moves going out of the cluster, then moves going in
+			for (unsigned int pass = 0; pass < 2; ++pass) {
+				const bool outgoing = pass == 0;
+				const bool upward = positive == outgoing;
+
+				entrance_transitions.clear();
+				find_face_entrances(*cluster, lower_origin, axis, upward, entrance_transitions);
+
+				for (const Transition &t : entrance_transitions) {
+					if (outgoing) {
+						exits.push_back(Exit{ get_local_index(t.src - cluster->origin),
+											  uint8_t(direction),
+											  get_local_index(t.dst - neighbor_origin),
+											  t.cost });
+						cluster->portal_cells.push_back(get_local_index(t.src - cluster->origin));
+					} else {
+						cluster->portal_cells.push_back(get_local_index(t.dst - cluster->origin));
+					}
+				}
+			}
+		}
+
+		std::sort(cluster->portal_cells.begin(), cluster->portal_cells.end());
+		cluster->portal_cells.erase(
+				std::unique(cluster->portal_cells.begin(), cluster->portal_cells.end()), cluster->portal_cells.end()
+		);
+	}
+
+	// Connect portals
+	{
+		ZN_PROFILE_SCOPE_NAMED("Edges");
+
+		const unsigned int portal_count = cluster->portal_cells.size();
+		cluster->edge_starts.resize(portal_count + 1);
+
+		std::sort(exits.begin(), exits.end(), [](const Exit &a, const Exit &b) { return a.cell < b.cell; });
+		unsigned int exit_index = 0;
+
+		LocalSearch search;
+
+		for (unsigned int portal_index = 0; portal_index < portal_count; ++portal_index) {
+			const uint16_t cell = cluster->portal_cells[portal_index];
+			cluster->edge_starts[portal_index] = cluster->edges.size();
+
+			search.run(*cluster, cell, false, NO_INDEX, to_span(cluster->portal_cells));
+
+			for (unsigned int other_index = 0; other_index < portal_count; ++other_index) {
+				if (other_index == portal_index) {
+					continue;
+				}
+				const float cost = search.get_cost(cluster->portal_cells[other_index]);
+				if (cost != INFINITE_COST) {
+					cluster->edges.push_back(Cluster::Edge{ uint16_t(other_index), Cluster::Edge::INTERNAL, cost });
+				}
+			}
+
+			for (; exit_index < exits.size() && exits[exit_index].cell == cell; ++exit_index) {
+				const Exit &exit = exits[exit_index];
+				cluster->edges.push_back(Cluster::Edge{ exit.target, exit.direction, exit.cost });
+			}
+		}
+
+		cluster->edge_starts[portal_count] = cluster->edges.size();
+	}
+
+	return cluster;
+}
+
+std::shared_ptr<const HierarchicalPathFinder::Cluster> HierarchicalPathFinder::get_or_build_cluster(
+		Vector3i cluster_pos
+) const {
+	{
+		RWLockRead rlock(_clusters_lock);
+		auto it = _clusters.find(cluster_pos);
+		if (it != _clusters.end()) {
+			return it->second;
+		}
+	}
+
+	// Must be read before voxels are
+	const uint32_t invalidation_counter = _invalidation_counter;
+
+	std::shared_ptr<const Cluster> cluster = build_cluster(cluster_pos);
+
+	RWLockWrite wlock(_clusters_lock);
+	if (_invalidation_counter != invalidation_counter) {
+		// Voxels changed while the cluster was being built, it might be outdated. Still fine to use for the current
+		// query.
+		return cluster;
+	}
+	if (_clusters.size() >= MAX_CACHED_CLUSTERS) {
+		_clusters.clear();
+	}
+	// Another thread may have built the same cluster in the meantime
+	auto p = _clusters.insert({ cluster_pos, cluster });
+	return p.first->second;
+}
+
+void HierarchicalPathFinder::invalidate_area(Box3i voxel_box) {
+	// Clusters depend on voxels around them too
+	const Box3i padded_voxel_box = Box3i::from_min_max(
+			voxel_box.position - Vector3i(2, _agent_height + 1, 2),
+			voxel_box.position + voxel_box.size + Vector3i(2, _max_fall_height + 2, 2)
+	);
+	const Box3i cluster_box = padded_voxel_box.downscaled(CLUSTER_SIZE);
+
+	RWLockWrite wlock(_clusters_lock);
+	++_invalidation_counter;
+
+	if (Vector3iUtil::get_volume(cluster_box.size) > int64_t(_clusters.size())) {
+		for (auto it = _clusters.begin(); it != _clusters.end();) {
+			if (cluster_box.contains(it->first)) {
+				it = _clusters.erase(it);
+			} else {
+				++it;
+			}
+		}
+	} else {
+		cluster_box.for_each_cell([this](Vector3i cluster_pos) { _clusters.erase(cluster_pos); });
+	}
+}
+
+void HierarchicalPathFinder::clear_cache() {
+	RWLockWrite wlock(_clusters_lock);
+	++_invalidation_counter;
+	_clusters.clear();
+}
+
+unsigned int HierarchicalPathFinder::get_cached_cluster_count() const {
+	RWLockRead rlock(_clusters_lock);
+	return _clusters.size();
+}
+
+// State of a search over the graph of portals. Nodes are portals, identified by the base index of their cluster plus
+// their index within that cluster, so the search uses flat arrays instead of maps.
+struct HierarchicalPathFinder::QueryContext {
+	StdVector<std::shared_ptr<const Cluster>> clusters;
+	StdVector<uint32_t> cluster_base_indices;
+	StdUnorderedMap<Vector3i, uint32_t> cluster_indices;
+
+	// Per node
+	StdVector<float> costs;
+	StdVector<uint32_t> came_from;
+	StdVector<uint32_t> node_cluster_indices;
+	StdVector<uint8_t> closed;
+
+	struct OpenItem {
+		float priority;
+		uint32_t node;
+	};
+	StdVector<OpenItem> open_list;
+
+	uint32_t add_cluster(std::shared_ptr<const Cluster> cluster) {
+		const uint32_t cluster_index = clusters.size();
+		const uint32_t base = costs.size();
+		const unsigned int portal_count = cluster->portal_cells.size();
+
+		cluster_indices.insert({ cluster->position, cluster_index });
+		cluster_base_indices.push_back(base);
+		clusters.push_back(cluster);
+
+		costs.resize(base + portal_count, INFINITE_COST);
+		came_from.resize(base + portal_count, NO_INDEX);
+		node_cluster_indices.resize(base + portal_count, cluster_index);
+		closed.resize(base + portal_count, 0);
+
+		return cluster_index;
+	}
+
+	Vector3i get_node_position(uint32_t node) const {
+		const uint32_t cluster_index = node_cluster_indices[node];
+		const Cluster &cluster = *clusters[cluster_index];
+		const uint32_t portal_index = node - cluster_base_indices[cluster_index];
+		return cluster.origin + get_local_position(cluster.portal_cells[portal_index]);
+	}
+
+	static bool compare_open_items(const OpenItem &a, const OpenItem &b) {
+		return a.priority > b.priority;
+	}
+
+	void push(uint32_t node, float priority) {
+		open_list.push_back(OpenItem{ priority, node });
+		std::push_heap(open_list.begin(), open_list.end(), compare_open_items);
+	}
+};
+
+bool HierarchicalPathFinder::find_path(Vector3i from, Vector3i to, StdVector<Vector3i> &out_path) const {
+	ZN_PROFILE_SCOPE();
+
+	QueryContext ctx;
+
+	const Vector3i from_cluster_pos = from >> CLUSTER_SIZE_PO2;
+	const Vector3i to_cluster_pos = to >> CLUSTER_SIZE_PO2;
+
+	const uint32_t from_cluster_index = ctx.add_cluster(get_or_build_cluster(from_cluster_pos));
+	const uint32_t to_cluster_index = from_cluster_pos == to_cluster_pos
+			? from_cluster_index
+			: ctx.add_cluster(get_or_build_cluster(to_cluster_pos));
+
+	const Cluster &from_cluster = *ctx.clusters[from_cluster_index];
+	const Cluster &to_cluster = *ctx.clusters[to_cluster_index];
+
+	if (!from_cluster.is_clear(from) || !to_cluster.is_clear(to)) {
+		return false;
+	}
+
+	const uint16_t from_cell = get_local_index(from - from_cluster.origin);
+	const uint16_t to_cell = get_local_index(to - to_cluster.origin);
+
+	LocalSearch search;
+
+	// Costs from the start to portals of its cluster, and possibly to the destination directly
+	float best_cost = INFINITE_COST;
+	uint32_t best_last_node = NO_INDEX;
+	search.run(from_cluster, from_cell, false, NO_INDEX, Span<const uint16_t>());
+	if (from_cluster_index == to_cluster_index) {
+		best_cost = search.get_cost(to_cell);
+	}
+	for (unsigned int portal_index = 0; portal_index < from_cluster.portal_cells.size(); ++portal_index) {
+		const float cost = search.get_cost(from_cluster.portal_cells[portal_index]);
+		if (cost != INFINITE_COST) {
+			const uint32_t node = ctx.cluster_base_indices[from_cluster_index] + portal_index;
+			ctx.costs[node] = cost;
+			ctx.push(node, cost + math::length(to_vec3f(to - ctx.get_node_position(node))));
+		}
+	}
+
+	// Costs from portals of the destination cluster to the destination
+	StdVector<float> to_portal_costs;
+	search.run(to_cluster, to_cell, true, NO_INDEX, Span<const uint16_t>());
+	to_portal_costs.resize(to_cluster.portal_cells.size());
+	for (unsigned int portal_index = 0; portal_index < to_cluster.portal_cells.size(); ++portal_index) {
+		to_portal_costs[portal_index] = search.get_cost(to_cluster.portal_cells[portal_index]);
+	}
+
+	// Search the graph of portals
+	{
+		ZN_PROFILE_SCOPE_NAMED("Abstract search");
+
+		while (ctx.open_list.size() > 0) {
+			std::pop_heap(ctx.open_list.begin(), ctx.open_list.end(), QueryContext::compare_open_items);
+			const QueryContext::OpenItem item = ctx.open_list.back();
+			ctx.open_list.pop_back();
+
+			if (item.priority >= best_cost) {
+				// The heuristic never overestimates, nothing left can be better
+				break;
+			}
+			if (ctx.closed[item.node] != 0) {
+				continue;
+			}
+			ctx.closed[item.node] = 1;
+
+			const uint32_t cluster_index = ctx.node_cluster_indices[item.node];
+			// Not a reference to the shared pointer, `ctx.clusters` can grow while edges are followed
+			const Cluster &cluster = *ctx.clusters[cluster_index].get();
+			const uint32_t portal_index = item.node - ctx.cluster_base_indices[cluster_index];
+			const float cost = ctx.costs[item.node];
+
+			if (cluster_index == to_cluster_index) {
+				const float total_cost = cost + to_portal_costs[portal_index];
+				if (total_cost < best_cost) {
+					best_cost = total_cost;
+					best_last_node = item.node;
+				}
+			}
+
+			for (uint32_t edge_index = cluster.edge_starts[portal_index];
+				 edge_index < cluster.edge_starts[portal_index + 1];
+				 ++edge_index) {
+				const Cluster::Edge &edge = cluster.edges[edge_index];
+				uint32_t target_node;
+
+				if (edge.direction == Cluster::Edge::INTERNAL) {
+					target_node = ctx.cluster_base_indices[cluster_index] + edge.target;
+
+				} else {
+					const Vector3i ncluster_pos = cluster.position + g_face_directions[edge.direction];
+					uint32_t ncluster_index;
+					auto it = ctx.cluster_indices.find(ncluster_pos);
+					if (it != ctx.cluster_indices.end()) {
+						ncluster_index = it->second;
+					} else if (ctx.clusters.size() < _max_searched_clusters) {
+						ncluster_index = ctx.add_cluster(get_or_build_cluster(ncluster_pos));
+					} else {
+						continue;
+					}
+					const uint32_t nportal_index = ctx.clusters[ncluster_index]->find_portal(edge.target);
+					if (nportal_index == NO_INDEX) {
+						// The neighbor was built from different voxels, it will be invalidated soon
+						continue;
+					}
+					target_node = ctx.cluster_base_indices[ncluster_index] + nportal_index;
+				}
+
+				if (ctx.closed[target_node] != 0) {
+					continue;
+				}
+				const float ncost = cost + edge.cost;
+				if (ncost < ctx.costs[target_node]) {
+					ctx.costs[target_node] = ncost;
+					ctx.came_from[target_node] = item.node;
+					ctx.push(target_node, ncost + math::length(to_vec3f(to - ctx.get_node_position(target_node))));
+				}
+			}
+		}
+	}
+
+	if (best_cost == INFINITE_COST) {
+		return false;
+	}
+
+	// Refine into voxel steps
+	{
+		ZN_PROFILE_SCOPE_NAMED("Refinement");
+
+		StdVector<uint32_t> nodes;
+		for (uint32_t node = best_last_node; node != NO_INDEX; node = ctx.came_from[node]) {
+			nodes.push_back(node);
+		}
+		std::reverse(nodes.begin(), nodes.end());
+
+		out_path.clear();
+		out_path.push_back(from);
+
+		Vector3i pos = from;
+		uint32_t cluster_index = from_cluster_index;
+
+		for (const uint32_t node : nodes) {
+			const uint32_t node_cluster_index = ctx.node_cluster_indices[node];
+			const Vector3i node_pos = ctx.get_node_position(node);
+
+			if (node_cluster_index == cluster_index) {
+				const Cluster &cluster = *ctx.clusters[cluster_index];
+				const uint16_t cell = get_local_index(node_pos - cluster.origin);
+				search.run(cluster, get_local_index(pos - cluster.origin), false, cell, Span<const uint16_t>());
+				ZN_ASSERT_RETURN_V(search.get_cost(cell) != INFINITE_COST, false);
+				search.get_path(cluster, cell, out_path);
+			} else {
+				// Crossing into a neighbor cluster
+				out_path.push_back(node_pos);
+			}
+
+			pos = node_pos;
+			cluster_index = node_cluster_index;
+		}
+
+		ZN_ASSERT_RETURN_V(cluster_index == to_cluster_index, false);
+		search.run(to_cluster, get_local_index(pos - to_cluster.origin), false, to_cell, Span<const uint16_t>());
+		ZN_ASSERT_RETURN_V(search.get_cost(to_cell) != INFINITE_COST, false);
+		search.get_path(to_cluster, to_cell, out_path);
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+TypedArray<Vector3i> to_typed_array(Span<const Vector3i> items) {
+	TypedArray<Vector3i> typed_array;
+	typed_array.resize(items.size());
+	for (unsigned int i = 0; i < items.size(); ++i) {
+		typed_array[i] = items[i];
+	}
+	return typed_array;
+}
+
+struct PathBatch {
+	static const unsigned int QUERIES_PER_CHUNK = 4;
+
+	std::shared_ptr<HierarchicalPathFinder> path_finder;
+	StdVector<Vector3i> from_positions;
+	StdVector<Vector3i> to_positions;
+	StdVector<StdVector<Vector3i>> paths;
+	std::atomic_uint32_t next_index = 0;
+	// Only accessed on the main thread
+	unsigned int remaining_tasks = 0;
+	Ref<VoxelHierarchicalPathFinder> owner;
+	int batch_id = 0;
+
+	void run_queries() {
+		const unsigned int count = from_positions.size();
+
+		while (true) {
+			const unsigned int begin = next_index.fetch_add(QUERIES_PER_CHUNK);
+			if (begin >= count) {
+				break;
+			}
+			const unsigned int end = math::min(begin + QUERIES_PER_CHUNK, count);
+
+			for (unsigned int i = begin; i < end; ++i) {
+				if (!path_finder->find_path(from_positions[i], to_positions[i], paths[i])) {
+					paths[i].clear();
+				}
+			}
+		}
+	}
+};
+
+class FindPathsTask : public IThreadedTask {
+public:
+	FindPathsTask(std::shared_ptr<PathBatch> batch) : _batch(batch) {}
+
+	void run(ThreadedTaskContext &ctx) override {
+		_batch->run_queries();
+	}
+
+	void apply_result() override {
+		PathBatch &batch = *_batch;
+		ZN_ASSERT_RETURN(batch.remaining_tasks > 0);
+		--batch.remaining_tasks;
+		if (batch.remaining_tasks > 0) {
+			return;
+		}
+
+		// Last task to finish reports results of the whole batch
+		Array paths;
+		paths.resize(batch.paths.size());
+		for (unsigned int i = 0; i < batch.paths.size(); ++i) {
+			paths[i] = to_typed_array(to_span(batch.paths[i]));
+		}
+		batch.owner->emit_signal(VoxelStringNames::get_singleton().async_paths_found, batch.batch_id, paths);
+		batch.owner.unref();
+	}
+
+	const char *get_debug_name() const override {
+		return "FindPaths";
+	}
+
+private:
+	std::shared_ptr<PathBatch> _batch;
+};
+
+} // namespace
+
+VoxelHierarchicalPathFinder::VoxelHierarchicalPathFinder() {}
+
+void VoxelHierarchicalPathFinder::set_terrain(VoxelTerrain *terrain) {
+	ZN_ASSERT_RETURN(terrain != nullptr);
+	_data = terrain->get_storage_shared();
+	_terrain_id = terrain->get_instance_id();
+	update_path_finder();
+}
+
+void VoxelHierarchicalPathFinder::update_path_finder() {
+	if (_data == nullptr) {
+		return;
+	}
+	// Queries still running keep using the previous path finder
+	_path_finder = make_shared_instance<HierarchicalPathFinder>(_data, _agent_height, _max_fall_height);
+
+	VoxelTerrain *terrain = Object::cast_to<VoxelTerrain>(ObjectDB::get_instance(_terrain_id));
+	if (terrain != nullptr) {
+		terrain->add_path_finder(_path_finder);
+	}
+}
+
+void VoxelHierarchicalPathFinder::set_agent_height(int height) {
+	ZN_ASSERT_RETURN(height >= 1);
+	if (height == _agent_height) {
+		return;
+	}
+	_agent_height = height;
+	update_path_finder();
+}
+
+int VoxelHierarchicalPathFinder::get_agent_height() const {
+	return _agent_height;
+}
+
+void VoxelHierarchicalPathFinder::set_max_fall_height(int height) {
+	ZN_ASSERT_RETURN(height >= 1);
+	if (height == _max_fall_height) {
+		return;
+	}
+	_max_fall_height = height;
+	update_path_finder();
+}
+
+int VoxelHierarchicalPathFinder::get_max_fall_height() const {
+	return _max_fall_height;
+}
+
+TypedArray<Vector3i> VoxelHierarchicalPathFinder::find_path(Vector3i from_position, Vector3i to_position) const {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND_V_MSG(_path_finder == nullptr, TypedArray<Vector3i>(), "No terrain was set");
+	StdVector<Vector3i> path;
+	if (!_path_finder->find_path(from_position, to_position, path)) {
+		return TypedArray<Vector3i>();
+	}
+	return to_typed_array(to_span(path));
+}
+
+int VoxelHierarchicalPathFinder::find_paths_async(
+		TypedArray<Vector3i> from_positions,
+		TypedArray<Vector3i> to_positions
+) {
+	ERR_FAIL_COND_V_MSG(_path_finder == nullptr, -1, "No terrain was set");
+	ERR_FAIL_COND_V(from_positions.size() != to_positions.size(), -1);
+
+	const int batch_id = _next_batch_id;
+	++_next_batch_id;
+
+	const unsigned int count = from_positions.size();
+
+	std::shared_ptr<PathBatch> batch = make_shared_instance<PathBatch>();
+	batch->path_finder = _path_finder;
+	batch->from_positions.resize(count);
+	batch->to_positions.resize(count);
+	batch->paths.resize(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		batch->from_positions[i] = from_positions[i];
+		batch->to_positions[i] = to_positions[i];
+	}
+	batch->owner = Ref<VoxelHierarchicalPathFinder>(this);
+	batch->batch_id = batch_id;
+
+	const unsigned int max_tasks = math::max(Thread::get_hardware_concurrency(), 2u) - 1;
+	const unsigned int chunk_count = (count + PathBatch::QUERIES_PER_CHUNK - 1) / PathBatch::QUERIES_PER_CHUNK;
+	const unsigned int task_count = math::clamp(chunk_count, 1u, max_tasks);
+	batch->remaining_tasks = task_count;
+
+	StdVector<IThreadedTask *> tasks;
+	tasks.reserve(task_count);
+	for (unsigned int i = 0; i < task_count; ++i) {
+		tasks.push_back(ZN_NEW(FindPathsTask(batch)));
+	}
+	VoxelEngine::get_singleton().push_async_tasks(to_span(tasks));
+
+	return batch_id;
+}
+
+void VoxelHierarchicalPathFinder::clear_cache() {
+	if (_path_finder != nullptr) {
+		_path_finder->clear_cache();
+	}
+}
+
+int VoxelHierarchicalPathFinder::get_cached_cluster_count() const {
+	if (_path_finder == nullptr) {
+		return 0;
+	}
+	return _path_finder->get_cached_cluster_count();
+}
+
+void VoxelHierarchicalPathFinder::_b_set_terrain(VoxelNode *node) {
+	ERR_FAIL_COND(node == nullptr);
+	// Other terrains don't invalidate cached clusters when their voxels change, so paths would become wrong
+	ERR_FAIL_COND_MSG(
+			Object::cast_to<VoxelLodTerrain>(node) != nullptr,
+			"VoxelLodTerrain is not supported, only VoxelTerrain can be used for pathfinding"
+	);
+	VoxelTerrain *terrain = Object::cast_to<VoxelTerrain>(node);
+	ERR_FAIL_COND_MSG(terrain == nullptr, "Only VoxelTerrain can be used for pathfinding");
+	set_terrain(terrain);
+}
+
+void VoxelHierarchicalPathFinder::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_terrain", "terrain"), &VoxelHierarchicalPathFinder::_b_set_terrain);
+
+	ClassDB::bind_method(D_METHOD("set_agent_height", "height"), &VoxelHierarchicalPathFinder::set_agent_height);
+	ClassDB::bind_method(D_METHOD("get_agent_height"), &VoxelHierarchicalPathFinder::get_agent_height);
+
+	ClassDB::bind_method(
+			D_METHOD("set_max_fall_height", "height"), &VoxelHierarchicalPathFinder::set_max_fall_height
+	);
+	ClassDB::bind_method(D_METHOD("get_max_fall_height"), &VoxelHierarchicalPathFinder::get_max_fall_height);
+
+	ClassDB::bind_method(
+			D_METHOD("find_path", "from_position", "to_position"), &VoxelHierarchicalPathFinder::find_path
+	);
+	ClassDB::bind_method(
+			D_METHOD("find_paths_async", "from_positions", "to_positions"),
+			&VoxelHierarchicalPathFinder::find_paths_async
+	);
+
+	ClassDB::bind_method(D_METHOD("clear_cache"), &VoxelHierarchicalPathFinder::clear_cache);
+	ClassDB::bind_method(
+			D_METHOD("get_cached_cluster_count"), &VoxelHierarchicalPathFinder::get_cached_cluster_count
+	);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "agent_height"), "set_agent_height", "get_agent_height");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "max_fall_height"), "set_max_fall_height", "get_max_fall_height");
+
+	ADD_SIGNAL(MethodInfo(
+			"async_paths_found", PropertyInfo(Variant::INT, "batch_id"), PropertyInfo(Variant::ARRAY, "paths")
+	));
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,127 @@
+#ifndef VOXEL_HIERARCHICAL_PATH_FINDER_H
+#define VOXEL_HIERARCHICAL_PATH_FINDER_H
+
+#include "../util/containers/span.h"
+#include "../util/containers/std_unordered_map.h"
+#include "../util/containers/std_vector.h"
+#include "../util/godot/classes/object.h"
+#include "../util/godot/classes/ref_counted.h"
+#include "../util/godot/core/typed_array.h"
+#include "../util/math/box3i.h"
+#include "../util/thread/rw_lock.h"
+#include <atomic>
+#include <memory>
+
+namespace zylann::voxel {
+
+class VoxelData;
+class VoxelNode;
+class VoxelTerrain;
+
+// Pathfinding on voxel grids for agents walking on top of solid voxels, using the same movement rules as
+// `AStarGrid3D` with an agent 1 voxel wide. Designed for long paths and many queries at once:
+//
+// The world is split into clusters of voxels. Each cluster has a small graph of "portals", which are the cells where
+// agents can enter or leave it, connected by the cost of the shortest path between them. Queries search that graph
+// first, then refine the result into voxel steps only inside the clusters the path goes through.
+//
+// Cluster graphs are built on demand and cached. They must be invalidated when voxels change (`VoxelTerrain` does this
+// automatically for path finders registered with `add_path_finder`). Queries only read voxels, so they can run from
+// multiple threads at once.
+class HierarchicalPathFinder {
+public:
+	static const int CLUSTER_SIZE_PO2 = 4;
+	static const int CLUSTER_SIZE = 1 << CLUSTER_SIZE_PO2;
+	static const int CLUSTER_SIZE_MASK = CLUSTER_SIZE - 1;
+	static const int CLUSTER_VOLUME = CLUSTER_SIZE * CLUSTER_SIZE * CLUSTER_SIZE;
+
+	// Above this count, the whole cache is cleared next time a cluster is added, to bound memory usage
+	static const unsigned int MAX_CACHED_CLUSTERS = 4096;
+	// Limits how far queries can search, in clusters
+	static const unsigned int DEFAULT_MAX_SEARCHED_CLUSTERS = 512;
+
+	HierarchicalPathFinder(std::shared_ptr<VoxelData> data, int agent_height, int max_fall_height);
+
+	int get_agent_height() const {
+		return _agent_height;
+	}
+
+	int get_max_fall_height() const {
+		return _max_fall_height;
+	}
+
+	void set_max_searched_clusters(unsigned int count);
+
+	// Finds a path going from `from` to `to`, where positions are the cells agents stand in (above the ground). The
+	// path includes both ends. Returns false if no path was found. Can be called from any thread.
+	bool find_path(Vector3i from, Vector3i to, StdVector<Vector3i> &out_path) const;
+
+	// Must be called when voxels change in the given area
+	void invalidate_area(Box3i voxel_box);
+	void clear_cache();
+
+	unsigned int get_cached_cluster_count() const;
+
+	struct Cluster;
+
+private:
+	struct QueryContext;
+
+	std::shared_ptr<const Cluster> get_or_build_cluster(Vector3i cluster_pos) const;
+	std::shared_ptr<Cluster> build_cluster(Vector3i cluster_pos) const;
+	Box3i get_cluster_padded_box(Vector3i cluster_pos) const;
+
+	std::shared_ptr<VoxelData> _data;
+	int _agent_height;
+	int _max_fall_height;
+	unsigned int _max_searched_clusters = DEFAULT_MAX_SEARCHED_CLUSTERS;
+
+	// Cluster graphs are immutable once built, so queries can keep using them while they get invalidated
+	mutable StdUnorderedMap<Vector3i, std::shared_ptr<const Cluster>> _clusters;
+	mutable RWLock _clusters_lock;
+	// Incremented on every invalidation, so clusters built from voxels read before an edit don't get cached
+	std::atomic_uint32_t _invalidation_counter = { 0 };
+};
+
+// Godot-facing API for hierarchical pathfinding on blocky terrains.
+class VoxelHierarchicalPathFinder : public RefCounted {
+	GDCLASS(VoxelHierarchicalPathFinder, RefCounted)
+public:
+	VoxelHierarchicalPathFinder();
+
+	void set_terrain(VoxelTerrain *terrain);
+
+	void set_agent_height(int height);
+	int get_agent_height() const;
+
+	void set_max_fall_height(int height);
+	int get_max_fall_height() const;
+
+	TypedArray<Vector3i> find_path(Vector3i from_position, Vector3i to_position) const;
+
+	// Finds paths for many pairs of positions, spread over threads of `VoxelEngine`. Results are given with the
+	// `async_paths_found` signal, with the returned batch ID.
+	int find_paths_async(TypedArray<Vector3i> from_positions, TypedArray<Vector3i> to_positions);
+
+	void clear_cache();
+	int get_cached_cluster_count() const;
+
+private:
+	void update_path_finder();
+
+	void _b_set_terrain(VoxelNode *node);
+
+	static void _bind_methods();
+
+	std::shared_ptr<HierarchicalPathFinder> _path_finder;
+	std::shared_ptr<VoxelData> _data;
+	// Path finders are re-registered to the terrain when their settings change
+	ObjectID _terrain_id;
+	int _agent_height = 2;
+	int _max_fall_height = 3;
+	int _next_batch_id = 0;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_HIERARCHICAL_PATH_FINDER_H
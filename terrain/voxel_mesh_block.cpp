@@ -216,7 +216,8 @@ Ref<ConcavePolygonShape3D> make_collision_shape_from_mesher_output(
 
 	Ref<ConcavePolygonShape3D> shape;
 
-	if (mesher.is_generating_collision_surface()) {
+	// Simplified collision surfaces are stored there even if the mesher doesn't generate one
+	if (mesher.is_generating_collision_surface() || mesher_output.collision_surface.indices.size() > 0) {
 		if (mesher_output.collision_surface.submesh_vertex_end != -1) {
 			// Use a sub-region of the render mesh
 			if (mesher_output.surfaces.size() > 0) {
@@ -198,6 +198,18 @@ int VoxelNode::get_render_layers_mask() const {
 	return _render_layers_mask;
 }
 
+void VoxelNode::set_collision_detail(CollisionDetail detail) {
+	ERR_FAIL_INDEX(detail, COLLISION_DETAIL_COUNT);
+	if (detail != _collision_detail) {
+		_collision_detail = detail;
+		_on_collision_detail_changed();
+	}
+}
+
+VoxelNode::CollisionDetail VoxelNode::get_collision_detail() const {
+	return _collision_detail;
+}
+
 GeometryInstance3D::ShadowCastingSetting VoxelNode::get_shadow_casting() const {
 	return _shadow_casting;
 }
@@ -221,6 +233,9 @@ void VoxelNode::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_render_layers_mask", "mask"), &VoxelNode::set_render_layers_mask);
 	ClassDB::bind_method(D_METHOD("get_render_layers_mask"), &VoxelNode::get_render_layers_mask);
 
+	ClassDB::bind_method(D_METHOD("set_collision_detail", "detail"), &VoxelNode::set_collision_detail);
+	ClassDB::bind_method(D_METHOD("get_collision_detail"), &VoxelNode::get_collision_detail);
+
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "stream", PROPERTY_HINT_RESOURCE_TYPE, VoxelStream::get_class_static()),
 			"set_stream", "get_stream");
 	ADD_PROPERTY(
@@ -235,6 +250,13 @@ void VoxelNode::_bind_methods() {
 			"set_shadow_casting", "get_shadow_casting");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "render_layers_mask", PROPERTY_HINT_LAYERS_3D_RENDER),
 			"set_render_layers_mask", "get_render_layers_mask");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "collision_detail", PROPERTY_HINT_ENUM, "Full,Simplified,Coarse"),
+			"set_collision_detail", "get_collision_detail");
+
+	BIND_ENUM_CONSTANT(COLLISION_DETAIL_FULL);
+	BIND_ENUM_CONSTANT(COLLISION_DETAIL_SIMPLIFIED);
+	BIND_ENUM_CONSTANT(COLLISION_DETAIL_COARSE);
+	BIND_ENUM_CONSTANT(COLLISION_DETAIL_COUNT);
 }
 
 } // namespace zylann::voxel
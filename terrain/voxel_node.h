@@ -20,6 +20,14 @@ class VoxelTool;
 class VoxelNode : public Node3D {
 	GDCLASS(VoxelNode, Node3D)
 public:
+	// How detailed collision shapes are, compared to rendering meshes
+	enum CollisionDetail {
+		COLLISION_DETAIL_FULL = 0,
+		COLLISION_DETAIL_SIMPLIFIED,
+		COLLISION_DETAIL_COARSE,
+		COLLISION_DETAIL_COUNT
+	};
+
 	virtual void set_mesher(Ref<VoxelMesher> mesher);
 	virtual Ref<VoxelMesher> get_mesher() const;
 
@@ -38,6 +46,9 @@ public:
 	void set_render_layers_mask(int mask);
 	int get_render_layers_mask() const;
 
+	void set_collision_detail(CollisionDetail detail);
+	CollisionDetail get_collision_detail() const;
+
 	virtual void restart_stream();
 	virtual void remesh_all_blocks();
 
@@ -61,6 +72,7 @@ protected:
 	virtual void _on_gi_mode_changed() {}
 	virtual void _on_shadow_casting_changed() {}
 	virtual void _on_render_layers_mask_changed() {}
+	virtual void _on_collision_detail_changed() {}
 
 private:
 	Ref<VoxelMesher> _b_get_mesher() {
@@ -89,8 +101,11 @@ private:
 	GeometryInstance3D::GIMode _gi_mode = GeometryInstance3D::GI_MODE_DISABLED;
 	GeometryInstance3D::ShadowCastingSetting _shadow_casting = GeometryInstance3D::SHADOW_CASTING_SETTING_ON;
 	int _render_layers_mask = 1;
+	CollisionDetail _collision_detail = COLLISION_DETAIL_FULL;
 };
 
 } // namespace zylann::voxel
 
+VARIANT_ENUM_CAST(zylann::voxel::VoxelNode::CollisionDetail);
+
 #endif // VOXEL_NODE_H
@@ -0,0 +1,117 @@
+#include "../../engine/detail_rendering/detail_rendering.h"
+#include "../../generators/graph/voxel_generator_graph.h"
+#include "../../meshers/transvoxel/transvoxel_cell_iterator.h"
+#include "../../meshers/transvoxel/voxel_mesher_transvoxel.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../util/containers/container_funcs.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/funcs.h"
+#include "../testing.h"
+#include "benchmark_runner.h"
+#include "benchmarks.h"
+
+namespace zylann::voxel::benchmarks {
+
+namespace {
+
+struct DetailRenderingDataset {
+	StdVector<Vector3f> vertices;
+	StdVector<Vector3f> normals;
+	StdVector<int> indices;
+	StdVector<transvoxel::CellInfo> cell_infos;
+	Vector3i origin_in_voxels;
+	Vector3i voxels_size;
+};
+
+// Transvoxel mesh of one block crossing the surface of the terrain, with the cell infos detail rendering needs
+void create_detail_rendering_dataset(DetailRenderingDataset &ds, VoxelGenerator &generator, int block_size) {
+	Ref<VoxelMesherTransvoxel> mesher;
+	mesher.instantiate();
+
+	const int min_padding = mesher->get_minimum_padding();
+
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	voxels.create(Vector3iUtil::create(block_size + min_padding + mesher->get_maximum_padding()));
+
+	// Centered vertically on the ground
+	const Vector3i origin_in_voxels = Vector3i(0, -block_size / 2, 0) - Vector3iUtil::create(min_padding);
+	VoxelGenerator::VoxelQueryData query{ voxels, origin_in_voxels, 0 };
+	generator.generate_block(query);
+
+	const VoxelMesher::Input mesher_input = { voxels, &generator, nullptr, origin_in_voxels, 0, false, false, true };
+	VoxelMesher::Output mesher_output;
+	mesher->build(mesher_output, mesher_input);
+	ZN_TEST_ASSERT(!VoxelMesher::is_mesh_empty(mesher_output.surfaces));
+
+	const transvoxel::MeshArrays &mesh_arrays = VoxelMesherTransvoxel::get_mesh_cache_from_current_thread();
+	Span<const transvoxel::CellInfo> cell_infos = VoxelMesherTransvoxel::get_cell_info_from_current_thread();
+	ZN_TEST_ASSERT(cell_infos.size() > 0 && mesh_arrays.vertices.size() > 0);
+
+	append_array(ds.vertices, mesh_arrays.vertices);
+	append_array(ds.normals, mesh_arrays.normals);
+	append_array(ds.indices, mesh_arrays.indices);
+	ds.cell_infos.insert(ds.cell_infos.end(), cell_infos.begin(), cell_infos.end());
+	ds.origin_in_voxels = origin_in_voxels;
+	ds.voxels_size = voxels.get_size();
+}
+
+void compute_dataset_detail_texture_data(
+		const DetailRenderingDataset &ds,
+		VoxelGenerator &generator,
+		unsigned int tile_resolution,
+		bool octahedral_encoding,
+		DetailTextureData &out_data
+) {
+	TransvoxelCellIterator cell_iterator(to_span(ds.cell_infos));
+	out_data.clear();
+	compute_detail_texture_data(
+			cell_iterator,
+			to_span(ds.vertices),
+			to_span(ds.normals),
+			to_span(ds.indices),
+			out_data,
+			tile_resolution,
+			generator,
+			nullptr,
+			ds.origin_in_voxels,
+			ds.voxels_size,
+			0,
+			octahedral_encoding,
+			math::deg_to_rad(60.f),
+			false
+	);
+}
+
+// Baking detail textures on the CPU is the only option on servers without GPU, so its throughput matters
+void run_detail_rendering_benchmark(BenchmarkRunner &runner, const char *name, bool octahedral_encoding) {
+	if (!runner.is_enabled(name)) {
+		return;
+	}
+
+	const int block_size = 32;
+	const unsigned int tile_resolution = 16;
+
+	Ref<VoxelGeneratorGraph> generator = create_terrain_generator();
+	DetailRenderingDataset ds;
+	create_detail_rendering_dataset(ds, **generator, block_size);
+
+	DetailTextureData data;
+	// Also allocates memory reused by the next iterations
+	compute_dataset_detail_texture_data(ds, **generator, tile_resolution, octahedral_encoding, data);
+	ZN_TEST_ASSERT(data.tiles.size() > 0);
+
+	const uint64_t pixel_count = uint64_t(data.tiles.size()) * math::squared(tile_resolution);
+
+	runner.run(name, 10, pixel_count, [&ds, &generator, &data, octahedral_encoding]() {
+		compute_dataset_detail_texture_data(ds, **generator, tile_resolution, octahedral_encoding, data);
+	});
+}
+
+} // namespace
+
+void run_detail_rendering_benchmarks(BenchmarkRunner &runner) {
+	run_detail_rendering_benchmark(runner, "detail_rendering/cpu_normalmap", false);
+	run_detail_rendering_benchmark(runner, "detail_rendering/cpu_normalmap_octahedral", true);
+}
+
+} // namespace zylann::voxel::benchmarks
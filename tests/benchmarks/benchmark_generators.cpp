@@ -0,0 +1,148 @@
+#include "../../engine/voxel_engine.h"
+#include "../../generators/graph/voxel_generator_graph.h"
+#include "../../generators/multipass/generate_column_multipass_task.h"
+#include "../../generators/multipass/voxel_generator_multipass_cb.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/memory/memory.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+#include "benchmark_runner.h"
+#include "benchmarks.h"
+#include <atomic>
+
+namespace zylann::voxel::benchmarks {
+
+namespace {
+
+// Scheduled when a column task returns to its caller
+class CountCompletionTask : public IThreadedTask {
+public:
+	std::atomic_uint32_t &count;
+
+	CountCompletionTask(std::atomic_uint32_t &p_count) : count(p_count) {}
+
+	void run(ThreadedTaskContext &ctx) override {
+		++count;
+	}
+};
+
+// Measures the cost of scheduling and synchronizing multipass column tasks. Passes are no-ops since the generator has
+// no script, so what remains is dependency checks, locking and task wakeups.
+void run_multipass_scheduling_benchmark(BenchmarkRunner &runner) {
+	const char *name = "multipass/noop_passes";
+	if (!runner.is_enabled(name)) {
+		return;
+	}
+
+	Ref<VoxelGeneratorMultipassCB> generator;
+	generator.instantiate();
+	generator->set_column_base_y_blocks(-2);
+	generator->set_column_height_blocks(4);
+	generator->set_pass_count(3);
+	generator->set_pass_extent_blocks(1, 1);
+	generator->set_pass_extent_blocks(2, 1);
+
+	const int block_size = 16;
+	const int pass_count = generator->get_pass_count();
+	const int final_subpass_index = VoxelGeneratorMultipassCB::get_subpass_count_from_pass_count(pass_count) - 1;
+
+	const Box3i requested_box(Vector3i(-8, -2, -8), Vector3i(16, 4, 16));
+	const unsigned int column_count = requested_box.size.x * requested_box.size.z;
+	const ViewerID viewer_id;
+
+	runner.run(name, 10, column_count, [&generator, &requested_box, final_subpass_index, column_count, viewer_id]() {
+		generator->process_viewer_diff(viewer_id, requested_box, Box3i());
+
+		std::shared_ptr<VoxelGeneratorMultipassCBStructs::Internal> internal = generator->get_internal();
+		std::atomic_uint32_t completed_count(0);
+
+		for (int z = 0; z < requested_box.size.z; ++z) {
+			for (int x = 0; x < requested_box.size.x; ++x) {
+				const Vector2i cpos(requested_box.position.x + x, requested_box.position.z + z);
+				CountCompletionTask *caller = ZN_NEW(CountCompletionTask(completed_count));
+				GenerateColumnMultipassTask *task = ZN_NEW(GenerateColumnMultipassTask(
+						cpos,
+						block_size,
+						final_subpass_index,
+						internal,
+						generator,
+						TaskPriority(),
+						caller,
+						make_shared_instance<std::atomic_int>(1)
+				));
+				VoxelEngine::get_singleton().push_async_task(task);
+			}
+		}
+
+		while (completed_count < column_count) {
+			Thread::sleep_usec(100);
+		}
+
+		// Unload everything so the next iteration starts from scratch
+		generator->process_viewer_diff(viewer_id, Box3i(), requested_box);
+	});
+}
+
+} // namespace
+
+void run_generator_benchmarks(BenchmarkRunner &runner) {
+	run_multipass_scheduling_benchmark(runner);
+
+	Ref<VoxelGeneratorGraph> generator = create_terrain_generator();
+
+	{
+		const int block_size = 16;
+		StdVector<Vector3i> origins;
+		Vector3i bpos;
+		// Blocks across the surface, where the generator can't skip work using range analysis
+		for (bpos.z = -2; bpos.z < 2; ++bpos.z) {
+			for (bpos.x = -2; bpos.x < 2; ++bpos.x) {
+				for (bpos.y = -1; bpos.y < 1; ++bpos.y) {
+					origins.push_back(bpos * block_size);
+				}
+			}
+		}
+
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(Vector3iUtil::create(block_size));
+
+		runner.run("graph/generate_block", 10, origins.size(), [&generator, &origins, &vb]() {
+			for (const Vector3i origin : origins) {
+				VoxelGenerator::VoxelQueryData query{ vb, origin, 0 };
+				generator->generate_block(query);
+			}
+		});
+	}
+	{
+		const unsigned int count = 65536;
+		const float extent = 100.f;
+		StdVector<float> x;
+		StdVector<float> y;
+		StdVector<float> z;
+		StdVector<float> sdf;
+		RandomPCG rng;
+		rng.seed(DATASET_SEED);
+		for (unsigned int i = 0; i < count; ++i) {
+			x.push_back(extent * (2.f * rng.randf() - 1.f));
+			y.push_back(extent * (2.f * rng.randf() - 1.f));
+			z.push_back(extent * (2.f * rng.randf() - 1.f));
+		}
+		sdf.resize(count);
+
+		runner.run("graph/generate_series", 10, count, [&generator, &x, &y, &z, &sdf, extent]() {
+			generator->generate_series(
+					to_span(x),
+					to_span(y),
+					to_span(z),
+					VoxelBuffer::CHANNEL_SDF,
+					to_span(sdf),
+					Vector3f(-extent),
+					Vector3f(extent)
+			);
+		});
+	}
+}
+
+} // namespace zylann::voxel::benchmarks
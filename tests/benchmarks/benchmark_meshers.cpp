@@ -0,0 +1,149 @@
+#include "../../meshers/blocky/voxel_blocky_library.h"
+#include "../../meshers/blocky/voxel_blocky_model_cube.h"
+#include "../../meshers/blocky/voxel_blocky_model_empty.h"
+#include "../../meshers/blocky/voxel_mesher_blocky.h"
+#include "../../meshers/cubes/voxel_mesher_cubes.h"
+#include "../../meshers/dmc/voxel_mesher_dmc.h"
+#include "../../meshers/transvoxel/voxel_mesher_transvoxel.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../util/containers/std_vector.h"
+#include "benchmark_runner.h"
+#include "benchmarks.h"
+
+namespace zylann::voxel::benchmarks {
+
+namespace {
+
+enum TerrainType { //
+	TERRAIN_SDF,
+	TERRAIN_BLOCKY,
+	TERRAIN_COLORED
+};
+
+struct MeshingDataset {
+	StdVector<VoxelBuffer> blocks;
+	StdVector<Vector3i> origins;
+};
+
+// Blocks along the surface of the terrain, padded as the mesher requires
+void create_meshing_dataset(
+		MeshingDataset &ds,
+		const VoxelMesher &mesher,
+		TerrainType terrain_type,
+		int block_size,
+		int horizontal_radius
+) {
+	const unsigned int min_padding = mesher.get_minimum_padding();
+	const unsigned int max_padding = mesher.get_maximum_padding();
+	const Vector3i padded_size = Vector3iUtil::create(block_size + min_padding + max_padding);
+
+	Vector3i bpos;
+	for (bpos.z = -horizontal_radius; bpos.z < horizontal_radius; ++bpos.z) {
+		for (bpos.x = -horizontal_radius; bpos.x < horizontal_radius; ++bpos.x) {
+			for (bpos.y = -1; bpos.y < 1; ++bpos.y) {
+				const Vector3i origin = bpos * block_size - Vector3iUtil::create(min_padding);
+				ds.blocks.emplace_back(VoxelBuffer::ALLOCATOR_DEFAULT);
+				VoxelBuffer &vb = ds.blocks.back();
+				switch (terrain_type) {
+					case TERRAIN_SDF:
+						create_terrain_sdf(vb, padded_size, origin);
+						break;
+					case TERRAIN_BLOCKY:
+						create_terrain_blocky(vb, padded_size, origin);
+						break;
+					case TERRAIN_COLORED:
+						create_terrain_colored(vb, padded_size, origin);
+						break;
+				}
+				ds.origins.push_back(origin);
+			}
+		}
+	}
+}
+
+void run_mesher_benchmark(
+		BenchmarkRunner &runner,
+		const char *name,
+		VoxelMesher &mesher,
+		TerrainType terrain_type,
+		int block_size = 16,
+		int horizontal_radius = 2
+) {
+	if (!runner.is_enabled(name)) {
+		return;
+	}
+
+	MeshingDataset dataset;
+	create_meshing_dataset(dataset, mesher, terrain_type, block_size, horizontal_radius);
+
+	runner.run(name, 10, dataset.blocks.size(), [&mesher, &dataset]() {
+		for (unsigned int i = 0; i < dataset.blocks.size(); ++i) {
+			VoxelMesher::Input input{ dataset.blocks[i], nullptr, nullptr, dataset.origins[i], 0, false, false, false };
+			VoxelMesher::Output output;
+			mesher.build(output, input);
+		}
+	});
+}
+
+} // namespace
+
+void run_mesher_benchmarks(BenchmarkRunner &runner) {
+	{
+		Ref<VoxelBlockyLibrary> library;
+		library.instantiate();
+		{
+			Ref<VoxelBlockyModelEmpty> air;
+			air.instantiate();
+			library->add_model(air);
+		}
+		{
+			Ref<VoxelBlockyModelCube> cube;
+			cube.instantiate();
+			library->add_model(cube);
+		}
+		library->bake();
+
+		Ref<VoxelMesherBlocky> mesher;
+		mesher.instantiate();
+		mesher->set_library(library);
+		run_mesher_benchmark(runner, "mesher/blocky", **mesher, TERRAIN_BLOCKY);
+	}
+	{
+		Ref<VoxelMesherCubes> mesher;
+		mesher.instantiate();
+		mesher->set_color_mode(VoxelMesherCubes::COLOR_RAW);
+		run_mesher_benchmark(runner, "mesher/cubes", **mesher, TERRAIN_COLORED);
+	}
+	{
+		Ref<VoxelMesherTransvoxel> mesher;
+		mesher.instantiate();
+		run_mesher_benchmark(runner, "mesher/transvoxel", **mesher, TERRAIN_SDF);
+	}
+	{
+		Ref<VoxelMesherDMC> mesher;
+		mesher.instantiate();
+		run_mesher_benchmark(runner, "mesher/dmc", **mesher, TERRAIN_SDF);
+	}
+	// Large blocks, where a single block takes long enough to be worth splitting across threads.
+	// DMC with no geometric error keeps full resolution, like Transvoxel does.
+	{
+		Ref<VoxelMesherTransvoxel> mesher;
+		mesher.instantiate();
+		run_mesher_benchmark(runner, "mesher/transvoxel_64", **mesher, TERRAIN_SDF, 64, 1);
+	}
+	{
+		Ref<VoxelMesherDMC> mesher;
+		mesher.instantiate();
+		mesher->set_geometric_error(0.f);
+		run_mesher_benchmark(runner, "mesher/dmc_64_full_resolution", **mesher, TERRAIN_SDF, 64, 1);
+	}
+	{
+		Ref<VoxelMesherDMC> mesher;
+		mesher.instantiate();
+		mesher->set_geometric_error(0.f);
+		mesher->set_parallel_octants_enabled(true);
+		run_mesher_benchmark(runner, "mesher/dmc_64_full_resolution_parallel_octants", **mesher, TERRAIN_SDF, 64, 1);
+	}
+}
+
+} // namespace zylann::voxel::benchmarks
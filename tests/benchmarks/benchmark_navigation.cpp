@@ -0,0 +1,194 @@
+#include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_data.h"
+#include "../../terrain/voxel_a_star_grid_3d.h"
+#include "../../terrain/voxel_hierarchical_path_finder.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/math/funcs.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+#include "benchmark_runner.h"
+#include "benchmarks.h"
+#include <atomic>
+
+namespace zylann::voxel::benchmarks {
+
+namespace {
+
+const int AGENT_HEIGHT = 2;
+const int MAX_FALL_HEIGHT = 3;
+const unsigned int QUERY_COUNT = 1000;
+const unsigned int THREAD_COUNT = 8;
+// Single-threaded queries, to compare with a regular A* running on the same paths
+const unsigned int SINGLE_THREAD_QUERY_COUNT = 20;
+
+const char *COLD_CACHE_BENCHMARK_NAME = "hierarchical_path_finder/multithreaded_cold_cache";
+const char *WARM_CACHE_BENCHMARK_NAME = "hierarchical_path_finder/multithreaded_warm_cache";
+const char *SINGLE_THREAD_BENCHMARK_NAME = "hierarchical_path_finder/single_thread_warm_cache";
+const char *A_STAR_BENCHMARK_NAME = "a_star_grid/single_thread";
+
+// Terrain with slopes made of 1-voxel steps, and walls agents have to go around
+int get_navigation_terrain_height(int x, int z) {
+	const int t = (x / 6 + z / 9) % 6;
+	int h = 4 + (t < 3 ? t : 6 - t);
+	if (x % 32 == 16 && z % 64 < 48) {
+		h += 6;
+	}
+	return h;
+}
+
+Vector3i get_navigation_ground_position(int x, int z) {
+	return Vector3i(x, get_navigation_terrain_height(x, z), z);
+}
+
+void create_navigation_terrain(VoxelData &data, const Box3i blocks_box) {
+	const int block_size = data.get_block_size();
+
+	blocks_box.for_each_cell_zxy([&data, block_size](Vector3i bpos) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(Vector3iUtil::create(block_size));
+		const Vector3i origin = bpos * block_size;
+
+		for (int z = 0; z < block_size; ++z) {
+			for (int x = 0; x < block_size; ++x) {
+				const int h = get_navigation_terrain_height(origin.x + x, origin.z + z) - origin.y;
+				for (int y = 0; y < math::min(h, block_size); ++y) {
+					buffer->set_voxel(1, x, y, z, VoxelBuffer::CHANNEL_TYPE);
+				}
+			}
+		}
+
+		VoxelDataBlock block(buffer, 0);
+		block.set_edited(true);
+		ZN_TEST_ASSERT(data.try_set_block(bpos, block));
+	});
+}
+
+struct PathQueries {
+	StdVector<Vector3i> from_positions;
+	StdVector<Vector3i> to_positions;
+};
+
+// Many agents requesting paths at the same time across a terrain, which is what batched requests do
+unsigned int find_paths_multithreaded(const HierarchicalPathFinder &path_finder, const PathQueries &queries) {
+	struct Context {
+		const HierarchicalPathFinder *path_finder;
+		const PathQueries *queries;
+		std::atomic_uint32_t next_index;
+		std::atomic_uint32_t found_count;
+	};
+
+	struct L {
+		static void thread_func(void *userdata) {
+			Context &ctx = *static_cast<Context *>(userdata);
+			const PathQueries &queries = *ctx.queries;
+			StdVector<Vector3i> path;
+			while (true) {
+				const unsigned int i = ctx.next_index.fetch_add(1);
+				if (i >= queries.from_positions.size()) {
+					break;
+				}
+				if (ctx.path_finder->find_path(queries.from_positions[i], queries.to_positions[i], path)) {
+					++ctx.found_count;
+				}
+			}
+		}
+	};
+
+	Context ctx;
+	ctx.path_finder = &path_finder;
+	ctx.queries = &queries;
+	ctx.next_index = 0;
+	ctx.found_count = 0;
+
+	FixedArray<Thread, THREAD_COUNT> threads;
+	for (unsigned int i = 0; i < threads.size(); ++i) {
+		threads[i].start(L::thread_func, &ctx);
+	}
+	for (unsigned int i = 0; i < threads.size(); ++i) {
+		threads[i].wait_to_finish();
+	}
+
+	return ctx.found_count;
+}
+
+} // namespace
+
+void run_navigation_benchmarks(BenchmarkRunner &runner) {
+	if (!runner.is_enabled(COLD_CACHE_BENCHMARK_NAME) && !runner.is_enabled(WARM_CACHE_BENCHMARK_NAME) &&
+		!runner.is_enabled(SINGLE_THREAD_BENCHMARK_NAME) && !runner.is_enabled(A_STAR_BENCHMARK_NAME)) {
+		return;
+	}
+
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	const Box3i blocks_box(Vector3i(0, 0, 0), Vector3i(16, 1, 16));
+	create_navigation_terrain(*data, blocks_box);
+	const int block_size = data->get_block_size();
+	const Box3i voxel_box(blocks_box.position * block_size, blocks_box.size * block_size);
+
+	PathQueries queries;
+	{
+		RandomPCG rng;
+		rng.seed(DATASET_SEED);
+		for (unsigned int i = 0; i < QUERY_COUNT; ++i) {
+			queries.from_positions.push_back(
+					get_navigation_ground_position(rng.rand(voxel_box.size.x), rng.rand(voxel_box.size.z))
+			);
+			queries.to_positions.push_back(
+					get_navigation_ground_position(rng.rand(voxel_box.size.x), rng.rand(voxel_box.size.z))
+			);
+		}
+	}
+
+	// Cluster graphs are built as queries need them
+	runner.run(COLD_CACHE_BENCHMARK_NAME, 5, QUERY_COUNT, [&data, &queries]() {
+		HierarchicalPathFinder path_finder(data, AGENT_HEIGHT, MAX_FALL_HEIGHT);
+		find_paths_multithreaded(path_finder, queries);
+	});
+
+	{
+		HierarchicalPathFinder path_finder(data, AGENT_HEIGHT, MAX_FALL_HEIGHT);
+		const unsigned int cold_found_count = find_paths_multithreaded(path_finder, queries);
+
+		runner.run(
+				WARM_CACHE_BENCHMARK_NAME,
+				10,
+				QUERY_COUNT,
+				[&path_finder, &queries, cold_found_count]() {
+					const unsigned int found_count = find_paths_multithreaded(path_finder, queries);
+					ZN_TEST_ASSERT(found_count == cold_found_count);
+				}
+		);
+
+		runner.run(
+				SINGLE_THREAD_BENCHMARK_NAME,
+				10,
+				SINGLE_THREAD_QUERY_COUNT,
+				[&path_finder, &queries]() {
+					StdVector<Vector3i> path;
+					for (unsigned int i = 0; i < SINGLE_THREAD_QUERY_COUNT; ++i) {
+						path_finder.find_path(queries.from_positions[i], queries.to_positions[i], path);
+					}
+				}
+		);
+
+		// A* gives up on paths costing more than its limit, so it may find less of them
+		runner.run(A_STAR_BENCHMARK_NAME, 2, SINGLE_THREAD_QUERY_COUNT, [&data, &queries, voxel_box]() {
+			VoxelAStarGrid3DInternal a_star;
+			a_star.data = data;
+			a_star.set_region(voxel_box);
+			// The default agent size fits in 1x2x1 voxels
+			a_star.set_max_fall_height(MAX_FALL_HEIGHT);
+			for (unsigned int i = 0; i < SINGLE_THREAD_QUERY_COUNT; ++i) {
+				a_star.start(queries.from_positions[i], queries.to_positions[i]);
+				a_star.init_cache();
+				while (a_star.is_running()) {
+					a_star.step();
+				}
+			}
+		});
+	}
+}
+
+} // namespace zylann::voxel::benchmarks
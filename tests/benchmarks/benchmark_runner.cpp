@@ -0,0 +1,122 @@
+#include "benchmark_runner.h"
+#include "../../constants/version.gen.h"
+#include "../../util/errors.h"
+#include "../../util/godot/classes/file_access.h"
+#include "../../util/godot/classes/json.h"
+#include "../../util/godot/classes/time.h"
+#include "../../util/godot/core/array.h"
+#include "../../util/godot/core/dictionary.h"
+#include "../../util/io/log.h"
+#include "../../util/math/funcs.h"
+#include "../../util/string/format.h"
+#include "../../util/thread/thread.h"
+#include <algorithm>
+
+namespace zylann::voxel::benchmarks {
+
+void BenchmarkRunner::set_filter(const StdString &filter) {
+	_filter = filter;
+}
+
+bool BenchmarkRunner::is_enabled(const char *name) const {
+	return _filter.empty() || std::string_view(name).find(_filter) != std::string_view::npos;
+}
+
+void BenchmarkRunner::add_result(const char *name, uint64_t items_per_iteration) {
+	ZN_ASSERT_RETURN(_durations.size() > 0);
+
+	std::sort(_durations.begin(), _durations.end());
+
+	uint64_t sum = 0;
+	for (const uint64_t d : _durations) {
+		sum += d;
+	}
+
+	Result result;
+	result.name = name;
+	result.iterations = _durations.size();
+	result.items_per_iteration = items_per_iteration;
+	result.min_usec = _durations.front();
+	result.max_usec = _durations.back();
+	result.median_usec = _durations[_durations.size() / 2];
+	result.mean_usec = sum / _durations.size();
+	_results.push_back(result);
+
+	print_line(
+			format("{}: median {} us, min {} us, max {} us ({} iterations)",
+				   result.name,
+				   result.median_usec,
+				   result.min_usec,
+				   result.max_usec,
+				   result.iterations)
+	);
+}
+
+namespace {
+
+double get_items_per_second(const BenchmarkRunner::Result &result) {
+	// Median is less sensitive to outliers caused by the OS
+	return double(result.items_per_iteration) * 1'000'000.0 / double(math::max(result.median_usec, uint64_t(1)));
+}
+
+} // namespace
+
+void BenchmarkRunner::print_results() const {
+	print_line("------------ Voxel benchmark results -------------");
+	for (const Result &result : _results) {
+		print_line(format("{}: {} us, {} items/s", result.name, result.median_usec, get_items_per_second(result)));
+	}
+}
+
+Dictionary BenchmarkRunner::to_dictionary() const {
+	Array results;
+	for (const Result &result : _results) {
+		Dictionary d;
+		d["name"] = to_godot(result.name);
+		d["iterations"] = result.iterations;
+		d["items_per_iteration"] = result.items_per_iteration;
+		d["min_usec"] = result.min_usec;
+		d["max_usec"] = result.max_usec;
+		d["median_usec"] = result.median_usec;
+		d["mean_usec"] = result.mean_usec;
+		d["items_per_second"] = get_items_per_second(result);
+		results.append(d);
+	}
+
+	Dictionary d;
+	add_environment_info(d);
+	d["benchmarks"] = results;
+	return d;
+}
+
+bool BenchmarkRunner::save_json(const String &fpath) const {
+	return save_results_json(to_dictionary(), fpath);
+}
+
+void add_environment_info(Dictionary &d) {
+	String version_string =
+			String("{0}.{1}.{2}").format(varray(VOXEL_VERSION_MAJOR, VOXEL_VERSION_MINOR, VOXEL_VERSION_PATCH));
+	if (VOXEL_VERSION_STATUS[0] != '\0') {
+		version_string += ".";
+		version_string += VOXEL_VERSION_STATUS;
+	}
+	d["version"] = version_string;
+	d["git_hash"] = VOXEL_VERSION_GIT_HASH;
+	d["timestamp"] = Time::get_singleton()->get_datetime_string_from_system(true);
+	d["hardware_concurrency"] = Thread::get_hardware_concurrency();
+}
+
+bool save_results_json(const Dictionary &results, const String &fpath) {
+	const String json_string = JSON::stringify(results, "\t", true);
+
+	Error err;
+	Ref<FileAccess> f = zylann::godot::open_file(fpath, FileAccess::WRITE, err);
+	if (f.is_null()) {
+		ERR_PRINT(String("Could not save benchmark results to {0}").format(varray(fpath)));
+		return false;
+	}
+	f->store_string(json_string);
+	return true;
+}
+
+} // namespace zylann::voxel::benchmarks
@@ -0,0 +1,74 @@
+#ifndef VOXEL_BENCHMARK_RUNNER_H
+#define VOXEL_BENCHMARK_RUNNER_H
+
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/string.h"
+#include "../../util/godot/macros.h"
+#include "../../util/profiling_clock.h"
+#include "../../util/string/std_string.h"
+
+ZN_GODOT_FORWARD_DECLARE(class Dictionary);
+
+namespace zylann::voxel::benchmarks {
+
+// Runs timed functions and collects statistics about them, so they can be compared between versions.
+// Benchmarks must be deterministic: use fixed seeds and datasets, so results only change when the code does.
+class BenchmarkRunner {
+public:
+	struct Result {
+		StdString name;
+		unsigned int iterations;
+		// How many items (voxels, blocks, tasks...) are processed in one iteration, used to compute throughput
+		uint64_t items_per_iteration;
+		uint64_t min_usec;
+		uint64_t max_usec;
+		uint64_t median_usec;
+		uint64_t mean_usec;
+	};
+
+	// Only benchmarks whose name contains this string will run. Empty means all of them.
+	void set_filter(const StdString &filter);
+
+	bool is_enabled(const char *name) const;
+
+	// Runs `f` once to warm up caches, then `iterations` more times while measuring each call.
+	template <typename F>
+	void run(const char *name, unsigned int iterations, uint64_t items_per_iteration, F f) {
+		if (!is_enabled(name)) {
+			return;
+		}
+		f();
+		_durations.clear();
+		ProfilingClock profiling_clock;
+		for (unsigned int i = 0; i < iterations; ++i) {
+			profiling_clock.restart();
+			f();
+			_durations.push_back(profiling_clock.get_elapsed_microseconds());
+		}
+		add_result(name, items_per_iteration);
+	}
+
+	Span<const Result> get_results() const {
+		return to_span(_results);
+	}
+
+	void print_results() const;
+	Dictionary to_dictionary() const;
+	bool save_json(const String &fpath) const;
+
+private:
+	void add_result(const char *name, uint64_t items_per_iteration);
+
+	StdString _filter;
+	StdVector<uint64_t> _durations;
+	StdVector<Result> _results;
+};
+
+// Adds information to tell apart results coming from different versions or machines
+void add_environment_info(Dictionary &d);
+bool save_results_json(const Dictionary &results, const String &fpath);
+
+} // namespace zylann::voxel::benchmarks
+
+#endif // VOXEL_BENCHMARK_RUNNER_H
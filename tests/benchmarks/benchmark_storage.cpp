@@ -0,0 +1,285 @@
+#include "../../edition/funcs.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_data_map.h"
+#include "../../storage/voxel_memory_pool.h"
+#include "../../streams/voxel_block_serializer.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/math/conv.h"
+#include "../../util/math/funcs.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+#include "benchmark_runner.h"
+#include "benchmarks.h"
+
+namespace zylann::voxel::benchmarks {
+
+namespace {
+
+void create_random_blocks(StdVector<VoxelBuffer> &blocks, unsigned int count, unsigned int block_size) {
+	RandomPCG rng;
+	rng.seed(DATASET_SEED);
+	blocks.reserve(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		blocks.emplace_back(VoxelBuffer::ALLOCATOR_DEFAULT);
+		create_random_block(blocks.back(), block_size, rng);
+	}
+}
+
+// Each thread repeatedly allocates a batch of blocks of typical channel sizes and recycles them, which is similar to
+// what generation and meshing tasks do
+void run_memory_pool_benchmark(BenchmarkRunner &runner, const char *name, bool thread_caches_enabled) {
+	if (!runner.is_enabled(name)) {
+		return;
+	}
+
+	static const unsigned int ITERATIONS = 2000;
+	static const unsigned int BATCH_SIZE = 16;
+	static const unsigned int THREAD_COUNT = 8;
+
+	struct Context {
+		VoxelMemoryPool *pool;
+		unsigned int seed;
+	};
+
+	struct L {
+		static void thread_func(void *userdata) {
+			Context &ctx = *static_cast<Context *>(userdata);
+			RandomPCG rng;
+			rng.seed(ctx.seed);
+
+			FixedArray<uint8_t *, BATCH_SIZE> blocks;
+			FixedArray<size_t, BATCH_SIZE> sizes;
+
+			for (unsigned int iteration = 0; iteration < ITERATIONS; ++iteration) {
+				for (unsigned int i = 0; i < BATCH_SIZE; ++i) {
+					// 4 KB, 8 KB or 16 KB
+					const size_t size = size_t(4096) << rng.rand(3);
+					uint8_t *block = ctx.pool->allocate(size);
+					ZN_TEST_ASSERT(block != nullptr);
+					block[0] = i;
+					blocks[i] = block;
+					sizes[i] = size;
+				}
+				for (unsigned int i = 0; i < BATCH_SIZE; ++i) {
+					ctx.pool->recycle(blocks[i], sizes[i]);
+				}
+			}
+		}
+	};
+
+	VoxelMemoryPool pool;
+	pool.set_thread_caches_enabled(thread_caches_enabled);
+
+	const uint64_t allocation_count = uint64_t(THREAD_COUNT) * ITERATIONS * BATCH_SIZE;
+
+	runner.run(name, 10, allocation_count, [&pool]() {
+		FixedArray<Thread, THREAD_COUNT> threads;
+		FixedArray<Context, THREAD_COUNT> contexts;
+		for (unsigned int i = 0; i < threads.size(); ++i) {
+			contexts[i] = Context{ &pool, static_cast<unsigned int>(DATASET_SEED + i) };
+			threads[i].start(L::thread_func, &contexts[i]);
+		}
+		for (unsigned int i = 0; i < threads.size(); ++i) {
+			threads[i].wait_to_finish();
+		}
+	});
+
+	ZN_TEST_ASSERT(pool.debug_get_used_blocks() == 0);
+}
+
+} // namespace
+
+void run_storage_benchmarks(BenchmarkRunner &runner) {
+	const Vector3i terrain_size(64, 64, 64);
+	const Vector3i terrain_origin(-32, -32, -32);
+	const uint64_t terrain_volume = Vector3iUtil::get_volume(terrain_size);
+
+	VoxelBuffer terrain(VoxelBuffer::ALLOCATOR_DEFAULT);
+	create_terrain_sdf(terrain, terrain_size, terrain_origin);
+
+	// VoxelBuffer
+
+	{
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(terrain_size);
+		unsigned int value = 0;
+		runner.run("voxel_buffer/fill_area", 100, terrain_volume, [&vb, &value, terrain_size]() {
+			// Alternate values so the channel doesn't stay uniform
+			vb.fill_area(value, Vector3i(), terrain_size, VoxelBuffer::CHANNEL_TYPE);
+			vb.set_voxel(value + 1, Vector3i(), VoxelBuffer::CHANNEL_TYPE);
+			value = (value + 1) & 0xff;
+		});
+	}
+	{
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(terrain_size);
+		runner.run("voxel_buffer/copy_channel_from_area", 100, terrain_volume, [&vb, &terrain, terrain_size]() {
+			vb.copy_channel_from(terrain, Vector3i(), terrain_size, Vector3i(), VoxelBuffer::CHANNEL_SDF);
+		});
+	}
+	{
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(terrain_size / 2);
+		runner.run("voxel_buffer/downscale_to", 100, terrain_volume, [&vb, &terrain, terrain_size]() {
+			terrain.downscale_to(vb, Vector3i(), terrain_size, Vector3i());
+		});
+	}
+	{
+		float sum = 0.f;
+		runner.run("voxel_buffer/get_voxel_f", 20, terrain_volume, [&sum, &terrain, terrain_size]() {
+			Vector3i pos;
+			for (pos.z = 0; pos.z < terrain_size.z; ++pos.z) {
+				for (pos.x = 0; pos.x < terrain_size.x; ++pos.x) {
+					for (pos.y = 0; pos.y < terrain_size.y; ++pos.y) {
+						sum += terrain.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+					}
+				}
+			}
+		});
+		// Use the result so the loop doesn't get optimized out
+		ZN_TEST_ASSERT(!Math::is_nan(sum));
+	}
+
+	// BlockSerializer
+
+	{
+		const unsigned int block_count = 256;
+		const unsigned int block_size = 16;
+		StdVector<VoxelBuffer> blocks;
+		create_random_blocks(blocks, block_count, block_size);
+
+		runner.run("block_serializer/serialize", 20, block_count, [&blocks]() {
+			for (const VoxelBuffer &vb : blocks) {
+				BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb);
+				ZN_TEST_ASSERT(result.success);
+			}
+		});
+
+		runner.run("block_serializer/serialize_and_compress", 20, block_count, [&blocks]() {
+			for (const VoxelBuffer &vb : blocks) {
+				BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(vb);
+				ZN_TEST_ASSERT(result.success);
+			}
+		});
+
+		StdVector<StdVector<uint8_t>> serialized_blocks;
+		StdVector<StdVector<uint8_t>> compressed_blocks;
+		for (const VoxelBuffer &vb : blocks) {
+			serialized_blocks.push_back(BlockSerializer::serialize(vb).data);
+			compressed_blocks.push_back(BlockSerializer::serialize_and_compress(vb).data);
+		}
+
+		VoxelBuffer loaded_vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		// Sections are copied straight into channels of the reused buffer
+		runner.run("block_serializer/deserialize", 20, block_count, [&serialized_blocks, &loaded_vb]() {
+			for (const StdVector<uint8_t> &data : serialized_blocks) {
+				ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(data), loaded_vb));
+			}
+		});
+
+		runner.run("block_serializer/decompress_and_deserialize", 20, block_count, [&compressed_blocks, &loaded_vb]() {
+			for (const StdVector<uint8_t> &data : compressed_blocks) {
+				ZN_TEST_ASSERT(BlockSerializer::decompress_and_deserialize(to_span(data), loaded_vb));
+			}
+		});
+	}
+
+	// VoxelMemoryPool
+
+	run_memory_pool_benchmark(runner, "voxel_memory_pool/multithreaded", false);
+	run_memory_pool_benchmark(runner, "voxel_memory_pool/multithreaded_thread_caches", true);
+
+	// VoxelDataMap
+
+	{
+		VoxelDataMap map;
+		map.create(0);
+
+		runner.run("voxel_data_map/paste", 20, terrain_volume, [&map, &terrain, terrain_origin]() {
+			map.paste(terrain_origin, terrain, 1 << VoxelBuffer::CHANNEL_SDF, true);
+		});
+
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(terrain_size);
+		runner.run("voxel_data_map/copy", 20, terrain_volume, [&map, &vb, terrain_origin]() {
+			map.copy(terrain_origin, vb, 1 << VoxelBuffer::CHANNEL_SDF);
+		});
+
+		const unsigned int access_count = 100'000;
+		StdVector<Vector3i> positions;
+		{
+			RandomPCG rng;
+			rng.seed(DATASET_SEED);
+			for (unsigned int i = 0; i < access_count; ++i) {
+				positions.push_back(
+						terrain_origin +
+						Vector3i(rng.rand(terrain_size.x), rng.rand(terrain_size.y), rng.rand(terrain_size.z))
+				);
+			}
+		}
+		int64_t sum = 0;
+		runner.run("voxel_data_map/get_voxel_random", 20, access_count, [&map, &positions, &sum]() {
+			for (const Vector3i pos : positions) {
+				sum += map.get_voxel(pos, VoxelBuffer::CHANNEL_SDF);
+			}
+		});
+		ZN_TEST_ASSERT(sum != 0);
+	}
+}
+
+void run_edition_benchmarks(BenchmarkRunner &runner) {
+	const Vector3i terrain_size(64, 64, 64);
+	const Vector3i terrain_origin(-32, -32, -32);
+
+	VoxelBuffer terrain(VoxelBuffer::ALLOCATOR_DEFAULT);
+	create_terrain_sdf(terrain, terrain_size, terrain_origin);
+
+	{
+		VoxelDataMap map;
+		map.create(0);
+		map.paste(terrain_origin, terrain, 1 << VoxelBuffer::CHANNEL_SDF, true);
+
+		const float radius = 12.f;
+		const Box3i box = ops::get_sdf_sphere_box(Vector3(), radius);
+		bool add = true;
+
+		runner.run("edition/sdf_sphere", 50, Vector3iUtil::get_volume(box.size), [&map, &add, &box, radius]() {
+			// Alternate adding and removing so the terrain doesn't converge to a state where edits do nothing
+			ops::SdfSphere shape;
+			shape.center = Vector3();
+			shape.radius = radius;
+			shape.sdf_scale = 1.f;
+			if (add) {
+				ops::SdfOperation16bit<ops::SdfUnion, ops::SdfSphere> op;
+				op.shape = shape;
+				op.op.strength = 1.f;
+				map.write_box(box, VoxelBuffer::CHANNEL_SDF, op);
+			} else {
+				ops::SdfOperation16bit<ops::SdfSubtract, ops::SdfSphere> op;
+				op.shape = shape;
+				op.op.strength = 1.f;
+				map.write_box(box, VoxelBuffer::CHANNEL_SDF, op);
+			}
+			add = !add;
+		});
+	}
+	{
+		const Vector3f center = to_vec3f(terrain_size / 2);
+		const float radius = 24.f;
+		VoxelBuffer dst(VoxelBuffer::ALLOCATOR_DEFAULT);
+
+		runner.run("edition/box_blur", 20, Vector3iUtil::get_volume(terrain_size), [&terrain, &dst, center, radius]() {
+			ops::box_blur(terrain, dst, 1, center, radius);
+		});
+
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		terrain.copy_to(vb, false);
+		runner.run("edition/grow_sphere", 20, Vector3iUtil::get_volume(terrain_size), [&vb, center, radius]() {
+			ops::grow_sphere(vb, 0.1f, center, radius);
+		});
+	}
+}
+
+} // namespace zylann::voxel::benchmarks
@@ -0,0 +1,110 @@
+#include "../../streams/region/region_file.h"
+#include "../../streams/sqlite/voxel_stream_sqlite.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../testing.h"
+#include "benchmark_runner.h"
+#include "benchmarks.h"
+
+namespace zylann::voxel::benchmarks {
+
+namespace {
+
+struct BlockDataset {
+	StdVector<VoxelBuffer> blocks;
+	StdVector<Vector3i> positions;
+};
+
+void create_block_dataset(BlockDataset &ds, unsigned int count, unsigned int block_size, Vector3i area_size) {
+	RandomPCG rng;
+	rng.seed(DATASET_SEED);
+	ds.blocks.reserve(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		ds.blocks.emplace_back(VoxelBuffer::ALLOCATOR_DEFAULT);
+		create_random_block(ds.blocks.back(), block_size, rng);
+	}
+	// Positions are unique so every block is actually stored
+	Vector3i pos;
+	for (pos.z = 0; pos.z < area_size.z && ds.positions.size() < count; ++pos.z) {
+		for (pos.x = 0; pos.x < area_size.x && ds.positions.size() < count; ++pos.x) {
+			for (pos.y = 0; pos.y < area_size.y && ds.positions.size() < count; ++pos.y) {
+				ds.positions.push_back(pos);
+			}
+		}
+	}
+	ZN_TEST_ASSERT(ds.positions.size() == count);
+}
+
+} // namespace
+
+void run_stream_benchmarks(BenchmarkRunner &runner) {
+	const unsigned int block_size_po2 = 4;
+	const unsigned int block_count = 512;
+
+	BlockDataset dataset;
+	create_block_dataset(dataset, block_count, 1 << block_size_po2, Vector3i(8, 8, 8));
+
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	// RegionFile
+
+	if (runner.is_enabled("region_file/")) {
+		const String fpath = test_dir.get_path().path_join("benchmark.vxr");
+
+		RegionFile region_file;
+		RegionFormat format = region_file.get_format();
+		format.block_size_po2 = block_size_po2;
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			format.channel_depths[channel_index] = dataset.blocks[0].get_channel_depth(channel_index);
+		}
+		ZN_TEST_ASSERT(region_file.set_format(format));
+		ZN_TEST_ASSERT(region_file.open(fpath, true) == OK);
+
+		// After the first run, blocks are overwritten in place, which is the common case when saving edited terrain
+		runner.run("region_file/save_block", 10, block_count, [&region_file, &dataset]() {
+			for (unsigned int i = 0; i < dataset.blocks.size(); ++i) {
+				ZN_TEST_ASSERT(region_file.save_block(dataset.positions[i], dataset.blocks[i]) == OK);
+			}
+		});
+
+		VoxelBuffer loaded_vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		runner.run("region_file/load_block", 10, block_count, [&region_file, &dataset, &loaded_vb]() {
+			for (const Vector3i pos : dataset.positions) {
+				ZN_TEST_ASSERT(region_file.load_block(pos, loaded_vb) == OK);
+			}
+		});
+
+		ZN_TEST_ASSERT(region_file.close() == OK);
+	}
+
+	// VoxelStreamSQLite
+
+	if (runner.is_enabled("stream_sqlite/")) {
+		const String fpath = test_dir.get_path().path_join("benchmark.sqlite");
+
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(fpath);
+
+		// Includes flushing, otherwise blocks would only be cached in memory
+		runner.run("stream_sqlite/save_voxel_blocks", 10, block_count, [&stream, &dataset]() {
+			for (unsigned int i = 0; i < dataset.blocks.size(); ++i) {
+				VoxelStream::VoxelQueryData q{ dataset.blocks[i], dataset.positions[i], 0, VoxelStream::RESULT_ERROR };
+				stream->save_voxel_block(q);
+			}
+			stream->flush();
+		});
+
+		VoxelBuffer loaded_vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		runner.run("stream_sqlite/load_voxel_block", 10, block_count, [&stream, &dataset, &loaded_vb]() {
+			for (const Vector3i pos : dataset.positions) {
+				VoxelStream::VoxelQueryData q{ loaded_vb, pos, 0, VoxelStream::RESULT_ERROR };
+				stream->load_voxel_block(q);
+				ZN_TEST_ASSERT(q.result == VoxelStream::RESULT_BLOCK_FOUND);
+			}
+		});
+	}
+}
+
+} // namespace zylann::voxel::benchmarks
@@ -0,0 +1,170 @@
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/math/funcs.h"
+#include "../../util/memory/memory.h"
+#include "../../util/tasks/threaded_task_runner.h"
+#include "../../util/thread/spatial_lock_3d.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+#include "benchmark_runner.h"
+#include "benchmarks.h"
+
+namespace zylann::voxel::benchmarks {
+
+namespace {
+
+// Small amount of work, so the cost of scheduling is significant
+class ComputeTask : public IThreadedTask {
+public:
+	uint32_t seed;
+	uint32_t result = 0;
+
+	ComputeTask(uint32_t p_seed) : seed(p_seed) {}
+
+	void run(ThreadedTaskContext &ctx) override {
+		uint32_t h = seed;
+		for (unsigned int i = 0; i < 2000; ++i) {
+			h = h * 1664525u + 1013904223u;
+		}
+		result = h;
+	}
+};
+
+void run_task_runner_benchmark(BenchmarkRunner &runner, const char *name, bool serial) {
+	if (!runner.is_enabled(name)) {
+		return;
+	}
+
+	const unsigned int task_count = 4096;
+
+	ThreadedTaskRunner task_runner;
+	task_runner.set_name("Benchmark");
+	task_runner.set_thread_count(math::min(Thread::get_hardware_concurrency(), ThreadedTaskRunner::MAX_THREADS));
+
+	StdVector<IThreadedTask *> tasks;
+	tasks.resize(task_count);
+
+	runner.run(name, 20, task_count, [&task_runner, &tasks, serial]() {
+		for (unsigned int i = 0; i < tasks.size(); ++i) {
+			tasks[i] = ZN_NEW(ComputeTask(i));
+		}
+		task_runner.enqueue(to_span(tasks), serial);
+		task_runner.wait_for_all_tasks();
+		unsigned int completed_count = 0;
+		task_runner.dequeue_completed_tasks([&completed_count](IThreadedTask *task) {
+			ZN_DELETE(task);
+			++completed_count;
+		});
+		ZN_TEST_ASSERT(completed_count == tasks.size());
+	});
+}
+
+// Many threads lock small boxes in a large area, like tasks generating, meshing and editing blocks of a terrain
+// around viewers. Each thread works around its own moving location, so some of them overlap at times.
+void run_spatial_lock_benchmark(BenchmarkRunner &runner, const char *name, unsigned int shard_count) {
+	if (!runner.is_enabled(name)) {
+		return;
+	}
+
+	static const unsigned int THREAD_COUNT = 16;
+	static const unsigned int MOVE_COUNT = 100;
+	static const unsigned int LOCKS_PER_MOVE = 100;
+	static const int AREA_SIZE_XZ = 64;
+	static const int AREA_SIZE_Y = 16;
+	static const unsigned int WORK_ITERATIONS = 200;
+
+	struct Context {
+		SpatialLock3D *spatial_lock;
+		StdVector<uint32_t> *cells;
+		unsigned int thread_index;
+	};
+
+	struct L {
+		static inline unsigned int get_index(Vector3i pos) {
+			return Vector3iUtil::get_zxy_index(pos, Vector3i(AREA_SIZE_XZ, AREA_SIZE_Y, AREA_SIZE_XZ));
+		}
+
+		static void thread_func(void *userdata) {
+			Context &ctx = *static_cast<Context *>(userdata);
+			SpatialLock3D &spatial_lock = *ctx.spatial_lock;
+			StdVector<uint32_t> &cells = *ctx.cells;
+
+			RandomPCG rng;
+			rng.seed(DATASET_SEED + ctx.thread_index);
+
+			const Vector3i area_size(AREA_SIZE_XZ, AREA_SIZE_Y, AREA_SIZE_XZ);
+			Vector3i center(rng.rand(AREA_SIZE_XZ), AREA_SIZE_Y / 2, rng.rand(AREA_SIZE_XZ));
+
+			for (unsigned int move_index = 0; move_index < MOVE_COUNT; ++move_index) {
+				for (unsigned int i = 0; i < LOCKS_PER_MOVE; ++i) {
+					// Clamped instead of clipped, so every iteration takes a lock
+					const Vector3i size(1 + rng.rand(3), 1 + rng.rand(3), 1 + rng.rand(3));
+					const Vector3i pos = math::clamp(
+							center + Vector3i(rng.rand(9) - 4, rng.rand(9) - 4, rng.rand(9) - 4),
+							Vector3i(),
+							area_size - size
+					);
+					const Box3i box(pos, size);
+
+					if (rng.rand(100) < 80) {
+						SpatialLock3D::Read srlock(spatial_lock, box);
+						uint32_t sum = 0;
+						for (unsigned int j = 0; j < WORK_ITERATIONS; ++j) {
+							sum += cells[get_index(box.position)];
+						}
+						ZN_TEST_ASSERT(sum == cells[get_index(box.position)] * WORK_ITERATIONS);
+
+					} else {
+						SpatialLock3D::Write swlock(spatial_lock, box);
+						for (unsigned int j = 0; j < WORK_ITERATIONS; ++j) {
+							box.for_each_cell([&cells, j](Vector3i cpos) { cells[get_index(cpos)] = j; });
+						}
+					}
+				}
+
+				// Move around
+				center.x = math::clamp(center.x + rng.rand(3) - 1, 0, AREA_SIZE_XZ - 1);
+				center.z = math::clamp(center.z + rng.rand(3) - 1, 0, AREA_SIZE_XZ - 1);
+			}
+		}
+	};
+
+	SpatialLock3D spatial_lock(shard_count);
+	StdVector<uint32_t> cells;
+	cells.resize(AREA_SIZE_XZ * AREA_SIZE_Y * AREA_SIZE_XZ, 0);
+
+	runner.run(name, 5, THREAD_COUNT * MOVE_COUNT * LOCKS_PER_MOVE, [&spatial_lock, &cells]() {
+		FixedArray<Thread, THREAD_COUNT - 1> threads; // Excluding main thread
+		FixedArray<Context, THREAD_COUNT> contexts;
+		const unsigned int main_thread_index = contexts.size() - 1;
+
+		for (unsigned int thread_index = 0; thread_index < contexts.size(); ++thread_index) {
+			contexts[thread_index] = Context{ &spatial_lock, &cells, thread_index };
+		}
+		for (unsigned int thread_index = 0; thread_index < threads.size(); ++thread_index) {
+			threads[thread_index].start(L::thread_func, &contexts[thread_index]);
+		}
+
+		L::thread_func(&contexts[main_thread_index]);
+
+		for (unsigned int thread_index = 0; thread_index < threads.size(); ++thread_index) {
+			threads[thread_index].wait_to_finish();
+		}
+	});
+
+	ZN_TEST_ASSERT(spatial_lock.get_locked_boxes_count() == 0);
+}
+
+} // namespace
+
+void run_task_benchmarks(BenchmarkRunner &runner) {
+	run_task_runner_benchmark(runner, "threaded_task_runner/parallel", false);
+	run_task_runner_benchmark(runner, "threaded_task_runner/serial", true);
+
+	// A single shard behaves like a single list of boxes behind one mutex
+	run_spatial_lock_benchmark(runner, "spatial_lock_3d/single_shard", 1);
+	run_spatial_lock_benchmark(runner, "spatial_lock_3d/sharded", SpatialLock3D::DEFAULT_SHARD_COUNT);
+}
+
+} // namespace zylann::voxel::benchmarks
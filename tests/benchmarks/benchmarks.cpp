@@ -0,0 +1,171 @@
+#include "benchmarks.h"
+#include "../../constants/voxel_constants.h"
+#include "../../generators/graph/voxel_generator_graph.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/io/log.h"
+#include "../../util/math/color8.h"
+#include "../../util/math/conv.h"
+#include "../../util/math/funcs.h"
+#include "../../util/noise/fast_noise_lite/fast_noise_lite.h"
+#include "../../util/string/format.h"
+#include "../testing.h"
+#include "benchmark_runner.h"
+
+namespace zylann::voxel::benchmarks {
+
+Ref<VoxelGeneratorGraph> create_terrain_generator() {
+	Ref<VoxelGeneratorGraph> generator;
+	generator.instantiate();
+	{
+		pg::VoxelGraphFunction &g = **generator->get_main_function();
+
+		// Plane --- Sub --- OutSDF
+		//          /
+		// Noise2D --- Mul
+		//
+		// Bumpy ground around Y=0, not going higher than 10 or lower than -10 voxels.
+
+		const uint32_t n_out_sdf = g.create_node(pg::VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		const uint32_t n_plane = g.create_node(pg::VoxelGraphFunction::NODE_SDF_PLANE, Vector2());
+
+		const uint32_t n_noise = g.create_node(pg::VoxelGraphFunction::NODE_FAST_NOISE_2D, Vector2());
+		Ref<ZN_FastNoiseLite> fnl;
+		fnl.instantiate();
+		fnl->set_seed(DATASET_SEED);
+		fnl->set_period(64);
+		fnl->set_fractal_octaves(4);
+		g.set_node_param(n_noise, 0, fnl);
+
+		const uint32_t n_mul = g.create_node(pg::VoxelGraphFunction::NODE_MULTIPLY, Vector2());
+		g.set_node_default_input(n_mul, 1, 10.0);
+
+		const uint32_t n_sub = g.create_node(pg::VoxelGraphFunction::NODE_SUBTRACT, Vector2());
+
+		g.add_connection(n_plane, 0, n_sub, 0);
+		g.add_connection(n_noise, 0, n_mul, 0);
+		g.add_connection(n_mul, 0, n_sub, 1);
+		g.add_connection(n_sub, 0, n_out_sdf, 0);
+
+		const pg::CompilationResult result = generator->compile(false);
+		ZN_TEST_ASSERT(result.success);
+	}
+	return generator;
+}
+
+void create_terrain_sdf(VoxelBuffer &vb, Vector3i size, Vector3i origin) {
+	Ref<VoxelGeneratorGraph> generator = create_terrain_generator();
+	vb.create(size);
+	VoxelGenerator::VoxelQueryData query{ vb, origin, 0 };
+	generator->generate_block(query);
+}
+
+namespace {
+
+inline bool is_cave(Vector3i pos) {
+	const Vector3f p = to_vec3f(pos) * 0.3f;
+	return Math::sin(p.x) * Math::sin(p.y) * Math::sin(p.z) > 0.5f;
+}
+
+} // namespace
+
+void create_terrain_blocky(VoxelBuffer &vb, Vector3i size, Vector3i origin) {
+	create_terrain_sdf(vb, size, origin);
+
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				const float sd = vb.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+				const bool solid = sd < 0.f && !is_cave(origin + pos);
+				vb.set_voxel(solid ? 1 : 0, pos, VoxelBuffer::CHANNEL_TYPE);
+			}
+		}
+	}
+
+	vb.clear_channel_f(VoxelBuffer::CHANNEL_SDF, constants::SDF_FAR_OUTSIDE);
+}
+
+void create_terrain_colored(VoxelBuffer &vb, Vector3i size, Vector3i origin) {
+	create_terrain_blocky(vb, size, origin);
+
+	const unsigned int color_count = 3;
+	const uint16_t colors[color_count] = {
+		Color8(80, 160, 40, 255).to_u16(), //
+		Color8(120, 90, 50, 255).to_u16(), //
+		Color8(128, 128, 128, 255).to_u16() //
+	};
+
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_COLOR, VoxelBuffer::DEPTH_16_BIT);
+
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				if (vb.get_voxel(pos, VoxelBuffer::CHANNEL_TYPE) != 0) {
+					// Layers of different colors
+					const unsigned int layer = math::wrap(origin.y + pos.y, int(color_count) * 4) / 4;
+					vb.set_voxel(colors[layer], pos, VoxelBuffer::CHANNEL_COLOR);
+				}
+			}
+		}
+	}
+
+	vb.clear_channel(VoxelBuffer::CHANNEL_TYPE, 0);
+}
+
+void create_random_block(VoxelBuffer &vb, unsigned int size, RandomPCG &rng) {
+	vb.create(Vector3iUtil::create(size));
+	const unsigned int channel_index = VoxelBuffer::CHANNEL_TYPE;
+
+	const float r = rng.randf();
+
+	if (r < 0.2f) {
+		// Uniform block
+		vb.clear_channel(channel_index, rng.rand() % 256);
+
+	} else if (r < 0.6f) {
+		// Semi-uniform block
+		vb.clear_channel(channel_index, rng.rand() % 256);
+		const int ymax = rng.rand() % vb.get_size().y;
+		vb.fill_area(rng.rand() % 256, Vector3i(), Vector3i(size, ymax, size), channel_index);
+
+	} else {
+		// Noisy block, doesn't compress well
+		for (unsigned int z = 0; z < size; ++z) {
+			for (unsigned int x = 0; x < size; ++x) {
+				for (unsigned int y = 0; y < size; ++y) {
+					vb.set_voxel(rng.rand() % 256, x, y, z, channel_index);
+				}
+			}
+		}
+	}
+}
+
+void run_voxel_benchmarks(const String &filter, const String &output_path) {
+	print_line("------------ Voxel benchmarks begin -------------");
+
+	BenchmarkRunner runner;
+	runner.set_filter(to_std_string(filter));
+
+	run_storage_benchmarks(runner);
+	run_edition_benchmarks(runner);
+	run_stream_benchmarks(runner);
+	run_mesher_benchmarks(runner);
+	run_detail_rendering_benchmarks(runner);
+	run_generator_benchmarks(runner);
+	run_task_benchmarks(runner);
+	run_navigation_benchmarks(runner);
+
+	runner.print_results();
+
+	if (!output_path.is_empty()) {
+		if (runner.save_json(output_path)) {
+			print_line(format("Saved benchmark results to {}", to_std_string(output_path)));
+		}
+	}
+
+	print_line("------------ Voxel benchmarks end -------------");
+}
+
+} // namespace zylann::voxel::benchmarks
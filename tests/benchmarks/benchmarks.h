@@ -0,0 +1,52 @@
+#ifndef VOXEL_BENCHMARKS_H
+#define VOXEL_BENCHMARKS_H
+
+#include "../../util/godot/classes/ref_counted.h"
+#include "../../util/godot/core/string.h"
+#include "../../util/godot/macros.h"
+#include "../../util/math/vector3i.h"
+
+ZN_GODOT_FORWARD_DECLARE(class RandomPCG);
+
+namespace zylann::voxel {
+
+class VoxelBuffer;
+class VoxelGeneratorGraph;
+
+namespace benchmarks {
+
+class BenchmarkRunner;
+
+// Runs benchmarks whose name contains `filter` (all of them if empty), prints results, and saves them as JSON if
+// `output_path` is not empty.
+void run_voxel_benchmarks(const String &filter, const String &output_path);
+
+// Datasets. They are always generated the same way, so results can be compared between runs.
+
+static const uint64_t DATASET_SEED = 131183;
+
+Ref<VoxelGeneratorGraph> create_terrain_generator();
+// SDF of a bumpy terrain around Y=0, in the SDF channel
+void create_terrain_sdf(VoxelBuffer &vb, Vector3i size, Vector3i origin);
+// Blocky terrain with caves, using types 0 (air) and 1 in the TYPE channel
+void create_terrain_blocky(VoxelBuffer &vb, Vector3i size, Vector3i origin);
+// Same as blocky terrain, with a few different colors in the COLOR channel
+void create_terrain_colored(VoxelBuffer &vb, Vector3i size, Vector3i origin);
+// Block that is either uniform, partially filled or noisy, like what is found when saving terrains
+void create_random_block(VoxelBuffer &vb, unsigned int size, RandomPCG &rng);
+
+// Subsystems
+
+void run_storage_benchmarks(BenchmarkRunner &runner);
+void run_edition_benchmarks(BenchmarkRunner &runner);
+void run_stream_benchmarks(BenchmarkRunner &runner);
+void run_mesher_benchmarks(BenchmarkRunner &runner);
+void run_detail_rendering_benchmarks(BenchmarkRunner &runner);
+void run_generator_benchmarks(BenchmarkRunner &runner);
+void run_task_benchmarks(BenchmarkRunner &runner);
+void run_navigation_benchmarks(BenchmarkRunner &runner);
+
+} // namespace benchmarks
+} // namespace zylann::voxel
+
+#endif // VOXEL_BENCHMARKS_H
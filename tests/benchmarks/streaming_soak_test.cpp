@@ -0,0 +1,391 @@
+#include "streaming_soak_test.h"
+#include "../../engine/voxel_engine.h"
+#include "../../generators/graph/voxel_generator_graph.h"
+#include "../../meshers/transvoxel/voxel_mesher_transvoxel.h"
+#include "../../storage/voxel_memory_pool.h"
+#include "../../streams/sqlite/voxel_stream_sqlite.h"
+#include "../../terrain/fixed_lod/voxel_terrain.h"
+#include "../../terrain/variable_lod/voxel_lod_terrain.h"
+#include "../../terrain/voxel_viewer.h"
+#include "../../util/godot/classes/json.h"
+#include "../../util/godot/classes/os.h"
+#include "../../util/godot/classes/resource_loader.h"
+#include "../../util/godot/classes/scene_tree.h"
+#include "../../util/godot/classes/time.h"
+#include "../../util/godot/classes/window.h"
+#include "../../util/godot/core/array.h"
+#include "../../util/godot/macros.h"
+#include "../../util/io/log.h"
+#include "../../util/math/conv.h"
+#include "../../util/math/funcs.h"
+#include "../../util/string/format.h"
+#include "benchmark_runner.h"
+#include "benchmarks.h"
+#include <algorithm>
+
+namespace zylann::voxel::benchmarks {
+
+namespace {
+
+// Consecutive frames without any pending task after which the terrain is considered loaded.
+// Terrains only request blocks when they process, so a single idle frame isn't enough.
+const unsigned int SETTLED_FRAME_COUNT = 10;
+
+const char *g_scenario_names[StreamingSoakTestParams::SCENARIO_COUNT] = {
+	"flight", //
+	"teleport", //
+	"crowd" //
+};
+
+StreamingSoakTestParams g_scheduled_params;
+
+void start_scheduled_streaming_soak_test() {
+	SceneTree *tree = SceneTree::get_singleton();
+	ZN_ASSERT_RETURN_MSG(tree != nullptr, "Streaming soak test requires a SceneTree");
+
+	StreamingSoakTest *test = memnew(StreamingSoakTest);
+	test->set_name("VoxelStreamingSoakTest");
+	test->setup(g_scheduled_params);
+	tree->get_root()->add_child(test);
+}
+
+template <typename T>
+Ref<T> load_resource_or_null(const String &path) {
+	if (path.is_empty()) {
+		return Ref<T>();
+	}
+	Ref<T> res = zylann::godot::load_resource(path);
+	ERR_FAIL_COND_V_MSG(res.is_null(), res, String("Could not load {0}").format(varray(path)));
+	return res;
+}
+
+uint32_t get_percentile(Span<const uint32_t> sorted_values, float p) {
+	if (sorted_values.size() == 0) {
+		return 0;
+	}
+	const size_t i = math::min(size_t(p * sorted_values.size()), sorted_values.size() - 1);
+	return sorted_values[i];
+}
+
+double get_rate(uint64_t count, double seconds) {
+	return seconds > 0.0 ? count / seconds : 0.0;
+}
+
+} // namespace
+
+bool StreamingSoakTestParams::parse_scenario(const String &name, Scenario &out_scenario) {
+	for (unsigned int i = 0; i < SCENARIO_COUNT; ++i) {
+		if (name == g_scenario_names[i]) {
+			out_scenario = Scenario(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void schedule_streaming_soak_test(const StreamingSoakTestParams &params) {
+	g_scheduled_params = params;
+	// The scene tree doesn't exist yet when modules are initialized
+	callable_mp_static(&start_scheduled_streaming_soak_test).call_deferred();
+}
+
+StreamingSoakTest::StreamingSoakTest() {
+	_rng.seed(DATASET_SEED);
+}
+
+void StreamingSoakTest::setup(const StreamingSoakTestParams &params) {
+	ZN_ASSERT_RETURN(_terrain == nullptr);
+	_params = params;
+
+	Ref<VoxelGenerator> generator = load_resource_or_null<VoxelGenerator>(params.generator_path);
+	if (generator.is_null()) {
+		generator = create_terrain_generator();
+	}
+
+	Ref<VoxelStream> stream = load_resource_or_null<VoxelStream>(params.stream_path);
+	if (stream.is_null()) {
+		// Saving generated blocks so the test also covers writing to a stream
+		Ref<VoxelStreamSQLite> sqlite;
+		sqlite.instantiate();
+		sqlite->set_database_path(_test_dir.get_path().path_join("streaming_soak_test.sqlite"));
+		sqlite->set_save_generator_output(true);
+		stream = sqlite;
+	}
+
+	Ref<VoxelMesher> mesher = load_resource_or_null<VoxelMesher>(params.mesher_path);
+	if (mesher.is_null()) {
+		mesher = Ref<VoxelMesher>(memnew(VoxelMesherTransvoxel));
+	}
+
+	if (params.use_lod_terrain) {
+		VoxelLodTerrain *terrain = memnew(VoxelLodTerrain);
+		terrain->set_view_distance(params.view_distance);
+		_terrain = terrain;
+	} else {
+		VoxelTerrain *terrain = memnew(VoxelTerrain);
+		terrain->set_max_view_distance(params.view_distance);
+		_terrain = terrain;
+	}
+	_terrain->set_generator(generator);
+	_terrain->set_stream(stream);
+	_terrain->set_mesher(mesher);
+	add_child(_terrain);
+
+	unsigned int viewer_count = params.viewer_count;
+	float speed = 0.f;
+	float spread = 0.f;
+	switch (params.scenario) {
+		case StreamingSoakTestParams::SCENARIO_FLIGHT:
+			viewer_count = viewer_count == 0 ? 1 : viewer_count;
+			speed = 40.f;
+			spread = 256.f;
+			break;
+		case StreamingSoakTestParams::SCENARIO_TELEPORT:
+			viewer_count = viewer_count == 0 ? 1 : viewer_count;
+			break;
+		case StreamingSoakTestParams::SCENARIO_CROWD:
+			viewer_count = viewer_count == 0 ? 16 : viewer_count;
+			speed = 4.f;
+			spread = 1024.f;
+			break;
+		default:
+			ZN_PRINT_ERROR("Unknown scenario");
+			break;
+	}
+
+	for (unsigned int i = 0; i < viewer_count; ++i) {
+		Viewer viewer;
+		viewer.origin = Vector3f( //
+				spread * (2.f * _rng.randf() - 1.f),
+				20.f,
+				spread * (2.f * _rng.randf() - 1.f)
+		);
+		const float angle = math::TAU_32 * _rng.randf();
+		viewer.velocity = speed * Vector3f(Math::cos(angle), 0.f, Math::sin(angle));
+
+		viewer.node = memnew(VoxelViewer);
+		viewer.node->set_view_distance(params.view_distance);
+		viewer.node->set_position(to_vec3(viewer.origin));
+		add_child(viewer.node);
+
+		_viewers.push_back(viewer);
+	}
+
+	set_process(true);
+}
+
+void StreamingSoakTest::_notification(int p_what) {
+	switch (p_what) {
+		case NOTIFICATION_PROCESS:
+			process();
+			break;
+
+		default:
+			break;
+	}
+}
+
+StreamingSoakTest::Totals StreamingSoakTest::get_engine_totals() {
+	const VoxelEngine::Stats stats = VoxelEngine::get_singleton().get_stats();
+	Totals totals;
+	totals.generated_blocks = stats.generated_blocks;
+	totals.meshed_blocks = stats.meshed_blocks;
+	totals.loaded_blocks = stats.loaded_blocks;
+	totals.saved_blocks = stats.saved_blocks;
+	return totals;
+}
+
+void StreamingSoakTest::process() {
+	if (_phase == PHASE_DONE) {
+		return;
+	}
+
+	const uint64_t now_usec = Time::get_singleton()->get_ticks_usec();
+
+	if (_start_usec == 0) {
+		_start_usec = now_usec;
+		_start_totals = get_engine_totals();
+		start_loading("initial", now_usec);
+	} else {
+		_frame_times_usec.push_back(now_usec - _last_frame_usec);
+	}
+	_last_frame_usec = now_usec;
+
+	_peak_voxel_memory = math::max(_peak_voxel_memory, VoxelMemoryPool::get_singleton().debug_get_used_memory());
+
+	switch (_phase) {
+		case PHASE_LOADING: {
+			const uint64_t timeout_usec = _params.load_timeout_seconds * 1'000'000.0;
+			if (update_settled(now_usec)) {
+				const float seconds = (_idle_since_usec - _phase_start_usec) / 1'000'000.0;
+				_load_measurements.push_back(LoadMeasurement{ _loading_name, seconds, true });
+				start_next_step(now_usec);
+
+			} else if (now_usec - _phase_start_usec > timeout_usec) {
+				const float seconds = (now_usec - _phase_start_usec) / 1'000'000.0;
+				_load_measurements.push_back(LoadMeasurement{ _loading_name, seconds, false });
+				ZN_PRINT_WARNING(format("Terrain did not finish loading after {} seconds", seconds));
+				start_next_step(now_usec);
+			}
+		} break;
+
+		case PHASE_MOVING: {
+			const float t = (now_usec - _phase_start_usec) / 1'000'000.0;
+			const bool end = t >= _params.move_duration_seconds;
+			for (Viewer &viewer : _viewers) {
+				const Vector3f pos = viewer.origin + viewer.velocity * t;
+				viewer.node->set_position(to_vec3(pos));
+				if (end) {
+					viewer.origin = pos;
+				}
+			}
+			if (end) {
+				// Measure how long it takes to catch up once viewers stop
+				start_loading("after_moving", now_usec);
+			}
+		} break;
+
+		default:
+			break;
+	}
+}
+
+bool StreamingSoakTest::update_settled(uint64_t now_usec) {
+	const VoxelEngine::Stats stats = VoxelEngine::get_singleton().get_stats();
+	bool idle = stats.generation_tasks == 0 && stats.meshing_tasks == 0 && stats.streaming_tasks == 0 &&
+			stats.main_thread_tasks == 0;
+
+	const VoxelLodTerrain *lod_terrain = Object::cast_to<VoxelLodTerrain>(_terrain);
+	if (lod_terrain != nullptr) {
+		idle = idle && lod_terrain->get_stats().blocked_lods == 0;
+	}
+
+	if (!idle) {
+		_idle_frame_count = 0;
+		return false;
+	}
+	if (_idle_frame_count == 0) {
+		_idle_since_usec = now_usec;
+	}
+	++_idle_frame_count;
+	return _idle_frame_count >= SETTLED_FRAME_COUNT;
+}
+
+void StreamingSoakTest::start_loading(const char *name, uint64_t now_usec) {
+	_phase = PHASE_LOADING;
+	_phase_start_usec = now_usec;
+	_loading_name = name;
+	_idle_frame_count = 0;
+}
+
+void StreamingSoakTest::start_next_step(uint64_t now_usec) {
+	++_step;
+
+	if (_params.scenario == StreamingSoakTestParams::SCENARIO_TELEPORT) {
+		if (_step > _params.teleport_count) {
+			finish();
+			return;
+		}
+		// Far enough that nothing loaded previously can be reused
+		const float distance = 4096.f;
+		for (Viewer &viewer : _viewers) {
+			viewer.origin = Vector3f( //
+					distance * (2.f * _rng.randf() - 1.f),
+					20.f,
+					distance * (2.f * _rng.randf() - 1.f)
+			);
+			viewer.node->set_position(to_vec3(viewer.origin));
+		}
+		start_loading("teleport", now_usec);
+
+	} else {
+		if (_step == 1) {
+			_phase = PHASE_MOVING;
+			_phase_start_usec = now_usec;
+		} else {
+			finish();
+		}
+	}
+}
+
+void StreamingSoakTest::finish() {
+	_phase = PHASE_DONE;
+	_end_usec = Time::get_singleton()->get_ticks_usec();
+	_end_totals = get_engine_totals();
+	set_process(false);
+
+	const Dictionary results = get_results();
+
+	print_line("------------ Voxel streaming soak test results -------------");
+	print_line(zylann::godot::to_std_string(JSON::stringify(results, "\t", true)));
+
+	if (!_params.output_path.is_empty()) {
+		if (save_results_json(results, _params.output_path)) {
+			print_line(format(
+					"Saved streaming soak test results to {}", zylann::godot::to_std_string(_params.output_path)
+			));
+		}
+	}
+
+	get_tree()->quit();
+}
+
+Dictionary StreamingSoakTest::get_results() const {
+	Dictionary d;
+	add_environment_info(d);
+
+	d["scenario"] = g_scenario_names[_params.scenario];
+	d["terrain"] = _terrain->get_class();
+	d["viewer_count"] = static_cast<int64_t>(_viewers.size());
+	d["view_distance"] = _params.view_distance;
+
+	const double duration = (_end_usec - _start_usec) / 1'000'000.0;
+	d["duration_seconds"] = duration;
+
+	Array load_times;
+	for (const LoadMeasurement &m : _load_measurements) {
+		Dictionary md;
+		md["name"] = m.name;
+		md["seconds"] = m.seconds;
+		md["settled"] = m.settled;
+		load_times.append(md);
+	}
+	d["load_times"] = load_times;
+
+	const uint64_t generated = _end_totals.generated_blocks - _start_totals.generated_blocks;
+	const uint64_t meshed = _end_totals.meshed_blocks - _start_totals.meshed_blocks;
+	const uint64_t loaded = _end_totals.loaded_blocks - _start_totals.loaded_blocks;
+	const uint64_t saved = _end_totals.saved_blocks - _start_totals.saved_blocks;
+
+	Dictionary blocks;
+	blocks["generated"] = generated;
+	blocks["meshed"] = meshed;
+	blocks["loaded"] = loaded;
+	blocks["saved"] = saved;
+	blocks["generated_per_second"] = get_rate(generated, duration);
+	blocks["meshed_per_second"] = get_rate(meshed, duration);
+	blocks["loaded_per_second"] = get_rate(loaded, duration);
+	blocks["saved_per_second"] = get_rate(saved, duration);
+	d["blocks"] = blocks;
+
+	Dictionary memory;
+	memory["peak_voxel_memory"] = ZN_SIZE_T_TO_VARIANT(_peak_voxel_memory);
+	memory["peak_static_memory"] = OS::get_singleton()->get_static_memory_peak_usage();
+	d["memory"] = memory;
+
+	StdVector<uint32_t> sorted_frame_times = _frame_times_usec;
+	std::sort(sorted_frame_times.begin(), sorted_frame_times.end());
+	Span<const uint32_t> sorted_frame_times_s = to_span(sorted_frame_times);
+
+	Dictionary frame_times;
+	frame_times["count"] = static_cast<int64_t>(sorted_frame_times.size());
+	frame_times["p50"] = get_percentile(sorted_frame_times_s, 0.5f);
+	frame_times["p90"] = get_percentile(sorted_frame_times_s, 0.9f);
+	frame_times["p99"] = get_percentile(sorted_frame_times_s, 0.99f);
+	frame_times["max"] = sorted_frame_times.size() > 0 ? sorted_frame_times.back() : 0;
+	d["frame_time_usec"] = frame_times;
+
+	return d;
+}
+
+} // namespace zylann::voxel::benchmarks
@@ -0,0 +1,129 @@
+#ifndef VOXEL_STREAMING_SOAK_TEST_H
+#define VOXEL_STREAMING_SOAK_TEST_H
+
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/classes/node_3d.h"
+#include "../../util/godot/core/dictionary.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/math/vector3f.h"
+#include "../testing.h"
+
+namespace zylann::voxel {
+
+class VoxelNode;
+class VoxelViewer;
+
+namespace benchmarks {
+
+// Measures end-to-end streaming of a terrain with synthetic viewers, without needing a game.
+// Meant to be run in a headless instance of Godot, in which case it quits when the test is over.
+struct StreamingSoakTestParams {
+	enum Scenario {
+		// Viewers fly in straight lines over the terrain
+		SCENARIO_FLIGHT,
+		// Viewers repeatedly teleport to random places once everything around them is loaded
+		SCENARIO_TELEPORT,
+		// Many viewers walk slowly in different places
+		SCENARIO_CROWD,
+		SCENARIO_COUNT
+	};
+
+	Scenario scenario = SCENARIO_FLIGHT;
+	bool use_lod_terrain = true;
+	// Resource paths. If empty, defaults are used.
+	String generator_path;
+	String stream_path;
+	String mesher_path;
+	// If not empty, results are saved as JSON to this path
+	String output_path;
+	// If 0, the scenario decides
+	unsigned int viewer_count = 0;
+	int view_distance = 256;
+	// How long viewers move, in scenarios where they do
+	float move_duration_seconds = 30.f;
+	// How long to wait for the terrain to load before giving up
+	float load_timeout_seconds = 120.f;
+	unsigned int teleport_count = 5;
+
+	static bool parse_scenario(const String &name, Scenario &out_scenario);
+};
+
+// Starts the test when the scene tree starts running. Call before the main loop starts.
+void schedule_streaming_soak_test(const StreamingSoakTestParams &params);
+
+class StreamingSoakTest : public Node3D {
+	GDCLASS(StreamingSoakTest, Node3D)
+public:
+	StreamingSoakTest();
+
+	void setup(const StreamingSoakTestParams &params);
+
+private:
+	void _notification(int p_what);
+
+	void process();
+	bool update_settled(uint64_t now_usec);
+	void start_loading(const char *name, uint64_t now_usec);
+	void start_next_step(uint64_t now_usec);
+	void finish();
+	Dictionary get_results() const;
+
+	static void _bind_methods() {}
+
+	enum Phase { //
+		PHASE_LOADING,
+		PHASE_MOVING,
+		PHASE_DONE
+	};
+
+	struct Viewer {
+		VoxelViewer *node = nullptr;
+		Vector3f origin;
+		Vector3f velocity;
+	};
+
+	// Time taken until everything around viewers was loaded and meshed
+	struct LoadMeasurement {
+		const char *name;
+		float seconds;
+		bool settled;
+	};
+
+	struct Totals {
+		uint64_t generated_blocks = 0;
+		uint64_t meshed_blocks = 0;
+		uint64_t loaded_blocks = 0;
+		uint64_t saved_blocks = 0;
+	};
+
+	static Totals get_engine_totals();
+
+	StreamingSoakTestParams _params;
+	VoxelNode *_terrain = nullptr;
+	StdVector<Viewer> _viewers;
+	RandomPCG _rng;
+
+	Phase _phase = PHASE_LOADING;
+	unsigned int _step = 0;
+	const char *_loading_name = "";
+	uint64_t _phase_start_usec = 0;
+	uint64_t _idle_since_usec = 0;
+	unsigned int _idle_frame_count = 0;
+
+	uint64_t _start_usec = 0;
+	uint64_t _last_frame_usec = 0;
+	StdVector<uint32_t> _frame_times_usec;
+	StdVector<LoadMeasurement> _load_measurements;
+	Totals _start_totals;
+	Totals _end_totals;
+	uint64_t _end_usec = 0;
+	size_t _peak_voxel_memory = 0;
+
+	// Used when no stream is specified
+	zylann::testing::TestDirectory _test_dir;
+};
+
+} // namespace benchmarks
+} // namespace zylann::voxel
+
+#endif // VOXEL_STREAMING_SOAK_TEST_H
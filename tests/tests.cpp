@@ -3,6 +3,7 @@
 #include "testing.h"
 
 #include "util/test_box3i.h"
+#include "util/test_builtin_profiler.h"
 #include "util/test_container_funcs.h"
 #include "util/test_expression_parser.h"
 #include "util/test_flat_map.h"
@@ -13,19 +14,26 @@
 #include "util/test_threaded_task_runner.h"
 
 #include "voxel/test_block_serializer.h"
+#include "voxel/test_collision_simplification.h"
 #include "voxel/test_curve_range.h"
+#include "voxel/test_detail_rendering.h"
 #include "voxel/test_detail_rendering_gpu.h"
 #include "voxel/test_edition_funcs.h"
+#include "voxel/test_hierarchical_path_finder.h"
 #include "voxel/test_mesh_sdf.h"
+#include "voxel/test_multipass_column_cache.h"
 #include "voxel/test_octree.h"
 #include "voxel/test_region_file.h"
 #include "voxel/test_storage_funcs.h"
 #include "voxel/test_stream_sqlite.h"
+#include "voxel/test_vox_scene.h"
 #include "voxel/test_voxel_buffer.h"
 #include "voxel/test_voxel_data_map.h"
 #include "voxel/test_voxel_graph.h"
 #include "voxel/test_voxel_instancer.h"
+#include "voxel/test_voxel_memory_pool.h"
 #include "voxel/test_voxel_mesher_cubes.h"
+#include "voxel/test_voxel_mesher_dmc.h"
 
 #ifdef VOXEL_ENABLE_FAST_NOISE_2
 #include "fast_noise_2/test_fast_noise_2.h"
@@ -53,6 +61,7 @@ void run_voxel_tests() {
 	VOXEL_TEST(test_voxel_data_map_paste_fill);
 	VOXEL_TEST(test_voxel_data_map_paste_mask);
 	VOXEL_TEST(test_voxel_data_map_copy);
+	VOXEL_TEST(test_voxel_data_evict_blocks);
 	VOXEL_TEST(test_encode_weights_packed_u16);
 	VOXEL_TEST(test_copy_3d_region_zxy);
 	VOXEL_TEST(test_voxel_graph_invalid_connection);
@@ -95,31 +104,59 @@ void run_voxel_tests() {
 	VOXEL_TEST(test_voxel_buffer_create);
 	VOXEL_TEST(test_block_serializer);
 	VOXEL_TEST(test_block_serializer_stream_peer);
+	VOXEL_TEST(test_block_delta);
+	VOXEL_TEST(test_block_serializer_v5);
+	VOXEL_TEST(test_block_serializer_v4_compatibility);
+	VOXEL_TEST(test_block_serializer_terrain_round_trip);
 	VOXEL_TEST(test_region_file);
+	VOXEL_TEST(test_region_file_free_list_and_compaction);
 	VOXEL_TEST(test_voxel_stream_region_files);
+	VOXEL_TEST(test_multipass_column_cache);
+	VOXEL_TEST(test_vox_scene_model_instances);
+	VOXEL_TEST(test_vox_scene_load_to_stream);
+	VOXEL_TEST(test_vox_scene_load_to_terrain);
 #ifdef VOXEL_ENABLE_FAST_NOISE_2
 	VOXEL_TEST(test_fast_noise_2_basic);
 	VOXEL_TEST(test_fast_noise_2_empty_encoded_node_tree);
 #endif
 	VOXEL_TEST(test_run_blocky_random_tick);
+	VOXEL_TEST(test_run_blocky_random_tick_batched);
+	VOXEL_TEST(test_cellular_automaton_falling);
+	VOXEL_TEST(test_cellular_automaton_fluid);
+	VOXEL_TEST(test_blocky_lighting);
+	VOXEL_TEST(test_collision_queries_blocky);
+	VOXEL_TEST(test_collision_queries_sdf);
+	VOXEL_TEST(test_hierarchical_path_finder);
 	VOXEL_TEST(test_flat_map);
 	VOXEL_TEST(test_expression_parser);
 	VOXEL_TEST(test_voxel_buffer_metadata);
 	VOXEL_TEST(test_voxel_buffer_metadata_gd);
+	VOXEL_TEST(test_voxel_buffer_metadata_area);
 	VOXEL_TEST(test_voxel_mesher_cubes);
+	VOXEL_TEST(test_voxel_mesher_cubes_shared_atlas);
+	VOXEL_TEST(test_voxel_mesher_dmc_parallel_octants);
+	VOXEL_TEST(test_collision_merge_quads);
+	VOXEL_TEST(test_collision_decimation);
 	VOXEL_TEST(test_threaded_task_runner_misc);
 	VOXEL_TEST(test_threaded_task_runner_debug_names);
 	VOXEL_TEST(test_task_priority_values);
 	VOXEL_TEST(test_voxel_mesh_sdf_issue463);
 	VOXEL_TEST(test_normalmap_render_gpu);
+	VOXEL_TEST(test_normalmap_render_cpu);
 	VOXEL_TEST(test_slot_map);
 	VOXEL_TEST(test_box_blur);
 	VOXEL_TEST(test_threaded_task_postponing);
+	VOXEL_TEST(test_parallel_for);
 	VOXEL_TEST(test_spatial_lock_misc);
 	VOXEL_TEST(test_spatial_lock_spam);
 	VOXEL_TEST(test_spatial_lock_dependent_map_chunks);
+	VOXEL_TEST(test_spatial_lock_contention);
+	VOXEL_TEST(test_builtin_profiler);
 	VOXEL_TEST(test_discord_soakil_copypaste);
 	VOXEL_TEST(test_voxel_stream_sqlite_basic);
+	VOXEL_TEST(test_voxel_stream_sqlite_migration_from_v0);
+	VOXEL_TEST(test_voxel_stream_sqlite_load_area);
+	VOXEL_TEST(test_voxel_memory_pool_thread_caches);
 
 	print_line("------------ Voxel tests end -------------");
 }
@@ -0,0 +1,101 @@
+#include "test_builtin_profiler.h"
+#include "../../util/profiling.h"
+#include "../../util/string/std_string.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_builtin_profiler() {
+#ifdef ZN_BUILTIN_PROFILER_ENABLED
+	const bool was_enabled = profiler::is_enabled();
+	const unsigned int prev_events_per_thread = profiler::get_events_per_thread();
+
+	profiler::clear();
+
+	{
+		// Not recorded when disabled
+		profiler::set_enabled(false);
+		ZN_PROFILE_SCOPE_NAMED("test_builtin_profiler_disabled");
+	}
+
+	profiler::set_enabled(true);
+	{
+		ZN_PROFILE_SCOPE_NAMED("test_builtin_profiler_main");
+		ZN_PROFILE_PLOT("test_builtin_profiler_plot", 42);
+	}
+
+	Thread thread;
+	thread.start(
+			[](void *userdata) {
+				ZN_PROFILE_SET_THREAD_NAME("test_builtin_profiler_thread");
+				ZN_PROFILE_SCOPE_NAMED("test_builtin_profiler_thread_scope");
+			},
+			nullptr
+	);
+	thread.wait_to_finish();
+
+	// Small buffer, so we can check that only the most recent events are kept. The main thread already has a buffer,
+	// like engine threads naming themselves at startup, so it has to be resized.
+	profiler::set_events_per_thread(4);
+	{
+		const char *names[] = {
+			"test_builtin_profiler_scope0", //
+			"test_builtin_profiler_scope1", //
+			"test_builtin_profiler_scope2", //
+			"test_builtin_profiler_scope3", //
+			"test_builtin_profiler_scope4", //
+			"test_builtin_profiler_scope5", //
+		};
+		for (const char *name : names) {
+			ZN_PROFILE_SCOPE_NAMED(name);
+		}
+	}
+
+	profiler::set_enabled(false);
+
+	StdString trace;
+	profiler::get_chrome_trace(trace);
+
+	ZN_TEST_ASSERT(trace.find("\"traceEvents\"") != StdString::npos);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_disabled") == StdString::npos);
+	// Dropped when the buffer of the main thread got resized
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_main") == StdString::npos);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_plot") == StdString::npos);
+	// The other thread didn't record anything since then, so it still has its events
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_thread") != StdString::npos);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_thread_scope") != StdString::npos);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_scope0") == StdString::npos);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_scope1") == StdString::npos);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_scope2") != StdString::npos);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_scope5") != StdString::npos);
+
+	// The buffer of the thread that exited is reused by the next one, instead of allocating another
+	profiler::set_enabled(true);
+	Thread thread2;
+	thread2.start(
+			[](void *userdata) {
+				ZN_PROFILE_SET_THREAD_NAME("test_builtin_profiler_reusing_thread");
+				ZN_PROFILE_SCOPE_NAMED("test_builtin_profiler_reusing_thread_scope");
+			},
+			nullptr
+	);
+	thread2.wait_to_finish();
+	profiler::set_enabled(false);
+
+	trace.clear();
+	profiler::get_chrome_trace(trace);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_reusing_thread_scope") != StdString::npos);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_thread_scope") == StdString::npos);
+
+	profiler::clear();
+	trace.clear();
+	profiler::get_chrome_trace(trace);
+	ZN_TEST_ASSERT(trace.find("test_builtin_profiler_scope5") == StdString::npos);
+
+	profiler::set_events_per_thread(prev_events_per_thread);
+	profiler::set_enabled(was_enabled);
+#endif
+}
+
+} // namespace zylann::tests
@@ -0,0 +1,10 @@
+#ifndef ZN_TEST_BUILTIN_PROFILER_H
+#define ZN_TEST_BUILTIN_PROFILER_H
+
+namespace zylann::tests {
+
+void test_builtin_profiler();
+
+} // namespace zylann::tests
+
+#endif // ZN_TEST_BUILTIN_PROFILER_H
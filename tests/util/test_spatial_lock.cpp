@@ -6,6 +6,7 @@
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "../../util/tasks/threaded_task_runner.h"
+#include "../../util/thread/mutex.h"
 #include "../../util/thread/spatial_lock_3d.h"
 #include "../testing.h"
 
@@ -438,4 +439,111 @@ void test_spatial_lock_dependent_map_chunks() {
 #endif
 }
 
+void test_spatial_lock_contention() {
+	// Many threads lock small boxes in a large area, like tasks generating, meshing and editing blocks of a terrain
+	// around viewers. Each thread works around its own moving location, so some of them overlap at times. Checks that
+	// boxes are still exclusive when they are spread across shards, and when there is a single shard.
+
+	static const unsigned int MOVE_COUNT = 50;
+	static const unsigned int LOCKS_PER_MOVE = 100;
+	static const int AREA_SIZE_XZ = 64;
+	static const int AREA_SIZE_Y = 16;
+	static const unsigned int WORK_ITERATIONS = 20;
+
+	struct Context {
+		SpatialLock3D *spatial_lock;
+		// Cells are filled with a value unique to each write. Readers and writers check nobody else modified them
+		// while they had the lock.
+		StdVector<uint32_t> *cells;
+		unsigned int thread_index;
+		uint32_t lock_count;
+	};
+
+	struct L {
+		static inline unsigned int get_index(Vector3i pos) {
+			return Vector3iUtil::get_zxy_index(pos, Vector3i(AREA_SIZE_XZ, AREA_SIZE_Y, AREA_SIZE_XZ));
+		}
+
+		static void thread_func(void *userdata) {
+			Context &ctx = *static_cast<Context *>(userdata);
+			SpatialLock3D &spatial_lock = *ctx.spatial_lock;
+			StdVector<uint32_t> &cells = *ctx.cells;
+
+			RandomPCG rng;
+			rng.seed(ctx.thread_index + 1);
+
+			const Box3i area(Vector3i(), Vector3i(AREA_SIZE_XZ, AREA_SIZE_Y, AREA_SIZE_XZ));
+			Vector3i center(rng.rand(AREA_SIZE_XZ), AREA_SIZE_Y / 2, rng.rand(AREA_SIZE_XZ));
+
+			for (unsigned int move_index = 0; move_index < MOVE_COUNT; ++move_index) {
+				for (unsigned int i = 0; i < LOCKS_PER_MOVE; ++i) {
+					const Vector3i pos = center + Vector3i(rng.rand(9) - 4, rng.rand(9) - 4, rng.rand(9) - 4);
+					const Box3i box = Box3i(pos, Vector3i(1 + rng.rand(3), 1 + rng.rand(3), 1 + rng.rand(3)))
+											  .clipped(area);
+					if (box.is_empty()) {
+						continue;
+					}
+
+					if (rng.rand(100) < 80) {
+						SpatialLock3D::Read srlock(spatial_lock, box);
+						const uint32_t v0 = cells[get_index(box.position)];
+						for (unsigned int j = 0; j < WORK_ITERATIONS; ++j) {
+							ZN_TEST_ASSERT(cells[get_index(box.position)] == v0);
+						}
+
+					} else {
+						SpatialLock3D::Write swlock(spatial_lock, box);
+						const uint32_t tag = (ctx.thread_index << 24) | (ctx.lock_count & 0xffffff);
+						for (unsigned int j = 0; j < WORK_ITERATIONS; ++j) {
+							box.for_each_cell([&cells, tag](Vector3i cpos) { cells[get_index(cpos)] = tag; });
+						}
+						ZN_TEST_ASSERT(box.all_cells_match([&cells, tag](Vector3i cpos) { //
+							return cells[get_index(cpos)] == tag;
+						}));
+					}
+
+					++ctx.lock_count;
+				}
+
+				// Move around
+				center.x = math::clamp(center.x + rng.rand(3) - 1, 0, AREA_SIZE_XZ - 1);
+				center.z = math::clamp(center.z + rng.rand(3) - 1, 0, AREA_SIZE_XZ - 1);
+			}
+		}
+
+		static void run(unsigned int shard_count) {
+			SpatialLock3D spatial_lock(shard_count);
+			StdVector<uint32_t> cells;
+			cells.resize(AREA_SIZE_XZ * AREA_SIZE_Y * AREA_SIZE_XZ, 0);
+
+			FixedArray<Thread, 15> threads; // Excluding main thread
+			FixedArray<Context, 16> contexts;
+			const unsigned int main_thread_index = contexts.size() - 1;
+
+			for (unsigned int thread_index = 0; thread_index < contexts.size(); ++thread_index) {
+				contexts[thread_index] = Context{ &spatial_lock, &cells, thread_index, 0 };
+			}
+			for (unsigned int thread_index = 0; thread_index < threads.size(); ++thread_index) {
+				threads[thread_index].start(thread_func, &contexts[thread_index]);
+			}
+
+			thread_func(&contexts[main_thread_index]);
+
+			for (unsigned int thread_index = 0; thread_index < threads.size(); ++thread_index) {
+				threads[thread_index].wait_to_finish();
+			}
+
+			ZN_TEST_ASSERT(spatial_lock.get_locked_boxes_count() == 0);
+
+			for (const Context &ctx : contexts) {
+				// Some boxes may be skipped when clipped out of the area
+				ZN_TEST_ASSERT(ctx.lock_count > 0 && ctx.lock_count <= MOVE_COUNT * LOCKS_PER_MOVE);
+			}
+		}
+	};
+
+	L::run(1);
+	L::run(SpatialLock3D::DEFAULT_SHARD_COUNT);
+}
+
 } // namespace zylann::tests
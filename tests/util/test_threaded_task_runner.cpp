@@ -9,6 +9,7 @@
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "../../util/string/std_stringstream.h"
+#include "../../util/tasks/parallel_for.h"
 #include "../../util/tasks/threaded_task_runner.h"
 #include "../testing.h"
 
@@ -457,4 +458,53 @@ void test_threaded_task_postponing() {
 #endif
 }
 
+void test_parallel_for() {
+	const unsigned int test_thread_count = 4;
+
+	// Scheduling callbacks can't capture anything
+	static ThreadedTaskRunner *s_runner = nullptr;
+	ThreadedTaskRunner runner;
+	runner.set_thread_count(test_thread_count);
+	runner.set_name("Test");
+	s_runner = &runner;
+
+	const ScheduleParallelTasksCallback schedule_tasks = [](Span<IThreadedTask *> tasks) {
+		s_runner->enqueue(tasks, false);
+	};
+
+	const unsigned int count = 1000;
+	StdVector<uint32_t> values;
+	values.resize(count, 0);
+	std::atomic_uint32_t call_count = { 0 };
+
+	parallel_for(count, 10, test_thread_count, schedule_tasks, [&values, &call_count](unsigned int i) {
+		// Make indices take some time, so helpers get a chance to take part
+		if ((i % 100) == 0) {
+			Thread::sleep_usec(1000);
+		}
+		values[i] += i + 1;
+		++call_count;
+	});
+
+	// Every index must have been processed exactly once by the time it returns
+	ZN_TEST_ASSERT(call_count == count);
+	for (unsigned int i = 0; i < count; ++i) {
+		ZN_TEST_ASSERT(values[i] == i + 1);
+	}
+
+	// Not enough indices for helpers to be worth it
+	parallel_for(5, 10, test_thread_count, schedule_tasks, [&values](unsigned int i) { values[i] = 0; });
+	for (unsigned int i = 0; i < 5; ++i) {
+		ZN_TEST_ASSERT(values[i] == 0);
+	}
+
+	// Helper tasks can still be running or starting after the call returned, they must have nothing left to do
+	runner.wait_for_all_tasks();
+	runner.dequeue_completed_tasks([](IThreadedTask *task) {
+		task->apply_result();
+		ZN_DELETE(task);
+	});
+	s_runner = nullptr;
+}
+
 } // namespace zylann::tests
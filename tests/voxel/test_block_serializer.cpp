@@ -1,8 +1,11 @@
 #include "test_block_serializer.h"
 #include "../../storage/voxel_buffer_gd.h"
+#include "../../streams/compressed_data.h"
+#include "../../streams/voxel_block_delta.h"
 #include "../../streams/voxel_block_serializer.h"
 #include "../../streams/voxel_block_serializer_gd.h"
 #include "../../util/godot/classes/stream_peer_buffer.h"
+#include "../../util/io/serialization.h"
 #include "../testing.h"
 
 namespace zylann::voxel::tests {
@@ -81,4 +84,253 @@ void test_block_serializer_stream_peer() {
 	ZN_TEST_ASSERT(voxel_buffer2->get_buffer().equals(voxel_buffer->get_buffer()));
 }
 
+void test_block_delta() {
+	const Vector3i block_size(16, 16, 16);
+
+	VoxelBuffer base(VoxelBuffer::ALLOCATOR_DEFAULT);
+	base.create(block_size);
+	base.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_32_BIT);
+	base.fill_area(42, Vector3i(1, 2, 3), Vector3i(5, 5, 5), VoxelBuffer::CHANNEL_TYPE);
+	base.fill_area_f(-1.f, Vector3i(0, 0, 0), Vector3i(16, 8, 16), VoxelBuffer::CHANNEL_SDF);
+
+	VoxelBuffer current(VoxelBuffer::ALLOCATOR_DEFAULT);
+	base.copy_to(current, false);
+
+	const Box3i area(Vector3i(2, 3, 4), Vector3i(6, 7, 5));
+
+	{
+		// No change
+		StdVector<uint8_t> delta;
+		ZN_TEST_ASSERT(BlockDelta::encode(base, area.position, current, area.position, area.size, delta) == false);
+		ZN_TEST_ASSERT(delta.size() == 0);
+	}
+
+	// Sparse edits in different channels, one of which was uniform
+	current.set_voxel(43, area.position, VoxelBuffer::CHANNEL_TYPE);
+	current.set_voxel(7, area.position + Vector3i(3, 2, 1), VoxelBuffer::CHANNEL_TYPE);
+	current.set_voxel(1, area.position + area.size - Vector3i(1, 1, 1), VoxelBuffer::CHANNEL_COLOR);
+	current.set_voxel_f(0.5f, area.position + Vector3i(1, 6, 2), VoxelBuffer::CHANNEL_SDF);
+
+	StdVector<uint8_t> delta;
+	ZN_TEST_ASSERT(BlockDelta::encode(base, area.position, current, area.position, area.size, delta));
+	// A few voxels changed, the delta should be much smaller than the area
+	ZN_TEST_ASSERT(delta.size() < static_cast<size_t>(Vector3iUtil::get_volume(area.size)));
+
+	{
+		VoxelBuffer result(VoxelBuffer::ALLOCATOR_DEFAULT);
+		base.copy_to(result, false);
+		ZN_TEST_ASSERT(BlockDelta::apply(to_span(delta), result, area.position, area.size));
+		ZN_TEST_ASSERT(result.equals(current));
+	}
+	{
+		// Areas can have different origins in each buffer
+		VoxelBuffer current_area(VoxelBuffer::ALLOCATOR_DEFAULT);
+		current_area.create(area.size + Vector3i(2, 2, 2));
+		current_area.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_32_BIT);
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			current_area.copy_channel_from(
+					current, area.position, area.position + area.size, Vector3i(1, 1, 1), channel_index
+			);
+		}
+		StdVector<uint8_t> delta2;
+		ZN_TEST_ASSERT(
+				BlockDelta::encode(base, area.position, current_area, Vector3i(1, 1, 1), area.size, delta2)
+		);
+		ZN_TEST_ASSERT(delta2 == delta);
+	}
+	{
+		// Truncated data must be rejected
+		VoxelBuffer result(VoxelBuffer::ALLOCATOR_DEFAULT);
+		base.copy_to(result, false);
+		Span<const uint8_t> truncated = to_span_const(delta).sub(0, delta.size() - 3);
+		ZN_TEST_ASSERT(BlockDelta::apply(truncated, result, area.position, area.size) == false);
+	}
+}
+
+void test_block_serializer_v5() {
+	const Vector3i block_size(16, 17, 18);
+	VoxelBuffer voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+	voxel_buffer.create(block_size);
+	voxel_buffer.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_32_BIT);
+	voxel_buffer.set_channel_depth(VoxelBuffer::CHANNEL_COLOR, VoxelBuffer::DEPTH_64_BIT);
+	// Type: non-uniform 16-bit
+	voxel_buffer.fill_area(42, Vector3i(1, 2, 3), Vector3i(9, 10, 11), VoxelBuffer::CHANNEL_TYPE);
+	// SDF: non-uniform 32-bit
+	Vector3i pos;
+	for (pos.z = 0; pos.z < block_size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < block_size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < block_size.y; ++pos.y) {
+				voxel_buffer.set_voxel_f(static_cast<float>(pos.y) - 8.5f, pos, VoxelBuffer::CHANNEL_SDF);
+			}
+		}
+	}
+	// Color: uniform 64-bit with a non-zero value
+	voxel_buffer.clear_channel(VoxelBuffer::CHANNEL_COLOR, 0x0123456789abcdefull);
+	// Data5: non-uniform 8-bit, single voxel
+	voxel_buffer.set_voxel(7, 3, 4, 5, VoxelBuffer::CHANNEL_DATA5);
+	// Metadata
+	voxel_buffer.get_block_metadata().set_u64(1234);
+	voxel_buffer.get_or_create_voxel_metadata(Vector3i(1, 2, 3))->set_u64(5678);
+
+	struct L {
+		static void check_equal(const VoxelBuffer &expected, const VoxelBuffer &actual) {
+			ZN_TEST_ASSERT(expected.equals(actual));
+			ZN_TEST_ASSERT(actual.get_block_metadata().get_type() == VoxelMetadata::TYPE_U64);
+			ZN_TEST_ASSERT(actual.get_block_metadata().get_u64() == 1234);
+			const VoxelMetadata *vmeta = actual.get_voxel_metadata(Vector3i(1, 2, 3));
+			ZN_TEST_ASSERT(vmeta != nullptr);
+			ZN_TEST_ASSERT(vmeta->get_type() == VoxelMetadata::TYPE_U64);
+			ZN_TEST_ASSERT(vmeta->get_u64() == 5678);
+		}
+	};
+
+	{
+		// Uncompressed sections
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize(voxel_buffer);
+		ZN_TEST_ASSERT(result.success);
+		StdVector<uint8_t> data = result.data;
+		ZN_TEST_ASSERT(data[0] == BlockSerializer::BLOCK_FORMAT_VERSION);
+
+		VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span_const(data), deserialized_voxel_buffer));
+		L::check_equal(voxel_buffer, deserialized_voxel_buffer);
+
+		// Deserializing into a buffer that already has allocated channels must overwrite them entirely
+		VoxelBuffer reused_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		reused_voxel_buffer.create(block_size);
+		reused_voxel_buffer.fill_area(99, Vector3i(), block_size, VoxelBuffer::CHANNEL_TYPE);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span_const(data), reused_voxel_buffer));
+		L::check_equal(voxel_buffer, reused_voxel_buffer);
+
+		// Truncated data must be rejected
+		StdVector<uint8_t> truncated_data;
+		truncated_data.insert(truncated_data.end(), data.begin(), data.begin() + data.size() / 2);
+		// Keep the trailing magic so the error is detected by section bounds
+		truncated_data.insert(truncated_data.end(), data.end() - 4, data.end());
+		VoxelBuffer truncated_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span_const(truncated_data), truncated_voxel_buffer) == false);
+	}
+	{
+		// Compressed sections
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxel_buffer);
+		ZN_TEST_ASSERT(result.success);
+		StdVector<uint8_t> data = result.data;
+		// The container is not compressed as a whole, channels are
+		ZN_TEST_ASSERT(data[0] == CompressedData::COMPRESSION_NONE);
+		ZN_TEST_ASSERT(data[1] == BlockSerializer::BLOCK_FORMAT_VERSION);
+
+		VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::decompress_and_deserialize(to_span_const(data), deserialized_voxel_buffer));
+		L::check_equal(voxel_buffer, deserialized_voxel_buffer);
+	}
+	{
+		// Uniform blocks must stay small
+		VoxelBuffer uniform_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		uniform_voxel_buffer.create(Vector3i(32, 32, 32));
+		uniform_voxel_buffer.clear_channel(VoxelBuffer::CHANNEL_TYPE, 3);
+
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(uniform_voxel_buffer);
+		ZN_TEST_ASSERT(result.success);
+		ZN_TEST_ASSERT(result.data.size() < 64);
+		StdVector<uint8_t> data = result.data;
+
+		VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::decompress_and_deserialize(to_span_const(data), deserialized_voxel_buffer));
+		ZN_TEST_ASSERT(uniform_voxel_buffer.equals(deserialized_voxel_buffer));
+	}
+}
+
+void test_block_serializer_v4_compatibility() {
+	// Blocks saved with the previous version must still load
+	StdVector<uint8_t> data;
+	MemoryWriter w(data, ENDIANNESS_LITTLE_ENDIAN);
+	w.store_8(4);
+	w.store_16(2);
+	w.store_16(2);
+	w.store_16(2);
+	// Type: not compressed, 8-bit
+	w.store_8(VoxelBuffer::COMPRESSION_NONE | (VoxelBuffer::DEPTH_8_BIT << 4));
+	for (unsigned int i = 0; i < 8; ++i) {
+		w.store_8(i + 1);
+	}
+	// SDF: uniform, 16-bit
+	w.store_8(VoxelBuffer::COMPRESSION_UNIFORM | (VoxelBuffer::DEPTH_16_BIT << 4));
+	w.store_16(0x1234);
+	// Others: uniform, 8-bit
+	for (unsigned int channel_index = 2; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		w.store_8(VoxelBuffer::COMPRESSION_UNIFORM | (VoxelBuffer::DEPTH_8_BIT << 4));
+		w.store_8(channel_index);
+	}
+	// No metadata
+	w.store_32(0x900df00d);
+
+	VoxelBuffer expected(VoxelBuffer::ALLOCATOR_DEFAULT);
+	expected.create(Vector3i(2, 2, 2));
+	expected.set_channel_depth(VoxelBuffer::CHANNEL_TYPE, VoxelBuffer::DEPTH_8_BIT);
+	expected.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	for (unsigned int channel_index = 2; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		expected.set_channel_depth(channel_index, VoxelBuffer::DEPTH_8_BIT);
+		expected.clear_channel(channel_index, channel_index);
+	}
+	expected.decompress_channel(VoxelBuffer::CHANNEL_TYPE);
+	Span<uint8_t> type_data;
+	ZN_TEST_ASSERT(expected.get_channel_as_bytes(VoxelBuffer::CHANNEL_TYPE, type_data));
+	for (unsigned int i = 0; i < type_data.size(); ++i) {
+		type_data[i] = i + 1;
+	}
+	expected.clear_channel(VoxelBuffer::CHANNEL_SDF, 0x1234);
+
+	VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+	ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span_const(data), deserialized_voxel_buffer));
+	ZN_TEST_ASSERT(expected.equals(deserialized_voxel_buffer));
+
+	// Also through the compression wrapper used by streams
+	StdVector<uint8_t> compressed_data;
+	ZN_TEST_ASSERT(CompressedData::compress(to_span_const(data), compressed_data, CompressedData::COMPRESSION_LZ4));
+	VoxelBuffer deserialized_voxel_buffer2(VoxelBuffer::ALLOCATOR_DEFAULT);
+	ZN_TEST_ASSERT(
+			BlockSerializer::decompress_and_deserialize(to_span_const(compressed_data), deserialized_voxel_buffer2)
+	);
+	ZN_TEST_ASSERT(expected.equals(deserialized_voxel_buffer2));
+}
+
+void test_block_serializer_terrain_round_trip() {
+	const Vector3i block_size(32, 32, 32);
+
+	VoxelBuffer voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+	voxel_buffer.create(block_size);
+	// Typical terrain block: a surface going through, some scattered types
+	Vector3i pos;
+	for (pos.z = 0; pos.z < block_size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < block_size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < block_size.y; ++pos.y) {
+				const float h = 14.f + static_cast<float>(pos.x % 7) - 0.5f * static_cast<float>(pos.z % 5);
+				voxel_buffer.set_voxel_f(pos.y - h, pos, VoxelBuffer::CHANNEL_SDF);
+				voxel_buffer.set_voxel((pos.x * 7 + pos.z * 3) % 5, pos, VoxelBuffer::CHANNEL_TYPE);
+			}
+		}
+	}
+
+	// The same buffer is deserialized into twice, to check channels allocated by the first round trip get reused
+	VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize(voxel_buffer);
+		ZN_TEST_ASSERT(result.success);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span_const(result.data), deserialized_voxel_buffer));
+		ZN_TEST_ASSERT(voxel_buffer.equals(deserialized_voxel_buffer));
+	}
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxel_buffer);
+		ZN_TEST_ASSERT(result.success);
+		// Sections are compressed, so the block must be smaller than its voxels
+		ZN_TEST_ASSERT(result.data.size() < voxel_buffer.get_allocated_channels_size_in_bytes());
+		ZN_TEST_ASSERT(
+				BlockSerializer::decompress_and_deserialize(to_span_const(result.data), deserialized_voxel_buffer)
+		);
+		ZN_TEST_ASSERT(voxel_buffer.equals(deserialized_voxel_buffer));
+	}
+}
+
 } // namespace zylann::voxel::tests
@@ -5,6 +5,10 @@ namespace zylann::voxel::tests {
 
 void test_block_serializer();
 void test_block_serializer_stream_peer();
+void test_block_delta();
+void test_block_serializer_v5();
+void test_block_serializer_v4_compatibility();
+void test_block_serializer_terrain_round_trip();
 
 } // namespace zylann::voxel::tests
 
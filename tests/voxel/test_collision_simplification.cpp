@@ -0,0 +1,169 @@
+#include "test_collision_simplification.h"
+#include "../../meshers/collision_simplification.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/funcs.h"
+#include "../testing.h"
+#include <cmath>
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+// Adds a unit square facing up, the same way blocky meshers output faces
+void add_up_face(StdVector<Vector3f> &positions, StdVector<int> &indices, Vector3f origin) {
+	const int i0 = positions.size();
+	positions.push_back(origin + Vector3f(0, 0, 0));
+	positions.push_back(origin + Vector3f(1, 0, 0));
+	positions.push_back(origin + Vector3f(1, 0, 1));
+	positions.push_back(origin + Vector3f(0, 0, 1));
+	indices.push_back(i0);
+	indices.push_back(i0 + 2);
+	indices.push_back(i0 + 1);
+	indices.push_back(i0);
+	indices.push_back(i0 + 3);
+	indices.push_back(i0 + 2);
+}
+
+float get_total_area(Span<const Vector3f> positions, Span<const int> indices) {
+	float area = 0.f;
+	for (unsigned int i = 0; i < indices.size(); i += 3) {
+		const Vector3f a = positions[indices[i]];
+		const Vector3f b = positions[indices[i + 1]];
+		const Vector3f c = positions[indices[i + 2]];
+		area += 0.5f * math::length(math::cross(b - a, c - a));
+	}
+	return area;
+}
+
+} // namespace
+
+void test_collision_merge_quads() {
+	StdVector<Vector3f> src_positions;
+	StdVector<int> src_indices;
+
+	// 4x4 floor
+	for (int z = 0; z < 4; ++z) {
+		for (int x = 0; x < 4; ++x) {
+			add_up_face(src_positions, src_indices, Vector3f(x, 2, z));
+		}
+	}
+	// A face with a hole next to it, on another plane, so it can't merge with the floor
+	add_up_face(src_positions, src_indices, Vector3f(6, 3, 0));
+	// A triangle that is not part of a grid
+	src_positions.push_back(Vector3f(0.5f, 5.f, 0.f));
+	src_positions.push_back(Vector3f(1.f, 5.f, 0.3f));
+	src_positions.push_back(Vector3f(0.f, 5.f, 0.7f));
+	src_indices.push_back(src_positions.size() - 3);
+	src_indices.push_back(src_positions.size() - 2);
+	src_indices.push_back(src_positions.size() - 1);
+
+	StdVector<Vector3f> dst_positions;
+	StdVector<int> dst_indices;
+	merge_collision_quads(to_span(src_positions), to_span(src_indices), dst_positions, dst_indices);
+
+	// Floor and separate face become one quad each, the other triangle is kept
+	ZN_TEST_ASSERT(dst_indices.size() == 6 + 6 + 3);
+	ZN_TEST_ASSERT(
+			Math::is_equal_approx(
+					get_total_area(to_span(src_positions), to_span(src_indices)),
+					get_total_area(to_span(dst_positions), to_span(dst_indices))
+			)
+	);
+
+	// Merged triangles must still face up
+	for (unsigned int i = 0; i < dst_indices.size(); i += 3) {
+		const Vector3f a = dst_positions[dst_indices[i]];
+		const Vector3f b = dst_positions[dst_indices[i + 1]];
+		const Vector3f c = dst_positions[dst_indices[i + 2]];
+		const Vector3f n = math::cross(b - a, c - a);
+		if (a.y == 5.f) {
+			continue;
+		}
+		ZN_TEST_ASSERT(n.y > 0.f);
+	}
+
+	{
+		// 3x3 floor with a hole in the middle
+		StdVector<Vector3f> holed_positions;
+		StdVector<int> holed_indices;
+		for (int z = 0; z < 3; ++z) {
+			for (int x = 0; x < 3; ++x) {
+				if (x != 1 || z != 1) {
+					add_up_face(holed_positions, holed_indices, Vector3f(x, 0, z));
+				}
+			}
+		}
+
+		merge_collision_quads(to_span(holed_positions), to_span(holed_indices), dst_positions, dst_indices, false);
+		ZN_TEST_ASSERT(dst_indices.size() > 6);
+		ZN_TEST_ASSERT(Math::is_equal_approx(get_total_area(to_span(dst_positions), to_span(dst_indices)), 8.f));
+
+		// The hole gets covered, so the whole floor is one quad
+		merge_collision_quads(to_span(holed_positions), to_span(holed_indices), dst_positions, dst_indices, true);
+		ZN_TEST_ASSERT(dst_indices.size() == 6);
+		ZN_TEST_ASSERT(Math::is_equal_approx(get_total_area(to_span(dst_positions), to_span(dst_indices)), 9.f));
+	}
+}
+
+void test_collision_decimation() {
+	// Bumpy grid covering a whole block
+	const int size = 16;
+	StdVector<Vector3f> src_positions;
+	StdVector<int> src_indices;
+	for (int z = 0; z <= size; ++z) {
+		for (int x = 0; x <= size; ++x) {
+			const float y = 5.f + 0.3f * std::sin(x * 1.3f) * std::cos(z * 0.7f);
+			src_positions.push_back(Vector3f(x, y, z));
+		}
+	}
+	for (int z = 0; z < size; ++z) {
+		for (int x = 0; x < size; ++x) {
+			const int i00 = x + z * (size + 1);
+			const int i10 = i00 + 1;
+			const int i01 = i00 + size + 1;
+			const int i11 = i01 + 1;
+			src_indices.push_back(i00);
+			src_indices.push_back(i11);
+			src_indices.push_back(i10);
+			src_indices.push_back(i00);
+			src_indices.push_back(i01);
+			src_indices.push_back(i11);
+		}
+	}
+
+	StdVector<Vector3f> dst_positions;
+	StdVector<int> dst_indices;
+	decimate_collision_mesh(
+			to_span(src_positions),
+			to_span(src_indices),
+			4.f,
+			Vector3f(size, size, size),
+			dst_positions,
+			dst_indices
+	);
+
+	ZN_TEST_ASSERT(dst_indices.size() > 0);
+	ZN_TEST_ASSERT(dst_indices.size() < src_indices.size() / 2);
+	ZN_TEST_ASSERT(dst_indices.size() % 3 == 0);
+
+	// Vertices on the border of the block must be preserved, so neighbor blocks still connect
+	for (const Vector3f src_pos : src_positions) {
+		if (src_pos.x != 0 && src_pos.z != 0 && src_pos.x != size && src_pos.z != size) {
+			continue;
+		}
+		bool found = false;
+		for (const Vector3f dst_pos : dst_positions) {
+			if (dst_pos == src_pos) {
+				found = true;
+				break;
+			}
+		}
+		ZN_TEST_ASSERT(found);
+	}
+
+	// The surface must still cover the block
+	const float area = get_total_area(to_span(dst_positions), to_span(dst_indices));
+	ZN_TEST_ASSERT(area > 0.9f * size * size);
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,11 @@
+#ifndef VOXEL_TESTS_COLLISION_SIMPLIFICATION_H
+#define VOXEL_TESTS_COLLISION_SIMPLIFICATION_H
+
+namespace zylann::voxel::tests {
+
+void test_collision_merge_quads();
+void test_collision_decimation();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TESTS_COLLISION_SIMPLIFICATION_H
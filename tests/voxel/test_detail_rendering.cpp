@@ -0,0 +1,174 @@
+#include "test_detail_rendering.h"
+#include "../../engine/detail_rendering/detail_rendering.h"
+#include "../../generators/graph/voxel_generator_graph.h"
+#include "../../meshers/transvoxel/transvoxel_cell_iterator.h"
+#include "../../meshers/transvoxel/voxel_mesher_transvoxel.h"
+#include "../../util/containers/container_funcs.h"
+#include "../../util/containers/std_vector.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+// SDF of a plane sloping along X: y + 0.5 * x - 8
+Ref<VoxelGeneratorGraph> create_sloped_plane_generator() {
+	Ref<VoxelGeneratorGraph> generator;
+	generator.instantiate();
+	{
+		pg::VoxelGraphFunction &g = **generator->get_main_function();
+
+		// X --- Mul --- Add1 --- Add2 --- OutSDF
+		//              /        /
+		//             Y       -8
+		const uint32_t n_x = g.create_node(pg::VoxelGraphFunction::NODE_INPUT_X, Vector2());
+		const uint32_t n_y = g.create_node(pg::VoxelGraphFunction::NODE_INPUT_Y, Vector2());
+		const uint32_t n_mul = g.create_node(pg::VoxelGraphFunction::NODE_MULTIPLY, Vector2());
+		const uint32_t n_add1 = g.create_node(pg::VoxelGraphFunction::NODE_ADD, Vector2());
+		const uint32_t n_add2 = g.create_node(pg::VoxelGraphFunction::NODE_ADD, Vector2());
+		const uint32_t n_out_sd = g.create_node(pg::VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		g.add_connection(n_x, 0, n_mul, 0);
+		g.set_node_default_input(n_mul, 1, 0.5f);
+		g.add_connection(n_mul, 0, n_add1, 0);
+		g.add_connection(n_y, 0, n_add1, 1);
+		g.add_connection(n_add1, 0, n_add2, 0);
+		g.set_node_default_input(n_add2, 1, -8.f);
+		g.add_connection(n_add2, 0, n_out_sd, 0);
+
+		pg::CompilationResult result = generator->compile(false);
+		ZN_TEST_ASSERT(result.success);
+	}
+	return generator;
+}
+
+struct DetailRenderingTestMesh {
+	StdVector<Vector3f> vertices;
+	StdVector<Vector3f> normals;
+	StdVector<int> indices;
+	StdVector<transvoxel::CellInfo> cell_infos;
+	Vector3i voxels_size;
+};
+
+void build_detail_rendering_test_mesh(VoxelGenerator &generator, int block_size, DetailRenderingTestMesh &mesh) {
+	Ref<VoxelMesherTransvoxel> mesher;
+	mesher.instantiate();
+
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	voxels.create(Vector3iUtil::create(block_size + mesher->get_minimum_padding() + mesher->get_maximum_padding()));
+
+	const Vector3i origin_in_voxels;
+	VoxelGenerator::VoxelQueryData query{ voxels, origin_in_voxels, 0 };
+	generator.generate_block(query);
+
+	const VoxelMesher::Input mesher_input = { voxels, &generator, nullptr, origin_in_voxels, 0, false, false, true };
+	VoxelMesher::Output mesher_output;
+	mesher->build(mesher_output, mesher_input);
+	ZN_TEST_ASSERT(!VoxelMesher::is_mesh_empty(mesher_output.surfaces));
+
+	const transvoxel::MeshArrays &mesh_arrays = VoxelMesherTransvoxel::get_mesh_cache_from_current_thread();
+	Span<const transvoxel::CellInfo> cell_infos = VoxelMesherTransvoxel::get_cell_info_from_current_thread();
+	ZN_TEST_ASSERT(cell_infos.size() > 0 && mesh_arrays.vertices.size() > 0);
+
+	append_array(mesh.vertices, mesh_arrays.vertices);
+	append_array(mesh.normals, mesh_arrays.normals);
+	append_array(mesh.indices, mesh_arrays.indices);
+	mesh.cell_infos.insert(mesh.cell_infos.end(), cell_infos.begin(), cell_infos.end());
+	mesh.voxels_size = voxels.get_size();
+}
+
+void compute_test_detail_texture_data(
+		const DetailRenderingTestMesh &mesh,
+		VoxelGenerator &generator,
+		unsigned int tile_resolution,
+		bool octahedral_encoding,
+		DetailTextureData &out_data
+) {
+	TransvoxelCellIterator cell_iterator(to_span(mesh.cell_infos));
+	out_data.clear();
+	compute_detail_texture_data(
+			cell_iterator,
+			to_span(mesh.vertices),
+			to_span(mesh.normals),
+			to_span(mesh.indices),
+			out_data,
+			tile_resolution,
+			generator,
+			nullptr,
+			Vector3i(),
+			mesh.voxels_size,
+			0,
+			octahedral_encoding,
+			math::deg_to_rad(60.f),
+			false
+	);
+}
+
+} // namespace
+
+void test_normalmap_render_cpu() {
+	Ref<VoxelGeneratorGraph> generator = create_sloped_plane_generator();
+	DetailRenderingTestMesh mesh;
+	build_detail_rendering_test_mesh(**generator, 16, mesh);
+
+	const unsigned int tile_resolution = 8;
+	const unsigned int pixels_per_tile = math::squared(tile_resolution);
+
+	// The plane has the same normal everywhere, so all pixels must either have it, or be empty if no triangle was
+	// found behind them after dilation
+	const Vector3f expected_normal = math::normalized(Vector3f(0.5f, 1.f, 0.f));
+
+	struct L {
+		static bool is_close(uint8_t a, uint8_t b) {
+			return Math::abs(int(a) - int(b)) <= 1;
+		}
+		static uint8_t encode(float v) {
+			return math::clamp(255.f * (0.5f + 0.5f * v), 0.f, 255.f);
+		}
+	};
+
+	{
+		DetailTextureData data;
+		compute_test_detail_texture_data(mesh, **generator, tile_resolution, false, data);
+		ZN_TEST_ASSERT(data.tiles.size() == mesh.cell_infos.size());
+		ZN_TEST_ASSERT(data.normals.size() == data.tiles.size() * pixels_per_tile * 3);
+
+		unsigned int expected_count = 0;
+		for (unsigned int i = 0; i < data.normals.size(); i += 3) {
+			const uint8_t r = data.normals[i];
+			const uint8_t g = data.normals[i + 1];
+			const uint8_t b = data.normals[i + 2];
+			if (L::is_close(r, L::encode(expected_normal.x)) && L::is_close(g, L::encode(expected_normal.y)) &&
+				L::is_close(b, L::encode(expected_normal.z))) {
+				++expected_count;
+			} else {
+				ZN_TEST_ASSERT(r == 127 && g == 127 && b == 127);
+			}
+		}
+		ZN_TEST_ASSERT(expected_count > data.normals.size() / 6);
+	}
+	{
+		DetailTextureData data;
+		compute_test_detail_texture_data(mesh, **generator, tile_resolution, true, data);
+		ZN_TEST_ASSERT(data.tiles.size() == mesh.cell_infos.size());
+		ZN_TEST_ASSERT(data.normals.size() == data.tiles.size() * pixels_per_tile * 2);
+
+		// Normal pointing towards positive Z, so the octahedron is not folded
+		const float sum = expected_normal.x + expected_normal.y;
+		const uint8_t expected_r = L::encode(expected_normal.x / sum);
+		const uint8_t expected_g = L::encode(expected_normal.y / sum);
+
+		unsigned int expected_count = 0;
+		for (unsigned int i = 0; i < data.normals.size(); i += 2) {
+			const uint8_t r = data.normals[i];
+			const uint8_t g = data.normals[i + 1];
+			if (L::is_close(r, expected_r) && L::is_close(g, expected_g)) {
+				++expected_count;
+			} else {
+				ZN_TEST_ASSERT(r == 127 && g == 127);
+			}
+		}
+		ZN_TEST_ASSERT(expected_count > data.normals.size() / 4);
+	}
+}
+
+} // namespace zylann::voxel::tests
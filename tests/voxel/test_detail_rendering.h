@@ -0,0 +1,10 @@
+#ifndef VOXEL_TEST_DETAIL_RENDERING_H
+#define VOXEL_TEST_DETAIL_RENDERING_H
+
+namespace zylann::voxel::tests {
+
+void test_normalmap_render_cpu();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_DETAIL_RENDERING_H
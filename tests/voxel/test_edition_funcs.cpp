@@ -1,5 +1,9 @@
 #include "test_edition_funcs.h"
+#include "../../edition/blocky_lighting.h"
+#include "../../edition/blocky_random_tick.h"
 #include "../../edition/funcs.h"
+#include "../../edition/voxel_blocky_cellular_automaton.h"
+#include "../../edition/voxel_collision_query.h"
 #include "../../edition/voxel_tool_terrain.h"
 #include "../../generators/graph/voxel_generator_graph.h"
 #include "../../meshers/blocky/voxel_blocky_library.h"
@@ -134,6 +138,503 @@ void test_run_blocky_random_tick() {
 	}
 }
 
+void test_run_blocky_random_tick_batched() {
+	const Box3i voxel_box(Vector3i(-24, -23, -22), Vector3i(64, 40, 40));
+
+	Ref<VoxelBlockyLibrary> library;
+	library.instantiate();
+
+	{
+		Ref<VoxelBlockyModelMesh> air;
+		air.instantiate();
+		library->add_model(air);
+	}
+
+	{
+		Ref<VoxelBlockyModelCube> non_tickable;
+		non_tickable.instantiate();
+		library->add_model(non_tickable);
+	}
+
+	int tickable_id = -1;
+	{
+		Ref<VoxelBlockyModel> tickable;
+		tickable.instantiate();
+		tickable->set_random_tickable(true);
+		tickable_id = library->add_model(tickable);
+	}
+
+	library->bake();
+
+	VoxelData data;
+	{
+		VoxelBuffer model_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		model_buffer.create(Vector3iUtil::create(data.get_block_size()));
+		for (int z = 0; z < model_buffer.get_size().z; ++z) {
+			for (int x = 0; x < model_buffer.get_size().x; ++x) {
+				for (int y = 0; y < model_buffer.get_size().y; ++y) {
+					const int block_id = (x + y + z) % 3;
+					model_buffer.set_voxel(block_id, x, y, z, VoxelBuffer::CHANNEL_TYPE);
+				}
+			}
+		}
+
+		const Box3i world_blocks_box(-4, -4, -4, 8, 8, 8);
+		world_blocks_box.for_each_cell_zxy([&data, &model_buffer](Vector3i block_pos) {
+			std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+			buffer->create(model_buffer.get_size());
+			buffer->copy_channels_from(model_buffer);
+			VoxelDataBlock block(buffer, 0);
+			block.set_edited(true);
+			ZN_TEST_ASSERT(data.try_set_block(block_pos, block));
+		});
+	}
+
+	struct Callback {
+		Box3i voxel_box;
+		int tickable_id = -1;
+		int hit_count = 0;
+		bool ok = true;
+
+		Callback(Box3i p_voxel_box, int p_tickable_id) : voxel_box(p_voxel_box), tickable_id(p_tickable_id) {}
+
+		bool exec(Span<const Vector3i> positions, Span<const uint32_t> types) {
+			if (ok) {
+				ok = _exec(positions, types);
+			}
+			return ok;
+		}
+
+		inline bool _exec(Span<const Vector3i> positions, Span<const uint32_t> types) {
+			ZN_TEST_ASSERT_V(positions.size() == types.size(), false);
+			ZN_TEST_ASSERT_V(positions.size() > 0, false);
+			for (unsigned int i = 0; i < positions.size(); ++i) {
+				ZN_TEST_ASSERT_V(int(types[i]) == tickable_id, false);
+				ZN_TEST_ASSERT_V(voxel_box.contains(positions[i]), false);
+			}
+			hit_count += positions.size();
+			return true;
+		}
+
+		static bool callback(void *self, Span<const Vector3i> positions, Span<const uint32_t> types) {
+			Callback *cb = (Callback *)self;
+			return cb->exec(positions, types);
+		}
+	};
+
+	BlockyRandomTickIndex index;
+	RandomPCG random;
+	random.seed(131183);
+
+	{
+		Callback cb(voxel_box, tickable_id);
+		zylann::voxel::run_blocky_random_tick_batched(
+				data, voxel_box, **library, index, random, 1000, 4, &cb, &Callback::callback
+		);
+		ZN_TEST_ASSERT(cb.ok);
+		ZN_TEST_ASSERT_MSG(cb.hit_count > 0, "At least one hit is expected, not none");
+	}
+
+	// Edit one block so it has no tickable voxels left, and sample only that block
+	{
+		const Vector3i bpos(0, 0, 0);
+		const Box3i block_voxel_box(data.block_to_voxel(bpos), Vector3iUtil::create(data.get_block_size()));
+
+		Callback cb(block_voxel_box, tickable_id);
+		zylann::voxel::run_blocky_random_tick_batched(
+				data, block_voxel_box, **library, index, random, 64, 64, &cb, &Callback::callback
+		);
+		ZN_TEST_ASSERT(cb.ok);
+		ZN_TEST_ASSERT(cb.hit_count > 0);
+
+		block_voxel_box.for_each_cell_zxy([&data](Vector3i pos) { //
+			ZN_TEST_ASSERT(data.try_set_voxel(0, pos, VoxelBuffer::CHANNEL_TYPE));
+		});
+		index.mark_block_dirty(bpos);
+
+		cb.hit_count = 0;
+		zylann::voxel::run_blocky_random_tick_batched(
+				data, block_voxel_box, **library, index, random, 64, 64, &cb, &Callback::callback
+		);
+		ZN_TEST_ASSERT(cb.ok);
+		ZN_TEST_ASSERT_MSG(cb.hit_count == 0, "The index should have been updated after the edit");
+	}
+}
+
+namespace {
+
+// Model 0 is air, 1 is solid, 2 falls, 3 to 10 are water levels 1 to 8
+std::shared_ptr<CellularAutomatonRules> make_test_cellular_automaton_rules() {
+	std::shared_ptr<CellularAutomatonRules> rules = make_shared_instance<CellularAutomatonRules>();
+	rules->empty_model = 0;
+	rules->cells.resize(11);
+	rules->cells[0].kind = CellularAutomatonRules::KIND_EMPTY;
+	rules->cells[1].kind = CellularAutomatonRules::KIND_SOLID;
+	rules->cells[2].kind = CellularAutomatonRules::KIND_FALLING;
+	rules->fluids.resize(1);
+	CellularAutomatonRules::Fluid &water = rules->fluids[0];
+	water.level_models.push_back(0);
+	for (unsigned int level = 1; level <= 8; ++level) {
+		const unsigned int model = 2 + level;
+		CellularAutomatonRules::Cell &cell = rules->cells[model];
+		cell.kind = CellularAutomatonRules::KIND_FLUID;
+		cell.fluid_index = 0;
+		cell.level = level;
+		water.level_models.push_back(model);
+	}
+	return rules;
+}
+
+// Loads an area of blocks. The bottom layer of blocks is solid, the rest is air.
+void load_test_cellular_automaton_blocks(VoxelData &data, const Box3i blocks_box) {
+	blocks_box.for_each_cell_zxy([&data, &blocks_box](Vector3i bpos) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(Vector3iUtil::create(data.get_block_size()));
+		buffer->fill(bpos.y == blocks_box.position.y ? 1 : 0, VoxelBuffer::CHANNEL_TYPE);
+		VoxelDataBlock block(buffer, 0);
+		block.set_edited(true);
+		ZN_TEST_ASSERT(data.try_set_block(bpos, block));
+	});
+}
+
+unsigned int run_cellular_automaton_until_stable(
+		CellularAutomaton &automaton,
+		const std::shared_ptr<VoxelData> &data,
+		unsigned int max_steps
+) {
+	StdVector<Box3i> modified_boxes;
+	unsigned int step_count = 0;
+	while (automaton.get_active_block_count() > 0 && step_count < max_steps) {
+		automaton.step(data, 0, modified_boxes);
+		++step_count;
+	}
+	return step_count;
+}
+
+} // namespace
+
+void test_cellular_automaton_falling() {
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	const Box3i blocks_box(Vector3i(-1, -1, -1), Vector3i(3, 3, 3));
+	load_test_cellular_automaton_blocks(*data, blocks_box);
+
+	const Vector3i start_pos(5, 20, 5);
+	// Resting on top of the solid layer of blocks
+	const Vector3i end_pos(5, 0, 5);
+	ZN_TEST_ASSERT(data->try_set_voxel(2, start_pos, VoxelBuffer::CHANNEL_TYPE));
+
+	CellularAutomaton automaton;
+	automaton.set_rules(make_test_cellular_automaton_rules());
+	automaton.mark_blocks_active(blocks_box);
+
+	const unsigned int step_count = run_cellular_automaton_until_stable(automaton, data, 1000);
+	ZN_TEST_ASSERT(automaton.get_active_block_count() == 0);
+	// One voxel per step
+	ZN_TEST_ASSERT(step_count >= unsigned(start_pos.y - end_pos.y));
+
+	const VoxelSingleValue defval{ 0 };
+	ZN_TEST_ASSERT(data->get_voxel(start_pos, VoxelBuffer::CHANNEL_TYPE, defval).i == 0);
+	ZN_TEST_ASSERT(data->get_voxel(end_pos, VoxelBuffer::CHANNEL_TYPE, defval).i == 2);
+}
+
+void test_cellular_automaton_fluid() {
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	const Box3i blocks_box(Vector3i(-1, -1, -1), Vector3i(3, 3, 3));
+	load_test_cellular_automaton_blocks(*data, blocks_box);
+
+	std::shared_ptr<CellularAutomatonRules> rules = make_test_cellular_automaton_rules();
+
+	// Column of full water voxels, crossing block borders
+	const int full_model = rules->fluids[0].level_models.back();
+	const int max_level = rules->fluids[0].get_max_level();
+	const int column_height = 6;
+	for (int y = 0; y < column_height; ++y) {
+		ZN_TEST_ASSERT(data->try_set_voxel(full_model, Vector3i(0, 10 + y, 0), VoxelBuffer::CHANNEL_TYPE));
+	}
+	const int expected_total_level = column_height * max_level;
+
+	CellularAutomaton automaton;
+	automaton.set_rules(rules);
+	automaton.mark_blocks_active(blocks_box);
+
+	run_cellular_automaton_until_stable(automaton, data, 1000);
+	ZN_TEST_ASSERT(automaton.get_active_block_count() == 0);
+
+	const Box3i voxel_box(
+			data->block_to_voxel(blocks_box.position), blocks_box.size * int(data->get_block_size())
+	);
+	const VoxelSingleValue defval{ 0 };
+	int total_level = 0;
+	int max_found_y = std::numeric_limits<int>::min();
+	unsigned int wet_voxel_count = 0;
+	voxel_box.for_each_cell_zxy([&](Vector3i pos) {
+		const int model = data->get_voxel(pos, VoxelBuffer::CHANNEL_TYPE, defval).i;
+		const CellularAutomatonRules::Cell cell = rules->get_cell(model);
+		if (cell.kind == CellularAutomatonRules::KIND_FLUID) {
+			total_level += cell.level;
+			max_found_y = math::max(max_found_y, pos.y);
+			++wet_voxel_count;
+		}
+	});
+
+	// No water should be created or lost
+	ZN_TEST_ASSERT(total_level == expected_total_level);
+	// It should have fallen on the ground and spread sideways
+	ZN_TEST_ASSERT(max_found_y == 0);
+	ZN_TEST_ASSERT(wet_voxel_count > unsigned(column_height));
+}
+
+namespace {
+
+// Model 0 is air, 1 is solid, 2 is a solid light source
+std::shared_ptr<BlockyLightingRules> make_test_lighting_rules() {
+	std::shared_ptr<BlockyLightingRules> rules = make_shared_instance<BlockyLightingRules>();
+	rules->models.resize(3);
+	rules->models[0].opaque = false;
+	rules->models[2].emission = 14;
+	return rules;
+}
+
+uint8_t get_test_light(VoxelData &data, Vector3i pos, VoxelBuffer::ChannelId channel) {
+	const VoxelSingleValue defval{ 0 };
+	return data.get_voxel(pos, channel, defval).i;
+}
+
+bool is_box_within(const Box3i &box, const Box3i &limit) {
+	return box.clipped(limit) == box;
+}
+
+// Runs lighting tasks on the current thread until no work is left
+void process_test_lighting(
+		BlockyLighting &lighting,
+		const std::shared_ptr<VoxelData> &data,
+		StdVector<Box3i> &out_modified_boxes
+) {
+	StdVector<IThreadedTask *> tasks;
+	while (lighting.has_pending_work()) {
+		tasks.clear();
+		lighting.take_tasks(data, tasks);
+		for (IThreadedTask *task : tasks) {
+			ThreadedTaskContext ctx(0, TaskPriority());
+			task->run(ctx);
+			// Nothing else is locking voxels
+			ZN_TEST_ASSERT(ctx.status == ThreadedTaskContext::STATUS_COMPLETE);
+			task->apply_result();
+			ZN_DELETE(task);
+		}
+		ZN_TEST_ASSERT(!lighting.has_tasks_in_progress());
+		lighting.take_results(out_modified_boxes);
+	}
+}
+
+} // namespace
+
+void test_blocky_lighting() {
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	const Box3i blocks_box(Vector3i(-1, -1, -1), Vector3i(3, 3, 3));
+	load_test_cellular_automaton_blocks(*data, blocks_box);
+	const int block_size = data->get_block_size();
+	const Box3i voxel_box(blocks_box.position * block_size, blocks_box.size * block_size);
+
+	BlockyLighting lighting;
+	lighting.set_rules(make_test_lighting_rules());
+	const VoxelBuffer::ChannelId channel = lighting.get_channel();
+
+	StdVector<Box3i> modified_boxes;
+	blocks_box.for_each_cell_zxy([&lighting, block_size](Vector3i bpos) { //
+		lighting.mark_block_loaded(bpos, block_size);
+	});
+	process_test_lighting(lighting, data, modified_boxes);
+	ZN_TEST_ASSERT(!lighting.has_pending_work());
+
+	// Nothing above, so sky light reaches the ground
+	ZN_TEST_ASSERT(blocky_light::get_sky(get_test_light(*data, Vector3i(5, 0, 5), channel)) == 15);
+	ZN_TEST_ASSERT(get_test_light(*data, Vector3i(5, -1, 5), channel) == 0);
+
+	// Light source
+	const Vector3i source_pos(2, 5, 2);
+	ZN_TEST_ASSERT(data->try_set_voxel(2, source_pos, VoxelBuffer::CHANNEL_TYPE));
+	const Box3i source_box(source_pos, Vector3i(1, 1, 1));
+	lighting.mark_area_edited(source_box, block_size);
+	modified_boxes.clear();
+	process_test_lighting(lighting, data, modified_boxes);
+	ZN_TEST_ASSERT(blocky_light::get_block(get_test_light(*data, source_pos, channel)) == 14);
+	ZN_TEST_ASSERT(blocky_light::get_block(get_test_light(*data, source_pos + Vector3i(3, 0, 0), channel)) == 11);
+	ZN_TEST_ASSERT(modified_boxes.size() > 0);
+	for (const Box3i &box : modified_boxes) {
+		ZN_TEST_ASSERT(is_box_within(box, source_box.padded(15)));
+	}
+
+	// Roof over the light source, crossing block borders
+	const Box3i roof_box(Vector3i(-8, 20, -8), Vector3i(16, 1, 16));
+	roof_box.for_each_cell_zxy([&data](Vector3i pos) { //
+		ZN_TEST_ASSERT(data->try_set_voxel(1, pos, VoxelBuffer::CHANNEL_TYPE));
+	});
+	lighting.mark_area_edited(roof_box, block_size);
+	modified_boxes.clear();
+	process_test_lighting(lighting, data, modified_boxes);
+	ZN_TEST_ASSERT(blocky_light::get_sky(get_test_light(*data, Vector3i(0, 10, 0), channel)) < 15);
+	// Sky light can only change below the roof, and no further than light can spread sideways
+	Box3i roof_limit = roof_box.padded(15);
+	roof_limit.size.y += roof_limit.position.y - voxel_box.position.y;
+	roof_limit.position.y = voxel_box.position.y;
+	ZN_TEST_ASSERT(modified_boxes.size() > 0);
+	for (const Box3i &box : modified_boxes) {
+		ZN_TEST_ASSERT(is_box_within(box, roof_limit));
+	}
+
+	// Remove the light source
+	ZN_TEST_ASSERT(data->try_set_voxel(0, source_pos, VoxelBuffer::CHANNEL_TYPE));
+	lighting.mark_area_edited(source_box, block_size);
+	modified_boxes.clear();
+	process_test_lighting(lighting, data, modified_boxes);
+
+	// Incremental updates must give the same result as lighting everything from scratch
+	std::shared_ptr<VoxelData> ref_data = make_shared_instance<VoxelData>();
+	blocks_box.for_each_cell_zxy([&data, &ref_data](Vector3i bpos) {
+		std::shared_ptr<VoxelBuffer> src = data->try_get_block_voxels(bpos);
+		ZN_TEST_ASSERT(src != nullptr);
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(src->get_size());
+		buffer->copy_channel_from(*src, VoxelBuffer::CHANNEL_TYPE);
+		VoxelDataBlock block(buffer, 0);
+		ZN_TEST_ASSERT(ref_data->try_set_block(bpos, block));
+	});
+	BlockyLighting ref_lighting;
+	ref_lighting.set_rules(make_test_lighting_rules());
+	blocks_box.for_each_cell_zxy([&ref_lighting, block_size](Vector3i bpos) { //
+		ref_lighting.mark_block_loaded(bpos, block_size);
+	});
+	modified_boxes.clear();
+	process_test_lighting(ref_lighting, ref_data, modified_boxes);
+
+	voxel_box.for_each_cell_zxy([&data, &ref_data, channel](Vector3i pos) {
+		ZN_TEST_ASSERT(get_test_light(*data, pos, channel) == get_test_light(*ref_data, pos, channel));
+	});
+}
+
+namespace {
+
+bool is_near(real_t a, real_t b) {
+	return Math::abs(a - b) < 0.01;
+}
+
+} // namespace
+
+void test_collision_queries_blocky() {
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	// Ground with its surface at Y=0
+	const Box3i blocks_box(Vector3i(-1, -1, -1), Vector3i(3, 3, 3));
+	load_test_cellular_automaton_blocks(*data, blocks_box);
+	// Wall with its side at X=5
+	Box3i(Vector3i(5, 0, -3), Vector3i(1, 4, 6)).for_each_cell_zxy([&data](Vector3i pos) { //
+		ZN_TEST_ASSERT(data->try_set_voxel(1, pos, VoxelBuffer::CHANNEL_TYPE));
+	});
+
+	// Model 0 is air, model 1 is a full cube on the first collision layer
+	CollisionQuerySource source;
+	source.type = CollisionQuerySource::TYPE_BLOCKY;
+	source.blocky_models.resize(2);
+	source.blocky_models[1].collision_mask = 1;
+	source.blocky_models[1].box_count = 1;
+	source.blocky_boxes.push_back(AABB(Vector3(0, 0, 0), Vector3(1, 1, 1)));
+
+	CollisionSweepResult result;
+
+	// Box standing on the ground, moving towards the wall
+	const AABB box(Vector3(-0.4, 0, -0.4), Vector3(0.8, 1.8, 0.8));
+	ZN_TEST_ASSERT(collision_queries::sweep_aabb(*data, source, 1, box, Vector3(10, 0, 0), result));
+	ZN_TEST_ASSERT(is_near(result.fraction, 0.46));
+	ZN_TEST_ASSERT(result.normal.is_equal_approx(Vector3(-1, 0, 0)));
+	// Sliding on the ground away from the wall
+	ZN_TEST_ASSERT(!collision_queries::sweep_aabb(*data, source, 1, box, Vector3(-5, 0, 3), result));
+	// Going into the ground
+	ZN_TEST_ASSERT(collision_queries::sweep_aabb(*data, source, 1, box, Vector3(0, -1, 0), result));
+	ZN_TEST_ASSERT(is_near(result.fraction, 0));
+	// Layer not in the mask
+	ZN_TEST_ASSERT(!collision_queries::sweep_aabb(*data, source, 2, box, Vector3(10, 0, 0), result));
+
+	// Falling sphere
+	ZN_TEST_ASSERT(
+			collision_queries::sweep_sphere(*data, source, 1, Vector3(0, 5, 0), 0.5, Vector3(0, -10, 0), result)
+	);
+	ZN_TEST_ASSERT(is_near(result.fraction, 0.45));
+	ZN_TEST_ASSERT(result.normal.is_equal_approx(Vector3(0, 1, 0)));
+
+	// Standing capsule moving towards the wall
+	ZN_TEST_ASSERT(collision_queries::sweep_capsule(
+			*data, source, 1, Vector3(0, 0.5, 0), Vector3(0, 1.5, 0), 0.4, Vector3(10, 0, 0), result
+	));
+	ZN_TEST_ASSERT(is_near(result.fraction, 0.46));
+	// Passing beside the wall
+	ZN_TEST_ASSERT(!collision_queries::sweep_capsule(
+			*data, source, 1, Vector3(0, 1, -5), Vector3(0, 2, -4), 0.3, Vector3(10, 0, 0), result
+	));
+
+	ZN_TEST_ASSERT(collision_queries::overlaps_sphere(*data, source, 1, Vector3(0, 0.3, 0), 0.5));
+	ZN_TEST_ASSERT(!collision_queries::overlaps_sphere(*data, source, 1, Vector3(0, 2, 0), 0.5));
+	// Touching isn't overlapping
+	ZN_TEST_ASSERT(!collision_queries::overlaps_aabb(*data, source, 1, box));
+	ZN_TEST_ASSERT(collision_queries::overlaps_aabb(*data, source, 1, AABB(Vector3(4.5, 1, 0), Vector3(1, 1, 1))));
+	ZN_TEST_ASSERT(collision_queries::overlaps_capsule(*data, source, 1, Vector3(3, 2, 0), Vector3(6, 2, 0), 0.25));
+
+	// Motion too long to be read at once, coming from far away. It must still stop at the wall.
+	const AABB far_box(Vector3(-19995.8, 0, -0.4), Vector3(0.8, 1.8, 0.8));
+	ZN_TEST_ASSERT(collision_queries::sweep_aabb(*data, source, 1, far_box, Vector3(40000, 0, 0), result));
+	ZN_TEST_ASSERT(is_near(result.fraction, 0.5));
+	ZN_TEST_ASSERT(result.normal.is_equal_approx(Vector3(-1, 0, 0)));
+	// Shape too large to be queried at all is blocked
+	const AABB huge_box(Vector3(-100, 0, -100), Vector3(200, 10, 200));
+	ZN_TEST_ASSERT(collision_queries::sweep_aabb(*data, source, 1, huge_box, Vector3(0, 1, 0), result));
+	ZN_TEST_ASSERT(result.fraction == 0);
+}
+
+void test_collision_queries_sdf() {
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	// Flat ground with its surface at Y=0
+	const Box3i blocks_box(Vector3i(-1, -1, -1), Vector3i(3, 3, 3));
+	const int block_size = data->get_block_size();
+	blocks_box.for_each_cell_zxy([&data, block_size](Vector3i bpos) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(Vector3iUtil::create(block_size));
+		const Vector3i origin = bpos * block_size;
+		Vector3i rpos;
+		for (rpos.z = 0; rpos.z < block_size; ++rpos.z) {
+			for (rpos.x = 0; rpos.x < block_size; ++rpos.x) {
+				for (rpos.y = 0; rpos.y < block_size; ++rpos.y) {
+					buffer->set_voxel_f(origin.y + rpos.y, rpos, VoxelBuffer::CHANNEL_SDF);
+				}
+			}
+		}
+		VoxelDataBlock block(buffer, 0);
+		block.set_edited(true);
+		ZN_TEST_ASSERT(data->try_set_block(bpos, block));
+	});
+
+	CollisionQuerySource source;
+	source.type = CollisionQuerySource::TYPE_SDF;
+
+	CollisionSweepResult result;
+
+	ZN_TEST_ASSERT(
+			collision_queries::sweep_sphere(*data, source, 1, Vector3(0, 5, 0), 0.5, Vector3(0, -10, 0), result)
+	);
+	ZN_TEST_ASSERT(is_near(result.fraction, 0.45));
+	ZN_TEST_ASSERT(result.normal.is_equal_approx(Vector3(0, 1, 0)));
+	// Rolling on the ground
+	ZN_TEST_ASSERT(
+			!collision_queries::sweep_sphere(*data, source, 1, Vector3(0, 0.5, 0), 0.5, Vector3(5, 0, 5), result)
+	);
+
+	ZN_TEST_ASSERT(collision_queries::sweep_aabb(
+			*data, source, 1, AABB(Vector3(0, 3, 0), Vector3(1, 2, 1)), Vector3(3, -6, 0), result
+	));
+	ZN_TEST_ASSERT(is_near(result.fraction, 0.5));
+
+	ZN_TEST_ASSERT(collision_queries::overlaps_capsule(*data, source, 1, Vector3(0, -1, 0), Vector3(0, 1, 0), 0.5));
+	ZN_TEST_ASSERT(!collision_queries::overlaps_capsule(*data, source, 1, Vector3(0, 1, 0), Vector3(0, 2, 0), 0.5));
+}
+
 void test_box_blur() {
 	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
 	voxels.create(64, 64, 64);
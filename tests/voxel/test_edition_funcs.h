@@ -4,6 +4,12 @@
 namespace zylann::voxel::tests {
 
 void test_run_blocky_random_tick();
+void test_run_blocky_random_tick_batched();
+void test_cellular_automaton_falling();
+void test_cellular_automaton_fluid();
+void test_blocky_lighting();
+void test_collision_queries_blocky();
+void test_collision_queries_sdf();
 void test_box_blur();
 void test_discord_soakil_copypaste();
 
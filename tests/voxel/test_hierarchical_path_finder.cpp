@@ -0,0 +1,191 @@
+#include "test_hierarchical_path_finder.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_data.h"
+#include "../../terrain/voxel_a_star_grid_3d.h"
+#include "../../terrain/voxel_hierarchical_path_finder.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/conv.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+const int TEST_AGENT_HEIGHT = 2;
+const int TEST_MAX_FALL_HEIGHT = 3;
+
+// Terrain with slopes made of 1-voxel steps, and walls agents have to go around
+int get_test_terrain_height(int x, int z) {
+	const int t = (x / 6 + z / 9) % 6;
+	int h = 4 + (t < 3 ? t : 6 - t);
+	if (x % 32 == 16 && z % 64 < 48) {
+		h += 6;
+	}
+	return h;
+}
+
+Vector3i get_test_ground_position(int x, int z) {
+	return Vector3i(x, get_test_terrain_height(x, z), z);
+}
+
+void load_test_path_finding_terrain(VoxelData &data, const Box3i blocks_box) {
+	const int block_size = data.get_block_size();
+
+	blocks_box.for_each_cell_zxy([&data, block_size](Vector3i bpos) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(Vector3iUtil::create(block_size));
+		const Vector3i origin = bpos * block_size;
+
+		for (int z = 0; z < block_size; ++z) {
+			for (int x = 0; x < block_size; ++x) {
+				const int h = get_test_terrain_height(origin.x + x, origin.z + z) - origin.y;
+				for (int y = 0; y < math::min(h, block_size); ++y) {
+					buffer->set_voxel(1, x, y, z, VoxelBuffer::CHANNEL_TYPE);
+				}
+			}
+		}
+
+		VoxelDataBlock block(buffer, 0);
+		block.set_edited(true);
+		ZN_TEST_ASSERT(data.try_set_block(bpos, block));
+	});
+}
+
+bool is_test_solid(const VoxelData &data, Vector3i pos) {
+	VoxelSingleValue defval;
+	defval.i = 0;
+	return data.get_voxel(pos, VoxelBuffer::CHANNEL_TYPE, defval).i != 0;
+}
+
+// Checks that the path goes between the given positions, by steps to neighbor cells the agent fits in
+bool is_valid_test_path(const VoxelData &data, Span<const Vector3i> path, Vector3i from, Vector3i to) {
+	if (path.size() == 0 || path[0] != from || path[path.size() - 1] != to) {
+		return false;
+	}
+	for (unsigned int i = 0; i < path.size(); ++i) {
+		const Vector3i pos = path[i];
+		for (int y = 0; y < TEST_AGENT_HEIGHT; ++y) {
+			if (is_test_solid(data, pos + Vector3i(0, y, 0))) {
+				return false;
+			}
+		}
+		if (i > 0) {
+			const Vector3i d = math::abs(pos - path[i - 1]);
+			if (d == Vector3i() || d.x > 1 || d.y > 1 || d.z > 1) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+float get_test_path_cost(Span<const Vector3i> path) {
+	float cost = 0.f;
+	for (unsigned int i = 1; i < path.size(); ++i) {
+		cost += math::length(to_vec3f(path[i] - path[i - 1]));
+	}
+	return cost;
+}
+
+bool find_test_path_a_star(
+		std::shared_ptr<VoxelData> data,
+		Box3i region,
+		Vector3i from,
+		Vector3i to,
+		StdVector<Vector3i> &out_path
+) {
+	VoxelAStarGrid3DInternal a_star;
+	a_star.data = data;
+	a_star.set_region(region);
+	// The default agent size fits in 1x2x1 voxels
+	a_star.set_max_fall_height(TEST_MAX_FALL_HEIGHT);
+	a_star.start(from, to);
+	a_star.init_cache();
+	while (a_star.is_running()) {
+		a_star.step();
+	}
+	Span<const Vector3i> path = a_star.get_path();
+	if (path.size() == 0) {
+		return false;
+	}
+	out_path.clear();
+	out_path.insert(out_path.end(), path.begin(), path.end());
+	// The destination is not included
+	out_path.push_back(to);
+	return true;
+}
+
+} // namespace
+
+void test_hierarchical_path_finder() {
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	const Box3i blocks_box(Vector3i(0, 0, 0), Vector3i(8, 1, 8));
+	load_test_path_finding_terrain(*data, blocks_box);
+	const int block_size = data->get_block_size();
+	const Box3i voxel_box(blocks_box.position * block_size, blocks_box.size * block_size);
+
+	HierarchicalPathFinder path_finder(data, TEST_AGENT_HEIGHT, TEST_MAX_FALL_HEIGHT);
+	StdVector<Vector3i> path;
+
+	// Same cluster
+	{
+		const Vector3i from = get_test_ground_position(2, 2);
+		const Vector3i to = get_test_ground_position(10, 6);
+		ZN_TEST_ASSERT(path_finder.find_path(from, to, path));
+		ZN_TEST_ASSERT(is_valid_test_path(*data, to_span(path), from, to));
+	}
+
+	// Across many clusters, going around walls
+	const Vector3i from = get_test_ground_position(2, 2);
+	const Vector3i to = get_test_ground_position(120, 10);
+	ZN_TEST_ASSERT(path_finder.find_path(from, to, path));
+	ZN_TEST_ASSERT(is_valid_test_path(*data, to_span(path), from, to));
+	ZN_TEST_ASSERT(path_finder.get_cached_cluster_count() > 0);
+
+	// Paths are slightly less optimal than with a regular A*, but not by much
+	{
+		const Vector3i a_star_to = get_test_ground_position(40, 20);
+		StdVector<Vector3i> a_star_path;
+		ZN_TEST_ASSERT(find_test_path_a_star(data, voxel_box, from, a_star_to, a_star_path));
+		ZN_TEST_ASSERT(path_finder.find_path(from, a_star_to, path));
+		ZN_TEST_ASSERT(is_valid_test_path(*data, to_span(path), from, a_star_to));
+		ZN_TEST_ASSERT(get_test_path_cost(to_span(path)) <= 1.5f * get_test_path_cost(to_span(a_star_path)));
+	}
+
+	// Inside walls
+	ZN_TEST_ASSERT(!path_finder.find_path(from, Vector3i(16, 5, 10), path));
+
+	// Close the gaps in walls at X=16 and check the cache gets updated after invalidation
+	const Box3i gap_box(Vector3i(16, 0, 48), Vector3i(1, 20, 16));
+	const Box3i gap_box2(Vector3i(16, 0, 112), Vector3i(1, 20, 16));
+	for (const Box3i &box : { gap_box, gap_box2 }) {
+		box.for_each_cell_zxy([&data](Vector3i pos) { //
+			ZN_TEST_ASSERT(data->try_set_voxel(1, pos, VoxelBuffer::CHANNEL_TYPE));
+		});
+		path_finder.invalidate_area(box);
+	}
+	ZN_TEST_ASSERT(!path_finder.find_path(from, to, path));
+
+	// Open a door
+	// At the same height as the ground around it
+	const Box3i door_box(Vector3i(16, 6, 80), Vector3i(1, 20, 2));
+	door_box.for_each_cell_zxy([&data](Vector3i pos) { //
+		ZN_TEST_ASSERT(data->try_set_voxel(0, pos, VoxelBuffer::CHANNEL_TYPE));
+	});
+	path_finder.invalidate_area(door_box);
+	ZN_TEST_ASSERT(path_finder.find_path(from, to, path));
+	ZN_TEST_ASSERT(is_valid_test_path(*data, to_span(path), from, to));
+	bool goes_through_door = false;
+	for (const Vector3i pos : path) {
+		if (door_box.contains(pos)) {
+			goes_through_door = true;
+			break;
+		}
+	}
+	ZN_TEST_ASSERT(goes_through_door);
+
+	path_finder.clear_cache();
+	ZN_TEST_ASSERT(path_finder.get_cached_cluster_count() == 0);
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,10 @@
+#ifndef VOXEL_TEST_HIERARCHICAL_PATH_FINDER_H
+#define VOXEL_TEST_HIERARCHICAL_PATH_FINDER_H
+
+namespace zylann::voxel::tests {
+
+void test_hierarchical_path_finder();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_HIERARCHICAL_PATH_FINDER_H
@@ -0,0 +1,101 @@
+#include "test_multipass_column_cache.h"
+#include "../../generators/multipass/multipass_column_cache.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+MultipassColumnCache::ColumnData make_test_column(int8_t subpass_index, int value) {
+	MultipassColumnCache::ColumnData data;
+	data.subpass_index = subpass_index;
+	for (unsigned int i = 0; i < 3; ++i) {
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+		voxels.create(Vector3i(4, 4, 4));
+		voxels.set_voxel(value + i, Vector3i(1, 2, 3), VoxelBuffer::CHANNEL_TYPE);
+		data.blocks.push_back(std::move(voxels));
+	}
+	return data;
+}
+
+bool is_test_column(const MultipassColumnCache::ColumnData &data, int8_t subpass_index, int value) {
+	if (data.subpass_index != subpass_index || data.blocks.size() != 3) {
+		return false;
+	}
+	for (unsigned int i = 0; i < data.blocks.size(); ++i) {
+		if (data.blocks[i].get_voxel(Vector3i(1, 2, 3), VoxelBuffer::CHANNEL_TYPE) != uint64_t(value + i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+void test_multipass_column_cache() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	MultipassColumnCache cache(test_dir.get_path(), 2);
+
+	// Loading a column that is still pending save gets it from memory
+	{
+		cache.push_pending_save(Vector2i(0, 0), make_test_column(2, 10));
+		ZN_TEST_ASSERT(cache.has(Vector2i(0, 0)));
+
+		MultipassColumnCache::ColumnData data;
+		ZN_TEST_ASSERT(cache.load(Vector2i(0, 0), data) == MultipassColumnCache::LOAD_FOUND);
+		ZN_TEST_ASSERT(is_test_column(data, 2, 10));
+		ZN_TEST_ASSERT(!cache.has(Vector2i(0, 0)));
+
+		// Nothing left to save
+		ZN_TEST_ASSERT(cache.save(Vector2i(0, 0)));
+		ZN_TEST_ASSERT(cache.get_stored_column_count() == 0);
+	}
+
+	// Saved columns are loaded from files
+	{
+		cache.push_pending_save(Vector2i(1, 0), make_test_column(1, 20));
+		ZN_TEST_ASSERT(cache.save(Vector2i(1, 0)));
+		ZN_TEST_ASSERT(cache.get_stored_column_count() == 1);
+
+		MultipassColumnCache::ColumnData data;
+		ZN_TEST_ASSERT(cache.load(Vector2i(1, 0), data) == MultipassColumnCache::LOAD_FOUND);
+		ZN_TEST_ASSERT(is_test_column(data, 1, 20));
+	}
+
+	// The least recently used column gets evicted
+	{
+		cache.push_pending_save(Vector2i(2, 0), make_test_column(3, 30));
+		ZN_TEST_ASSERT(cache.save(Vector2i(2, 0)));
+
+		// Use (1, 0) again so (2, 0) becomes the least recently used
+		{
+			MultipassColumnCache::ColumnData data;
+			ZN_TEST_ASSERT(cache.load(Vector2i(1, 0), data) == MultipassColumnCache::LOAD_FOUND);
+		}
+
+		cache.push_pending_save(Vector2i(3, 0), make_test_column(4, 40));
+		ZN_TEST_ASSERT(cache.save(Vector2i(3, 0)));
+
+		ZN_TEST_ASSERT(cache.get_stored_column_count() == 2);
+		ZN_TEST_ASSERT(cache.has(Vector2i(1, 0)));
+		ZN_TEST_ASSERT(!cache.has(Vector2i(2, 0)));
+		ZN_TEST_ASSERT(cache.has(Vector2i(3, 0)));
+
+		MultipassColumnCache::ColumnData data;
+		ZN_TEST_ASSERT(cache.load(Vector2i(2, 0), data) == MultipassColumnCache::LOAD_NOT_FOUND);
+		ZN_TEST_ASSERT(cache.load(Vector2i(3, 0), data) == MultipassColumnCache::LOAD_FOUND);
+		ZN_TEST_ASSERT(is_test_column(data, 4, 40));
+	}
+
+	// An expired cache doesn't write anything
+	{
+		cache.set_expired();
+		cache.push_pending_save(Vector2i(4, 0), make_test_column(0, 50));
+		ZN_TEST_ASSERT(cache.save(Vector2i(4, 0)));
+		ZN_TEST_ASSERT(cache.get_stored_column_count() == 2);
+	}
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,10 @@
+#ifndef VOXEL_TEST_MULTIPASS_COLUMN_CACHE_H
+#define VOXEL_TEST_MULTIPASS_COLUMN_CACHE_H
+
+namespace zylann::voxel::tests {
+
+void test_multipass_column_cache();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_MULTIPASS_COLUMN_CACHE_H
@@ -166,6 +166,104 @@ void test_region_file() {
 	}
 }
 
+void test_region_file_free_list_and_compaction() {
+	const int block_size_po2 = 4;
+	const int block_size = 1 << block_size_po2;
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+	const String region_file_path = test_dir.get_path().path_join("test_region_file_compaction.vxr");
+
+	struct Chunk {
+		VoxelBuffer voxels;
+		Chunk() : voxels(VoxelBuffer::ALLOCATOR_DEFAULT) {}
+	};
+
+	StdUnorderedMap<Vector3i, Chunk> buffers;
+	RandomPCG rng;
+	rng.seed(131183);
+
+	auto check_blocks = [&buffers](RegionFile &region_file) {
+		for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+			VoxelBuffer loaded_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+			const Error load_error = region_file.load_block(it->first, loaded_voxel_buffer);
+			ZN_TEST_ASSERT(load_error == OK);
+			ZN_TEST_ASSERT(it->second.voxels.equals(loaded_voxel_buffer));
+		}
+	};
+
+	{
+		RegionFile region_file;
+		RegionFormat region_format = region_file.get_format();
+		region_format.block_size_po2 = block_size_po2;
+		region_format.region_size = Vector3i(8, 8, 8);
+		const VoxelBuffer reference_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			region_format.channel_depths[channel_index] = reference_buffer.get_channel_depth(channel_index);
+		}
+		ZN_TEST_ASSERT(region_file.set_format(region_format));
+		region_file.set_allocation_strategy(RegionFile::ALLOCATION_FREE_LIST);
+
+		const Error open_error = region_file.open(region_file_path, true);
+		ZN_TEST_ASSERT(open_error == OK);
+
+		// Save blocks of varying compressibility at the same positions many times, so they shrink and grow
+		for (int i = 0; i < 2000; ++i) {
+			const Vector3i pos(rng.rand() % 8, rng.rand() % 8, rng.rand() % 2);
+
+			VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+			voxels.create(Vector3iUtil::create(block_size));
+			const int noisy_layers = rng.rand() % (block_size + 1);
+			for (int z = 0; z < block_size; ++z) {
+				for (int x = 0; x < block_size; ++x) {
+					for (int y = 0; y < noisy_layers; ++y) {
+						voxels.set_voxel(rng.rand() % 256, x, y, z, 0);
+					}
+				}
+			}
+
+			const Error save_error = region_file.save_block(pos, voxels);
+			ZN_TEST_ASSERT(save_error == OK);
+			buffers[pos].voxels = std::move(voxels);
+		}
+
+		check_blocks(region_file);
+
+		// Holes must be found again after reopening
+		const unsigned int free_sector_count = region_file.get_free_sector_count();
+		ZN_TEST_ASSERT(region_file.close() == OK);
+		ZN_TEST_ASSERT(region_file.open(region_file_path, false) == OK);
+		ZN_TEST_ASSERT(region_file.get_free_sector_count() == free_sector_count);
+		check_blocks(region_file);
+
+		const Error compact_error = region_file.compact();
+		ZN_TEST_ASSERT(compact_error == OK);
+		ZN_TEST_ASSERT(region_file.is_open());
+		ZN_TEST_ASSERT(region_file.get_free_sector_count() == 0);
+		check_blocks(region_file);
+	}
+	// The default strategy must be able to read and write compacted files
+	{
+		RegionFile region_file;
+		ZN_TEST_ASSERT(region_file.open(region_file_path, false) == OK);
+		ZN_TEST_ASSERT(region_file.get_free_sector_count() == 0);
+		check_blocks(region_file);
+
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+		voxels.create(Vector3iUtil::create(block_size));
+		for (int z = 0; z < block_size; ++z) {
+			for (int x = 0; x < block_size; ++x) {
+				for (int y = 0; y < block_size; ++y) {
+					voxels.set_voxel(rng.rand() % 256, x, y, z, 0);
+				}
+			}
+		}
+		const Vector3i pos = buffers.begin()->first;
+		ZN_TEST_ASSERT(region_file.save_block(pos, voxels) == OK);
+		buffers[pos].voxels = std::move(voxels);
+		check_blocks(region_file);
+	}
+}
+
 // Test based on an issue from `I am the Carl` on Discord. It should only not crash or cause errors.
 void test_voxel_stream_region_files() {
 	const int block_size_po2 = 4;
@@ -4,6 +4,7 @@
 namespace zylann::voxel::tests {
 
 void test_region_file();
+void test_region_file_free_list_and_compaction();
 void test_voxel_stream_region_files();
 
 } // namespace zylann::voxel::tests
@@ -1,5 +1,7 @@
 #include "test_stream_sqlite.h"
 #include "../../streams/sqlite/voxel_stream_sqlite.h"
+#include "../../thirdparty/sqlite/sqlite3.h"
+#include "../../util/string/format.h"
 #include "../testing.h"
 
 namespace zylann::voxel::tests {
@@ -61,4 +63,119 @@ void test_voxel_stream_sqlite_basic() {
 	test_voxel_stream_sqlite_basic(true);
 }
 
+void test_voxel_stream_sqlite_migration_from_v0() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const String database_path = test_dir.get_path().path_join("database.sqlite");
+
+	VoxelBuffer vb1(VoxelBuffer::ALLOCATOR_DEFAULT);
+	vb1.create(Vector3i(16, 16, 16));
+	vb1.fill_area(1, Vector3i(5, 5, 5), Vector3i(10, 11, 12), 0);
+	const Vector3i vb1_pos(1, 2, -3);
+
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+		VoxelStreamSQLite::VoxelQueryData q{ vb1, vb1_pos, 0, VoxelStream::RESULT_ERROR };
+		stream->save_voxel_block(q);
+		stream->flush();
+	}
+	{
+		// Turn the database into what older versions would have written, where keys were packed coordinates
+		const uint64_t v0_key = ((static_cast<uint64_t>(vb1_pos.x) & 0xffff) << 32) |
+				((static_cast<uint64_t>(vb1_pos.y) & 0xffff) << 16) | (static_cast<uint64_t>(vb1_pos.z) & 0xffff);
+
+		sqlite3 *db = nullptr;
+		const CharString path_utf8 = database_path.utf8();
+		ZN_TEST_ASSERT(sqlite3_open(path_utf8.get_data(), &db) == SQLITE_OK);
+		const StdString sql = format("UPDATE blocks SET loc={}; UPDATE meta SET version=0;", v0_key);
+		ZN_TEST_ASSERT(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+		sqlite3_close(db);
+	}
+	{
+		// Opening the database should migrate it
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+		VoxelBuffer loaded_vb1(VoxelBuffer::ALLOCATOR_DEFAULT);
+		VoxelStreamSQLite::VoxelQueryData q{ loaded_vb1, vb1_pos, 0, VoxelStream::RESULT_ERROR };
+		stream->load_voxel_block(q);
+		ZN_TEST_ASSERT(q.result == VoxelStream::RESULT_BLOCK_FOUND);
+		ZN_TEST_ASSERT(loaded_vb1.equals(vb1));
+	}
+}
+
+void test_voxel_stream_sqlite_load_area() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const String database_path = test_dir.get_path().path_join("database.sqlite");
+
+	// Only some of the blocks of the area are saved, using their position as value
+	const Box3i area(Vector3i(-4, -3, -4), Vector3i(8, 6, 8));
+	struct L {
+		static bool is_saved(Vector3i pos) {
+			return (pos.x + pos.y + pos.z) % 3 != 0;
+		}
+		static uint64_t get_value(Vector3i pos) {
+			return (pos.x + 10) + (pos.y + 10) * 20 + (pos.z + 10) * 400;
+		}
+	};
+
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+
+		StdVector<VoxelBuffer> buffers;
+		StdVector<VoxelStream::VoxelQueryData> queries;
+		buffers.reserve(Vector3iUtil::get_volume(area.size));
+		area.for_each_cell_zxy([&buffers, &queries](Vector3i pos) {
+			if (!L::is_saved(pos)) {
+				return;
+			}
+			buffers.emplace_back(VoxelBuffer::ALLOCATOR_DEFAULT);
+			VoxelBuffer &vb = buffers.back();
+			vb.create(Vector3i(16, 16, 16));
+			vb.fill(L::get_value(pos), 0);
+			queries.push_back(VoxelStream::VoxelQueryData{ vb, pos, 0, VoxelStream::RESULT_ERROR });
+		});
+		stream->save_voxel_blocks(to_span(queries));
+		stream->flush();
+	}
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+
+		// Also request a block twice and blocks far away from the others
+		StdVector<Vector3i> positions;
+		area.for_each_cell_zxy([&positions](Vector3i pos) { positions.push_back(pos); });
+		positions.push_back(Vector3i(1, 1, 1));
+		positions.push_back(Vector3i(1000, 1, -1000));
+		positions.push_back(Vector3i(-1000, 1, 1000));
+
+		StdVector<VoxelBuffer> buffers;
+		StdVector<VoxelStream::VoxelQueryData> queries;
+		buffers.reserve(positions.size());
+		for (const Vector3i pos : positions) {
+			buffers.emplace_back(VoxelBuffer::ALLOCATOR_DEFAULT);
+			queries.push_back(VoxelStream::VoxelQueryData{ buffers.back(), pos, 0, VoxelStream::RESULT_ERROR });
+		}
+		stream->load_voxel_blocks(to_span(queries));
+
+		for (const VoxelStream::VoxelQueryData &q : queries) {
+			if (area.contains(q.position_in_blocks) && L::is_saved(q.position_in_blocks)) {
+				ZN_TEST_ASSERT(q.result == VoxelStream::RESULT_BLOCK_FOUND);
+				ZN_TEST_ASSERT(q.voxel_buffer.get_size() == Vector3i(16, 16, 16));
+				ZN_TEST_ASSERT(q.voxel_buffer.get_voxel(Vector3i(3, 4, 5), 0) == L::get_value(q.position_in_blocks));
+			} else {
+				ZN_TEST_ASSERT(q.result == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+			}
+		}
+	}
+}
+
 } // namespace zylann::voxel::tests
\ No newline at end of file
@@ -4,6 +4,8 @@
 namespace zylann::voxel::tests {
 
 void test_voxel_stream_sqlite_basic();
+void test_voxel_stream_sqlite_migration_from_v0();
+void test_voxel_stream_sqlite_load_area();
 
 } // namespace zylann::voxel::tests
 
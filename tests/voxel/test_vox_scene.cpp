@@ -0,0 +1,335 @@
+#include "test_vox_scene.h"
+#include "../../meshers/cubes/voxel_color_palette.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_data.h"
+#include "../../streams/vox/vox_data.h"
+#include "../../streams/vox/vox_loader.h"
+#include "../../streams/vox/vox_scene_converter.h"
+#include "../../streams/voxel_stream_memory.h"
+#include "../../terrain/fixed_lod/voxel_terrain.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/classes/file_access.h"
+#include "../testing.h"
+#include <cstring>
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+// Builds a .vox file in memory, following
+// https://github.com/ephtracy/voxel-model/blob/master/MagicaVoxel-file-format-vox.txt
+class TestVoxFileWriter {
+public:
+	void append_u32(uint32_t v) {
+		_bytes.push_back(v & 0xff);
+		_bytes.push_back((v >> 8) & 0xff);
+		_bytes.push_back((v >> 16) & 0xff);
+		_bytes.push_back((v >> 24) & 0xff);
+	}
+
+	void append_id(const char *id) {
+		for (unsigned int i = 0; i < 4; ++i) {
+			_bytes.push_back(id[i]);
+		}
+	}
+
+	void append_string(const char *s) {
+		const unsigned int len = strlen(s);
+		append_u32(len);
+		for (unsigned int i = 0; i < len; ++i) {
+			_bytes.push_back(s[i]);
+		}
+	}
+
+	void begin_chunk(const char *id) {
+		append_id(id);
+		_chunk_size_position = _bytes.size();
+		// Content size, patched when the chunk ends
+		append_u32(0);
+		// Children size
+		append_u32(0);
+	}
+
+	void end_chunk() {
+		const uint32_t content_size = _bytes.size() - _chunk_size_position - 8;
+		for (unsigned int i = 0; i < 4; ++i) {
+			_bytes[_chunk_size_position + i] = (content_size >> (i * 8)) & 0xff;
+		}
+	}
+
+	// `t` and `r` are optional frame attributes. Positions and rotations are in MagicaVoxel's Z-up convention.
+	void append_transform_node(int id, int child_id, const char *t, const char *r) {
+		begin_chunk("nTRN");
+		append_u32(id);
+		append_u32(0); // Attributes
+		append_u32(child_id);
+		append_u32(-1); // Reserved
+		append_u32(-1); // Layer
+		append_u32(1); // Frames
+		append_u32((t != nullptr ? 1 : 0) + (r != nullptr ? 1 : 0));
+		if (t != nullptr) {
+			append_string("_t");
+			append_string(t);
+		}
+		if (r != nullptr) {
+			append_string("_r");
+			append_string(r);
+		}
+		end_chunk();
+	}
+
+	void append_shape_node(int id, int model_id) {
+		begin_chunk("nSHP");
+		append_u32(id);
+		append_u32(0); // Attributes
+		append_u32(1); // Models
+		append_u32(model_id);
+		append_u32(0); // Model attributes
+		end_chunk();
+	}
+
+	Span<const uint8_t> get_bytes() const {
+		return to_span(_bytes);
+	}
+
+private:
+	StdVector<uint8_t> _bytes;
+	size_t _chunk_size_position = 0;
+};
+
+// Writes a scene with two models placed three times:
+// - Model 0, 1x2 voxels with colors 1 and 2, translated
+// - Model 1, one voxel with color 3, translated
+// - Model 0 again, rotated 180 degrees around the vertical axis and translated
+// Palette colors have their red component equal to their index.
+void write_test_vox_scene(String fpath) {
+	TestVoxFileWriter children;
+
+	children.begin_chunk("SIZE");
+	children.append_u32(2);
+	children.append_u32(1);
+	children.append_u32(1);
+	children.end_chunk();
+
+	children.begin_chunk("XYZI");
+	children.append_u32(2);
+	// x, y, z, color index
+	children.append_u32(0x01000000);
+	children.append_u32(0x02000001);
+	children.end_chunk();
+
+	children.begin_chunk("SIZE");
+	children.append_u32(1);
+	children.append_u32(1);
+	children.append_u32(1);
+	children.end_chunk();
+
+	children.begin_chunk("XYZI");
+	children.append_u32(1);
+	children.append_u32(0x03000000);
+	children.end_chunk();
+
+	children.append_transform_node(0, 1, nullptr, nullptr);
+
+	children.begin_chunk("nGRP");
+	children.append_u32(1);
+	children.append_u32(0); // Attributes
+	children.append_u32(3);
+	children.append_u32(2);
+	children.append_u32(4);
+	children.append_u32(6);
+	children.end_chunk();
+
+	children.append_transform_node(2, 3, "10 0 0", nullptr);
+	children.append_shape_node(3, 0);
+	children.append_transform_node(4, 5, "0 0 20", nullptr);
+	children.append_shape_node(5, 1);
+	// Rows (-1, 0, 0), (0, -1, 0), (0, 0, 1)
+	children.append_transform_node(6, 7, "30 0 0", "52");
+	children.append_shape_node(7, 0);
+
+	children.begin_chunk("RGBA");
+	for (unsigned int i = 1; i <= 256; ++i) {
+		// Bytes are r, g, b, a
+		children.append_u32(0xff000000 | (i & 0xff));
+	}
+	children.end_chunk();
+
+	Span<const uint8_t> children_bytes = children.get_bytes();
+
+	TestVoxFileWriter header;
+	header.append_id("VOX ");
+	header.append_u32(150);
+	header.append_id("MAIN");
+	header.append_u32(0);
+	header.append_u32(children_bytes.size());
+
+	Error open_err;
+	Ref<FileAccess> f = godot::open_file(fpath, FileAccess::WRITE, open_err);
+	ZN_TEST_ASSERT(f.is_valid());
+	godot::store_buffer(**f, header.get_bytes());
+	godot::store_buffer(**f, children_bytes);
+}
+
+struct ExpectedVoxel {
+	Vector3i position;
+	uint8_t color_index;
+};
+
+// Where voxels of the test scene end up. Models are rotated around their center, and MagicaVoxel's Z axis becomes Y.
+const ExpectedVoxel g_expected_voxels[] = {
+	{ Vector3i(0, 0, 9), 1 }, //
+	{ Vector3i(0, 0, 10), 2 }, //
+	{ Vector3i(0, 20, 0), 3 }, //
+	{ Vector3i(-1, 0, 30), 1 }, //
+	{ Vector3i(-1, 0, 29), 2 }
+};
+
+} // namespace
+
+void test_vox_scene_model_instances() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+	const String fpath = test_dir.get_path().path_join("test_scene.vox");
+	write_test_vox_scene(fpath);
+
+	magica::Data data;
+	ZN_TEST_ASSERT(data.load_from_file(fpath, false) == OK);
+	ZN_TEST_ASSERT(data.get_model_count() == 2);
+
+	StdVector<magica::ModelInstance> instances;
+	ZN_TEST_ASSERT(magica::get_model_instances(data, instances) == OK);
+	ZN_TEST_ASSERT(instances.size() == 3);
+
+	// Instances are in the order of the scene graph
+	{
+		const magica::ModelInstance &instance = instances[0];
+		ZN_TEST_ASSERT(instance.model_index == 0);
+		ZN_TEST_ASSERT(instance.axes[0] == Vector3i(1, 0, 0));
+		ZN_TEST_ASSERT(instance.axes[1] == Vector3i(0, 1, 0));
+		ZN_TEST_ASSERT(instance.axes[2] == Vector3i(0, 0, 1));
+		ZN_TEST_ASSERT(instance.origin == Vector3i(0, 0, 9));
+		ZN_TEST_ASSERT(instance.box == Box3i(Vector3i(0, 0, 9), Vector3i(1, 1, 2)));
+	}
+	{
+		const magica::ModelInstance &instance = instances[1];
+		ZN_TEST_ASSERT(instance.model_index == 1);
+		ZN_TEST_ASSERT(instance.origin == Vector3i(0, 20, 0));
+		ZN_TEST_ASSERT(instance.box == Box3i(Vector3i(0, 20, 0), Vector3i(1, 1, 1)));
+	}
+	{
+		const magica::ModelInstance &instance = instances[2];
+		ZN_TEST_ASSERT(instance.model_index == 0);
+		ZN_TEST_ASSERT(instance.axes[0] == Vector3i(-1, 0, 0));
+		ZN_TEST_ASSERT(instance.axes[1] == Vector3i(0, 1, 0));
+		ZN_TEST_ASSERT(instance.axes[2] == Vector3i(0, 0, -1));
+		ZN_TEST_ASSERT(instance.box == Box3i(Vector3i(-1, 0, 29), Vector3i(1, 1, 2)));
+		// The second voxel of the model comes first along Z
+		ZN_TEST_ASSERT(instance.transform(Vector3i(0, 0, 0)) == Vector3i(-1, 0, 30));
+		ZN_TEST_ASSERT(instance.transform(Vector3i(0, 0, 1)) == Vector3i(-1, 0, 29));
+	}
+
+	magica::SceneConverter converter;
+	ZN_TEST_ASSERT(converter.open(fpath) == OK);
+	ZN_TEST_ASSERT(converter.get_bounds() == Box3i::from_min_max(Vector3i(-1, 0, 0), Vector3i(1, 21, 31)));
+	ZN_TEST_ASSERT(converter.get_palette()[3].r == 3);
+}
+
+void test_vox_scene_load_to_stream() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+	const String fpath = test_dir.get_path().path_join("test_scene.vox");
+	write_test_vox_scene(fpath);
+
+	Ref<VoxelStreamMemory> stream;
+	stream.instantiate();
+	Ref<VoxelColorPalette> palette;
+	palette.instantiate();
+	const Vector3i offset(5, 0, 0);
+
+	const int err = VoxelVoxLoader::load_scene_to_stream(
+			fpath, stream, palette, godot::VoxelBuffer::CHANNEL_COLOR, offset
+	);
+	ZN_TEST_ASSERT(err == OK);
+	ZN_TEST_ASSERT(palette->get_color8(3).r == 3);
+
+	const int block_size_po2 = stream->get_block_size_po2();
+	const int block_size_mask = (1 << block_size_po2) - 1;
+
+	struct L {
+		static VoxelStream::ResultCode load_block(VoxelStream &stream, Vector3i bpos, VoxelBuffer &voxels) {
+			VoxelStream::VoxelQueryData q{ voxels, bpos, 0, VoxelStream::RESULT_ERROR };
+			stream.load_voxel_block(q);
+			return q.result;
+		}
+	};
+
+	// A palette was given, so indices are written
+	for (const ExpectedVoxel &ev : g_expected_voxels) {
+		const Vector3i pos = ev.position + offset;
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(L::load_block(**stream, pos >> block_size_po2, voxels) == VoxelStream::RESULT_BLOCK_FOUND);
+		const Vector3i rpos(pos.x & block_size_mask, pos.y & block_size_mask, pos.z & block_size_mask);
+		ZN_TEST_ASSERT(voxels.get_voxel(rpos, VoxelBuffer::CHANNEL_COLOR) == ev.color_index);
+	}
+
+	// Cells next to models are empty
+	{
+		const Vector3i pos = Vector3i(0, 0, 11) + offset;
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(L::load_block(**stream, pos >> block_size_po2, voxels) == VoxelStream::RESULT_BLOCK_FOUND);
+		const Vector3i rpos(pos.x & block_size_mask, pos.y & block_size_mask, pos.z & block_size_mask);
+		ZN_TEST_ASSERT(voxels.get_voxel(rpos, VoxelBuffer::CHANNEL_COLOR) == 0);
+	}
+
+	// Blocks without models are not saved, even in converted regions
+	{
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(L::load_block(**stream, Vector3i(3, 3, 3), voxels) == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+	}
+}
+
+void test_vox_scene_load_to_terrain() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+	const String fpath = test_dir.get_path().path_join("test_scene.vox");
+	write_test_vox_scene(fpath);
+
+	VoxelTerrain *terrain = memnew(VoxelTerrain);
+	VoxelData &data = *terrain->get_storage_shared();
+	const int block_size = data.get_block_size();
+
+	// The terrain streams its data, so voxels are only pasted into blocks that are loaded
+	const Vector3i existing_voxel_pos(0, 1, 9);
+	const uint8_t existing_voxel_value = 7;
+	const Box3i blocks_box = Box3i::from_min_max(Vector3i(-1, 0, 0), Vector3i(1, 2, 2));
+	blocks_box.for_each_cell_zxy([&data, block_size](Vector3i bpos) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(Vector3iUtil::create(block_size));
+		VoxelDataBlock block(buffer, 0);
+		ZN_TEST_ASSERT(data.try_set_block(bpos, block));
+	});
+	ZN_TEST_ASSERT(data.try_set_voxel(existing_voxel_value, existing_voxel_pos, VoxelBuffer::CHANNEL_COLOR));
+
+	Ref<VoxelColorPalette> palette;
+	palette.instantiate();
+
+	const int err = VoxelVoxLoader::load_scene_to_terrain(
+			fpath, terrain, palette, godot::VoxelBuffer::CHANNEL_COLOR, Vector3i()
+	);
+	ZN_TEST_ASSERT(err == OK);
+
+	VoxelSingleValue defval;
+	defval.i = 0;
+
+	for (const ExpectedVoxel &ev : g_expected_voxels) {
+		ZN_TEST_ASSERT(data.get_voxel(ev.position, VoxelBuffer::CHANNEL_COLOR, defval).i == ev.color_index);
+	}
+
+	// Empty voxels of models don't erase what was already there
+	ZN_TEST_ASSERT(data.get_voxel(existing_voxel_pos, VoxelBuffer::CHANNEL_COLOR, defval).i == existing_voxel_value);
+
+	memdelete(terrain);
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,12 @@
+#ifndef VOXEL_TEST_VOX_SCENE_H
+#define VOXEL_TEST_VOX_SCENE_H
+
+namespace zylann::voxel::tests {
+
+void test_vox_scene_model_instances();
+void test_vox_scene_load_to_stream();
+void test_vox_scene_load_to_terrain();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_VOX_SCENE_H
@@ -118,14 +118,10 @@ void test_voxel_buffer_metadata() {
 		VoxelBuffer rvb(VoxelBuffer::ALLOCATOR_DEFAULT);
 		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(bytes), rvb));
 
-		const FlatMapMoveOnly<Vector3i, VoxelMetadata> &vb_meta_map = vb.get_voxel_metadata();
-		const FlatMapMoveOnly<Vector3i, VoxelMetadata> &rvb_meta_map = rvb.get_voxel_metadata();
+		ZN_TEST_ASSERT(vb.get_voxel_metadata().size() == rvb.get_voxel_metadata().size());
 
-		ZN_TEST_ASSERT(vb_meta_map.size() == rvb_meta_map.size());
-
-		for (auto it = vb_meta_map.begin(); it != vb_meta_map.end(); ++it) {
-			const VoxelMetadata &meta = it->value;
-			const VoxelMetadata *rmeta = rvb_meta_map.find(it->key);
+		vb.for_each_voxel_metadata([&rvb](Vector3i pos, const VoxelMetadata &meta) {
+			const VoxelMetadata *rmeta = rvb.get_voxel_metadata(pos);
 
 			ZN_TEST_ASSERT(rmeta != nullptr);
 			ZN_TEST_ASSERT(rmeta->get_type() == meta.get_type());
@@ -145,7 +141,7 @@ void test_voxel_buffer_metadata() {
 					ZN_TEST_ASSERT(false);
 					break;
 			}
-		}
+		});
 	}
 }
 
@@ -202,16 +198,13 @@ void test_voxel_buffer_metadata_gd() {
 		// `equals` does not compare metadata at the moment, mainly because it's not trivial and there is no use case
 		// for it apart from this test, so do it manually
 
-		const FlatMapMoveOnly<Vector3i, VoxelMetadata> &vb_meta_map = vb->get_buffer().get_voxel_metadata();
-		const FlatMapMoveOnly<Vector3i, VoxelMetadata> &vb2_meta_map = vb2->get_buffer().get_voxel_metadata();
-
-		ZN_TEST_ASSERT(vb_meta_map.size() == vb2_meta_map.size());
+		const zylann::voxel::VoxelBuffer &buffer2 = vb2->get_buffer();
+		ZN_TEST_ASSERT(vb->get_buffer().get_voxel_metadata().size() == buffer2.get_voxel_metadata().size());
 
-		for (auto it = vb_meta_map.begin(); it != vb_meta_map.end(); ++it) {
-			const VoxelMetadata &meta = it->value;
+		vb->get_buffer().for_each_voxel_metadata([&buffer2](Vector3i pos, const VoxelMetadata &meta) {
 			ZN_TEST_ASSERT(meta.get_type() == godot::METADATA_TYPE_VARIANT);
 
-			const VoxelMetadata *meta2 = vb2_meta_map.find(it->key);
+			const VoxelMetadata *meta2 = buffer2.get_voxel_metadata(pos);
 			ZN_TEST_ASSERT(meta2 != nullptr);
 			ZN_TEST_ASSERT(meta2->get_type() == meta.get_type());
 
@@ -220,7 +213,144 @@ void test_voxel_buffer_metadata_gd() {
 			const godot::VoxelMetadataVariant &meta2v =
 					static_cast<const godot::VoxelMetadataVariant &>(meta2->get_custom());
 			ZN_TEST_ASSERT(metav.data == meta2v.data);
+		});
+	}
+}
+
+void test_voxel_buffer_metadata_area() {
+	// Reference implementation of area operations, checked voxel by voxel
+	struct L {
+		static uint64_t get_tag(Vector3i pos) {
+			return 1000 + pos.x + pos.y * 100 + pos.z * 10000;
 		}
+		static bool is_tagged(Vector3i pos) {
+			return (pos.x + pos.y + pos.z) % 3 == 0;
+		}
+	};
+
+	VoxelBuffer src(VoxelBuffer::ALLOCATOR_DEFAULT);
+	src.create(Vector3i(8, 7, 9));
+	{
+		Vector3i pos;
+		for (pos.z = 0; pos.z < src.get_size().z; ++pos.z) {
+			for (pos.x = 0; pos.x < src.get_size().x; ++pos.x) {
+				for (pos.y = 0; pos.y < src.get_size().y; ++pos.y) {
+					if (L::is_tagged(pos)) {
+						src.get_or_create_voxel_metadata(pos)->set_u64(L::get_tag(pos));
+					}
+				}
+			}
+		}
+	}
+
+	// Area query
+	{
+		const Box3i box(Vector3i(1, 2, 3), Vector3i(4, 3, 5));
+		unsigned int count = 0;
+		src.for_each_voxel_metadata_in_area(box, [&count, box](Vector3i pos, const VoxelMetadata &meta) {
+			ZN_TEST_ASSERT(box.contains(pos));
+			ZN_TEST_ASSERT(meta.get_u64() == L::get_tag(pos));
+			++count;
+		});
+		unsigned int expected_count = 0;
+		box.for_each_cell([&expected_count](Vector3i pos) {
+			if (L::is_tagged(pos)) {
+				++expected_count;
+			}
+		});
+		ZN_TEST_ASSERT(count == expected_count);
+	}
+
+	// Copy with clipping and an offset, into a buffer that already has metadata
+	{
+		VoxelBuffer dst(VoxelBuffer::ALLOCATOR_DEFAULT);
+		dst.create(Vector3i(6, 6, 6));
+		const Vector3i untouched_pos(5, 5, 0);
+		dst.get_or_create_voxel_metadata(untouched_pos)->set_bool(true);
+		const Vector3i replaced_pos(0, 2, 2);
+		dst.get_or_create_voxel_metadata(replaced_pos)->set_bool(false);
+
+		const Box3i src_box(Vector3i(2, 1, 3), Vector3i(5, 5, 5));
+		const Vector3i dst_origin(-1, 0, 2);
+		dst.copy_voxel_metadata_in_area(src, src_box, dst_origin);
+
+		Vector3i dst_pos;
+		for (dst_pos.z = 0; dst_pos.z < dst.get_size().z; ++dst_pos.z) {
+			for (dst_pos.x = 0; dst_pos.x < dst.get_size().x; ++dst_pos.x) {
+				for (dst_pos.y = 0; dst_pos.y < dst.get_size().y; ++dst_pos.y) {
+					const Vector3i src_pos = dst_pos - dst_origin + src_box.position;
+					const VoxelMetadata *meta = dst.get_voxel_metadata(dst_pos);
+
+					if (src_box.contains(src_pos) && L::is_tagged(src_pos)) {
+						ZN_TEST_ASSERT(meta != nullptr);
+						ZN_TEST_ASSERT(meta->get_type() == VoxelMetadata::TYPE_U64);
+						ZN_TEST_ASSERT(meta->get_u64() == L::get_tag(src_pos));
+
+					} else if (dst_pos == untouched_pos || dst_pos == replaced_pos) {
+						ZN_TEST_ASSERT(meta != nullptr);
+						ZN_TEST_ASSERT(meta->get_type() == VoxelMetadata::TYPE_BOOL);
+
+					} else {
+						ZN_TEST_ASSERT(meta == nullptr);
+					}
+				}
+			}
+		}
+	}
+
+	// Clear area
+	{
+		VoxelBuffer dst(VoxelBuffer::ALLOCATOR_DEFAULT);
+		dst.create(src.get_size());
+		dst.copy_voxel_metadata(src);
+		ZN_TEST_ASSERT(dst.get_voxel_metadata().size() == src.get_voxel_metadata().size());
+
+		const Box3i box(Vector3i(3, 0, 2), Vector3i(2, 4, 6));
+		dst.clear_voxel_metadata_in_area(box);
+
+		src.for_each_voxel_metadata([&dst, box](Vector3i pos, const VoxelMetadata &src_meta) {
+			const VoxelMetadata *meta = dst.get_voxel_metadata(pos);
+			if (box.contains(pos)) {
+				ZN_TEST_ASSERT(meta == nullptr);
+			} else {
+				ZN_TEST_ASSERT(meta != nullptr);
+				ZN_TEST_ASSERT(meta->get_u64() == src_meta.get_u64());
+			}
+		});
+	}
+
+	// Inline types survive serialization, and keys inserted out of order get sorted
+	{
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(Vector3i(4, 4, 4));
+
+		VoxelMetadataMap map;
+		map.push_back_unsorted(VoxelBuffer::get_index(Vector3i(3, 2, 1), vb.get_size())).set_f64(-2.5);
+		map.push_back_unsorted(VoxelBuffer::get_index(Vector3i(0, 1, 0), vb.get_size())).set_bool(true);
+		map.push_back_unsorted(VoxelBuffer::get_index(Vector3i(3, 2, 1), vb.get_size())).set_f64(4.25);
+		vb.clear_and_set_voxel_metadata(std::move(map));
+
+		const VoxelMetadataMap &vb_map = vb.get_voxel_metadata();
+		ZN_TEST_ASSERT(vb_map.size() == 2);
+		ZN_TEST_ASSERT(vb_map.get_index(0) < vb_map.get_index(1));
+
+		BlockSerializer::SerializeResult sresult = BlockSerializer::serialize(vb);
+		ZN_TEST_ASSERT(sresult.success);
+		StdVector<uint8_t> bytes = sresult.data;
+
+		VoxelBuffer rvb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(bytes), rvb));
+
+		const VoxelMetadata *meta0 = rvb.get_voxel_metadata(Vector3i(3, 2, 1));
+		ZN_TEST_ASSERT(meta0 != nullptr);
+		ZN_TEST_ASSERT(meta0->get_type() == VoxelMetadata::TYPE_F64);
+		// The last value added with the same key wins
+		ZN_TEST_ASSERT(meta0->get_f64() == 4.25);
+
+		const VoxelMetadata *meta1 = rvb.get_voxel_metadata(Vector3i(0, 1, 0));
+		ZN_TEST_ASSERT(meta1 != nullptr);
+		ZN_TEST_ASSERT(meta1->get_type() == VoxelMetadata::TYPE_BOOL);
+		ZN_TEST_ASSERT(meta1->get_bool() == true);
 	}
 }
 
@@ -6,6 +6,7 @@ namespace zylann::voxel::tests {
 void test_voxel_buffer_create();
 void test_voxel_buffer_metadata();
 void test_voxel_buffer_metadata_gd();
+void test_voxel_buffer_metadata_area();
 void test_voxel_buffer_paste_masked();
 
 } // namespace zylann::voxel::tests
@@ -1,5 +1,6 @@
 #include "test_voxel_data_map.h"
 #include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_data.h"
 #include "../../storage/voxel_data_map.h"
 #include "../testing.h"
 
@@ -162,4 +163,54 @@ void test_voxel_data_map_copy() {
 	ZN_TEST_ASSERT(buffer.equals(buffer2));
 }
 
+void test_voxel_data_evict_blocks() {
+	static const int channel = VoxelBuffer::CHANNEL_TYPE;
+
+	VoxelData data;
+	const Vector3i block_size = Vector3iUtil::create(data.get_block_size());
+
+	auto make_block = [block_size]() {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+		buffer->create(block_size);
+		// Non-uniform, so the channel gets allocated
+		buffer->set_voxel(1, Vector3i(1, 2, 3), channel);
+		return VoxelDataBlock(buffer, 0);
+	};
+
+	const Vector3i generated_bpos(0, 0, 0);
+	const Vector3i edited_bpos(1, 0, 0);
+	const Vector3i recent_bpos(2, 0, 0);
+
+	ZN_TEST_ASSERT(data.try_set_block(generated_bpos, make_block()));
+	{
+		VoxelDataBlock block = make_block();
+		block.set_edited(true);
+		ZN_TEST_ASSERT(data.try_set_block(edited_bpos, block));
+	}
+
+	for (unsigned int i = 0; i < 10; ++i) {
+		VoxelDataBlock::advance_access_clock();
+	}
+	const uint32_t max_access_clock = VoxelDataBlock::get_access_clock() - 1;
+
+	// Accessed after the clock limit, so should not be evicted
+	ZN_TEST_ASSERT(data.try_set_block(recent_bpos, make_block()));
+
+	StdVector<VoxelData::EvictableBlock> evictable_blocks;
+	data.get_evictable_blocks(max_access_clock, evictable_blocks);
+	ZN_TEST_ASSERT(evictable_blocks.size() == 1);
+	ZN_TEST_ASSERT(evictable_blocks[0].position == generated_bpos);
+
+	unsigned int evicted_count = 0;
+	const size_t released_bytes = data.evict_blocks(to_span(evictable_blocks), evicted_count);
+	ZN_TEST_ASSERT(evicted_count == 1);
+	ZN_TEST_ASSERT(released_bytes > 0);
+
+	// The block remains known, but its voxels are gone and will be generated again when needed
+	ZN_TEST_ASSERT(data.has_block(generated_bpos, 0));
+	ZN_TEST_ASSERT(data.try_get_block_voxels(generated_bpos) == nullptr);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(edited_bpos) != nullptr);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(recent_bpos) != nullptr);
+}
+
 } // namespace zylann::voxel::tests
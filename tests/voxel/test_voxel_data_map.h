@@ -6,6 +6,7 @@ namespace zylann::voxel::tests {
 void test_voxel_data_map_paste_fill();
 void test_voxel_data_map_paste_mask();
 void test_voxel_data_map_copy();
+void test_voxel_data_evict_blocks();
 
 } // namespace zylann::voxel::tests
 
@@ -0,0 +1,92 @@
+#include "test_voxel_memory_pool.h"
+#include "../../storage/voxel_memory_pool.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+#include <cstring>
+
+namespace zylann::voxel::tests {
+
+void test_voxel_memory_pool_thread_caches() {
+	// Blocks allocated by one thread and recycled by another must end up reusable by both, and caches must not
+	// keep blocks around once trimmed.
+
+	struct Context {
+		VoxelMemoryPool *pool;
+		StdVector<uint8_t *> blocks;
+		size_t size;
+	};
+
+	struct L {
+		static void allocate(void *userdata) {
+			Context &ctx = *static_cast<Context *>(userdata);
+			for (unsigned int i = 0; i < ctx.blocks.size(); ++i) {
+				uint8_t *block = ctx.pool->allocate(ctx.size);
+				ZN_TEST_ASSERT(block != nullptr);
+				// Write into the whole block to make sure it is at least as big as requested
+				memset(block, i & 0xff, ctx.size);
+				ctx.blocks[i] = block;
+			}
+		}
+
+		static void recycle(void *userdata) {
+			Context &ctx = *static_cast<Context *>(userdata);
+			for (unsigned int i = 0; i < ctx.blocks.size(); ++i) {
+				uint8_t *block = ctx.blocks[i];
+				ZN_TEST_ASSERT(block[0] == (i & 0xff));
+				ZN_TEST_ASSERT(block[ctx.size - 1] == (i & 0xff));
+				ctx.pool->recycle(block, ctx.size);
+				ctx.blocks[i] = nullptr;
+			}
+		}
+
+		static void run_in_thread(Thread::Callback callback, Context &ctx) {
+			Thread thread;
+			thread.start(callback, &ctx);
+			thread.wait_to_finish();
+		}
+	};
+
+	VoxelMemoryPool pool;
+
+	Context ctx;
+	ctx.pool = &pool;
+	ctx.size = 8 * 1024;
+	ctx.blocks.resize(100, nullptr);
+
+	L::run_in_thread(L::allocate, ctx);
+	ZN_TEST_ASSERT(pool.debug_get_used_blocks() == ctx.blocks.size());
+
+	// Recycle from a different thread than the one that allocated
+	L::run_in_thread(L::recycle, ctx);
+	ZN_TEST_ASSERT(pool.debug_get_used_blocks() == 0);
+
+	{
+		// Threads exited, so their caches must have been given back
+		const VoxelMemoryPool::ThreadCacheStats stats = pool.debug_get_thread_cache_stats();
+		ZN_TEST_ASSERT(stats.thread_count == 0);
+		ZN_TEST_ASSERT(stats.cached_blocks == 0);
+		ZN_TEST_ASSERT(stats.counters.misses == ctx.blocks.size());
+		ZN_TEST_ASSERT(stats.counters.drains > 0);
+	}
+
+	// Blocks given back by the recycling thread must be reused instead of allocating new ones
+	L::run_in_thread(L::allocate, ctx);
+	{
+		const VoxelMemoryPool::ThreadCacheStats stats = pool.debug_get_thread_cache_stats();
+		ZN_TEST_ASSERT(stats.counters.misses == ctx.blocks.size());
+		ZN_TEST_ASSERT(stats.counters.refills > 0);
+		ZN_TEST_ASSERT(stats.counters.hits > 0);
+	}
+	L::run_in_thread(L::recycle, ctx);
+	ZN_TEST_ASSERT(pool.debug_get_used_blocks() == 0);
+
+	// Same with caches turned off
+	pool.set_thread_caches_enabled(false);
+	L::run_in_thread(L::allocate, ctx);
+	L::run_in_thread(L::recycle, ctx);
+	ZN_TEST_ASSERT(pool.debug_get_used_blocks() == 0);
+	ZN_TEST_ASSERT(pool.debug_get_thread_cache_stats().cached_blocks == 0);
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,10 @@
+#ifndef VOXEL_TEST_VOXEL_MEMORY_POOL_H
+#define VOXEL_TEST_VOXEL_MEMORY_POOL_H
+
+namespace zylann::voxel::tests {
+
+void test_voxel_memory_pool_thread_caches();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_VOXEL_MEMORY_POOL_H
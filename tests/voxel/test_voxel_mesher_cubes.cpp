@@ -1,6 +1,10 @@
 #include "test_voxel_mesher_cubes.h"
+#include "../../constants/voxel_string_names.h"
+#include "../../meshers/cubes/cubes_atlas_pool.h"
 #include "../../meshers/cubes/voxel_mesher_cubes.h"
 #include "../../storage/voxel_buffer.h"
+#include "../../util/godot/classes/array_mesh.h"
+#include "../../util/godot/classes/ref_counted.h"
 #include "../testing.h"
 
 namespace zylann::voxel::tests {
@@ -51,4 +55,85 @@ void test_voxel_mesher_cubes() {
 	ZN_TEST_ASSERT(surface1_vertices_count == 20);
 }
 
+void test_voxel_mesher_cubes_shared_atlas() {
+	{
+		CubesAtlasPool pool(4);
+
+		StdVector<CubesAtlasPool::Tile> tiles;
+		for (unsigned int i = 0; i < CubesAtlasPool::TILES_PER_LAYER + 1; ++i) {
+			CubesAtlasPool::Tile tile;
+			ZN_TEST_ASSERT(pool.allocate_tile(tile));
+			tiles.push_back(tile);
+		}
+		ZN_TEST_ASSERT(pool.get_used_tile_count() == CubesAtlasPool::TILES_PER_LAYER + 1);
+		// Tiles are allocated in order, and a new layer is added when the first one is full
+		ZN_TEST_ASSERT(tiles[0].layer == 0 && tiles[0].index == 0);
+		ZN_TEST_ASSERT(pool.get_tile_position(tiles[1]) == Vector2i(4, 0));
+		ZN_TEST_ASSERT(pool.get_tile_position(tiles[CubesAtlasPool::TILES_PER_LAYER_AXIS]) == Vector2i(0, 4));
+		ZN_TEST_ASSERT(tiles.back().layer == 1 && tiles.back().index == 0);
+
+		// Freed tiles get reused before growing
+		pool.free_tile(tiles[10]);
+		ZN_TEST_ASSERT(pool.get_used_tile_count() == CubesAtlasPool::TILES_PER_LAYER);
+		CubesAtlasPool::Tile tile;
+		ZN_TEST_ASSERT(pool.allocate_tile(tile));
+		ZN_TEST_ASSERT(tile.layer == tiles[10].layer && tile.index == tiles[10].index);
+
+		// The pool doesn't grow beyond its maximum number of layers
+		ZN_TEST_ASSERT(pool.get_max_layer_count() > 0 && pool.get_max_layer_count() <= CubesAtlasPool::MAX_LAYERS);
+		const unsigned int capacity = CubesAtlasPool::TILES_PER_LAYER * pool.get_max_layer_count();
+		while (pool.get_used_tile_count() < capacity) {
+			ZN_TEST_ASSERT(pool.allocate_tile(tile));
+		}
+		ZN_TEST_ASSERT(pool.allocate_tile(tile) == false);
+	}
+	{
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(8, 8, 8);
+		vb.set_channel_depth(VoxelBuffer::CHANNEL_COLOR, VoxelBuffer::DEPTH_8_BIT);
+		vb.set_voxel(1, Vector3i(3, 4, 4), VoxelBuffer::CHANNEL_COLOR);
+		vb.set_voxel(2, Vector3i(4, 4, 4), VoxelBuffer::CHANNEL_COLOR);
+
+		Ref<VoxelColorPalette> palette;
+		palette.instantiate();
+		palette->set_color8(1, Color8(0, 255, 0, 255));
+		palette->set_color8(2, Color8(255, 0, 0, 255));
+
+		Ref<VoxelMesherCubes> mesher;
+		mesher.instantiate();
+		mesher->set_color_mode(VoxelMesherCubes::COLOR_MESHER_PALETTE);
+		mesher->set_palette(palette);
+		mesher->set_shared_atlas_enabled(true);
+
+		VoxelMesher::Input input{ vb, nullptr, nullptr, Vector3i(), 0, false };
+		VoxelMesher::Output output;
+		mesher->build(output, input);
+
+		Ref<VoxelMesherCubesAtlasTile> atlas_tile;
+		ZN_TEST_ASSERT(zylann::godot::try_get_as(output.atlas_tile, atlas_tile));
+		ZN_TEST_ASSERT(output.atlas_image.is_null());
+		CubesAtlasPool *pool = atlas_tile->get_pool();
+		ZN_TEST_ASSERT(pool->get_used_tile_count() == 1);
+
+		const Array &arrays = output.surfaces[VoxelMesherCubes::MATERIAL_OPAQUE].arrays;
+		const PackedVector3Array vertices = arrays[Mesh::ARRAY_VERTEX];
+		const PackedVector2Array uv2s = arrays[Mesh::ARRAY_TEX_UV2];
+		ZN_TEST_ASSERT(vertices.size() > 0);
+		ZN_TEST_ASSERT(uv2s.size() == vertices.size());
+
+		// Meshes keep their tile
+		Ref<ArrayMesh> mesh;
+		mesh.instantiate();
+		mesher->attach_output_resources(**mesh, output);
+		ZN_TEST_ASSERT(mesh->get_meta(VoxelStringNames::get_singleton().voxel_cubes_atlas_tile) == Variant(atlas_tile));
+
+		// The tile goes back to the pool once nothing references it
+		atlas_tile.unref();
+		output.atlas_tile.unref();
+		ZN_TEST_ASSERT(pool->get_used_tile_count() == 1);
+		mesh.unref();
+		ZN_TEST_ASSERT(pool->get_used_tile_count() == 0);
+	}
+}
+
 } // namespace zylann::voxel::tests
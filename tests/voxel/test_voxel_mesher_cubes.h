@@ -4,6 +4,7 @@
 namespace zylann::voxel::tests {
 
 void test_voxel_mesher_cubes();
+void test_voxel_mesher_cubes_shared_atlas();
 
 } // namespace zylann::voxel::tests
 
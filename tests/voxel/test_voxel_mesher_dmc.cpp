@@ -0,0 +1,91 @@
+#include "test_voxel_mesher_dmc.h"
+#include "../../meshers/dmc/voxel_mesher_dmc.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../util/godot/classes/mesh.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+Array build_dmc_surface(
+		const VoxelBuffer &voxels,
+		VoxelMesherDMC::SimplifyMode simplify_mode,
+		VoxelMesherDMC::SeamMode seam_mode,
+		bool parallel_octants
+) {
+	Ref<VoxelMesherDMC> mesher;
+	mesher.instantiate();
+	mesher->set_simplify_mode(simplify_mode);
+	mesher->set_seam_mode(seam_mode);
+	mesher->set_parallel_octants_enabled(parallel_octants);
+
+	VoxelMesher::Input input{ voxels, nullptr, nullptr, Vector3i(), 0, false };
+	VoxelMesher::Output output;
+	mesher->build(output, input);
+
+	if (output.surfaces.size() == 0) {
+		return Array();
+	}
+	return output.surfaces[0].arrays;
+}
+
+bool is_same_surface(const Array &a, const Array &b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	if (a.size() == 0) {
+		return true;
+	}
+	const PackedVector3Array a_positions = a[Mesh::ARRAY_VERTEX];
+	const PackedVector3Array b_positions = b[Mesh::ARRAY_VERTEX];
+	const PackedVector3Array a_normals = a[Mesh::ARRAY_NORMAL];
+	const PackedVector3Array b_normals = b[Mesh::ARRAY_NORMAL];
+	const PackedInt32Array a_indices = a[Mesh::ARRAY_INDEX];
+	const PackedInt32Array b_indices = b[Mesh::ARRAY_INDEX];
+	return a_positions == b_positions && a_normals == b_normals && a_indices == b_indices;
+}
+
+} // namespace
+
+void test_voxel_mesher_dmc_parallel_octants() {
+	// Large enough to be split in octants
+	const int block_size = 32;
+	const int padding = VoxelMesherDMC::PADDING;
+
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	voxels.create(Vector3iUtil::create(block_size + 2 * padding));
+
+	// Bumpy sphere crossing every octant
+	const Vector3f center(18.f, 17.5f, 18.f);
+	for (int z = 0; z < voxels.get_size().z; ++z) {
+		for (int x = 0; x < voxels.get_size().x; ++x) {
+			for (int y = 0; y < voxels.get_size().y; ++y) {
+				const Vector3f pos(x, y, z);
+				const float sd =
+						math::length(pos - center) - 11.f + 1.5f * Math::sin(0.7f * pos.x) * Math::cos(0.5f * pos.z);
+				voxels.set_voxel_f(sd, Vector3i(x, y, z), VoxelBuffer::CHANNEL_SDF);
+			}
+		}
+	}
+
+	const VoxelMesherDMC::SimplifyMode simplify_modes[] = { //
+		VoxelMesherDMC::SIMPLIFY_OCTREE_BOTTOM_UP, //
+		VoxelMesherDMC::SIMPLIFY_OCTREE_TOP_DOWN, //
+		VoxelMesherDMC::SIMPLIFY_NONE
+	};
+
+	for (const VoxelMesherDMC::SimplifyMode simplify_mode : simplify_modes) {
+		for (const VoxelMesherDMC::SeamMode seam_mode :
+			 { VoxelMesherDMC::SEAM_NONE, VoxelMesherDMC::SEAM_MARCHING_SQUARE_SKIRTS }) {
+			const Array expected = build_dmc_surface(voxels, simplify_mode, seam_mode, false);
+			ZN_TEST_ASSERT(expected.size() > 0);
+
+			// Octants are processed separately, but the result must be the same
+			const Array parallel = build_dmc_surface(voxels, simplify_mode, seam_mode, true);
+			ZN_TEST_ASSERT(is_same_surface(expected, parallel));
+		}
+	}
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,10 @@
+#ifndef VOXEL_TESTS_VOXEL_MESHER_DMC_H
+#define VOXEL_TESTS_VOXEL_MESHER_DMC_H
+
+namespace zylann::voxel::tests {
+
+void test_voxel_mesher_dmc_parallel_octants();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TESTS_VOXEL_MESHER_DMC_H
@@ -53,6 +53,13 @@ void AStarGrid3D::start(Vector3i from_position, Vector3i target_position) {
 		return;
 	}
 
+	_points_chunk_grid_size = math::ceildiv(_region.size, POINTS_CHUNK_SIZE);
+	const unsigned int chunk_count = Vector3iUtil::get_volume(_points_chunk_grid_size);
+	if (_points_chunk_slots.size() != chunk_count) {
+		_points_chunk_slots.resize(chunk_count, NO_INDEX);
+	}
+	_points_chunk_slot_count = 0;
+
 	Point src_node;
 	src_node.position = from_position;
 	src_node.gscore = 0.f;
@@ -66,7 +73,7 @@ void AStarGrid3D::start(Vector3i from_position, Vector3i target_position) {
 
 	_open_list.push(point_index);
 
-	_points_map.insert({ from_position, point_index });
+	set_point_index(from_position, point_index);
 
 	_is_running = true;
 }
@@ -104,13 +111,9 @@ void AStarGrid3D::step() {
 	get_neighbor_positions(current_point.position, _neighbor_positions);
 
 	for (const Vector3i npos : _neighbor_positions) {
-		uint32_t neighbor_point_index;
-		auto it = _points_map.find(npos);
+		uint32_t neighbor_point_index = get_point_index(npos);
 
-		if (it != _points_map.end()) {
-			neighbor_point_index = it->second;
-
-		} else {
+		if (neighbor_point_index == NO_INDEX) {
 			neighbor_point_index = _points_pool.size();
 
 			Point p;
@@ -124,8 +127,7 @@ void AStarGrid3D::step() {
 			p.in_open_set = false;
 
 			_points_pool.push_back(p);
-			// ZN_PROFILE_SCOPE_NAMED("Insert to points map");
-			_points_map.insert({ npos, neighbor_point_index });
+			set_point_index(npos, neighbor_point_index);
 		}
 
 		const Vector3i neighbor_dir = npos - current_point.position;
@@ -299,6 +301,47 @@ void AStarGrid3D::reconstruct_path(uint32_t end_point_index) {
 	std::reverse(_path.begin(), _path.end());
 }
 
+uint32_t AStarGrid3D::get_point_index(Vector3i pos) const {
+	const Vector3i rpos = pos - _region.position;
+	const unsigned int chunk_index =
+			Vector3iUtil::get_zxy_index(rpos >> POINTS_CHUNK_SIZE_PO2, _points_chunk_grid_size);
+	const uint32_t slot = _points_chunk_slots[chunk_index];
+	if (slot >= _points_chunk_slot_count || _points_chunk_owners[slot] != chunk_index) {
+		return NO_INDEX;
+	}
+	const uint32_t point_index = _points_chunks
+			[slot * POINTS_CHUNK_VOLUME +
+			 Vector3iUtil::get_zxy_index(rpos & POINTS_CHUNK_SIZE_MASK, Vector3iUtil::create(POINTS_CHUNK_SIZE))];
+	// The chunk may have been used by a previous search
+	if (point_index < _points_pool.size() && _points_pool[point_index].position == pos) {
+		return point_index;
+	}
+	return NO_INDEX;
+}
+
+void AStarGrid3D::set_point_index(Vector3i pos, uint32_t point_index) {
+	const Vector3i rpos = pos - _region.position;
+	const unsigned int chunk_index =
+			Vector3iUtil::get_zxy_index(rpos >> POINTS_CHUNK_SIZE_PO2, _points_chunk_grid_size);
+	uint32_t slot = _points_chunk_slots[chunk_index];
+
+	if (slot >= _points_chunk_slot_count || _points_chunk_owners[slot] != chunk_index) {
+		slot = _points_chunk_slot_count;
+		++_points_chunk_slot_count;
+		if (_points_chunk_owners.size() < _points_chunk_slot_count) {
+			_points_chunk_owners.resize(_points_chunk_slot_count);
+			_points_chunks.resize(_points_chunk_slot_count * POINTS_CHUNK_VOLUME);
+		}
+		_points_chunk_owners[slot] = chunk_index;
+		_points_chunk_slots[chunk_index] = slot;
+	}
+
+	_points_chunks
+			[slot * POINTS_CHUNK_VOLUME +
+			 Vector3iUtil::get_zxy_index(rpos & POINTS_CHUNK_SIZE_MASK, Vector3iUtil::create(POINTS_CHUNK_SIZE))] =
+					point_index;
+}
+
 bool AStarGrid3D::is_running() const {
 	return _is_running;
 }
@@ -309,7 +352,7 @@ Span<const Vector3i> AStarGrid3D::get_path() const {
 
 void AStarGrid3D::clear() {
 	_open_list.clear();
-	_points_map.clear();
+	_points_chunk_slot_count = 0;
 	_points_pool.clear();
 	_path.clear();
 	_neighbor_positions.clear();
@@ -323,9 +366,9 @@ float AStarGrid3D::evaluate_heuristic(Vector3i pos, Vector3i target_pos) const {
 }
 
 void AStarGrid3D::debug_get_visited_points(StdVector<Vector3i> &out_positions) const {
-	out_positions.reserve(out_positions.size() + _points_map.size());
-	for (auto it = _points_map.begin(); it != _points_map.end(); ++it) {
-		out_positions.push_back(it->first);
+	out_positions.reserve(out_positions.size() + _points_pool.size());
+	for (const Point &point : _points_pool) {
+		out_positions.push_back(point.position);
 	}
 }
 
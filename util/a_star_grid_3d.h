@@ -1,13 +1,11 @@
 #ifndef ZN_ASTAR_GRID_3D_H
 #define ZN_ASTAR_GRID_3D_H
 
-#include "../util/containers/std_unordered_map.h"
 #include "../util/containers/std_vector.h"
 #include "../util/godot/core/sort_array.h"
 #include "../util/math/box3i.h"
 #include "../util/math/vector3f.h"
 #include <limits>
-#include <unordered_map>
 
 namespace zylann {
 
@@ -51,12 +49,16 @@ protected:
 private:
 	float evaluate_heuristic(Vector3i pos, Vector3i target_pos) const;
 	void reconstruct_path(uint32_t end_point_index);
+	uint32_t get_point_index(Vector3i pos) const;
+	void set_point_index(Vector3i pos, uint32_t point_index);
 	void get_neighbor_positions(Vector3i pos, StdVector<Vector3i> &out_positions);
 	bool is_ground_close_enough(Vector3i pos);
 	bool fits(Vector3f pos, Vector3f agent_extents);
 
+	static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
 	struct Point {
-		static const uint32_t NO_CAME_FROM = std::numeric_limits<uint32_t>::max();
+		static const uint32_t NO_CAME_FROM = NO_INDEX;
 
 		Vector3i position;
 
@@ -155,10 +157,22 @@ private:
 	StdVector<Point> _points_pool;
 	PriorityQueue _open_list;
 
-	// Only visited points will be in this map. Should use less memory than if we made a big 3D grid of points, because
-	// in practice we may only visit a fraction of them.
-	// Eventually we could try a chunked grid if that's faster?
-	StdUnorderedMap<Vector3i, uint32_t> _points_map;
+	// Maps cells of the region to indices of visited points, in chunks of the grid allocated only where points are
+	// visited. Entries are checked against the positions of points and owners of chunks, so they don't need to be
+	// cleared between searches.
+	static const int POINTS_CHUNK_SIZE_PO2 = 3;
+	static const int POINTS_CHUNK_SIZE = 1 << POINTS_CHUNK_SIZE_PO2;
+	static const int POINTS_CHUNK_SIZE_MASK = POINTS_CHUNK_SIZE - 1;
+	static const int POINTS_CHUNK_VOLUME = POINTS_CHUNK_SIZE * POINTS_CHUNK_SIZE * POINTS_CHUNK_SIZE;
+
+	// Slot of each chunk covering the region, in ZXY order
+	StdVector<uint32_t> _points_chunk_slots;
+	Vector3i _points_chunk_grid_size;
+	// Chunk owning each slot
+	StdVector<uint32_t> _points_chunk_owners;
+	unsigned int _points_chunk_slot_count = 0;
+	// `POINTS_CHUNK_VOLUME` point indices per slot
+	StdVector<uint32_t> _points_chunks;
 
 	StdVector<Vector3i> _path;
 	StdVector<Vector3i> _neighbor_positions;
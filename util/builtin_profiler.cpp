@@ -0,0 +1,305 @@
+#include "builtin_profiler.h"
+#include "containers/std_vector.h"
+#include "memory/memory.h"
+#include "string/format.h"
+#include "string/std_string.h"
+#include "string/std_stringstream.h"
+#include "thread/mutex.h"
+#include "thread/spin_lock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+namespace zylann {
+namespace profiler {
+
+namespace internal {
+std::atomic_bool g_enabled = { false };
+}
+
+namespace {
+
+enum EventType : uint8_t { //
+	EVENT_SCOPE,
+	EVENT_COUNTER,
+	EVENT_INSTANT
+};
+
+std::atomic_uint g_events_per_thread = { 65536 };
+
+struct Event {
+	const char *name;
+	uint64_t time_usec;
+	union {
+		uint64_t duration_usec;
+		double value;
+	};
+	EventType type;
+};
+
+struct ThreadBuffer {
+	// Only locked by the owning thread when recording, and when exporting or clearing. So in practice it is almost
+	// never contended.
+	SpinLock spin_lock;
+	StdVector<Event> events;
+	// Index where the next event will be written, wrapping around when the buffer is full
+	unsigned int next_index = 0;
+	bool full = false;
+	unsigned int thread_index;
+	StdString name;
+
+	void add(const Event &event) {
+		// Read every time, so buffers of threads that already recorded events follow changes of capacity
+		const unsigned int capacity = g_events_per_thread.load(std::memory_order_relaxed);
+		spin_lock.lock();
+		if (events.size() != capacity) {
+			// Previous events are dropped, they would be out of order otherwise
+			events.clear();
+			events.resize(capacity);
+			next_index = 0;
+			full = false;
+		}
+		events[next_index] = event;
+		++next_index;
+		if (next_index == events.size()) {
+			next_index = 0;
+			full = true;
+		}
+		spin_lock.unlock();
+	}
+
+	void clear() {
+		spin_lock.lock();
+		next_index = 0;
+		full = false;
+		spin_lock.unlock();
+	}
+
+	template <typename F>
+	void for_each_event(F f) {
+		spin_lock.lock();
+		if (full) {
+			for (unsigned int i = next_index; i < events.size(); ++i) {
+				f(events[i]);
+			}
+		}
+		for (unsigned int i = 0; i < next_index; ++i) {
+			f(events[i]);
+		}
+		spin_lock.unlock();
+	}
+};
+
+struct Registry {
+	Mutex mutex;
+	StdVector<UniquePtr<ThreadBuffer>> buffers;
+	// Buffers of threads that exited. Their events can still be exported until another thread reuses them, so
+	// short-lived threads don't accumulate buffers.
+	StdVector<ThreadBuffer *> free_buffers;
+};
+
+Registry g_registry;
+
+// Reference for timestamps. Chrome trace timestamps don't have to start from zero, but small numbers are easier to
+// read.
+const std::chrono::steady_clock::time_point g_start_time = std::chrono::steady_clock::now();
+
+thread_local ThreadBuffer *tls_buffer = nullptr;
+// Set once the thread gave its buffer back. Events recorded after that, by destructors of other thread-local
+// objects, are dropped.
+thread_local bool tls_exited = false;
+
+// Gives the buffer of a thread back to the registry when the thread exits
+struct ThreadBufferReleaser {
+	ThreadBuffer *buffer = nullptr;
+
+	~ThreadBufferReleaser() {
+		tls_exited = true;
+		tls_buffer = nullptr;
+		if (buffer == nullptr) {
+			return;
+		}
+		MutexLock mlock(g_registry.mutex);
+		g_registry.free_buffers.push_back(buffer);
+	}
+};
+
+thread_local ThreadBufferReleaser tls_buffer_releaser;
+
+ThreadBuffer *get_tls_buffer() {
+	if (tls_buffer == nullptr) {
+		if (tls_exited) {
+			return nullptr;
+		}
+		MutexLock mlock(g_registry.mutex);
+
+		if (g_registry.free_buffers.size() > 0) {
+			ThreadBuffer *buffer = g_registry.free_buffers.back();
+			g_registry.free_buffers.pop_back();
+			// Events of the previous thread are dropped
+			buffer->spin_lock.lock();
+			buffer->next_index = 0;
+			buffer->full = false;
+			buffer->name.clear();
+			buffer->spin_lock.unlock();
+			tls_buffer = buffer;
+
+		} else {
+			UniquePtr<ThreadBuffer> buffer = make_unique_instance<ThreadBuffer>();
+			buffer->thread_index = g_registry.buffers.size();
+			tls_buffer = buffer.get();
+			g_registry.buffers.push_back(std::move(buffer));
+		}
+
+		// Accessing the releaser also makes sure its destructor runs when the thread exits
+		tls_buffer_releaser.buffer = tls_buffer;
+	}
+	return tls_buffer;
+}
+
+void write_json_string(StdStringStream &ss, const char *s) {
+	ss << '"';
+	for (; *s != '\0'; ++s) {
+		const char c = *s;
+		if (c == '"' || c == '\\') {
+			ss << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			// Control characters are not expected in names
+			ss << ' ';
+		} else {
+			ss << c;
+		}
+	}
+	ss << '"';
+}
+
+} // namespace
+
+void set_enabled(bool enabled) {
+	internal::g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void set_events_per_thread(unsigned int count) {
+	g_events_per_thread = std::max(count, 1u);
+}
+
+unsigned int get_events_per_thread() {
+	return g_events_per_thread;
+}
+
+void clear() {
+	MutexLock mlock(g_registry.mutex);
+	for (UniquePtr<ThreadBuffer> &buffer : g_registry.buffers) {
+		buffer->clear();
+	}
+}
+
+uint64_t get_time_usec() {
+	const std::chrono::steady_clock::duration d = std::chrono::steady_clock::now() - g_start_time;
+	return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void add_scope(const char *name, uint64_t begin_usec, uint64_t end_usec) {
+	Event event;
+	event.name = name;
+	event.time_usec = begin_usec;
+	event.duration_usec = end_usec - begin_usec;
+	event.type = EVENT_SCOPE;
+	ThreadBuffer *buffer = get_tls_buffer();
+	if (buffer != nullptr) {
+		buffer->add(event);
+	}
+}
+
+void add_counter(const char *name, double value) {
+	if (!is_enabled()) {
+		return;
+	}
+	Event event;
+	event.name = name;
+	event.time_usec = get_time_usec();
+	event.value = value;
+	event.type = EVENT_COUNTER;
+	ThreadBuffer *buffer = get_tls_buffer();
+	if (buffer != nullptr) {
+		buffer->add(event);
+	}
+}
+
+void add_instant(const char *name) {
+	if (!is_enabled()) {
+		return;
+	}
+	Event event;
+	event.name = name;
+	event.time_usec = get_time_usec();
+	event.duration_usec = 0;
+	event.type = EVENT_INSTANT;
+	ThreadBuffer *buffer = get_tls_buffer();
+	if (buffer != nullptr) {
+		buffer->add(event);
+	}
+}
+
+void set_thread_name(const char *name) {
+	ThreadBuffer *buffer = get_tls_buffer();
+	if (buffer == nullptr) {
+		return;
+	}
+	buffer->spin_lock.lock();
+	buffer->name = name;
+	buffer->spin_lock.unlock();
+}
+
+void get_chrome_trace(FwdMutableStdString out) {
+	// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nzsKchXAKnI
+	StdStringStream ss;
+	ss << "{\"traceEvents\":[";
+	bool first = true;
+
+	MutexLock mlock(g_registry.mutex);
+
+	for (UniquePtr<ThreadBuffer> &buffer_ptr : g_registry.buffers) {
+		ThreadBuffer &buffer = *buffer_ptr;
+		const unsigned int tid = buffer.thread_index;
+
+		buffer.spin_lock.lock();
+		const StdString thread_name = buffer.name.empty() ? format("Thread {}", tid) : buffer.name;
+		buffer.spin_lock.unlock();
+
+		if (!first) {
+			ss << ',';
+		}
+		first = false;
+		ss << "\n{\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+		write_json_string(ss, thread_name.c_str());
+		ss << "}}";
+
+		buffer.for_each_event([&ss, tid](const Event &event) {
+			ss << ",\n{\"name\":";
+			write_json_string(ss, event.name);
+			ss << ",\"pid\":0,\"tid\":" << tid << ",\"ts\":" << event.time_usec;
+			switch (event.type) {
+				case EVENT_SCOPE:
+					ss << ",\"ph\":\"X\",\"dur\":" << event.duration_usec << '}';
+					break;
+				case EVENT_COUNTER:
+					// JSON doesn't support NaN or infinity
+					ss << ",\"ph\":\"C\",\"args\":{\"value\":" << (std::isfinite(event.value) ? event.value : 0.0)
+					   << "}}";
+					break;
+				case EVENT_INSTANT:
+					ss << ",\"ph\":\"i\",\"s\":\"g\"}";
+					break;
+			}
+		});
+	}
+
+	ss << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	out.s += ss.str();
+}
+
+} // namespace profiler
+} // namespace zylann
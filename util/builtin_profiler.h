@@ -0,0 +1,74 @@
+#ifndef ZN_BUILTIN_PROFILER_H
+#define ZN_BUILTIN_PROFILER_H
+
+#include "string/fwd_std_string.h"
+#include <atomic>
+#include <cstdint>
+
+// Lightweight profiler recording a timeline of scopes, available without external tools. It is used by `ZN_PROFILE_*`
+// macros when Tracy is not enabled, and does nothing until it is enabled at runtime.
+// Each thread records events into its own ring buffer, so only the last events are kept, and recording doesn't
+// require synchronization between threads.
+// The timeline can be exported in Chrome trace format, which can be opened in https://ui.perfetto.dev or
+// chrome://tracing.
+
+namespace zylann {
+namespace profiler {
+
+namespace internal {
+extern std::atomic_bool g_enabled;
+}
+
+inline bool is_enabled() {
+	return internal::g_enabled.load(std::memory_order_relaxed);
+}
+
+void set_enabled(bool enabled);
+
+// How many events are kept per thread. Buffers of every thread are resized the next time they record an event, which
+// drops the events they had. Memory is allocated the first time a thread records an event, and reused by other
+// threads once it exits.
+void set_events_per_thread(unsigned int count);
+unsigned int get_events_per_thread();
+
+// Removes all recorded events.
+void clear();
+
+// Name must be a string with static lifetime (usually a literal).
+void add_scope(const char *name, uint64_t begin_usec, uint64_t end_usec);
+void add_counter(const char *name, double value);
+void add_instant(const char *name);
+// Name will be copied.
+void set_thread_name(const char *name);
+
+// Time in microseconds, in the same reference as recorded events.
+uint64_t get_time_usec();
+
+// Gets all recorded events as JSON in Chrome trace format.
+void get_chrome_trace(FwdMutableStdString out);
+
+struct Scope {
+	const char *name;
+	uint64_t begin_usec;
+
+	inline Scope(const char *p_name) {
+		if (is_enabled()) {
+			name = p_name;
+			begin_usec = get_time_usec();
+		} else {
+			name = nullptr;
+		}
+	}
+
+	inline ~Scope() {
+		// Don't check if the profiler is still enabled, so disabling it doesn't drop scopes that were in progress
+		if (name != nullptr) {
+			add_scope(name, begin_usec, get_time_usec());
+		}
+	}
+};
+
+} // namespace profiler
+} // namespace zylann
+
+#endif // ZN_BUILTIN_PROFILER_H
@@ -0,0 +1,18 @@
+#ifndef ZN_GODOT_TEXTURE_ARRAY_H
+#define ZN_GODOT_TEXTURE_ARRAY_H
+
+#if defined(ZN_GODOT)
+#include <core/version.h>
+
+#if VERSION_MAJOR == 4 && VERSION_MINOR <= 1
+#include <scene/resources/texture.h>
+#else
+#include <scene/resources/image_texture.h>
+#endif
+
+#elif defined(ZN_GODOT_EXTENSION)
+#include <godot_cpp/classes/texture2d_array.hpp>
+using namespace godot;
+#endif
+
+#endif // ZN_GODOT_TEXTURE_ARRAY_H
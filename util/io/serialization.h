@@ -92,6 +92,15 @@ struct MemoryWriterTemplate {
 		store_32(m.i);
 	}
 
+	inline void store_double(double v) {
+		union M {
+			uint64_t i;
+			double f;
+		} m;
+		m.f = v;
+		store_64(m.i);
+	}
+
 	inline void store_buffer(Span<const uint8_t> p_data) {
 		const size_t begin = data.size();
 		data.resize(data.size() + p_data.size());
@@ -211,6 +220,15 @@ struct MemoryReader {
 		return m.f;
 	}
 
+	inline double get_double() {
+		union M {
+			uint64_t i;
+			double f;
+		} m;
+		m.i = get_64();
+		return m.f;
+	}
+
 	inline size_t get_buffer(Span<uint8_t> p_dst) {
 #ifdef DEBUG_ENABLED
 		ZN_ASSERT(pos <= data.size());
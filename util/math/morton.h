@@ -0,0 +1,46 @@
+#ifndef ZN_MATH_MORTON_H
+#define ZN_MATH_MORTON_H
+
+#include <cstdint>
+
+// Morton order (Z-order curve) interleaves the bits of coordinates, so positions close to each other in space tend to
+// be close to each other in the resulting sequence.
+
+namespace zylann::math {
+
+// Spreads the first 21 bits of `x` so there are two zero bits between each of them
+inline uint64_t morton_spread_3(uint32_t x) {
+	uint64_t v = x & 0x1fffff;
+	v = (v | (v << 32)) & 0x1f00000000ffffull;
+	v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+	v = (v | (v << 8)) & 0x100f00f00f00f00full;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+	v = (v | (v << 2)) & 0x1249249249249249ull;
+	return v;
+}
+
+// Inverse of `morton_spread_3`
+inline uint32_t morton_compact_3(uint64_t v) {
+	v &= 0x1249249249249249ull;
+	v = (v | (v >> 2)) & 0x10c30c30c30c30c3ull;
+	v = (v | (v >> 4)) & 0x100f00f00f00f00full;
+	v = (v | (v >> 8)) & 0x1f0000ff0000ffull;
+	v = (v | (v >> 16)) & 0x1f00000000ffffull;
+	v = (v | (v >> 32)) & 0x1fffff;
+	return static_cast<uint32_t>(v);
+}
+
+// Coordinates must fit in 21 bits.
+inline uint64_t morton_encode_3d(uint32_t x, uint32_t y, uint32_t z) {
+	return morton_spread_3(x) | (morton_spread_3(y) << 1) | (morton_spread_3(z) << 2);
+}
+
+inline void morton_decode_3d(uint64_t code, uint32_t &out_x, uint32_t &out_y, uint32_t &out_z) {
+	out_x = morton_compact_3(code);
+	out_y = morton_compact_3(code >> 1);
+	out_z = morton_compact_3(code >> 2);
+}
+
+} // namespace zylann::math
+
+#endif // ZN_MATH_MORTON_H
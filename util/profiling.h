@@ -15,6 +15,33 @@
 #define ZN_PROFILE_MESSAGE(message) TracyMessageL(message)
 #define ZN_PROFILE_MESSAGE_DYN(message, size) TracyMessage(message, size)
 
+#elif !defined(ZN_BUILTIN_PROFILER_DISABLED)
+
+// Built-in profiler. Scopes cost a check of an atomic boolean when it is not enabled at runtime.
+// Can be compiled out by defining ZN_BUILTIN_PROFILER_DISABLED.
+
+#include "builtin_profiler.h"
+#include "macros.h"
+
+// `ZN_PROFILER_ENABLED` is not defined here, code guarded by it is specific to Tracy builds. The built-in profiler is
+// compiled in release builds, so code only needed for it must check `ZN_BUILTIN_PROFILER_ENABLED`.
+#define ZN_BUILTIN_PROFILER_ENABLED
+
+#define ZN_PROFILE_SCOPE() zylann::profiler::Scope ZN_CONCAT(zn_profile_scope_, __LINE__)(__FUNCTION__)
+#define ZN_PROFILE_SCOPE_NAMED(name) zylann::profiler::Scope ZN_CONCAT(zn_profile_scope_, __LINE__)(name)
+#define ZN_PROFILE_MARK_FRAME() zylann::profiler::add_instant("Frame")
+#define ZN_PROFILE_SET_THREAD_NAME(name) zylann::profiler::set_thread_name(name)
+// Not evaluating the number when the profiler is disabled, as it can be expensive to obtain
+#define ZN_PROFILE_PLOT(name, number)                                                                                  \
+	do {                                                                                                               \
+		if (zylann::profiler::is_enabled()) {                                                                          \
+			zylann::profiler::add_counter(name, static_cast<double>(number));                                          \
+		}                                                                                                              \
+	} while (false)
+#define ZN_PROFILE_MESSAGE(message) zylann::profiler::add_instant(message)
+// Messages with dynamic lifetime are not recorded by the built-in profiler
+#define ZN_PROFILE_MESSAGE_DYN(message, size)
+
 #else
 
 #define ZN_PROFILE_SCOPE()
@@ -0,0 +1,117 @@
+#include "parallel_for.h"
+#include "../containers/std_vector.h"
+#include "../errors.h"
+#include "../math/funcs.h"
+#include "../memory/memory.h"
+#include "../profiling.h"
+#include "threaded_task.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace zylann {
+
+namespace {
+
+struct ParallelForState {
+	ParallelForFunc func = nullptr;
+	void *func_data = nullptr;
+	unsigned int count = 0;
+
+	std::atomic_uint32_t next_index = { 0 };
+
+	// Indices not processed yet
+	unsigned int remaining_count = 0;
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	void run() {
+		unsigned int processed_count = 0;
+
+		while (true) {
+			const uint32_t index = next_index++;
+			if (index >= count) {
+				break;
+			}
+			func(func_data, index);
+			++processed_count;
+		}
+
+		if (processed_count == 0) {
+			// Nothing was claimed. The caller may have returned already, so `func` must not be used.
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		remaining_count -= processed_count;
+		if (remaining_count == 0) {
+			condition.notify_all();
+		}
+	}
+
+	void wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (remaining_count > 0) {
+			condition.wait(lock);
+		}
+	}
+};
+
+class ParallelForTask : public IThreadedTask {
+public:
+	ParallelForTask(std::shared_ptr<ParallelForState> state) : _state(state) {}
+
+	void run(ThreadedTaskContext &ctx) override {
+		ZN_PROFILE_SCOPE();
+		_state->run();
+	}
+
+	const char *get_debug_name() const override {
+		return "ParallelFor";
+	}
+
+private:
+	std::shared_ptr<ParallelForState> _state;
+};
+
+} // namespace
+
+void parallel_for(
+		unsigned int count,
+		unsigned int min_count_per_task,
+		unsigned int max_helper_tasks,
+		ScheduleParallelTasksCallback schedule_tasks,
+		ParallelForFunc func,
+		void *func_data
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(func != nullptr);
+	ZN_ASSERT_RETURN(schedule_tasks != nullptr);
+
+	if (count == 0) {
+		return;
+	}
+
+	// Shared because helper tasks may start after this function returned
+	std::shared_ptr<ParallelForState> state = make_shared_instance<ParallelForState>();
+	state->func = func;
+	state->func_data = func_data;
+	state->count = count;
+	state->remaining_count = count;
+
+	const unsigned int task_count = math::min(max_helper_tasks, (count - 1) / math::max(min_count_per_task, 1u));
+	if (task_count > 0) {
+		StdVector<IThreadedTask *> tasks;
+		tasks.reserve(task_count);
+		for (unsigned int i = 0; i < task_count; ++i) {
+			tasks.push_back(ZN_NEW(ParallelForTask(state)));
+		}
+		schedule_tasks(to_span(tasks));
+	}
+
+	state->run();
+	state->wait();
+}
+
+} // namespace zylann
@@ -0,0 +1,50 @@
+#ifndef ZN_PARALLEL_FOR_H
+#define ZN_PARALLEL_FOR_H
+
+#include "../containers/span.h"
+
+namespace zylann {
+
+class IThreadedTask;
+
+typedef void (*ScheduleParallelTasksCallback)(Span<IThreadedTask *> tasks);
+typedef void (*ParallelForFunc)(void *data, unsigned int index);
+
+// Calls `func(data, i)` for every index in [0, count). Up to `max_helper_tasks` threaded tasks are given to
+// `schedule_tasks`, with no more than one per `min_count_per_task` indices, and the calling thread takes part in the
+// work too. Indices are claimed one at a time, so calls can happen on several threads at once, in any order.
+// Returns once all calls are complete. If helpers are still working on their last index at that point, the calling
+// thread sleeps until they are done. Helper tasks starting after that have nothing left to do.
+void parallel_for(
+		unsigned int count,
+		unsigned int min_count_per_task,
+		unsigned int max_helper_tasks,
+		ScheduleParallelTasksCallback schedule_tasks,
+		ParallelForFunc func,
+		void *func_data
+);
+
+// Same as above, calling `f(i)`
+template <typename F>
+inline void parallel_for(
+		unsigned int count,
+		unsigned int min_count_per_task,
+		unsigned int max_helper_tasks,
+		ScheduleParallelTasksCallback schedule_tasks,
+		F f
+) {
+	parallel_for(
+			count,
+			min_count_per_task,
+			max_helper_tasks,
+			schedule_tasks,
+			[](void *data, unsigned int index) { //
+				(*static_cast<F *>(data))(index);
+			},
+			&f
+	);
+}
+
+} // namespace zylann
+
+#endif // ZN_PARALLEL_FOR_H
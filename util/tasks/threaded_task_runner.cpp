@@ -158,7 +158,7 @@ void ThreadedTaskRunner::thread_func_static(void *p_data) {
 	if (!data.name.empty()) {
 		Thread::set_name(data.name.c_str());
 
-#ifdef ZN_PROFILER_ENABLED
+#if defined(ZN_PROFILER_ENABLED) || defined(ZN_BUILTIN_PROFILER_ENABLED)
 		ZN_PROFILE_SET_THREAD_NAME(data.name.c_str());
 #endif
 	}
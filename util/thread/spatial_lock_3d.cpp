@@ -4,30 +4,241 @@
 
 namespace zylann {
 
-SpatialLock3D::SpatialLock3D() {
-	_boxes.reserve(8);
+namespace {
+
+// Size of cells of the grid used to distribute boxes into shards
+const int CELL_SIZE_PO2 = 3;
+// Boxes touching more cells than this are stored in all shards, instead of spending time listing their cells
+const int64_t MAX_CELLS_PER_BOX = 64;
+
+inline Vector3i get_cell_position(Vector3i pos) {
+	return Vector3i(pos.x >> CELL_SIZE_PO2, pos.y >> CELL_SIZE_PO2, pos.z >> CELL_SIZE_PO2);
+}
+
+inline unsigned int get_shard_index(int cx, int cy, int cz, unsigned int shard_count) {
+	// Hash so that neighbor cells end up in different shards
+	const uint32_t h = (static_cast<uint32_t>(cx) * 73856093u) ^ (static_cast<uint32_t>(cy) * 19349663u) ^
+			(static_cast<uint32_t>(cz) * 83492791u);
+	return h % shard_count;
+}
+
+inline bool conflicts(const SpatialLock3D::Box &existing_box, const BoxBounds3i &box, SpatialLock3D::Mode mode) {
+	return existing_box.bounds.intersects(box) &&
+			(mode == SpatialLock3D::MODE_WRITE || existing_box.mode == SpatialLock3D::MODE_WRITE);
 }
 
-void SpatialLock3D::remove_box(const BoxBounds3i &box, Mode mode) {
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+// Spatial locks in which the current thread has locked a box
+thread_local StdVector<const SpatialLock3D *> tls_held_locks;
+
+bool is_held_by_current_thread(const SpatialLock3D *sl) {
+	for (const SpatialLock3D *held : tls_held_locks) {
+		if (held == sl) {
+			return true;
+		}
+	}
+	return false;
+}
+#endif
+
+} // namespace
+
+SpatialLock3D::SpatialLock3D(unsigned int shard_count) {
+	ZN_ASSERT(shard_count >= 1 && shard_count <= MAX_SHARD_COUNT);
+	_shard_count = shard_count;
+	_all_shards_mask = shard_count == 32 ? 0xffffffff : ((1u << shard_count) - 1);
+	for (unsigned int i = 0; i < _shard_count; ++i) {
+		_shards[i].boxes.reserve(8);
+	}
+}
+
+uint32_t SpatialLock3D::get_shard_mask(const BoxBounds3i &box) const {
+	if (_shard_count == 1) {
+		return 1;
+	}
+
+	// Boxes touching each other are considered intersecting, so the max position is included
+	const Vector3i min_cell = get_cell_position(box.min_pos);
+	const Vector3i max_cell = get_cell_position(box.max_pos);
+
+	const int64_t size_x = static_cast<int64_t>(max_cell.x) - min_cell.x + 1;
+	const int64_t size_y = static_cast<int64_t>(max_cell.y) - min_cell.y + 1;
+	const int64_t size_z = static_cast<int64_t>(max_cell.z) - min_cell.z + 1;
+	// Checking each axis first, because the volume of boxes covering everywhere doesn't fit in 64 bits
+	if (size_x > MAX_CELLS_PER_BOX || size_y > MAX_CELLS_PER_BOX || size_z > MAX_CELLS_PER_BOX ||
+		size_x * size_y * size_z > MAX_CELLS_PER_BOX) {
+		return _all_shards_mask;
+	}
+
+	uint32_t mask = 0;
+	for (int cz = min_cell.z; cz <= max_cell.z; ++cz) {
+		for (int cx = min_cell.x; cx <= max_cell.x; ++cx) {
+			for (int cy = min_cell.y; cy <= max_cell.y; ++cy) {
+				mask |= (1u << get_shard_index(cx, cy, cz, _shard_count));
+			}
+		}
+	}
+	return mask;
+}
+
+int SpatialLock3D::lock_or_find_conflict(const BoxBounds3i &box, Mode mode) {
+	const uint32_t mask = get_shard_mask(box);
+
+	// Shards are always locked in the same order, so threads locking several of them can't deadlock
+	for (unsigned int si = 0; si < _shard_count; ++si) {
+		if ((mask & (1u << si)) != 0) {
+			_shards[si].mutex.lock();
+		}
+	}
+
+	int conflict_shard_index = -1;
+
+	for (unsigned int si = 0; si < _shard_count && conflict_shard_index == -1; ++si) {
+		if ((mask & (1u << si)) == 0) {
+			continue;
+		}
+		for (const Box &existing_box : _shards[si].boxes) {
+			if (conflicts(existing_box, box, mode)) {
+				conflict_shard_index = si;
+				break;
+			}
+		}
+	}
+
+	if (conflict_shard_index == -1) {
+		const Box new_box{ box, mode,
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+			Thread::get_caller_id()
+#endif
+		};
+		for (unsigned int si = 0; si < _shard_count; ++si) {
+			if ((mask & (1u << si)) != 0) {
+				_shards[si].boxes.push_back(new_box);
+			}
+		}
+		++_box_count;
+	}
+
+	for (unsigned int si = 0; si < _shard_count; ++si) {
+		if ((mask & (1u << si)) != 0 && static_cast<int>(si) != conflict_shard_index) {
+			_shards[si].mutex.unlock();
+		}
+	}
+
+	return conflict_shard_index;
+}
+
+bool SpatialLock3D::try_lock(const BoxBounds3i &box, Mode mode) {
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+	// Each thread can lock only one box at a time, otherwise there can be deadlocks depending on the order of
+	// locks. For example:
+	// - Thread 1 locks A
+	// - Thread 2 locks B
+	// - Thread 1 locks B, but blocks because it is already locked
+	// - Thread 2 locks A, but blocks because it is already locked:
+	//   This is a deadlock.
+	// Note: this is not true if threads only lock for reading, but if we didn't ever write we'd not use locks.
+	// Note: this is also not true if threads use `try_lock` instead!
+	ZN_ASSERT_RETURN_V_MSG(
+			!is_held_by_current_thread(this), false, "Locking two areas from the same threads is not allowed"
+	);
+#endif
+
+	const int conflict_shard_index = lock_or_find_conflict(box, mode);
+	if (conflict_shard_index != -1) {
+		_shards[conflict_shard_index].mutex.unlock();
+		return false;
+	}
+
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+	tls_held_locks.push_back(this);
+#endif
+	return true;
+}
+
+void SpatialLock3D::lock(const BoxBounds3i &box, Mode mode) {
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+	ZN_ASSERT_RETURN_MSG(!is_held_by_current_thread(this), "Locking two areas from the same threads is not allowed");
+#endif
+
+	while (true) {
+		const int conflict_shard_index = lock_or_find_conflict(box, mode);
+		if (conflict_shard_index == -1) {
+			break;
+		}
+
+		// Wait until a box gets removed from the shard where the conflict was found. Its mutex is still locked since
+		// we found the conflict, so we can't miss it.
+		Shard &shard = _shards[conflict_shard_index];
+		std::unique_lock<std::mutex> shard_lock(shard.mutex, std::adopt_lock);
+		const uint32_t generation = shard.generation;
+		++shard.waiter_count;
+		shard.condition.wait(shard_lock, [&shard, generation]() { return shard.generation != generation; });
+		--shard.waiter_count;
+	}
+
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+	tls_held_locks.push_back(this);
+#endif
+}
+
+void SpatialLock3D::unlock(const BoxBounds3i &box, Mode mode) {
 #ifdef ZN_SPATIAL_LOCK_3D_CHECKS
 	const Thread::ID thread_id = Thread::get_caller_id();
 #endif
 
-	for (unsigned int i = 0; i < _boxes.size(); ++i) {
-		const Box &existing_box = _boxes[i];
+	const uint32_t mask = get_shard_mask(box);
+	bool found = false;
+
+	// Shards don't need to be locked all at once here. Until the box is removed from all of them, other threads can
+	// still see it as locked, and wait for the next removal.
+	for (unsigned int si = 0; si < _shard_count; ++si) {
+		if ((mask & (1u << si)) == 0) {
+			continue;
+		}
+		Shard &shard = _shards[si];
+		std::lock_guard<std::mutex> shard_lock(shard.mutex);
+
+		StdVector<Box> &boxes = shard.boxes;
+		for (unsigned int i = 0; i < boxes.size(); ++i) {
+			const Box &existing_box = boxes[i];
 
-		if (existing_box.bounds == box && existing_box.mode == mode
+			if (existing_box.bounds == box && existing_box.mode == mode
 #ifdef ZN_SPATIAL_LOCK_3D_CHECKS
 				&& existing_box.thread_id == thread_id
 #endif
-		) {
-			_boxes[i] = _boxes[_boxes.size() - 1];
-			_boxes.pop_back();
-			return;
+			) {
+				boxes[i] = boxes.back();
+				boxes.pop_back();
+				found = true;
+
+				++shard.generation;
+				if (shard.waiter_count > 0) {
+					// Tell threads waiting on this shard that they might be able to lock their box now.
+					shard.condition.notify_all();
+				}
+				break;
+			}
 		}
 	}
-	// Could be a bug
-	ZN_PRINT_ERROR(format("Could not find box to remove {} with mode {}", box, mode));
+
+	if (!found) {
+		// Could be a bug
+		ZN_PRINT_ERROR(format("Could not find box to remove {} with mode {}", box, mode));
+		return;
+	}
+
+	--_box_count;
+
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+	for (unsigned int i = 0; i < tls_held_locks.size(); ++i) {
+		if (tls_held_locks[i] == this) {
+			tls_held_locks[i] = tls_held_locks.back();
+			tls_held_locks.pop_back();
+			break;
+		}
+	}
+#endif
 }
 
 } // namespace zylann
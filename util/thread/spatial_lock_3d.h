@@ -1,13 +1,15 @@
 #ifndef ZN_SPATIAL_LOCK_3D_H
 #define ZN_SPATIAL_LOCK_3D_H
 
+#include "../containers/fixed_array.h"
 #include "../containers/std_vector.h"
 #include "../math/box_bounds_3i.h"
-#include "mutex.h"
-#include "semaphore.h"
-#include "short_lock.h"
 #include "thread.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
 #ifdef TOOLS_ENABLED
 #define ZN_SPATIAL_LOCK_3D_CHECKS
 #endif
@@ -24,6 +26,10 @@ namespace zylann {
 //
 // Do not try to lock more than one box at the same time before doing your task. If another thread does so,
 // it could end up in a deadlock depending in the order it happens.
+//
+// Space is divided into a coarse grid, whose cells are hashed into a fixed number of shards. Locked boxes are stored in
+// the shards of every cell they touch, so looking for conflicts only has to check boxes in the same area, and only
+// contends with threads locking in the same area. Very large boxes are stored in all shards.
 class SpatialLock3D {
 public:
 	enum Mode { //
@@ -39,58 +45,34 @@ public:
 #endif
 	};
 
-	SpatialLock3D();
+	// Boxes are distributed into shards, each with their own lock, so threads locking distant areas don't contend
+	static const unsigned int MAX_SHARD_COUNT = 32;
+	static const unsigned int DEFAULT_SHARD_COUNT = MAX_SHARD_COUNT;
+
+	SpatialLock3D(unsigned int shard_count = DEFAULT_SHARD_COUNT);
 
 	~SpatialLock3D() {
-		ZN_ASSERT_RETURN(_boxes.size() == 0);
+		ZN_ASSERT_RETURN(_box_count == 0);
 	}
 
-	bool try_lock_read(const BoxBounds3i &box) {
-		_boxes_mutex.lock();
-		if (can_lock_for_read(box)) {
-			_boxes.push_back(Box{ box, MODE_READ,
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-					Thread::get_caller_id()
-#endif
-			});
-			_boxes_mutex.unlock();
-			return true;
-		} else {
-			_boxes_mutex.unlock();
-			return false;
-		}
+	inline bool try_lock_read(const BoxBounds3i &box) {
+		return try_lock(box, MODE_READ);
 	}
 
-	void lock_read(const BoxBounds3i &box) {
-		while (try_lock_read(box) == false) {
-			_semaphore.wait();
-		}
+	inline void lock_read(const BoxBounds3i &box) {
+		lock(box, MODE_READ);
 	}
 
 	inline void unlock_read(const BoxBounds3i &box) {
 		unlock(box, MODE_READ);
 	}
 
-	bool try_lock_write(const BoxBounds3i &box) {
-		_boxes_mutex.lock();
-		if (can_lock_for_write(box)) {
-			_boxes.push_back(Box{ box, MODE_WRITE,
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-					Thread::get_caller_id()
-#endif
-			});
-			_boxes_mutex.unlock();
-			return true;
-		} else {
-			_boxes_mutex.unlock();
-			return false;
-		}
+	inline bool try_lock_write(const BoxBounds3i &box) {
+		return try_lock(box, MODE_WRITE);
 	}
 
-	void lock_write(const BoxBounds3i &box) {
-		while (try_lock_write(box) == false) {
-			_semaphore.wait();
-		}
+	inline void lock_write(const BoxBounds3i &box) {
+		lock(box, MODE_WRITE);
 	}
 
 	inline void unlock_write(const BoxBounds3i &box) {
@@ -98,8 +80,11 @@ public:
 	}
 
 	inline int get_locked_boxes_count() const {
-		ShortLockScope rlock(_boxes_mutex);
-		return _boxes.size();
+		return _box_count;
+	}
+
+	inline unsigned int get_shard_count() const {
+		return _shard_count;
 	}
 
 	// Scoped helpers
@@ -127,75 +112,36 @@ public:
 	};
 
 private:
-	bool can_lock_for_read(const BoxBounds3i &box) {
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-		const Thread::ID thread_id = Thread::get_caller_id();
-#endif
-
-		for (unsigned int i = 0; i < _boxes.size(); ++i) {
-			const Box &existing_box = _boxes[i];
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-			// Each thread can lock only one box at a time, otherwise there can be deadlocks depending on the order of
-			// locks. For example:
-			// - Thread 1 locks A
-			// - Thread 2 locks B
-			// - Thread 1 locks B, but blocks because it is already locked
-			// - Thread 2 locks A, but blocks because it is already locked:
-			//   This is a deadlock.
-			// Note: this is not true if threads only lock for reading, but if we didn't ever write we'd not use locks.
-			// Note: this is also not true if threads use `try_lock` instead!
-			ZN_ASSERT_RETURN_V_MSG(existing_box.thread_id != thread_id, false,
-					"Locking two areas from the same threads is not allowed");
-#endif
-			if (existing_box.bounds.intersects(box) && existing_box.mode == MODE_WRITE) {
-				return false;
-				break;
-			}
-		}
-		return true;
-	}
-
-	bool can_lock_for_write(const BoxBounds3i &box) {
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-		const Thread::ID thread_id = Thread::get_caller_id();
-#endif
+	struct Shard {
+		// Boxes currently locked and touching this shard. A box can be stored in more than one shard.
+		// In practice, each thread can lock up to 1 box at once, so there won't be many boxes to store.
+		StdVector<Box> boxes;
+		// Incremented everytime a box is removed, so waiting threads can tell when to retry
+		uint32_t generation = 0;
+		unsigned int waiter_count = 0;
+		// This mutex is supposed to be locked for very small periods of time, just to lookup, add or remove boxes.
+		// The long-period locking states are the boxes themselves.
+		std::mutex mutex;
+		// Threads that failed to lock a box because of a conflict in this shard wait on this, so unlocking only wakes
+		// up threads that might be able to lock their box now.
+		std::condition_variable condition;
+	};
 
-		for (unsigned int i = 0; i < _boxes.size(); ++i) {
-			const Box &existing_box = _boxes[i];
+	bool try_lock(const BoxBounds3i &box, Mode mode);
+	void lock(const BoxBounds3i &box, Mode mode);
+	void unlock(const BoxBounds3i &box, Mode mode);
 
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-			ZN_ASSERT_RETURN_V_MSG(existing_box.thread_id != thread_id, false,
-					"Locking two areas from the same threads is not allowed");
-#endif
-			if (existing_box.bounds.intersects(box)) {
-				return false;
-				break;
-			}
-		}
-		return true;
-	}
-
-	void remove_box(const BoxBounds3i &box, Mode mode);
+	// Locks the box if it doesn't conflict with other locked boxes, and returns -1. Otherwise, returns the index of
+	// the shard where a conflict was found, leaving that shard's mutex locked.
+	int lock_or_find_conflict(const BoxBounds3i &box, Mode mode);
 
-	void unlock(const BoxBounds3i &box, Mode mode) {
-		_boxes_mutex.lock();
-		remove_box(box, mode);
-		_boxes_mutex.unlock();
-		// Tell eventual waiting threads that they might be able to lock their box now.
-		_semaphore.post();
-	}
+	// Gets which shards a box is stored in, as a bitmask
+	uint32_t get_shard_mask(const BoxBounds3i &box) const;
 
-	// List of boxes currently locked.
-	// In practice, each thread can lock up to 1 box at once (maybe a few more in rare cases that would allow it), so
-	// there won't be many boxes to store.
-	StdVector<Box> _boxes;
-	// This mutex is supposed to be locked for very small periods of time, just to lookup, add or remove boxes.
-	// So we lock it even in `try_*` methods. The long-period locking states are the boxes themselves.
-	// Also it is not a recursive mutex for performance. Do not lock it again once you successfully locked it.
-	mutable ShortLock _boxes_mutex;
-	// This semaphore is waited for when a lock fails. It is posted everytime a box is unlocked, so any thread
-	// waiting for it may retry locking their box.
-	Semaphore _semaphore;
+	FixedArray<Shard, MAX_SHARD_COUNT> _shards;
+	unsigned int _shard_count;
+	uint32_t _all_shards_mask;
+	std::atomic_int _box_count = { 0 };
 };
 
 } // namespace zylann